@@ -55,6 +55,11 @@
 #define CONFDB_SERVICE_DEBUG_TIMESTAMPS "debug_timestamps"
 #define CONFDB_SERVICE_DEBUG_MICROSECONDS "debug_microseconds"
 #define CONFDB_SERVICE_DEBUG_TO_FILES "debug_to_files"
+#define CONFDB_SERVICE_DEBUG_BUFFER_SIZE "debug_buffer_size"
+#define CONFDB_SERVICE_DEBUG_TRACE_LEVEL "debug_trace_level"
+#define CONFDB_SERVICE_DEBUG_TRACE_SIZE "debug_trace_size"
+#define CONFDB_SERVICE_LATENCY_REPORT_INTERVAL "latency_report_interval"
+#define CONFDB_SERVICE_LATENCY_TRACE_REQUESTS "latency_trace_requests"
 #define CONFDB_SERVICE_TIMEOUT "timeout"
 #define CONFDB_SERVICE_FORCE_TIMEOUT "force_timeout"
 #define CONFDB_SERVICE_RECON_RETRIES "reconnection_retries"
@@ -84,6 +89,7 @@
 #define CONFDB_RESPONDER_GET_DOMAINS_TIMEOUT "get_domains_timeout"
 #define CONFDB_RESPONDER_CLI_IDLE_TIMEOUT "client_idle_timeout"
 #define CONFDB_RESPONDER_CLI_IDLE_DEFAULT_TIMEOUT 60
+#define CONFDB_RESPONDER_PARALLEL_DOMAIN_LOOKUPS "parallel_domain_lookups"
 
 /* NSS */
 #define CONFDB_NSS_CONF_ENTRY "config/nss"
@@ -102,6 +108,16 @@
 #define CONFDB_NSS_SHELL_FALLBACK "shell_fallback"
 #define CONFDB_NSS_DEFAULT_SHELL "default_shell"
 #define CONFDB_MEMCACHE_TIMEOUT "memcache_timeout"
+#define CONFDB_NSS_MEMCACHE_NEGATIVE "memcache_negative"
+#define CONFDB_NSS_MEMCACHE_SIZE_PASSWD "memcache_size_passwd"
+#define CONFDB_NSS_MEMCACHE_SIZE_GROUP "memcache_size_group"
+#define CONFDB_NSS_MEMCACHE_SIZE_INITGROUPS "memcache_size_initgroups"
+#define CONFDB_NSS_MEMCACHE_SIZE_NETGROUP "memcache_size_netgroup"
+#define CONFDB_NSS_MEMCACHE_SIZE_SERVICES "memcache_size_services"
+#define CONFDB_NSS_MEMCACHE_SIZE_SID "memcache_size_sid"
+#define CONFDB_NSS_MEMCACHE_SIZE_NEGATIVE "memcache_size_negative"
+#define CONFDB_NSS_MEMCACHE_STATS "memcache_stats"
+#define CONFDB_NSS_MEMCACHE_WARM_RESTART "memcache_warm_restart"
 #define CONFDB_NSS_HOMEDIR_SUBSTRING "homedir_substring"
 #define CONFDB_DEFAULT_HOMEDIR_SUBSTRING "/home"
 
@@ -179,6 +195,7 @@
                                  "cache_credentials_minimal_first_factor_length"
 #define CONFDB_DEFAULT_CACHE_CREDS_MIN_FF_LENGTH 8
 #define CONFDB_DOMAIN_LEGACY_PASS "store_legacy_passwords"
+#define CONFDB_DOMAIN_LOG_FULL_SCANS "cache_log_full_scans"
 #define CONFDB_DOMAIN_MPG "magic_private_groups"
 #define CONFDB_DOMAIN_FQ "use_fully_qualified_names"
 #define CONFDB_DOMAIN_ENTRY_CACHE_TIMEOUT "entry_cache_timeout"
@@ -258,6 +275,7 @@ struct sss_domain_info {
     bool cache_credentials;
     uint32_t cache_credentials_min_ff_length;
     bool legacy_passwords;
+    bool log_full_scans;
     bool case_sensitive;
     bool case_preserve;
 
@@ -303,10 +303,16 @@ class SSSDConfigTestSSSDService(unittest.TestCase):
             'debug_timestamps',
             'debug_microseconds',
             'debug_to_files',
+            'debug_buffer_size',
+            'debug_trace_level',
+            'debug_trace_size',
+            'latency_report_interval',
+            'latency_trace_requests',
             'command',
             'reconnection_retries',
             'fd_limit',
             'client_idle_timeout',
+            'parallel_domain_lookups',
             'diag_cmd',
             'description',
             'certificate_verification']
@@ -499,6 +505,8 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'description',
             'debug_level',
             'debug_timestamps',
+            'latency_report_interval',
+            'latency_trace_requests',
             'min_id',
             'max_id',
             'timeout',
@@ -510,6 +518,7 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'cache_credentials',
             'cache_credentials_minimal_first_factor_length',
             'store_legacy_passwords',
+            'cache_log_full_scans',
             'use_fully_qualified_names',
             'ignore_group_members',
             'filter_users',
@@ -526,6 +535,7 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'lookup_family_order',
             'account_cache_expiration',
             'dns_resolver_timeout',
+            'dns_resolver_cache_timeout',
             'dns_discovery_domain',
             'dyndns_update',
             'dyndns_ttl',
@@ -640,7 +650,9 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
              'krb5_canonicalize',
              'krb5_use_enterprise_principal',
              'krb5_use_kdcinfo',
-             'krb5_map_user'])
+             'krb5_map_user',
+             'krb5_child_pool_size',
+             'krb5_child_pool_max_requests'])
 
         options = domain.list_options()
 
@@ -802,7 +814,9 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'krb5_canonicalize',
             'krb5_use_enterprise_principal',
             'krb5_use_kdcinfo',
-            'krb5_map_user']
+            'krb5_map_user',
+            'krb5_child_pool_size',
+            'krb5_child_pool_max_requests']
 
         self.assertTrue(type(options) == dict,
                         "Options should be a dictionary")
@@ -865,6 +879,8 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'description',
             'debug_level',
             'debug_timestamps',
+            'latency_report_interval',
+            'latency_trace_requests',
             'min_id',
             'max_id',
             'timeout',
@@ -876,6 +892,7 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'cache_credentials',
             'cache_credentials_minimal_first_factor_length',
             'store_legacy_passwords',
+            'cache_log_full_scans',
             'use_fully_qualified_names',
             'ignore_group_members',
             'filter_users',
@@ -892,6 +909,7 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'account_cache_expiration',
             'lookup_family_order',
             'dns_resolver_timeout',
+            'dns_resolver_cache_timeout',
             'dns_discovery_domain',
             'dyndns_update',
             'dyndns_ttl',
@@ -1007,7 +1025,9 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
              'krb5_canonicalize',
              'krb5_use_enterprise_principal',
              'krb5_use_kdcinfo',
-             'krb5_map_user'])
+             'krb5_map_user',
+             'krb5_child_pool_size',
+             'krb5_child_pool_max_requests'])
 
         options = domain.list_options()
 
@@ -23,6 +23,7 @@
 #include "util/util.h"
 #include "util/strtonum.h"
 #include "util/sss_utf8.h"
+#include "util/sss_latency.h"
 #include "db/sysdb_private.h"
 #include "confdb/confdb.h"
 #include <time.h>
@@ -31,10 +32,17 @@
 
 errno_t sysdb_ldb_connect(TALLOC_CTX *mem_ctx, const char *filename,
                           struct ldb_context **_ldb)
+{
+    return sysdb_ldb_connect_ex(mem_ctx, filename, false, _ldb);
+}
+
+errno_t sysdb_ldb_connect_ex(TALLOC_CTX *mem_ctx, const char *filename,
+                             bool log_full_scans, struct ldb_context **_ldb)
 {
     int ret;
     struct ldb_context *ldb;
     const char *mod_path;
+    const char **options = NULL;
 
     if (_ldb == NULL) {
         return EINVAL;
@@ -56,7 +64,16 @@ errno_t sysdb_ldb_connect(TALLOC_CTX *mem_ctx, const char *filename,
         ldb_set_modules_dir(ldb, mod_path);
     }
 
-    ret = ldb_connect(ldb, filename, 0, NULL);
+    if (log_full_scans) {
+        ret = sysdb_trace_init(ldb, &options);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "Cannot set up logging of full cache scans\n");
+            return ret;
+        }
+    }
+
+    ret = ldb_connect(ldb, filename, 0, options);
     if (ret != LDB_SUCCESS) {
         return EIO;
     }
@@ -904,9 +921,13 @@ int sysdb_transaction_start(struct sysdb_ctx *sysdb)
 
 int sysdb_transaction_commit(struct sysdb_ctx *sysdb)
 {
+    struct timeval start;
     int ret;
 
+    sss_latency_start(&start);
     ret = ldb_transaction_commit(sysdb->ldb);
+    sss_latency_record(sss_latency_current_rid(), SSS_LATENCY_SYSDB_WRITE,
+                       &start);
     if (ret != LDB_SUCCESS) {
         DEBUG(SSSDBG_CRIT_FAILURE,
               "Failed to commit ldb transaction! (%d)\n", ret);
@@ -1120,7 +1141,8 @@ int sysdb_domain_init_internal(TALLOC_CTX *mem_ctx,
     DEBUG(SSSDBG_FUNC_DATA,
           "DB File for %s: %s\n", domain->name, sysdb->ldb_file);
 
-    ret = sysdb_ldb_connect(sysdb, sysdb->ldb_file, &sysdb->ldb);
+    ret = sysdb_ldb_connect_ex(sysdb, sysdb->ldb_file,
+                               domain->log_full_scans, &sysdb->ldb);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, "sysdb_ldb_connect failed.\n");
         goto done;
@@ -1284,6 +1306,13 @@ int sysdb_domain_init_internal(TALLOC_CTX *mem_ctx,
             }
         }
 
+        if (strcmp(version, SYSDB_VERSION_0_17) == 0) {
+            ret = sysdb_upgrade_17(sysdb, &version);
+            if (ret != EOK) {
+                goto done;
+            }
+        }
+
         /* The version should now match SYSDB_VERSION.
          * If not, it means we didn't match any of the
          * known older versions. The DB might be
@@ -1296,7 +1325,8 @@ int sysdb_domain_init_internal(TALLOC_CTX *mem_ctx,
              * any changes made above take effect.
              */
             talloc_zfree(sysdb->ldb);
-            ret = sysdb_ldb_connect(sysdb, sysdb->ldb_file, &sysdb->ldb);
+            ret = sysdb_ldb_connect_ex(sysdb, sysdb->ldb_file,
+                                       domain->log_full_scans, &sysdb->ldb);
             if (ret != EOK) {
                 DEBUG(SSSDBG_CRIT_FAILURE, "sysdb_ldb_connect failed.\n");
             }
@@ -1337,7 +1367,8 @@ int sysdb_domain_init_internal(TALLOC_CTX *mem_ctx,
      * the various indexes).
      */
     talloc_zfree(sysdb->ldb);
-    ret = sysdb_ldb_connect(sysdb, sysdb->ldb_file, &sysdb->ldb);
+    ret = sysdb_ldb_connect_ex(sysdb, sysdb->ldb_file,
+                               domain->log_full_scans, &sysdb->ldb);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, "sysdb_ldb_connect failed.\n");
     }
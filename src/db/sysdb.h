@@ -646,6 +646,22 @@ int sysdb_enumpwent_filter_with_views(TALLOC_CTX *mem_ctx,
                                       const char *addtl_filter,
                                       struct ldb_result **res);
 
+/* Returns only the names of the users sysdb_enumpwent() would return, so
+ * that large domains can be enumerated a page at a time with
+ * sysdb_enumpwent_page_with_views(). */
+int sysdb_enumpwent_names(TALLOC_CTX *mem_ctx,
+                          struct sss_domain_info *domain,
+                          const char ***_names,
+                          size_t *_count);
+
+/* Loads the users in @names with the overrides of the domain view applied.
+ * Users removed since @names was read are skipped. */
+int sysdb_enumpwent_page_with_views(TALLOC_CTX *mem_ctx,
+                                    struct sss_domain_info *domain,
+                                    const char **names,
+                                    size_t count,
+                                    struct ldb_result **res);
+
 int sysdb_getgrnam(TALLOC_CTX *mem_ctx,
                    struct sss_domain_info *domain,
                    const char *name,
@@ -934,6 +950,54 @@ int sysdb_store_group(struct sss_domain_info *domain,
                       uint64_t cache_timeout,
                       time_t now);
 
+/* One user of a batch, the members have the same meaning as the arguments
+ * of sysdb_store_user(). The result of storing the user is set in ret. */
+struct sysdb_user_batch_entry {
+    struct sss_domain_info *domain;
+    const char *name;
+    const char *pwd;
+    uid_t uid;
+    gid_t gid;
+    const char *gecos;
+    const char *homedir;
+    const char *shell;
+    const char *orig_dn;
+    struct sysdb_attrs *attrs;
+    char **remove_attrs;
+    uint64_t cache_timeout;
+
+    errno_t ret;
+};
+
+/* Stores all users in a single transaction. Which of the users are already
+ * cached is found out with one search per chunk of users instead of one
+ * search per user. A failure to store a single user is only recorded in its
+ * entry, the function returns an error only if the transaction could not be
+ * used. */
+errno_t sysdb_store_users_batch(struct sysdb_ctx *sysdb,
+                                struct sysdb_user_batch_entry *users,
+                                size_t num_users,
+                                time_t now);
+
+/* One group of a batch, see struct sysdb_user_batch_entry */
+struct sysdb_group_batch_entry {
+    struct sss_domain_info *domain;
+    const char *name;
+    gid_t gid;
+    struct sysdb_attrs *attrs;
+    uint64_t cache_timeout;
+
+    errno_t ret;
+};
+
+/* Stores all groups like sysdb_store_users_batch() does for users. Member
+ * lists of cached groups that did not change are not written again, so the
+ * memberof plugin does not have to process them. */
+errno_t sysdb_store_groups_batch(struct sysdb_ctx *sysdb,
+                                 struct sysdb_group_batch_entry *groups,
+                                 size_t num_groups,
+                                 time_t now);
+
 enum sysdb_member_type {
     SYSDB_MEMBER_USER,
     SYSDB_MEMBER_GROUP,
@@ -317,6 +317,13 @@ enum sysdb_obj_type {
     SYSDB_GROUP
 };
 
+/* Tells the store functions whether the object is already cached */
+enum sysdb_store_lookup {
+    SYSDB_STORE_LOOKUP = 0,     /* not known yet, search for the object */
+    SYSDB_STORE_NEW,            /* the object is not cached */
+    SYSDB_STORE_EXISTING        /* the object is cached */
+};
+
 static int sysdb_search_by_name(TALLOC_CTX *mem_ctx,
                                 struct sss_domain_info *domain,
                                 const char *name,
@@ -1887,18 +1894,19 @@ done:
 /* if one of the basic attributes is empty ("") as opposed to NULL,
  * this will just remove it */
 
-int sysdb_store_user(struct sss_domain_info *domain,
-                     const char *name,
-                     const char *pwd,
-                     uid_t uid, gid_t gid,
-                     const char *gecos,
-                     const char *homedir,
-                     const char *shell,
-                     const char *orig_dn,
-                     struct sysdb_attrs *attrs,
-                     char **remove_attrs,
-                     uint64_t cache_timeout,
-                     time_t now)
+static int sysdb_store_user_int(struct sss_domain_info *domain,
+                                const char *name,
+                                const char *pwd,
+                                uid_t uid, gid_t gid,
+                                const char *gecos,
+                                const char *homedir,
+                                const char *shell,
+                                const char *orig_dn,
+                                struct sysdb_attrs *attrs,
+                                char **remove_attrs,
+                                uint64_t cache_timeout,
+                                time_t now,
+                                enum sysdb_store_lookup lookup)
 {
     TALLOC_CTX *tmp_ctx;
     struct ldb_message *msg;
@@ -1932,9 +1940,12 @@ int sysdb_store_user(struct sss_domain_info *domain,
 
     in_transaction = true;
 
-    ret = sysdb_search_user_by_name(tmp_ctx, domain, name, NULL, &msg);
-    if (ret && ret != ENOENT) {
-        goto fail;
+    if (lookup == SYSDB_STORE_LOOKUP) {
+        ret = sysdb_search_user_by_name(tmp_ctx, domain, name, NULL, &msg);
+        if (ret && ret != ENOENT) {
+            goto fail;
+        }
+        lookup = (ret == ENOENT) ? SYSDB_STORE_NEW : SYSDB_STORE_EXISTING;
     }
 
     /* get transaction timestamp */
@@ -1942,7 +1953,7 @@ int sysdb_store_user(struct sss_domain_info *domain,
         now = time(NULL);
     }
 
-    if (ret == ENOENT) {
+    if (lookup == SYSDB_STORE_NEW) {
         /* users doesn't exist, turn into adding a user */
         ret = sysdb_add_user(domain, name, uid, gid, gecos, homedir,
                              shell, orig_dn, attrs, cache_timeout, now);
@@ -2052,16 +2063,35 @@ fail:
     return ret;
 }
 
+int sysdb_store_user(struct sss_domain_info *domain,
+                     const char *name,
+                     const char *pwd,
+                     uid_t uid, gid_t gid,
+                     const char *gecos,
+                     const char *homedir,
+                     const char *shell,
+                     const char *orig_dn,
+                     struct sysdb_attrs *attrs,
+                     char **remove_attrs,
+                     uint64_t cache_timeout,
+                     time_t now)
+{
+    return sysdb_store_user_int(domain, name, pwd, uid, gid, gecos, homedir,
+                                shell, orig_dn, attrs, remove_attrs,
+                                cache_timeout, now, SYSDB_STORE_LOOKUP);
+}
+
 /* =Store-Group-(Native/Legacy)-(replaces-existing-data)================== */
 
 /* this function does not check that all user members are actually present */
 
-int sysdb_store_group(struct sss_domain_info *domain,
-                      const char *name,
-                      gid_t gid,
-                      struct sysdb_attrs *attrs,
-                      uint64_t cache_timeout,
-                      time_t now)
+static int sysdb_store_group_int(struct sss_domain_info *domain,
+                                 const char *name,
+                                 gid_t gid,
+                                 struct sysdb_attrs *attrs,
+                                 uint64_t cache_timeout,
+                                 time_t now,
+                                 enum sysdb_store_lookup lookup)
 {
     TALLOC_CTX *tmp_ctx;
     static const char *src_attrs[] = { SYSDB_NAME, SYSDB_GIDNUM,
@@ -2075,14 +2105,18 @@ int sysdb_store_group(struct sss_domain_info *domain,
         return ENOMEM;
     }
 
-    ret = sysdb_search_group_by_name(tmp_ctx, domain, name, src_attrs, &msg);
-    if (ret && ret != ENOENT) {
-        DEBUG(SSSDBG_MINOR_FAILURE,
-              "sysdb_search_group_by_name failed for %s with: [%d][%s].\n",
-              name, ret, strerror(ret));
-        goto done;
+    if (lookup == SYSDB_STORE_LOOKUP) {
+        ret = sysdb_search_group_by_name(tmp_ctx, domain, name, src_attrs,
+                                         &msg);
+        if (ret && ret != ENOENT) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "sysdb_search_group_by_name failed for %s with: [%d][%s].\n",
+                  name, ret, strerror(ret));
+            goto done;
+        }
+        lookup = (ret == ENOENT) ? SYSDB_STORE_NEW : SYSDB_STORE_EXISTING;
     }
-    if (ret == ENOENT) {
+    if (lookup == SYSDB_STORE_NEW) {
         DEBUG(SSSDBG_TRACE_LIBS, "Group %s does not exist.\n", name);
         new_group = true;
     }
@@ -2176,6 +2210,489 @@ done:
     return ret;
 }
 
+int sysdb_store_group(struct sss_domain_info *domain,
+                      const char *name,
+                      gid_t gid,
+                      struct sysdb_attrs *attrs,
+                      uint64_t cache_timeout,
+                      time_t now)
+{
+    return sysdb_store_group_int(domain, name, gid, attrs, cache_timeout, now,
+                                 SYSDB_STORE_LOOKUP);
+}
+
+/* =Store-Users/Groups-in-batches========================================== */
+
+#define SYSDB_STORE_BATCH_SIZE 64
+
+static bool sysdb_batch_msg_matches(struct ldb_message *msg,
+                                    const char *name,
+                                    const char *lc_name)
+{
+    struct ldb_message_element *el;
+    const char *val;
+    unsigned int i;
+
+    val = ldb_msg_find_attr_as_string(msg, SYSDB_NAME, NULL);
+    if (val != NULL && strcmp(val, name) == 0) {
+        return true;
+    }
+
+    el = ldb_msg_find_element(msg, SYSDB_NAME_ALIAS);
+    if (el == NULL) {
+        return false;
+    }
+
+    for (i = 0; i < el->num_values; i++) {
+        val = (const char *) el->values[i].data;
+        if (strcmp(val, name) == 0 || strcmp(val, lc_name) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Searches all objects of the given names with a single search, the filter
+ * is the union of the filters sysdb_search_by_name() would use for each
+ * name. On success _cached contains the cached object for each name or NULL
+ * if the name is not cached. */
+static errno_t sysdb_batch_search_by_name(TALLOC_CTX *mem_ctx,
+                                          struct sss_domain_info *domain,
+                                          enum sysdb_obj_type type,
+                                          const char **names,
+                                          size_t num_names,
+                                          const char **attrs,
+                                          struct ldb_message ***_cached)
+{
+    TALLOC_CTX *tmp_ctx;
+    const char *base_tmpl;
+    const char *class_filter;
+    struct ldb_message **msgs = NULL;
+    struct ldb_message **cached;
+    struct ldb_dn *basedn;
+    size_t msgs_count = 0;
+    char *sanitized_name;
+    char *lc_sanitized_name;
+    const char *lc_name;
+    char *filter;
+    size_t i;
+    size_t j;
+    errno_t ret;
+
+    switch (type) {
+    case SYSDB_USER:
+        base_tmpl = SYSDB_TMPL_USER_BASE;
+        class_filter = SYSDB_UC;
+        break;
+    case SYSDB_GROUP:
+        base_tmpl = SYSDB_TMPL_GROUP_BASE;
+        class_filter = SYSDB_GC;
+        break;
+    default:
+        return EINVAL;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    basedn = ldb_dn_new_fmt(tmp_ctx, domain->sysdb->ldb,
+                            base_tmpl, domain->name);
+    if (basedn == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    filter = talloc_asprintf(tmp_ctx, "(&(%s)(|", class_filter);
+    if (filter == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    for (i = 0; i < num_names; i++) {
+        ret = sss_filter_sanitize_for_dom(tmp_ctx, names[i], domain,
+                                          &sanitized_name,
+                                          &lc_sanitized_name);
+        if (ret != EOK) {
+            goto done;
+        }
+
+        filter = talloc_asprintf_append_buffer(filter,
+                                               "(%s=%s)(%s=%s)(%s=%s)",
+                                               SYSDB_NAME_ALIAS,
+                                               lc_sanitized_name,
+                                               SYSDB_NAME_ALIAS,
+                                               sanitized_name,
+                                               SYSDB_NAME, sanitized_name);
+        if (filter == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+    }
+
+    filter = talloc_asprintf_append_buffer(filter, "))");
+    if (filter == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sysdb_search_entry(tmp_ctx, domain->sysdb, basedn, LDB_SCOPE_SUBTREE,
+                             filter, attrs, &msgs_count, &msgs);
+    if (ret == ENOENT) {
+        msgs_count = 0;
+    } else if (ret != EOK) {
+        goto done;
+    }
+
+    cached = talloc_zero_array(tmp_ctx, struct ldb_message *, num_names);
+    if (cached == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    for (i = 0; i < num_names; i++) {
+        if (domain->case_sensitive) {
+            lc_name = names[i];
+        } else {
+            lc_name = sss_tc_utf8_str_tolower(tmp_ctx, names[i]);
+            if (lc_name == NULL) {
+                ret = ENOMEM;
+                goto done;
+            }
+        }
+
+        for (j = 0; j < msgs_count; j++) {
+            if (sysdb_batch_msg_matches(msgs[j], names[i], lc_name)) {
+                cached[i] = talloc_steal(cached, msgs[j]);
+                break;
+            }
+        }
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, "Found %zu of %zu objects in the cache\n",
+          msgs_count, num_names);
+
+    *_cached = talloc_steal(mem_ctx, cached);
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+/* Returns how the object at position idx of a chunk is to be stored. Names
+ * that appear more than once in the chunk are looked up again, because the
+ * first store may have already added the object. */
+static enum sysdb_store_lookup
+sysdb_batch_lookup_state(struct sss_domain_info *domain,
+                         struct ldb_message **cached,
+                         const char **names,
+                         size_t idx)
+{
+    size_t i;
+
+    if (cached == NULL) {
+        return SYSDB_STORE_LOOKUP;
+    }
+
+    for (i = 0; i < idx; i++) {
+        if (sss_string_equal(domain->case_sensitive, names[i], names[idx])) {
+            return SYSDB_STORE_LOOKUP;
+        }
+    }
+
+    return cached[idx] != NULL ? SYSDB_STORE_EXISTING : SYSDB_STORE_NEW;
+}
+
+errno_t sysdb_store_users_batch(struct sysdb_ctx *sysdb,
+                                struct sysdb_user_batch_entry *users,
+                                size_t num_users,
+                                time_t now)
+{
+    TALLOC_CTX *tmp_ctx;
+    static const char *attrs[] = { SYSDB_NAME, SYSDB_NAME_ALIAS, NULL };
+    struct sysdb_user_batch_entry *user;
+    struct ldb_message **cached;
+    enum sysdb_store_lookup lookup;
+    const char **names;
+    bool in_transaction = false;
+    size_t start;
+    size_t count;
+    size_t i;
+    errno_t ret;
+    errno_t sret;
+
+    if (num_users == 0) {
+        return EOK;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    names = talloc_array(tmp_ctx, const char *, SYSDB_STORE_BATCH_SIZE);
+    if (names == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    if (!now) {
+        now = time(NULL);
+    }
+
+    ret = sysdb_transaction_start(sysdb);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to start transaction\n");
+        goto done;
+    }
+    in_transaction = true;
+
+    for (start = 0; start < num_users; start += count) {
+        /* a chunk consists of consecutive users of the same domain */
+        for (count = 0; count < SYSDB_STORE_BATCH_SIZE
+                        && start + count < num_users
+                        && users[start + count].domain == users[start].domain;
+             count++) {
+            names[count] = users[start + count].name;
+        }
+
+        ret = sysdb_batch_search_by_name(tmp_ctx, users[start].domain,
+                                         SYSDB_USER, names, count, attrs,
+                                         &cached);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Batch search failed [%d]: %s, looking up users one by "
+                  "one\n", ret, sss_strerror(ret));
+            cached = NULL;
+        }
+
+        for (i = 0; i < count; i++) {
+            user = &users[start + i];
+            lookup = sysdb_batch_lookup_state(user->domain, cached, names, i);
+
+            user->ret = sysdb_store_user_int(user->domain, user->name,
+                                             user->pwd, user->uid, user->gid,
+                                             user->gecos, user->homedir,
+                                             user->shell, user->orig_dn,
+                                             user->attrs, user->remove_attrs,
+                                             user->cache_timeout, now, lookup);
+            if (user->ret == ENOENT && lookup == SYSDB_STORE_EXISTING) {
+                /* the user was removed by a rename earlier in the batch */
+                user->ret = sysdb_store_user_int(user->domain, user->name,
+                                                 user->pwd, user->uid,
+                                                 user->gid, user->gecos,
+                                                 user->homedir, user->shell,
+                                                 user->orig_dn, user->attrs,
+                                                 user->remove_attrs,
+                                                 user->cache_timeout, now,
+                                                 SYSDB_STORE_LOOKUP);
+            }
+            if (user->ret != EOK) {
+                DEBUG(SSSDBG_MINOR_FAILURE, "Failed to store user %s\n",
+                      user->name);
+            }
+        }
+
+        talloc_zfree(cached);
+    }
+
+    ret = sysdb_transaction_commit(sysdb);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to commit transaction\n");
+        goto done;
+    }
+    in_transaction = false;
+
+done:
+    if (in_transaction) {
+        sret = sysdb_transaction_cancel(sysdb);
+        if (sret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Could not cancel transaction\n");
+        }
+    }
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static int sysdb_batch_val_cmp(const void *a, const void *b)
+{
+    const struct ldb_val *va = (const struct ldb_val *) a;
+    const struct ldb_val *vb = (const struct ldb_val *) b;
+
+    if (va->length != vb->length) {
+        return va->length < vb->length ? -1 : 1;
+    }
+
+    return memcmp(va->data, vb->data, va->length);
+}
+
+/* Removes attr_name from attrs if the new values are the same as the cached
+ * ones, replacing them would only make the memberof plugin walk the
+ * memberships of the group again. */
+static void sysdb_batch_drop_unchanged(struct sysdb_attrs *attrs,
+                                       struct ldb_message *cached,
+                                       const char *attr_name)
+{
+    struct ldb_message_element *new_el = NULL;
+    struct ldb_message_element *old_el;
+    unsigned int num_old;
+    unsigned int i;
+    int idx;
+
+    if (attrs == NULL) {
+        return;
+    }
+
+    for (idx = 0; idx < attrs->num; idx++) {
+        if (strcasecmp(attrs->a[idx].name, attr_name) == 0) {
+            new_el = &attrs->a[idx];
+            break;
+        }
+    }
+    if (new_el == NULL) {
+        return;
+    }
+
+    old_el = ldb_msg_find_element(cached, attr_name);
+    num_old = old_el != NULL ? old_el->num_values : 0;
+    if (new_el->num_values != num_old) {
+        return;
+    }
+
+    if (num_old != 0) {
+        qsort(new_el->values, new_el->num_values, sizeof(struct ldb_val),
+              sysdb_batch_val_cmp);
+        qsort(old_el->values, old_el->num_values, sizeof(struct ldb_val),
+              sysdb_batch_val_cmp);
+
+        for (i = 0; i < num_old; i++) {
+            if (sysdb_batch_val_cmp(&new_el->values[i],
+                                    &old_el->values[i]) != 0) {
+                return;
+            }
+        }
+    }
+
+    attrs->num--;
+    memmove(&attrs->a[idx], &attrs->a[idx + 1],
+            (attrs->num - idx) * sizeof(struct ldb_message_element));
+}
+
+errno_t sysdb_store_groups_batch(struct sysdb_ctx *sysdb,
+                                 struct sysdb_group_batch_entry *groups,
+                                 size_t num_groups,
+                                 time_t now)
+{
+    TALLOC_CTX *tmp_ctx;
+    static const char *attrs[] = { SYSDB_NAME, SYSDB_NAME_ALIAS,
+                                   SYSDB_MEMBER, SYSDB_GHOST, NULL };
+    struct sysdb_group_batch_entry *group;
+    struct ldb_message **cached;
+    enum sysdb_store_lookup lookup;
+    const char **names;
+    bool in_transaction = false;
+    size_t start;
+    size_t count;
+    size_t i;
+    errno_t ret;
+    errno_t sret;
+
+    if (num_groups == 0) {
+        return EOK;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    names = talloc_array(tmp_ctx, const char *, SYSDB_STORE_BATCH_SIZE);
+    if (names == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    if (!now) {
+        now = time(NULL);
+    }
+
+    ret = sysdb_transaction_start(sysdb);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to start transaction\n");
+        goto done;
+    }
+    in_transaction = true;
+
+    for (start = 0; start < num_groups; start += count) {
+        /* a chunk consists of consecutive groups of the same domain */
+        for (count = 0; count < SYSDB_STORE_BATCH_SIZE
+                        && start + count < num_groups
+                        && groups[start + count].domain == groups[start].domain;
+             count++) {
+            names[count] = groups[start + count].name;
+        }
+
+        ret = sysdb_batch_search_by_name(tmp_ctx, groups[start].domain,
+                                         SYSDB_GROUP, names, count, attrs,
+                                         &cached);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Batch search failed [%d]: %s, looking up groups one by "
+                  "one\n", ret, sss_strerror(ret));
+            cached = NULL;
+        }
+
+        for (i = 0; i < count; i++) {
+            group = &groups[start + i];
+            lookup = sysdb_batch_lookup_state(group->domain, cached, names, i);
+
+            if (lookup == SYSDB_STORE_EXISTING) {
+                sysdb_batch_drop_unchanged(group->attrs, cached[i],
+                                           SYSDB_MEMBER);
+                sysdb_batch_drop_unchanged(group->attrs, cached[i],
+                                           SYSDB_GHOST);
+            }
+
+            group->ret = sysdb_store_group_int(group->domain, group->name,
+                                               group->gid, group->attrs,
+                                               group->cache_timeout, now,
+                                               lookup);
+            if (group->ret == ENOENT && lookup == SYSDB_STORE_EXISTING) {
+                /* the group was removed by a rename earlier in the batch */
+                group->ret = sysdb_store_group_int(group->domain, group->name,
+                                                   group->gid, group->attrs,
+                                                   group->cache_timeout, now,
+                                                   SYSDB_STORE_LOOKUP);
+            }
+            if (group->ret != EOK) {
+                DEBUG(SSSDBG_MINOR_FAILURE, "Failed to store group %s\n",
+                      group->name);
+            }
+        }
+
+        talloc_zfree(cached);
+    }
+
+    ret = sysdb_transaction_commit(sysdb);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to commit transaction\n");
+        goto done;
+    }
+    in_transaction = false;
+
+done:
+    if (in_transaction) {
+        sret = sysdb_transaction_cancel(sysdb);
+        if (sret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Could not cancel transaction\n");
+        }
+    }
+    talloc_free(tmp_ctx);
+    return ret;
+}
 
 /* =Add-User-to-Group(Native/Legacy)====================================== */
 static int
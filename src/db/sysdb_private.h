@@ -23,6 +23,7 @@
 #ifndef __INT_SYS_DB_H__
 #define __INT_SYS_DB_H__
 
+#define SYSDB_VERSION_0_18 "0.18"
 #define SYSDB_VERSION_0_17 "0.17"
 #define SYSDB_VERSION_0_16 "0.16"
 #define SYSDB_VERSION_0_15 "0.15"
@@ -41,7 +42,10 @@
 #define SYSDB_VERSION_0_2 "0.2"
 #define SYSDB_VERSION_0_1 "0.1"
 
-#define SYSDB_VERSION SYSDB_VERSION_0_17
+#define SYSDB_VERSION SYSDB_VERSION_0_18
+
+/* ldb modules of the cache, the @MODULES record */
+#define SYSDB_MODULES_LIST "asq,memberof"
 
 #define SYSDB_BASE_LDIF \
      "dn: @ATTRIBUTES\n" \
@@ -70,10 +74,15 @@
      "@IDXATTR: sudoUser\n" \
      "@IDXATTR: sshKnownHostsExpire\n" \
      "@IDXATTR: objectSIDString\n" \
+     "@IDXATTR: userPrincipalName\n" \
+     "@IDXATTR: canonicalUserPrincipalName\n" \
+     "@IDXATTR: uniqueID\n" \
+     "@IDXATTR: userCertificate\n" \
+     "@IDXATTR: ghost\n" \
      "@IDXONE: 1\n" \
      "\n" \
      "dn: @MODULES\n" \
-     "@LIST: asq,memberof\n" \
+     "@LIST: " SYSDB_MODULES_LIST "\n" \
      "\n" \
      "dn: cn=sysdb\n" \
      "cn: sysdb\n" \
@@ -97,6 +106,14 @@ int sysdb_get_db_file(TALLOC_CTX *mem_ctx,
                       const char *base_path, char **_ldb_file);
 errno_t sysdb_ldb_connect(TALLOC_CTX *mem_ctx, const char *filename,
                           struct ldb_context **_ldb);
+errno_t sysdb_ldb_connect_ex(TALLOC_CTX *mem_ctx, const char *filename,
+                             bool log_full_scans, struct ldb_context **_ldb);
+
+/* Loads a module in front of the cache modules that logs every search
+ * ldb had to answer without an index. Returns the ldb_connect() options
+ * that enable it. */
+errno_t sysdb_trace_init(struct ldb_context *ldb, const char ***_options);
+
 int sysdb_domain_init_internal(TALLOC_CTX *mem_ctx,
                                struct sss_domain_info *domain,
                                const char *db_path,
@@ -123,6 +140,7 @@ int sysdb_upgrade_13(struct sysdb_ctx *sysdb, const char **ver);
 int sysdb_upgrade_14(struct sysdb_ctx *sysdb, const char **ver);
 int sysdb_upgrade_15(struct sysdb_ctx *sysdb, const char **ver);
 int sysdb_upgrade_16(struct sysdb_ctx *sysdb, const char **ver);
+int sysdb_upgrade_17(struct sysdb_ctx *sysdb, const char **ver);
 
 int add_string(struct ldb_message *msg, int flags,
                const char *attr, const char *value);
@@ -427,6 +427,150 @@ int sysdb_enumpwent_with_views(TALLOC_CTX *mem_ctx,
     return sysdb_enumpwent_filter_with_views(mem_ctx, domain, NULL, NULL, _res);
 }
 
+int sysdb_enumpwent_names(TALLOC_CTX *mem_ctx,
+                          struct sss_domain_info *domain,
+                          const char ***_names,
+                          size_t *_count)
+{
+    TALLOC_CTX *tmp_ctx;
+    static const char *attrs[] = { SYSDB_NAME, NULL };
+    struct ldb_dn *base_dn;
+    struct ldb_result *res;
+    const char **names;
+    const char *name;
+    size_t count;
+    size_t c;
+    int ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    base_dn = sysdb_user_base_dn(tmp_ctx, domain);
+    if (base_dn == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = ldb_search(domain->sysdb->ldb, tmp_ctx, &res, base_dn,
+                     LDB_SCOPE_SUBTREE, attrs, "%s", SYSDB_PWENT_FILTER);
+    if (ret) {
+        ret = sysdb_error_to_errno(ret);
+        goto done;
+    }
+
+    names = talloc_array(tmp_ctx, const char *, res->count + 1);
+    if (names == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    count = 0;
+    for (c = 0; c < res->count; c++) {
+        name = ldb_msg_find_attr_as_string(res->msgs[c], SYSDB_NAME, NULL);
+        if (name == NULL) {
+            DEBUG(SSSDBG_MINOR_FAILURE, "User [%s] has no name, skipping.\n",
+                  ldb_dn_get_linearized(res->msgs[c]->dn));
+            continue;
+        }
+
+        names[count] = talloc_strdup(names, name);
+        if (names[count] == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+        count++;
+    }
+    names[count] = NULL;
+
+    *_names = talloc_steal(mem_ctx, names);
+    *_count = count;
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+int sysdb_enumpwent_page_with_views(TALLOC_CTX *mem_ctx,
+                                    struct sss_domain_info *domain,
+                                    const char **names,
+                                    size_t count,
+                                    struct ldb_result **_res)
+{
+    TALLOC_CTX *tmp_ctx;
+    static const char *attrs[] = SYSDB_PW_ATTRS;
+    struct ldb_result *page;
+    struct ldb_result *res;
+    struct ldb_dn *dn;
+    size_t c;
+    int ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    page = talloc_zero(tmp_ctx, struct ldb_result);
+    if (page == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    page->msgs = talloc_array(page, struct ldb_message *, count + 1);
+    if (page->msgs == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    for (c = 0; c < count; c++) {
+        dn = sysdb_user_dn(tmp_ctx, domain, names[c]);
+        if (dn == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        ret = ldb_search(domain->sysdb->ldb, tmp_ctx, &res, dn,
+                         LDB_SCOPE_BASE, attrs, "%s", SYSDB_PWENT_FILTER);
+        talloc_free(dn);
+        if (ret == LDB_ERR_NO_SUCH_OBJECT) {
+            /* removed since the list of names was read */
+            continue;
+        } else if (ret != LDB_SUCCESS) {
+            ret = sysdb_error_to_errno(ret);
+            goto done;
+        }
+
+        if (res->count == 0) {
+            talloc_free(res);
+            continue;
+        }
+
+        if (DOM_HAS_VIEWS(domain)) {
+            ret = sysdb_add_overrides_to_object(domain, res->msgs[0], NULL,
+                                                NULL);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_OP_FAILURE,
+                      "sysdb_add_overrides_to_object failed.\n");
+                goto done;
+            }
+        }
+
+        page->msgs[page->count] = talloc_steal(page->msgs, res->msgs[0]);
+        page->count++;
+        talloc_free(res);
+    }
+    page->msgs[page->count] = NULL;
+
+    *_res = talloc_steal(mem_ctx, page);
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
 /* groups */
 
 static int mpg_convert(struct ldb_message *msg)
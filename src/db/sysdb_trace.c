@@ -0,0 +1,204 @@
+/*
+   SSSD
+
+   System Database - logging of searches without an index
+
+   Copyright (C) 2016 Red Hat
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <ldb_module.h>
+
+#include "util/util.h"
+#include "db/sysdb_private.h"
+
+/* ldb_tdb reports every search it could not answer from an index with this
+ * warning when LDB_WARN_UNINDEXED is set in the environment */
+#define LDB_WARN_UNINDEXED "LDB_WARN_UNINDEXED"
+#define LDB_FULL_SEARCH_MSG "ldb FULL SEARCH"
+
+#define SYSDB_TRACE_MODULE "sysdb_trace"
+
+struct sysdb_trace {
+    /* set when the running search fell back to a full scan */
+    bool full_scan;
+};
+
+struct sysdb_trace_search_ctx {
+    struct sysdb_trace *trace;
+    struct ldb_request *req;
+    struct timeval start;
+    unsigned int count;
+};
+
+static void sysdb_trace_ldb_debug(void *context, enum ldb_debug_level level,
+                                  const char *fmt, va_list ap)
+{
+    struct sysdb_trace *trace = talloc_get_type(context, struct sysdb_trace);
+
+    if (strncmp(fmt, LDB_FULL_SEARCH_MSG,
+                sizeof(LDB_FULL_SEARCH_MSG) - 1) == 0) {
+        trace->full_scan = true;
+    }
+
+    ldb_debug_messages(NULL, level, fmt, ap);
+}
+
+static void sysdb_trace_report(struct sysdb_trace_search_ctx *ctx)
+{
+    struct ldb_request *req = ctx->req;
+    struct timeval now;
+    struct timeval diff;
+    char *filter;
+
+    now = tevent_timeval_current();
+    diff = tevent_timeval_until(&ctx->start, &now);
+
+    filter = ldb_filter_from_tree(ctx, req->op.search.tree);
+
+    DEBUG(SSSDBG_IMPORTANT_INFO,
+          "Full cache scan for [%s] under [%s] took %ld.%06ld seconds "
+          "and returned %u entries\n",
+          filter ? filter : "unknown filter",
+          ldb_dn_get_linearized(req->op.search.base),
+          (long) diff.tv_sec, (long) diff.tv_usec, ctx->count);
+
+    talloc_free(filter);
+}
+
+static int sysdb_trace_search_callback(struct ldb_request *req,
+                                       struct ldb_reply *ares)
+{
+    struct sysdb_trace_search_ctx *ctx;
+
+    ctx = talloc_get_type(req->context, struct sysdb_trace_search_ctx);
+
+    if (ares == NULL) {
+        return ldb_module_done(ctx->req, NULL, NULL,
+                               LDB_ERR_OPERATIONS_ERROR);
+    }
+
+    if (ares->error != LDB_SUCCESS) {
+        return ldb_module_done(ctx->req, ares->controls,
+                               ares->response, ares->error);
+    }
+
+    switch (ares->type) {
+    case LDB_REPLY_ENTRY:
+        ctx->count++;
+        return ldb_module_send_entry(ctx->req, ares->message, ares->controls);
+    case LDB_REPLY_REFERRAL:
+        return ldb_module_send_referral(ctx->req, ares->referral);
+    case LDB_REPLY_DONE:
+        if (ctx->trace->full_scan) {
+            sysdb_trace_report(ctx);
+        }
+        return ldb_module_done(ctx->req, ares->controls,
+                               ares->response, LDB_SUCCESS);
+    }
+
+    talloc_free(ares);
+    return LDB_SUCCESS;
+}
+
+static int sysdb_trace_search(struct ldb_module *module,
+                              struct ldb_request *req)
+{
+    struct ldb_context *ldb = ldb_module_get_ctx(module);
+    struct sysdb_trace_search_ctx *ctx;
+    struct ldb_request *down_req;
+    int ret;
+
+    ctx = talloc_zero(req, struct sysdb_trace_search_ctx);
+    if (ctx == NULL) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+
+    ctx->trace = talloc_get_type(ldb_get_opaque(ldb, SYSDB_TRACE_MODULE),
+                                 struct sysdb_trace);
+    if (ctx->trace == NULL) {
+        talloc_free(ctx);
+        return ldb_next_request(module, req);
+    }
+    ctx->req = req;
+
+    ret = ldb_build_search_req_ex(&down_req, ldb, ctx,
+                                  req->op.search.base,
+                                  req->op.search.scope,
+                                  req->op.search.tree,
+                                  req->op.search.attrs,
+                                  req->controls,
+                                  ctx, sysdb_trace_search_callback,
+                                  req);
+    if (ret != LDB_SUCCESS) {
+        return ret;
+    }
+
+    ctx->trace->full_scan = false;
+    ctx->start = tevent_timeval_current();
+
+    return ldb_next_request(module, down_req);
+}
+
+static const struct ldb_module_ops sysdb_trace_module_ops = {
+    .name = SYSDB_TRACE_MODULE,
+    .search = sysdb_trace_search,
+};
+
+errno_t sysdb_trace_init(struct ldb_context *ldb, const char ***_options)
+{
+    static const char *options[] = {
+        "modules:" SYSDB_TRACE_MODULE "," SYSDB_MODULES_LIST,
+        NULL
+    };
+    struct sysdb_trace *trace;
+    int ret;
+
+    ret = ldb_register_module(&sysdb_trace_module_ops);
+    if (ret != LDB_SUCCESS && ret != LDB_ERR_ENTRY_ALREADY_EXISTS) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Cannot register the trace module\n");
+        return sysdb_error_to_errno(ret);
+    }
+
+    trace = talloc_zero(ldb, struct sysdb_trace);
+    if (trace == NULL) {
+        return ENOMEM;
+    }
+
+    ret = ldb_set_opaque(ldb, SYSDB_TRACE_MODULE, trace);
+    if (ret != LDB_SUCCESS) {
+        talloc_free(trace);
+        return sysdb_error_to_errno(ret);
+    }
+
+    ret = ldb_set_debug(ldb, sysdb_trace_ldb_debug, trace);
+    if (ret != LDB_SUCCESS) {
+        return EIO;
+    }
+
+    /* read by the tdb backend when the database is opened */
+    if (setenv(LDB_WARN_UNINDEXED, "1", 0) != 0) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "setenv failed [%d]: %s\n",
+              ret, sss_strerror(ret));
+        return ret;
+    }
+
+    /* the module list replaces the one stored in @MODULES */
+    *_options = options;
+
+    return EOK;
+}
@@ -73,14 +73,23 @@ struct mbof_add_operation {
 struct mbof_memberuid_op {
     struct ldb_dn *dn;
     struct ldb_message_element *el;
+
+    /* values already in el, so that big groups are deduplicated in
+     * constant time per value */
+    hash_table_t *vals;
 };
 
 struct mbof_add_ctx {
     struct mbof_ctx *ctx;
 
     struct mbof_add_operation *add_list;
+    struct mbof_add_operation *add_tail;
     struct mbof_add_operation *current_op;
 
+    /* every entry of the member graph reached by this operation, keyed by
+     * the casefolded DN, each one is looked up and modified only once */
+    hash_table_t *add_table;
+
     struct ldb_message *msg;
     struct ldb_dn *msg_dn;
     bool terminate;
@@ -123,7 +132,9 @@ struct mbof_del_ctx {
     struct mbof_ctx *ctx;
 
     struct mbof_del_operation *first;
-    struct mbof_dn *history;
+
+    /* entries already processed, keyed by the casefolded DN */
+    hash_table_t *history;
 
     struct ldb_message **mus;
     int num_mus;
@@ -238,7 +249,10 @@ static int mbof_append_muop(TALLOC_CTX *memctx,
     int num_muops = *_num_muops;
     struct mbof_memberuid_op *op;
     struct ldb_val *val;
+    hash_key_t key;
+    hash_value_t value;
     int i;
+    int ret;
 
     op = NULL;
     if (muops) {
@@ -263,6 +277,7 @@ static int mbof_append_muop(TALLOC_CTX *memctx,
 
         op->dn = parent;
         op->el = NULL;
+        op->vals = NULL;
     }
 
     if (!op->el) {
@@ -275,15 +290,27 @@ static int mbof_append_muop(TALLOC_CTX *memctx,
             return LDB_ERR_OPERATIONS_ERROR;
         }
         op->el->flags = flags;
-    }
 
-    for (i = 0; i < op->el->num_values; i++) {
-        if (strcmp((char *)op->el->values[i].data, name) == 0) {
-            /* we already have this value, get out*/
-            return LDB_SUCCESS;
+        ret = hash_create_ex(32, &op->vals, 0, 0, 0, 0,
+                             hash_alloc, hash_free, op->el, NULL, NULL);
+        if (ret != HASH_SUCCESS) {
+            return LDB_ERR_OPERATIONS_ERROR;
         }
     }
 
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(name);
+    if (hash_has_key(op->vals, &key)) {
+        /* we already have this value, get out*/
+        return LDB_SUCCESS;
+    }
+
+    value.type = HASH_VALUE_UNDEF;
+    ret = hash_enter(op->vals, &key, &value);
+    if (ret != HASH_SUCCESS) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+
     val = talloc_realloc(op->el, op->el->values,
                          struct ldb_val, op->el->num_values + 1);
     if (!val) {
@@ -347,25 +374,33 @@ static int mbof_append_addop(struct mbof_add_ctx *add_ctx,
                              struct mbof_dn_array *parents,
                              struct ldb_dn *entry_dn)
 {
-    struct mbof_add_operation *lastop = NULL;
     struct mbof_add_operation *addop;
+    hash_key_t key;
+    hash_value_t value;
+    const char *casefold;
+    int ret;
 
-    /* test if this is a duplicate */
-    /* FIXME: this is not efficient */
-    if (add_ctx->add_list) {
-        do {
-            if (lastop) {
-                lastop = lastop->next;
-            } else {
-                lastop = add_ctx->add_list;
-            }
+    if (add_ctx->add_table == NULL) {
+        ret = hash_create_ex(32, &add_ctx->add_table, 0, 0, 0, 0,
+                             hash_alloc, hash_free, add_ctx, NULL, NULL);
+        if (ret != HASH_SUCCESS) {
+            return LDB_ERR_OPERATIONS_ERROR;
+        }
+    }
 
-            /* FIXME: check if this is right, might have to compare parents */
-            if (ldb_dn_compare(lastop->entry_dn, entry_dn) == 0) {
-                /* duplicate found */
-                return LDB_SUCCESS;
-            }
-        } while (lastop->next);
+    casefold = ldb_dn_get_casefold(entry_dn);
+    if (casefold == NULL) {
+        return LDB_ERR_INVALID_DN_SYNTAX;
+    }
+
+    /* test if this is a duplicate, comparing the parents is not needed:
+     * a parent is only left out on a path when a group on it is already
+     * a memberof that parent, and so are all members of that group */
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(casefold);
+    if (hash_has_key(add_ctx->add_table, &key)) {
+        /* duplicate found */
+        return LDB_SUCCESS;
     }
 
     addop = talloc_zero(add_ctx, struct mbof_add_operation);
@@ -377,11 +412,20 @@ static int mbof_append_addop(struct mbof_add_ctx *add_ctx,
     addop->parents = parents;
     addop->entry_dn = entry_dn;
 
-    if (add_ctx->add_list) {
-        lastop->next = addop;
+    value.type = HASH_VALUE_PTR;
+    value.ptr = addop;
+    ret = hash_enter(add_ctx->add_table, &key, &value);
+    if (ret != HASH_SUCCESS) {
+        talloc_free(addop);
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+
+    if (add_ctx->add_tail) {
+        add_ctx->add_tail->next = addop;
     } else {
         add_ctx->add_list = addop;
     }
+    add_ctx->add_tail = addop;
 
     return LDB_SUCCESS;
 }
@@ -2384,23 +2428,32 @@ static int mbof_del_get_next(struct mbof_del_operation *delop,
 {
     struct mbof_del_operation *top, *cop;
     struct mbof_del_ctx *del_ctx;
-    struct mbof_dn *save, *tmp;
+    const char *casefold;
+    hash_key_t key;
+    hash_value_t value;
+    int ret;
 
     del_ctx = delop->del_ctx;
 
+    if (del_ctx->history == NULL) {
+        ret = hash_create_ex(32, &del_ctx->history, 0, 0, 0, 0,
+                             hash_alloc, hash_free, del_ctx, NULL, NULL);
+        if (ret != HASH_SUCCESS) {
+            return LDB_ERR_OPERATIONS_ERROR;
+        }
+    }
+
     /* first of all, save the current delop in the history */
-    save = talloc_zero(del_ctx, struct mbof_dn);
-    if (!save) {
+    casefold = ldb_dn_get_casefold(delop->entry_dn);
+    if (casefold == NULL) {
         return LDB_ERR_OPERATIONS_ERROR;
     }
-    save->dn = delop->entry_dn;
-
-    if (del_ctx->history) {
-        tmp = del_ctx->history;
-        while (tmp->next) tmp = tmp->next;
-        tmp->next = save;
-    } else {
-        del_ctx->history = save;
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(casefold);
+    value.type = HASH_VALUE_UNDEF;
+    ret = hash_enter(del_ctx->history, &key, &value);
+    if (ret != HASH_SUCCESS) {
+        return LDB_ERR_OPERATIONS_ERROR;
     }
 
     /* Find next one */
@@ -2415,12 +2468,12 @@ static int mbof_del_get_next(struct mbof_del_operation *delop,
             top->next_child++;
 
             /* verify this operation has not already been performed */
-            for (tmp = del_ctx->history; tmp; tmp = tmp->next) {
-                if (ldb_dn_compare(tmp->dn, cop->entry_dn) == 0) {
-                    break;
-                }
+            casefold = ldb_dn_get_casefold(cop->entry_dn);
+            if (casefold == NULL) {
+                return LDB_ERR_OPERATIONS_ERROR;
             }
-            if (tmp == NULL) {
+            key.str = discard_const(casefold);
+            if (!hash_has_key(del_ctx->history, &key)) {
                 /* and return the current one */
                 *nextop = cop;
                 return LDB_SUCCESS;
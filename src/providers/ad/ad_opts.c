@@ -147,6 +147,11 @@ struct dp_option ad_def_ldap_opts[] = {
     { "ldap_max_id", DP_OPT_NUMBER, NULL_NUMBER, NULL_NUMBER},
     { "ldap_pwdlockout_dn", DP_OPT_STRING, NULL_STRING, NULL_STRING },
     { "wildcard_limit", DP_OPT_NUMBER, { .number = 1000 }, NULL_NUMBER},
+    { "ldap_nested_group_parallel_lookups", DP_OPT_NUMBER, { .number = 8 }, NULL_NUMBER },
+    { "ldap_nested_group_batch_size", DP_OPT_NUMBER, { .number = 50 }, NULL_NUMBER },
+    { "ldap_use_syncrepl", DP_OPT_BOOL, BOOL_FALSE, BOOL_FALSE },
+    { "ldap_connection_pool_size", DP_OPT_NUMBER, { .number = 1 }, NULL_NUMBER },
+    { "ldap_connection_pool_max_ops", DP_OPT_NUMBER, { .number = 0 }, NULL_NUMBER },
     DP_OPTION_TERMINATOR
 };
 
@@ -171,6 +176,8 @@ struct dp_option ad_def_krb5_opts[] = {
     { "krb5_use_enterprise_principal", DP_OPT_BOOL, BOOL_TRUE, BOOL_TRUE },
     { "krb5_use_kdcinfo", DP_OPT_BOOL, BOOL_TRUE, BOOL_TRUE },
     { "krb5_map_user", DP_OPT_STRING, NULL_STRING, NULL_STRING },
+    { "krb5_child_pool_size", DP_OPT_NUMBER, { .number = 0 }, NULL_NUMBER },
+    { "krb5_child_pool_max_requests", DP_OPT_NUMBER, { .number = 100 }, NULL_NUMBER },
     DP_OPTION_TERMINATOR
 };
 
@@ -48,6 +48,7 @@
 
 #define DATA_PROVIDER_VERSION 0x0001
 #define DATA_PROVIDER_PIPE "private/sbus-dp"
+#define DATA_PROVIDER_FRAME_PIPE "private/frame-dp"
 
 #define DP_PATH "/org/freedesktop/sssd/dataprovider"
 
@@ -233,6 +234,8 @@ void dp_id_callback(DBusPendingCall *pending, void *ptr);
 /* from dp_sbus.c */
 int dp_get_sbus_address(TALLOC_CTX *mem_ctx,
                         char **address, const char *domain_name);
+int dp_get_frame_address(TALLOC_CTX *mem_ctx,
+                         char **address, const char *domain_name);
 
 
 /* Helpers */
@@ -331,6 +334,7 @@ enum dp_res_opts {
     DP_RES_OPT_RESOLVER_TIMEOUT,
     DP_RES_OPT_RESOLVER_OP_TIMEOUT,
     DP_RES_OPT_DNS_DOMAIN,
+    DP_RES_OPT_CACHE_TIMEOUT,
 
     DP_RES_OPTS /* attrs counter */
 };
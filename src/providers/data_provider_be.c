@@ -38,6 +38,7 @@
 
 #include "util/util.h"
 #include "util/sss_utf8.h"
+#include "util/sss_latency.h"
 #include "confdb/confdb.h"
 #include "db/sysdb.h"
 #include "sbus/sssd_dbus.h"
@@ -159,6 +160,8 @@ static const char *safe_be_req_err_msg(const char *msg_in,
 #define REQ_PHASE_ACCESS 0
 #define REQ_PHASE_SELINUX 1
 
+struct be_acct_inflight;
+
 struct be_req {
     struct be_client *becli;
     struct be_ctx *be_ctx;
@@ -177,6 +180,14 @@ struct be_req {
     /* Just for nicer debugging */
     const char *req_name;
 
+    /* Identical account requests waiting for this one */
+    struct be_acct_inflight *inflight;
+
+    /* latency tracing */
+    uint32_t rid;
+    struct timeval created;
+    struct timeval started;
+
     struct be_req *prev;
     struct be_req *next;
 };
@@ -205,6 +216,8 @@ struct be_req *be_req_create(TALLOC_CTX *mem_ctx,
     be_req->domain = be_ctx->domain;
     be_req->fn = fn;
     be_req->pvt = pvt_fn_data;
+    be_req->rid = sss_latency_current_rid();
+    sss_latency_start(&be_req->created);
     be_req->req_name = talloc_strdup(be_req, name);
     if (be_req->req_name == NULL) {
         talloc_free(be_req);
@@ -250,6 +263,8 @@ void be_req_terminate(struct be_req *be_req,
                       int dp_err_type, int errnum, const char *errstr)
 {
     if (be_req->fn == NULL) return;
+    sss_latency_record(be_req->rid, SSS_LATENCY_BE_REQUEST,
+                       &be_req->started);
     be_req->fn(be_req, dp_err_type, errnum, errstr);
 }
 
@@ -309,6 +324,11 @@ static errno_t be_sbus_req_reply(struct sbus_request *sbus_req,
     return be_sbus_reply(sbus_req, err_maj, err_min, errstr);
 }
 
+static void be_acct_inflight_reply(struct be_acct_inflight *inflight,
+                                   int dp_err_type,
+                                   int errnum,
+                                   const char *errstr);
+
 static void be_req_default_callback(struct be_req *be_req,
                                     int dp_err_type,
                                     int errnum,
@@ -321,6 +341,9 @@ static void be_req_default_callback(struct be_req *be_req,
     dbus_req = (struct sbus_request *) be_req->pvt;
 
     be_sbus_req_reply(dbus_req, dp_err_type, errnum, errstr);
+    if (be_req->inflight != NULL) {
+        be_acct_inflight_reply(be_req->inflight, dp_err_type, errnum, errstr);
+    }
     talloc_free(be_req);
 }
 
@@ -413,10 +436,19 @@ static void be_async_req_handler(struct tevent_context *ev,
                                  struct timeval tv, void *pvt)
 {
     struct be_async_req *async_req;
+    struct be_req *be_req;
+    uint32_t prev_rid;
 
     async_req = talloc_get_type(pvt, struct be_async_req);
+    be_req = async_req->req;
 
-    async_req->fn(async_req->req);
+    sss_latency_record(be_req->rid, SSS_LATENCY_BE_QUEUE, &be_req->created);
+    sss_latency_start(&be_req->started);
+
+    /* the handler may free the request */
+    prev_rid = sss_latency_set_current(be_req->rid);
+    async_req->fn(be_req);
+    sss_latency_set_current(prev_rid);
 }
 
 struct be_spy {
@@ -968,6 +1000,59 @@ done:
     }
 }
 
+static void be_invalidate_memcache_entry_done(DBusPendingCall *pending,
+                                              void *ptr)
+{
+    dbus_pending_call_unref(pending);
+}
+
+errno_t be_invalidate_memcache_entry(struct be_ctx *be_ctx, uint32_t type,
+                                     const char *domain, const char *name)
+{
+    DBusMessage *msg;
+    dbus_bool_t dbret;
+    errno_t ret;
+
+    if (!be_ctx->nss_cli || !be_ctx->nss_cli->conn) {
+        DEBUG(SSSDBG_TRACE_INTERNAL, "NSS Service not conected\n");
+        return EOK;
+    }
+
+    msg = dbus_message_new_method_call(NULL,
+                                       DP_PATH,
+                                       DATA_PROVIDER_REV_IFACE,
+                                       DATA_PROVIDER_REV_IFACE_INVALIDATEENTRY);
+    if (!msg) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Out of memory?!\n");
+        return ENOMEM;
+    }
+
+    dbret = dbus_message_append_args(msg,
+                                     DBUS_TYPE_UINT32, &type,
+                                     DBUS_TYPE_STRING, &name,
+                                     DBUS_TYPE_STRING, &domain,
+                                     DBUS_TYPE_INVALID);
+    if (!dbret) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Out of memory?!\n");
+        ret = ENOMEM;
+        goto done;
+    }
+
+    /* the reply carries nothing, it is only waited for to release the
+     * pending call */
+    ret = sbus_conn_send(be_ctx->nss_cli->conn, msg, -1,
+                         be_invalidate_memcache_entry_done, NULL, NULL);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_TRACE_FUNC,
+              "Error contacting NSS responder: %d [%s]\n",
+               ret, strerror(ret));
+    }
+
+done:
+    dbus_message_unref(msg);
+    return ret;
+}
+
 static errno_t be_initgroups_prereq(struct be_req *be_req)
 {
     struct be_acct_req *ar = talloc_get_type(be_req_get_data(be_req),
@@ -1191,6 +1276,206 @@ errno_t be_get_account_info_recv(struct tevent_req *req,
     return EOK;
 }
 
+/* Allocated on the waiting sbus_request so that it goes away together
+ * with the request, e.g. when the client connection is lost */
+struct be_acct_waiter {
+    struct be_acct_waiter *prev;
+    struct be_acct_waiter *next;
+
+    struct be_acct_inflight *inflight;
+    struct sbus_request *dbus_req;
+};
+
+struct be_acct_inflight {
+    struct be_ctx *be_ctx;
+    char *key;
+    bool in_table;
+
+    struct be_acct_waiter *waiters;
+};
+
+static int be_acct_waiter_destructor(struct be_acct_waiter *waiter)
+{
+    if (waiter->inflight != NULL) {
+        DLIST_REMOVE(waiter->inflight->waiters, waiter);
+        waiter->inflight = NULL;
+    }
+
+    return 0;
+}
+
+static void be_acct_inflight_unlink(struct be_acct_inflight *inflight)
+{
+    hash_key_t key;
+    int hret;
+
+    if (!inflight->in_table) {
+        return;
+    }
+
+    key.type = HASH_KEY_STRING;
+    key.str = inflight->key;
+    hret = hash_delete(inflight->be_ctx->acct_requests, &key);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Could not remove [%s] from the running requests: [%s]\n",
+              inflight->key, hash_error_string(hret));
+    }
+    inflight->in_table = false;
+}
+
+static void be_acct_inflight_reply(struct be_acct_inflight *inflight,
+                                   int dp_err_type,
+                                   int errnum,
+                                   const char *errstr)
+{
+    struct be_acct_waiter *waiter;
+
+    /* no new request may join once the reply is being sent */
+    be_acct_inflight_unlink(inflight);
+
+    while ((waiter = inflight->waiters) != NULL) {
+        DLIST_REMOVE(inflight->waiters, waiter);
+        waiter->inflight = NULL;
+
+        /* sending the reply frees the request and the waiter with it */
+        be_sbus_req_reply(waiter->dbus_req, dp_err_type, errnum, errstr);
+    }
+}
+
+static int be_acct_inflight_destructor(struct be_acct_inflight *inflight)
+{
+    /* The request was freed without a reply, the waiting clients would
+     * not get any answer otherwise */
+    be_acct_inflight_reply(inflight, DP_ERR_FATAL, EIO,
+                           "Request was terminated");
+
+    return 0;
+}
+
+static char *be_acct_inflight_key(TALLOC_CTX *mem_ctx,
+                                  uint32_t type,
+                                  uint32_t attr_type,
+                                  const char *filter,
+                                  const char *domain)
+{
+    /* BE_REQ_FAST only changes the reply when offline, not the lookup */
+    return talloc_asprintf(mem_ctx, "%#x:%u:%s:%s",
+                           type & ~BE_REQ_FAST, attr_type, domain, filter);
+}
+
+/* Attaches the request to an identical running one. Returns ENOENT if
+ * there is no such request. */
+static errno_t be_acct_inflight_join(struct be_ctx *be_ctx,
+                                     const char *key_str,
+                                     struct sbus_request *dbus_req)
+{
+    struct be_acct_inflight *inflight;
+    struct be_acct_waiter *waiter;
+    hash_key_t key;
+    hash_value_t value;
+    int hret;
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(key_str);
+
+    hret = hash_lookup(be_ctx->acct_requests, &key, &value);
+    if (hret == HASH_ERROR_KEY_NOT_FOUND) {
+        return ENOENT;
+    } else if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_OP_FAILURE, "Could not search the running requests: "
+              "[%s]\n", hash_error_string(hret));
+        return EIO;
+    }
+
+    inflight = talloc_get_type(value.ptr, struct be_acct_inflight);
+
+    /* an offline fast reply was already sent, nobody waits for the result */
+    if (dbus_req != NULL) {
+        waiter = talloc_zero(dbus_req, struct be_acct_waiter);
+        if (waiter == NULL) {
+            return ENOMEM;
+        }
+        waiter->inflight = inflight;
+        waiter->dbus_req = dbus_req;
+        DLIST_ADD_END(inflight->waiters, waiter, struct be_acct_waiter *);
+        talloc_set_destructor(waiter, be_acct_waiter_destructor);
+    }
+
+    be_ctx->acct_stats.coalesced++;
+    DEBUG(SSSDBG_TRACE_FUNC, "Request [%s] is already running, waiting for "
+          "its result (%"PRIu64" of %"PRIu64" requests coalesced)\n",
+          key_str, be_ctx->acct_stats.coalesced, be_ctx->acct_stats.requests);
+
+    return EOK;
+}
+
+/* Makes be_req the running request identical requests will wait for */
+static errno_t be_acct_inflight_register(struct be_req *be_req,
+                                         const char *key_str)
+{
+    struct be_ctx *be_ctx = be_req->be_ctx;
+    struct be_acct_inflight *inflight;
+    hash_key_t key;
+    hash_value_t value;
+    int hret;
+
+    inflight = talloc_zero(be_req, struct be_acct_inflight);
+    if (inflight == NULL) {
+        return ENOMEM;
+    }
+    inflight->be_ctx = be_ctx;
+    inflight->key = talloc_strdup(inflight, key_str);
+    if (inflight->key == NULL) {
+        talloc_free(inflight);
+        return ENOMEM;
+    }
+
+    key.type = HASH_KEY_STRING;
+    key.str = inflight->key;
+    value.type = HASH_VALUE_PTR;
+    value.ptr = inflight;
+
+    hret = hash_enter(be_ctx->acct_requests, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_OP_FAILURE, "Could not store the running request: "
+              "[%s]\n", hash_error_string(hret));
+        talloc_free(inflight);
+        return EIO;
+    }
+    inflight->in_table = true;
+    talloc_set_destructor(inflight, be_acct_inflight_destructor);
+
+    be_req->inflight = inflight;
+    return EOK;
+}
+
+/* Newer responders append the latency tracing ID of the client request
+ * to the arguments of getAccountInfo */
+static uint32_t be_get_account_info_rid(DBusMessage *message)
+{
+    DBusMessageIter iter;
+    uint32_t rid = 0;
+    int i;
+
+    if (!dbus_message_iter_init(message, &iter)) {
+        return 0;
+    }
+
+    /* skip type, attributes, filter and domain */
+    for (i = 0; i < 4; i++) {
+        if (!dbus_message_iter_next(&iter)) {
+            return 0;
+        }
+    }
+
+    if (dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_UINT32) {
+        dbus_message_iter_get_basic(&iter, &rid);
+    }
+
+    return rid;
+}
+
 static int be_get_account_info(struct sbus_request *dbus_req, void *user_data)
 {
     struct be_acct_req *req;
@@ -1200,6 +1485,8 @@ static int be_get_account_info(struct sbus_request *dbus_req, void *user_data)
     char *filter;
     char *domain;
     uint32_t attr_type;
+    uint32_t rid;
+    char *key;
     int ret;
     struct be_sbus_reply_data req_reply = BE_SBUS_REPLY_DATA_INIT;
 
@@ -1216,9 +1503,11 @@ static int be_get_account_info(struct sbus_request *dbus_req, void *user_data)
                                       DBUS_TYPE_INVALID))
         return EOK; /* handled */
 
+    rid = be_get_account_info_rid(dbus_req->message);
+
     DEBUG(SSSDBG_FUNC_DATA,
-          "Got request for [%#x][%s][%d][%s]\n", type, be_req2str(type),
-          attr_type, filter);
+          "Got request for [%#x][%s][%d][%s][%#x]\n", type, be_req2str(type),
+          attr_type, filter, rid);
 
     /* If we are offline and fast reply was requested
      * return offline immediately
@@ -1244,6 +1533,7 @@ static int be_get_account_info(struct sbus_request *dbus_req, void *user_data)
                                "Out of memory");
         goto done;
     }
+    be_req->rid = rid;
 
     ret = be_req_set_domain(be_req, domain);
     if (ret != EOK) {
@@ -1327,6 +1617,33 @@ static int be_get_account_info(struct sbus_request *dbus_req, void *user_data)
         goto done;
     }
 
+    becli->bectx->acct_stats.requests++;
+
+    key = be_acct_inflight_key(be_req, type, attr_type, filter, domain);
+    if (key == NULL) {
+        be_sbus_reply_data_set(&req_reply, DP_ERR_FATAL, ENOMEM,
+                               "Out of memory");
+        goto done;
+    }
+
+    ret = be_acct_inflight_join(becli->bectx, key, dbus_req);
+    if (ret == EOK) {
+        /* the reply is sent when the running request finishes */
+        talloc_free(be_req);
+        return EOK;
+    } else if (ret != ENOENT) {
+        be_sbus_reply_data_set(&req_reply, DP_ERR_FATAL, ret,
+                               "Cannot join running request");
+        goto done;
+    }
+
+    ret = be_acct_inflight_register(be_req, key);
+    if (ret != EOK) {
+        /* not fatal, the request just cannot be shared */
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Request [%s] cannot be shared with other clients\n", key);
+    }
+
     ret = be_file_account_request(be_req, req);
     if (ret != EOK) {
         be_sbus_reply_data_set(&req_reply, DP_ERR_FATAL, EINVAL,
@@ -2176,12 +2493,34 @@ static int be_client_init(struct sbus_connection *conn, void *data)
     return sbus_conn_register_iface(conn, &be_methods.vtable, DP_PATH, becli);
 }
 
+static int be_frame_client_init(struct sbus_connection *conn, void *data)
+{
+    struct be_ctx *bectx;
+    struct be_client *becli;
+
+    bectx = talloc_get_type(data, struct be_ctx);
+
+    becli = talloc_zero(conn, struct be_client);
+    if (!becli) {
+        DEBUG(SSSDBG_FATAL_FAILURE,"Out of memory?!\n");
+        return ENOMEM;
+    }
+    becli->bectx = bectx;
+    becli->conn = conn;
+    /* the responder identified itself on its D-Bus connection already,
+     * the framed one only carries its data provider requests */
+    becli->initialized = true;
+
+    return sbus_conn_register_iface(conn, &be_methods.vtable, DP_PATH, becli);
+}
+
 /* be_srv_init
  * set up per-domain sbus channel */
 static int be_srv_init(struct be_ctx *ctx,
                        uid_t uid, gid_t gid)
 {
     char *sbus_address;
+    char *frame_address;
     int ret;
 
     /* Set up SBUS connection to the monitor */
@@ -2201,6 +2540,21 @@ static int be_srv_init(struct be_ctx *ctx,
         return ret;
     }
 
+    ret = dp_get_frame_address(ctx, &frame_address, ctx->domain->name);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE, "Could not get framed backend address.\n");
+        return ret;
+    }
+
+    /* not fatal, the responders use the D-Bus server then */
+    ret = sbus_frame_server_new(ctx, ctx->ev, frame_address, uid, gid,
+                                be_frame_client_init, ctx, &ctx->frame_srv);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Could not set up framed server [%d]: %s\n",
+              ret, sss_strerror(ret));
+    }
+
     return EOK;
 }
 
@@ -2501,6 +2855,13 @@ int be_process_init(TALLOC_CTX *mem_ctx,
     ctx->ev = ev;
     ctx->cdb = cdb;
     ctx->identity = talloc_asprintf(ctx, "%%BE_%s", be_domain);
+    ret = sss_hash_create(ctx, 32, &ctx->acct_requests);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              "fatal error initializing the request table\n");
+        goto fail;
+    }
+
     ctx->conf_path = talloc_asprintf(ctx, CONFDB_DOMAIN_PATH_TMPL, be_domain);
     if (!ctx->identity || !ctx->conf_path) {
         DEBUG(SSSDBG_FATAL_FAILURE, "Out of memory!?\n");
@@ -2835,8 +3196,16 @@ int main(int argc, const char *argv[])
 static int data_provider_res_init(struct sbus_request *dbus_req, void *data)
 {
     struct be_ctx *be_ctx;
+    struct resolv_cache_stats stats;
     be_ctx = talloc_get_type(data, struct be_ctx);
 
+    /* The DNS cache is purged when the configuration is reread */
+    resolv_cache_get_stats(be_ctx->be_res->resolv, &stats);
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "DNS cache: %"PRIu64" hits, %"PRIu64" negative hits, "
+          "%"PRIu64" misses, %"PRIu64" coalesced queries\n",
+          stats.hits, stats.negative_hits, stats.misses, stats.coalesced);
+
     resolv_reread_configuration(be_ctx->be_res->resolv);
     check_if_online(be_ctx);
 
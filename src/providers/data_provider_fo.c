@@ -847,6 +847,7 @@ static struct dp_option dp_res_default_opts[] = {
     { "dns_resolver_timeout", DP_OPT_NUMBER, { .number = 6 }, NULL_NUMBER },
     { "dns_resolver_op_timeout", DP_OPT_NUMBER, { .number = 6 }, NULL_NUMBER },
     { "dns_discovery_domain", DP_OPT_STRING, NULL_STRING, NULL_STRING },
+    { "dns_resolver_cache_timeout", DP_OPT_NUMBER, { .number = 300 }, NULL_NUMBER },
     DP_OPTION_TERMINATOR
 };
 
@@ -888,6 +889,7 @@ static errno_t be_res_get_opts(struct be_resolv_ctx *res_ctx,
 errno_t be_res_init(struct be_ctx *ctx)
 {
     errno_t ret;
+    int cache_timeout;
 
     if (ctx->be_res != NULL) {
         return EOK;
@@ -913,5 +915,15 @@ errno_t be_res_init(struct be_ctx *ctx)
         return ret;
     }
 
+    cache_timeout = dp_opt_get_int(ctx->be_res->opts,
+                                   DP_RES_OPT_CACHE_TIMEOUT);
+    if (cache_timeout < 0) {
+        DEBUG(SSSDBG_CONF_SETTINGS,
+              "Negative value of %s, disabling the DNS cache\n",
+              dp_res_default_opts[DP_RES_OPT_CACHE_TIMEOUT].opt_name);
+        cache_timeout = 0;
+    }
+    resolv_cache_set_max_ttl(ctx->be_res->resolv, cache_timeout);
+
     return EOK;
 }
@@ -85,6 +85,13 @@ const struct sbus_method_meta data_provider_rev_iface__methods[] = {
         offsetof(struct data_provider_rev_iface, initgrCheck),
         NULL, /* no invoker */
     },
+    {
+        "invalidateEntry", /* name */
+        NULL, /* no in_args */
+        NULL, /* no out_args */
+        offsetof(struct data_provider_rev_iface, invalidateEntry),
+        NULL, /* no invoker */
+    },
     { NULL, }
 };
 
@@ -25,6 +25,7 @@
 #define DATA_PROVIDER_REV_IFACE "org.freedesktop.sssd.dataprovider_rev"
 #define DATA_PROVIDER_REV_IFACE_UPDATECACHE "updateCache"
 #define DATA_PROVIDER_REV_IFACE_INITGRCHECK "initgrCheck"
+#define DATA_PROVIDER_REV_IFACE_INVALIDATEENTRY "invalidateEntry"
 
 /* ------------------------------------------------------------------------
  * DBus handlers
@@ -61,6 +62,7 @@ struct data_provider_rev_iface {
     struct sbus_vtable vtable; /* derive from sbus_vtable */
     sbus_msg_handler_fn updateCache;
     sbus_msg_handler_fn initgrCheck;
+    sbus_msg_handler_fn invalidateEntry;
 };
 
 /* ------------------------------------------------------------------------
@@ -100,6 +100,13 @@ struct be_failover_ctx;
 
 struct be_cb;
 
+struct be_acct_req_stats {
+    /* account requests received from the responders */
+    uint64_t requests;
+    /* requests answered by an identical request that was already running */
+    uint64_t coalesced;
+};
+
 struct be_ctx {
     struct tevent_context *ev;
     struct confdb_ctx *cdb;
@@ -130,6 +137,8 @@ struct be_ctx {
 
     struct sbus_connection *mon_conn;
     struct sbus_connection *sbus_srv;
+    /* serves the data provider requests of the responders without D-Bus */
+    struct sbus_frame_server *frame_srv;
 
     struct be_client *nss_cli;
     struct be_client *pam_cli;
@@ -148,6 +157,11 @@ struct be_ctx {
 
     /* List of ongoing requests */
     struct be_req *active_requests;
+
+    /* Account requests in progress, identical requests from other
+     * responders wait for them instead of running again */
+    hash_table_t *acct_requests;
+    struct be_acct_req_stats acct_stats;
 };
 
 struct bet_ops {
@@ -328,4 +342,9 @@ errno_t be_get_account_info_recv(struct tevent_req *req,
                                  int *_err_min,
                                  const char **_err_msg);
 
+/* Ask the NSS responder to drop an entry of type BE_REQ_USER or
+ * BE_REQ_GROUP from its memory cache */
+errno_t be_invalidate_memcache_entry(struct be_ctx *be_ctx, uint32_t type,
+                                     const char *domain, const char *name);
+
 #endif /* __DP_BACKEND_H___ */
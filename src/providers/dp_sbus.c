@@ -44,3 +44,20 @@ int dp_get_sbus_address(TALLOC_CTX *mem_ctx,
     return EOK;
 }
 
+/* Path of the socket of the framed connections, not a D-Bus address */
+int dp_get_frame_address(TALLOC_CTX *mem_ctx,
+                         char **address, const char *domain_name)
+{
+    char *default_address;
+
+    *address = NULL;
+    default_address = talloc_asprintf(mem_ctx, "%s/%s_%s",
+                                      PIPE_PATH, DATA_PROVIDER_FRAME_PIPE,
+                                      domain_name);
+    if (default_address == NULL) {
+        return ENOMEM;
+    }
+
+    *address = default_address;
+    return EOK;
+}
@@ -84,6 +84,10 @@ struct tevent_req *handle_child_send(TALLOC_CTX *mem_ctx,
 int handle_child_recv(struct tevent_req *req, TALLOC_CTX *mem_ctx,
                       uint8_t **buf, ssize_t *len);
 
+/* Starts the pre-spawned krb5_child workers if krb5_child_pool_size is set */
+errno_t krb5_child_pool_init(struct krb5_ctx *krb5_ctx,
+                             struct tevent_context *ev);
+
 struct krb5_child_response {
     int32_t msg_status;
     struct tgt_times tgtt;
@@ -26,6 +26,9 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <popt.h>
+#ifdef HAVE_PRCTL
+#include <sys/prctl.h>
+#endif
 
 #include <security/pam_modules.h>
 
@@ -80,6 +83,9 @@ struct krb5_req {
 
     uid_t fast_uid;
     gid_t fast_gid;
+
+    /* the pool worker that forked the request process, 0 otherwise */
+    pid_t worker_pid;
 };
 
 static krb5_context krb5_error_ctx;
@@ -2599,6 +2605,348 @@ static void try_open_krb5_conf(void)
     }
 }
 
+/* The back end only knows the pool worker, so a request process must not
+ * outlive it, e.g. when the back end kills the worker on timeout */
+static errno_t k5c_die_with_worker(pid_t worker_pid)
+{
+#ifdef HAVE_PRCTL
+    int ret;
+
+    errno = 0;
+    ret = prctl(PR_SET_PDEATHSIG, SIGKILL, 0, 0, 0);
+    if (ret != 0) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "prctl failed [%d][%s].\n", ret, strerror(ret));
+        return ret;
+    }
+#endif
+
+    /* the worker might be gone before the signal was set */
+    if (getppid() != worker_pid) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "krb5_child pool worker exited.\n");
+        return ESRCH;
+    }
+
+    return EOK;
+}
+
+/* Handles a single request and writes the reply to out_fd. The process
+ * drops its privileges to the user of the request, so it must not be used
+ * for another request afterwards. */
+static errno_t k5c_run(struct krb5_req *kr, uint32_t offline, int out_fd)
+{
+    errno_t ret;
+    krb5_error_code kerr;
+
+    kerr = privileged_krb5_setup(kr, offline);
+    if (kerr != 0) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "privileged_krb5_setup failed.\n");
+        return EFAULT;
+    }
+
+    kerr = become_user(kr->uid, kr->gid);
+    if (kerr != 0) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "become_user failed.\n");
+        return EFAULT;
+    }
+
+    if (kr->worker_pid != 0) {
+        /* changing the credentials cleared the parent death signal */
+        ret = k5c_die_with_worker(kr->worker_pid);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL,
+          "Running as [%"SPRIuid"][%"SPRIgid"].\n", geteuid(), getegid());
+    try_open_krb5_conf();
+
+    ret = k5c_setup(kr, offline);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "krb5_child_setup failed.\n");
+        return ret;
+    }
+
+    switch(kr->pd->cmd) {
+    case SSS_PAM_AUTHENTICATE:
+        /* If we are offline, we need to create an empty ccache file */
+        if (offline) {
+            DEBUG(SSSDBG_TRACE_FUNC, "Will perform offline auth\n");
+            ret = create_empty_ccache(kr);
+        } else {
+            DEBUG(SSSDBG_TRACE_FUNC, "Will perform online auth\n");
+            ret = tgt_req_child(kr);
+        }
+        break;
+    case SSS_PAM_CHAUTHTOK:
+        DEBUG(SSSDBG_TRACE_FUNC, "Will perform password change\n");
+        ret = changepw_child(kr, false);
+        break;
+    case SSS_PAM_CHAUTHTOK_PRELIM:
+        DEBUG(SSSDBG_TRACE_FUNC, "Will perform password change checks\n");
+        ret = changepw_child(kr, true);
+        break;
+    case SSS_PAM_ACCT_MGMT:
+        DEBUG(SSSDBG_TRACE_FUNC, "Will perform account management\n");
+        ret = kuserok_child(kr);
+        break;
+    case SSS_CMD_RENEW:
+        if (offline) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Cannot renew TGT while offline\n");
+            return KRB5_KDC_UNREACH;
+        }
+        DEBUG(SSSDBG_TRACE_FUNC, "Will perform ticket renewal\n");
+        ret = renew_tgt_child(kr);
+        break;
+    case SSS_PAM_PREAUTH:
+        DEBUG(SSSDBG_TRACE_FUNC, "Will perform pre-auth\n");
+        ret = tgt_req_child(kr);
+        break;
+    default:
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "PAM command [%d] not supported.\n", kr->pd->cmd);
+        return EINVAL;
+    }
+
+    ret = k5c_send_data(kr, out_fd, ret);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to send reply\n");
+    }
+
+    return ret;
+}
+
+/* Reads a request of a pool worker, the length of the request as 32-bit
+ * integer followed by the request as sent to a single krb5_child.
+ * Returns ENOENT if the back end closed the pipe. */
+static errno_t k5c_pool_read_request(int fd, uint8_t *buf, size_t *_len)
+{
+    uint32_t len;
+    ssize_t ret;
+    errno_t err;
+
+    errno = 0;
+    ret = sss_atomic_read_s(fd, &len, sizeof(len));
+    if (ret == 0) {
+        return ENOENT;
+    } else if (ret != sizeof(len)) {
+        err = (ret == -1 && errno != 0) ? errno : EIO;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "read failed [%d][%s].\n", err, strerror(err));
+        return err;
+    }
+
+    if (len == 0 || len > IN_BUF_SIZE) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Invalid request size [%"PRIu32"].\n", len);
+        return EINVAL;
+    }
+
+    errno = 0;
+    ret = sss_atomic_read_s(fd, buf, len);
+    if (ret != len) {
+        err = (ret == -1 && errno != 0) ? errno : EIO;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "read failed [%d][%s].\n", err, strerror(err));
+        return err;
+    }
+
+    *_len = len;
+    return EOK;
+}
+
+/* Reads the complete reply of a request process */
+static errno_t k5c_pool_read_reply(TALLOC_CTX *mem_ctx, int fd,
+                                   uint8_t **_buf, uint32_t *_len)
+{
+    uint8_t *buf = NULL;
+    uint32_t len = 0;
+    ssize_t ret;
+    errno_t err;
+
+    while (true) {
+        buf = talloc_realloc(mem_ctx, buf, uint8_t, len + CHILD_MSG_CHUNK);
+        if (buf == NULL) {
+            return ENOMEM;
+        }
+
+        errno = 0;
+        ret = sss_atomic_read_s(fd, buf + len, CHILD_MSG_CHUNK);
+        if (ret == -1) {
+            err = errno;
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "read failed [%d][%s].\n", err, strerror(err));
+            talloc_free(buf);
+            return err;
+        }
+
+        len += ret;
+        if (ret < CHILD_MSG_CHUNK) {
+            break;
+        }
+    }
+
+    *_buf = buf;
+    *_len = len;
+    return EOK;
+}
+
+/* The standard output of a pool worker is the pipe the back end reads all
+ * replies from. The request process runs as the user, so it must not be
+ * able to write there, its reply goes to a pipe of its own. */
+static errno_t k5c_pool_detach_stdout(void)
+{
+    int fd;
+    int ret;
+
+    fd = open("/dev/null", O_WRONLY);
+    if (fd == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "open failed [%d][%s].\n", ret, strerror(ret));
+        return ret;
+    }
+
+    ret = dup2(fd, STDOUT_FILENO);
+    close(fd);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "dup2 failed [%d][%s].\n", ret, strerror(ret));
+        return ret;
+    }
+
+    return EOK;
+}
+
+/* A pool worker is started by the back end before it is needed and handles
+ * requests until the back end closes its standard input. Every request is
+ * handled by a forked process, so the worker never changes its identity and
+ * no data of one user is ever visible to a request of another user. The
+ * worker saves the exec and start-up of a new krb5_child per request. */
+static errno_t k5c_pool_worker(uid_t fast_uid, gid_t fast_gid)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct krb5_req *kr;
+    uint8_t buf[IN_BUF_SIZE];
+    size_t len;
+    uint8_t *reply;
+    uint32_t reply_len;
+    uint32_t offline;
+    int pipefd[2];
+    int status;
+    ssize_t written;
+    pid_t worker_pid;
+    pid_t pid;
+    errno_t ret;
+
+    DEBUG(SSSDBG_TRACE_FUNC, "krb5_child pool worker started.\n");
+
+    while (true) {
+        ret = k5c_pool_read_request(STDIN_FILENO, buf, &len);
+        if (ret == ENOENT) {
+            DEBUG(SSSDBG_TRACE_FUNC, "Back end closed the pipe, exiting.\n");
+            return EOK;
+        } else if (ret != EOK) {
+            return ret;
+        }
+
+        ret = pipe(pipefd);
+        if (ret == -1) {
+            ret = errno;
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "pipe failed [%d][%s].\n", ret, strerror(ret));
+            safezero(buf, sizeof(buf));
+            return ret;
+        }
+
+        worker_pid = getpid();
+        pid = fork();
+        if (pid == 0) { /* request process */
+            close(pipefd[0]);
+            close(STDIN_FILENO);
+
+            ret = k5c_pool_detach_stdout();
+            if (ret == EOK) {
+                ret = k5c_die_with_worker(worker_pid);
+            }
+            if (ret != EOK) {
+                safezero(buf, sizeof(buf));
+                _exit(-1);
+            }
+
+            kr = talloc_zero(NULL, struct krb5_req);
+            if (kr == NULL) {
+                DEBUG(SSSDBG_CRIT_FAILURE, "talloc failed.\n");
+                safezero(buf, sizeof(buf));
+                _exit(-1);
+            }
+            kr->fast_uid = fast_uid;
+            kr->fast_gid = fast_gid;
+            kr->worker_pid = worker_pid;
+
+            ret = unpack_buffer(buf, len, kr, &offline);
+            safezero(buf, sizeof(buf));
+            if (ret == EOK) {
+                ret = k5c_run(kr, offline, pipefd[1]);
+            } else {
+                DEBUG(SSSDBG_CRIT_FAILURE, "unpack_buffer failed.\n");
+            }
+
+            krb5_cleanup(kr);
+            talloc_free(kr);
+            _exit(ret == EOK ? 0 : -1);
+        }
+
+        /* the worker must not keep the credentials of the request */
+        safezero(buf, sizeof(buf));
+        close(pipefd[1]);
+
+        if (pid == -1) {
+            ret = errno;
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "fork failed [%d][%s].\n", ret, strerror(ret));
+            close(pipefd[0]);
+            return ret;
+        }
+
+        tmp_ctx = talloc_new(NULL);
+        if (tmp_ctx == NULL) {
+            close(pipefd[0]);
+            return ENOMEM;
+        }
+
+        ret = k5c_pool_read_reply(tmp_ctx, pipefd[0], &reply, &reply_len);
+        close(pipefd[0]);
+
+        while (waitpid(pid, &status, 0) == -1 && errno == EINTR);
+
+        if (ret != EOK) {
+            talloc_free(tmp_ctx);
+            return ret;
+        }
+
+        /* An empty reply tells the back end the request failed, just like
+         * a single krb5_child that exits without a reply */
+        errno = 0;
+        written = sss_atomic_write_s(STDOUT_FILENO, &reply_len,
+                                     sizeof(reply_len));
+        if (written == sizeof(reply_len) && reply_len > 0) {
+            written = sss_atomic_write_s(STDOUT_FILENO, reply, reply_len);
+            written = (written == reply_len) ? sizeof(reply_len) : -1;
+        }
+        talloc_free(tmp_ctx);
+        if (written != sizeof(reply_len)) {
+            ret = errno ? errno : EIO;
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "write failed [%d][%s].\n", ret, strerror(ret));
+            return ret;
+        }
+    }
+}
+
+#ifndef UNIT_TESTING
 int main(int argc, const char *argv[])
 {
     struct krb5_req *kr = NULL;
@@ -2607,9 +2955,9 @@ int main(int argc, const char *argv[])
     poptContext pc;
     int debug_fd = -1;
     errno_t ret;
-    krb5_error_code kerr;
     uid_t fast_uid;
     gid_t fast_gid;
+    int pool_worker = 0;
 
     struct poptOption long_options[] = {
         POPT_AUTOHELP
@@ -2628,6 +2976,9 @@ int main(int argc, const char *argv[])
           _("The user to create FAST ccache as"), NULL},
         {"fast-ccache-gid", 0, POPT_ARG_INT, &fast_gid, 0,
           _("The group to create FAST ccache as"), NULL},
+        {"pool-worker", 0, POPT_ARG_NONE | POPT_ARGFLAG_DOC_HIDDEN,
+         &pool_worker, 0,
+         _("Handle requests until standard input is closed"), NULL},
         POPT_TABLEEND
     };
 
@@ -2666,6 +3017,11 @@ int main(int argc, const char *argv[])
 
     DEBUG(SSSDBG_TRACE_FUNC, "krb5_child started.\n");
 
+    if (pool_worker) {
+        ret = k5c_pool_worker(fast_uid, fast_gid);
+        goto done;
+    }
+
     kr = talloc_zero(NULL, struct krb5_req);
     if (kr == NULL) {
         DEBUG(SSSDBG_CRIT_FAILURE, "talloc failed.\n");
@@ -2684,77 +3040,7 @@ int main(int argc, const char *argv[])
 
     close(STDIN_FILENO);
 
-    kerr = privileged_krb5_setup(kr, offline);
-    if (kerr != 0) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "privileged_krb5_setup failed.\n");
-        ret = EFAULT;
-        goto done;
-    }
-
-    kerr = become_user(kr->uid, kr->gid);
-    if (kerr != 0) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "become_user failed.\n");
-        ret = EFAULT;
-        goto done;
-    }
-
-    DEBUG(SSSDBG_TRACE_INTERNAL,
-          "Running as [%"SPRIuid"][%"SPRIgid"].\n", geteuid(), getegid());
-    try_open_krb5_conf();
-
-    ret = k5c_setup(kr, offline);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "krb5_child_setup failed.\n");
-        goto done;
-    }
-
-    switch(kr->pd->cmd) {
-    case SSS_PAM_AUTHENTICATE:
-        /* If we are offline, we need to create an empty ccache file */
-        if (offline) {
-            DEBUG(SSSDBG_TRACE_FUNC, "Will perform offline auth\n");
-            ret = create_empty_ccache(kr);
-        } else {
-            DEBUG(SSSDBG_TRACE_FUNC, "Will perform online auth\n");
-            ret = tgt_req_child(kr);
-        }
-        break;
-    case SSS_PAM_CHAUTHTOK:
-        DEBUG(SSSDBG_TRACE_FUNC, "Will perform password change\n");
-        ret = changepw_child(kr, false);
-        break;
-    case SSS_PAM_CHAUTHTOK_PRELIM:
-        DEBUG(SSSDBG_TRACE_FUNC, "Will perform password change checks\n");
-        ret = changepw_child(kr, true);
-        break;
-    case SSS_PAM_ACCT_MGMT:
-        DEBUG(SSSDBG_TRACE_FUNC, "Will perform account management\n");
-        ret = kuserok_child(kr);
-        break;
-    case SSS_CMD_RENEW:
-        if (offline) {
-            DEBUG(SSSDBG_CRIT_FAILURE, "Cannot renew TGT while offline\n");
-            ret = KRB5_KDC_UNREACH;
-            goto done;
-        }
-        DEBUG(SSSDBG_TRACE_FUNC, "Will perform ticket renewal\n");
-        ret = renew_tgt_child(kr);
-        break;
-    case SSS_PAM_PREAUTH:
-        DEBUG(SSSDBG_TRACE_FUNC, "Will perform pre-auth\n");
-        ret = tgt_req_child(kr);
-        break;
-    default:
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "PAM command [%d] not supported.\n", kr->pd->cmd);
-        ret = EINVAL;
-        goto done;
-    }
-
-    ret = k5c_send_data(kr, STDOUT_FILENO, ret);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to send reply\n");
-    }
+    ret = k5c_run(kr, offline, STDOUT_FILENO);
 
 done:
     if (ret == EOK) {
@@ -2768,3 +3054,4 @@ done:
     talloc_free(kr);
     exit(ret);
 }
+#endif
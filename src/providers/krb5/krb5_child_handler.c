@@ -51,8 +51,14 @@ struct handle_child_state {
     pid_t child_pid;
 
     struct child_io_fds *io;
+
+    /* set if the request is handled by a pool worker */
+    struct krb5_child_lease *lease;
+    struct timeval start;
 };
 
+struct krb5_child_lease;
+
 static errno_t pack_authtok(struct io_buffer *buf, size_t *rp,
                             struct sss_auth_token *tok)
 {
@@ -351,6 +357,529 @@ static errno_t fork_child(struct tevent_req *req)
     return EOK;
 }
 
+/* Pool of pre-spawned krb5_child processes
+ *
+ * A pool worker is a krb5_child started with --pool-worker. It reads
+ * requests framed with their length from its standard input, forks a
+ * process for each of them and writes the framed reply to its standard
+ * output. Workers are started ahead of time, so a request does not have
+ * to wait for fork, exec and the start-up of krb5_child. A worker handles
+ * one request at a time and is replaced after krb5_child_pool_max_requests
+ * requests or if a request fails. If no worker is idle, a single
+ * krb5_child is forked for the request as before. */
+
+struct krb5_child_pool;
+
+struct krb5_child_worker {
+    struct krb5_child_worker *prev;
+    struct krb5_child_worker *next;
+
+    struct krb5_child_pool *pool;
+    pid_t pid;
+    int read_fd;
+    int write_fd;
+    struct sss_child_ctx_old *child_ctx;
+
+    uint32_t num_requests;
+    bool busy;
+};
+
+struct krb5_child_pool {
+    struct krb5_ctx *krb5_ctx;
+    struct tevent_context *ev;
+
+    /* workers waiting for a request */
+    struct krb5_child_worker *idle;
+    int num_workers;
+    int size;
+    uint32_t max_requests;
+
+    struct tevent_timer *refill;
+};
+
+static void krb5_child_pool_schedule_refill(struct krb5_child_pool *pool);
+
+static int krb5_child_worker_destructor(struct krb5_child_worker *worker)
+{
+    if (!worker->busy) {
+        DLIST_REMOVE(worker->pool->idle, worker);
+    }
+    worker->pool->num_workers--;
+
+    if (worker->read_fd != -1) {
+        close(worker->read_fd);
+    }
+    if (worker->write_fd != -1) {
+        close(worker->write_fd);
+    }
+
+    /* the worker exits when its input is closed, but it might be stuck */
+    if (worker->child_ctx != NULL) {
+        child_handler_destroy(worker->child_ctx);
+    }
+
+    return 0;
+}
+
+static void krb5_child_worker_exited(int child_status,
+                                     struct tevent_signal *sige,
+                                     void *pvt)
+{
+    struct krb5_child_worker *worker;
+    struct krb5_child_pool *pool;
+
+    worker = talloc_get_type(pvt, struct krb5_child_worker);
+    worker->child_ctx = NULL;
+    pool = worker->pool;
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "krb5_child pool worker [%d] exited.\n", worker->pid);
+
+    /* A busy worker is released by its request which fails because the
+     * pipe is closed */
+    if (!worker->busy) {
+        talloc_free(worker);
+        krb5_child_pool_schedule_refill(pool);
+    }
+}
+
+static errno_t krb5_child_worker_spawn(struct krb5_child_pool *pool)
+{
+    struct krb5_child_worker *worker;
+    int pipefd_to_child[2] = { -1, -1 };
+    int pipefd_from_child[2] = { -1, -1 };
+    const char *k5c_extra_args[4];
+    pid_t pid;
+    errno_t ret;
+
+    worker = talloc_zero(pool, struct krb5_child_worker);
+    if (worker == NULL) {
+        return ENOMEM;
+    }
+    worker->pool = pool;
+    worker->read_fd = -1;
+    worker->write_fd = -1;
+
+    k5c_extra_args[0] = talloc_asprintf(worker, "--fast-ccache-uid=%"SPRIuid,
+                                        getuid());
+    k5c_extra_args[1] = talloc_asprintf(worker, "--fast-ccache-gid=%"SPRIgid,
+                                        getgid());
+    k5c_extra_args[2] = "--pool-worker";
+    k5c_extra_args[3] = NULL;
+    if (k5c_extra_args[0] == NULL || k5c_extra_args[1] == NULL) {
+        ret = ENOMEM;
+        goto fail;
+    }
+
+    ret = pipe(pipefd_from_child);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "pipe failed [%d][%s].\n", ret, strerror(ret));
+        goto fail;
+    }
+    ret = pipe(pipefd_to_child);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "pipe failed [%d][%s].\n", ret, strerror(ret));
+        goto fail;
+    }
+
+    pid = fork();
+    if (pid == 0) { /* child */
+        ret = exec_child_ex(worker, pipefd_to_child, pipefd_from_child,
+                            KRB5_CHILD, pool->krb5_ctx->child_debug_fd,
+                            k5c_extra_args, false,
+                            STDIN_FILENO, STDOUT_FILENO);
+        DEBUG(SSSDBG_CRIT_FAILURE, "Could not exec KRB5 child: [%d][%s].\n",
+              ret, strerror(ret));
+        _exit(1);
+    } else if (pid == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "fork failed [%d][%s].\n", ret, strerror(ret));
+        goto fail;
+    }
+
+    worker->pid = pid;
+    worker->read_fd = pipefd_from_child[0];
+    close(pipefd_from_child[1]);
+    worker->write_fd = pipefd_to_child[1];
+    close(pipefd_to_child[0]);
+    sss_fd_nonblocking(worker->read_fd);
+    sss_fd_nonblocking(worker->write_fd);
+
+    /* Other workers must not keep the pipes open, otherwise this worker
+     * would not see the end of its input when the back end exits */
+    (void) fcntl(worker->read_fd, F_SETFD, FD_CLOEXEC);
+    (void) fcntl(worker->write_fd, F_SETFD, FD_CLOEXEC);
+
+    DLIST_ADD(pool->idle, worker);
+    pool->num_workers++;
+    talloc_set_destructor(worker, krb5_child_worker_destructor);
+
+    ret = child_handler_setup(pool->ev, pid, krb5_child_worker_exited, worker,
+                              &worker->child_ctx);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Could not set up child signal handler\n");
+        talloc_free(worker);
+        return ret;
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL,
+          "Started krb5_child pool worker [%d].\n", pid);
+    return EOK;
+
+fail:
+    if (pipefd_from_child[0] != -1) {
+        close(pipefd_from_child[0]);
+        close(pipefd_from_child[1]);
+    }
+    if (pipefd_to_child[0] != -1) {
+        close(pipefd_to_child[0]);
+        close(pipefd_to_child[1]);
+    }
+    talloc_free(worker);
+    return ret;
+}
+
+static void krb5_child_pool_refill(struct tevent_context *ev,
+                                   struct tevent_timer *te,
+                                   struct timeval tv, void *pvt)
+{
+    struct krb5_child_pool *pool;
+    errno_t ret;
+
+    pool = talloc_get_type(pvt, struct krb5_child_pool);
+    pool->refill = NULL;
+
+    while (pool->num_workers < pool->size) {
+        ret = krb5_child_worker_spawn(pool);
+        if (ret != EOK) {
+            /* requests fork their own krb5_child until the next attempt */
+            DEBUG(SSSDBG_OP_FAILURE,
+                  "Cannot start krb5_child pool worker [%d]: %s\n",
+                  ret, sss_strerror(ret));
+            return;
+        }
+    }
+}
+
+static void krb5_child_pool_schedule_refill(struct krb5_child_pool *pool)
+{
+    if (pool->refill != NULL || pool->num_workers >= pool->size) {
+        return;
+    }
+
+    /* start the workers after the current request is served */
+    pool->refill = tevent_add_timer(pool->ev, pool, tevent_timeval_current(),
+                                    krb5_child_pool_refill, pool);
+    if (pool->refill == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_add_timer failed.\n");
+    }
+}
+
+static struct krb5_child_worker *
+krb5_child_pool_get(struct krb5_child_pool *pool)
+{
+    struct krb5_child_worker *worker;
+
+    if (pool == NULL || pool->idle == NULL) {
+        return NULL;
+    }
+
+    worker = pool->idle;
+    DLIST_REMOVE(pool->idle, worker);
+    worker->busy = true;
+    worker->num_requests++;
+
+    return worker;
+}
+
+/* Returns the worker to the pool if it can handle another request */
+static void krb5_child_pool_put(struct krb5_child_worker *worker,
+                                bool reusable)
+{
+    struct krb5_child_pool *pool = worker->pool;
+
+    if (reusable && worker->child_ctx != NULL
+            && worker->num_requests < pool->max_requests) {
+        worker->busy = false;
+        DLIST_ADD(pool->idle, worker);
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, "Retiring krb5_child pool worker [%d] "
+          "after %"PRIu32" requests.\n", worker->pid, worker->num_requests);
+    talloc_free(worker);
+    krb5_child_pool_schedule_refill(pool);
+}
+
+errno_t krb5_child_pool_init(struct krb5_ctx *krb5_ctx,
+                             struct tevent_context *ev)
+{
+    struct krb5_child_pool *pool;
+    int size;
+    int max_requests;
+
+    size = dp_opt_get_int(krb5_ctx->opts, KRB5_CHILD_POOL_SIZE);
+    if (size <= 0) {
+        DEBUG(SSSDBG_CONF_SETTINGS, "krb5_child pool is disabled.\n");
+        return EOK;
+    }
+
+    max_requests = dp_opt_get_int(krb5_ctx->opts,
+                                  KRB5_CHILD_POOL_MAX_REQUESTS);
+    if (max_requests <= 0) {
+        DEBUG(SSSDBG_CONF_SETTINGS,
+              "Invalid value [%d] of krb5_child_pool_max_requests, "
+              "workers will handle a single request.\n", max_requests);
+        max_requests = 1;
+    }
+
+    pool = talloc_zero(krb5_ctx, struct krb5_child_pool);
+    if (pool == NULL) {
+        return ENOMEM;
+    }
+    pool->krb5_ctx = krb5_ctx;
+    pool->ev = ev;
+    pool->size = size;
+    pool->max_requests = max_requests;
+
+    krb5_ctx->child_pool = pool;
+    krb5_child_pool_schedule_refill(pool);
+
+    DEBUG(SSSDBG_CONF_SETTINGS, "Using a pool of %d krb5_child workers, "
+          "each handling up to %d requests.\n", size, max_requests);
+    return EOK;
+}
+
+/* Reads the reply of a pool worker, the length as 32-bit integer followed
+ * by the reply of krb5_child */
+struct krb5_child_worker_read_state {
+    int fd;
+    uint32_t len;
+    size_t hdr_read;
+    uint8_t *buf;
+    size_t buf_read;
+};
+
+static void krb5_child_worker_read_handler(struct tevent_context *ev,
+                                           struct tevent_fd *fde,
+                                           uint16_t flags, void *pvt);
+
+static struct tevent_req *
+krb5_child_worker_read_send(TALLOC_CTX *mem_ctx,
+                            struct tevent_context *ev, int fd)
+{
+    struct tevent_req *req;
+    struct krb5_child_worker_read_state *state;
+    struct tevent_fd *fde;
+
+    req = tevent_req_create(mem_ctx, &state,
+                            struct krb5_child_worker_read_state);
+    if (req == NULL) {
+        return NULL;
+    }
+    state->fd = fd;
+
+    fde = tevent_add_fd(ev, state, fd, TEVENT_FD_READ,
+                        krb5_child_worker_read_handler, req);
+    if (fde == NULL) {
+        talloc_free(req);
+        return NULL;
+    }
+
+    return req;
+}
+
+static void krb5_child_worker_read_handler(struct tevent_context *ev,
+                                           struct tevent_fd *fde,
+                                           uint16_t flags, void *pvt)
+{
+    struct tevent_req *req;
+    struct krb5_child_worker_read_state *state;
+    uint8_t *dest;
+    size_t missing;
+    ssize_t size;
+    errno_t err;
+
+    req = talloc_get_type(pvt, struct tevent_req);
+    state = tevent_req_data(req, struct krb5_child_worker_read_state);
+
+    if (state->hdr_read < sizeof(state->len)) {
+        dest = (uint8_t *) &state->len + state->hdr_read;
+        missing = sizeof(state->len) - state->hdr_read;
+    } else {
+        dest = state->buf + state->buf_read;
+        missing = state->len - state->buf_read;
+    }
+
+    errno = 0;
+    size = read(state->fd, dest, missing);
+    if (size == -1) {
+        err = errno;
+        if (err == EAGAIN || err == EINTR) {
+            return;
+        }
+
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "read failed [%d][%s].\n", err, strerror(err));
+        tevent_req_error(req, err);
+        return;
+    } else if (size == 0) {
+        DEBUG(SSSDBG_OP_FAILURE, "krb5_child pool worker closed the pipe\n");
+        tevent_req_error(req, EPIPE);
+        return;
+    }
+
+    if (state->hdr_read < sizeof(state->len)) {
+        state->hdr_read += size;
+        if (state->hdr_read < sizeof(state->len)) {
+            return;
+        }
+
+        if (state->len == 0) {
+            /* the request failed without a reply */
+            tevent_req_done(req);
+            return;
+        }
+
+        state->buf = talloc_size(state, state->len);
+        if (state->buf == NULL) {
+            tevent_req_error(req, ENOMEM);
+        }
+        return;
+    }
+
+    state->buf_read += size;
+    if (state->buf_read == state->len) {
+        tevent_req_done(req);
+    }
+}
+
+static errno_t krb5_child_worker_read_recv(struct tevent_req *req,
+                                           TALLOC_CTX *mem_ctx,
+                                           uint8_t **_buf, ssize_t *_len)
+{
+    struct krb5_child_worker_read_state *state;
+
+    state = tevent_req_data(req, struct krb5_child_worker_read_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *_buf = talloc_steal(mem_ctx, state->buf);
+    *_len = state->len;
+    return EOK;
+}
+
+/* Prefixes the request with its length for a pool worker */
+static errno_t krb5_child_worker_frame(struct io_buffer *buf)
+{
+    uint8_t *data;
+    uint32_t len;
+    size_t rp = 0;
+
+    len = buf->size;
+    data = talloc_size(buf, sizeof(len) + buf->size);
+    if (data == NULL) {
+        return ENOMEM;
+    }
+
+    SAFEALIGN_COPY_UINT32(data, &len, &rp);
+    safealign_memcpy(&data[rp], buf->data, buf->size, &rp);
+
+    /* the request contains the password */
+    safezero(buf->data, buf->size);
+    talloc_free(buf->data);
+
+    buf->data = data;
+    buf->size = rp;
+    return EOK;
+}
+
+static void krb5_child_update_stats(struct krb5_ctx *krb5_ctx,
+                                    struct timeval *start,
+                                    bool pooled)
+{
+    struct krb5_child_stats *stats = &krb5_ctx->child_stats;
+    struct timeval now;
+    uint64_t usec;
+
+    now = tevent_timeval_current();
+    usec = (now.tv_sec - start->tv_sec) * 1000000
+           + (now.tv_usec - start->tv_usec);
+
+    if (pooled) {
+        stats->pooled++;
+        stats->pooled_usec += usec;
+    } else {
+        stats->forked++;
+        stats->forked_usec += usec;
+    }
+    if (usec > stats->max_usec) {
+        stats->max_usec = usec;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "krb5_child request took %"PRIu64" us. Average of %"PRIu64" "
+          "requests handled by the pool: %"PRIu64" us, average of %"PRIu64
+          " forked requests: %"PRIu64" us, maximum: %"PRIu64" us.\n",
+          usec, stats->pooled,
+          stats->pooled ? stats->pooled_usec / stats->pooled : 0,
+          stats->forked,
+          stats->forked ? stats->forked_usec / stats->forked : 0,
+          stats->max_usec);
+}
+
+struct krb5_child_lease {
+    struct krb5_child_worker *worker;
+    bool reusable;
+};
+
+static int krb5_child_lease_destructor(struct krb5_child_lease *lease)
+{
+    krb5_child_pool_put(lease->worker, lease->reusable);
+    return 0;
+}
+
+static errno_t use_pool_worker(struct tevent_req *req,
+                               struct krb5_child_worker *worker,
+                               struct io_buffer *buf)
+{
+    struct handle_child_state *state = tevent_req_data(req,
+                                                     struct handle_child_state);
+    errno_t ret;
+
+    state->lease = talloc_zero(state, struct krb5_child_lease);
+    if (state->lease == NULL) {
+        krb5_child_pool_put(worker, true);
+        return ENOMEM;
+    }
+    state->lease->worker = worker;
+    talloc_set_destructor(state->lease, krb5_child_lease_destructor);
+
+    ret = krb5_child_worker_frame(buf);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL,
+          "Sending request to krb5_child pool worker [%d].\n", worker->pid);
+    state->child_pid = worker->pid;
+
+    ret = activate_child_timeout_handler(req, state->ev,
+              dp_opt_get_int(state->kr->krb5_ctx->opts, KRB5_AUTH_TIMEOUT));
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "activate_child_timeout_handler failed.\n");
+    }
+
+    return EOK;
+}
+
 static void handle_child_step(struct tevent_req *subreq);
 static void handle_child_done(struct tevent_req *subreq);
 
@@ -360,7 +889,9 @@ struct tevent_req *handle_child_send(TALLOC_CTX *mem_ctx,
 {
     struct tevent_req *req, *subreq;
     struct handle_child_state *state;
+    struct krb5_child_worker *worker;
     int ret;
+    int write_fd;
     struct io_buffer *buf = NULL;
 
     req = tevent_req_create(mem_ctx, &state, struct handle_child_state);
@@ -391,14 +922,26 @@ struct tevent_req *handle_child_send(TALLOC_CTX *mem_ctx,
         goto fail;
     }
 
-    ret = fork_child(req);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "fork_child failed.\n");
-        goto fail;
+    state->start = tevent_timeval_current();
+
+    worker = krb5_child_pool_get(kr->krb5_ctx->child_pool);
+    if (worker != NULL) {
+        ret = use_pool_worker(req, worker, buf);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "use_pool_worker failed.\n");
+            goto fail;
+        }
+        write_fd = worker->write_fd;
+    } else {
+        ret = fork_child(req);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "fork_child failed.\n");
+            goto fail;
+        }
+        write_fd = state->io->write_to_child_fd;
     }
 
-    subreq = write_pipe_send(state, ev, buf->data, buf->size,
-                             state->io->write_to_child_fd);
+    subreq = write_pipe_send(state, ev, buf->data, buf->size, write_fd);
     if (!subreq) {
         ret = ENOMEM;
         goto fail;
@@ -428,6 +971,18 @@ static void handle_child_step(struct tevent_req *subreq)
         return;
     }
 
+    if (state->lease != NULL) {
+        /* the worker stays running, the reply is framed */
+        subreq = krb5_child_worker_read_send(state, state->ev,
+                                             state->lease->worker->read_fd);
+        if (!subreq) {
+            tevent_req_error(req, ENOMEM);
+            return;
+        }
+        tevent_req_set_callback(subreq, handle_child_done, req);
+        return;
+    }
+
     close(state->io->write_to_child_fd);
     state->io->write_to_child_fd = -1;
 
@@ -445,19 +1000,37 @@ static void handle_child_done(struct tevent_req *subreq)
                                                       struct tevent_req);
     struct handle_child_state *state = tevent_req_data(req,
                                                     struct handle_child_state);
+    bool pooled;
     int ret;
 
     talloc_zfree(state->timeout_handler);
 
-    ret = read_pipe_recv(subreq, state, &state->buf, &state->len);
-    talloc_zfree(subreq);
-    if (ret != EOK) {
-        tevent_req_error(req, ret);
-        return;
+    pooled = (state->lease != NULL);
+    if (pooled) {
+        ret = krb5_child_worker_read_recv(subreq, state,
+                                          &state->buf, &state->len);
+        talloc_zfree(subreq);
+        if (ret != EOK) {
+            tevent_req_error(req, ret);
+            return;
+        }
+
+        /* a worker whose request failed is replaced */
+        state->lease->reusable = (state->len > 0);
+        talloc_zfree(state->lease);
+    } else {
+        ret = read_pipe_recv(subreq, state, &state->buf, &state->len);
+        talloc_zfree(subreq);
+        if (ret != EOK) {
+            tevent_req_error(req, ret);
+            return;
+        }
+
+        close(state->io->read_from_child_fd);
+        state->io->read_from_child_fd = -1;
     }
 
-    close(state->io->read_from_child_fd);
-    state->io->read_from_child_fd = -1;
+    krb5_child_update_stats(state->kr->krb5_ctx, &state->start, pooled);
 
     tevent_req_done(req);
     return;
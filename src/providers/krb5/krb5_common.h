@@ -68,6 +68,8 @@ enum krb5_opts {
     KRB5_USE_ENTERPRISE_PRINCIPAL,
     KRB5_USE_KDCINFO,
     KRB5_MAP_USER,
+    KRB5_CHILD_POOL_SIZE,
+    KRB5_CHILD_POOL_MAX_REQUESTS,
 
     KRB5_OPTS
 };
@@ -90,6 +92,17 @@ enum krb5_config_type {
     K5C_IPA_SERVER
 };
 
+struct krb5_child_pool;
+
+/* Latency of the krb5_child requests */
+struct krb5_child_stats {
+    uint64_t pooled;        /* requests handled by a pool worker */
+    uint64_t pooled_usec;
+    uint64_t forked;        /* requests that forked a new krb5_child */
+    uint64_t forked_usec;
+    uint64_t max_usec;
+};
+
 struct map_id_name_to_krb_primary {
     const char *id_name;
     const char* krb_primary;
@@ -136,6 +149,9 @@ struct krb5_ctx {
     enum krb5_config_type config_type;
 
     struct map_id_name_to_krb_primary *name_to_primary;
+
+    struct krb5_child_pool *child_pool;
+    struct krb5_child_stats child_stats;
 };
 
 struct remove_info_files_ctx {
@@ -75,6 +75,13 @@ int sdap_id_setup_tasks(struct be_ctx *be_ctx,
         ret = ldap_setup_cleanup(ctx, sdom);
     }
 
+    /* keep the cache up to date between the refreshes */
+    if (ret == EOK && dp_opt_get_bool(ctx->opts->basic, SDAP_USE_SYNCREPL)) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Setting up content synchronization for %s\n",
+                                  sdom->dom->name);
+        ret = ldap_setup_sync(ctx, sdom);
+    }
+
     return ret;
 }
 
@@ -209,6 +209,11 @@ errno_t ldap_setup_cleanup(struct sdap_id_ctx *id_ctx,
 errno_t ldap_id_cleanup(struct sdap_options *opts,
                         struct sdap_domain *sdom);
 
+/* Follows the changes of users and groups on the server with the LDAP
+ * Content Synchronization operation (RFC 4533) */
+errno_t ldap_setup_sync(struct sdap_id_ctx *id_ctx,
+                        struct sdap_domain *sdom);
+
 struct tevent_req *groups_get_send(TALLOC_CTX *memctx,
                                    struct tevent_context *ev,
                                    struct sdap_id_ctx *ctx,
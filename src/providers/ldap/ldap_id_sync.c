@@ -0,0 +1,1110 @@
+/*
+    SSSD
+
+    LDAP Content Synchronization
+
+    Keeps an RFC 4533 refreshAndPersist search open against the server and
+    applies the changes it reports to the cache as they happen, instead of
+    waiting for the next enumeration or refresh to notice them.
+
+    Copyright (C) 2016 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#include <lber.h>
+#include <ldap.h>
+
+#include "util/util.h"
+#include "util/sss_ldap.h"
+#include "db/sysdb.h"
+#include "providers/ldap/ldap_common.h"
+#include "providers/ldap/sdap_async_private.h"
+
+/* Seconds to wait before the session is opened again after it failed */
+#define LDAP_SYNC_RETRY_DELAY 30
+
+/* Number of changed entries written to the cache in one go while the
+ * initial content is being transferred. Once the session is persisting
+ * every change is written as soon as it arrives. */
+#define LDAP_SYNC_BATCH_SIZE 100
+
+enum ldap_sync_entry_type {
+    LDAP_SYNC_ENTRY_UNKNOWN,
+    LDAP_SYNC_ENTRY_USER,
+    LDAP_SYNC_ENTRY_GROUP,
+};
+
+struct ldap_sync_stale {
+    enum ldap_sync_entry_type type;
+    const char *name;
+};
+
+/* Changes read from the server that are not in the cache yet */
+struct ldap_sync_batch {
+    struct sysdb_attrs *users[LDAP_SYNC_BATCH_SIZE];
+    size_t num_users;
+    struct sysdb_attrs *groups[LDAP_SYNC_BATCH_SIZE];
+    size_t num_groups;
+
+    /* cached names of the changed entries, dropped from the memory cache
+     * once the batch is written */
+    struct ldap_sync_stale stale[LDAP_SYNC_BATCH_SIZE];
+    size_t num_stale;
+};
+
+struct ldap_sync_ctx {
+    struct sdap_id_ctx *id_ctx;
+    struct sdap_domain *sdom;
+
+    char *filter;
+    const char **attrs;
+
+    struct sdap_id_op *op;
+    struct sdap_op *ldap_op;
+    struct tevent_timer *timer;
+    errno_t error;
+
+    /* the synchronization state, the session resumes from it */
+    struct berval cookie;
+    bool refreshing;
+    bool refresh_required;
+    struct timeval refresh_start;
+    size_t num_changes;
+
+    struct ldap_sync_batch *batch;
+};
+
+static void ldap_sync_schedule(struct ldap_sync_ctx *ctx, time_t delay,
+                               tevent_timer_handler_t handler);
+static void ldap_sync_connect(struct tevent_context *ev,
+                              struct tevent_timer *te,
+                              struct timeval tv, void *pvt);
+static void ldap_sync_connected(struct tevent_req *subreq);
+static errno_t ldap_sync_search(struct ldap_sync_ctx *ctx);
+static void ldap_sync_reply(struct sdap_op *op, struct sdap_msg *reply,
+                            int error, void *pvt);
+static void ldap_sync_stop(struct ldap_sync_ctx *ctx, errno_t error);
+static void ldap_sync_restart(struct tevent_context *ev,
+                              struct tevent_timer *te,
+                              struct timeval tv, void *pvt);
+static errno_t ldap_sync_flush(struct ldap_sync_ctx *ctx);
+
+static errno_t ldap_sync_build_attrs(struct ldap_sync_ctx *ctx)
+{
+    struct sdap_options *opts = ctx->id_ctx->opts;
+    const char **user_attrs;
+    const char **group_attrs;
+    size_t num_user_attrs;
+    size_t num_group_attrs;
+    errno_t ret;
+
+    ret = build_attrs_from_map(ctx, opts->user_map, opts->user_map_cnt,
+                               NULL, &user_attrs, &num_user_attrs);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = build_attrs_from_map(ctx, opts->group_map, SDAP_OPTS_GROUP,
+                               NULL, &group_attrs, &num_group_attrs);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ctx->attrs = talloc_realloc(ctx, user_attrs, const char *,
+                                num_user_attrs + num_group_attrs + 1);
+    if (ctx->attrs == NULL) {
+        return ENOMEM;
+    }
+
+    memcpy(&ctx->attrs[num_user_attrs], group_attrs,
+           num_group_attrs * sizeof(const char *));
+    ctx->attrs[num_user_attrs + num_group_attrs] = NULL;
+    talloc_steal(ctx->attrs, group_attrs);
+
+    return EOK;
+}
+
+errno_t ldap_setup_sync(struct sdap_id_ctx *id_ctx,
+                        struct sdap_domain *sdom)
+{
+    struct sdap_options *opts = id_ctx->opts;
+    struct ldap_sync_ctx *ctx;
+    errno_t ret;
+
+    if (sdom->search_bases == NULL || sdom->search_bases[0] == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "No search base for domain %s, cannot set up the LDAP "
+              "Content Synchronization\n", sdom->dom->name);
+        return EINVAL;
+    }
+
+    ctx = talloc_zero(sdom, struct ldap_sync_ctx);
+    if (ctx == NULL) {
+        return ENOMEM;
+    }
+    ctx->id_ctx = id_ctx;
+    ctx->sdom = sdom;
+
+    ctx->filter = talloc_asprintf(ctx, "(|(objectclass=%s)(objectclass=%s)",
+                                  opts->user_map[SDAP_OC_USER].name,
+                                  opts->group_map[SDAP_OC_GROUP].name);
+    if (ctx->filter != NULL && opts->group_map[SDAP_OC_GROUP_ALT].name) {
+        ctx->filter = talloc_asprintf_append_buffer(ctx->filter,
+                                "(objectclass=%s)",
+                                opts->group_map[SDAP_OC_GROUP_ALT].name);
+    }
+    if (ctx->filter != NULL) {
+        ctx->filter = talloc_asprintf_append_buffer(ctx->filter, ")");
+    }
+    if (ctx->filter == NULL) {
+        ret = ENOMEM;
+        goto fail;
+    }
+
+    ret = ldap_sync_build_attrs(ctx);
+    if (ret != EOK) {
+        goto fail;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "Setting up LDAP Content Synchronization for %s\n",
+          sdom->dom->name);
+
+    /* start once the main loop is running */
+    ldap_sync_schedule(ctx, 0, ldap_sync_connect);
+    if (ctx->timer == NULL) {
+        ret = ENOMEM;
+        goto fail;
+    }
+
+    return EOK;
+
+fail:
+    talloc_free(ctx);
+    return ret;
+}
+
+static void ldap_sync_schedule(struct ldap_sync_ctx *ctx, time_t delay,
+                               tevent_timer_handler_t handler)
+{
+    struct timeval tv;
+
+    talloc_zfree(ctx->timer);
+
+    tv = tevent_timeval_current_ofs(delay, 0);
+    ctx->timer = tevent_add_timer(ctx->id_ctx->be->ev, ctx, tv,
+                                  handler, ctx);
+    if (ctx->timer == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Cannot schedule the LDAP Content Synchronization, "
+              "changes will only be seen by the regular refreshes\n");
+    }
+}
+
+static void ldap_sync_connect(struct tevent_context *ev,
+                              struct tevent_timer *te,
+                              struct timeval tv, void *pvt)
+{
+    struct ldap_sync_ctx *ctx = talloc_get_type(pvt, struct ldap_sync_ctx);
+    struct tevent_req *subreq;
+    errno_t ret;
+
+    ctx->timer = NULL;
+
+    if (ctx->op == NULL) {
+        ctx->op = sdap_id_op_create(ctx, ctx->id_ctx->conn->conn_cache);
+        if (ctx->op == NULL) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "sdap_id_op_create failed\n");
+            ldap_sync_schedule(ctx, LDAP_SYNC_RETRY_DELAY, ldap_sync_connect);
+            return;
+        }
+
+        /* the search runs until the connection is closed */
+        sdap_id_op_set_long_lived(ctx->op);
+    }
+
+    subreq = sdap_id_op_connect_send(ctx->op, ctx, &ret);
+    if (subreq == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "sdap_id_op_connect_send failed: %d\n", ret);
+        talloc_zfree(ctx->op);
+        ldap_sync_schedule(ctx, LDAP_SYNC_RETRY_DELAY, ldap_sync_connect);
+        return;
+    }
+
+    tevent_req_set_callback(subreq, ldap_sync_connected, ctx);
+}
+
+static void ldap_sync_connected(struct tevent_req *subreq)
+{
+    struct ldap_sync_ctx *ctx = tevent_req_callback_data(subreq,
+                                                    struct ldap_sync_ctx);
+    int dp_error;
+    errno_t ret;
+
+    ret = sdap_id_op_connect_recv(subreq, &dp_error);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        if (dp_error == DP_ERR_OFFLINE) {
+            DEBUG(SSSDBG_TRACE_FUNC,
+                  "Backend is offline, retrying the LDAP Content "
+                  "Synchronization later\n");
+        } else {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "LDAP Content Synchronization failed to connect to "
+                  "LDAP server: (%d)[%s]\n", ret, sss_strerror(ret));
+        }
+        talloc_zfree(ctx->op);
+        ldap_sync_schedule(ctx, LDAP_SYNC_RETRY_DELAY, ldap_sync_connect);
+        return;
+    }
+
+    ret = ldap_sync_search(ctx);
+    if (ret != EOK) {
+        ldap_sync_stop(ctx, ret);
+        return;
+    }
+}
+
+static errno_t ldap_sync_create_control(struct berval *cookie,
+                                        LDAPControl **_ctrl)
+{
+    BerElement *ber;
+    struct berval *value = NULL;
+    int lret;
+    errno_t ret;
+
+    ber = ber_alloc_t(LBER_USE_DER);
+    if (ber == NULL) {
+        return ENOMEM;
+    }
+
+    if (cookie->bv_val != NULL) {
+        lret = ber_printf(ber, "{eO}", LDAP_SYNC_REFRESH_AND_PERSIST, cookie);
+    } else {
+        lret = ber_printf(ber, "{e}", LDAP_SYNC_REFRESH_AND_PERSIST);
+    }
+    if (lret == -1) {
+        DEBUG(SSSDBG_OP_FAILURE, "ber_printf failed\n");
+        ret = EIO;
+        goto done;
+    }
+
+    lret = ber_flatten(ber, &value);
+    if (lret == -1) {
+        DEBUG(SSSDBG_OP_FAILURE, "ber_flatten failed\n");
+        ret = EIO;
+        goto done;
+    }
+
+    lret = sss_ldap_control_create(LDAP_CONTROL_SYNC, 1, value, 1, _ctrl);
+    if (lret != LDAP_SUCCESS) {
+        DEBUG(SSSDBG_OP_FAILURE, "sss_ldap_control_create failed [%d][%s]\n",
+              lret, sss_ldap_err2string(lret));
+        ret = EIO;
+        goto done;
+    }
+
+    ret = EOK;
+
+done:
+    ber_bvfree(value);
+    ber_free(ber, 1);
+    return ret;
+}
+
+static errno_t ldap_sync_search(struct ldap_sync_ctx *ctx)
+{
+    struct sdap_handle *sh = sdap_id_op_handle(ctx->op);
+    struct sdap_search_base *base = ctx->sdom->search_bases[0];
+    LDAPControl *ctrls[2] = { NULL, NULL };
+    int msgid;
+    int lret;
+    errno_t ret;
+
+    ret = ldap_sync_create_control(&ctx->cookie, &ctrls[0]);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "Starting LDAP Content Synchronization of [%s][%s]%s\n",
+          base->basedn, ctx->filter,
+          ctx->cookie.bv_val != NULL ? ", resuming the previous session" : "");
+
+    lret = ldap_search_ext(sh->ldap, base->basedn, base->scope, ctx->filter,
+                           discard_const(ctx->attrs), 0, ctrls, NULL, NULL,
+                           0, &msgid);
+    ldap_control_free(ctrls[0]);
+    if (lret != LDAP_SUCCESS) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "ldap_search_ext failed: %s\n", sss_ldap_err2string(lret));
+        return lret == LDAP_SERVER_DOWN ? ETIMEDOUT : EIO;
+    }
+
+    /* the search never finishes on its own, so it has no timeout */
+    ret = sdap_op_add(ctx, ctx->id_ctx->be->ev, sh, msgid,
+                      ldap_sync_reply, ctx, 0, &ctx->ldap_op);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to set up operation!\n");
+        return ret;
+    }
+
+    ctx->refreshing = true;
+    ctx->refresh_required = false;
+    ctx->refresh_start = tevent_timeval_current();
+    ctx->num_changes = 0;
+
+    return EOK;
+}
+
+static errno_t ldap_sync_set_cookie(struct ldap_sync_ctx *ctx,
+                                    struct berval *cookie)
+{
+    char *val = NULL;
+
+    if (cookie != NULL && cookie->bv_val != NULL) {
+        val = talloc_memdup(ctx, cookie->bv_val, cookie->bv_len);
+        if (val == NULL) {
+            return ENOMEM;
+        }
+    }
+
+    talloc_free(ctx->cookie.bv_val);
+    ctx->cookie.bv_val = val;
+    ctx->cookie.bv_len = val != NULL ? cookie->bv_len : 0;
+
+    return EOK;
+}
+
+static errno_t ldap_sync_parse_state(struct ldap_sync_ctx *ctx,
+                                     struct sdap_handle *sh,
+                                     LDAPMessage *msg,
+                                     int *_state)
+{
+    LDAPControl **ctrls = NULL;
+    LDAPControl *ctrl;
+    BerElement *ber = NULL;
+    struct berval uuid;
+    struct berval cookie;
+    ber_int_t state;
+    ber_len_t len;
+    int lret;
+    errno_t ret;
+
+    lret = ldap_get_entry_controls(sh->ldap, msg, &ctrls);
+    if (lret != LDAP_SUCCESS) {
+        DEBUG(SSSDBG_OP_FAILURE, "ldap_get_entry_controls failed [%s]\n",
+              sss_ldap_err2string(lret));
+        return EIO;
+    }
+
+    ctrl = ldap_control_find(LDAP_CONTROL_SYNC_STATE, ctrls, NULL);
+    if (ctrl == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE, "Entry without a Sync State Control\n");
+        ret = EINVAL;
+        goto done;
+    }
+
+    ber = ber_init(&ctrl->ldctl_value);
+    if (ber == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    if (ber_scanf(ber, "{em", &state, &uuid) == LBER_ERROR) {
+        DEBUG(SSSDBG_OP_FAILURE, "Malformed Sync State Control\n");
+        ret = EINVAL;
+        goto done;
+    }
+
+    if (ber_peek_tag(ber, &len) == LDAP_TAG_SYNC_COOKIE) {
+        if (ber_scanf(ber, "m", &cookie) == LBER_ERROR) {
+            ret = EINVAL;
+            goto done;
+        }
+
+        ret = ldap_sync_set_cookie(ctx, &cookie);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    *_state = state;
+    ret = EOK;
+
+done:
+    if (ber != NULL) {
+        ber_free(ber, 1);
+    }
+    ldap_controls_free(ctrls);
+    return ret;
+}
+
+static bool ldap_sync_oc_matches(const char *oc, struct berval *val)
+{
+    if (oc == NULL) {
+        return false;
+    }
+
+    return strlen(oc) == val->bv_len
+           && strncasecmp(oc, val->bv_val, val->bv_len) == 0;
+}
+
+static enum ldap_sync_entry_type
+ldap_sync_entry_type(struct ldap_sync_ctx *ctx,
+                     struct sdap_handle *sh,
+                     LDAPMessage *msg)
+{
+    struct sdap_options *opts = ctx->id_ctx->opts;
+    enum ldap_sync_entry_type type = LDAP_SYNC_ENTRY_UNKNOWN;
+    struct berval **vals;
+    int i;
+
+    vals = ldap_get_values_len(sh->ldap, msg, "objectClass");
+    if (vals == NULL) {
+        return LDAP_SYNC_ENTRY_UNKNOWN;
+    }
+
+    for (i = 0; vals[i] != NULL; i++) {
+        if (ldap_sync_oc_matches(opts->user_map[SDAP_OC_USER].name,
+                                 vals[i])) {
+            type = LDAP_SYNC_ENTRY_USER;
+            break;
+        }
+
+        if (ldap_sync_oc_matches(opts->group_map[SDAP_OC_GROUP].name,
+                                 vals[i])
+                || ldap_sync_oc_matches(
+                            opts->group_map[SDAP_OC_GROUP_ALT].name,
+                            vals[i])) {
+            type = LDAP_SYNC_ENTRY_GROUP;
+            break;
+        }
+    }
+
+    ldap_value_free_len(vals);
+    return type;
+}
+
+/* Finds the cached object that was stored from the entry with the given DN */
+static errno_t ldap_sync_find_cached(TALLOC_CTX *mem_ctx,
+                                     struct ldap_sync_ctx *ctx,
+                                     const char *dn,
+                                     enum ldap_sync_entry_type *_type,
+                                     const char **_name,
+                                     const char **_modstamp)
+{
+    TALLOC_CTX *tmp_ctx;
+    const char *attrs[] = { SYSDB_NAME, SYSDB_ORIG_MODSTAMP, NULL };
+    struct ldb_message **msgs;
+    enum ldap_sync_entry_type type;
+    size_t count = 0;
+    char *sanitized;
+    char *filter;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sss_filter_sanitize(tmp_ctx, dn, &sanitized);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    filter = talloc_asprintf(tmp_ctx, "(%s=%s)", SYSDB_ORIG_DN, sanitized);
+    if (filter == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    type = LDAP_SYNC_ENTRY_USER;
+    ret = sysdb_search_users(tmp_ctx, ctx->sdom->dom, filter, attrs,
+                             &count, &msgs);
+    if (ret == ENOENT || (ret == EOK && count == 0)) {
+        type = LDAP_SYNC_ENTRY_GROUP;
+        ret = sysdb_search_groups(tmp_ctx, ctx->sdom->dom, filter, attrs,
+                                  &count, &msgs);
+    }
+    if (ret == EOK && count == 0) {
+        ret = ENOENT;
+    }
+    if (ret != EOK) {
+        goto done;
+    }
+
+    *_type = type;
+    *_name = talloc_strdup(mem_ctx,
+                    ldb_msg_find_attr_as_string(msgs[0], SYSDB_NAME, NULL));
+    if (*_name == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+    *_modstamp = talloc_strdup(mem_ctx,
+                    ldb_msg_find_attr_as_string(msgs[0], SYSDB_ORIG_MODSTAMP,
+                                                ""));
+    if (*_modstamp == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static void ldap_sync_invalidate(struct ldap_sync_ctx *ctx,
+                                 enum ldap_sync_entry_type type,
+                                 const char *name)
+{
+    errno_t ret;
+
+    ret = be_invalidate_memcache_entry(ctx->id_ctx->be,
+                                       type == LDAP_SYNC_ENTRY_USER ?
+                                            BE_REQ_USER : BE_REQ_GROUP,
+                                       ctx->sdom->dom->name, name);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Could not invalidate [%s] in the memory cache [%d]: %s\n",
+              name, ret, sss_strerror(ret));
+    }
+}
+
+static errno_t ldap_sync_delete(struct ldap_sync_ctx *ctx,
+                                enum ldap_sync_entry_type type,
+                                const char *name)
+{
+    errno_t ret;
+
+    /* changes that arrived earlier must not be written after this one */
+    ret = ldap_sync_flush(ctx);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    if (type == LDAP_SYNC_ENTRY_USER) {
+        ret = sysdb_delete_user(ctx->sdom->dom, name, 0);
+    } else {
+        ret = sysdb_delete_group(ctx->sdom->dom, name, 0);
+    }
+    if (ret != EOK && ret != ENOENT) {
+        DEBUG(SSSDBG_OP_FAILURE, "Cannot delete [%s] from the cache [%d]: %s\n",
+              name, ret, sss_strerror(ret));
+        return ret;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Deleted %s [%s] removed from the server\n",
+          type == LDAP_SYNC_ENTRY_USER ? "user" : "group", name);
+
+    ldap_sync_invalidate(ctx, type, name);
+    return EOK;
+}
+
+static errno_t ldap_sync_add(struct ldap_sync_ctx *ctx,
+                             struct sdap_handle *sh,
+                             struct sdap_msg *reply,
+                             enum ldap_sync_entry_type cached_type,
+                             const char *cached_name,
+                             const char *cached_modstamp)
+{
+    struct sdap_options *opts = ctx->id_ctx->opts;
+    enum ldap_sync_entry_type type;
+    struct ldap_sync_batch *batch;
+    struct sysdb_attrs *attrs;
+    const char *modstamp;
+    bool disable_range_rtrvl;
+    errno_t ret;
+
+    type = ldap_sync_entry_type(ctx, sh, reply->msg);
+    if (type == LDAP_SYNC_ENTRY_UNKNOWN) {
+        DEBUG(SSSDBG_TRACE_INTERNAL, "Ignoring entry of unknown type\n");
+        return EOK;
+    }
+
+    if (ctx->batch == NULL) {
+        ctx->batch = talloc_zero(ctx, struct ldap_sync_batch);
+        if (ctx->batch == NULL) {
+            return ENOMEM;
+        }
+    }
+    batch = ctx->batch;
+
+    disable_range_rtrvl = dp_opt_get_bool(opts->basic,
+                                          SDAP_DISABLE_RANGE_RETRIEVAL);
+
+    if (type == LDAP_SYNC_ENTRY_USER) {
+        ret = sdap_parse_entry(batch, sh, reply,
+                               opts->user_map, opts->user_map_cnt,
+                               &attrs, disable_range_rtrvl);
+    } else {
+        ret = sdap_parse_entry(batch, sh, reply,
+                               opts->group_map, SDAP_OPTS_GROUP,
+                               &attrs, disable_range_rtrvl);
+    }
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "sdap_parse_entry failed [%d]: %s\n", ret, sss_strerror(ret));
+        return ret;
+    }
+
+    /* The initial content includes every entry, skip the ones the cache
+     * already has in this version. Later notifications are always applied,
+     * the modification timestamp is too coarse to tell changes apart. */
+    if (ctx->refreshing && cached_name != NULL && cached_type == type) {
+        ret = sysdb_attrs_get_string(attrs, SYSDB_ORIG_MODSTAMP, &modstamp);
+        if (ret == EOK && strcmp(modstamp, cached_modstamp) == 0) {
+            talloc_free(attrs);
+            return EOK;
+        }
+    }
+
+    if (type == LDAP_SYNC_ENTRY_USER) {
+        batch->users[batch->num_users++] = attrs;
+    } else {
+        batch->groups[batch->num_groups++] = attrs;
+    }
+
+    if (cached_name != NULL) {
+        batch->stale[batch->num_stale].type = cached_type;
+        batch->stale[batch->num_stale].name = talloc_steal(batch,
+                                                           cached_name);
+        batch->num_stale++;
+    }
+
+    ctx->num_changes++;
+
+    if (ctx->refreshing == false
+            || batch->num_users + batch->num_groups == LDAP_SYNC_BATCH_SIZE) {
+        return ldap_sync_flush(ctx);
+    }
+
+    return EOK;
+}
+
+static errno_t ldap_sync_entry(struct ldap_sync_ctx *ctx,
+                               struct sdap_handle *sh,
+                               struct sdap_msg *reply)
+{
+    TALLOC_CTX *tmp_ctx;
+    enum ldap_sync_entry_type cached_type = LDAP_SYNC_ENTRY_UNKNOWN;
+    const char *cached_name = NULL;
+    const char *cached_modstamp = NULL;
+    char *ldap_dn;
+    char *dn;
+    int state;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = ldap_sync_parse_state(ctx, sh, reply->msg, &state);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    if (state == LDAP_SYNC_PRESENT) {
+        /* unchanged entry of a present phase */
+        ret = EOK;
+        goto done;
+    }
+
+    ldap_dn = ldap_get_dn(sh->ldap, reply->msg);
+    if (ldap_dn == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE, "ldap_get_dn failed\n");
+        ret = EIO;
+        goto done;
+    }
+    dn = talloc_strdup(tmp_ctx, ldap_dn);
+    ldap_memfree(ldap_dn);
+    if (dn == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = ldap_sync_find_cached(tmp_ctx, ctx, dn, &cached_type,
+                                &cached_name, &cached_modstamp);
+    if (ret != EOK && ret != ENOENT) {
+        goto done;
+    }
+
+    switch (state) {
+    case LDAP_SYNC_ADD:
+    case LDAP_SYNC_MODIFY:
+        ret = ldap_sync_add(ctx, sh, reply, cached_type, cached_name,
+                            cached_modstamp);
+        break;
+    case LDAP_SYNC_DELETE:
+        if (cached_name == NULL) {
+            DEBUG(SSSDBG_TRACE_INTERNAL, "[%s] is not cached\n", dn);
+            ret = EOK;
+            break;
+        }
+        ctx->num_changes++;
+        ret = ldap_sync_delete(ctx, cached_type, cached_name);
+        break;
+    default:
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unknown sync state %d of [%s]\n",
+              state, dn);
+        ret = EOK;
+        break;
+    }
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static void ldap_sync_refresh_done(struct ldap_sync_ctx *ctx,
+                                   bool present_phase)
+{
+    struct timeval now;
+    struct timeval diff;
+    errno_t ret;
+
+    ret = ldap_sync_flush(ctx);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Cannot write the pending changes [%d]: %s\n",
+              ret, sss_strerror(ret));
+    }
+
+    ctx->refreshing = false;
+
+    now = tevent_timeval_current();
+    diff = tevent_timeval_until(&ctx->refresh_start, &now);
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "LDAP Content Synchronization of %s is up to date after "
+          "%ld.%03ld seconds, %zu entries changed\n",
+          ctx->sdom->dom->name, (long) diff.tv_sec,
+          (long) diff.tv_usec / 1000, ctx->num_changes);
+
+    if (present_phase) {
+        /* Entries missing from a present phase were deleted, but they are
+         * only known by their entryUUID */
+        DEBUG(SSSDBG_TRACE_FUNC,
+              "Entries deleted while the session was down are left to the "
+              "cache cleanup task\n");
+    }
+}
+
+static errno_t ldap_sync_info(struct ldap_sync_ctx *ctx,
+                              struct sdap_handle *sh,
+                              struct sdap_msg *reply)
+{
+    char *oid = NULL;
+    struct berval *data = NULL;
+    BerElement *ber = NULL;
+    struct berval cookie;
+    ber_tag_t tag;
+    ber_tag_t info;
+    ber_len_t len;
+    ber_int_t refresh_done = 1;
+    ber_int_t refresh_deletes = 0;
+    int lret;
+    errno_t ret;
+
+    lret = ldap_parse_intermediate(sh->ldap, reply->msg, &oid, &data,
+                                   NULL, 0);
+    if (lret != LDAP_SUCCESS) {
+        DEBUG(SSSDBG_OP_FAILURE, "ldap_parse_intermediate failed [%s]\n",
+              sss_ldap_err2string(lret));
+        return EIO;
+    }
+
+    if (oid == NULL || strcmp(oid, LDAP_SYNC_INFO) != 0 || data == NULL) {
+        DEBUG(SSSDBG_TRACE_INTERNAL, "Ignoring intermediate response [%s]\n",
+              oid != NULL ? oid : "no oid");
+        ret = EOK;
+        goto done;
+    }
+
+    ber = ber_init(data);
+    if (ber == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    info = ber_peek_tag(ber, &len);
+    switch (info) {
+    case LDAP_TAG_SYNC_NEW_COOKIE:
+        if (ber_scanf(ber, "m", &cookie) == LBER_ERROR) {
+            ret = EINVAL;
+            goto done;
+        }
+        ret = ldap_sync_set_cookie(ctx, &cookie);
+        break;
+
+    case LDAP_TAG_SYNC_REFRESH_DELETE:
+    case LDAP_TAG_SYNC_REFRESH_PRESENT:
+    case LDAP_TAG_SYNC_ID_SET:
+        if (ber_scanf(ber, "{") == LBER_ERROR) {
+            ret = EINVAL;
+            goto done;
+        }
+
+        tag = ber_peek_tag(ber, &len);
+        if (tag == LDAP_TAG_SYNC_COOKIE) {
+            if (ber_scanf(ber, "m", &cookie) == LBER_ERROR) {
+                ret = EINVAL;
+                goto done;
+            }
+            ret = ldap_sync_set_cookie(ctx, &cookie);
+            if (ret != EOK) {
+                goto done;
+            }
+            tag = ber_peek_tag(ber, &len);
+        }
+
+        if (info == LDAP_TAG_SYNC_ID_SET) {
+            if (tag == LDAP_TAG_REFRESHDELETES) {
+                ber_scanf(ber, "b", &refresh_deletes);
+            }
+
+            DEBUG(SSSDBG_TRACE_FUNC,
+                  "The server reported %s entries by their entryUUID only, "
+                  "they are left to the cache cleanup task\n",
+                  refresh_deletes ? "deleted" : "present");
+            ret = EOK;
+            break;
+        }
+
+        if (tag == LDAP_TAG_REFRESHDONE) {
+            ber_scanf(ber, "b", &refresh_done);
+        }
+
+        if (refresh_done && ctx->refreshing) {
+            ldap_sync_refresh_done(ctx,
+                                   info == LDAP_TAG_SYNC_REFRESH_PRESENT);
+        }
+        ret = EOK;
+        break;
+
+    default:
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unknown Sync Info Message [%lx]\n",
+              (unsigned long) info);
+        ret = EOK;
+        break;
+    }
+
+done:
+    if (ber != NULL) {
+        ber_free(ber, 1);
+    }
+    ldap_memfree(oid);
+    ber_bvfree(data);
+    return ret;
+}
+
+static errno_t ldap_sync_result(struct ldap_sync_ctx *ctx,
+                                struct sdap_handle *sh,
+                                struct sdap_msg *reply)
+{
+    char *errmsg = NULL;
+    int result;
+    int lret;
+    errno_t ret;
+
+    lret = ldap_parse_result(sh->ldap, reply->msg, &result, NULL, &errmsg,
+                             NULL, NULL, 0);
+    if (lret != LDAP_SUCCESS) {
+        DEBUG(SSSDBG_OP_FAILURE, "ldap_parse_result failed [%s]\n",
+              sss_ldap_err2string(lret));
+        return EIO;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "LDAP Content Synchronization ended: %s(%d), %s\n",
+          sss_ldap_err2string(result), result,
+          errmsg ? errmsg : "no errmsg set");
+
+    switch (result) {
+    case LDAP_SUCCESS:
+        ret = EOK;
+        break;
+    case LDAP_SYNC_REFRESH_REQUIRED:
+        /* the server cannot resume from our cookie, start over */
+        ldap_sync_set_cookie(ctx, NULL);
+        ctx->refresh_required = true;
+        ret = EOK;
+        break;
+    case LDAP_UNAVAILABLE_CRITICAL_EXTENSION:
+        ret = ENOTSUP;
+        break;
+    default:
+        ret = EIO;
+        break;
+    }
+
+    ldap_memfree(errmsg);
+    return ret;
+}
+
+static void ldap_sync_reply(struct sdap_op *op, struct sdap_msg *reply,
+                            int error, void *pvt)
+{
+    struct ldap_sync_ctx *ctx = talloc_get_type(pvt, struct ldap_sync_ctx);
+    errno_t ret;
+
+    if (error != EOK) {
+        ldap_sync_stop(ctx, error);
+        return;
+    }
+
+    switch (ldap_msgtype(reply->msg)) {
+    case LDAP_RES_SEARCH_ENTRY:
+        ret = ldap_sync_entry(ctx, op->sh, reply);
+        break;
+    case LDAP_RES_INTERMEDIATE:
+        ret = ldap_sync_info(ctx, op->sh, reply);
+        break;
+    case LDAP_RES_SEARCH_REFERENCE:
+        /* referrals are not followed */
+        ret = EOK;
+        break;
+    case LDAP_RES_SEARCH_RESULT:
+        ret = ldap_sync_result(ctx, op->sh, reply);
+        ldap_sync_stop(ctx, ret);
+        return;
+    default:
+        ret = EIO;
+        break;
+    }
+
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot process LDAP Content Synchronization message [%d]: %s\n",
+              ret, sss_strerror(ret));
+        ldap_sync_stop(ctx, ret);
+        return;
+    }
+
+    sdap_unlock_next_reply(op);
+}
+
+/* Ends the running search. This may be called while the connection is
+ * being released, so the rest is done from the main loop. */
+static void ldap_sync_stop(struct ldap_sync_ctx *ctx, errno_t error)
+{
+    ctx->error = error;
+    talloc_zfree(ctx->ldap_op);
+
+    ldap_sync_schedule(ctx, 0, ldap_sync_restart);
+}
+
+static void ldap_sync_restart(struct tevent_context *ev,
+                              struct tevent_timer *te,
+                              struct timeval tv, void *pvt)
+{
+    struct ldap_sync_ctx *ctx = talloc_get_type(pvt, struct ldap_sync_ctx);
+    int dp_error;
+    errno_t ret;
+
+    ctx->timer = NULL;
+
+    ret = ldap_sync_flush(ctx);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Cannot write the pending changes [%d]: %s\n",
+              ret, sss_strerror(ret));
+    }
+
+    if (ctx->error == ENOTSUP) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "The server does not support the LDAP Content Synchronization "
+              "operation, changes will only be seen by the regular "
+              "refreshes\n");
+        sss_log(SSS_LOG_ERR, "ldap_use_syncrepl is set, but the server does "
+                "not support the LDAP Content Synchronization operation");
+        talloc_zfree(ctx->op);
+        return;
+    }
+
+    ret = sdap_id_op_done(ctx->op, ctx->error, &dp_error);
+    if (dp_error == DP_ERR_OK && ret != EOK) {
+        /* the connection was lost, reconnect */
+        ldap_sync_schedule(ctx, 0, ldap_sync_connect);
+        return;
+    }
+
+    talloc_zfree(ctx->op);
+
+    if (ctx->refresh_required) {
+        ldap_sync_schedule(ctx, 0, ldap_sync_connect);
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "Restarting LDAP Content Synchronization in %d seconds\n",
+          LDAP_SYNC_RETRY_DELAY);
+    ldap_sync_schedule(ctx, LDAP_SYNC_RETRY_DELAY, ldap_sync_connect);
+}
+
+/* Writes the pending changes to the cache and drops the entries they
+ * replace from the memory cache */
+static errno_t ldap_sync_flush(struct ldap_sync_ctx *ctx)
+{
+    struct ldap_sync_batch *batch = ctx->batch;
+    struct sdap_options *opts = ctx->id_ctx->opts;
+    struct sss_domain_info *dom = ctx->sdom->dom;
+    size_t i;
+    errno_t ret;
+
+    if (batch == NULL) {
+        return EOK;
+    }
+
+    if (batch->num_users > 0) {
+        ret = sdap_save_users(batch, dom->sysdb, dom, opts,
+                              batch->users, batch->num_users, NULL);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "Failed to store users [%d]: %s\n",
+                  ret, sss_strerror(ret));
+            goto done;
+        }
+    }
+
+    if (batch->num_groups > 0) {
+        ret = sdap_save_groups(batch, dom->sysdb, dom, opts,
+                               batch->groups, batch->num_groups,
+                               !dom->ignore_group_members, NULL, false, NULL);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "Failed to store groups [%d]: %s\n",
+                  ret, sss_strerror(ret));
+            goto done;
+        }
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Stored %zu changed users and %zu groups\n",
+          batch->num_users, batch->num_groups);
+
+    for (i = 0; i < batch->num_stale; i++) {
+        ldap_sync_invalidate(ctx, batch->stale[i].type, batch->stale[i].name);
+    }
+
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        /* the changes are lost, so the session must not resume past them */
+        ldap_sync_set_cookie(ctx, NULL);
+    }
+    talloc_zfree(ctx->batch);
+    return ret;
+}
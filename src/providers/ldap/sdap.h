@@ -51,6 +51,10 @@ struct sdap_op {
     struct tevent_context *ev;
     struct sdap_msg *list;
     struct sdap_msg *last;
+
+    /* latency tracing of the request that started the operation */
+    uint32_t rid;
+    struct timeval start;
 };
 
 struct fd_event_item {
@@ -233,6 +237,11 @@ enum sdap_basic_opt {
     SDAP_MAX_ID,
     SDAP_PWDLOCKOUT_DN,
     SDAP_WILDCARD_LIMIT,
+    SDAP_NESTED_GROUP_PARALLEL,
+    SDAP_NESTED_GROUP_BATCH_SIZE,
+    SDAP_USE_SYNCREPL,
+    SDAP_CONNECTION_POOL_SIZE,
+    SDAP_CONNECTION_POOL_MAX_OPS,
 
     SDAP_OPTS_BASIC /* opts counter */
 };
@@ -23,6 +23,7 @@
 #include <ctype.h>
 #include "util/util.h"
 #include "util/strtonum.h"
+#include "util/sss_latency.h"
 #include "providers/ldap/sdap_async_private.h"
 
 #define REPLY_REALLOC_INCREMENT 10
@@ -261,6 +262,7 @@ static void sdap_process_message(struct tevent_context *ev,
 {
     struct sdap_msg *reply;
     struct sdap_op *op;
+    uint32_t prev_rid;
     int msgid;
     int msgtype;
     int ret;
@@ -300,7 +302,9 @@ static void sdap_process_message(struct tevent_context *ev,
     switch (msgtype) {
     case LDAP_RES_SEARCH_ENTRY:
     case LDAP_RES_SEARCH_REFERENCE:
-        /* go and process entry */
+    case LDAP_RES_INTERMEDIATE:
+        /* go and process entry, an intermediate response is never the
+         * last one of an operation (RFC 4511, 4.13) */
         break;
 
     case LDAP_RES_BIND:
@@ -311,9 +315,9 @@ static void sdap_process_message(struct tevent_context *ev,
     case LDAP_RES_MODDN:
     case LDAP_RES_COMPARE:
     case LDAP_RES_EXTENDED:
-    case LDAP_RES_INTERMEDIATE:
         /* no more results expected with this msgid */
         op->done = true;
+        sss_latency_record(op->rid, SSS_LATENCY_LDAP_OP, &op->start);
         break;
 
     default:
@@ -349,11 +353,13 @@ static void sdap_process_message(struct tevent_context *ev,
 
         /* must be the last operation as it may end up freeing all memory
          * including all ops handlers */
+        prev_rid = sss_latency_set_current(op->rid);
         op->callback(op, reply, ret, op->data);
+        sss_latency_set_current(prev_rid);
     }
 }
 
-static void sdap_unlock_next_reply(struct sdap_op *op)
+void sdap_unlock_next_reply(struct sdap_op *op)
 {
     struct timeval tv;
     struct tevent_timer *te;
@@ -392,8 +398,11 @@ static void sdap_process_next_reply(struct tevent_context *ev,
                                     struct timeval tv, void *pvt)
 {
     struct sdap_op *op = talloc_get_type(pvt, struct sdap_op);
+    uint32_t prev_rid;
 
+    prev_rid = sss_latency_set_current(op->rid);
     op->callback(op, op->list, EOK, op->data);
+    sss_latency_set_current(prev_rid);
 }
 
 /* ==LDAP-Operations-Helpers============================================== */
@@ -449,6 +458,8 @@ int sdap_op_add(TALLOC_CTX *memctx, struct tevent_context *ev,
     op->callback = callback;
     op->data = data;
     op->ev = ev;
+    op->rid = sss_latency_current_rid();
+    sss_latency_start(&op->start);
 
     DEBUG(SSSDBG_TRACE_INTERNAL,
           "New operation %d timeout %d\n", op->msgid, timeout);
@@ -1494,6 +1505,13 @@ static void sdap_get_generic_op_finished(struct sdap_op *op,
         sdap_unlock_next_reply(state->op);
         break;
 
+    case LDAP_RES_INTERMEDIATE:
+        /* not requested by any control we send, skip it */
+        DEBUG(SSSDBG_TRACE_INTERNAL,
+              "Ignoring intermediate response (%d)\n", state->op->msgid);
+        sdap_unlock_next_reply(state->op);
+        break;
+
     case LDAP_RES_SEARCH_RESULT:
         ret = ldap_parse_result(state->sh->ldap, reply->msg,
                                 &result, NULL, &errmsg, &refs,
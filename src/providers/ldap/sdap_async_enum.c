@@ -36,9 +36,12 @@ static struct tevent_req *enum_users_send(TALLOC_CTX *memctx,
                                           struct tevent_context *ev,
                                           struct sdap_id_ctx *ctx,
                                           struct sdap_domain *sdom,
+                                          struct sdap_search_base **search_bases,
                                           struct sdap_id_op *op,
                                           bool purge);
-static errno_t enum_users_recv(struct tevent_req *req);
+static errno_t enum_users_recv(struct tevent_req *req,
+                               TALLOC_CTX *mem_ctx,
+                               char **_usn_value);
 
 static struct tevent_req *enum_groups_send(TALLOC_CTX *memctx,
                                           struct tevent_context *ev,
@@ -49,6 +52,38 @@ static struct tevent_req *enum_groups_send(TALLOC_CTX *memctx,
 static errno_t enum_groups_recv(struct tevent_req *req);
 
 /* ==Enumeration-Request-with-connections=================================== */
+
+/* Users, groups and services are enumerated concurrently, each of them
+ * with its own sdap_id_op. Users are additionally split into one shard per
+ * user search base, so that the entries of a shard are saved to the sysdb
+ * while the searches of the other shards are still running. */
+enum sdap_dom_enum_phase_type {
+    SDAP_ENUM_PHASE_USERS,
+    SDAP_ENUM_PHASE_GROUPS,
+    SDAP_ENUM_PHASE_SERVICES,
+
+    SDAP_ENUM_PHASE_SENTINEL
+};
+
+static const char *sdap_dom_enum_phase_names[] = {
+    "users", "groups", "services"
+};
+
+struct sdap_dom_enum_phase {
+    struct tevent_req *req;
+    enum sdap_dom_enum_phase_type type;
+    struct sdap_id_op *op;
+
+    /* users only, the search bases of this shard */
+    struct sdap_search_base **search_bases;
+};
+
+struct sdap_dom_enum_phase_stat {
+    struct timeval start;
+    int pending;
+    int total;
+};
+
 struct sdap_dom_enum_ex_state {
     struct tevent_context *ev;
     struct sdap_id_ctx *ctx;
@@ -57,25 +92,40 @@ struct sdap_dom_enum_ex_state {
     struct sdap_id_conn_ctx *user_conn;
     struct sdap_id_conn_ctx *group_conn;
     struct sdap_id_conn_ctx *svc_conn;
-    struct sdap_id_op *user_op;
-    struct sdap_id_op *group_op;
-    struct sdap_id_op *svc_op;
+    struct sdap_id_op *check_op;
+    TALLOC_CTX *phases;
 
     bool purge;
+
+    /* With rfc2307bis-like schemas the group members are resolved against
+     * the users already stored in the cache, so the groups can only be
+     * enumerated once all users have been saved. */
+    bool groups_wait_for_users;
+
+    struct sdap_dom_enum_phase_stat stats[SDAP_ENUM_PHASE_SENTINEL];
+    int pending;
+
+    /* The highest USN of all user shards. It is only recorded once all
+     * shards succeeded, otherwise a failed shard would lose its changes
+     * in the next incremental enumeration. */
+    char *max_user_usn;
 };
 
-static errno_t sdap_dom_enum_ex_retry(struct tevent_req *req,
-                                      struct sdap_id_op *op,
-                                      tevent_req_fn tcb);
-static bool sdap_dom_enum_ex_connected(struct tevent_req *subreq);
-static void sdap_dom_enum_ex_get_users(struct tevent_req *subreq);
+static errno_t sdap_dom_enum_ex_check_connect(struct tevent_req *req);
+static void sdap_dom_enum_ex_check_connected(struct tevent_req *subreq);
 static void sdap_dom_enum_ex_posix_check_done(struct tevent_req *subreq);
-static errno_t sdap_dom_enum_search_users(struct tevent_req *req);
-static void sdap_dom_enum_ex_users_done(struct tevent_req *subreq);
-static void sdap_dom_enum_ex_get_groups(struct tevent_req *subreq);
-static void sdap_dom_enum_ex_groups_done(struct tevent_req *subreq);
-static void sdap_dom_enum_ex_get_svcs(struct tevent_req *subreq);
-static void sdap_dom_enum_ex_svcs_done(struct tevent_req *subreq);
+static errno_t sdap_dom_enum_ex_start_users(struct tevent_req *req);
+static errno_t sdap_dom_enum_ex_start_phase(struct tevent_req *req,
+                                            enum sdap_dom_enum_phase_type type,
+                                            struct sdap_id_conn_ctx *conn,
+                                            struct sdap_search_base **bases);
+static errno_t sdap_dom_enum_phase_connect(struct sdap_dom_enum_phase *phase);
+static void sdap_dom_enum_phase_connected(struct tevent_req *subreq);
+static void sdap_dom_enum_phase_done(struct tevent_req *subreq);
+static void sdap_dom_enum_ex_phase_finished(struct sdap_dom_enum_phase *phase,
+                                            char *usn_value);
+static void sdap_dom_enum_ex_finish(struct tevent_req *req);
+static void sdap_dom_enum_ex_stop(struct tevent_req *req, errno_t ret);
 
 struct tevent_req *
 sdap_dom_enum_ex_send(TALLOC_CTX *memctx,
@@ -88,6 +138,7 @@ sdap_dom_enum_ex_send(TALLOC_CTX *memctx,
 {
     struct tevent_req *req;
     struct sdap_dom_enum_ex_state *state;
+    bool use_id_mapping;
     int t;
     errno_t ret;
 
@@ -107,17 +158,58 @@ sdap_dom_enum_ex_send(TALLOC_CTX *memctx,
         state->purge = true;
     }
 
-    state->user_op = sdap_id_op_create(state, user_conn->conn_cache);
-    if (state->user_op == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "sdap_id_op_create failed for users\n");
-        ret = EIO;
+    state->phases = talloc_new(state);
+    if (state->phases == NULL) {
+        ret = ENOMEM;
+        goto fail;
+    }
+
+    state->groups_wait_for_users =
+                            (ctx->opts->schema_type != SDAP_SCHEMA_RFC2307);
+
+    use_id_mapping = sdap_idmap_domain_has_algorithmic_mapping(
+                                            ctx->opts->idmap_ctx,
+                                            sdom->dom->name,
+                                            sdom->dom->domain_id);
+
+    /* If POSIX attributes have been requested with an AD server and we
+     * have no idea about POSIX attributes support, run a one-time check
+     * before the users are searched
+     */
+    if (use_id_mapping == false &&
+            ctx->opts->schema_type == SDAP_SCHEMA_AD &&
+            ctx->srv_opts &&
+            ctx->srv_opts->posix_checked == false) {
+        state->check_op = sdap_id_op_create(state, user_conn->conn_cache);
+        if (state->check_op == NULL) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "sdap_id_op_create failed for the POSIX check\n");
+            ret = EIO;
+            goto fail;
+        }
+
+        ret = sdap_dom_enum_ex_check_connect(req);
+        /* the users are only started when the check completes, keep the
+         * request from finishing before that */
+        state->pending++;
+    } else {
+        ret = sdap_dom_enum_ex_start_users(req);
+    }
+    if (ret != EOK) {
         goto fail;
     }
 
-    ret = sdap_dom_enum_ex_retry(req, state->user_op,
-                                 sdap_dom_enum_ex_get_users);
+    if (state->groups_wait_for_users == false) {
+        ret = sdap_dom_enum_ex_start_phase(req, SDAP_ENUM_PHASE_GROUPS,
+                                           group_conn, NULL);
+        if (ret != EOK) {
+            goto fail;
+        }
+    }
+
+    ret = sdap_dom_enum_ex_start_phase(req, SDAP_ENUM_PHASE_SERVICES,
+                                       svc_conn, NULL);
     if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, "sdap_dom_enum_ex_retry failed\n");
         goto fail;
     }
 
@@ -129,32 +221,29 @@ fail:
     return req;
 }
 
-static errno_t sdap_dom_enum_ex_retry(struct tevent_req *req,
-                                      struct sdap_id_op *op,
-                                      tevent_req_fn tcb)
+static errno_t sdap_dom_enum_ex_check_connect(struct tevent_req *req)
 {
     struct sdap_dom_enum_ex_state *state = tevent_req_data(req,
                                                 struct sdap_dom_enum_ex_state);
     struct tevent_req *subreq;
     errno_t ret;
 
-    subreq = sdap_id_op_connect_send(op, state, &ret);
+    subreq = sdap_id_op_connect_send(state->check_op, state, &ret);
     if (subreq == NULL) {
         DEBUG(SSSDBG_OP_FAILURE,
               "sdap_id_op_connect_send failed: %d\n", ret);
         return ret;
     }
 
-    tevent_req_set_callback(subreq, tcb, req);
+    tevent_req_set_callback(subreq, sdap_dom_enum_ex_check_connected, req);
     return EOK;
 }
 
-static bool sdap_dom_enum_ex_connected(struct tevent_req *subreq)
+static bool sdap_dom_enum_ex_connected(struct tevent_req *req,
+                                       struct tevent_req *subreq)
 {
     errno_t ret;
     int dp_error;
-    struct tevent_req *req = tevent_req_callback_data(subreq,
-                                                      struct tevent_req);
 
     ret = sdap_id_op_connect_recv(subreq, &dp_error);
     talloc_zfree(subreq);
@@ -162,12 +251,12 @@ static bool sdap_dom_enum_ex_connected(struct tevent_req *subreq)
         if (dp_error == DP_ERR_OFFLINE) {
             DEBUG(SSSDBG_TRACE_FUNC,
                   "Backend is marked offline, retry later!\n");
-            tevent_req_done(req);
+            sdap_dom_enum_ex_stop(req, EOK);
         } else {
             DEBUG(SSSDBG_MINOR_FAILURE,
                   "Domain enumeration failed to connect to " \
                    "LDAP server: (%d)[%s]\n", ret, strerror(ret));
-            tevent_req_error(req, ret);
+            sdap_dom_enum_ex_stop(req, ret);
         }
         return false;
     }
@@ -175,52 +264,27 @@ static bool sdap_dom_enum_ex_connected(struct tevent_req *subreq)
     return true;
 }
 
-static void sdap_dom_enum_ex_get_users(struct tevent_req *subreq)
+static void sdap_dom_enum_ex_check_connected(struct tevent_req *subreq)
 {
     struct tevent_req *req = tevent_req_callback_data(subreq,
                                                       struct tevent_req);
     struct sdap_dom_enum_ex_state *state = tevent_req_data(req,
                                                 struct sdap_dom_enum_ex_state);
-    bool use_id_mapping;
-    errno_t ret;
-
-    if (sdap_dom_enum_ex_connected(subreq) == false) {
-        return;
-    }
 
-    use_id_mapping = sdap_idmap_domain_has_algorithmic_mapping(
-                                            state->ctx->opts->idmap_ctx,
-                                            state->sdom->dom->name,
-                                            state->sdom->dom->domain_id);
-
-    /* If POSIX attributes have been requested with an AD server and we
-     * have no idea about POSIX attributes support, run a one-time check
-     */
-    if (use_id_mapping == false &&
-            state->ctx->opts->schema_type == SDAP_SCHEMA_AD &&
-            state->ctx->srv_opts &&
-            state->ctx->srv_opts->posix_checked == false) {
-        subreq = sdap_posix_check_send(state, state->ev, state->ctx->opts,
-                                       sdap_id_op_handle(state->user_op),
-                                       state->sdom->user_search_bases,
-                                       dp_opt_get_int(state->ctx->opts->basic,
-                                                      SDAP_SEARCH_TIMEOUT));
-        if (subreq == NULL) {
-            tevent_req_error(req, ENOMEM);
-            return;
-        }
-        tevent_req_set_callback(subreq,
-                                sdap_dom_enum_ex_posix_check_done, req);
+    if (sdap_dom_enum_ex_connected(req, subreq) == false) {
         return;
     }
 
-
-    ret = sdap_dom_enum_search_users(req);
-    if (ret != EOK) {
-        tevent_req_error(req, ret);
+    subreq = sdap_posix_check_send(state, state->ev, state->ctx->opts,
+                                   sdap_id_op_handle(state->check_op),
+                                   state->sdom->user_search_bases,
+                                   dp_opt_get_int(state->ctx->opts->basic,
+                                                  SDAP_SEARCH_TIMEOUT));
+    if (subreq == NULL) {
+        sdap_dom_enum_ex_stop(req, ENOMEM);
         return;
     }
-    /* Execution resumes in sdap_dom_enum_ex_users_done */
+    tevent_req_set_callback(subreq, sdap_dom_enum_ex_posix_check_done, req);
 }
 
 static void sdap_dom_enum_ex_posix_check_done(struct tevent_req *subreq)
@@ -236,237 +300,304 @@ static void sdap_dom_enum_ex_posix_check_done(struct tevent_req *subreq)
 
     ret = sdap_posix_check_recv(subreq, &has_posix);
     talloc_zfree(subreq);
-    if (ret != EOK && ret != ERR_NO_POSIX) {
-        /* We can only finish the id_op on error as the connection
-         * is re-used by the user search
-         */
-        ret = sdap_id_op_done(state->user_op, ret, &dp_error);
-        if (dp_error == DP_ERR_OK && ret != EOK) {
-            /* retry */
-            ret = sdap_dom_enum_ex_retry(req, state->user_op,
-                                         sdap_dom_enum_ex_get_users);
-            if (ret != EOK) {
-                tevent_req_error(req, ret);
-            }
-            return;
-        } else if (dp_error == DP_ERR_OFFLINE) {
-            DEBUG(SSSDBG_TRACE_FUNC, "Backend is offline, retrying later\n");
-            tevent_req_done(req);
-            return;
-        } else {
-            /* Non-recoverable error */
-            DEBUG(SSSDBG_OP_FAILURE,
-                "POSIX check failed: %d: %s\n", ret, sss_strerror(ret));
-            tevent_req_error(req, ret);
-            return;
+    ret = sdap_id_op_done(state->check_op,
+                          ret == ERR_NO_POSIX ? EOK : ret, &dp_error);
+    if (dp_error == DP_ERR_OK && ret != EOK) {
+        /* retry */
+        ret = sdap_dom_enum_ex_check_connect(req);
+        if (ret != EOK) {
+            sdap_dom_enum_ex_stop(req, ret);
         }
+        return;
+    } else if (dp_error == DP_ERR_OFFLINE) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Backend is offline, retrying later\n");
+        sdap_dom_enum_ex_stop(req, EOK);
+        return;
+    } else if (ret != EOK) {
+        /* Non-recoverable error */
+        DEBUG(SSSDBG_OP_FAILURE,
+            "POSIX check failed: %d: %s\n", ret, sss_strerror(ret));
+        sdap_dom_enum_ex_stop(req, ret);
+        return;
     }
+    talloc_zfree(state->check_op);
 
     state->ctx->srv_opts->posix_checked = true;
 
     /* If the check ran to completion, we know for certain about the attributes
      */
     if (has_posix == false) {
-        tevent_req_error(req, ERR_NO_POSIX);
+        sdap_dom_enum_ex_stop(req, ERR_NO_POSIX);
         return;
     }
 
-
-    ret = sdap_dom_enum_search_users(req);
+    ret = sdap_dom_enum_ex_start_users(req);
     if (ret != EOK) {
-        tevent_req_error(req, ret);
+        sdap_dom_enum_ex_stop(req, ret);
         return;
     }
-    /* Execution resumes in sdap_dom_enum_ex_users_done */
+    state->pending--;
 }
 
-static errno_t sdap_dom_enum_search_users(struct tevent_req *req)
+static errno_t sdap_dom_enum_ex_start_users(struct tevent_req *req)
 {
     struct sdap_dom_enum_ex_state *state = tevent_req_data(req,
                                                 struct sdap_dom_enum_ex_state);
-    struct tevent_req *subreq;
+    struct sdap_search_base **bases = state->sdom->user_search_bases;
+    struct sdap_search_base **shard;
+    size_t i;
+    errno_t ret;
 
-    subreq = enum_users_send(state, state->ev,
-                             state->ctx, state->sdom,
-                             state->user_op, state->purge);
-    if (subreq == NULL) {
-        return ENOMEM;
+    if (bases == NULL || bases[0] == NULL || bases[1] == NULL) {
+        return sdap_dom_enum_ex_start_phase(req, SDAP_ENUM_PHASE_USERS,
+                                            state->user_conn, bases);
+    }
+
+    for (i = 0; bases[i] != NULL; i++) {
+        shard = talloc_zero_array(state, struct sdap_search_base *, 2);
+        if (shard == NULL) {
+            return ENOMEM;
+        }
+        shard[0] = bases[i];
+
+        ret = sdap_dom_enum_ex_start_phase(req, SDAP_ENUM_PHASE_USERS,
+                                           state->user_conn, shard);
+        if (ret != EOK) {
+            return ret;
+        }
     }
-    tevent_req_set_callback(subreq, sdap_dom_enum_ex_users_done, req);
+
     return EOK;
 }
 
-static void sdap_dom_enum_ex_users_done(struct tevent_req *subreq)
+static errno_t sdap_dom_enum_ex_start_phase(struct tevent_req *req,
+                                            enum sdap_dom_enum_phase_type type,
+                                            struct sdap_id_conn_ctx *conn,
+                                            struct sdap_search_base **bases)
 {
-    struct tevent_req *req = tevent_req_callback_data(subreq,
-                                                      struct tevent_req);
     struct sdap_dom_enum_ex_state *state = tevent_req_data(req,
                                                 struct sdap_dom_enum_ex_state);
+    struct sdap_dom_enum_phase *phase;
     errno_t ret;
-    int dp_error;
 
-    ret = enum_users_recv(subreq);
-    talloc_zfree(subreq);
-    ret = sdap_id_op_done(state->user_op, ret, &dp_error);
-    if (dp_error == DP_ERR_OK && ret != EOK) {
-        /* retry */
-        ret = sdap_dom_enum_ex_retry(req, state->user_op,
-                                     sdap_dom_enum_ex_get_users);
-        if (ret != EOK) {
-            tevent_req_error(req, ret);
-            return;
-        }
-        return;
-    } else if (dp_error == DP_ERR_OFFLINE) {
-        DEBUG(SSSDBG_TRACE_FUNC, "Backend is offline, retrying later\n");
-        tevent_req_done(req);
-        return;
-    } else if (ret != EOK && ret != ENOENT) {
-        /* Non-recoverable error */
-        DEBUG(SSSDBG_OP_FAILURE,
-              "User enumeration failed: %d: %s\n", ret, sss_strerror(ret));
-        tevent_req_error(req, ret);
-        return;
+    phase = talloc_zero(state->phases, struct sdap_dom_enum_phase);
+    if (phase == NULL) {
+        return ENOMEM;
     }
+    phase->req = req;
+    phase->type = type;
+    phase->search_bases = bases;
 
-    state->group_op = sdap_id_op_create(state, state->group_conn->conn_cache);
-    if (state->group_op == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "sdap_id_op_create failed for groups\n");
-        tevent_req_error(req, EIO);
-        return;
+    phase->op = sdap_id_op_create(phase, conn->conn_cache);
+    if (phase->op == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "sdap_id_op_create failed for %s\n",
+              sdap_dom_enum_phase_names[type]);
+        talloc_free(phase);
+        return EIO;
     }
 
-    ret = sdap_dom_enum_ex_retry(req, state->group_op,
-                                 sdap_dom_enum_ex_get_groups);
+    ret = sdap_dom_enum_phase_connect(phase);
     if (ret != EOK) {
-        tevent_req_error(req, ret);
-        return;
+        talloc_free(phase);
+        return ret;
+    }
+
+    if (state->stats[type].total == 0) {
+        state->stats[type].start = tevent_timeval_current();
     }
+    state->stats[type].total++;
+    state->stats[type].pending++;
+    state->pending++;
 
-    /* Continues to sdap_dom_enum_ex_get_groups */
+    return EOK;
 }
 
-static void sdap_dom_enum_ex_get_groups(struct tevent_req *subreq)
+static errno_t sdap_dom_enum_phase_connect(struct sdap_dom_enum_phase *phase)
 {
-    struct tevent_req *req = tevent_req_callback_data(subreq,
-                                                      struct tevent_req);
-    struct sdap_dom_enum_ex_state *state = tevent_req_data(req,
+    struct tevent_req *subreq;
+    errno_t ret;
+
+    subreq = sdap_id_op_connect_send(phase->op, phase, &ret);
+    if (subreq == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "sdap_id_op_connect_send failed: %d\n", ret);
+        return ret;
+    }
+
+    tevent_req_set_callback(subreq, sdap_dom_enum_phase_connected, phase);
+    return EOK;
+}
+
+static void sdap_dom_enum_phase_connected(struct tevent_req *subreq)
+{
+    struct sdap_dom_enum_phase *phase = tevent_req_callback_data(subreq,
+                                                 struct sdap_dom_enum_phase);
+    struct sdap_dom_enum_ex_state *state = tevent_req_data(phase->req,
                                                 struct sdap_dom_enum_ex_state);
 
-    if (sdap_dom_enum_ex_connected(subreq) == false) {
+    if (sdap_dom_enum_ex_connected(phase->req, subreq) == false) {
         return;
     }
 
-    subreq = enum_groups_send(state, state->ev, state->ctx,
-                              state->sdom,
-                              state->group_op, state->purge);
+    switch (phase->type) {
+    case SDAP_ENUM_PHASE_USERS:
+        subreq = enum_users_send(phase, state->ev, state->ctx, state->sdom,
+                                 phase->search_bases, phase->op,
+                                 state->purge);
+        break;
+    case SDAP_ENUM_PHASE_GROUPS:
+        subreq = enum_groups_send(phase, state->ev, state->ctx, state->sdom,
+                                  phase->op, state->purge);
+        break;
+    case SDAP_ENUM_PHASE_SERVICES:
+        subreq = enum_services_send(phase, state->ev, state->ctx,
+                                    phase->op, state->purge);
+        break;
+    default:
+        sdap_dom_enum_ex_stop(phase->req, EINVAL);
+        return;
+    }
     if (subreq == NULL) {
-        tevent_req_error(req, ENOMEM);
+        sdap_dom_enum_ex_stop(phase->req, ENOMEM);
         return;
     }
-    tevent_req_set_callback(subreq, sdap_dom_enum_ex_groups_done, req);
+    tevent_req_set_callback(subreq, sdap_dom_enum_phase_done, phase);
 }
 
-static void sdap_dom_enum_ex_groups_done(struct tevent_req *subreq)
+static void sdap_dom_enum_phase_done(struct tevent_req *subreq)
 {
-    struct tevent_req *req = tevent_req_callback_data(subreq,
-                                                      struct tevent_req);
-    struct sdap_dom_enum_ex_state *state = tevent_req_data(req,
-                                                struct sdap_dom_enum_ex_state);
-    int ret;
+    struct sdap_dom_enum_phase *phase = tevent_req_callback_data(subreq,
+                                                 struct sdap_dom_enum_phase);
+    char *usn_value = NULL;
+    errno_t ret;
     int dp_error;
 
-    ret = enum_groups_recv(subreq);
+    switch (phase->type) {
+    case SDAP_ENUM_PHASE_USERS:
+        ret = enum_users_recv(subreq, phase, &usn_value);
+        break;
+    case SDAP_ENUM_PHASE_GROUPS:
+        ret = enum_groups_recv(subreq);
+        break;
+    default:
+        ret = enum_services_recv(subreq);
+        break;
+    }
     talloc_zfree(subreq);
-    ret = sdap_id_op_done(state->group_op, ret, &dp_error);
+
+    ret = sdap_id_op_done(phase->op, ret, &dp_error);
     if (dp_error == DP_ERR_OK && ret != EOK) {
         /* retry */
-        ret = sdap_dom_enum_ex_retry(req, state->group_op,
-                                     sdap_dom_enum_ex_get_groups);
+        ret = sdap_dom_enum_phase_connect(phase);
         if (ret != EOK) {
-            tevent_req_error(req, ret);
-            return;
+            sdap_dom_enum_ex_stop(phase->req, ret);
         }
         return;
     } else if (dp_error == DP_ERR_OFFLINE) {
         DEBUG(SSSDBG_TRACE_FUNC, "Backend is offline, retrying later\n");
-        tevent_req_done(req);
+        sdap_dom_enum_ex_stop(phase->req, EOK);
         return;
     } else if (ret != EOK && ret != ENOENT) {
         /* Non-recoverable error */
-        DEBUG(SSSDBG_OP_FAILURE,
-              "Group enumeration failed: %d: %s\n", ret, sss_strerror(ret));
-        tevent_req_error(req, ret);
+        DEBUG(SSSDBG_OP_FAILURE, "Enumeration of %s failed: %d: %s\n",
+              sdap_dom_enum_phase_names[phase->type],
+              ret, sss_strerror(ret));
+        sdap_dom_enum_ex_stop(phase->req, ret);
         return;
     }
 
+    sdap_dom_enum_ex_phase_finished(phase, usn_value);
+}
 
-    state->svc_op = sdap_id_op_create(state, state->svc_conn->conn_cache);
-    if (state->svc_op == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "sdap_id_op_create failed for svcs\n");
-        tevent_req_error(req, EIO);
+static void sdap_dom_enum_ex_merge_usn(struct sdap_dom_enum_ex_state *state,
+                                       char *usn_value)
+{
+    if (usn_value == NULL) {
         return;
     }
 
-    ret = sdap_dom_enum_ex_retry(req, state->svc_op,
-                                 sdap_dom_enum_ex_get_svcs);
-    if (ret != EOK) {
-        tevent_req_error(req, ret);
-        return;
+    if (state->max_user_usn == NULL
+            || strtoul(usn_value, NULL, 10)
+                    > strtoul(state->max_user_usn, NULL, 10)) {
+        talloc_free(state->max_user_usn);
+        state->max_user_usn = talloc_steal(state, usn_value);
     }
 }
 
-static void sdap_dom_enum_ex_get_svcs(struct tevent_req *subreq)
+static void sdap_dom_enum_ex_phase_finished(struct sdap_dom_enum_phase *phase,
+                                            char *usn_value)
 {
-    struct tevent_req *req = tevent_req_callback_data(subreq,
-                                                      struct tevent_req);
+    struct tevent_req *req = phase->req;
     struct sdap_dom_enum_ex_state *state = tevent_req_data(req,
                                                 struct sdap_dom_enum_ex_state);
+    struct sdap_dom_enum_phase_stat *stat = &state->stats[phase->type];
+    enum sdap_dom_enum_phase_type type = phase->type;
+    struct timeval now;
+    struct timeval diff;
+    errno_t ret;
 
-    if (sdap_dom_enum_ex_connected(subreq) == false) {
-        return;
+    if (type == SDAP_ENUM_PHASE_USERS) {
+        sdap_dom_enum_ex_merge_usn(state, usn_value);
+    }
+    talloc_free(phase);
+
+    stat->pending--;
+    DEBUG(SSSDBG_TRACE_INTERNAL,
+          "Enumeration of %s in domain %s: %d of %d searches finished\n",
+          sdap_dom_enum_phase_names[type], state->sdom->dom->name,
+          stat->total - stat->pending, stat->total);
+
+    if (stat->pending == 0) {
+        now = tevent_timeval_current();
+        diff = tevent_timeval_until(&stat->start, &now);
+        DEBUG(SSSDBG_TRACE_FUNC,
+              "Enumeration of %s in domain %s finished in %ld.%03ld "
+              "seconds\n", sdap_dom_enum_phase_names[type],
+              state->sdom->dom->name,
+              (long) diff.tv_sec, (long) diff.tv_usec / 1000);
+
+        if (type == SDAP_ENUM_PHASE_USERS && state->groups_wait_for_users) {
+            ret = sdap_dom_enum_ex_start_phase(req, SDAP_ENUM_PHASE_GROUPS,
+                                               state->group_conn, NULL);
+            if (ret != EOK) {
+                sdap_dom_enum_ex_stop(req, ret);
+                return;
+            }
+        }
     }
 
-    subreq = enum_services_send(state, state->ev, state->ctx,
-                                state->svc_op, state->purge);
-    if (!subreq) {
-        tevent_req_error(req, ENOMEM);
-        return;
+    state->pending--;
+    if (state->pending == 0) {
+        sdap_dom_enum_ex_finish(req);
     }
-    tevent_req_set_callback(subreq, sdap_dom_enum_ex_svcs_done, req);
 }
 
-static void sdap_dom_enum_ex_svcs_done(struct tevent_req *subreq)
+static void sdap_dom_enum_ex_finish(struct tevent_req *req)
 {
-    struct tevent_req *req = tevent_req_callback_data(subreq,
-                                                      struct tevent_req);
     struct sdap_dom_enum_ex_state *state = tevent_req_data(req,
                                                 struct sdap_dom_enum_ex_state);
-    int ret;
-    int dp_error;
+    struct sdap_server_opts *srv_opts = state->ctx->srv_opts;
+    char *endptr = NULL;
+    unsigned usn_number;
+    errno_t ret;
 
-    ret = enum_services_recv(subreq);
-    talloc_zfree(subreq);
-    ret = sdap_id_op_done(state->svc_op, ret, &dp_error);
-    if (dp_error == DP_ERR_OK && ret != EOK) {
-        /* retry */
-        ret = sdap_dom_enum_ex_retry(req, state->user_op,
-                                     sdap_dom_enum_ex_get_svcs);
-        if (ret != EOK) {
-            tevent_req_error(req, ret);
-            return;
+    if (state->max_user_usn != NULL && srv_opts != NULL) {
+        talloc_zfree(srv_opts->max_user_value);
+        srv_opts->max_user_value = talloc_steal(state->ctx,
+                                                state->max_user_usn);
+        state->max_user_usn = NULL;
+
+        usn_number = strtoul(srv_opts->max_user_value, &endptr, 10);
+        if ((endptr == NULL || (*endptr == '\0'
+                                && endptr != srv_opts->max_user_value))
+            && (usn_number > srv_opts->last_usn)) {
+            srv_opts->last_usn = usn_number;
         }
-        return;
-    } else if (dp_error == DP_ERR_OFFLINE) {
-        DEBUG(SSSDBG_TRACE_FUNC, "Backend is offline, retrying later\n");
-        tevent_req_done(req);
-        return;
-    } else if (ret != EOK && ret != ENOENT) {
-        /* Non-recoverable error */
-        DEBUG(SSSDBG_OP_FAILURE,
-              "Service enumeration failed: %d: %s\n", ret, sss_strerror(ret));
-        tevent_req_error(req, ret);
-        return;
+    }
+
+    if (srv_opts != NULL) {
+        DEBUG(SSSDBG_CONF_SETTINGS, "Users higher USN value: [%s]\n",
+              srv_opts->max_user_value);
     }
 
     /* Ok, we've completed an enumeration. Save this to the
@@ -495,6 +626,24 @@ static void sdap_dom_enum_ex_svcs_done(struct tevent_req *subreq)
     tevent_req_done(req);
 }
 
+/* Finishes the request early, cancelling the phases that are still running
+ * so that none of them can complete the request a second time. */
+static void sdap_dom_enum_ex_stop(struct tevent_req *req, errno_t ret)
+{
+    struct sdap_dom_enum_ex_state *state = tevent_req_data(req,
+                                                struct sdap_dom_enum_ex_state);
+
+    talloc_zfree(state->phases);
+    talloc_zfree(state->check_op);
+
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
 errno_t sdap_dom_enum_ex_recv(struct tevent_req *req)
 {
     TEVENT_REQ_RETURN_ON_ERROR(req);
@@ -523,10 +672,12 @@ struct enum_users_state {
     struct tevent_context *ev;
     struct sdap_id_ctx *ctx;
     struct sdap_domain *sdom;
+    struct sdap_search_base **search_bases;
     struct sdap_id_op *op;
 
     char *filter;
     const char **attrs;
+    char *usn_value;
 };
 
 static void enum_users_done(struct tevent_req *subreq);
@@ -535,6 +686,7 @@ static struct tevent_req *enum_users_send(TALLOC_CTX *memctx,
                                           struct tevent_context *ev,
                                           struct sdap_id_ctx *ctx,
                                           struct sdap_domain *sdom,
+                                          struct sdap_search_base **search_bases,
                                           struct sdap_id_op *op,
                                           bool purge)
 {
@@ -548,6 +700,7 @@ static struct tevent_req *enum_users_send(TALLOC_CTX *memctx,
 
     state->ev = ev;
     state->sdom = sdom;
+    state->search_bases = search_bases;
     state->ctx = ctx;
     state->op = op;
 
@@ -623,15 +776,11 @@ static struct tevent_req *enum_users_send(TALLOC_CTX *memctx,
                                NULL, &state->attrs, NULL);
     if (ret != EOK) goto fail;
 
-    /* TODO: restrict the enumerations to using a single
-     * search base at a time.
-     */
-
     subreq = sdap_get_users_send(state, state->ev,
                                  state->sdom->dom,
                                  state->sdom->dom->sysdb,
                                  state->ctx->opts,
-                                 state->sdom->user_search_bases,
+                                 state->search_bases,
                                  sdap_id_op_handle(state->op),
                                  state->attrs, state->filter,
                                  dp_opt_get_int(state->ctx->opts->basic,
@@ -657,40 +806,31 @@ static void enum_users_done(struct tevent_req *subreq)
                                                       struct tevent_req);
     struct enum_users_state *state = tevent_req_data(req,
                                                      struct enum_users_state);
-    char *usn_value;
-    char *endptr = NULL;
-    unsigned usn_number;
     int ret;
 
-    ret = sdap_get_users_recv(subreq, state, &usn_value);
+    ret = sdap_get_users_recv(subreq, state, &state->usn_value);
     talloc_zfree(subreq);
     if (ret) {
         tevent_req_error(req, ret);
         return;
     }
 
-    if (usn_value) {
-        talloc_zfree(state->ctx->srv_opts->max_user_value);
-        state->ctx->srv_opts->max_user_value =
-                                        talloc_steal(state->ctx, usn_value);
-
-        usn_number = strtoul(usn_value, &endptr, 10);
-        if ((endptr == NULL || (*endptr == '\0' && endptr != usn_value))
-            && (usn_number > state->ctx->srv_opts->last_usn)) {
-            state->ctx->srv_opts->last_usn = usn_number;
-        }
-    }
-
-    DEBUG(SSSDBG_CONF_SETTINGS, "Users higher USN value: [%s]\n",
-              state->ctx->srv_opts->max_user_value);
+    DEBUG(SSSDBG_TRACE_FUNC, "Users higher USN value of the search: [%s]\n",
+          state->usn_value);
 
     tevent_req_done(req);
 }
 
-static errno_t enum_users_recv(struct tevent_req *req)
+static errno_t enum_users_recv(struct tevent_req *req,
+                               TALLOC_CTX *mem_ctx,
+                               char **_usn_value)
 {
+    struct enum_users_state *state = tevent_req_data(req,
+                                                     struct enum_users_state);
+
     TEVENT_REQ_RETURN_ON_ERROR(req);
 
+    *_usn_value = talloc_steal(mem_ctx, state->usn_value);
     return EOK;
 }
 
@@ -341,13 +341,13 @@ done:
     /* FIXME: support storing additional attributes */
 
 static errno_t
-sdap_store_group_with_gid(struct sss_domain_info *domain,
-                          const char *name,
-                          gid_t gid,
-                          struct sysdb_attrs *group_attrs,
-                          uint64_t cache_timeout,
-                          bool posix_group,
-                          time_t now)
+sdap_prepare_group_with_gid(struct sss_domain_info *domain,
+                            const char *name,
+                            gid_t gid,
+                            struct sysdb_attrs *group_attrs,
+                            uint64_t cache_timeout,
+                            bool posix_group,
+                            struct sysdb_group_batch_entry *entry)
 {
     errno_t ret;
 
@@ -362,14 +362,13 @@ sdap_store_group_with_gid(struct sss_domain_info *domain,
         }
     }
 
-    ret = sysdb_store_group(domain, name, gid, group_attrs,
-                            cache_timeout, now);
-    if (ret) {
-        DEBUG(SSSDBG_OP_FAILURE, "Could not store group %s\n", name);
-        return ret;
-    }
+    entry->domain = domain;
+    entry->name = name;
+    entry->gid = gid;
+    entry->attrs = group_attrs;
+    entry->cache_timeout = cache_timeout;
 
-    return ret;
+    return EOK;
 }
 
 static errno_t
@@ -491,15 +490,17 @@ sdap_process_ghost_members(struct sysdb_attrs *attrs,
     return EOK;
 }
 
-static int sdap_save_group(TALLOC_CTX *memctx,
-                           struct sdap_options *opts,
-                           struct sss_domain_info *dom,
-                           struct sysdb_attrs *attrs,
-                           bool populate_members,
-                           bool store_original_member,
-                           hash_table_t *ghosts,
-                           char **_usn_value,
-                           time_t now)
+/* Fills the cache entry of the group returned by LDAP in attrs. The name of
+ * the entry is left NULL for objects that are not stored in the cache. */
+static int sdap_prepare_group(TALLOC_CTX *memctx,
+                              struct sdap_options *opts,
+                              struct sss_domain_info *dom,
+                              struct sysdb_attrs *attrs,
+                              bool populate_members,
+                              bool store_original_member,
+                              hash_table_t *ghosts,
+                              char **_usn_value,
+                              struct sysdb_group_batch_entry *entry)
 {
     struct ldb_message_element *el;
     struct sysdb_attrs *group_attrs;
@@ -514,6 +515,8 @@ static int sdap_save_group(TALLOC_CTX *memctx,
     char *sid_str;
     struct sss_domain_info *subdomain;
 
+    memset(entry, 0, sizeof(struct sysdb_group_batch_entry));
+
     tmpctx = talloc_new(NULL);
     if (!tmpctx) {
         ret = ENOMEM;
@@ -571,7 +574,8 @@ static int sdap_save_group(TALLOC_CTX *memctx,
         }
     }
 
-    ret = sdap_get_group_primary_name(tmpctx, opts, attrs, dom, &group_name);
+    ret = sdap_get_group_primary_name(group_attrs, opts, attrs, dom,
+                                      &group_name);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "Failed to get group name\n");
         goto done;
@@ -745,9 +749,9 @@ static int sdap_save_group(TALLOC_CTX *memctx,
     }
     DEBUG(SSSDBG_TRACE_FUNC, "Storing info for group %s\n", group_name);
 
-    ret = sdap_store_group_with_gid(dom, group_name, gid, group_attrs,
-                                    dom->group_timeout,
-                                    posix_group, now);
+    ret = sdap_prepare_group_with_gid(dom, group_name, gid, group_attrs,
+                                      dom->group_timeout,
+                                      posix_group, entry);
     if (ret) {
         DEBUG(SSSDBG_MINOR_FAILURE,
               "Could not store group with GID: [%s]\n",
@@ -860,13 +864,15 @@ done:
     /* FIXME: support non legacy */
     /* FIXME: support storing additional attributes */
 
-static int sdap_save_grpmem(TALLOC_CTX *memctx,
-                            struct sysdb_ctx *ctx,
-                            struct sdap_options *opts,
-                            struct sss_domain_info *dom,
-                            struct sysdb_attrs *attrs,
-                            hash_table_t *ghosts,
-                            time_t now)
+/* Fills the cache entry that replaces the members of the group returned by
+ * LDAP in attrs. The name of the entry is left NULL if members are ignored. */
+static int sdap_prepare_grpmem(TALLOC_CTX *memctx,
+                               struct sysdb_ctx *ctx,
+                               struct sdap_options *opts,
+                               struct sss_domain_info *dom,
+                               struct sysdb_attrs *attrs,
+                               hash_table_t *ghosts,
+                               struct sysdb_group_batch_entry *entry)
 {
     struct ldb_message_element *el;
     struct sysdb_attrs *group_attrs = NULL;
@@ -877,6 +883,8 @@ static int sdap_save_grpmem(TALLOC_CTX *memctx,
     struct sss_domain_info *group_dom = NULL;
     int ret;
 
+    memset(entry, 0, sizeof(struct sysdb_group_batch_entry));
+
     if (dom->ignore_group_members) {
         DEBUG(SSSDBG_CRIT_FAILURE,
               "Group members are ignored, nothing to do. If you see this " \
@@ -982,13 +990,11 @@ static int sdap_save_grpmem(TALLOC_CTX *memctx,
         }
     }
 
-    ret = sysdb_store_group(group_dom, group_name, 0, group_attrs,
-                            group_dom->group_timeout, now);
-    if (ret) {
-        DEBUG(SSSDBG_MINOR_FAILURE, "sysdb_store_group failed: [%d][%s].\n",
-              ret, strerror(ret));
-        goto fail;
-    }
+    entry->domain = group_dom;
+    entry->name = group_name;
+    entry->gid = 0;
+    entry->attrs = group_attrs;
+    entry->cache_timeout = group_dom->group_timeout;
 
     return EOK;
 
@@ -1001,16 +1007,16 @@ fail:
 
 /* ==Generic-Function-to-save-multiple-groups============================= */
 
-static int sdap_save_groups(TALLOC_CTX *memctx,
-                            struct sysdb_ctx *sysdb,
-                            struct sss_domain_info *dom,
-                            struct sdap_options *opts,
-                            struct sysdb_attrs **groups,
-                            int num_groups,
-                            bool populate_members,
-                            hash_table_t *ghosts,
-                            bool save_orig_member,
-                            char **_usn_value)
+int sdap_save_groups(TALLOC_CTX *memctx,
+                     struct sysdb_ctx *sysdb,
+                     struct sss_domain_info *dom,
+                     struct sdap_options *opts,
+                     struct sysdb_attrs **groups,
+                     int num_groups,
+                     bool populate_members,
+                     hash_table_t *ghosts,
+                     bool save_orig_member,
+                     char **_usn_value)
 {
     TALLOC_CTX *tmpctx;
     char *higher_usn = NULL;
@@ -1020,6 +1026,11 @@ static int sdap_save_groups(TALLOC_CTX *memctx,
     int ret;
     errno_t sret;
     int i;
+    struct sysdb_group_batch_entry *entries = NULL;
+    struct sysdb_group_batch_entry *mem_entries = NULL;
+    char **usn_values = NULL;
+    int *entry_idx = NULL;
+    int num_entries = 0;
     struct sysdb_attrs **saved_groups = NULL;
     int nsaved_groups = 0;
     time_t now;
@@ -1062,37 +1073,74 @@ static int sdap_save_groups(TALLOC_CTX *memctx,
         }
     }
 
-    now = time(NULL);
-    for (i = 0; i < num_groups; i++) {
-        usn_value = NULL;
+    entries = talloc_zero_array(tmpctx, struct sysdb_group_batch_entry,
+                                num_groups);
+    usn_values = talloc_zero_array(tmpctx, char *, num_groups);
+    entry_idx = talloc_array(tmpctx, int, num_groups);
+    if (entries == NULL || usn_values == NULL || entry_idx == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
 
+    for (i = 0; i < num_groups; i++) {
         /* if 2 pass savemembers = false */
-        ret = sdap_save_group(tmpctx, opts, dom, groups[i],
-                              populate_members,
-                              has_nesting && save_orig_member,
-                              ghosts, &usn_value, now);
+        ret = sdap_prepare_group(tmpctx, opts, dom, groups[i],
+                                 populate_members,
+                                 has_nesting && save_orig_member,
+                                 ghosts, &usn_values[num_entries],
+                                 &entries[num_entries]);
 
         /* Do not fail completely on errors.
          * Just report the failure to save and go on */
         if (ret) {
             DEBUG(SSSDBG_OP_FAILURE,
                   "Failed to store group %d. Ignoring.\n", i);
+            entry_idx[i] = -1;
+        } else if (entries[num_entries].name == NULL) {
+            /* not stored, but processed successfully */
+            entry_idx[i] = num_groups;
         } else {
-            DEBUG(SSSDBG_TRACE_ALL, "Group %d processed!\n", i);
-            if (twopass && !populate_members) {
-                saved_groups[nsaved_groups] = groups[i];
-                nsaved_groups++;
-            }
+            entry_idx[i] = num_entries;
+            num_entries++;
+        }
+    }
+
+    /* The groups are written in one batch, the members are stored in a
+     * second batch once all groups they may refer to are cached */
+    now = time(NULL);
+    ret = sysdb_store_groups_batch(sysdb, entries, num_entries, now);
+    if (ret) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to store the groups!\n");
+        goto done;
+    }
+
+    for (i = 0; i < num_groups; i++) {
+        if (entry_idx[i] == -1) {
+            continue;
+        }
+
+        if (entry_idx[i] < num_groups && entries[entry_idx[i]].ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  "Failed to store group %d. Ignoring.\n", i);
+            continue;
         }
 
+        DEBUG(SSSDBG_TRACE_ALL, "Group %d processed!\n", i);
+        if (twopass && !populate_members) {
+            saved_groups[nsaved_groups] = groups[i];
+            nsaved_groups++;
+        }
+
+        if (entry_idx[i] == num_groups) {
+            continue;
+        }
+
+        usn_value = usn_values[entry_idx[i]];
         if (usn_value) {
             if (higher_usn) {
                 if ((strlen(usn_value) > strlen(higher_usn)) ||
                     (strcmp(usn_value, higher_usn) > 0)) {
-                    talloc_zfree(higher_usn);
                     higher_usn = usn_value;
-                } else {
-                    talloc_zfree(usn_value);
                 }
             } else {
                 higher_usn = usn_value;
@@ -1101,18 +1149,43 @@ static int sdap_save_groups(TALLOC_CTX *memctx,
     }
 
     if (twopass && !populate_members) {
+        mem_entries = talloc_zero_array(tmpctx, struct sysdb_group_batch_entry,
+                                        nsaved_groups);
+        if (mem_entries == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
 
+        num_entries = 0;
         for (i = 0; i < nsaved_groups; i++) {
 
-            ret = sdap_save_grpmem(tmpctx, sysdb, opts, dom, saved_groups[i],
-                                   ghosts, now);
+            ret = sdap_prepare_grpmem(tmpctx, sysdb, opts, dom,
+                                      saved_groups[i], ghosts,
+                                      &mem_entries[num_entries]);
             /* Do not fail completely on errors.
              * Just report the failure to save and go on */
             if (ret) {
                 DEBUG(SSSDBG_OP_FAILURE,
                       "Failed to store group %d members.\n", i);
+            } else if (mem_entries[num_entries].name != NULL) {
+                num_entries++;
+            }
+        }
+
+        ret = sysdb_store_groups_batch(sysdb, mem_entries, num_entries, now);
+        if (ret) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Failed to store the group members!\n");
+            goto done;
+        }
+
+        for (i = 0; i < num_entries; i++) {
+            if (mem_entries[i].ret != EOK) {
+                DEBUG(SSSDBG_OP_FAILURE,
+                      "Failed to store group %s members.\n",
+                      mem_entries[i].name);
             } else {
-                DEBUG(SSSDBG_TRACE_ALL, "Group %d members processed!\n", i);
+                DEBUG(SSSDBG_TRACE_ALL, "Group %s members processed!\n",
+                      mem_entries[i].name);
             }
         }
     }
@@ -531,18 +531,248 @@ done:
     return ret;
 }
 
+/* Looks up a batch of groups of one domain by their SIDs with a single
+ * search and stores them without members */
+struct sdap_ad_groups_by_sids_state {
+    struct tevent_context *ev;
+    struct sdap_id_ctx *id_ctx;
+    struct sdap_domain *sdom;
+    struct sdap_id_op *op;
+
+    char *filter;
+    const char **attrs;
+
+    int dp_error;
+};
+
+static errno_t sdap_ad_groups_by_sids_retry(struct tevent_req *req);
+static void sdap_ad_groups_by_sids_connect_done(struct tevent_req *subreq);
+static void sdap_ad_groups_by_sids_done(struct tevent_req *subreq);
+
+static struct tevent_req *
+sdap_ad_groups_by_sids_send(TALLOC_CTX *mem_ctx,
+                            struct tevent_context *ev,
+                            struct sdap_id_ctx *id_ctx,
+                            struct sdap_id_conn_ctx *conn,
+                            struct sdap_domain *sdom,
+                            const char **sids,
+                            size_t num_sids)
+{
+    struct sdap_ad_groups_by_sids_state *state = NULL;
+    struct sdap_options *opts = id_ctx->opts;
+    struct tevent_req *req = NULL;
+    const char *member_filter[2];
+    char *sid_filter;
+    char *clean_sid;
+    char *oc_list;
+    size_t i;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state,
+                            struct sdap_ad_groups_by_sids_state);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_req_create() failed\n");
+        return NULL;
+    }
+
+    state->ev = ev;
+    state->id_ctx = id_ctx;
+    state->sdom = sdom;
+    state->dp_error = DP_ERR_FATAL;
+
+    state->op = sdap_id_op_create(state, conn->conn_cache);
+    if (state->op == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE, "sdap_id_op_create failed\n");
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    sid_filter = talloc_strdup(state, "(|");
+    for (i = 0; i < num_sids && sid_filter != NULL; i++) {
+        ret = sss_filter_sanitize(state, sids[i], &clean_sid);
+        if (ret != EOK) {
+            goto immediately;
+        }
+
+        sid_filter = talloc_asprintf_append_buffer(sid_filter, "(%s=%s)",
+                            opts->group_map[SDAP_AT_GROUP_OBJECTSID].name,
+                            clean_sid);
+        talloc_free(clean_sid);
+    }
+    if (sid_filter != NULL) {
+        sid_filter = talloc_asprintf_append_buffer(sid_filter, ")");
+    }
+    if (sid_filter == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    oc_list = sdap_make_oc_list(state, opts->group_map);
+    if (oc_list == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to create objectClass list.\n");
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    /* As with a single lookup by SID, groups without a GID are wanted too */
+    state->filter = talloc_asprintf(state, "(&%s(%s)(%s=*))",
+                                    sid_filter, oc_list,
+                                    opts->group_map[SDAP_AT_GROUP_NAME].name);
+    if (state->filter == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    member_filter[0] = opts->group_map[SDAP_AT_GROUP_MEMBER].name;
+    member_filter[1] = NULL;
+
+    ret = build_attrs_from_map(state, opts->group_map, SDAP_OPTS_GROUP,
+                               member_filter, &state->attrs, NULL);
+    if (ret != EOK) {
+        goto immediately;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Looking up %zu groups of domain %s by SID\n",
+          num_sids, sdom->dom->name);
+
+    ret = sdap_ad_groups_by_sids_retry(req);
+    if (ret != EOK) {
+        goto immediately;
+    }
+
+    return req;
+
+immediately:
+    tevent_req_error(req, ret);
+    tevent_req_post(req, ev);
+
+    return req;
+}
+
+static errno_t sdap_ad_groups_by_sids_retry(struct tevent_req *req)
+{
+    struct sdap_ad_groups_by_sids_state *state = NULL;
+    struct tevent_req *subreq = NULL;
+    errno_t ret;
+
+    state = tevent_req_data(req, struct sdap_ad_groups_by_sids_state);
+
+    subreq = sdap_id_op_connect_send(state->op, state, &ret);
+    if (subreq == NULL) {
+        return ret;
+    }
+
+    tevent_req_set_callback(subreq, sdap_ad_groups_by_sids_connect_done, req);
+
+    return EOK;
+}
+
+static void sdap_ad_groups_by_sids_connect_done(struct tevent_req *subreq)
+{
+    struct sdap_ad_groups_by_sids_state *state = NULL;
+    struct tevent_req *req = NULL;
+    int dp_error = DP_ERR_FATAL;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sdap_ad_groups_by_sids_state);
+
+    ret = sdap_id_op_connect_recv(subreq, &dp_error);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        state->dp_error = dp_error;
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    /* A batch may match more than one group, so search every base */
+    subreq = sdap_get_groups_send(state, state->ev, state->sdom,
+                                  state->id_ctx->opts,
+                                  sdap_id_op_handle(state->op),
+                                  state->attrs, state->filter,
+                                  dp_opt_get_int(state->id_ctx->opts->basic,
+                                                 SDAP_SEARCH_TIMEOUT),
+                                  SDAP_LOOKUP_WILDCARD, true);
+    if (subreq == NULL) {
+        tevent_req_error(req, ENOMEM);
+        return;
+    }
+
+    tevent_req_set_callback(subreq, sdap_ad_groups_by_sids_done, req);
+}
+
+static void sdap_ad_groups_by_sids_done(struct tevent_req *subreq)
+{
+    struct sdap_ad_groups_by_sids_state *state = NULL;
+    struct tevent_req *req = NULL;
+    int dp_error = DP_ERR_FATAL;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sdap_ad_groups_by_sids_state);
+
+    ret = sdap_get_groups_recv(subreq, NULL, NULL);
+    talloc_zfree(subreq);
+    ret = sdap_id_op_done(state->op, ret, &dp_error);
+    if (dp_error == DP_ERR_OK && ret != EOK) {
+        /* retry */
+        ret = sdap_ad_groups_by_sids_retry(req);
+        if (ret != EOK) {
+            tevent_req_error(req, ret);
+        }
+        return;
+    }
+
+    if (ret == ENOENT) {
+        /* none of the groups exists, this is not a failure of the server */
+        dp_error = DP_ERR_OK;
+    }
+
+    state->dp_error = dp_error;
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+static errno_t sdap_ad_groups_by_sids_recv(struct tevent_req *req,
+                                           int *_dp_error)
+{
+    struct sdap_ad_groups_by_sids_state *state = NULL;
+    state = tevent_req_data(req, struct sdap_ad_groups_by_sids_state);
+
+    *_dp_error = state->dp_error;
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
+/* SIDs of one domain that are looked up with a single search */
+struct sdap_ad_sids_batch {
+    struct sdap_domain *sdom;
+    const char **sids;
+    size_t num_sids;
+};
+
 struct sdap_ad_resolve_sids_state {
     struct tevent_context *ev;
     struct sdap_id_ctx *id_ctx;
     struct sdap_id_conn_ctx *conn;
     struct sdap_options *opts;
     struct sss_domain_info *domain;
-    char **sids;
 
-    const char *current_sid;
-    int index;
+    struct sdap_ad_sids_batch *batches;
+    size_t num_batches;
+    size_t next_batch;
+    size_t running;
+    size_t max_running;
 };
 
+static errno_t sdap_ad_resolve_sids_split(struct sdap_ad_resolve_sids_state *state,
+                                          char **sids);
 static errno_t sdap_ad_resolve_sids_step(struct tevent_req *req);
 static void sdap_ad_resolve_sids_done(struct tevent_req *subreq);
 
@@ -571,14 +801,23 @@ sdap_ad_resolve_sids_send(TALLOC_CTX *mem_ctx,
     state->conn = conn;
     state->opts = opts;
     state->domain = get_domains_head(domain);
-    state->sids = sids;
-    state->index = 0;
 
-    if (state->sids == NULL || state->sids[0] == NULL) {
+    state->max_running = dp_opt_get_int(opts->basic,
+                                        SDAP_NESTED_GROUP_PARALLEL);
+    if (state->max_running < 1) {
+        state->max_running = 1;
+    }
+
+    if (sids == NULL || sids[0] == NULL) {
         ret = EOK;
         goto immediately;
     }
 
+    ret = sdap_ad_resolve_sids_split(state, sids);
+    if (ret != EOK) {
+        goto immediately;
+    }
+
     ret = sdap_ad_resolve_sids_step(req);
     if (ret != EAGAIN) {
         goto immediately;
@@ -597,47 +836,112 @@ immediately:
     return req;
 }
 
-static errno_t sdap_ad_resolve_sids_step(struct tevent_req *req)
+/* Group the SIDs by their domain into batches of at most
+ * ldap_nested_group_batch_size SIDs */
+static errno_t sdap_ad_resolve_sids_split(struct sdap_ad_resolve_sids_state *state,
+                                          char **sids)
 {
-    struct sdap_ad_resolve_sids_state *state = NULL;
-    struct tevent_req *subreq = NULL;
-    struct sdap_domain *sdap_domain = NULL;
     struct sss_domain_info *domain = NULL;
+    struct sdap_domain *sdom = NULL;
+    struct sdap_ad_sids_batch *batch;
+    size_t batch_size;
+    int opt_batch_size;
+    int wildcard_limit;
+    size_t i;
+    size_t j;
 
-    state = tevent_req_data(req, struct sdap_ad_resolve_sids_state);
+    opt_batch_size = dp_opt_get_int(state->opts->basic,
+                                    SDAP_NESTED_GROUP_BATCH_SIZE);
+    wildcard_limit = dp_opt_get_int(state->opts->basic, SDAP_WILDCARD_LIMIT);
+    if (wildcard_limit > 0 && opt_batch_size > wildcard_limit) {
+        /* the batches are searched with the wildcard size limit */
+        opt_batch_size = wildcard_limit;
+    }
+    if (opt_batch_size < 1) {
+        opt_batch_size = 1;
+    }
+    batch_size = opt_batch_size;
 
-    do {
-        state->current_sid = state->sids[state->index];
-        if (state->current_sid == NULL) {
-            return EOK;
+    for (i = 0; sids[i] != NULL; i++) {
+        domain = sss_get_domain_by_sid_ldap_fallback(state->domain, sids[i]);
+        if (domain == NULL) {
+            DEBUG(SSSDBG_MINOR_FAILURE, "SID %s does not belong to any known "
+                                         "domain\n", sids[i]);
+            continue;
         }
-        state->index++;
 
-        domain = sss_get_domain_by_sid_ldap_fallback(state->domain,
-                                                     state->current_sid);
+        sdom = sdap_domain_get(state->opts, domain);
+        if (sdom == NULL) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "SDAP domain does not exist?\n");
+            return ERR_INTERNAL;
+        }
 
-        if (domain == NULL) {
-            DEBUG(SSSDBG_MINOR_FAILURE, "SID %s does not belong to any known "
-                                         "domain\n", state->current_sid);
+        /* only the last batch of a domain can have room left */
+        batch = NULL;
+        for (j = state->num_batches; j > 0; j--) {
+            if (state->batches[j - 1].sdom == sdom) {
+                if (state->batches[j - 1].num_sids < batch_size) {
+                    batch = &state->batches[j - 1];
+                }
+                break;
+            }
         }
-    } while (domain == NULL);
 
-    sdap_domain = sdap_domain_get(state->opts, domain);
-    if (sdap_domain == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "SDAP domain does not exist?\n");
-        return ERR_INTERNAL;
-    }
+        if (batch == NULL) {
+            state->batches = talloc_realloc(state, state->batches,
+                                            struct sdap_ad_sids_batch,
+                                            state->num_batches + 1);
+            if (state->batches == NULL) {
+                return ENOMEM;
+            }
 
-    subreq = groups_get_send(state, state->ev, state->id_ctx, sdap_domain,
-                             state->conn, state->current_sid,
-                             BE_FILTER_SECID, BE_ATTR_CORE, false, true);
-    if (subreq == NULL) {
-        return ENOMEM;
+            batch = &state->batches[state->num_batches];
+            batch->sdom = sdom;
+            batch->num_sids = 0;
+            batch->sids = talloc_zero_array(state->batches, const char *,
+                                            batch_size);
+            if (batch->sids == NULL) {
+                return ENOMEM;
+            }
+            state->num_batches++;
+        }
+
+        batch->sids[batch->num_sids] = sids[i];
+        batch->num_sids++;
     }
 
-    tevent_req_set_callback(subreq, sdap_ad_resolve_sids_done, req);
+    DEBUG(SSSDBG_TRACE_FUNC, "Resolving missing SIDs in %zu searches\n",
+          state->num_batches);
 
-    return EAGAIN;
+    return EOK;
+}
+
+/* Start as many batches as allowed, EAGAIN means some are running */
+static errno_t sdap_ad_resolve_sids_step(struct tevent_req *req)
+{
+    struct sdap_ad_resolve_sids_state *state = NULL;
+    struct sdap_ad_sids_batch *batch;
+    struct tevent_req *subreq = NULL;
+
+    state = tevent_req_data(req, struct sdap_ad_resolve_sids_state);
+
+    while (state->running < state->max_running
+            && state->next_batch < state->num_batches) {
+        batch = &state->batches[state->next_batch];
+        state->next_batch++;
+
+        subreq = sdap_ad_groups_by_sids_send(state, state->ev, state->id_ctx,
+                                             state->conn, batch->sdom,
+                                             batch->sids, batch->num_sids);
+        if (subreq == NULL) {
+            return ENOMEM;
+        }
+
+        tevent_req_set_callback(subreq, sdap_ad_resolve_sids_done, req);
+        state->running++;
+    }
+
+    return state->running > 0 ? EAGAIN : EOK;
 }
 
 static void sdap_ad_resolve_sids_done(struct tevent_req *subreq)
@@ -645,32 +949,33 @@ static void sdap_ad_resolve_sids_done(struct tevent_req *subreq)
     struct sdap_ad_resolve_sids_state *state = NULL;
     struct tevent_req *req = NULL;
     int dp_error;
-    int sdap_error;
     errno_t ret;
 
     req = tevent_req_callback_data(subreq, struct tevent_req);
     state = tevent_req_data(req, struct sdap_ad_resolve_sids_state);
 
-    ret = groups_get_recv(subreq, &dp_error, &sdap_error);
+    ret = sdap_ad_groups_by_sids_recv(subreq, &dp_error);
     talloc_zfree(subreq);
+    state->running--;
 
-    if (ret == EOK && sdap_error == ENOENT && dp_error == DP_ERR_OK) {
-        /* Group was not found, we will ignore the error and continue with
-         * next group. This may happen for example if the group is built-in,
-         * but a custom search base is provided. */
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "Unable to resolve SID %s - will try next sid.\n",
-              state->current_sid);
-    } else if (ret != EOK || sdap_error != EOK || dp_error != DP_ERR_OK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to resolve SID %s [dp_error: %d, "
-              "sdap_error: %d, ret: %d]: %s\n", state->current_sid, dp_error,
-              sdap_error, ret, strerror(ret));
+    if (ret == ENOENT && dp_error == DP_ERR_OK) {
+        /* No group was found, we will ignore the error and continue with
+         * next batch. This may happen for example if the groups are
+         * built-in, but a custom search base is provided. */
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Unable to resolve a batch of SIDs - will try next batch.\n");
+    } else if (ret != EOK || dp_error != DP_ERR_OK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to resolve SIDs [dp_error: %d, "
+              "ret: %d]: %s\n", dp_error, ret, strerror(ret));
+        if (ret == EOK) {
+            ret = EIO;
+        }
         goto done;
     }
 
     ret = sdap_ad_resolve_sids_step(req);
     if (ret == EAGAIN) {
-        /* continue with next SID */
+        /* wait for the remaining batches */
         return;
     }
 
@@ -1211,7 +1516,7 @@ sdap_ad_tokengroups_get_posix_members(TALLOC_CTX *mem_ctx,
 
     /* For each SID check if it is already present in the cache. If yes, we
      * will get name of the group and update the membership. Otherwise we need
-     * to remember the SID and download missing groups one by one. */
+     * to remember the SID and download the missing groups. */
     for (i = 0; i < num_sids; i++) {
         sid = sids[i];
         DEBUG(SSSDBG_TRACE_LIBS, "Processing membership SID [%s]\n", sid);
@@ -56,6 +56,19 @@ struct sdap_nested_group_member {
     const char *group_filter;
 };
 
+/* Members that are resolved with a single LDAP search. If base is NULL
+ * the batch contains exactly one member which is looked up with a base
+ * search on its DN, otherwise all members are searched for by their DN
+ * under base. */
+struct sdap_nested_group_batch {
+    enum sdap_nested_group_dn_type type;
+    const char *base;
+    struct sdap_nested_group_member **members;
+    int num_members;
+};
+
+struct sdap_nested_group_single_state;
+
 #ifndef EXTERNAL_MEMBERS_CHUNK
 #define EXTERNAL_MEMBERS_CHUNK  16
 #endif /* EXTERNAL_MEMBERS_CHUNK */
@@ -77,6 +90,13 @@ struct sdap_nested_group_ctx {
     bool try_deref;
     int deref_treshold;
     int max_nesting_level;
+
+    /* LDAP lookups of group members are limited across the whole request,
+     * requests that hit the limit wait in the queue for a free slot */
+    int max_lookups;
+    int active_lookups;
+    int batch_size;
+    struct sdap_nested_group_single_state *waiting;
 };
 
 static struct tevent_req *
@@ -835,6 +855,19 @@ sdap_nested_group_send(TALLOC_CTX *mem_ctx,
                                                       SDAP_DEREF_THRESHOLD);
     state->group_ctx->max_nesting_level = dp_opt_get_int(opts->basic,
                                                          SDAP_NESTING_LEVEL);
+    state->group_ctx->max_lookups = dp_opt_get_int(opts->basic,
+                                                   SDAP_NESTED_GROUP_PARALLEL);
+    if (state->group_ctx->max_lookups < 1) {
+        state->group_ctx->max_lookups = 1;
+    }
+
+    /* only AD allows searching for a list of objects by their DN */
+    state->group_ctx->batch_size = dp_opt_get_int(opts->basic,
+                                                  SDAP_NESTED_GROUP_BATCH_SIZE);
+    if (opts->schema_type != SDAP_SCHEMA_AD
+            || state->group_ctx->batch_size < 1) {
+        state->group_ctx->batch_size = 1;
+    }
     state->group_ctx->domain = sdom->dom;
     state->group_ctx->opts = opts;
     state->group_ctx->user_search_bases = sdom->user_search_bases;
@@ -1189,6 +1222,7 @@ struct sdap_nested_group_recurse_state {
     struct sysdb_attrs **groups;
     int num_groups;
     int index;
+    int active;
     int nesting_level;
 };
 
@@ -1219,9 +1253,10 @@ sdap_nested_group_recurse_send(TALLOC_CTX *mem_ctx,
     state->groups = nested_groups;
     state->num_groups = num_groups;
     state->index = 0;
+    state->active = 0;
     state->nesting_level = nesting_level;
 
-    /* process each group individually */
+    /* process up to max_lookups groups at the same time */
     ret = sdap_nested_group_recurse_step(req);
     if (ret != EAGAIN) {
         goto immediately;
@@ -1247,34 +1282,42 @@ static errno_t sdap_nested_group_recurse_step(struct tevent_req *req)
 
     state = tevent_req_data(req, struct sdap_nested_group_recurse_state);
 
-    if (state->index >= state->num_groups) {
-        /* we're done */
-        return EOK;
-    }
+    while (state->index < state->num_groups
+            && state->active < state->group_ctx->max_lookups) {
+        subreq = sdap_nested_group_process_send(state, state->ev,
+                                                state->group_ctx,
+                                                state->nesting_level,
+                                                state->groups[state->index]);
+        if (subreq == NULL) {
+            return ENOMEM;
+        }
 
-    subreq = sdap_nested_group_process_send(state, state->ev, state->group_ctx,
-                                            state->nesting_level,
-                                            state->groups[state->index]);
-    if (subreq == NULL) {
-        return ENOMEM;
-    }
+        tevent_req_set_callback(subreq, sdap_nested_group_recurse_done, req);
 
-    tevent_req_set_callback(subreq, sdap_nested_group_recurse_done, req);
+        state->index++;
+        state->active++;
+    }
 
-    state->index++;
+    if (state->active > 0) {
+        return EAGAIN;
+    }
 
-    return EAGAIN;
+    /* we're done */
+    return EOK;
 }
 
 static void sdap_nested_group_recurse_done(struct tevent_req *subreq)
 {
+    struct sdap_nested_group_recurse_state *state = NULL;
     struct tevent_req *req = NULL;
     errno_t ret;
 
     req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sdap_nested_group_recurse_state);
 
     ret = sdap_nested_group_process_recv(subreq);
     talloc_zfree(subreq);
+    state->active--;
     if (ret != EOK) {
         goto done;
     }
@@ -1298,24 +1341,213 @@ static errno_t sdap_nested_group_recurse_recv(struct tevent_req *req)
     return EOK;
 }
 
+static const char *
+sdap_nested_group_batch_base(struct sdap_nested_group_ctx *group_ctx,
+                             const char *dn)
+{
+    struct sdap_domain *sditer = NULL;
+    struct sdap_search_base *base;
+    size_t dn_len;
+    size_t base_len;
+    int i;
+
+    dn_len = strlen(dn);
+
+    DLIST_FOR_EACH(sditer, group_ctx->opts->sdom) {
+        if (sditer->search_bases == NULL) {
+            continue;
+        }
+
+        for (i = 0; sditer->search_bases[i] != NULL; i++) {
+            base = sditer->search_bases[i];
+            if (base->scope != LDAP_SCOPE_SUBTREE || base->filter != NULL) {
+                continue;
+            }
+
+            base_len = strlen(base->basedn);
+            if (base_len > dn_len
+                    || strcasecmp(&dn[dn_len - base_len], base->basedn) != 0) {
+                continue;
+            }
+
+            if (base_len < dn_len && dn[dn_len - base_len - 1] != ',') {
+                continue;
+            }
+
+            return base->basedn;
+        }
+    }
+
+    return NULL;
+}
+
+/* Members of the same type that live under the same search base are
+ * combined into batches of up to batch_size members, all other members
+ * are looked up individually. */
+static errno_t
+sdap_nested_group_make_batches(TALLOC_CTX *mem_ctx,
+                               struct sdap_nested_group_ctx *group_ctx,
+                               struct sdap_nested_group_member *members,
+                               int num_members,
+                               struct sdap_nested_group_batch **_batches,
+                               int *_num_batches)
+{
+    struct sdap_nested_group_batch *batches = NULL;
+    struct sdap_nested_group_batch *batch = NULL;
+    struct sdap_nested_group_member *member;
+    const char *base;
+    int num_batches = 0;
+    int i;
+    int j;
+
+    batches = talloc_zero_array(mem_ctx, struct sdap_nested_group_batch,
+                                num_members);
+    if (batches == NULL && num_members > 0) {
+        return ENOMEM;
+    }
+
+    for (i = 0; i < num_members; i++) {
+        member = &members[i];
+        base = NULL;
+
+        /* search base filters can not be combined */
+        if (group_ctx->batch_size > 1
+                && member->user_filter == NULL
+                && member->group_filter == NULL) {
+            base = sdap_nested_group_batch_base(group_ctx, member->dn);
+        }
+
+        batch = NULL;
+        if (base != NULL) {
+            /* the last batch with this type and base is the open one */
+            for (j = num_batches - 1; j >= 0; j--) {
+                if (batches[j].type == member->type
+                        && batches[j].base == base) {
+                    if (batches[j].num_members < group_ctx->batch_size) {
+                        batch = &batches[j];
+                    }
+                    break;
+                }
+            }
+        }
+
+        if (batch == NULL) {
+            batch = &batches[num_batches];
+            num_batches++;
+
+            batch->type = member->type;
+            batch->base = base;
+            batch->members = talloc_zero_array(batches,
+                                        struct sdap_nested_group_member *,
+                                        base == NULL ? 1 : group_ctx->batch_size);
+            if (batch->members == NULL) {
+                talloc_free(batches);
+                return ENOMEM;
+            }
+        }
+
+        batch->members[batch->num_members] = member;
+        batch->num_members++;
+    }
+
+    /* a batch of one member is cheaper as a base search */
+    for (i = 0; i < num_batches; i++) {
+        if (batches[i].num_members == 1) {
+            batches[i].base = NULL;
+        }
+    }
+
+    *_batches = batches;
+    *_num_batches = num_batches;
+
+    return EOK;
+}
+
 struct sdap_nested_group_single_state {
     struct tevent_context *ev;
+    struct tevent_req *req;
     struct sdap_nested_group_ctx *group_ctx;
-    struct sdap_nested_group_member *members;
     int nesting_level;
 
-    struct sdap_nested_group_member *current_member;
-    int num_members;
-    int member_index;
+    struct sdap_nested_group_batch *batches;
+    int num_batches;
+    int batch_index;
+    int active;
+
+    /* waiting for a free lookup slot */
+    bool waiting;
+    struct tevent_immediate *im;
+    struct sdap_nested_group_single_state *prev;
+    struct sdap_nested_group_single_state *next;
 
     struct sysdb_attrs **nested_groups;
     int num_groups;
+    int num_groups_max;
 };
 
 static errno_t sdap_nested_group_single_step(struct tevent_req *req);
+static void sdap_nested_group_single_next(struct tevent_req *req, errno_t ret);
 static void sdap_nested_group_single_step_done(struct tevent_req *subreq);
 static void sdap_nested_group_single_done(struct tevent_req *subreq);
 
+static struct tevent_req *
+sdap_nested_group_lookup_batch_send(TALLOC_CTX *mem_ctx,
+                                    struct tevent_context *ev,
+                                    struct sdap_nested_group_ctx *group_ctx,
+                                    struct sdap_nested_group_batch *batch);
+
+static errno_t
+sdap_nested_group_lookup_batch_recv(TALLOC_CTX *mem_ctx,
+                                    struct tevent_req *req,
+                                    enum sdap_nested_group_dn_type *_type,
+                                    size_t *_num_users,
+                                    struct sysdb_attrs ***_users,
+                                    size_t *_num_groups,
+                                    struct sysdb_attrs ***_groups);
+
+static int
+sdap_nested_group_single_destructor(struct sdap_nested_group_single_state *state)
+{
+    if (state->waiting) {
+        DLIST_REMOVE(state->group_ctx->waiting, state);
+        state->waiting = false;
+    }
+
+    state->group_ctx->active_lookups -= state->active;
+    state->active = 0;
+
+    return 0;
+}
+
+static void sdap_nested_group_single_wakeup(struct tevent_context *ev,
+                                            struct tevent_immediate *im,
+                                            void *pvt)
+{
+    struct tevent_req *req = talloc_get_type(pvt, struct tevent_req);
+
+    sdap_nested_group_single_next(req, sdap_nested_group_single_step(req));
+}
+
+static void
+sdap_nested_group_lookup_release(struct sdap_nested_group_ctx *group_ctx)
+{
+    struct sdap_nested_group_single_state *waiter;
+
+    group_ctx->active_lookups--;
+
+    /* let the request that waits longest continue */
+    waiter = group_ctx->waiting;
+    if (waiter == NULL) {
+        return;
+    }
+
+    DLIST_REMOVE(group_ctx->waiting, waiter);
+    waiter->waiting = false;
+
+    tevent_schedule_immediate(waiter->im, waiter->ev,
+                              sdap_nested_group_single_wakeup, waiter->req);
+}
+
 static struct tevent_req *
 sdap_nested_group_single_send(TALLOC_CTX *mem_ctx,
                               struct tevent_context *ev,
@@ -1337,12 +1569,11 @@ sdap_nested_group_single_send(TALLOC_CTX *mem_ctx,
     }
 
     state->ev = ev;
+    state->req = req;
     state->group_ctx = group_ctx;
-    state->members = members;
     state->nesting_level = nesting_level;
-    state->current_member = NULL;
-    state->num_members = num_members;
-    state->member_index = 0;
+    state->batch_index = 0;
+    state->active = 0;
     state->nested_groups = talloc_zero_array(state, struct sysdb_attrs *,
                                              num_groups_max);
     if (state->nested_groups == NULL) {
@@ -1350,8 +1581,29 @@ sdap_nested_group_single_send(TALLOC_CTX *mem_ctx,
         goto immediately;
     }
     state->num_groups = 0; /* we will count exact number of the groups */
+    state->num_groups_max = num_groups_max;
+
+    state->im = tevent_create_immediate(state);
+    if (state->im == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    ret = sdap_nested_group_make_batches(state, group_ctx, members,
+                                         num_members, &state->batches,
+                                         &state->num_batches);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to split members into batches "
+                                    "[%d]: %s\n", ret, sss_strerror(ret));
+        goto immediately;
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, "%d members will be resolved with %d "
+                                 "lookups\n", num_members, state->num_batches);
 
-    /* process each member individually */
+    talloc_set_destructor(state, sdap_nested_group_single_destructor);
+
+    /* process members, up to max_lookups lookups at the same time */
     ret = sdap_nested_group_single_step(req);
     if (ret != EAGAIN) {
         goto immediately;
@@ -1373,43 +1625,44 @@ immediately:
 static errno_t sdap_nested_group_single_step(struct tevent_req *req)
 {
     struct sdap_nested_group_single_state *state = NULL;
+    struct sdap_nested_group_ctx *group_ctx = NULL;
     struct tevent_req *subreq = NULL;
 
     state = tevent_req_data(req, struct sdap_nested_group_single_state);
+    group_ctx = state->group_ctx;
+
+    while (state->batch_index < state->num_batches) {
+        if (group_ctx->active_lookups >= group_ctx->max_lookups) {
+            /* wait until some other lookup finishes */
+            if (!state->waiting) {
+                DLIST_ADD_END(group_ctx->waiting, state,
+                              struct sdap_nested_group_single_state *);
+                state->waiting = true;
+            }
+            return EAGAIN;
+        }
 
-    if (state->member_index >= state->num_members) {
-        /* we're done */
-        return EOK;
-    }
+        subreq = sdap_nested_group_lookup_batch_send(state, state->ev,
+                                      group_ctx,
+                                      &state->batches[state->batch_index]);
+        if (subreq == NULL) {
+            return ENOMEM;
+        }
 
-    state->current_member = &state->members[state->member_index];
-    state->member_index++;
+        tevent_req_set_callback(subreq, sdap_nested_group_single_step_done,
+                                req);
 
-    switch (state->current_member->type) {
-    case SDAP_NESTED_GROUP_DN_USER:
-        subreq = sdap_nested_group_lookup_user_send(state, state->ev,
-                                                    state->group_ctx,
-                                                    state->current_member);
-        break;
-    case SDAP_NESTED_GROUP_DN_GROUP:
-        subreq = sdap_nested_group_lookup_group_send(state, state->ev,
-                                                     state->group_ctx,
-                                                     state->current_member);
-        break;
-    case SDAP_NESTED_GROUP_DN_UNKNOWN:
-        subreq = sdap_nested_group_lookup_unknown_send(state, state->ev,
-                                                   state->group_ctx,
-                                                   state->current_member);
-        break;
+        state->batch_index++;
+        state->active++;
+        group_ctx->active_lookups++;
     }
 
-    if (subreq == NULL) {
-        return ENOMEM;
+    if (state->active > 0 || state->waiting) {
+        return EAGAIN;
     }
 
-    tevent_req_set_callback(subreq, sdap_nested_group_single_step_done, req);
-
-    return EAGAIN;
+    /* we're done */
+    return EOK;
 }
 
 static errno_t
@@ -1417,73 +1670,47 @@ sdap_nested_group_single_step_process(struct tevent_req *subreq)
 {
     struct sdap_nested_group_single_state *state = NULL;
     struct tevent_req *req = NULL;
-    struct sysdb_attrs *entry = NULL;
+    struct sysdb_attrs **users = NULL;
+    struct sysdb_attrs **groups = NULL;
     enum sdap_nested_group_dn_type type = SDAP_NESTED_GROUP_DN_UNKNOWN;
+    size_t num_users = 0;
+    size_t num_groups = 0;
     const char *orig_dn = NULL;
+    size_t i;
     errno_t ret;
 
     req = tevent_req_callback_data(subreq, struct tevent_req);
     state = tevent_req_data(req, struct sdap_nested_group_single_state);
 
-    /* set correct type if possible */
-    if (state->current_member->type == SDAP_NESTED_GROUP_DN_UNKNOWN) {
-        ret = sdap_nested_group_lookup_unknown_recv(state, subreq,
-                                                    &entry, &type);
-        if (ret != EOK) {
-            goto done;
-        }
-
-        if (entry != NULL) {
-            state->current_member->type = type;
-        }
+    ret = sdap_nested_group_lookup_batch_recv(state, subreq, &type,
+                                              &num_users, &users,
+                                              &num_groups, &groups);
+    if (ret != EOK) {
+        goto done;
     }
 
-    switch (state->current_member->type) {
-    case SDAP_NESTED_GROUP_DN_USER:
-        if (entry == NULL) {
-            /* type was not unknown, receive data */
-            ret = sdap_nested_group_lookup_user_recv(state, subreq, &entry);
-            if (ret != EOK) {
-                goto done;
-            }
-
-            if (entry == NULL) {
-                /* user not found, continue */
-                break;
-            }
-        }
-
+    for (i = 0; i < num_users; i++) {
         /* save user in hash table */
-        ret = sdap_nested_group_hash_user(state->group_ctx, entry);
+        ret = sdap_nested_group_hash_user(state->group_ctx, users[i]);
         if (ret == EEXIST) {
             /* the user is already present, skip it */
-            talloc_zfree(entry);
-            ret = EOK;
-            goto done;
+            talloc_zfree(users[i]);
+            continue;
         } else if (ret != EOK) {
             DEBUG(SSSDBG_CRIT_FAILURE, "Unable to save user in hash table "
                                         "[%d]: %s\n", ret, strerror(ret));
             goto done;
         }
-        break;
-    case SDAP_NESTED_GROUP_DN_GROUP:
-        if (entry == NULL) {
-            /* type was not unknown, receive data */
-            ret = sdap_nested_group_lookup_group_recv(state, subreq, &entry);
-            if (ret != EOK) {
-                goto done;
-            }
+    }
 
-            if (entry == NULL) {
-                /* group not found, continue */
-                break;
-            }
-        } else {
+    for (i = 0; i < num_groups; i++) {
+        if (type == SDAP_NESTED_GROUP_DN_UNKNOWN) {
             /* the type was unknown so we had to pull the group,
              * but we don't want to process it if we have reached
              * the nesting level */
             if (state->nesting_level >= state->group_ctx->max_nesting_level) {
-                ret = sysdb_attrs_get_string(entry, SYSDB_ORIG_DN, &orig_dn);
+                ret = sysdb_attrs_get_string(groups[i], SYSDB_ORIG_DN,
+                                             &orig_dn);
                 if (ret != EOK) {
                     DEBUG(SSSDBG_MINOR_FAILURE,
                           "The entry has no originalDN\n");
@@ -1492,17 +1719,23 @@ sdap_nested_group_single_step_process(struct tevent_req *subreq)
 
                 DEBUG(SSSDBG_TRACE_ALL, "[%s] is outside nesting limit "
                       "(level %d), skipping\n", orig_dn, state->nesting_level);
-                break;
+                continue;
             }
         }
 
+        if (state->num_groups >= state->num_groups_max) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Lookup returned more groups than requested, "
+                  "ignoring the rest\n");
+            break;
+        }
+
         /* save group in hash table */
-        ret = sdap_nested_group_hash_group(state->group_ctx, entry);
+        ret = sdap_nested_group_hash_group(state->group_ctx, groups[i]);
         if (ret == EEXIST) {
             /* the group is already present, skip it */
-            talloc_zfree(entry);
-            ret = EOK;
-            goto done;
+            talloc_zfree(groups[i]);
+            continue;
         } else if (ret != EOK) {
             DEBUG(SSSDBG_CRIT_FAILURE, "Unable to save group in hash table "
                                         "[%d]: %s\n", ret, strerror(ret));
@@ -1510,18 +1743,16 @@ sdap_nested_group_single_step_process(struct tevent_req *subreq)
         }
 
         /* remember the group for later processing */
-        state->nested_groups[state->num_groups] = entry;
+        state->nested_groups[state->num_groups] = groups[i];
         state->num_groups++;
-
-        break;
-    case SDAP_NESTED_GROUP_DN_UNKNOWN:
-        /* not found in users nor nested_groups, continue */
-        break;
     }
 
     ret = EOK;
 
 done:
+    /* entries saved in the hash tables were moved there */
+    talloc_free(users);
+    talloc_free(groups);
     return ret;
 }
 
@@ -1537,13 +1768,27 @@ static void sdap_nested_group_single_step_done(struct tevent_req *subreq)
     /* process direct members */
     ret = sdap_nested_group_single_step_process(subreq);
     talloc_zfree(subreq);
+
+    state->active--;
+    sdap_nested_group_lookup_release(state->group_ctx);
+
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, "Error processing direct membership "
                                     "[%d]: %s\n", ret, strerror(ret));
-        goto done;
+        tevent_req_error(req, ret);
+        return;
     }
 
-    ret = sdap_nested_group_single_step(req);
+    sdap_nested_group_single_next(req, sdap_nested_group_single_step(req));
+}
+
+static void sdap_nested_group_single_next(struct tevent_req *req, errno_t ret)
+{
+    struct sdap_nested_group_single_state *state = NULL;
+    struct tevent_req *subreq = NULL;
+
+    state = tevent_req_data(req, struct sdap_nested_group_single_state);
+
     if (ret == EOK) {
         /* we have processed all direct members,
          * now recurse and process nested groups */
@@ -1553,28 +1798,16 @@ static void sdap_nested_group_single_step_done(struct tevent_req *subreq)
                                                 state->num_groups,
                                                 state->nesting_level + 1);
         if (subreq == NULL) {
-            ret = ENOMEM;
-            goto done;
+            tevent_req_error(req, ENOMEM);
+            return;
         }
 
         tevent_req_set_callback(subreq, sdap_nested_group_single_done, req);
-    } else if (ret != EAGAIN) {
-        /* error */
-        goto done;
-    }
-
-    /* we're not done yet */
-    ret = EAGAIN;
-
-done:
-    if (ret == EOK) {
-        /* tevent_req_error() cannot cope with EOK */
-        DEBUG(SSSDBG_CRIT_FAILURE, "We should not get here with EOK\n");
-        tevent_req_error(req, EINVAL);
     } else if (ret != EAGAIN) {
         tevent_req_error(req, ret);
     }
 
+    /* we're not done yet */
     return;
 }
 
@@ -2123,6 +2356,417 @@ sdap_nested_group_lookup_unknown_recv(TALLOC_CTX *mem_ctx,
     return EOK;
 }
 
+struct sdap_nested_group_lookup_batch_state {
+    struct tevent_context *ev;
+    struct sdap_nested_group_ctx *group_ctx;
+    struct sdap_nested_group_batch *batch;
+
+    struct sysdb_attrs **users;
+    size_t num_users;
+    struct sysdb_attrs **groups;
+    size_t num_groups;
+};
+
+static errno_t
+sdap_nested_group_lookup_batch_search(struct tevent_req *req,
+                                      enum sdap_nested_group_dn_type type);
+static void sdap_nested_group_lookup_batch_single_done(struct tevent_req *subreq);
+static void sdap_nested_group_lookup_batch_users_done(struct tevent_req *subreq);
+static void sdap_nested_group_lookup_batch_groups_done(struct tevent_req *subreq);
+
+static struct tevent_req *
+sdap_nested_group_lookup_batch_send(TALLOC_CTX *mem_ctx,
+                                    struct tevent_context *ev,
+                                    struct sdap_nested_group_ctx *group_ctx,
+                                    struct sdap_nested_group_batch *batch)
+{
+    struct sdap_nested_group_lookup_batch_state *state = NULL;
+    struct tevent_req *req = NULL;
+    struct tevent_req *subreq = NULL;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state,
+                            struct sdap_nested_group_lookup_batch_state);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_req_create() failed\n");
+        return NULL;
+    }
+
+    state->ev = ev;
+    state->group_ctx = group_ctx;
+    state->batch = batch;
+
+    if (batch->base == NULL) {
+        /* single member, use base search on its DN */
+        switch (batch->type) {
+        case SDAP_NESTED_GROUP_DN_USER:
+            subreq = sdap_nested_group_lookup_user_send(state, ev, group_ctx,
+                                                        batch->members[0]);
+            break;
+        case SDAP_NESTED_GROUP_DN_GROUP:
+            subreq = sdap_nested_group_lookup_group_send(state, ev, group_ctx,
+                                                         batch->members[0]);
+            break;
+        case SDAP_NESTED_GROUP_DN_UNKNOWN:
+            subreq = sdap_nested_group_lookup_unknown_send(state, ev,
+                                                           group_ctx,
+                                                           batch->members[0]);
+            break;
+        }
+
+        if (subreq == NULL) {
+            ret = ENOMEM;
+            goto immediately;
+        }
+
+        tevent_req_set_callback(subreq,
+                                sdap_nested_group_lookup_batch_single_done,
+                                req);
+
+        return req;
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, "Looking up %d members under [%s] with "
+                                 "a single search\n",
+                                 batch->num_members, batch->base);
+
+    /* unknown members are searched for as users first */
+    ret = sdap_nested_group_lookup_batch_search(req,
+                            batch->type == SDAP_NESTED_GROUP_DN_GROUP ?
+                                    SDAP_NESTED_GROUP_DN_GROUP :
+                                    SDAP_NESTED_GROUP_DN_USER);
+    if (ret != EAGAIN) {
+        goto immediately;
+    }
+
+    return req;
+
+immediately:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+
+    return req;
+}
+
+static void sdap_nested_group_lookup_batch_single_done(struct tevent_req *subreq)
+{
+    struct sdap_nested_group_lookup_batch_state *state = NULL;
+    struct tevent_req *req = NULL;
+    struct sysdb_attrs *entry = NULL;
+    struct sysdb_attrs ***entries;
+    size_t *num_entries;
+    enum sdap_nested_group_dn_type type;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sdap_nested_group_lookup_batch_state);
+
+    type = state->batch->type;
+    switch (type) {
+    case SDAP_NESTED_GROUP_DN_USER:
+        ret = sdap_nested_group_lookup_user_recv(state, subreq, &entry);
+        break;
+    case SDAP_NESTED_GROUP_DN_GROUP:
+        ret = sdap_nested_group_lookup_group_recv(state, subreq, &entry);
+        break;
+    case SDAP_NESTED_GROUP_DN_UNKNOWN:
+    default:
+        ret = sdap_nested_group_lookup_unknown_recv(state, subreq,
+                                                    &entry, &type);
+        break;
+    }
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    if (entry == NULL) {
+        /* not found, continue */
+        ret = EOK;
+        goto done;
+    }
+
+    if (type == SDAP_NESTED_GROUP_DN_USER) {
+        entries = &state->users;
+        num_entries = &state->num_users;
+    } else {
+        entries = &state->groups;
+        num_entries = &state->num_groups;
+    }
+
+    *entries = talloc_array(state, struct sysdb_attrs *, 1);
+    if (*entries == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    (*entries)[0] = talloc_steal(*entries, entry);
+    *num_entries = 1;
+
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+static bool
+sdap_nested_group_lookup_batch_found(struct sdap_nested_group_lookup_batch_state *state,
+                                     const char *dn)
+{
+    const char *orig_dn;
+    errno_t ret;
+    size_t i;
+
+    for (i = 0; i < state->num_users; i++) {
+        ret = sysdb_attrs_get_string(state->users[i], SYSDB_ORIG_DN, &orig_dn);
+        if (ret == EOK && strcasecmp(orig_dn, dn) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static errno_t
+sdap_nested_group_lookup_batch_search(struct tevent_req *req,
+                                      enum sdap_nested_group_dn_type type)
+{
+    struct sdap_nested_group_lookup_batch_state *state = NULL;
+    struct sdap_nested_group_ctx *group_ctx = NULL;
+    struct sdap_attr_map *map;
+    struct tevent_req *subreq = NULL;
+    const char **attrs = NULL;
+    char *base_filter = NULL;
+    char *dn_filter = NULL;
+    char *filter = NULL;
+    char *sanitized = NULL;
+    char *oc_list;
+    size_t map_cnt;
+    int num_dns = 0;
+    int i;
+    errno_t ret;
+
+    state = tevent_req_data(req, struct sdap_nested_group_lookup_batch_state);
+    group_ctx = state->group_ctx;
+
+    dn_filter = talloc_strdup(state, "");
+    if (dn_filter == NULL) {
+        return ENOMEM;
+    }
+
+    for (i = 0; i < state->batch->num_members; i++) {
+        /* when looking for groups of unknown type skip found users */
+        if (state->batch->type == SDAP_NESTED_GROUP_DN_UNKNOWN
+                && type == SDAP_NESTED_GROUP_DN_GROUP
+                && sdap_nested_group_lookup_batch_found(state,
+                                    state->batch->members[i]->dn)) {
+            continue;
+        }
+
+        ret = sss_filter_sanitize(state, state->batch->members[i]->dn,
+                                  &sanitized);
+        if (ret != EOK) {
+            return ret;
+        }
+
+        dn_filter = talloc_asprintf_append_buffer(dn_filter,
+                                                  "(distinguishedName=%s)",
+                                                  sanitized);
+        talloc_zfree(sanitized);
+        if (dn_filter == NULL) {
+            return ENOMEM;
+        }
+
+        num_dns++;
+    }
+
+    if (num_dns == 0) {
+        talloc_free(dn_filter);
+        return EOK;
+    }
+
+    if (type == SDAP_NESTED_GROUP_DN_USER) {
+        /* only pull down username and originalDN */
+        map = group_ctx->opts->user_map;
+        map_cnt = group_ctx->opts->user_map_cnt;
+
+        attrs = talloc_array(state, const char *, 3);
+        if (attrs == NULL) {
+            return ENOMEM;
+        }
+
+        attrs[0] = "objectClass";
+        attrs[1] = map[SDAP_AT_USER_NAME].name;
+        attrs[2] = NULL;
+
+        base_filter = talloc_asprintf(state, "(objectclass=%s)",
+                                      map[SDAP_OC_USER].name);
+        if (base_filter == NULL) {
+            return ENOMEM;
+        }
+    } else {
+        map = group_ctx->opts->group_map;
+        map_cnt = SDAP_OPTS_GROUP;
+
+        ret = build_attrs_from_map(state, map, SDAP_OPTS_GROUP, NULL,
+                                   &attrs, NULL);
+        if (ret != EOK) {
+            return ret;
+        }
+
+        oc_list = sdap_make_oc_list(state, map);
+        if (oc_list == NULL) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Failed to create objectClass list.\n");
+            return ENOMEM;
+        }
+
+        base_filter = talloc_asprintf(state, "(&(%s)(%s=*))", oc_list,
+                                      map[SDAP_AT_GROUP_NAME].name);
+        if (base_filter == NULL) {
+            return ENOMEM;
+        }
+    }
+
+    filter = talloc_asprintf(state, "(&%s(|%s))", base_filter, dn_filter);
+    talloc_free(dn_filter);
+    if (filter == NULL) {
+        return ENOMEM;
+    }
+
+    subreq = sdap_get_generic_send(state, state->ev, group_ctx->opts,
+                                   group_ctx->sh, state->batch->base,
+                                   LDAP_SCOPE_SUBTREE, filter, attrs,
+                                   map, map_cnt,
+                                   dp_opt_get_int(group_ctx->opts->basic,
+                                                  SDAP_SEARCH_TIMEOUT),
+                                   false);
+    if (subreq == NULL) {
+        return ENOMEM;
+    }
+
+    if (type == SDAP_NESTED_GROUP_DN_USER) {
+        tevent_req_set_callback(subreq,
+                                sdap_nested_group_lookup_batch_users_done,
+                                req);
+    } else {
+        tevent_req_set_callback(subreq,
+                                sdap_nested_group_lookup_batch_groups_done,
+                                req);
+    }
+
+    return EAGAIN;
+}
+
+static void sdap_nested_group_lookup_batch_users_done(struct tevent_req *subreq)
+{
+    struct sdap_nested_group_lookup_batch_state *state = NULL;
+    struct tevent_req *req = NULL;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sdap_nested_group_lookup_batch_state);
+
+    ret = sdap_get_generic_recv(subreq, state, &state->num_users,
+                                &state->users);
+    talloc_zfree(subreq);
+    if (ret == ENOENT) {
+        state->num_users = 0;
+    } else if (ret != EOK) {
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, "%zu of %d members found as users\n",
+                                 state->num_users, state->batch->num_members);
+
+    if (state->batch->type != SDAP_NESTED_GROUP_DN_UNKNOWN) {
+        ret = EOK;
+        goto done;
+    }
+
+    /* not all members were users, try groups */
+    ret = sdap_nested_group_lookup_batch_search(req,
+                                                SDAP_NESTED_GROUP_DN_GROUP);
+
+done:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else if (ret != EAGAIN) {
+        tevent_req_error(req, ret);
+    }
+}
+
+static void
+sdap_nested_group_lookup_batch_groups_done(struct tevent_req *subreq)
+{
+    struct sdap_nested_group_lookup_batch_state *state = NULL;
+    struct tevent_req *req = NULL;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sdap_nested_group_lookup_batch_state);
+
+    ret = sdap_get_generic_recv(subreq, state, &state->num_groups,
+                                &state->groups);
+    talloc_zfree(subreq);
+    if (ret == ENOENT) {
+        state->num_groups = 0;
+    } else if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, "%zu of %d members found as groups\n",
+                                 state->num_groups, state->batch->num_members);
+
+    tevent_req_done(req);
+}
+
+static errno_t
+sdap_nested_group_lookup_batch_recv(TALLOC_CTX *mem_ctx,
+                                    struct tevent_req *req,
+                                    enum sdap_nested_group_dn_type *_type,
+                                    size_t *_num_users,
+                                    struct sysdb_attrs ***_users,
+                                    size_t *_num_groups,
+                                    struct sysdb_attrs ***_groups)
+{
+    struct sdap_nested_group_lookup_batch_state *state = NULL;
+    state = tevent_req_data(req, struct sdap_nested_group_lookup_batch_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    if (_type != NULL) {
+        *_type = state->batch->type;
+    }
+
+    if (_num_users != NULL) {
+        *_num_users = state->num_users;
+    }
+
+    if (_users != NULL) {
+        *_users = talloc_steal(mem_ctx, state->users);
+    }
+
+    if (_num_groups != NULL) {
+        *_num_groups = state->num_groups;
+    }
+
+    if (_groups != NULL) {
+        *_groups = talloc_steal(mem_ctx, state->groups);
+    }
+
+    return EOK;
+}
+
 struct sdap_nested_group_deref_state {
     struct tevent_context *ev;
     struct sdap_nested_group_ctx *group_ctx;
@@ -61,6 +61,8 @@ int sdap_op_add(TALLOC_CTX *memctx, struct tevent_context *ev,
                 sdap_op_callback_t *callback, void *data,
                 int timeout, struct sdap_op **_op);
 
+void sdap_unlock_next_reply(struct sdap_op *op);
+
 struct tevent_req *sdap_get_rootdse_send(TALLOC_CTX *memctx,
                                          struct tevent_context *ev,
                                          struct sdap_options *opts,
@@ -96,6 +98,17 @@ int sdap_save_users(TALLOC_CTX *memctx,
                     int num_users,
                     char **_usn_value);
 
+int sdap_save_groups(TALLOC_CTX *memctx,
+                     struct sysdb_ctx *sysdb,
+                     struct sss_domain_info *dom,
+                     struct sdap_options *opts,
+                     struct sysdb_attrs **groups,
+                     int num_groups,
+                     bool populate_members,
+                     hash_table_t *ghosts,
+                     bool save_orig_member,
+                     char **_usn_value);
+
 int sdap_initgr_common_store(struct sysdb_ctx *sysdb,
                              struct sss_domain_info *domain,
                              struct sdap_options *opts,
@@ -111,13 +111,15 @@ done:
     return ret;
 }
 
+/* Fills the cache entry of the user returned by LDAP in attrs. The name of
+ * the entry is left NULL for objects that are not stored in the cache. */
 /* FIXME: support storing additional attributes */
-int sdap_save_user(TALLOC_CTX *memctx,
-                   struct sdap_options *opts,
-                   struct sss_domain_info *dom,
-                   struct sysdb_attrs *attrs,
-                   char **_usn_value,
-                   time_t now)
+static int sdap_prepare_user(TALLOC_CTX *memctx,
+                             struct sdap_options *opts,
+                             struct sss_domain_info *dom,
+                             struct sysdb_attrs *attrs,
+                             char **_usn_value,
+                             struct sysdb_user_batch_entry *entry)
 {
     struct ldb_message_element *el;
     int ret;
@@ -144,6 +146,8 @@ int sdap_save_user(TALLOC_CTX *memctx,
 
     DEBUG(SSSDBG_TRACE_FUNC, "Save user\n");
 
+    memset(entry, 0, sizeof(struct sysdb_user_batch_entry));
+
     tmpctx = talloc_new(NULL);
     if (!tmpctx) {
         ret = ENOMEM;
@@ -481,18 +485,23 @@ int sdap_save_user(TALLOC_CTX *memctx,
         goto done;
     }
 
-    DEBUG(SSSDBG_TRACE_FUNC, "Storing info for user %s\n", user_name);
-
-    ret = sysdb_store_user(dom, user_name, pwd, uid, gid,
-                           gecos, homedir, shell, orig_dn,
-                           user_attrs, missing, cache_timeout, now);
-    if (ret) goto done;
+    entry->domain = dom;
+    entry->name = user_name;
+    entry->pwd = pwd;
+    entry->uid = uid;
+    entry->gid = gid;
+    entry->gecos = gecos;
+    entry->homedir = homedir;
+    entry->shell = shell;
+    entry->orig_dn = orig_dn;
+    entry->attrs = talloc_steal(memctx, user_attrs);
+    entry->remove_attrs = missing;
+    entry->cache_timeout = cache_timeout;
 
     if (_usn_value) {
         *_usn_value = talloc_steal(memctx, usn_value);
     }
 
-    talloc_steal(memctx, user_attrs);
     ret = EOK;
 
 done:
@@ -505,6 +514,51 @@ done:
     return ret;
 }
 
+int sdap_save_user(TALLOC_CTX *memctx,
+                   struct sdap_options *opts,
+                   struct sss_domain_info *dom,
+                   struct sysdb_attrs *attrs,
+                   char **_usn_value,
+                   time_t now)
+{
+    TALLOC_CTX *tmpctx;
+    struct sysdb_user_batch_entry entry;
+    char *usn_value = NULL;
+    int ret;
+
+    tmpctx = talloc_new(NULL);
+    if (!tmpctx) {
+        return ENOMEM;
+    }
+
+    ret = sdap_prepare_user(tmpctx, opts, dom, attrs, &usn_value, &entry);
+    if (ret != EOK || entry.name == NULL) {
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Storing info for user %s\n", entry.name);
+
+    ret = sysdb_store_user(entry.domain, entry.name, entry.pwd,
+                           entry.uid, entry.gid, entry.gecos, entry.homedir,
+                           entry.shell, entry.orig_dn, entry.attrs,
+                           entry.remove_attrs, entry.cache_timeout, now);
+    if (ret) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Failed to save user [%s]\n", entry.name);
+        goto done;
+    }
+
+    if (_usn_value) {
+        *_usn_value = talloc_steal(memctx, usn_value);
+    }
+
+    talloc_steal(memctx, entry.attrs);
+
+done:
+    talloc_free(tmpctx);
+    return ret;
+}
+
 
 /* ==Generic-Function-to-save-multiple-users============================= */
 
@@ -517,13 +571,14 @@ int sdap_save_users(TALLOC_CTX *memctx,
                     char **_usn_value)
 {
     TALLOC_CTX *tmpctx;
+    struct sysdb_user_batch_entry *entries;
+    char **usn_values;
     char *higher_usn = NULL;
     char *usn_value;
+    int num_entries = 0;
     int ret;
-    errno_t sret;
     int i;
     time_t now;
-    bool in_transaction = false;
 
     if (num_users == 0) {
         /* Nothing to do if there are no users */
@@ -535,35 +590,50 @@ int sdap_save_users(TALLOC_CTX *memctx,
         return ENOMEM;
     }
 
-    ret = sysdb_transaction_start(sysdb);
-    if (ret) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to start transaction\n");
+    entries = talloc_zero_array(tmpctx, struct sysdb_user_batch_entry,
+                                num_users);
+    usn_values = talloc_zero_array(tmpctx, char *, num_users);
+    if (entries == NULL || usn_values == NULL) {
+        ret = ENOMEM;
         goto done;
     }
-    in_transaction = true;
 
-    now = time(NULL);
     for (i = 0; i < num_users; i++) {
-        usn_value = NULL;
-
-        ret = sdap_save_user(tmpctx, opts, dom, users[i], &usn_value, now);
+        ret = sdap_prepare_user(tmpctx, opts, dom, users[i],
+                                &usn_values[num_entries],
+                                &entries[num_entries]);
 
         /* Do not fail completely on errors.
          * Just report the failure to save and go on */
         if (ret) {
             DEBUG(SSSDBG_OP_FAILURE, "Failed to store user %d. Ignoring.\n", i);
-        } else {
-            DEBUG(SSSDBG_TRACE_ALL, "User %d processed!\n", i);
+        } else if (entries[num_entries].name != NULL) {
+            num_entries++;
         }
+    }
+
+    /* All users are written in a single transaction */
+    now = time(NULL);
+    ret = sysdb_store_users_batch(sysdb, entries, num_entries, now);
+    if (ret) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to store the users!\n");
+        goto done;
+    }
 
+    for (i = 0; i < num_entries; i++) {
+        if (entries[i].ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "Failed to store user %s. Ignoring.\n",
+                  entries[i].name);
+            continue;
+        }
+        DEBUG(SSSDBG_TRACE_ALL, "User %s processed!\n", entries[i].name);
+
+        usn_value = usn_values[i];
         if (usn_value) {
             if (higher_usn) {
                 if ((strlen(usn_value) > strlen(higher_usn)) ||
                     (strcmp(usn_value, higher_usn) > 0)) {
-                    talloc_zfree(higher_usn);
                     higher_usn = usn_value;
-                } else {
-                    talloc_zfree(usn_value);
                 }
             } else {
                 higher_usn = usn_value;
@@ -571,24 +641,11 @@ int sdap_save_users(TALLOC_CTX *memctx,
         }
     }
 
-    ret = sysdb_transaction_commit(sysdb);
-    if (ret) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to commit transaction!\n");
-        goto done;
-    }
-    in_transaction = false;
-
     if (_usn_value) {
         *_usn_value = talloc_steal(memctx, higher_usn);
     }
 
 done:
-    if (in_transaction) {
-        sret = sysdb_transaction_cancel(sysdb);
-        if (sret != EOK) {
-            DEBUG(SSSDBG_CRIT_FAILURE, "Failed to cancel transaction\n");
-        }
-    }
     talloc_zfree(tmpctx);
     return ret;
 }
@@ -32,8 +32,17 @@ struct sdap_id_conn_cache {
 
     /* list of all open connections */
     struct sdap_id_conn_data *connections;
-    /* cached (current) connection */
-    struct sdap_id_conn_data *cached_connection;
+    /* cached (current) connections, new operations are started on the
+     * least loaded one */
+    struct sdap_id_conn_data **pool;
+    int pool_size;
+    /* maximum number of operations per pooled connection, 0 for no limit */
+    int max_ops;
+    /* operations waiting for a pooled connection to become available */
+    struct sdap_id_op *waiting;
+    /* seconds an operation waits before it shares a busy connection */
+    int wait_timeout;
+    struct tevent_timer *dispatch_timer;
 };
 
 /* LDAP async operation tracker:
@@ -48,6 +57,15 @@ struct sdap_id_op {
     struct sdap_id_conn_data *conn_data;
     /* number of reconnects for this operation */
     int reconnect_retry_count;
+    /* operation which does not end, e.g. a persistent search, it does not
+     * count toward the limit of operations per connection */
+    bool long_lived;
+    /* operation is on the list of waiting operations */
+    bool waiting;
+    /* lifts the limit of operations per connection for this operation
+     * once it has waited for too long */
+    struct tevent_timer *wait_timer;
+    bool wait_expired;
     /* connection request
      * It is required as we need to know which requests to notify
      * when shared connection request to sdap_handle completes.
@@ -72,6 +90,8 @@ struct sdap_id_conn_data {
     int notify_lock;
     /* list of operations using connect */
     struct sdap_id_op *ops;
+    /* number of operations in the list which are not long-lived */
+    int num_ops;
     /* A flag which is signalizing that this
      * connection will be disconnected and should
      * not be used any more */
@@ -81,6 +101,11 @@ struct sdap_id_conn_data {
 static void sdap_id_conn_cache_be_offline_cb(void *pvt);
 static void sdap_id_conn_cache_fo_reconnect_cb(void *pvt);
 
+static bool sdap_id_conn_cache_is_pooled(struct sdap_id_conn_data *conn_data);
+static bool sdap_id_conn_cache_pool_add(struct sdap_id_conn_data *conn_data);
+static void sdap_id_conn_cache_pool_remove(struct sdap_id_conn_data *conn_data);
+static void sdap_id_conn_cache_schedule_dispatch(struct sdap_id_conn_cache *conn_cache);
+static void sdap_id_op_stop_waiting(struct sdap_id_op *op);
 static void sdap_id_release_conn_data(struct sdap_id_conn_data *conn_data);
 static int sdap_id_conn_data_destroy(struct sdap_id_conn_data *conn_data);
 static bool sdap_is_connection_expired(struct sdap_id_conn_data *conn_data, int timeout);
@@ -116,6 +141,31 @@ int sdap_id_conn_cache_create(TALLOC_CTX *memctx,
 
     conn_cache->id_conn = id_conn;
 
+    conn_cache->pool_size = dp_opt_get_int(id_conn->id_ctx->opts->basic,
+                                           SDAP_CONNECTION_POOL_SIZE);
+    if (conn_cache->pool_size < 1) {
+        DEBUG(SSSDBG_CONF_SETTINGS,
+              "Invalid connection pool size %d, using 1\n",
+              conn_cache->pool_size);
+        conn_cache->pool_size = 1;
+    }
+
+    conn_cache->max_ops = dp_opt_get_int(id_conn->id_ctx->opts->basic,
+                                         SDAP_CONNECTION_POOL_MAX_OPS);
+    if (conn_cache->max_ops < 0) {
+        conn_cache->max_ops = 0;
+    }
+
+    conn_cache->wait_timeout = dp_opt_get_int(id_conn->id_ctx->opts->basic,
+                                              SDAP_SEARCH_TIMEOUT);
+
+    conn_cache->pool = talloc_zero_array(conn_cache, struct sdap_id_conn_data *,
+                                         conn_cache->pool_size);
+    if (conn_cache->pool == NULL) {
+        ret = ENOMEM;
+        goto fail;
+    }
+
     ret = be_add_offline_cb(conn_cache, id_conn->id_ctx->be,
                             sdap_id_conn_cache_be_offline_cb, conn_cache,
                             NULL);
@@ -144,12 +194,16 @@ fail:
 static void sdap_id_conn_cache_be_offline_cb(void *pvt)
 {
     struct sdap_id_conn_cache *conn_cache = talloc_get_type(pvt, struct sdap_id_conn_cache);
-    struct sdap_id_conn_data *cached_connection = conn_cache->cached_connection;
+    struct sdap_id_conn_data *cached_connection;
+    int i;
 
     /* Release any cached connection on going offline */
-    if (cached_connection != NULL) {
-        conn_cache->cached_connection = NULL;
-        sdap_id_release_conn_data(cached_connection);
+    for (i = 0; i < conn_cache->pool_size; i++) {
+        cached_connection = conn_cache->pool[i];
+        if (cached_connection != NULL) {
+            conn_cache->pool[i] = NULL;
+            sdap_id_release_conn_data(cached_connection);
+        }
     }
 }
 
@@ -157,11 +211,275 @@ static void sdap_id_conn_cache_be_offline_cb(void *pvt)
 static void sdap_id_conn_cache_fo_reconnect_cb(void *pvt)
 {
     struct sdap_id_conn_cache *conn_cache = talloc_get_type(pvt, struct sdap_id_conn_cache);
-    struct sdap_id_conn_data *cached_connection = conn_cache->cached_connection;
+    int i;
 
     /* Release any cached connection on going offline */
-    if (cached_connection != NULL) {
-        cached_connection->disconnecting = true;
+    for (i = 0; i < conn_cache->pool_size; i++) {
+        if (conn_cache->pool[i] != NULL) {
+            conn_cache->pool[i]->disconnecting = true;
+        }
+    }
+}
+
+/* Check whether the connection is one of the cached connections */
+static bool sdap_id_conn_cache_is_pooled(struct sdap_id_conn_data *conn_data)
+{
+    struct sdap_id_conn_cache *conn_cache = conn_data->conn_cache;
+    int i;
+
+    for (i = 0; i < conn_cache->pool_size; i++) {
+        if (conn_cache->pool[i] == conn_data) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Cache the connection in a free slot of the pool */
+static bool sdap_id_conn_cache_pool_add(struct sdap_id_conn_data *conn_data)
+{
+    struct sdap_id_conn_cache *conn_cache = conn_data->conn_cache;
+    int i;
+
+    if (sdap_id_conn_cache_is_pooled(conn_data)) {
+        return true;
+    }
+
+    for (i = 0; i < conn_cache->pool_size; i++) {
+        if (conn_cache->pool[i] == NULL) {
+            conn_cache->pool[i] = conn_data;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Drop the connection from the pool, operations using it may finish */
+static void sdap_id_conn_cache_pool_remove(struct sdap_id_conn_data *conn_data)
+{
+    struct sdap_id_conn_cache *conn_cache = conn_data->conn_cache;
+    int i;
+
+    for (i = 0; i < conn_cache->pool_size; i++) {
+        if (conn_cache->pool[i] == conn_data) {
+            conn_cache->pool[i] = NULL;
+            /* the slot can take a new connection */
+            sdap_id_conn_cache_schedule_dispatch(conn_cache);
+            return;
+        }
+    }
+}
+
+/* Check whether another pooled connection is established */
+static bool sdap_id_conn_cache_has_other_connection(struct sdap_id_conn_data *conn_data)
+{
+    struct sdap_id_conn_cache *conn_cache = conn_data->conn_cache;
+    struct sdap_id_conn_data *other;
+    int i;
+
+    for (i = 0; i < conn_cache->pool_size; i++) {
+        other = conn_cache->pool[i];
+        if (other != NULL && other != conn_data && other->connect_req == NULL
+                && other->sh != NULL && other->sh->connected) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Find the least loaded pooled connection that can take an operation,
+ * ignoring the limit of operations per connection if limit is false.
+ * Connections that can no longer be reused are released on the way and
+ * the first free slot of the pool is returned in _free_slot (-1 if the
+ * pool is full) */
+static struct sdap_id_conn_data *
+sdap_id_conn_cache_pick(struct sdap_id_conn_cache *conn_cache,
+                        bool limit,
+                        int *_free_slot)
+{
+    struct sdap_id_conn_data *conn_data;
+    struct sdap_id_conn_data *best = NULL;
+    int free_slot = -1;
+    int i;
+
+    for (i = 0; i < conn_cache->pool_size; i++) {
+        conn_data = conn_cache->pool[i];
+
+        if (conn_data != NULL && conn_data->connect_req == NULL
+                && !sdap_can_reuse_connection(conn_data)) {
+            DEBUG(SSSDBG_TRACE_ALL, "releasing expired cached connection\n");
+            conn_cache->pool[i] = NULL;
+            sdap_id_release_conn_data(conn_data);
+            conn_data = NULL;
+        }
+
+        if (conn_data == NULL) {
+            if (free_slot == -1) {
+                free_slot = i;
+            }
+            continue;
+        }
+
+        if (limit && conn_cache->max_ops > 0
+                && conn_data->num_ops >= conn_cache->max_ops) {
+            continue;
+        }
+
+        if (best == NULL || conn_data->num_ops < best->num_ops) {
+            best = conn_data;
+        }
+    }
+
+    *_free_slot = free_slot;
+    return best;
+}
+
+/* Find the pooled connection of an operation the new operation is nested
+ * in, i.e. one started by a request the new operation belongs to. Such
+ * a nested operation must not wait for the limit of operations per
+ * connection as the connection it waits for is only released after the
+ * nested operation finishes. Contexts from the back end up are shared by
+ * all operations and are not considered. */
+static struct sdap_id_conn_data *
+sdap_id_op_parent_conn_data(struct sdap_id_op *op)
+{
+    struct sdap_id_conn_cache *conn_cache = op->conn_cache;
+    struct sdap_id_conn_data *conn_data;
+    struct sdap_id_op *other;
+    TALLOC_CTX *ctx;
+    int i;
+
+    for (ctx = talloc_parent(op);
+         ctx != NULL && ctx != conn_cache->id_conn->id_ctx->be;
+         ctx = talloc_parent(ctx)) {
+        for (i = 0; i < conn_cache->pool_size; i++) {
+            conn_data = conn_cache->pool[i];
+            if (conn_data == NULL) {
+                continue;
+            }
+
+            DLIST_FOR_EACH(other, conn_data->ops) {
+                if (other != op && talloc_parent(other) == ctx) {
+                    return conn_data;
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/* Let an operation that waited for too long share a busy connection */
+static void sdap_id_op_wait_timeout(struct tevent_context *ev,
+                                    struct tevent_timer *te,
+                                    struct timeval current_time,
+                                    void *pvt)
+{
+    struct sdap_id_op *op = talloc_get_type(pvt, struct sdap_id_op);
+    int ret;
+
+    op->wait_timer = NULL;
+
+    DEBUG(SSSDBG_MINOR_FAILURE,
+          "operation waited %d seconds for a cached connection, "
+          "sharing a busy one\n", op->conn_cache->wait_timeout);
+
+    sdap_id_op_stop_waiting(op);
+    op->wait_expired = true;
+
+    ret = sdap_id_op_connect_step(op->connect_req);
+    if (ret != EOK) {
+        sdap_id_op_connect_req_complete(op, DP_ERR_FATAL, ret);
+        return;
+    }
+
+    if (op->conn_data && !op->conn_data->connect_req) {
+        sdap_id_op_connect_req_complete(op, DP_ERR_OK, EOK);
+    }
+}
+
+/* Queue the operation until a pooled connection becomes available */
+static errno_t sdap_id_op_start_waiting(struct sdap_id_op *op)
+{
+    struct sdap_id_conn_cache *conn_cache = op->conn_cache;
+    struct timeval tv;
+
+    if (op->wait_timer == NULL && conn_cache->wait_timeout > 0) {
+        tv = tevent_timeval_current_ofs(conn_cache->wait_timeout, 0);
+        op->wait_timer = tevent_add_timer(conn_cache->id_conn->id_ctx->be->ev,
+                                          op, tv, sdap_id_op_wait_timeout, op);
+        if (op->wait_timer == NULL) {
+            return ENOMEM;
+        }
+    }
+
+    DLIST_ADD_END(conn_cache->waiting, op, struct sdap_id_op*);
+    op->waiting = true;
+
+    return EOK;
+}
+
+/* Remove the operation from the list of waiting operations */
+static void sdap_id_op_stop_waiting(struct sdap_id_op *op)
+{
+    if (op->waiting) {
+        DLIST_REMOVE(op->conn_cache->waiting, op);
+        op->waiting = false;
+    }
+}
+
+/* Start the waiting operations on the connections that became available */
+static void sdap_id_conn_cache_dispatch(struct tevent_context *ev,
+                                        struct tevent_timer *te,
+                                        struct timeval current_time,
+                                        void *pvt)
+{
+    struct sdap_id_conn_cache *conn_cache = talloc_get_type(pvt,
+                                                struct sdap_id_conn_cache);
+    struct sdap_id_op *op;
+    int ret;
+
+    conn_cache->dispatch_timer = NULL;
+
+    while ((op = conn_cache->waiting) != NULL) {
+        sdap_id_op_stop_waiting(op);
+
+        ret = sdap_id_op_connect_step(op->connect_req);
+        if (ret != EOK) {
+            sdap_id_op_connect_req_complete(op, DP_ERR_FATAL, ret);
+            continue;
+        }
+
+        if (op->waiting) {
+            /* still no connection available, keep the order */
+            DLIST_REMOVE(conn_cache->waiting, op);
+            DLIST_ADD(conn_cache->waiting, op);
+            break;
+        }
+
+        if (op->conn_data && !op->conn_data->connect_req) {
+            DEBUG(SSSDBG_TRACE_ALL, "waiting operation got a connection\n");
+            sdap_id_op_connect_req_complete(op, DP_ERR_OK, EOK);
+        }
+    }
+}
+
+static void sdap_id_conn_cache_schedule_dispatch(struct sdap_id_conn_cache *conn_cache)
+{
+    if (conn_cache->waiting == NULL || conn_cache->dispatch_timer != NULL) {
+        return;
+    }
+
+    conn_cache->dispatch_timer =
+                    tevent_add_timer(conn_cache->id_conn->id_ctx->be->ev,
+                                     conn_cache, tevent_timeval_zero(),
+                                     sdap_id_conn_cache_dispatch, conn_cache);
+    if (conn_cache->dispatch_timer == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Cannot schedule the waiting LDAP operations\n");
     }
 }
 
@@ -175,7 +493,7 @@ static void sdap_id_release_conn_data(struct sdap_id_conn_data *conn_data)
     }
 
     conn_cache = conn_data->conn_cache;
-    if (conn_data == conn_cache->cached_connection) {
+    if (sdap_id_conn_cache_is_pooled(conn_data)) {
         return;
     }
 
@@ -195,6 +513,7 @@ static int sdap_id_conn_data_destroy(struct sdap_id_conn_data *conn_data)
         op->conn_data = NULL;
         DLIST_REMOVE(conn_data->ops, op);
     }
+    conn_data->num_ops = 0;
 
     return 0;
 }
@@ -275,13 +594,12 @@ static void sdap_id_conn_data_expire_handler(struct tevent_context *ev,
 {
     struct sdap_id_conn_data *conn_data = talloc_get_type(pvt,
                                                           struct sdap_id_conn_data);
-    struct sdap_id_conn_cache *conn_cache = conn_data->conn_cache;
 
     DEBUG(SSSDBG_MINOR_FAILURE,
           "connection is about to expire, releasing it\n");
 
-    if (conn_cache->cached_connection == conn_data) {
-        conn_cache->cached_connection = NULL;
+    if (sdap_id_conn_cache_is_pooled(conn_data)) {
+        sdap_id_conn_cache_pool_remove(conn_data);
 
         sdap_id_release_conn_data(conn_data);
     }
@@ -301,6 +619,20 @@ struct sdap_id_op *sdap_id_op_create(TALLOC_CTX *memctx, struct sdap_id_conn_cac
     return op;
 }
 
+/* Do not count the operation toward the limit of operations per connection */
+void sdap_id_op_set_long_lived(struct sdap_id_op *op)
+{
+    if (op->long_lived) {
+        return;
+    }
+
+    op->long_lived = true;
+    if (op->conn_data) {
+        op->conn_data->num_ops--;
+        sdap_id_conn_cache_schedule_dispatch(op->conn_cache);
+    }
+}
+
 /* Attach/detach connection to sdap_id_op */
 static void sdap_id_op_hook_conn_data(struct sdap_id_op *op, struct sdap_id_conn_data *conn_data)
 {
@@ -316,16 +648,24 @@ static void sdap_id_op_hook_conn_data(struct sdap_id_op *op, struct sdap_id_conn
 
     if (current) {
         DLIST_REMOVE(current->ops, op);
+        if (!op->long_lived) {
+            current->num_ops--;
+        }
     }
 
     op->conn_data = conn_data;
 
     if (conn_data) {
         DLIST_ADD_END(conn_data->ops, op, struct sdap_id_op*);
+        if (!op->long_lived) {
+            conn_data->num_ops++;
+        }
     }
 
     if (current) {
         sdap_id_release_conn_data(current);
+        /* the connection may take one of the waiting operations now */
+        sdap_id_conn_cache_schedule_dispatch(op->conn_cache);
     }
 }
 
@@ -334,6 +674,8 @@ static int sdap_id_op_destroy(void *pvt)
 {
     struct sdap_id_op *op = talloc_get_type(pvt, struct sdap_id_op);
 
+    sdap_id_op_stop_waiting(op);
+
     if (op->conn_data) {
         DEBUG(SSSDBG_TRACE_ALL, "releasing operation connection\n");
         sdap_id_op_hook_conn_data(op, NULL);
@@ -378,6 +720,10 @@ static int sdap_id_op_connect_state_destroy(void *pvt)
     if (state->op != NULL) {
         /* clear destroyed connection request */
         state->op->connect_req = NULL;
+
+        sdap_id_op_stop_waiting(state->op);
+        talloc_zfree(state->op->wait_timer);
+        state->op->wait_expired = false;
     }
 
     return 0;
@@ -459,25 +805,45 @@ static int sdap_id_op_connect_step(struct tevent_req *req)
     int ret = EOK;
     struct sdap_id_conn_data *conn_data;
     struct tevent_req *subreq = NULL;
-
-    /* Try to reuse context cached connection */
-    conn_data = conn_cache->cached_connection;
-    if (conn_data) {
-        if (conn_data->connect_req) {
-            DEBUG(SSSDBG_TRACE_ALL, "waiting for connection to complete\n");
+    int free_slot;
+
+    /* A nested operation shares the connection of its parent operation
+     * regardless of the limit of operations per connection */
+    if (conn_cache->max_ops > 0 && !op->wait_expired) {
+        conn_data = sdap_id_op_parent_conn_data(op);
+        if (conn_data != NULL && (conn_data->connect_req != NULL
+                    || sdap_can_reuse_connection(conn_data))) {
+            DEBUG(SSSDBG_TRACE_ALL,
+                  "sharing the connection of the parent operation\n");
             sdap_id_op_hook_conn_data(op, conn_data);
             goto done;
         }
+    }
 
-        if (sdap_can_reuse_connection(conn_data)) {
+    /* Try to reuse context cached connection. A busy one is only shared
+     * when the pool cannot take another connection. A long-lived operation
+     * never waits as it does not take a place on the connection. */
+    conn_data = sdap_id_conn_cache_pick(conn_cache,
+                                        !op->wait_expired && !op->long_lived,
+                                        &free_slot);
+    if (conn_data && (conn_data->num_ops == 0 || free_slot == -1
+                      || op->long_lived)) {
+        if (conn_data->connect_req) {
+            DEBUG(SSSDBG_TRACE_ALL, "waiting for connection to complete\n");
+        } else {
             DEBUG(SSSDBG_TRACE_ALL, "reusing cached connection\n");
-            sdap_id_op_hook_conn_data(op, conn_data);
-            goto done;
         }
+        sdap_id_op_hook_conn_data(op, conn_data);
+        goto done;
+    }
 
-        DEBUG(SSSDBG_TRACE_ALL, "releasing expired cached connection\n");
-        conn_cache->cached_connection = NULL;
-        sdap_id_release_conn_data(conn_data);
+    if (free_slot == -1) {
+        DEBUG(SSSDBG_TRACE_ALL,
+              "all %d cached connections are busy, waiting\n",
+              conn_cache->pool_size);
+        sdap_id_op_hook_conn_data(op, NULL);
+        ret = sdap_id_op_start_waiting(op);
+        goto done;
     }
 
     DEBUG(SSSDBG_TRACE_ALL, "beginning to connect\n");
@@ -506,11 +872,15 @@ static int sdap_id_op_connect_step(struct tevent_req *req)
     conn_data->connect_req = subreq;
 
     DLIST_ADD(conn_cache->connections, conn_data);
-    conn_cache->cached_connection = conn_data;
+    conn_cache->pool[free_slot] = conn_data;
 
     sdap_id_op_hook_conn_data(op, conn_data);
 
 done:
+    if (!op->waiting) {
+        talloc_zfree(op->wait_timer);
+    }
+
     if (ret != EOK && conn_data) {
         sdap_id_release_conn_data(conn_data);
     }
@@ -643,9 +1013,7 @@ static void sdap_id_op_connect_done(struct tevent_req *subreq)
             bool retry = false;
 
             /* drop connection from cache now */
-            if (conn_cache->cached_connection == conn_data) {
-                conn_cache->cached_connection = NULL;
-            }
+            sdap_id_conn_cache_pool_remove(conn_data);
 
             if (can_retry) {
                 /* determining whether retry is possible */
@@ -705,19 +1073,21 @@ static void sdap_id_op_connect_done(struct tevent_req *subreq)
 
     if ((ret == EOK) &&
         conn_data->sh->connected &&
-        !be_is_offline(conn_cache->id_conn->id_ctx->be)) {
+        !be_is_offline(conn_cache->id_conn->id_ctx->be) &&
+        sdap_id_conn_cache_pool_add(conn_data)) {
         DEBUG(SSSDBG_TRACE_ALL,
               "caching successful connection after %d notifies\n", notify_count);
-        conn_cache->cached_connection = conn_data;
 
-        /* Run any post-connection routines */
-        be_run_unconditional_online_cb(conn_cache->id_conn->id_ctx->be);
-        be_run_online_cb(conn_cache->id_conn->id_ctx->be);
+        /* Run any post-connection routines, once for the whole pool */
+        if (!sdap_id_conn_cache_has_other_connection(conn_data)) {
+            be_run_unconditional_online_cb(conn_cache->id_conn->id_ctx->be);
+            be_run_online_cb(conn_cache->id_conn->id_ctx->be);
+        }
 
+        /* operations queued while the pool was full may use it */
+        sdap_id_conn_cache_schedule_dispatch(conn_cache);
     } else {
-        if (conn_cache->cached_connection == conn_data) {
-            conn_cache->cached_connection = NULL;
-        }
+        sdap_id_conn_cache_pool_remove(conn_data);
 
         sdap_id_release_conn_data(conn_data);
     }
@@ -820,9 +1190,9 @@ int sdap_id_op_done(struct sdap_id_op *op, int retval, int *dp_err_out)
     }
 
     if (communication_error && current_conn != 0
-            && current_conn == op->conn_cache->cached_connection) {
+            && sdap_id_conn_cache_is_pooled(current_conn)) {
         /* do not reuse failed connection */
-        op->conn_cache->cached_connection = NULL;
+        sdap_id_conn_cache_pool_remove(current_conn);
 
         DEBUG(SSSDBG_FUNC_DATA,
               "communication error on cached connection, moving to next server\n");
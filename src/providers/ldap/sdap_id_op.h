@@ -44,6 +44,11 @@ int sdap_id_conn_cache_create(TALLOC_CTX *memctx,
 /* Create an operation object */
 struct sdap_id_op *sdap_id_op_create(TALLOC_CTX *memctx, struct sdap_id_conn_cache *cache);
 
+/* Mark an operation which never ends, e.g. a persistent search. It shares
+ * the pooled connections without counting toward their limit of
+ * operations, so it neither waits for nor blocks other operations. */
+void sdap_id_op_set_long_lived(struct sdap_id_op *op);
+
 /* Begin to connect to LDAP server. */
 struct tevent_req *sdap_id_op_connect_send(struct sdap_id_op *op,
                                            TALLOC_CTX *memctx,
@@ -86,6 +86,9 @@ struct resolv_ctx {
      * if our pending requests didn't timeout. */
     int pending_requests;
     struct tevent_timer *timeout_watcher;
+
+    /* Answers of recent DNS queries and the queries in progress */
+    struct resolv_cache *cache;
 };
 
 struct request_watch {
@@ -99,6 +102,11 @@ struct resolv_request {
     struct tevent_timer *request_timeout;
 };
 
+static errno_t
+resolv_cache_init(TALLOC_CTX *mem_ctx, struct resolv_cache **_cache);
+static void
+resolv_cache_purge(struct resolv_cache *cache, bool expired_only);
+
 static int
 return_code(int ares_code)
 {
@@ -477,6 +485,13 @@ resolv_init(TALLOC_CTX *mem_ctx, struct tevent_context *ev_ctx,
 
     talloc_set_destructor(ctx, resolv_ctx_destructor);
 
+    /* Caching is disabled until resolv_cache_set_max_ttl() is called,
+     * concurrent queries of the same name are merged nevertheless */
+    ret = resolv_cache_init(ctx, &ctx->cache);
+    if (ret != EOK) {
+        goto done;
+    }
+
     *ctxp = ctx;
     return EOK;
 
@@ -489,6 +504,9 @@ void
 resolv_reread_configuration(struct resolv_ctx *ctx)
 {
     recreate_ares_channel(ctx);
+
+    /* The answers may come from different servers now */
+    resolv_cache_purge(ctx->cache, false);
 }
 
 static errno_t
@@ -1030,6 +1048,650 @@ resolv_gethostbyname_dns_recv(struct tevent_req *req, TALLOC_CTX *mem_ctx,
     return EOK;
 }
 
+/*******************************************************************
+ * DNS answer cache                                                *
+ *******************************************************************/
+
+/* Answers from DNS are kept for the TTL of the answer, but at most for
+ * max_ttl seconds. Names that do not exist are kept for
+ * RESOLV_NEGATIVE_TTL seconds. A lookup of a name that is already being
+ * queried waits for the pending query instead of sending another one, this
+ * is done even if caching is disabled. */
+
+#define RESOLV_CACHE_PURGE_COUNT 256
+
+enum resolv_cache_type {
+    RESOLV_CACHE_HOST,
+    RESOLV_CACHE_SRV
+};
+
+struct resolv_cache_waiter {
+    struct resolv_cache_waiter *prev;
+    struct resolv_cache_waiter *next;
+
+    struct resolv_cache_entry *entry;
+    struct tevent_req *req;
+};
+
+struct resolv_cache_entry {
+    struct resolv_cache *cache;
+    char *key;
+    bool in_table;
+
+    enum resolv_cache_type type;
+    int family;
+    char *name;
+
+    /* The query that is in progress and the lookups waiting for it */
+    struct tevent_req *query;
+    struct resolv_cache_waiter *waiters;
+    bool notifying;
+
+    /* The answer */
+    time_t expire;
+    errno_t error;
+    int status;
+    int timeouts;
+    struct resolv_hostent *rhostent;
+    struct ares_srv_reply *reply_list;
+    uint32_t ttl;
+};
+
+struct resolv_cache {
+    hash_table_t *table;
+    uint32_t max_ttl;
+    struct resolv_cache_stats stats;
+};
+
+static struct tevent_req *
+resolv_getsrv_dns_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
+                       struct resolv_ctx *ctx, const char *query);
+static int
+resolv_getsrv_dns_recv(TALLOC_CTX *mem_ctx, struct tevent_req *req,
+                       int *status, int *timeouts,
+                       struct ares_srv_reply **reply_list, uint32_t *ttl);
+
+static int
+resolv_cache_destructor(struct resolv_cache *cache)
+{
+    hash_destroy(cache->table);
+    cache->table = NULL;
+    return 0;
+}
+
+static errno_t
+resolv_cache_init(TALLOC_CTX *mem_ctx, struct resolv_cache **_cache)
+{
+    struct resolv_cache *cache;
+    int hret;
+
+    cache = talloc_zero(mem_ctx, struct resolv_cache);
+    if (cache == NULL) {
+        return ENOMEM;
+    }
+
+    hret = hash_create(32, &cache->table, NULL, NULL);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Cannot create the DNS cache [%d]: %s\n",
+              hret, hash_error_string(hret));
+        talloc_free(cache);
+        return ENOMEM;
+    }
+    talloc_set_destructor(cache, resolv_cache_destructor);
+
+    *_cache = cache;
+    return EOK;
+}
+
+static int
+resolv_cache_entry_destructor(struct resolv_cache_entry *entry)
+{
+    struct resolv_cache_waiter *waiter;
+    hash_key_t key;
+
+    if (entry->in_table && entry->cache->table != NULL) {
+        key.type = HASH_KEY_STRING;
+        key.str = entry->key;
+        hash_delete(entry->cache->table, &key);
+    }
+
+    /* nobody will answer the waiting lookups anymore */
+    while ((waiter = entry->waiters) != NULL) {
+        DLIST_REMOVE(entry->waiters, waiter);
+        waiter->entry = NULL;
+    }
+
+    return 0;
+}
+
+static int
+resolv_cache_waiter_destructor(struct resolv_cache_waiter *waiter)
+{
+    if (waiter->entry != NULL) {
+        DLIST_REMOVE(waiter->entry->waiters, waiter);
+    }
+
+    return 0;
+}
+
+static void
+resolv_cache_entry_unlink(struct resolv_cache_entry *entry)
+{
+    hash_key_t key;
+
+    if (entry->in_table) {
+        key.type = HASH_KEY_STRING;
+        key.str = entry->key;
+        hash_delete(entry->cache->table, &key);
+        entry->in_table = false;
+    }
+}
+
+/* Removes all answers, or only the expired ones. Pending queries stay. */
+static void
+resolv_cache_purge(struct resolv_cache *cache, bool expired_only)
+{
+    struct resolv_cache_entry *entry;
+    hash_value_t *values;
+    unsigned long count;
+    unsigned long i;
+    time_t now;
+    int hret;
+
+    hret = hash_values(cache->table, &count, &values);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_OP_FAILURE, "Cannot list the DNS cache [%d]: %s\n",
+              hret, hash_error_string(hret));
+        return;
+    }
+
+    now = time(NULL);
+    for (i = 0; i < count; i++) {
+        entry = talloc_get_type(values[i].ptr, struct resolv_cache_entry);
+        if (entry->query != NULL || entry->notifying) {
+            continue;
+        }
+
+        if (!expired_only || entry->expire <= now) {
+            talloc_free(entry);
+        }
+    }
+
+    free(values);
+}
+
+static struct resolv_cache_entry *
+resolv_cache_get(struct resolv_cache *cache, const char *key_str)
+{
+    hash_key_t key;
+    hash_value_t value;
+    int hret;
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(key_str);
+
+    hret = hash_lookup(cache->table, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        return NULL;
+    }
+
+    return talloc_get_type(value.ptr, struct resolv_cache_entry);
+}
+
+static void
+resolv_cache_query_done(struct tevent_req *subreq);
+
+static struct resolv_cache_entry *
+resolv_cache_query_send(struct tevent_context *ev,
+                        struct resolv_ctx *ctx,
+                        const char *key_str,
+                        enum resolv_cache_type type,
+                        int family,
+                        const char *name)
+{
+    struct resolv_cache *cache = ctx->cache;
+    struct resolv_cache_entry *entry;
+    hash_key_t key;
+    hash_value_t value;
+    int hret;
+
+    if (hash_count(cache->table) >= RESOLV_CACHE_PURGE_COUNT) {
+        resolv_cache_purge(cache, true);
+    }
+
+    entry = talloc_zero(cache, struct resolv_cache_entry);
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    entry->cache = cache;
+    entry->type = type;
+    entry->family = family;
+    entry->key = talloc_strdup(entry, key_str);
+    entry->name = talloc_strdup(entry, name);
+    if (entry->key == NULL || entry->name == NULL) {
+        goto fail;
+    }
+    talloc_set_destructor(entry, resolv_cache_entry_destructor);
+
+    switch (type) {
+    case RESOLV_CACHE_HOST:
+        entry->query = resolv_gethostbyname_dns_send(entry, ev, ctx,
+                                                     entry->name, family);
+        break;
+    case RESOLV_CACHE_SRV:
+        entry->query = resolv_getsrv_dns_send(entry, ev, ctx, entry->name);
+        break;
+    }
+    if (entry->query == NULL) {
+        goto fail;
+    }
+    tevent_req_set_callback(entry->query, resolv_cache_query_done, entry);
+
+    key.type = HASH_KEY_STRING;
+    key.str = entry->key;
+    value.type = HASH_VALUE_PTR;
+    value.ptr = entry;
+    hret = hash_enter(cache->table, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_OP_FAILURE, "Cannot add %s to the DNS cache [%d]: %s\n",
+              name, hret, hash_error_string(hret));
+        goto fail;
+    }
+    entry->in_table = true;
+
+    return entry;
+
+fail:
+    talloc_free(entry);
+    return NULL;
+}
+
+static uint32_t
+resolv_cache_answer_ttl(struct resolv_cache_entry *entry)
+{
+    uint32_t ttl = 0;
+    uint32_t addr_ttl;
+    int i;
+
+    if (entry->error != EOK) {
+        /* only names that do not exist are cached */
+        if (entry->status == ARES_ENOTFOUND || entry->status == ARES_ENODATA) {
+            return RESOLV_NEGATIVE_TTL;
+        }
+        return 0;
+    }
+
+    switch (entry->type) {
+    case RESOLV_CACHE_HOST:
+        for (i = 0; entry->rhostent->addr_list[i] != NULL; i++) {
+            addr_ttl = MAX(entry->rhostent->addr_list[i]->ttl, 0);
+            if (i == 0 || addr_ttl < ttl) {
+                ttl = addr_ttl;
+            }
+        }
+        break;
+    case RESOLV_CACHE_SRV:
+        ttl = entry->ttl;
+        break;
+    }
+
+    return ttl;
+}
+
+static struct resolv_hostent *
+resolv_cache_copy_hostent(TALLOC_CTX *mem_ctx, struct resolv_hostent *src,
+                          uint32_t max_ttl);
+static struct ares_srv_reply *
+resolv_cache_copy_srv_reply(TALLOC_CTX *mem_ctx,
+                            struct ares_srv_reply *src);
+
+struct resolv_cache_lookup_state {
+    struct resolv_cache_waiter *waiter;
+
+    int status;
+    int timeouts;
+    struct resolv_hostent *rhostent;
+    struct ares_srv_reply *reply_list;
+    uint32_t ttl;
+};
+
+/* Gives the lookup its own copy of the answer */
+static errno_t
+resolv_cache_lookup_answer(struct tevent_req *req,
+                           struct resolv_cache_entry *entry,
+                           uint32_t remaining)
+{
+    struct resolv_cache_lookup_state *state = tevent_req_data(req,
+                                        struct resolv_cache_lookup_state);
+
+    state->status = entry->status;
+    if (entry->error != EOK) {
+        return entry->error;
+    }
+
+    switch (entry->type) {
+    case RESOLV_CACHE_HOST:
+        state->rhostent = resolv_cache_copy_hostent(state, entry->rhostent,
+                                                    remaining);
+        if (state->rhostent == NULL) {
+            return ENOMEM;
+        }
+        break;
+    case RESOLV_CACHE_SRV:
+        state->reply_list = resolv_cache_copy_srv_reply(state,
+                                                        entry->reply_list);
+        if (state->reply_list == NULL) {
+            return ENOMEM;
+        }
+        state->ttl = MIN(entry->ttl, remaining);
+        break;
+    }
+
+    return EOK;
+}
+
+static struct tevent_req *
+resolv_cache_lookup_send(TALLOC_CTX *mem_ctx,
+                         struct tevent_context *ev,
+                         struct resolv_ctx *ctx,
+                         enum resolv_cache_type type,
+                         int family,
+                         const char *name)
+{
+    struct tevent_req *req;
+    struct resolv_cache_lookup_state *state;
+    struct resolv_cache_entry *entry;
+    char *key;
+    time_t now;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state,
+                            struct resolv_cache_lookup_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    key = talloc_asprintf(state, "%d:%d:%s", type, family, name);
+    if (key == NULL) {
+        goto fail;
+    }
+
+    now = time(NULL);
+    entry = resolv_cache_get(ctx->cache, key);
+    if (entry != NULL && entry->query == NULL) {
+        if (entry->expire > now) {
+            DEBUG(SSSDBG_TRACE_INTERNAL,
+                  "Answering lookup of '%s' from the DNS cache\n", name);
+            if (entry->error == EOK) {
+                ctx->cache->stats.hits++;
+            } else {
+                ctx->cache->stats.negative_hits++;
+            }
+
+            ret = resolv_cache_lookup_answer(req, entry, entry->expire - now);
+            if (ret != EOK) {
+                tevent_req_error(req, ret);
+            } else {
+                tevent_req_done(req);
+            }
+            tevent_req_post(req, ev);
+            return req;
+        }
+
+        talloc_free(entry);
+        entry = NULL;
+    }
+
+    if (entry == NULL) {
+        entry = resolv_cache_query_send(ev, ctx, key, type, family, name);
+        if (entry == NULL) {
+            goto fail;
+        }
+        ctx->cache->stats.misses++;
+    } else {
+        DEBUG(SSSDBG_TRACE_INTERNAL,
+              "Waiting for the pending query of '%s'\n", name);
+        ctx->cache->stats.coalesced++;
+    }
+
+    state->waiter = talloc_zero(state, struct resolv_cache_waiter);
+    if (state->waiter == NULL) {
+        goto fail;
+    }
+    state->waiter->entry = entry;
+    state->waiter->req = req;
+    DLIST_ADD_END(entry->waiters, state->waiter, struct resolv_cache_waiter *);
+    talloc_set_destructor(state->waiter, resolv_cache_waiter_destructor);
+
+    return req;
+
+fail:
+    talloc_free(req);
+    return NULL;
+}
+
+static void
+resolv_cache_query_done(struct tevent_req *subreq)
+{
+    struct resolv_cache_entry *entry = tevent_req_callback_data(subreq,
+                                                struct resolv_cache_entry);
+    struct resolv_cache_lookup_state *state;
+    struct resolv_cache_waiter *waiter;
+    struct tevent_req *req;
+    uint32_t ttl;
+    errno_t ret;
+
+    switch (entry->type) {
+    case RESOLV_CACHE_HOST:
+        entry->error = resolv_gethostbyname_dns_recv(subreq, entry,
+                                                     &entry->status,
+                                                     &entry->timeouts,
+                                                     &entry->rhostent);
+        break;
+    case RESOLV_CACHE_SRV:
+        entry->error = resolv_getsrv_dns_recv(entry, subreq,
+                                              &entry->status,
+                                              &entry->timeouts,
+                                              &entry->reply_list,
+                                              &entry->ttl);
+        break;
+    }
+    talloc_zfree(subreq);
+    entry->query = NULL;
+
+    ttl = MIN(resolv_cache_answer_ttl(entry), entry->cache->max_ttl);
+    if (ttl > 0) {
+        entry->expire = time(NULL) + ttl;
+        DEBUG(SSSDBG_TRACE_INTERNAL, "Caching the answer for '%s' for %"
+              PRIu32" seconds\n", entry->name, ttl);
+    } else {
+        /* the answer is only passed to the waiting lookups */
+        resolv_cache_entry_unlink(entry);
+    }
+
+    /* the callbacks of the lookups must not free the entry */
+    entry->notifying = true;
+    while ((waiter = entry->waiters) != NULL) {
+        DLIST_REMOVE(entry->waiters, waiter);
+        waiter->entry = NULL;
+        req = waiter->req;
+
+        state = tevent_req_data(req, struct resolv_cache_lookup_state);
+        state->timeouts = entry->timeouts;
+
+        /* a fresh answer keeps its own TTL */
+        ret = resolv_cache_lookup_answer(req, entry, UINT32_MAX);
+        if (ret != EOK) {
+            tevent_req_error(req, ret);
+        } else {
+            tevent_req_done(req);
+        }
+    }
+    entry->notifying = false;
+
+    if (!entry->in_table) {
+        talloc_free(entry);
+    }
+}
+
+static int
+resolv_cache_lookup_recv(struct tevent_req *req, TALLOC_CTX *mem_ctx,
+                         int *status, int *timeouts,
+                         struct resolv_hostent **rhostent,
+                         struct ares_srv_reply **reply_list,
+                         uint32_t *ttl)
+{
+    struct resolv_cache_lookup_state *state = tevent_req_data(req,
+                                        struct resolv_cache_lookup_state);
+
+    /* Fill in even in case of error as status contains the
+     * c-ares return code */
+    if (status) {
+        *status = state->status;
+    }
+    if (timeouts) {
+        *timeouts = state->timeouts;
+    }
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    if (rhostent) {
+        *rhostent = talloc_steal(mem_ctx, state->rhostent);
+    }
+    if (reply_list) {
+        *reply_list = talloc_steal(mem_ctx, state->reply_list);
+    }
+    if (ttl) {
+        *ttl = state->ttl;
+    }
+
+    return EOK;
+}
+
+static struct resolv_hostent *
+resolv_cache_copy_hostent(TALLOC_CTX *mem_ctx, struct resolv_hostent *src,
+                          uint32_t max_ttl)
+{
+    struct resolv_hostent *ret;
+    size_t size;
+    int len;
+    int i;
+
+    ret = talloc_zero(mem_ctx, struct resolv_hostent);
+    if (ret == NULL) {
+        return NULL;
+    }
+
+    ret->family = src->family;
+    size = (src->family == AF_INET6) ? sizeof(struct in6_addr)
+                                     : sizeof(struct in_addr);
+
+    if (src->name != NULL) {
+        ret->name = talloc_strdup(ret, src->name);
+        if (ret->name == NULL) {
+            goto fail;
+        }
+    }
+
+    if (src->aliases != NULL) {
+        for (len = 0; src->aliases[len] != NULL; len++);
+
+        ret->aliases = talloc_array(ret, char *, len + 1);
+        if (ret->aliases == NULL) {
+            goto fail;
+        }
+
+        for (i = 0; i < len; i++) {
+            ret->aliases[i] = talloc_strdup(ret->aliases, src->aliases[i]);
+            if (ret->aliases[i] == NULL) {
+                goto fail;
+            }
+        }
+        ret->aliases[len] = NULL;
+    }
+
+    for (len = 0; src->addr_list[len] != NULL; len++);
+
+    ret->addr_list = talloc_array(ret, struct resolv_addr *, len + 1);
+    if (ret->addr_list == NULL) {
+        goto fail;
+    }
+
+    for (i = 0; i < len; i++) {
+        ret->addr_list[i] = talloc_zero(ret->addr_list, struct resolv_addr);
+        if (ret->addr_list[i] == NULL) {
+            goto fail;
+        }
+
+        ret->addr_list[i]->ipaddr = talloc_memdup(ret->addr_list[i],
+                                                  src->addr_list[i]->ipaddr,
+                                                  size);
+        if (ret->addr_list[i]->ipaddr == NULL) {
+            goto fail;
+        }
+
+        /* do not let the caller keep the address longer than the cache */
+        ret->addr_list[i]->ttl = MIN((uint32_t) src->addr_list[i]->ttl,
+                                     max_ttl);
+    }
+    ret->addr_list[len] = NULL;
+
+    return ret;
+
+fail:
+    talloc_free(ret);
+    return NULL;
+}
+
+static struct ares_srv_reply *
+resolv_cache_copy_srv_reply(TALLOC_CTX *mem_ctx, struct ares_srv_reply *src)
+{
+    struct ares_srv_reply *new_list = NULL;
+    struct ares_srv_reply *ptr = NULL;
+
+    for (; src != NULL; src = src->next) {
+        if (new_list == NULL) {
+            new_list = talloc_zero(mem_ctx, struct ares_srv_reply);
+            ptr = new_list;
+        } else {
+            ptr->next = talloc_zero(new_list, struct ares_srv_reply);
+            ptr = ptr->next;
+        }
+        if (ptr == NULL) {
+            talloc_free(new_list);
+            return NULL;
+        }
+
+        ptr->weight = src->weight;
+        ptr->priority = src->priority;
+        ptr->port = src->port;
+        ptr->host = talloc_strdup(ptr, src->host);
+        if (ptr->host == NULL) {
+            talloc_free(new_list);
+            return NULL;
+        }
+    }
+
+    return new_list;
+}
+
+void
+resolv_cache_set_max_ttl(struct resolv_ctx *ctx, uint32_t max_ttl)
+{
+    ctx->cache->max_ttl = max_ttl;
+    if (max_ttl == 0) {
+        resolv_cache_purge(ctx->cache, false);
+    }
+}
+
+void
+resolv_cache_get_stats(struct resolv_ctx *ctx,
+                       struct resolv_cache_stats *stats)
+{
+    *stats = ctx->cache->stats;
+}
+
 /*******************************************************************
  * Get host by name.                                               *
  *******************************************************************/
@@ -1292,10 +1954,11 @@ resolv_gethostbyname_step(struct tevent_req *req)
             break;
         case DB_DNS:
             DEBUG(SSSDBG_TRACE_INTERNAL, "Querying DNS\n");
-            subreq = resolv_gethostbyname_dns_send(state, state->ev,
-                                                   state->resolv_ctx,
-                                                   state->name,
-                                                   state->family);
+            subreq = resolv_cache_lookup_send(state, state->ev,
+                                              state->resolv_ctx,
+                                              RESOLV_CACHE_HOST,
+                                              state->family,
+                                              state->name);
             break;
         default:
             DEBUG(SSSDBG_CRIT_FAILURE, "Invalid hosts database\n");
@@ -1328,9 +1991,9 @@ resolv_gethostbyname_done(struct tevent_req *subreq)
             state->timeouts = 0;
             break;
         case DB_DNS:
-            ret = resolv_gethostbyname_dns_recv(subreq, state,
-                                                &state->status, &state->timeouts,
-                                                &state->rhostent);
+            ret = resolv_cache_lookup_recv(subreq, state,
+                                           &state->status, &state->timeouts,
+                                           &state->rhostent, NULL, NULL);
             break;
         default:
             DEBUG(SSSDBG_CRIT_FAILURE, "Invalid hosts database\n");
@@ -1578,9 +2241,9 @@ static void
 resolv_getsrv_query(struct tevent_req *req,
                     struct getsrv_state *state);
 
-struct tevent_req *
-resolv_getsrv_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
-                   struct resolv_ctx *ctx, const char *query)
+static struct tevent_req *
+resolv_getsrv_dns_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
+                       struct resolv_ctx *ctx, const char *query)
 {
     struct tevent_req *req, *subreq;
     struct getsrv_state *state;
@@ -1769,10 +2432,10 @@ fail:
     tevent_req_error(req, ret);
 }
 
-int
-resolv_getsrv_recv(TALLOC_CTX *mem_ctx, struct tevent_req *req, int *status,
-                   int *timeouts, struct ares_srv_reply **reply_list,
-                   uint32_t *ttl)
+static int
+resolv_getsrv_dns_recv(TALLOC_CTX *mem_ctx, struct tevent_req *req,
+                       int *status, int *timeouts,
+                       struct ares_srv_reply **reply_list, uint32_t *ttl)
 {
     struct getsrv_state *state = tevent_req_data(req, struct getsrv_state);
 
@@ -1791,6 +2454,23 @@ resolv_getsrv_recv(TALLOC_CTX *mem_ctx, struct tevent_req *req, int *status,
     return EOK;
 }
 
+struct tevent_req *
+resolv_getsrv_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
+                   struct resolv_ctx *ctx, const char *query)
+{
+    return resolv_cache_lookup_send(mem_ctx, ev, ctx, RESOLV_CACHE_SRV,
+                                    AF_UNSPEC, query);
+}
+
+int
+resolv_getsrv_recv(TALLOC_CTX *mem_ctx, struct tevent_req *req, int *status,
+                   int *timeouts, struct ares_srv_reply **reply_list,
+                   uint32_t *ttl)
+{
+    return resolv_cache_lookup_recv(req, mem_ctx, status, timeouts,
+                                    NULL, reply_list, ttl);
+}
+
 static void
 ares_getsrv_wakeup(struct tevent_req *subreq)
 {
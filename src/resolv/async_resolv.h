@@ -40,6 +40,10 @@
 #define RESOLV_DEFAULT_SRV_TTL 14400
 #endif  /* RESOLV_DEFAULT_SRV_TTL */
 
+#ifndef RESOLV_NEGATIVE_TTL
+#define RESOLV_NEGATIVE_TTL 30
+#endif  /* RESOLV_NEGATIVE_TTL */
+
 #include "util/util.h"
 
 /*
@@ -56,6 +60,20 @@ int resolv_init(TALLOC_CTX *mem_ctx, struct tevent_context *ev_ctx,
 
 void resolv_reread_configuration(struct resolv_ctx *ctx);
 
+/* Answers of DNS queries are cached for their TTL, but at most for
+ * max_ttl seconds. Zero, the default, disables caching. */
+void resolv_cache_set_max_ttl(struct resolv_ctx *ctx, uint32_t max_ttl);
+
+struct resolv_cache_stats {
+    uint64_t hits;          /* answered from the cache */
+    uint64_t negative_hits; /* answered from a cached "does not exist" */
+    uint64_t misses;        /* sent a query to the DNS server */
+    uint64_t coalesced;     /* waited for a query already in progress */
+};
+
+void resolv_cache_get_stats(struct resolv_ctx *ctx,
+                            struct resolv_cache_stats *stats);
+
 const char *resolv_strerror(int ares_code);
 
 struct resolv_hostent *
@@ -20,290 +20,496 @@
 */
 
 #include "util/util.h"
+#include "util/murmurhash3.h"
 #include "confdb/confdb.h"
 #include "responder/common/responder.h"
 #include "responder/common/negcache.h"
-#include <fcntl.h>
 #include <time.h>
-#include "tdb.h"
-
-#define NC_ENTRY_PREFIX "NCE/"
-#define NC_USER_PREFIX NC_ENTRY_PREFIX"USER"
-#define NC_GROUP_PREFIX NC_ENTRY_PREFIX"GROUP"
-#define NC_NETGROUP_PREFIX NC_ENTRY_PREFIX"NETGR"
-#define NC_SERVICE_PREFIX NC_ENTRY_PREFIX"SERVICE"
-#define NC_UID_PREFIX NC_ENTRY_PREFIX"UID"
-#define NC_GID_PREFIX NC_ENTRY_PREFIX"GID"
-#define NC_SID_PREFIX NC_ENTRY_PREFIX"SID"
-#define NC_CERT_PREFIX NC_ENTRY_PREFIX"CERT"
 
-struct sss_nc_ctx {
-    struct tdb_context *tdb;
+/* initial number of slots of a table, must be a power of 2 */
+#define NC_TABLE_INIT_SIZE 256
+
+enum sss_nc_type {
+    NC_USER,
+    NC_GROUP,
+    NC_NETGROUP,
+    NC_SERVICE,
+    NC_UID,
+    NC_GID,
+    NC_SID,
+    NC_CERT,
 };
 
-typedef int (*ncache_set_byname_fn_t)(struct sss_nc_ctx *, bool,
-                                      const char *, const char *);
+static const char *sss_nc_type_str[] = {
+    "USER", "GROUP", "NETGR", "SERVICE", "UID", "GID", "SID", "CERT"
+};
 
-static int sss_ncache_set_ent(struct sss_nc_ctx *ctx, bool permanent,
-                              struct sss_domain_info *dom, const char *name,
-                              ncache_set_byname_fn_t setter);
+struct sss_nc_key {
+    enum sss_nc_type type;
+    const char *domain;     /* NULL if the entry is valid in all domains */
+    const char *name;       /* NULL for UIDs and GIDs */
+    uint32_t id;
+};
+
+struct sss_nc_entry {
+    struct sss_nc_key key;
+    uint32_t hash;
+    time_t timestamp;       /* 0 for permanent entries */
+};
+
+/* Hash table with open addressing and linear probing. Removed entries
+ * leave a tombstone behind which is dropped when the table is rebuilt. */
+struct sss_nc_table {
+    struct sss_nc_entry **slots;
+    uint32_t size;          /* number of slots, a power of 2 */
+    uint32_t count;         /* number of entries */
+    uint32_t used;          /* number of entries and tombstones */
+};
 
-static int string_to_tdb_data(char *str, TDB_DATA *ret)
+struct sss_nc_ctx {
+    /* Permanent entries are kept apart from the ones that expire, which
+     * allows all of them to be dropped at once when the filters are
+     * reloaded */
+    struct sss_nc_table *timed;
+    struct sss_nc_table *permanent;
+
+    /* Expired entries are dropped when the tables are rebuilt and by
+     * a periodic timer. 0 if the lifetime of the entries is unknown. */
+    int timeout;
+    struct tevent_context *ev;
+    struct tevent_timer *purge_te;
+};
+
+static struct sss_nc_entry sss_nc_tombstone;
+#define NC_TOMBSTONE (&sss_nc_tombstone)
+
+static uint32_t sss_nc_key_hash(struct sss_nc_key *key)
 {
-    if (!str || !ret) return EINVAL;
+    uint32_t hash;
 
-    ret->dptr = (uint8_t *)str;
-    ret->dsize = strlen(str)+1;
+    hash = murmurhash3(key->domain != NULL ? key->domain : "",
+                       key->domain != NULL ? strlen(key->domain) : 0,
+                       key->type);
+    if (key->name != NULL) {
+        hash = murmurhash3(key->name, strlen(key->name), hash);
+    } else {
+        hash = murmurhash3((const char *)&key->id, sizeof(key->id), hash);
+    }
 
-    return EOK;
+    return hash;
 }
 
-int sss_ncache_init(TALLOC_CTX *memctx, struct sss_nc_ctx **_ctx)
+static bool sss_nc_str_equal(const char *a, const char *b)
 {
-    struct sss_nc_ctx *ctx;
+    if (a == NULL || b == NULL) {
+        return a == b;
+    }
 
-    ctx = talloc_zero(memctx, struct sss_nc_ctx);
-    if (!ctx) return ENOMEM;
+    return strcmp(a, b) == 0;
+}
 
-    errno = 0;
-    /* open a memory only tdb with default hash size */
-    ctx->tdb = tdb_open("memcache", 0, TDB_INTERNAL, O_RDWR|O_CREAT, 0);
-    if (!ctx->tdb) return errno;
+static bool sss_nc_key_equal(struct sss_nc_key *a, struct sss_nc_key *b)
+{
+    return a->type == b->type
+           && a->id == b->id
+           && sss_nc_str_equal(a->domain, b->domain)
+           && sss_nc_str_equal(a->name, b->name);
+}
 
-    *_ctx = ctx;
-    return EOK;
-};
+static void sss_nc_debug_key(int level, const char *msg,
+                             struct sss_nc_key *key, bool permanent)
+{
+    if (key->name != NULL) {
+        DEBUG(level, "%s [%s/%s%s%s]%s\n", msg, sss_nc_type_str[key->type],
+              key->domain != NULL ? key->domain : "",
+              key->domain != NULL ? "/" : "", key->name,
+              permanent ? " permanently" : "");
+    } else {
+        DEBUG(level, "%s [%s/%s%s%"PRIu32"]%s\n", msg,
+              sss_nc_type_str[key->type],
+              key->domain != NULL ? key->domain : "",
+              key->domain != NULL ? "/" : "", key->id,
+              permanent ? " permanently" : "");
+    }
+}
 
-static int sss_ncache_check_str(struct sss_nc_ctx *ctx, char *str, int ttl)
+static struct sss_nc_table *sss_nc_table_new(TALLOC_CTX *mem_ctx,
+                                             uint32_t size)
 {
-    TDB_DATA key;
-    TDB_DATA data;
-    unsigned long long int timestamp;
-    bool expired = false;
-    char *ep;
-    int ret;
+    struct sss_nc_table *table;
 
-    DEBUG(SSSDBG_TRACE_INTERNAL, "Checking negative cache for [%s]\n", str);
+    table = talloc_zero(mem_ctx, struct sss_nc_table);
+    if (table == NULL) {
+        return NULL;
+    }
 
-    data.dptr = NULL;
+    table->slots = talloc_zero_array(table, struct sss_nc_entry *, size);
+    if (table->slots == NULL) {
+        talloc_free(table);
+        return NULL;
+    }
+    table->size = size;
 
-    ret = string_to_tdb_data(str, &key);
-    if (ret != EOK) goto done;
+    return table;
+}
 
-    data = tdb_fetch(ctx->tdb, key);
+static struct sss_nc_entry *sss_nc_table_find(struct sss_nc_table *table,
+                                              struct sss_nc_key *key,
+                                              uint32_t hash,
+                                              uint32_t *_idx)
+{
+    struct sss_nc_entry *entry;
+    uint32_t mask = table->size - 1;
+    uint32_t idx;
 
-    if (!data.dptr) {
-        ret = ENOENT;
-        goto done;
+    for (idx = hash & mask; table->slots[idx] != NULL; idx = (idx + 1) & mask) {
+        entry = table->slots[idx];
+        if (entry != NC_TOMBSTONE
+                && entry->hash == hash
+                && sss_nc_key_equal(&entry->key, key)) {
+            *_idx = idx;
+            return entry;
+        }
     }
 
-    if (ttl == -1) {
-        /* a negative ttl means: never expires */
-        ret = EEXIST;
-        goto done;
+    return NULL;
+}
+
+static void sss_nc_table_put(struct sss_nc_entry **slots, uint32_t size,
+                             struct sss_nc_entry *entry)
+{
+    uint32_t mask = size - 1;
+    uint32_t idx;
+
+    for (idx = entry->hash & mask;
+         slots[idx] != NULL && slots[idx] != NC_TOMBSTONE;
+         idx = (idx + 1) & mask);
+
+    slots[idx] = entry;
+}
+
+static void sss_nc_table_remove(struct sss_nc_table *table, uint32_t idx)
+{
+    talloc_free(table->slots[idx]);
+    table->slots[idx] = NC_TOMBSTONE;
+    table->count--;
+}
+
+/* Rebuilds the table without tombstones and entries older than timeout
+ * seconds, twice as large if it is more than half full and smaller if
+ * it is mostly empty */
+static errno_t sss_nc_table_rehash(struct sss_nc_table *table, int timeout)
+{
+    struct sss_nc_entry **slots;
+    struct sss_nc_entry *entry;
+    uint32_t size = table->size;
+    time_t now;
+    uint32_t i;
+
+    if (timeout > 0) {
+        now = time(NULL);
+        for (i = 0; i < table->size; i++) {
+            entry = table->slots[i];
+            if (entry != NULL && entry != NC_TOMBSTONE
+                    && entry->timestamp != 0
+                    && entry->timestamp + timeout < now) {
+                sss_nc_table_remove(table, i);
+            }
+        }
     }
 
-    errno = 0;
-    timestamp = strtoull((const char *)data.dptr, &ep, 10);
-    if (errno != 0 || *ep != '\0') {
-        /* Malformed entry, remove it and return no entry */
-        expired = true;
-        goto done;
+    if (table->count >= size / 2) {
+        size *= 2;
+    } else {
+        while (size > NC_TABLE_INIT_SIZE && table->count < size / 8) {
+            size /= 2;
+        }
     }
 
-    if (timestamp == 0) {
-        /* a 0 timestamp means this is a permanent entry */
-        ret = EEXIST;
-        goto done;
+    slots = talloc_zero_array(table, struct sss_nc_entry *, size);
+    if (slots == NULL) {
+        return ENOMEM;
     }
 
-    if (timestamp + ttl >= time(NULL)) {
-        /* still valid */
-        ret = EEXIST;
-        goto done;
+    for (i = 0; i < table->size; i++) {
+        if (table->slots[i] != NULL && table->slots[i] != NC_TOMBSTONE) {
+            sss_nc_table_put(slots, size, table->slots[i]);
+        }
     }
 
-    expired = true;
+    talloc_free(table->slots);
+    table->slots = slots;
+    table->size = size;
+    table->used = table->count;
 
-done:
-    if (expired) {
-        /* expired, remove and return no entry */
-        tdb_delete(ctx->tdb, key);
-        ret = ENOENT;
+    return EOK;
+}
+
+static errno_t sss_nc_table_insert(struct sss_nc_table *table,
+                                   struct sss_nc_entry *entry,
+                                   int timeout)
+{
+    errno_t ret;
+
+    /* keep at least a quarter of the slots empty so that probing for a
+     * missing key stays short */
+    if ((table->used + 1) * 4 > table->size * 3) {
+        ret = sss_nc_table_rehash(table, timeout);
+        if (ret != EOK) {
+            return ret;
+        }
     }
 
-    free(data.dptr);
-    return ret;
+    sss_nc_table_put(table->slots, table->size, entry);
+    table->count++;
+    table->used++;
+
+    return EOK;
 }
 
-static int sss_ncache_set_str(struct sss_nc_ctx *ctx,
-                              char *str, bool permanent)
+int sss_ncache_init(TALLOC_CTX *memctx, struct sss_nc_ctx **_ctx)
 {
-    TDB_DATA key;
-    TDB_DATA data;
-    char *timest;
-    int ret;
+    struct sss_nc_ctx *ctx;
 
-    ret = string_to_tdb_data(str, &key);
-    if (ret != EOK) return ret;
+    ctx = talloc_zero(memctx, struct sss_nc_ctx);
+    if (!ctx) return ENOMEM;
 
-    if (permanent) {
-        timest = talloc_strdup(ctx, "0");
-    } else {
-        timest = talloc_asprintf(ctx, "%llu",
-                                 (unsigned long long int)time(NULL));
+    ctx->timed = sss_nc_table_new(ctx, NC_TABLE_INIT_SIZE);
+    ctx->permanent = sss_nc_table_new(ctx, NC_TABLE_INIT_SIZE);
+    if (ctx->timed == NULL || ctx->permanent == NULL) {
+        talloc_free(ctx);
+        return ENOMEM;
     }
-    if (!timest) return ENOMEM;
 
-    ret = string_to_tdb_data(timest, &data);
-    if (ret != EOK) goto done;
+    *_ctx = ctx;
+    return EOK;
+};
+
+static void sss_ncache_purge_timer(struct tevent_context *ev,
+                                   struct tevent_timer *te,
+                                   struct timeval current_time,
+                                   void *pvt);
 
-    DEBUG(SSSDBG_TRACE_FUNC, "Adding [%s] to negative cache%s\n",
-              str, permanent?" permanently":"");
+static errno_t sss_ncache_schedule_purge(struct sss_nc_ctx *ctx)
+{
+    struct timeval tv;
 
-    ret = tdb_store(ctx->tdb, key, data, TDB_REPLACE);
-    if (ret != 0) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Negative cache failed to set entry: [%s]\n",
-                  tdb_errorstr(ctx->tdb));
-        ret = EFAULT;
+    tv = tevent_timeval_current_ofs(ctx->timeout, 0);
+    ctx->purge_te = tevent_add_timer(ctx->ev, ctx, tv,
+                                     sss_ncache_purge_timer, ctx);
+    if (ctx->purge_te == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Cannot schedule the purge of the negative cache\n");
+        return ENOMEM;
     }
 
-done:
-    talloc_free(timest);
-    return ret;
+    return EOK;
 }
 
-static int sss_ncache_check_user_int(struct sss_nc_ctx *ctx, int ttl,
-                                     const char *domain, const char *name)
+static void sss_ncache_purge_timer(struct tevent_context *ev,
+                                   struct tevent_timer *te,
+                                   struct timeval current_time,
+                                   void *pvt)
 {
-    char *str;
-    int ret;
+    struct sss_nc_ctx *ctx = talloc_get_type(pvt, struct sss_nc_ctx);
+    uint32_t count;
+    errno_t ret;
 
-    if (!name || !*name) return EINVAL;
+    ctx->purge_te = NULL;
 
-    str = talloc_asprintf(ctx, "%s/%s/%s", NC_USER_PREFIX, domain, name);
-    if (!str) return ENOMEM;
+    count = ctx->timed->count;
+    ret = sss_nc_table_rehash(ctx->timed, ctx->timeout);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Cannot purge the negative cache [%d]: %s\n",
+              ret, sss_strerror(ret));
+    } else {
+        DEBUG(SSSDBG_TRACE_INTERNAL,
+              "Dropped %"PRIu32" expired negative cache entries\n",
+              count - ctx->timed->count);
+    }
 
-    ret = sss_ncache_check_str(ctx, str, ttl);
+    sss_ncache_schedule_purge(ctx);
+}
 
-    talloc_free(str);
-    return ret;
+errno_t sss_ncache_set_timeout(struct sss_nc_ctx *ctx,
+                               struct tevent_context *ev,
+                               int timeout)
+{
+    talloc_zfree(ctx->purge_te);
+
+    ctx->timeout = timeout > 0 ? timeout : 0;
+    ctx->ev = ev;
+
+    if (ctx->ev == NULL || ctx->timeout == 0) {
+        return EOK;
+    }
+
+    return sss_ncache_schedule_purge(ctx);
 }
 
-static int sss_ncache_check_group_int(struct sss_nc_ctx *ctx, int ttl,
-                                      const char *domain, const char *name)
+static int sss_ncache_check_key(struct sss_nc_ctx *ctx, int ttl,
+                                struct sss_nc_key *key)
 {
-    char *str;
-    int ret;
+    struct sss_nc_entry *entry;
+    uint32_t hash;
+    uint32_t idx;
 
-    if (!name || !*name) return EINVAL;
+    sss_nc_debug_key(SSSDBG_TRACE_INTERNAL, "Checking negative cache for",
+                     key, false);
 
-    str = talloc_asprintf(ctx, "%s/%s/%s", NC_GROUP_PREFIX, domain, name);
-    if (!str) return ENOMEM;
+    hash = sss_nc_key_hash(key);
 
-    ret = sss_ncache_check_str(ctx, str, ttl);
+    entry = sss_nc_table_find(ctx->permanent, key, hash, &idx);
+    if (entry != NULL) {
+        return EEXIST;
+    }
 
-    talloc_free(str);
-    return ret;
+    entry = sss_nc_table_find(ctx->timed, key, hash, &idx);
+    if (entry == NULL) {
+        return ENOENT;
+    }
+
+    if (ttl == -1) {
+        /* a negative ttl means: never expires */
+        return EEXIST;
+    }
+
+    if (entry->timestamp + ttl >= time(NULL)) {
+        /* still valid */
+        return EEXIST;
+    }
+
+    /* expired, remove and return no entry */
+    sss_nc_table_remove(ctx->timed, idx);
+    return ENOENT;
 }
 
-static int sss_ncache_check_netgr_int(struct sss_nc_ctx *ctx, int ttl,
-                                      const char *domain, const char *name)
+static int sss_ncache_set_key(struct sss_nc_ctx *ctx, bool permanent,
+                              struct sss_nc_key *key)
 {
-    char *str;
-    int ret;
+    struct sss_nc_table *table;
+    struct sss_nc_table *other;
+    struct sss_nc_entry *entry;
+    uint32_t hash;
+    uint32_t idx;
+    errno_t ret;
 
-    if (!name || !*name) return EINVAL;
+    sss_nc_debug_key(SSSDBG_TRACE_FUNC, "Adding to negative cache",
+                     key, permanent);
+
+    table = permanent ? ctx->permanent : ctx->timed;
+    other = permanent ? ctx->timed : ctx->permanent;
+    hash = sss_nc_key_hash(key);
+
+    /* the new entry replaces the old one regardless of its lifetime */
+    entry = sss_nc_table_find(other, key, hash, &idx);
+    if (entry != NULL) {
+        sss_nc_table_remove(other, idx);
+    }
+
+    entry = sss_nc_table_find(table, key, hash, &idx);
+    if (entry != NULL) {
+        entry->timestamp = permanent ? 0 : time(NULL);
+        return EOK;
+    }
+
+    entry = talloc_zero(table, struct sss_nc_entry);
+    if (entry == NULL) {
+        return ENOMEM;
+    }
 
-    str = talloc_asprintf(ctx, "%s/%s/%s", NC_NETGROUP_PREFIX, domain, name);
-    if (!str) return ENOMEM;
+    entry->key.type = key->type;
+    entry->key.id = key->id;
+    if (key->domain != NULL) {
+        entry->key.domain = talloc_strdup(entry, key->domain);
+        if (entry->key.domain == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+    }
+    if (key->name != NULL) {
+        entry->key.name = talloc_strdup(entry, key->name);
+        if (entry->key.name == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+    }
+    entry->hash = hash;
+    entry->timestamp = permanent ? 0 : time(NULL);
 
-    ret = sss_ncache_check_str(ctx, str, ttl);
+    ret = sss_nc_table_insert(table, entry, ctx->timeout);
 
-    talloc_free(str);
+done:
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Negative cache failed to set entry: [%d]: %s\n",
+              ret, sss_strerror(ret));
+        talloc_free(entry);
+    }
     return ret;
 }
 
-static int sss_ncache_check_service_int(struct sss_nc_ctx *ctx,
-                                        int ttl,
-                                        const char *domain,
-                                        const char *name)
+static int sss_ncache_check_ent(struct sss_nc_ctx *ctx, int ttl,
+                                struct sss_domain_info *dom,
+                                enum sss_nc_type type, const char *name)
 {
-    char *str;
-    int ret;
+    struct sss_nc_key key = { type, dom->name, name, 0 };
+    char *lower = NULL;
+    errno_t ret;
 
     if (!name || !*name) return EINVAL;
 
-    str = talloc_asprintf(ctx, "%s/%s/%s",
-                          NC_SERVICE_PREFIX,
-                          domain,
-                          name);
-    if (!str) return ENOMEM;
+    if (dom->case_sensitive == false) {
+        lower = sss_tc_utf8_str_tolower(ctx, name);
+        if (!lower) return ENOMEM;
+        key.name = lower;
+    }
 
-    ret = sss_ncache_check_str(ctx, str, ttl);
+    ret = sss_ncache_check_key(ctx, ttl, &key);
 
-    talloc_free(str);
+    talloc_free(lower);
     return ret;
 }
 
-typedef int (*ncache_check_byname_fn_t)(struct sss_nc_ctx *, int,
-                                        const char *, const char *);
-
-static int sss_cache_check_ent(struct sss_nc_ctx *ctx, int ttl,
-                               struct sss_domain_info *dom, const char *name,
-                               ncache_check_byname_fn_t checker)
+static int sss_ncache_set_ent(struct sss_nc_ctx *ctx, bool permanent,
+                              struct sss_domain_info *dom,
+                              enum sss_nc_type type, const char *name)
 {
-    char *lower;
+    struct sss_nc_key key = { type, dom->name, name, 0 };
+    char *lower = NULL;
     errno_t ret;
 
+    if (!name || !*name) return EINVAL;
+
     if (dom->case_sensitive == false) {
         lower = sss_tc_utf8_str_tolower(ctx, name);
         if (!lower) return ENOMEM;
-        ret = checker(ctx, ttl, dom->name, lower);
-        talloc_free(lower);
-    } else {
-        ret = checker(ctx, ttl, dom->name, name);
+        key.name = lower;
     }
 
+    ret = sss_ncache_set_key(ctx, permanent, &key);
+
+    talloc_free(lower);
     return ret;
 }
 
 int sss_ncache_check_user(struct sss_nc_ctx *ctx, int ttl,
                           struct sss_domain_info *dom, const char *name)
 {
-    return sss_cache_check_ent(ctx, ttl, dom, name,
-                               sss_ncache_check_user_int);
+    return sss_ncache_check_ent(ctx, ttl, dom, NC_USER, name);
 }
 
 int sss_ncache_check_group(struct sss_nc_ctx *ctx, int ttl,
                            struct sss_domain_info *dom, const char *name)
 {
-    return sss_cache_check_ent(ctx, ttl, dom, name,
-                               sss_ncache_check_group_int);
+    return sss_ncache_check_ent(ctx, ttl, dom, NC_GROUP, name);
 }
 
 int sss_ncache_check_netgr(struct sss_nc_ctx *ctx, int ttl,
                            struct sss_domain_info *dom, const char *name)
 {
-    return sss_cache_check_ent(ctx, ttl, dom, name,
-                               sss_ncache_check_netgr_int);
-}
-
-static int sss_ncache_set_service_int(struct sss_nc_ctx *ctx, bool permanent,
-                                      const char *domain, const char *name)
-{
-    char *str;
-    int ret;
-
-    if (!name || !*name) return EINVAL;
-
-    str = talloc_asprintf(ctx, "%s/%s/%s", NC_SERVICE_PREFIX, domain, name);
-    if (!str) return ENOMEM;
-
-    ret = sss_ncache_set_str(ctx, str, permanent);
-
-    talloc_free(str);
-    return ret;
+    return sss_ncache_check_ent(ctx, ttl, dom, NC_NETGROUP, name);
 }
 
 int sss_ncache_set_service_name(struct sss_nc_ctx *ctx, bool permanent,
@@ -316,9 +522,8 @@ int sss_ncache_set_service_name(struct sss_nc_ctx *ctx, bool permanent,
                                                  proto ? proto : "<ANY>");
     if (!service_and_protocol) return ENOMEM;
 
-    ret = sss_ncache_set_ent(ctx, permanent, dom,
-                             service_and_protocol,
-                             sss_ncache_set_service_int);
+    ret = sss_ncache_set_ent(ctx, permanent, dom, NC_SERVICE,
+                             service_and_protocol);
     talloc_free(service_and_protocol);
     return ret;
 }
@@ -334,8 +539,8 @@ int sss_ncache_check_service(struct sss_nc_ctx *ctx, int ttl,
                                                  proto ? proto : "<ANY>");
     if (!service_and_protocol) return ENOMEM;
 
-    ret = sss_cache_check_ent(ctx, ttl, dom, service_and_protocol,
-                              sss_ncache_check_service_int);
+    ret = sss_ncache_check_ent(ctx, ttl, dom, NC_SERVICE,
+                               service_and_protocol);
     talloc_free(service_and_protocol);
     return ret;
 }
@@ -350,9 +555,8 @@ int sss_ncache_set_service_port(struct sss_nc_ctx *ctx, bool permanent,
                                                  proto ? proto : "<ANY>");
     if (!service_and_protocol) return ENOMEM;
 
-    ret = sss_ncache_set_ent(ctx, permanent, dom,
-                             service_and_protocol,
-                             sss_ncache_set_service_int);
+    ret = sss_ncache_set_ent(ctx, permanent, dom, NC_SERVICE,
+                             service_and_protocol);
     talloc_free(service_and_protocol);
     return ret;
 }
@@ -368,282 +572,110 @@ int sss_ncache_check_service_port(struct sss_nc_ctx *ctx, int ttl,
                                                  proto ? proto : "<ANY>");
     if (!service_and_protocol) return ENOMEM;
 
-    ret = sss_cache_check_ent(ctx, ttl, dom, service_and_protocol,
-                              sss_ncache_check_service_int);
+    ret = sss_ncache_check_ent(ctx, ttl, dom, NC_SERVICE,
+                               service_and_protocol);
     talloc_free(service_and_protocol);
     return ret;
 }
 
-
-
 int sss_ncache_check_uid(struct sss_nc_ctx *ctx, int ttl,
                          struct sss_domain_info *dom, uid_t uid)
 {
-    char *str;
-    int ret;
-
-    if (dom != NULL) {
-        str = talloc_asprintf(ctx, "%s/%s/%"SPRIuid, NC_UID_PREFIX, dom->name,
-                              uid);
-    } else {
-        str = talloc_asprintf(ctx, "%s/%"SPRIuid, NC_UID_PREFIX, uid);
-    }
-    if (!str) return ENOMEM;
-
-    ret = sss_ncache_check_str(ctx, str, ttl);
+    struct sss_nc_key key = { NC_UID, dom ? dom->name : NULL, NULL, uid };
 
-    talloc_free(str);
-    return ret;
+    return sss_ncache_check_key(ctx, ttl, &key);
 }
 
 int sss_ncache_check_gid(struct sss_nc_ctx *ctx, int ttl,
                          struct sss_domain_info *dom, gid_t gid)
 {
-    char *str;
-    int ret;
-
-    if (dom != NULL) {
-        str = talloc_asprintf(ctx, "%s/%s/%"SPRIgid, NC_GID_PREFIX, dom->name,
-                              gid);
-    } else {
-        str = talloc_asprintf(ctx, "%s/%"SPRIgid, NC_GID_PREFIX, gid);
-    }
-    if (!str) return ENOMEM;
-
-    ret = sss_ncache_check_str(ctx, str, ttl);
+    struct sss_nc_key key = { NC_GID, dom ? dom->name : NULL, NULL, gid };
 
-    talloc_free(str);
-    return ret;
+    return sss_ncache_check_key(ctx, ttl, &key);
 }
 
 int sss_ncache_check_sid(struct sss_nc_ctx *ctx, int ttl, const char *sid)
 {
-    char *str;
-    int ret;
+    struct sss_nc_key key = { NC_SID, NULL, sid, 0 };
 
-    str = talloc_asprintf(ctx, "%s/%s", NC_SID_PREFIX, sid);
-    if (!str) return ENOMEM;
+    if (sid == NULL) return EINVAL;
 
-    ret = sss_ncache_check_str(ctx, str, ttl);
-
-    talloc_free(str);
-    return ret;
+    return sss_ncache_check_key(ctx, ttl, &key);
 }
 
 int sss_ncache_check_cert(struct sss_nc_ctx *ctx, int ttl, const char *cert)
 {
-    char *str;
-    int ret;
-
-    str = talloc_asprintf(ctx, "%s/%s", NC_CERT_PREFIX, cert);
-    if (!str) return ENOMEM;
+    struct sss_nc_key key = { NC_CERT, NULL, cert, 0 };
 
-    ret = sss_ncache_check_str(ctx, str, ttl);
+    if (cert == NULL) return EINVAL;
 
-    talloc_free(str);
-    return ret;
+    return sss_ncache_check_key(ctx, ttl, &key);
 }
 
-
-static int sss_ncache_set_user_int(struct sss_nc_ctx *ctx, bool permanent,
-                                   const char *domain, const char *name)
-{
-    char *str;
-    int ret;
-
-    if (!name || !*name) return EINVAL;
-
-    str = talloc_asprintf(ctx, "%s/%s/%s", NC_USER_PREFIX, domain, name);
-    if (!str) return ENOMEM;
-
-    ret = sss_ncache_set_str(ctx, str, permanent);
-
-    talloc_free(str);
-    return ret;
-}
-
-static int sss_ncache_set_group_int(struct sss_nc_ctx *ctx, bool permanent,
-                                    const char *domain, const char *name)
-{
-    char *str;
-    int ret;
-
-    if (!name || !*name) return EINVAL;
-
-    str = talloc_asprintf(ctx, "%s/%s/%s", NC_GROUP_PREFIX, domain, name);
-    if (!str) return ENOMEM;
-
-    ret = sss_ncache_set_str(ctx, str, permanent);
-
-    talloc_free(str);
-    return ret;
-}
-
-static int sss_ncache_set_netgr_int(struct sss_nc_ctx *ctx, bool permanent,
-                                    const char *domain, const char *name)
-{
-    char *str;
-    int ret;
-
-    if (!name || !*name) return EINVAL;
-
-    str = talloc_asprintf(ctx, "%s/%s/%s", NC_NETGROUP_PREFIX, domain, name);
-    if (!str) return ENOMEM;
-
-    ret = sss_ncache_set_str(ctx, str, permanent);
-
-    talloc_free(str);
-    return ret;
-}
-
-static int sss_ncache_set_ent(struct sss_nc_ctx *ctx, bool permanent,
-                              struct sss_domain_info *dom, const char *name,
-                              ncache_set_byname_fn_t setter)
-{
-    char *lower;
-    errno_t ret;
-
-    if (dom->case_sensitive == false) {
-        lower = sss_tc_utf8_str_tolower(ctx, name);
-        if (!lower) return ENOMEM;
-        ret = setter(ctx, permanent, dom->name, lower);
-        talloc_free(lower);
-    } else {
-        ret = setter(ctx, permanent, dom->name, name);
-    }
-
-    return ret;
-}
-
-
 int sss_ncache_set_user(struct sss_nc_ctx *ctx, bool permanent,
                         struct sss_domain_info *dom, const char *name)
 {
-    return sss_ncache_set_ent(ctx, permanent, dom, name, sss_ncache_set_user_int);
+    return sss_ncache_set_ent(ctx, permanent, dom, NC_USER, name);
 }
 
 int sss_ncache_set_group(struct sss_nc_ctx *ctx, bool permanent,
                          struct sss_domain_info *dom, const char *name)
 {
-    return sss_ncache_set_ent(ctx, permanent, dom, name, sss_ncache_set_group_int);
+    return sss_ncache_set_ent(ctx, permanent, dom, NC_GROUP, name);
 }
 
 int sss_ncache_set_netgr(struct sss_nc_ctx *ctx, bool permanent,
                          struct sss_domain_info *dom, const char *name)
 {
-    return sss_ncache_set_ent(ctx, permanent, dom, name, sss_ncache_set_netgr_int);
+    return sss_ncache_set_ent(ctx, permanent, dom, NC_NETGROUP, name);
 }
 
 int sss_ncache_set_uid(struct sss_nc_ctx *ctx, bool permanent,
                        struct sss_domain_info *dom, uid_t uid)
 {
-    char *str;
-    int ret;
+    struct sss_nc_key key = { NC_UID, dom ? dom->name : NULL, NULL, uid };
 
-    if (dom != NULL) {
-        str = talloc_asprintf(ctx, "%s/%s/%"SPRIuid, NC_UID_PREFIX, dom->name,
-                              uid);
-    } else {
-        str = talloc_asprintf(ctx, "%s/%"SPRIuid, NC_UID_PREFIX, uid);
-    }
-    if (!str) return ENOMEM;
-
-    ret = sss_ncache_set_str(ctx, str, permanent);
-
-    talloc_free(str);
-    return ret;
+    return sss_ncache_set_key(ctx, permanent, &key);
 }
 
 int sss_ncache_set_gid(struct sss_nc_ctx *ctx, bool permanent,
                        struct sss_domain_info *dom, gid_t gid)
 {
-    char *str;
-    int ret;
-
-    if (dom != NULL) {
-        str = talloc_asprintf(ctx, "%s/%s/%"SPRIgid, NC_GID_PREFIX, dom->name,
-                              gid);
-    } else {
-        str = talloc_asprintf(ctx, "%s/%"SPRIgid, NC_GID_PREFIX, gid);
-    }
-    if (!str) return ENOMEM;
+    struct sss_nc_key key = { NC_GID, dom ? dom->name : NULL, NULL, gid };
 
-    ret = sss_ncache_set_str(ctx, str, permanent);
-
-    talloc_free(str);
-    return ret;
+    return sss_ncache_set_key(ctx, permanent, &key);
 }
 
 int sss_ncache_set_sid(struct sss_nc_ctx *ctx, bool permanent, const char *sid)
 {
-    char *str;
-    int ret;
-
-    str = talloc_asprintf(ctx, "%s/%s", NC_SID_PREFIX, sid);
-    if (!str) return ENOMEM;
+    struct sss_nc_key key = { NC_SID, NULL, sid, 0 };
 
-    ret = sss_ncache_set_str(ctx, str, permanent);
+    if (sid == NULL) return EINVAL;
 
-    talloc_free(str);
-    return ret;
+    return sss_ncache_set_key(ctx, permanent, &key);
 }
 
 int sss_ncache_set_cert(struct sss_nc_ctx *ctx, bool permanent,
                         const char *cert)
 {
-    char *str;
-    int ret;
-
-    str = talloc_asprintf(ctx, "%s/%s", NC_CERT_PREFIX, cert);
-    if (!str) return ENOMEM;
+    struct sss_nc_key key = { NC_CERT, NULL, cert, 0 };
 
-    ret = sss_ncache_set_str(ctx, str, permanent);
+    if (cert == NULL) return EINVAL;
 
-    talloc_free(str);
-    return ret;
+    return sss_ncache_set_key(ctx, permanent, &key);
 }
 
-static int delete_permanent(struct tdb_context *tdb,
-                            TDB_DATA key, TDB_DATA data, void *state)
+int sss_ncache_reset_permanent(struct sss_nc_ctx *ctx)
 {
-    unsigned long long int timestamp;
-    bool remove_key = false;
-    char *ep;
-
-    if (strncmp((char *)key.dptr,
-                NC_ENTRY_PREFIX, sizeof(NC_ENTRY_PREFIX) - 1) != 0) {
-        /* not interested in this key */
-        return 0;
-    }
+    struct sss_nc_table *table;
 
-    errno = 0;
-    timestamp = strtoull((const char *)data.dptr, &ep, 10);
-    if (errno != 0 || *ep != '\0') {
-        /* Malformed entry, remove it */
-        remove_key = true;
-        goto done;
+    table = sss_nc_table_new(ctx, NC_TABLE_INIT_SIZE);
+    if (table == NULL) {
+        return ENOMEM;
     }
 
-    if (timestamp == 0) {
-        /* a 0 timestamp means this is a permanent entry */
-        remove_key = true;
-    }
-
-done:
-    if (remove_key) {
-        return tdb_delete(tdb, key);
-    }
-
-    return 0;
-}
-
-int sss_ncache_reset_permanent(struct sss_nc_ctx *ctx)
-{
-    int ret;
-
-    ret = tdb_traverse(ctx->tdb, delete_permanent, NULL);
-    if (ret < 0)
-        return EIO;
+    talloc_free(ctx->permanent);
+    ctx->permanent = table;
 
     return EOK;
 }
@@ -27,6 +27,13 @@ struct sss_nc_ctx;
 /* init the in memory negative cache */
 int sss_ncache_init(TALLOC_CTX *memctx, struct sss_nc_ctx **_ctx);
 
+/* set the lifetime of the entries which are not permanent, they are
+ * dropped when they expire even if nobody looks them up again, every
+ * timeout seconds if ev is not NULL */
+errno_t sss_ncache_set_timeout(struct sss_nc_ctx *ctx,
+                               struct tevent_context *ev,
+                               int timeout);
+
 /* check if the user is expired according to the passed in time to live */
 int sss_ncache_check_user(struct sss_nc_ctx *ctx, int ttl,
                           struct sss_domain_info *dom, const char *name);
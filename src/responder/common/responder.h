@@ -53,18 +53,27 @@ extern hash_table_t *dp_requests;
 
 /* needed until nsssrv.h is updated */
 struct cli_request {
+    struct cli_request *prev;
+    struct cli_request *next;
 
     /* original request from the wire */
     struct sss_packet *in;
 
     /* reply data */
     struct sss_packet *out;
+
+    /* latency tracing */
+    uint32_t rid;
+    struct timeval start;
 };
 
 struct cli_protocol_version {
     uint32_t version;
     const char *date;
     const char *description;
+    /* the client may send more tagged requests without waiting for the
+     * replies, which are sent back as soon as they are ready */
+    bool multiplexed;
 };
 
 struct resp_ctx;
@@ -80,6 +89,11 @@ struct be_conn {
 
     char *sbus_address;
     struct sbus_connection *conn;
+
+    /* framed connection for the data provider requests, D-Bus is used
+     * when the back end does not accept it */
+    char *frame_address;
+    struct sbus_connection *frame_conn;
 };
 
 struct resp_ctx {
@@ -98,6 +112,7 @@ struct resp_ctx {
     struct sss_domain_info *domains;
     int domains_timeout;
     int client_idle_timeout;
+    bool parallel_domain_lookups;
 
     struct sss_cmd_table *sss_cmds;
     const char *sss_pipe_name;
@@ -149,11 +164,24 @@ struct cli_ctx {
     char *automntmap_name;
 
     struct tevent_timer *idle;
+
+    /* multiplexed protocol versions only */
+    struct cli_ctx *mux_parent;     /* client connection this request
+                                     * context was created for */
+    struct cli_request *mux_recv;   /* request being read */
+    struct cli_request *mux_wait;   /* requests waiting for the connection
+                                     * state to be available */
+    struct cli_request *mux_out;    /* replies waiting to be sent */
+    int mux_pending;                /* requests read but not yet answered */
 };
 
 struct sss_cmd_table {
     enum sss_cli_command cmd;
     int (*fn)(struct cli_ctx *cctx);
+    /* the command uses the per-connection state in cli_ctx, so with
+     * multiplexed protocols it is run in the order it was received and only
+     * after the previous command of this kind was answered */
+    bool conn_state;
 };
 
 /* from generated code */
@@ -184,6 +212,10 @@ int sss_process_init(TALLOC_CTX *mem_ctx,
 
 int sss_dp_get_domain_conn(struct resp_ctx *rctx, const char *domain,
                            struct be_conn **_conn);
+/* Returns the framed connection of @be_conn, connecting again if it was
+ * lost */
+errno_t sss_dp_get_frame_conn(struct be_conn *be_conn,
+                              struct sbus_connection **_conn);
 struct sss_domain_info *
 responder_get_domain(struct resp_ctx *rctx, const char *domain);
 
@@ -192,6 +224,9 @@ errno_t responder_get_domain_by_id(struct resp_ctx *rctx, const char *id,
 
 int create_pipe_fd(const char *sock_name, int *_fd, mode_t umaskval);
 
+bool client_is_multiplexed(struct cli_ctx *cctx);
+void client_mux_cmd_done(struct cli_ctx *cctx);
+
 /* responder_cmd.c */
 int sss_cmd_empty_packet(struct sss_packet *packet);
 int sss_cmd_send_empty(struct cli_ctx *cctx, TALLOC_CTX *freectx);
@@ -201,6 +236,8 @@ int sss_cmd_get_version(struct cli_ctx *cctx);
 int sss_cmd_execute(struct cli_ctx *cctx,
                     enum sss_cli_command cmd,
                     struct sss_cmd_table *sss_cmds);
+bool sss_cmd_uses_conn_state(enum sss_cli_command cmd,
+                             struct sss_cmd_table *sss_cmds);
 struct cli_protocol_version *register_cli_protocol_version(void);
 
 struct setent_req_list;
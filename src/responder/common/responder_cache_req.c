@@ -24,6 +24,7 @@
 #include <tevent.h>
 
 #include "util/util.h"
+#include "util/sss_latency.h"
 #include "db/sysdb.h"
 #include "responder/common/responder_cache_req.h"
 #include "providers/data_provider.h"
@@ -247,6 +248,9 @@ struct cache_req {
 
     /* Time when the request started. Useful for by-filter lookups */
     time_t req_start;
+
+    /* Latency tracing ID of the client request */
+    uint32_t rid;
 };
 
 static void
@@ -345,6 +349,7 @@ cache_req_create(TALLOC_CTX *mem_ctx,
 
     cr->data = data;
     cr->req_start = time(NULL);
+    cr->rid = sss_latency_current_rid();
 
     /* It is perfectly fine to just overflow here. */
     cr->reqid = rctx->cache_req_num++;
@@ -355,6 +360,37 @@ cache_req_create(TALLOC_CTX *mem_ctx,
     return cr;
 }
 
+/* Creates a copy of @cr that can be bound to a different domain than the
+ * original request. The input data are shared with @cr, which therefore
+ * must outlive the copy. */
+static struct cache_req *
+cache_req_clone(TALLOC_CTX *mem_ctx, struct cache_req *cr)
+{
+    struct cache_req *clone;
+
+    clone = talloc_zero(mem_ctx, struct cache_req);
+    if (clone == NULL) {
+        return NULL;
+    }
+
+    clone->data = talloc_zero(clone, struct cache_req_data);
+    if (clone->data == NULL) {
+        talloc_free(clone);
+        return NULL;
+    }
+
+    *clone->data = *cr->data;
+    clone->data->name.lookup = NULL;
+
+    clone->dp_type = cr->dp_type;
+    clone->reqid = cr->reqid;
+    clone->reqname = cr->reqname;
+    clone->req_start = cr->req_start;
+    clone->rid = cr->rid;
+
+    return clone;
+}
+
 static errno_t
 cache_req_set_name(struct cache_req *cr, const char *name)
 {
@@ -489,6 +525,26 @@ cache_req_is_upn(struct cache_req *cr)
     }
 }
 
+static bool
+cache_req_skip_domain(struct cache_req *cr, struct sss_domain_info *domain)
+{
+    /* If it is a domainless search, skip domains that require fully
+     * qualified names instead. */
+    return domain->fqnames
+               && cr->data->type != CACHE_REQ_USER_BY_CERT
+               && !cache_req_is_upn(cr);
+}
+
+static struct sss_domain_info *
+cache_req_get_next_domain(struct cache_req *cr, struct sss_domain_info *domain)
+{
+    if (cache_req_is_upn(cr) || cr->data->type == CACHE_REQ_USER_BY_CERT) {
+        return get_next_domain(domain, SSS_GND_DESCEND);
+    }
+
+    return get_next_domain(domain, 0);
+}
+
 static bool
 cache_req_assume_upn(struct cache_req *cr)
 {
@@ -674,11 +730,14 @@ static errno_t cache_req_get_object(TALLOC_CTX *mem_ctx,
 {
     struct ldb_result *result = NULL;
     bool one_item_only = false;
+    struct timeval start;
     errno_t ret = ERR_INTERNAL;
 
     CACHE_REQ_DEBUG(SSSDBG_FUNC_DATA, cr, "Requesting info for [%s]\n",
                     cr->debugobj);
 
+    sss_latency_start(&start);
+
     switch (cr->data->type) {
     case CACHE_REQ_USER_BY_NAME:
         one_item_only = true;
@@ -740,6 +799,8 @@ static errno_t cache_req_get_object(TALLOC_CTX *mem_ctx,
         break;
     }
 
+    sss_latency_record(cr->rid, SSS_LATENCY_CACHE_SEARCH, &start);
+
     if (ret != EOK) {
         goto done;
     } else if (result->count == 0) {
@@ -991,6 +1052,26 @@ static errno_t cache_req_cache_search(struct tevent_req *req)
     return EOK;
 }
 
+static struct tevent_req *
+cache_req_dp_send(struct cache_req_cache_state *state,
+                  const char *search_str,
+                  uint32_t search_id,
+                  const char *extra_flag)
+{
+    struct tevent_req *subreq;
+    uint32_t prev_rid;
+
+    /* we may be resumed from another request's callback */
+    prev_rid = sss_latency_set_current(state->cr->rid);
+    subreq = sss_dp_get_account_send(state, state->rctx,
+                                     state->cr->domain, true,
+                                     state->cr->dp_type,
+                                     search_str, search_id, extra_flag);
+    sss_latency_set_current(prev_rid);
+
+    return subreq;
+}
+
 static errno_t cache_req_cache_check(struct tevent_req *req)
 {
     struct cache_req_cache_state *state = NULL;
@@ -1021,10 +1102,8 @@ static errno_t cache_req_cache_check(struct tevent_req *req)
                         "Performing midpoint cache update of [%s]\n",
                         state->cr->debugobj);
 
-        subreq = sss_dp_get_account_send(state, state->rctx,
-                                         state->cr->domain, true,
-                                         state->cr->dp_type,
-                                         search_str, search_id, extra_flag);
+        subreq = cache_req_dp_send(state, search_str, search_id,
+                                   extra_flag);
         if (subreq == NULL) {
             DEBUG(SSSDBG_CRIT_FAILURE, "Out of memory sending out-of-band "
                                        "data provider request\n");
@@ -1040,10 +1119,8 @@ static errno_t cache_req_cache_check(struct tevent_req *req)
                         "Looking up [%s] in data provider\n",
                         state->cr->debugobj);
 
-        subreq = sss_dp_get_account_send(state, state->rctx,
-                                         state->cr->domain, true,
-                                         state->cr->dp_type,
-                                         search_str, search_id, extra_flag);
+        subreq = cache_req_dp_send(state, search_str, search_id,
+                                   extra_flag);
         if (subreq == NULL) {
             DEBUG(SSSDBG_CRIT_FAILURE,
                   "Out of memory sending data provider request\n");
@@ -1139,6 +1216,24 @@ struct cache_req_state {
     struct sss_domain_info *domain;
     struct sss_domain_info *selected_domain;
     bool check_next;
+
+    /* parallel multi-domain search */
+    TALLOC_CTX *parallel_ctx;
+    struct cache_req_parallel_domain **parallel;
+    size_t num_parallel;
+    struct timeval parallel_start;
+};
+
+/* One domain of a multi-domain search that is run in parallel. */
+struct cache_req_parallel_domain {
+    struct tevent_req *req;
+    struct cache_req *cr;
+    struct sss_domain_info *domain;
+    struct timeval start;
+
+    bool finished;
+    errno_t ret;
+    struct ldb_result *result;
 };
 
 static void cache_req_input_parsed(struct tevent_req *subreq);
@@ -1148,6 +1243,8 @@ static errno_t cache_req_select_domains(struct tevent_req *req,
 
 static errno_t cache_req_next_domain(struct tevent_req *req);
 
+static errno_t cache_req_parallel_domains(struct tevent_req *req);
+
 static void cache_req_done(struct tevent_req *subreq);
 
 struct tevent_req *cache_req_send(TALLOC_CTX *mem_ctx,
@@ -1288,6 +1385,10 @@ static errno_t cache_req_select_domains(struct tevent_req *req,
 
         state->domain = state->rctx->domains;
         state->check_next = true;
+
+        if (state->rctx->parallel_domain_lookups) {
+            return cache_req_parallel_domains(req);
+        }
     }
 
     return cache_req_next_domain(req);
@@ -1302,12 +1403,8 @@ static errno_t cache_req_next_domain(struct tevent_req *req)
     state = tevent_req_data(req, struct cache_req_state);
 
     while (state->domain != NULL) {
-       /* If it is a domainless search, skip domains that require fully
-        * qualified names instead. */
         while (state->domain != NULL && state->check_next
-                && state->domain->fqnames
-                && state->cr->data->type != CACHE_REQ_USER_BY_CERT
-                && !cache_req_is_upn(state->cr)) {
+                && cache_req_skip_domain(state->cr, state->domain)) {
             state->domain = get_next_domain(state->domain, 0);
         }
 
@@ -1335,12 +1432,8 @@ static errno_t cache_req_next_domain(struct tevent_req *req)
 
         /* we will continue with the following domain the next time */
         if (state->check_next) {
-            if (cache_req_is_upn(state->cr)
-                    || state->cr->data->type == CACHE_REQ_USER_BY_CERT ) {
-                state->domain = get_next_domain(state->domain, SSS_GND_DESCEND);
-            } else {
-                state->domain = get_next_domain(state->domain, 0);
-            }
+            state->domain = cache_req_get_next_domain(state->cr,
+                                                      state->domain);
         }
 
         return EAGAIN;
@@ -1394,6 +1487,203 @@ static void cache_req_done(struct tevent_req *subreq)
     return;
 }
 
+static uint64_t cache_req_elapsed_usec(struct timeval *start)
+{
+    struct timeval now;
+    struct timeval diff;
+
+    now = tevent_timeval_current();
+    diff = tevent_timeval_until(start, &now);
+
+    return (uint64_t)diff.tv_sec * 1000000 + diff.tv_usec;
+}
+
+static void cache_req_parallel_domain_done(struct tevent_req *subreq);
+
+/* Queries all eligible domains at once instead of one after another.
+ * The domains are still evaluated in the order in which the sequential
+ * search would visit them, so the result is the same: the first domain
+ * in that order that knows the object wins, even if a later domain
+ * answered sooner. */
+static errno_t cache_req_parallel_domains(struct tevent_req *req)
+{
+    struct cache_req_state *state = NULL;
+    struct cache_req_parallel_domain *pd = NULL;
+    struct tevent_req *subreq = NULL;
+    struct sss_domain_info *dom;
+    size_t count;
+    size_t i;
+    errno_t ret;
+
+    state = tevent_req_data(req, struct cache_req_state);
+
+    talloc_zfree(state->parallel_ctx);
+    state->parallel = NULL;
+    state->num_parallel = 0;
+
+    count = 0;
+    for (dom = state->domain; dom != NULL;
+            dom = cache_req_get_next_domain(state->cr, dom)) {
+        if (!cache_req_skip_domain(state->cr, dom)) {
+            count++;
+        }
+    }
+
+    if (count == 0) {
+        cache_req_add_to_ncache_global(state->cr, state->ncache);
+        return ENOENT;
+    }
+
+    state->parallel_ctx = talloc_new(state);
+    if (state->parallel_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    state->parallel = talloc_zero_array(state->parallel_ctx,
+                                        struct cache_req_parallel_domain *,
+                                        count);
+    if (state->parallel == NULL) {
+        ret = ENOMEM;
+        goto fail;
+    }
+
+    CACHE_REQ_DEBUG(SSSDBG_TRACE_FUNC, state->cr,
+                    "Searching %zu domains in parallel\n", count);
+
+    state->parallel_start = tevent_timeval_current();
+
+    i = 0;
+    for (dom = state->domain; dom != NULL;
+            dom = cache_req_get_next_domain(state->cr, dom)) {
+        if (cache_req_skip_domain(state->cr, dom)) {
+            continue;
+        }
+
+        pd = talloc_zero(state->parallel, struct cache_req_parallel_domain);
+        if (pd == NULL) {
+            ret = ENOMEM;
+            goto fail;
+        }
+        state->parallel[i] = pd;
+        state->num_parallel = ++i;
+
+        pd->req = req;
+        pd->domain = dom;
+        pd->cr = cache_req_clone(pd, state->cr);
+        if (pd->cr == NULL) {
+            ret = ENOMEM;
+            goto fail;
+        }
+
+        ret = cache_req_set_domain(pd->cr, dom, state->rctx);
+        if (ret != EOK) {
+            goto fail;
+        }
+
+        pd->start = tevent_timeval_current();
+        subreq = cache_req_cache_send(pd, state->ev, state->rctx,
+                                      state->ncache, state->neg_timeout,
+                                      state->cache_refresh_percent, pd->cr);
+        if (subreq == NULL) {
+            ret = ENOMEM;
+            goto fail;
+        }
+
+        tevent_req_set_callback(subreq, cache_req_parallel_domain_done, pd);
+    }
+
+    state->domain = NULL;
+
+    return EAGAIN;
+
+fail:
+    talloc_zfree(state->parallel_ctx);
+    state->parallel = NULL;
+    state->num_parallel = 0;
+    return ret;
+}
+
+static void cache_req_parallel_domain_done(struct tevent_req *subreq)
+{
+    struct cache_req_parallel_domain *pd = NULL;
+    struct cache_req_state *state = NULL;
+    struct cache_req_parallel_domain *winner = NULL;
+    struct tevent_req *req = NULL;
+    struct cache_req *last_cr = NULL;
+    size_t i;
+    errno_t ret;
+
+    pd = tevent_req_callback_data(subreq, struct cache_req_parallel_domain);
+    req = pd->req;
+    state = tevent_req_data(req, struct cache_req_state);
+
+    pd->ret = cache_req_cache_recv(pd, subreq, &pd->result);
+    talloc_zfree(subreq);
+    pd->finished = true;
+
+    CACHE_REQ_DEBUG(SSSDBG_TRACE_FUNC, pd->cr,
+                    "Domain [%s] answered in %"PRIu64" usec [%d]: %s\n",
+                    pd->domain->name, cache_req_elapsed_usec(&pd->start),
+                    pd->ret, sss_strerror(pd->ret));
+
+    /* Walk the domains in the order of the sequential search. We can only
+     * decide once every domain that precedes the first match has answered. */
+    for (i = 0; i < state->num_parallel; i++) {
+        if (!state->parallel[i]->finished) {
+            return;
+        }
+
+        if (state->parallel[i]->ret == EOK) {
+            winner = state->parallel[i];
+            break;
+        }
+
+        last_cr = state->parallel[i]->cr;
+    }
+
+    if (winner == NULL) {
+        CACHE_REQ_DEBUG(SSSDBG_TRACE_FUNC, state->cr,
+                        "Parallel search of %zu domains finished in "
+                        "%"PRIu64" usec\n", state->num_parallel,
+                        cache_req_elapsed_usec(&state->parallel_start));
+
+        cache_req_add_to_ncache_global(last_cr, state->ncache);
+
+        talloc_zfree(state->parallel_ctx);
+        state->parallel = NULL;
+        state->num_parallel = 0;
+
+        CACHE_REQ_DEBUG(SSSDBG_TRACE_FUNC, state->cr, "Finished: Not found\n");
+        tevent_req_error(req, ENOENT);
+        return;
+    }
+
+    CACHE_REQ_DEBUG(SSSDBG_TRACE_FUNC, state->cr,
+                    "Parallel search of %zu domains finished in %"PRIu64" "
+                    "usec, result taken from domain [%s]\n",
+                    state->num_parallel,
+                    cache_req_elapsed_usec(&state->parallel_start),
+                    winner->domain->name);
+
+    ret = cache_req_set_domain(state->cr, winner->domain, state->rctx);
+    if (ret != EOK) {
+        talloc_zfree(state->parallel_ctx);
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    state->selected_domain = winner->domain;
+    state->result = talloc_steal(state, winner->result);
+
+    /* Requests still running for the remaining domains are cancelled. */
+    talloc_zfree(state->parallel_ctx);
+    state->parallel = NULL;
+    state->num_parallel = 0;
+
+    CACHE_REQ_DEBUG(SSSDBG_TRACE_FUNC, state->cr, "Finished: Success\n");
+    tevent_req_done(req);
+}
+
 errno_t cache_req_recv(TALLOC_CTX *mem_ctx,
                        struct tevent_req *req,
                        struct ldb_result **_result,
@@ -23,6 +23,7 @@
 #include "util/util.h"
 #include "responder/common/responder.h"
 #include "responder/common/responder_packet.h"
+#include "util/sss_latency.h"
 
 int sss_cmd_send_error(struct cli_ctx *cctx, int err)
 {
@@ -85,9 +86,20 @@ int sss_cmd_send_empty(struct cli_ctx *cctx, TALLOC_CTX *freectx)
 
 void sss_cmd_done(struct cli_ctx *cctx, void *freectx)
 {
-    /* now that the packet is in place, unlock queue
-     * making the event writable */
-    TEVENT_FD_WRITEABLE(cctx->cfde);
+    if (cctx->creq != NULL) {
+        sss_latency_record(cctx->creq->rid, SSS_LATENCY_CLIENT,
+                           &cctx->creq->start);
+    }
+
+    if (client_is_multiplexed(cctx)) {
+        /* the reply is queued together with the replies to the other
+         * requests of this client */
+        client_mux_cmd_done(cctx);
+    } else {
+        /* now that the packet is in place, unlock queue
+         * making the event writable */
+        TEVENT_FD_WRITEABLE(cctx->cfde);
+    }
 
     /* free all request related data through the talloc hierarchy */
     talloc_free(freectx);
@@ -164,6 +176,25 @@ int sss_cmd_execute(struct cli_ctx *cctx,
 
     return EINVAL;
 }
+
+bool sss_cmd_uses_conn_state(enum sss_cli_command cmd,
+                             struct sss_cmd_table *sss_cmds)
+{
+    int i;
+
+    /* the negotiated protocol version is kept in the connection */
+    if (cmd == SSS_GET_VERSION) {
+        return true;
+    }
+
+    for (i = 0; sss_cmds[i].cmd != SSS_CLI_NULL; i++) {
+        if (cmd == sss_cmds[i].cmd) {
+            return sss_cmds[i].conn_state;
+        }
+    }
+
+    return false;
+}
 struct setent_req_list {
     struct setent_req_list *prev;
     struct setent_req_list *next;
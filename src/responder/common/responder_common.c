@@ -43,6 +43,7 @@
 #include "monitor/monitor_interfaces.h"
 #include "sbus/sbus_client.h"
 #include "util/util_creds.h"
+#include "util/sss_latency.h"
 
 static errno_t set_close_on_exec(int fd)
 {
@@ -242,10 +243,247 @@ done:
 }
 
 
+/* Maximum number of requests of one multiplexing client that are processed
+ * at the same time, the socket is not read until some of them are answered */
+#define CLIENT_MUX_MAX_PENDING 64
+
+bool client_is_multiplexed(struct cli_ctx *cctx)
+{
+    if (cctx->mux_parent != NULL) {
+        return true;
+    }
+
+    return cctx->cli_protocol_version != NULL
+           && cctx->cli_protocol_version->multiplexed;
+}
+
+static int client_cmd_execute(struct cli_ctx *cctx,
+                              struct sss_cmd_table *sss_cmds);
+
+static void client_mux_wait_handler(struct tevent_context *ev,
+                                    struct tevent_immediate *imm,
+                                    void *pvt);
+
+/* Runs the oldest request that needs the connection state, if there is no
+ * other such request being processed */
+static void client_mux_run_wait(struct cli_ctx *cctx)
+{
+    struct cli_request *creq;
+    int ret;
+
+    if (cctx->creq != NULL || cctx->mux_wait == NULL) {
+        return;
+    }
+
+    creq = cctx->mux_wait;
+    DLIST_REMOVE(cctx->mux_wait, creq);
+    cctx->creq = creq;
+
+    ret = client_cmd_execute(cctx, cctx->rctx->sss_cmds);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              "Failed to execute request, aborting client!\n");
+        talloc_free(cctx);
+    }
+}
+
+static void client_mux_wait_handler(struct tevent_context *ev,
+                                    struct tevent_immediate *imm,
+                                    void *pvt)
+{
+    struct cli_ctx *cctx = talloc_get_type(pvt, struct cli_ctx);
+
+    talloc_free(imm);
+
+    /* the previous request was answered, its reply is still waiting in
+     * cctx->mux_out */
+    cctx->creq = NULL;
+    client_mux_run_wait(cctx);
+}
+
+void client_mux_cmd_done(struct cli_ctx *cctx)
+{
+    struct cli_ctx *conn;
+    struct cli_request *creq = cctx->creq;
+    struct tevent_immediate *imm;
+
+    conn = cctx->mux_parent != NULL ? cctx->mux_parent : cctx;
+
+    if (creq->out != NULL) {
+        sss_packet_set_tag(creq->out, sss_packet_get_tag(creq->in));
+    }
+
+    talloc_steal(conn, creq);
+    DLIST_ADD_END(conn->mux_out, creq, struct cli_request *);
+    TEVENT_FD_WRITEABLE(conn->cfde);
+
+    if (cctx != conn) {
+        /* the caller may still use its request context, free it together
+         * with the reply */
+        talloc_steal(creq, cctx);
+        return;
+    }
+
+    /* The caller may still use cctx->creq as well, so the next request
+     * waiting for the connection state is started from the main loop. The
+     * immediate is cancelled if the reply is sent first, client_mux_send()
+     * starts the next request then. */
+    imm = tevent_create_immediate(creq);
+    if (imm == NULL) {
+        return;
+    }
+    tevent_schedule_immediate(imm, conn->ev, client_mux_wait_handler, conn);
+}
+
+/* Runs a request that does not use the connection state in its own context
+ * so that any number of them can be processed at the same time */
+static int client_mux_execute(struct cli_ctx *cctx, struct cli_request *creq)
+{
+    struct cli_ctx *rcctx;
+
+    rcctx = talloc_zero(cctx, struct cli_ctx);
+    if (rcctx == NULL) {
+        return ENOMEM;
+    }
+
+    rcctx->ev = cctx->ev;
+    rcctx->rctx = cctx->rctx;
+    rcctx->cfd = cctx->cfd;
+    rcctx->addr = cctx->addr;
+    rcctx->cli_protocol_version = cctx->cli_protocol_version;
+    rcctx->priv = cctx->priv;
+    rcctx->creds = cctx->creds;
+    rcctx->mux_parent = cctx;
+    rcctx->creq = talloc_steal(rcctx, creq);
+
+    return client_cmd_execute(rcctx, cctx->rctx->sss_cmds);
+}
+
+static void client_mux_send(struct cli_ctx *cctx)
+{
+    struct cli_request *creq = cctx->mux_out;
+    bool conn_state_done;
+    int ret;
+
+    if (creq == NULL) {
+        TEVENT_FD_NOT_WRITEABLE(cctx->cfde);
+        return;
+    }
+
+    ret = sss_packet_send(creq->out, cctx->cfd);
+    if (ret == EAGAIN) {
+        /* not all data was sent, loop again */
+        return;
+    }
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE, "Failed to send data, aborting client!\n");
+        talloc_free(cctx);
+        return;
+    }
+
+    DLIST_REMOVE(cctx->mux_out, creq);
+    conn_state_done = (cctx->creq == creq);
+    talloc_free(creq);
+    cctx->mux_pending--;
+
+    if (cctx->mux_out == NULL) {
+        TEVENT_FD_NOT_WRITEABLE(cctx->cfde);
+    }
+    if (cctx->mux_pending < CLIENT_MUX_MAX_PENDING) {
+        TEVENT_FD_READABLE(cctx->cfde);
+    }
+
+    if (conn_state_done) {
+        /* the request using the connection state was answered before
+         * client_mux_wait_handler() was called */
+        cctx->creq = NULL;
+        client_mux_run_wait(cctx);
+    }
+}
+
+static void client_recv_failed(struct cli_ctx *cctx, int ret)
+{
+    switch (ret) {
+    case EINVAL:
+        DEBUG(SSSDBG_TRACE_FUNC,
+              "Invalid data from client, closing connection!\n");
+        break;
+    case ENODATA:
+        DEBUG(SSSDBG_FUNC_DATA, "Client disconnected!\n");
+        break;
+    default:
+        DEBUG(SSSDBG_TRACE_FUNC, "Failed to read request, aborting client!\n");
+    }
+
+    talloc_free(cctx);
+}
+
+static void client_mux_recv(struct cli_ctx *cctx)
+{
+    struct cli_request *creq;
+    enum sss_cli_command cmd;
+    int ret;
+
+    if (cctx->mux_recv == NULL) {
+        cctx->mux_recv = talloc_zero(cctx, struct cli_request);
+        if (cctx->mux_recv == NULL) {
+            DEBUG(SSSDBG_FATAL_FAILURE,
+                  "Failed to alloc request, aborting client!\n");
+            talloc_free(cctx);
+            return;
+        }
+
+        ret = sss_packet_new(cctx->mux_recv, SSS_PACKET_MAX_RECV_SIZE,
+                             0, &cctx->mux_recv->in);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_FATAL_FAILURE,
+                  "Failed to alloc request, aborting client!\n");
+            talloc_free(cctx);
+            return;
+        }
+    }
+
+    ret = sss_packet_recv_one(cctx->mux_recv->in, cctx->cfd);
+    if (ret == EAGAIN) {
+        /* need to read still some data, loop again */
+        return;
+    } else if (ret != EOK) {
+        client_recv_failed(cctx, ret);
+        return;
+    }
+
+    creq = cctx->mux_recv;
+    cctx->mux_recv = NULL;
+
+    cctx->mux_pending++;
+    if (cctx->mux_pending >= CLIENT_MUX_MAX_PENDING) {
+        TEVENT_FD_NOT_READABLE(cctx->cfde);
+    }
+
+    cmd = sss_packet_get_cmd(creq->in);
+    if (sss_cmd_uses_conn_state(cmd, cctx->rctx->sss_cmds)) {
+        DLIST_ADD_END(cctx->mux_wait, creq, struct cli_request *);
+        client_mux_run_wait(cctx);
+        return;
+    }
+
+    ret = client_mux_execute(cctx, creq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              "Failed to execute request, aborting client!\n");
+        talloc_free(cctx);
+    }
+}
+
 static void client_send(struct cli_ctx *cctx)
 {
     int ret;
 
+    if (client_is_multiplexed(cctx)) {
+        client_mux_send(cctx);
+        return;
+    }
+
     ret = sss_packet_send(cctx->creq->out, cctx->cfd);
     if (ret == EAGAIN) {
         /* not all data was sent, loop again */
@@ -262,21 +500,39 @@ static void client_send(struct cli_ctx *cctx)
     TEVENT_FD_READABLE(cctx->cfde);
     talloc_free(cctx->creq);
     cctx->creq = NULL;
+    cctx->mux_pending--;
     return;
 }
 
-static int client_cmd_execute(struct cli_ctx *cctx, struct sss_cmd_table *sss_cmds)
+static int client_cmd_execute(struct cli_ctx *cctx,
+                              struct sss_cmd_table *sss_cmds)
 {
     enum sss_cli_command cmd;
+    uint32_t prev_rid;
+    int ret;
+
+    cctx->creq->rid = sss_latency_new_rid();
+    sss_latency_start(&cctx->creq->start);
 
     cmd = sss_packet_get_cmd(cctx->creq->in);
-    return sss_cmd_execute(cctx, cmd, sss_cmds);
+
+    /* everything the command starts is accounted to this request */
+    prev_rid = sss_latency_set_current(cctx->creq->rid);
+    ret = sss_cmd_execute(cctx, cmd, sss_cmds);
+    sss_latency_set_current(prev_rid);
+
+    return ret;
 }
 
 static void client_recv(struct cli_ctx *cctx)
 {
     int ret;
 
+    if (client_is_multiplexed(cctx)) {
+        client_mux_recv(cctx);
+        return;
+    }
+
     if (!cctx->creq) {
         cctx->creq = talloc_zero(cctx, struct cli_request);
         if (!cctx->creq) {
@@ -303,6 +559,7 @@ static void client_recv(struct cli_ctx *cctx)
     case EOK:
         /* do not read anymore */
         TEVENT_FD_NOT_READABLE(cctx->cfde);
+        cctx->mux_pending++;
         /* execute command */
         ret = client_cmd_execute(cctx, cctx->rctx->sss_cmds);
         if (ret != EOK) {
@@ -318,20 +575,8 @@ static void client_recv(struct cli_ctx *cctx)
         /* need to read still some data, loop again */
         break;
 
-    case EINVAL:
-        DEBUG(SSSDBG_TRACE_FUNC,
-              "Invalid data from client, closing connection!\n");
-        talloc_free(cctx);
-        break;
-
-    case ENODATA:
-        DEBUG(SSSDBG_FUNC_DATA, "Client disconnected!\n");
-        talloc_free(cctx);
-        break;
-
     default:
-        DEBUG(SSSDBG_TRACE_FUNC, "Failed to read request, aborting client!\n");
-        talloc_free(cctx);
+        client_recv_failed(cctx, ret);
     }
 
     return;
@@ -568,6 +813,19 @@ static int sss_dp_init(struct resp_ctx *rctx,
         return ret;
     }
 
+    ret = dp_get_frame_address(be_conn, &be_conn->frame_address,
+                               domain->name);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE, "Could not locate framed DP address.\n");
+        return ret;
+    }
+
+    ret = sss_dp_get_frame_conn(be_conn, NULL);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Framed connection to the DP is not "
+              "available, requests will be sent over D-Bus\n");
+    }
+
     DLIST_ADD_END(rctx->be_conns, be_conn, struct be_conn *);
 
     /* Identify ourselves to the DP */
@@ -825,6 +1083,16 @@ int sss_process_init(TALLOC_CTX *mem_ctx,
         rctx->domains_timeout = GET_DOMAINS_DEFAULT_TIMEOUT;
     }
 
+    ret = confdb_get_bool(rctx->cdb, rctx->confdb_service_path,
+                          CONFDB_RESPONDER_PARALLEL_DOMAIN_LOOKUPS, false,
+                          &rctx->parallel_domain_lookups);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot get the parallel domain lookups setting [%d]: %s\n",
+               ret, strerror(ret));
+        goto fail;
+    }
+
     ret = confdb_get_domains(rctx->cdb, &rctx->domains);
     if (ret != EOK) {
         DEBUG(SSSDBG_FATAL_FAILURE, "fatal error setting up domain map\n");
@@ -941,6 +1209,35 @@ int sss_dp_get_domain_conn(struct resp_ctx *rctx, const char *domain,
     return EOK;
 }
 
+errno_t sss_dp_get_frame_conn(struct be_conn *be_conn,
+                              struct sbus_connection **_conn)
+{
+    errno_t ret;
+
+    if (be_conn->frame_address == NULL) {
+        return ENOENT;
+    }
+
+    if (be_conn->frame_conn == NULL
+            || sbus_conn_disconnecting(be_conn->frame_conn)) {
+        /* the back end was restarted */
+        talloc_zfree(be_conn->frame_conn);
+
+        ret = sbus_frame_connect(be_conn, be_conn->rctx->ev,
+                                 be_conn->frame_address,
+                                 &be_conn->frame_conn);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    if (_conn != NULL) {
+        *_conn = be_conn->frame_conn;
+    }
+
+    return EOK;
+}
+
 struct sss_domain_info *
 responder_get_domain(struct resp_ctx *rctx, const char *name)
 {
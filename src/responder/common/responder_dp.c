@@ -23,6 +23,7 @@
 #include <sys/time.h>
 #include <time.h>
 #include "util/util.h"
+#include "util/sss_latency.h"
 #include "responder/common/responder_packet.h"
 #include "responder/common/responder.h"
 #include "providers/data_provider.h"
@@ -50,6 +51,10 @@ struct sss_dp_req {
     dbus_uint16_t dp_err;
     dbus_uint32_t dp_ret;
     char *err_msg;
+
+    /* latency tracing of the request that sent the message */
+    uint32_t rid;
+    struct timeval start;
 };
 
 static int sss_dp_callback_destructor(void *ptr)
@@ -161,12 +166,11 @@ void handle_requests_after_reconnect(struct resp_ctx *rctx)
     }
 }
 
-static int sss_dp_get_reply(DBusPendingCall *pending,
-                            dbus_uint16_t *dp_err,
-                            dbus_uint32_t *dp_ret,
-                            char **err_msg)
+static int sss_dp_get_reply_msg(DBusMessage *reply,
+                                dbus_uint16_t *dp_err,
+                                dbus_uint32_t *dp_ret,
+                                char **err_msg)
 {
-    DBusMessage *reply;
     DBusError dbus_error;
     dbus_bool_t ret;
     int type;
@@ -174,21 +178,6 @@ static int sss_dp_get_reply(DBusPendingCall *pending,
 
     dbus_error_init(&dbus_error);
 
-    reply = dbus_pending_call_steal_reply(pending);
-    if (!reply) {
-        /* reply should never be null. This function shouldn't be called
-         * until reply is valid or timeout has occurred. If reply is NULL
-         * here, something is seriously wrong and we should bail out.
-         */
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "Severe error. A reply callback was called but no reply "
-               "was received and no timeout occurred\n");
-
-        /* FIXME: Destroy this connection ? */
-        err = EIO;
-        goto done;
-    }
-
     type = dbus_message_get_type(reply);
     switch (type) {
     case DBUS_MESSAGE_TYPE_METHOD_RETURN:
@@ -234,6 +223,34 @@ static int sss_dp_get_reply(DBusPendingCall *pending,
     }
 
 done:
+    return err;
+}
+
+static int sss_dp_get_reply(DBusPendingCall *pending,
+                            dbus_uint16_t *dp_err,
+                            dbus_uint32_t *dp_ret,
+                            char **err_msg)
+{
+    DBusMessage *reply;
+    int err;
+
+    reply = dbus_pending_call_steal_reply(pending);
+    if (!reply) {
+        /* reply should never be null. This function shouldn't be called
+         * until reply is valid or timeout has occurred. If reply is NULL
+         * here, something is seriously wrong and we should bail out.
+         */
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Severe error. A reply callback was called but no reply "
+               "was received and no timeout occurred\n");
+
+        /* FIXME: Destroy this connection ? */
+        dbus_pending_call_unref(pending);
+        return EIO;
+    }
+
+    err = sss_dp_get_reply_msg(reply, dp_err, dp_ret, err_msg);
+
     dbus_pending_call_unref(pending);
     dbus_message_unref(reply);
 
@@ -522,6 +539,7 @@ sss_dp_get_account_msg(void *pvt)
     struct sss_dp_account_info *info;
     uint32_t be_type;
     uint32_t attrs = BE_ATTR_CORE;
+    uint32_t rid;
     char *filter;
 
     info = talloc_get_type(pvt, struct sss_dp_account_info);
@@ -618,16 +636,22 @@ sss_dp_get_account_msg(void *pvt)
         return NULL;
     }
 
+    /* The request ID is an optional trailing argument, so that the back end
+     * can account its work to this request. Back ends that do not know it
+     * ignore it. */
+    rid = sss_latency_current_rid();
+
     /* create the message */
     DEBUG(SSSDBG_TRACE_FUNC,
-          "Creating request for [%s][%#x][%s][%d][%s]\n",
-           info->dom->name, be_type, be_req2str(be_type), attrs, filter);
+          "Creating request for [%s][%#x][%s][%d][%s][%#x]\n",
+           info->dom->name, be_type, be_req2str(be_type), attrs, filter, rid);
 
     dbret = dbus_message_append_args(msg,
                                      DBUS_TYPE_UINT32, &be_type,
                                      DBUS_TYPE_UINT32, &attrs,
                                      DBUS_TYPE_STRING, &filter,
                                      DBUS_TYPE_STRING, &info->dom->name,
+                                     DBUS_TYPE_UINT32, &rid,
                                      DBUS_TYPE_INVALID);
     talloc_free(filter);
     if (!dbret) {
@@ -658,6 +682,9 @@ struct dp_internal_get_state {
 };
 
 static void sss_dp_internal_get_done(DBusPendingCall *pending, void *ptr);
+static void sss_dp_internal_get_frame_done(DBusMessage *reply,
+                                           errno_t error,
+                                           void *ptr);
 
 static struct tevent_req *
 sss_dp_internal_get_send(struct resp_ctx *rctx,
@@ -670,6 +697,7 @@ sss_dp_internal_get_send(struct resp_ctx *rctx,
     struct tevent_req *req;
     struct dp_internal_get_state *state;
     struct be_conn *be_conn;
+    struct sbus_connection *frame_conn;
     hash_value_t value;
 
     /* Internal requests need to be allocated on the responder context
@@ -692,6 +720,8 @@ sss_dp_internal_get_send(struct resp_ctx *rctx,
     }
     state->sdp_req->rctx = rctx;
     state->sdp_req->ev = rctx->ev;
+    state->sdp_req->rid = sss_latency_current_rid();
+    sss_latency_start(&state->sdp_req->start);
 
     /* Copy the key to use when calling the destructor
      * It needs to be a copy because the original request
@@ -712,11 +742,20 @@ sss_dp_internal_get_send(struct resp_ctx *rctx,
         goto error;
     }
 
-    ret = sbus_conn_send(be_conn->conn, msg,
-                         SSS_CLI_SOCKET_TIMEOUT / 2,
-                         sss_dp_internal_get_done,
-                         req,
-                         &state->sdp_req->pending_reply);
+    ret = sss_dp_get_frame_conn(be_conn, &frame_conn);
+    if (ret == EOK) {
+        /* the call is cancelled when sdp_req is freed */
+        ret = sbus_frame_send(state->sdp_req, frame_conn, msg,
+                              SSS_CLI_SOCKET_TIMEOUT / 2,
+                              sss_dp_internal_get_frame_done,
+                              req, NULL);
+    } else {
+        ret = sbus_conn_send(be_conn->conn, msg,
+                             SSS_CLI_SOCKET_TIMEOUT / 2,
+                             sss_dp_internal_get_done,
+                             req,
+                             &state->sdp_req->pending_reply);
+    }
     if (ret != EOK) {
         /*
          * Critical Failure
@@ -752,14 +791,14 @@ error:
     return req;
 }
 
+static void sss_dp_internal_get_finish(struct tevent_req *req, int ret);
+
 static void sss_dp_internal_get_done(DBusPendingCall *pending, void *ptr)
 {
     int ret;
     struct tevent_req *req;
     struct sss_dp_req *sdp_req;
-    struct sss_dp_callback *cb;
     struct dp_internal_get_state *state;
-    struct sss_dp_req_state *cb_state;
 
     req = talloc_get_type(ptr, struct tevent_req);
     state = tevent_req_data(req, struct dp_internal_get_state);
@@ -768,10 +807,55 @@ static void sss_dp_internal_get_done(DBusPendingCall *pending, void *ptr)
     /* prevent trying to cancel a reply that we already received */
     sdp_req->pending_reply = NULL;
 
+    sss_latency_record(sdp_req->rid, SSS_LATENCY_DP_REQUEST, &sdp_req->start);
+
     ret = sss_dp_get_reply(pending,
                            &sdp_req->dp_err,
                            &sdp_req->dp_ret,
                            &sdp_req->err_msg);
+
+    sss_dp_internal_get_finish(req, ret);
+}
+
+static void sss_dp_internal_get_frame_done(DBusMessage *reply,
+                                           errno_t error,
+                                           void *ptr)
+{
+    int ret;
+    struct tevent_req *req;
+    struct sss_dp_req *sdp_req;
+    struct dp_internal_get_state *state;
+
+    req = talloc_get_type(ptr, struct tevent_req);
+    state = tevent_req_data(req, struct dp_internal_get_state);
+    sdp_req = state->sdp_req;
+
+    sss_latency_record(sdp_req->rid, SSS_LATENCY_DP_REQUEST, &sdp_req->start);
+
+    if (error != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Framed DP request failed [%d]: %s\n",
+              error, sss_strerror(error));
+        ret = error == ETIME ? ETIME : EIO;
+    } else {
+        ret = sss_dp_get_reply_msg(reply,
+                                   &sdp_req->dp_err,
+                                   &sdp_req->dp_ret,
+                                   &sdp_req->err_msg);
+    }
+
+    sss_dp_internal_get_finish(req, ret);
+}
+
+static void sss_dp_internal_get_finish(struct tevent_req *req, int ret)
+{
+    struct sss_dp_req *sdp_req;
+    struct sss_dp_callback *cb;
+    struct dp_internal_get_state *state;
+    struct sss_dp_req_state *cb_state;
+
+    state = tevent_req_data(req, struct dp_internal_get_state);
+    sdp_req = state->sdp_req;
+
     if (ret != EOK) {
         if (ret == ETIME) {
             sdp_req->dp_err = DP_ERR_TIMEOUT;
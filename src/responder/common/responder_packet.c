@@ -40,7 +40,8 @@ struct sss_packet {
     * 0-3      packet length (uint32_t)
     * 4-7      command type (uint32_t)
     * 8-11     status (uint32_t)
-    * 12-15    reserved
+    * 12-15    request tag (uint32_t), only used by multiplexed protocol
+    *          versions, reserved otherwise
     * 16+      packet body */
     uint8_t *buffer;
 
@@ -52,6 +53,7 @@ struct sss_packet {
 #define SSS_PACKET_LEN_OFFSET 0
 #define SSS_PACKET_CMD_OFFSET sizeof(uint32_t)
 #define SSS_PACKET_ERR_OFFSET (2*(sizeof(uint32_t)))
+#define SSS_PACKET_TAG_OFFSET (3*(sizeof(uint32_t)))
 #define SSS_PACKET_BODY_OFFSET (4*(sizeof(uint32_t)))
 
 static void sss_packet_set_len(struct sss_packet *packet, uint32_t len);
@@ -220,6 +222,60 @@ int sss_packet_recv(struct sss_packet *packet, int fd)
     return EOK;
 }
 
+/* Same as sss_packet_recv() but never reads past the end of the packet, so
+ * that requests sent back to back by a multiplexing client stay in the
+ * socket until they are read into their own packets */
+int sss_packet_recv_one(struct sss_packet *packet, int fd)
+{
+    size_t rb;
+    size_t len;
+    size_t packet_len;
+    void *buf;
+
+    buf = (uint8_t *)packet->buffer + packet->iop;
+    if (packet->iop < SSS_NSS_HEADER_SIZE) {
+        len = SSS_NSS_HEADER_SIZE - packet->iop;
+    } else {
+        len = sss_packet_get_len(packet) - packet->iop;
+    }
+
+    /* check for wrapping */
+    if (len > packet->memsize) {
+        return EINVAL;
+    }
+
+    errno = 0;
+    rb = recv(fd, buf, len, 0);
+
+    if (rb == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return EAGAIN;
+        } else {
+            return errno;
+        }
+    }
+
+    if (rb == 0) {
+        return ENODATA;
+    }
+
+    packet->iop += rb;
+    if (packet->iop < SSS_NSS_HEADER_SIZE) {
+        return EAGAIN;
+    }
+
+    packet_len = sss_packet_get_len(packet);
+    if (packet_len < SSS_NSS_HEADER_SIZE || packet_len > packet->memsize) {
+        return EINVAL;
+    }
+
+    if (packet->iop < packet_len) {
+        return EAGAIN;
+    }
+
+    return EOK;
+}
+
 int sss_packet_send(struct sss_packet *packet, int fd)
 {
     size_t rb;
@@ -287,6 +343,19 @@ void sss_packet_set_error(struct sss_packet *packet, int error)
                             NULL);
 }
 
+uint32_t sss_packet_get_tag(struct sss_packet *packet)
+{
+    uint32_t tag;
+
+    SAFEALIGN_COPY_UINT32(&tag, packet->buffer + SSS_PACKET_TAG_OFFSET, NULL);
+    return tag;
+}
+
+void sss_packet_set_tag(struct sss_packet *packet, uint32_t tag)
+{
+    SAFEALIGN_SETMEM_UINT32(packet->buffer + SSS_PACKET_TAG_OFFSET, tag, NULL);
+}
+
 static void sss_packet_set_len(struct sss_packet *packet, uint32_t len)
 {
     SAFEALIGN_SETMEM_UINT32(packet->buffer + SSS_PACKET_LEN_OFFSET, len, NULL);
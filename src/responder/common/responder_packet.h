@@ -35,10 +35,13 @@ int sss_packet_grow(struct sss_packet *packet, size_t size);
 int sss_packet_shrink(struct sss_packet *packet, size_t size);
 int sss_packet_set_size(struct sss_packet *packet, size_t size);
 int sss_packet_recv(struct sss_packet *packet, int fd);
+int sss_packet_recv_one(struct sss_packet *packet, int fd);
 int sss_packet_send(struct sss_packet *packet, int fd);
 enum sss_cli_command sss_packet_get_cmd(struct sss_packet *packet);
 uint32_t sss_packet_get_status(struct sss_packet *packet);
 void sss_packet_get_body(struct sss_packet *packet, uint8_t **body, size_t *blen);
 void sss_packet_set_error(struct sss_packet *packet, int error);
+uint32_t sss_packet_get_tag(struct sss_packet *packet);
+void sss_packet_set_tag(struct sss_packet *packet, uint32_t tag);
 
 #endif /* __SSSSRV_PACKET_H__ */
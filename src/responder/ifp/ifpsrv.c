@@ -296,6 +296,12 @@ int ifp_process_init(TALLOC_CTX *mem_ctx,
         goto fail;
     }
 
+    ret = sss_ncache_set_timeout(ifp_ctx->ncache, rctx->ev,
+                                 ifp_ctx->neg_timeout);
+    if (ret != EOK) {
+        goto fail;
+    }
+
     ret = confdb_get_string(ifp_ctx->rctx->cdb, ifp_ctx->rctx,
                             CONFDB_IFP_CONF_ENTRY, CONFDB_IFP_USER_ATTR_LIST,
                             NULL, &attr_list_str);
@@ -71,6 +71,29 @@ struct mon_cli_iface monitor_nss_methods = {
     .sysbusReconnect = NULL,
 };
 
+/* Recreates an enabled memory cache empty. The cache keeps the size it
+ * has grown to. */
+static errno_t nss_clear_mmap_cache(struct nss_ctx *nctx, const char *name,
+                                    time_t timeout,
+                                    struct sss_mc_ctx **_mcc)
+{
+    errno_t ret;
+
+    if (*_mcc == NULL) {
+        /* cache is disabled */
+        return EOK;
+    }
+
+    ret = sss_mmap_cache_reinit(nctx, (size_t)-1, timeout, _mcc);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "%s mmap cache invalidation failed\n", name);
+        return ret;
+    }
+
+    return EOK;
+}
+
 static int nss_clear_memcache(struct sbus_request *dbus_req, void *data)
 {
     errno_t ret;
@@ -104,32 +127,46 @@ static int nss_clear_memcache(struct sbus_request *dbus_req, void *data)
         return ret;
     }
 
-    /* TODO: read cache sizes from configuration */
     DEBUG(SSSDBG_TRACE_FUNC, "Clearing memory caches.\n");
-    ret = sss_mmap_cache_reinit(nctx, SSS_MC_CACHE_ELEMENTS,
-                                (time_t) memcache_timeout,
-                                &nctx->pwd_mc_ctx);
+    ret = nss_clear_mmap_cache(nctx, "passwd", (time_t)memcache_timeout,
+                               &nctx->pwd_mc_ctx);
     if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "passwd mmap cache invalidation failed\n");
         return ret;
     }
 
-    ret = sss_mmap_cache_reinit(nctx, SSS_MC_CACHE_ELEMENTS,
-                                (time_t) memcache_timeout,
-                                &nctx->grp_mc_ctx);
+    ret = nss_clear_mmap_cache(nctx, "group", (time_t)memcache_timeout,
+                               &nctx->grp_mc_ctx);
     if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "group mmap cache invalidation failed\n");
         return ret;
     }
 
-    ret = sss_mmap_cache_reinit(nctx, SSS_MC_CACHE_ELEMENTS,
-                                (time_t)memcache_timeout,
-                                &nctx->initgr_mc_ctx);
+    ret = nss_clear_mmap_cache(nctx, "initgroups", (time_t)memcache_timeout,
+                               &nctx->initgr_mc_ctx);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = nss_clear_mmap_cache(nctx, "netgroup", (time_t)memcache_timeout,
+                               &nctx->netgr_mc_ctx);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = nss_clear_mmap_cache(nctx, "services", (time_t)memcache_timeout,
+                               &nctx->svc_mc_ctx);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = nss_clear_mmap_cache(nctx, "sid", (time_t)memcache_timeout,
+                               &nctx->sid_mc_ctx);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = nss_clear_mmap_cache(nctx, "negative", (time_t)nctx->neg_timeout,
+                               &nctx->neg_mc_ctx);
     if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "initgroups mmap cache invalidation failed\n");
         return ret;
     }
 
@@ -150,6 +187,10 @@ static int nss_clear_netgroup_hash_table(struct sbus_request *dbus_req, void *da
         return ret;
     }
 
+    /* Clients must not keep serving the invalidated netgroups from the
+     * fast cache either */
+    sss_mmap_cache_reset(nctx->netgr_mc_ctx);
+
     return sbus_request_return_and_finish(dbus_req, DBUS_TYPE_INVALID);
 }
 
@@ -368,10 +409,36 @@ static int nss_memcache_initgr_check(struct sbus_request *dbus_req, void *data)
     return sbus_request_return_and_finish(dbus_req, DBUS_TYPE_INVALID);
 }
 
+static int nss_memcache_invalidate_entry(struct sbus_request *dbus_req,
+                                         void *data)
+{
+    struct resp_ctx *rctx = talloc_get_type(data, struct resp_ctx);
+    struct nss_ctx *nctx = talloc_get_type(rctx->pvt_ctx, struct nss_ctx);
+    uint32_t type;
+    char *name;
+    char *domain;
+
+    if (!sbus_request_parse_or_finish(dbus_req,
+                                      DBUS_TYPE_UINT32, &type,
+                                      DBUS_TYPE_STRING, &name,
+                                      DBUS_TYPE_STRING, &domain,
+                                      DBUS_TYPE_INVALID)) {
+        return EOK; /* handled */
+    }
+
+    DEBUG(SSSDBG_TRACE_LIBS,
+          "Got request to invalidate [%s@%s]\n", name, domain);
+
+    nss_invalidate_memcache_entry(nctx, type, name, domain);
+
+    return sbus_request_return_and_finish(dbus_req, DBUS_TYPE_INVALID);
+}
+
 static struct data_provider_rev_iface nss_dp_methods = {
     { &data_provider_rev_iface_meta, 0 },
     .updateCache = nss_update_memcache,
-    .initgrCheck = nss_memcache_initgr_check
+    .initgrCheck = nss_memcache_initgr_check,
+    .invalidateEntry = nss_memcache_invalidate_entry
 };
 
 static void nss_dp_reconnect_init(struct sbus_connection *conn,
@@ -403,6 +470,43 @@ static void nss_dp_reconnect_init(struct sbus_connection *conn,
     /* nss_shutdown(rctx); */
 }
 
+/* Creates the memory cache @name with the number of entries configured in
+ * @size_opt. A failure only disables the cache, as does a size of 0. */
+static void nss_setup_mmap_cache(struct nss_ctx *nctx, const char *name,
+                                 enum sss_mc_type type, const char *size_opt,
+                                 int default_size, time_t timeout, bool warm,
+                                 struct sss_mc_ctx **_mcc)
+{
+    int size;
+    errno_t ret;
+
+    ret = confdb_get_int(nctx->rctx->cdb, CONFDB_NSS_CONF_ENTRY, size_opt,
+                         default_size, &size);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Failed to get '%s' option from confdb, using the default "
+              "size.\n", size_opt);
+        size = default_size;
+    }
+
+    if (size < 0) {
+        DEBUG(SSSDBG_CONF_SETTINGS,
+              "'%s' can't be set to a negative value, using the default "
+              "size.\n", size_opt);
+        size = default_size;
+    }
+
+    if (size == 0) {
+        DEBUG(SSSDBG_CONF_SETTINGS, "%s mmap cache is disabled\n", name);
+        return;
+    }
+
+    ret = sss_mmap_cache_init(nctx, name, type, size, timeout, warm, _mcc);
+    if (ret) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "%s mmap cache is DISABLED\n", name);
+    }
+}
+
 int nss_process_init(TALLOC_CTX *mem_ctx,
                      struct tevent_context *ev,
                      struct confdb_ctx *cdb)
@@ -412,6 +516,9 @@ int nss_process_init(TALLOC_CTX *mem_ctx,
     struct be_conn *iter;
     struct nss_ctx *nctx;
     int memcache_timeout;
+    bool memcache_negative;
+    bool memcache_stats;
+    bool warm_restart;
     int ret, max_retries;
     enum idmap_error_code err;
     int hret;
@@ -456,6 +563,13 @@ int nss_process_init(TALLOC_CTX *mem_ctx,
         goto fail;
     }
 
+    ret = sss_ncache_set_timeout(nctx->ncache, rctx->ev, nctx->neg_timeout);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              "fatal error setting negative cache timeout\n");
+        goto fail;
+    }
+
     /* Enable automatic reconnection to the Data Provider */
     ret = confdb_get_int(nctx->rctx->cdb,
                          CONFDB_NSS_CONF_ENTRY,
@@ -511,26 +625,81 @@ int nss_process_init(TALLOC_CTX *mem_ctx,
         goto fail;
     }
 
-    /* TODO: read cache sizes from configuration */
-    ret = sss_mmap_cache_init(nctx, "passwd", SSS_MC_PASSWD,
-                              SSS_MC_CACHE_ELEMENTS, (time_t)memcache_timeout,
-                              &nctx->pwd_mc_ctx);
-    if (ret) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "passwd mmap cache is DISABLED\n");
+    ret = confdb_get_bool(nctx->rctx->cdb,
+                          CONFDB_NSS_CONF_ENTRY,
+                          CONFDB_NSS_MEMCACHE_WARM_RESTART,
+                          false, &warm_restart);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              "Failed to get 'memcache_warm_restart' option from confdb.\n");
+        goto fail;
     }
 
-    ret = sss_mmap_cache_init(nctx, "group", SSS_MC_GROUP,
-                              SSS_MC_CACHE_ELEMENTS, (time_t)memcache_timeout,
-                              &nctx->grp_mc_ctx);
-    if (ret) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "group mmap cache is DISABLED\n");
+    nss_setup_mmap_cache(nctx, "passwd", SSS_MC_PASSWD,
+                         CONFDB_NSS_MEMCACHE_SIZE_PASSWD,
+                         SSS_MC_CACHE_ELEMENTS, (time_t)memcache_timeout,
+                         warm_restart, &nctx->pwd_mc_ctx);
+
+    nss_setup_mmap_cache(nctx, "group", SSS_MC_GROUP,
+                         CONFDB_NSS_MEMCACHE_SIZE_GROUP,
+                         SSS_MC_CACHE_ELEMENTS, (time_t)memcache_timeout,
+                         warm_restart, &nctx->grp_mc_ctx);
+
+    nss_setup_mmap_cache(nctx, "initgroups", SSS_MC_INITGROUPS,
+                         CONFDB_NSS_MEMCACHE_SIZE_INITGROUPS,
+                         SSS_MC_CACHE_ELEMENTS, (time_t)memcache_timeout,
+                         warm_restart, &nctx->initgr_mc_ctx);
+
+    nss_setup_mmap_cache(nctx, "netgroup", SSS_MC_NETGROUP,
+                         CONFDB_NSS_MEMCACHE_SIZE_NETGROUP,
+                         SSS_MC_CACHE_NETGR_ELEMENTS,
+                         (time_t)memcache_timeout,
+                         warm_restart, &nctx->netgr_mc_ctx);
+
+    nss_setup_mmap_cache(nctx, "services", SSS_MC_SERVICES,
+                         CONFDB_NSS_MEMCACHE_SIZE_SERVICES,
+                         SSS_MC_CACHE_SVC_ELEMENTS,
+                         (time_t)memcache_timeout,
+                         warm_restart, &nctx->svc_mc_ctx);
+
+    nss_setup_mmap_cache(nctx, "sid", SSS_MC_SID,
+                         CONFDB_NSS_MEMCACHE_SIZE_SID,
+                         SSS_MC_CACHE_ELEMENTS, (time_t)memcache_timeout,
+                         warm_restart, &nctx->sid_mc_ctx);
+
+    ret = confdb_get_bool(nctx->rctx->cdb,
+                          CONFDB_NSS_CONF_ENTRY,
+                          CONFDB_NSS_MEMCACHE_NEGATIVE,
+                          false, &memcache_negative);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              "Failed to get 'memcache_negative' option from confdb.\n");
+        goto fail;
     }
 
-    ret = sss_mmap_cache_init(nctx, "initgroups", SSS_MC_INITGROUPS,
-                              SSS_MC_CACHE_ELEMENTS, (time_t)memcache_timeout,
-                              &nctx->initgr_mc_ctx);
-    if (ret) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "inigroups mmap cache is DISABLED\n");
+    /* negative records expire together with the responder negative cache */
+    if (memcache_negative && nctx->neg_timeout > 0) {
+        nss_setup_mmap_cache(nctx, "negative", SSS_MC_NEGATIVE,
+                             CONFDB_NSS_MEMCACHE_SIZE_NEGATIVE,
+                             SSS_MC_CACHE_NEG_ELEMENTS,
+                             (time_t)nctx->neg_timeout, warm_restart,
+                             &nctx->neg_mc_ctx);
+    }
+
+    ret = confdb_get_bool(nctx->rctx->cdb,
+                          CONFDB_NSS_CONF_ENTRY,
+                          CONFDB_NSS_MEMCACHE_STATS,
+                          false, &memcache_stats);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              "Failed to get 'memcache_stats' option from confdb.\n");
+        goto fail;
+    }
+
+    ret = sss_mmap_cache_stats_init(memcache_stats, &nctx->mc_stats);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Memory cache statistics are not available.\n");
     }
 
     /* Set up file descriptor limits */
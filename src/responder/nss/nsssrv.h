@@ -40,6 +40,7 @@
 
 struct getent_ctx;
 struct sss_mc_ctx;
+struct sss_mc_stats;
 
 struct nss_ctx {
     struct resp_ctx *rctx;
@@ -73,6 +74,13 @@ struct nss_ctx {
     struct sss_mc_ctx *pwd_mc_ctx;
     struct sss_mc_ctx *grp_mc_ctx;
     struct sss_mc_ctx *initgr_mc_ctx;
+    struct sss_mc_ctx *netgr_mc_ctx;
+    struct sss_mc_ctx *svc_mc_ctx;
+    struct sss_mc_ctx *sid_mc_ctx;
+    struct sss_mc_ctx *neg_mc_ctx;
+
+    /* memory cache lookups reported by the clients, NULL if disabled */
+    struct sss_mc_stats *mc_stats;
 
     struct sss_idmap_ctx *idmap_ctx;
     struct sss_names_ctx *global_names;
@@ -22,12 +22,14 @@
 #include "util/util.h"
 #include "util/sss_nss.h"
 #include "util/sss_cli_cmd.h"
+#include "util/mmap_cache.h"
 #include "responder/nss/nsssrv.h"
 #include "responder/nss/nsssrv_private.h"
 #include "responder/nss/nsssrv_netgroup.h"
 #include "responder/nss/nsssrv_services.h"
 #include "responder/nss/nsssrv_mmap_cache.h"
 #include "responder/common/negcache.h"
+#include "responder/common/responder_cache_req.h"
 #include "providers/data_provider.h"
 #include "confdb/confdb.h"
 #include "db/sysdb.h"
@@ -45,6 +47,67 @@ static int nss_cmd_send_empty(struct nss_cmd_ctx *cmdctx)
     return sss_cmd_send_empty(cctx, cmdctx);
 }
 
+/* Publishes the final "not found" answer in the negative mmap cache, so
+ * that clients do not ask the responder again until it expires */
+static void nss_neg_mc_store(struct nss_cmd_ctx *cmdctx)
+{
+    struct cli_ctx *cctx = cmdctx->cctx;
+    struct nss_ctx *nctx;
+    struct sized_string key;
+    const char *prefix;
+    char *keystr = NULL;
+    uint8_t *body;
+    size_t blen;
+    uint32_t id;
+    errno_t ret;
+
+    nctx = talloc_get_type(cctx->rctx->pvt_ctx, struct nss_ctx);
+    if (nctx->neg_mc_ctx == NULL || nctx->neg_timeout <= 0) {
+        return;
+    }
+
+    sss_packet_get_body(cctx->creq->in, &body, &blen);
+
+    switch (cmdctx->cmd) {
+    case SSS_NSS_GETPWNAM:
+    case SSS_NSS_GETGRNAM:
+        if (blen == 0 || body[blen - 1] != '\0') {
+            return;
+        }
+        prefix = cmdctx->cmd == SSS_NSS_GETPWNAM ? SSS_MC_NEG_PWNAM
+                                                 : SSS_MC_NEG_GRNAM;
+        keystr = talloc_asprintf(cmdctx, "%s%s", prefix, (const char *)body);
+        break;
+    case SSS_NSS_GETPWUID:
+    case SSS_NSS_GETGRGID:
+        if (blen != sizeof(uint32_t)) {
+            return;
+        }
+        SAFEALIGN_COPY_UINT32(&id, body, NULL);
+        prefix = cmdctx->cmd == SSS_NSS_GETPWUID ? SSS_MC_NEG_PWUID
+                                                 : SSS_MC_NEG_GRGID;
+        keystr = talloc_asprintf(cmdctx, "%s%"PRIu32, prefix, id);
+        break;
+    default:
+        return;
+    }
+
+    if (keystr == NULL) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Out of memory\n");
+        return;
+    }
+
+    to_sized_string(&key, keystr);
+    ret = sss_mmap_cache_neg_store(&nctx->neg_mc_ctx, &key);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Failed to store negative record [%s] in mmap cache [%d]: %s\n",
+              keystr, ret, sss_strerror(ret));
+    }
+
+    talloc_free(keystr);
+}
+
 int nss_cmd_done(struct nss_cmd_ctx *cmdctx, int ret)
 {
     switch (ret) {
@@ -53,6 +116,7 @@ int nss_cmd_done(struct nss_cmd_ctx *cmdctx, int ret)
         break;
 
     case ENOENT:
+        nss_neg_mc_store(cmdctx);
         ret = nss_cmd_send_empty(cmdctx);
         if (ret) {
             return EFAULT;
@@ -939,6 +1003,15 @@ static int delete_entry_from_memcache(struct sss_domain_info *dom, char *name,
             goto done;
         }
         break;
+    case SSS_MC_SID:
+        ret = sss_mmap_cache_sid_invalidate(mc_ctx, &delete_name);
+        if (ret != EOK && ret != ENOENT) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "Internal failure in memory cache code: %d [%s]\n",
+                  ret, strerror(ret));
+            goto done;
+        }
+        break;
     default:
         ret = EINVAL;
         goto done;
@@ -1124,6 +1197,13 @@ static int nss_cmd_getpwnam_search(struct nss_dom_ctx *dctx)
                       "Deleting user from memcache failed.\n");
             }
 
+            ret = delete_entry_from_memcache(dctx->domain, name,
+                                             nctx->sid_mc_ctx, SSS_MC_SID);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_MINOR_FAILURE,
+                      "Deleting user from memcache failed.\n");
+            }
+
             return ENOENT;
         }
 
@@ -2296,7 +2376,8 @@ static errno_t nss_cmd_setpwent_step(struct setent_step_ctx *step_ctx)
     struct nss_dom_ctx *dctx = step_ctx->dctx;
     struct getent_ctx *pctx = step_ctx->getent_ctx;
     struct nss_ctx *nctx = step_ctx->nctx;
-    struct ldb_result *res;
+    const char **names;
+    size_t num_names;
     struct timeval tv;
     struct tevent_timer *te;
     struct tevent_req *dpreq;
@@ -2359,7 +2440,10 @@ static errno_t nss_cmd_setpwent_step(struct setent_step_ctx *step_ctx)
             }
         }
 
-        ret = sysdb_enumpwent_with_views(dctx, dom, &res);
+        /* Only the names are kept, so that a large domain neither has to
+         * be held in memory nor merged with its view in one go. All
+         * enumerating clients share this list. */
+        ret = sysdb_enumpwent_names(dctx, dom, &names, &num_names);
         if (ret != EOK) {
             DEBUG(SSSDBG_CRIT_FAILURE,
                   "Enum from cache failed, skipping domain [%s]\n",
@@ -2368,9 +2452,10 @@ static errno_t nss_cmd_setpwent_step(struct setent_step_ctx *step_ctx)
             continue;
         }
 
-        if (res->count == 0) {
+        if (num_names == 0) {
             DEBUG(SSSDBG_CONF_SETTINGS,
                   "Domain [%s] has no users, skipping.\n", dom->name);
+            talloc_free(names);
             dom = get_next_domain(dom, SSS_GND_DESCEND);
             continue;
         }
@@ -2384,7 +2469,9 @@ static errno_t nss_cmd_setpwent_step(struct setent_step_ctx *step_ctx)
         }
 
         nctx->pctx->doms[pctx->num].domain = dctx->domain;
-        nctx->pctx->doms[pctx->num].res = talloc_steal(pctx->doms, res);
+        nctx->pctx->doms[pctx->num].res = NULL;
+        nctx->pctx->doms[pctx->num].names = talloc_steal(pctx->doms, names);
+        nctx->pctx->doms[pctx->num].num_names = num_names;
 
         nctx->pctx->num++;
 
@@ -2563,7 +2650,7 @@ static int nss_cmd_retpwent(struct cli_ctx *cctx, int num)
 {
     struct nss_ctx *nctx;
     struct getent_ctx *pctx;
-    struct ldb_message **msgs = NULL;
+    struct ldb_result *res;
     struct dom_ctx *pdom = NULL;
     int n = 0;
     int ret = ENOENT;
@@ -2578,11 +2665,11 @@ static int nss_cmd_retpwent(struct cli_ctx *cctx, int num)
 
         pdom = &pctx->doms[cctx->pwent_dom_idx];
 
-        n = pdom->res->count - cctx->pwent_cur;
+        n = pdom->num_names - cctx->pwent_cur;
         if (n <= 0 && (cctx->pwent_dom_idx+1 < pctx->num)) {
             cctx->pwent_dom_idx++;
             pdom = &pctx->doms[cctx->pwent_dom_idx];
-            n = pdom->res->count;
+            n = pdom->num_names;
             cctx->pwent_cur = 0;
         }
 
@@ -2590,20 +2677,32 @@ static int nss_cmd_retpwent(struct cli_ctx *cctx, int num)
 
         if (n < 0) {
             DEBUG(SSSDBG_CRIT_FAILURE, "BUG: Negative difference"
-                  "[%d - %d = %d]\n", pdom->res->count, cctx->pwent_cur, n);
+                  "[%zu - %d = %d]\n", pdom->num_names, cctx->pwent_cur, n);
             DEBUG(SSSDBG_CRIT_FAILURE, "Domain: %d (total %d)\n",
                                         cctx->pwent_dom_idx, pctx->num);
             break;
         }
 
         if (n > num) n = num;
+        if (n > NSS_ENUM_PAGE_SIZE) n = NSS_ENUM_PAGE_SIZE;
 
-        msgs = &(pdom->res->msgs[cctx->pwent_cur]);
+        /* only the entries of this reply are loaded */
+        ret = sysdb_enumpwent_page_with_views(cctx, pdom->domain,
+                                              &pdom->names[cctx->pwent_cur],
+                                              n, &res);
+        cctx->pwent_cur += n;
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  "Failed to load users of domain [%s], skipping them "
+                  "[%d]: %s\n", pdom->domain->name, ret, sss_strerror(ret));
+            ret = ENOENT;
+            continue;
+        }
 
+        n = res->count;
         ret = fill_pwent(cctx->creq->out, pdom->domain, nctx,
-                         true, false, msgs, &n);
-
-        cctx->pwent_cur += n;
+                         true, false, res->msgs, &n);
+        talloc_free(res);
     }
 
 none:
@@ -3295,6 +3394,13 @@ static int nss_cmd_getgrnam_search(struct nss_dom_ctx *dctx)
                       "Deleting group from memcache failed.\n");
             }
 
+            ret = delete_entry_from_memcache(dctx->domain, name,
+                                             nctx->sid_mc_ctx, SSS_MC_SID);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_MINOR_FAILURE,
+                      "Deleting group from memcache failed.\n");
+            }
+
 
             return ENOENT;
         }
@@ -4031,6 +4137,60 @@ done:
     return EOK;
 }
 
+/* Drops the records of an entry the provider has seen change on the server,
+ * the next lookup reads the entry from the cache again */
+void nss_invalidate_memcache_entry(struct nss_ctx *nctx, uint32_t type,
+                                   const char *name, const char *domain)
+{
+    struct sss_domain_info *dom;
+    char *delete_name;
+    int ret;
+
+    for (dom = nctx->rctx->domains; dom; dom = get_next_domain(dom, 0)) {
+        if (strcasecmp(dom->name, domain) == 0) {
+            break;
+        }
+    }
+
+    if (dom == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Unknown domain (%s) requested by provider\n", domain);
+        return;
+    }
+
+    delete_name = discard_const(name);
+
+    switch (type) {
+    case BE_REQ_USER:
+        ret = delete_entry_from_memcache(dom, delete_name, nctx->pwd_mc_ctx,
+                                         SSS_MC_PASSWD);
+        if (ret == EOK) {
+            ret = delete_entry_from_memcache(dom, delete_name,
+                                             nctx->initgr_mc_ctx,
+                                             SSS_MC_INITGROUPS);
+        }
+        break;
+    case BE_REQ_GROUP:
+        ret = delete_entry_from_memcache(dom, delete_name, nctx->grp_mc_ctx,
+                                         SSS_MC_GROUP);
+        break;
+    default:
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Unsupported entry type [%"PRIu32"]\n", type);
+        return;
+    }
+
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Could not invalidate [%s@%s] in the memory cache\n",
+              name, domain);
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "Invalidated [%s@%s] in the memory cache\n", name, domain);
+}
+
 void nss_update_initgr_memcache(struct nss_ctx *nctx,
                                 const char *name, const char *domain,
                                 int gnum, uint32_t *groups)
@@ -4867,6 +5027,14 @@ static errno_t nss_cmd_getbysid_search(struct nss_dom_ctx *dctx)
         if (!dctx->check_provider) {
             DEBUG(SSSDBG_OP_FAILURE, "No results for getbysid call.\n");
 
+            /* SID not found in ldb -> delete it from memory cache. */
+            ret = sss_mmap_cache_sid_invalidate_sid(nctx->sid_mc_ctx,
+                                                    cmdctx->secid);
+            if (ret != EOK && ret != ENOENT) {
+                DEBUG(SSSDBG_MINOR_FAILURE,
+                      "Deleting SID from memcache failed.\n");
+            }
+
             /* set negative cache only if not result of cache check */
             ret = sss_ncache_set_sid(nctx->ncache, false, cmdctx->secid);
             if (ret != EOK) {
@@ -5142,22 +5310,16 @@ done:
     return ret;
 }
 
-static errno_t fill_name(struct sss_packet *packet,
-                         struct sss_domain_info *dom,
-                         enum sss_id_type id_type,
-                         bool apply_no_view,
-                         struct ldb_message *msg)
+static errno_t get_object_name(TALLOC_CTX *mem_ctx,
+                               struct sss_domain_info *dom,
+                               bool apply_no_view,
+                               struct ldb_message *msg,
+                               const char **_name)
 {
-    int ret;
-    TALLOC_CTX *tmp_ctx = NULL;
     const char *orig_name = NULL;
     const char *cased_name;
     const char *fq_name;
-    struct sized_string name;
     bool add_domain = (!IS_SUBDOMAIN(dom) && dom->fqnames);
-    uint8_t *body;
-    size_t blen;
-    size_t pctr = 0;
 
     if (apply_no_view) {
         orig_name = ldb_msg_find_attr_as_string(msg,
@@ -5183,30 +5345,51 @@ static errno_t fill_name(struct sss_packet *packet,
         return EINVAL;
     }
 
-    tmp_ctx = talloc_new(NULL);
-    if (tmp_ctx == NULL) {
-        DEBUG(SSSDBG_OP_FAILURE, "talloc_new failed.\n");
-        return ENOMEM;
-    }
-
-    cased_name= sss_get_cased_name(tmp_ctx, orig_name, dom->case_sensitive);
+    cased_name= sss_get_cased_name(mem_ctx, orig_name, dom->case_sensitive);
     if (cased_name == NULL) {
         DEBUG(SSSDBG_OP_FAILURE, "sss_get_cased_name failed.\n");
-        ret = ENOMEM;
-        goto done;
+        return ENOMEM;
     }
 
     if (add_domain) {
-        fq_name = sss_tc_fqname(tmp_ctx, dom->names, dom, cased_name);
+        fq_name = sss_tc_fqname(mem_ctx, dom->names, dom, cased_name);
         if (fq_name == NULL) {
             DEBUG(SSSDBG_OP_FAILURE, "talloc_asprintf failed.\n");
-            ret = ENOMEM;
-            goto done;
+            return ENOMEM;
         }
-        to_sized_string(&name, fq_name);
+        *_name = fq_name;
     } else {
-        to_sized_string(&name, cased_name);
+        *_name = cased_name;
+    }
+
+    return EOK;
+}
+
+static errno_t fill_name(struct sss_packet *packet,
+                         struct sss_domain_info *dom,
+                         enum sss_id_type id_type,
+                         bool apply_no_view,
+                         struct ldb_message *msg)
+{
+    int ret;
+    TALLOC_CTX *tmp_ctx = NULL;
+    const char *obj_name;
+    struct sized_string name;
+    uint8_t *body;
+    size_t blen;
+    size_t pctr = 0;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE, "talloc_new failed.\n");
+        return ENOMEM;
+    }
+
+    ret = get_object_name(tmp_ctx, dom, apply_no_view, msg, &obj_name);
+    if (ret != EOK) {
+        goto done;
     }
+    to_sized_string(&name, obj_name);
 
     ret = sss_packet_grow(packet, name.len + 3 * sizeof(uint32_t));
     if (ret != EOK) {
@@ -5267,6 +5450,65 @@ static errno_t fill_id(struct sss_packet *packet,
     return EOK;
 }
 
+/* Store the name, SID and ID of the object in the mmap cache so that
+ * libsss_nss_idmap can resolve the mapping without a round trip */
+static void nss_sid_mc_store(struct nss_ctx *nctx,
+                             struct sss_domain_info *dom,
+                             enum sss_id_type id_type,
+                             struct ldb_message *msg)
+{
+    TALLOC_CTX *tmp_ctx;
+    const char *sid_str;
+    const char *obj_name;
+    struct sized_string name;
+    struct sized_string sid;
+    uint64_t tmp_id;
+    uint32_t id;
+    errno_t ret;
+
+    if (nctx->sid_mc_ctx == NULL) {
+        return;
+    }
+
+    sid_str = ldb_msg_find_attr_as_string(msg, SYSDB_SID_STR, NULL);
+    if (sid_str == NULL) {
+        return;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return;
+    }
+
+    ret = get_object_name(tmp_ctx, dom, false, msg, &obj_name);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    if (id_type == SSS_ID_TYPE_GID) {
+        tmp_id = ldb_msg_find_attr_as_uint64(msg, SYSDB_GIDNUM, 0);
+    } else {
+        tmp_id = ldb_msg_find_attr_as_uint64(msg, SYSDB_UIDNUM, 0);
+    }
+    /* objects without a valid POSIX ID are still cached for the
+     * name <-> SID mappings */
+    id = (tmp_id >= UINT32_MAX) ? 0 : (uint32_t) tmp_id;
+
+    to_sized_string(&name, obj_name);
+    to_sized_string(&sid, sid_str);
+
+    ret = sss_mmap_cache_sid_store(&nctx->sid_mc_ctx, &name, &sid,
+                                   id, id_type);
+    if (ret != EOK && ret != ENOMEM) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Failed to store SID %s(%s) in mmap cache!\n",
+              sid_str, obj_name);
+    }
+
+done:
+    talloc_free(tmp_ctx);
+}
+
 static errno_t nss_cmd_getbysid_send_reply(struct nss_dom_ctx *dctx)
 {
     struct nss_cmd_ctx *cmdctx = dctx->cmdctx;
@@ -5293,6 +5535,11 @@ static errno_t nss_cmd_getbysid_send_reply(struct nss_dom_ctx *dctx)
         return ret;
     }
 
+    if (cmdctx->cmd != SSS_NSS_GETORIGBYNAME) {
+        nss_sid_mc_store(talloc_get_type(cctx->rctx->pvt_ctx, struct nss_ctx),
+                         dctx->domain, id_type, dctx->res->msgs[0]);
+    }
+
     switch(cmdctx->cmd) {
     case SSS_NSS_GETNAMEBYSID:
         ret = fill_name(cctx->creq->out,
@@ -5523,10 +5770,592 @@ static int nss_cmd_getorigbyname(struct cli_ctx *cctx)
     return nss_cmd_getbynam(SSS_NSS_GETORIGBYNAME, cctx);
 }
 
+/* Batch lookups
+ *
+ * All keys of a SSS_NSS_GETBATCH request are looked up at the same time with
+ * cache_req and the results are sent back in a single reply. Identical keys
+ * are looked up only once, concurrent data provider requests for the same
+ * object are merged by sss_dp_issue_request(). */
+
+struct nss_batch_key {
+    const char *str;
+    uint32_t id;
+
+    /* another key with the same value is looked up instead of this one */
+    bool duplicate;
+    size_t orig;
+
+    errno_t ret;
+    struct sss_domain_info *dom;
+    struct ldb_message *msg;
+
+    /* Well-Known SIDs are not stored in the cache */
+    const char *wk_name;
+    const char *wk_sid;
+};
+
+struct nss_batch_ctx {
+    struct nss_cmd_ctx *cmdctx;
+    struct nss_ctx *nctx;
+
+    enum sss_nss_key_type key_type;
+    uint32_t num_keys;
+    struct nss_batch_key *keys;
+    uint32_t num_pending;
+};
+
+struct nss_batch_lookup {
+    struct nss_batch_ctx *bctx;
+    size_t idx;
+    bool group;
+};
+
+static errno_t nss_batch_parse_keys(struct nss_batch_ctx *bctx,
+                                    uint8_t *body, size_t blen)
+{
+    struct nss_batch_key *key;
+    size_t pctr = 0;
+    size_t slen;
+    uint32_t key_type;
+    uint32_t c;
+    uint32_t d;
+
+    if (blen < 2 * sizeof(uint32_t)) {
+        return EINVAL;
+    }
+
+    SAFEALIGN_COPY_UINT32(&key_type, body, &pctr);
+    SAFEALIGN_COPY_UINT32(&bctx->num_keys, body + pctr, &pctr);
+
+    switch (key_type) {
+    case SSS_NSS_KEY_NAME:
+    case SSS_NSS_KEY_UID:
+    case SSS_NSS_KEY_GID:
+    case SSS_NSS_KEY_SID:
+        bctx->key_type = key_type;
+        break;
+    default:
+        DEBUG(SSSDBG_OP_FAILURE, "Unknown key type [%"PRIu32"].\n", key_type);
+        return EINVAL;
+    }
+
+    /* every key takes at least one byte */
+    if (bctx->num_keys == 0 || bctx->num_keys > blen - pctr) {
+        return EINVAL;
+    }
+
+    bctx->keys = talloc_zero_array(bctx, struct nss_batch_key, bctx->num_keys);
+    if (bctx->keys == NULL) {
+        return ENOMEM;
+    }
+
+    for (c = 0; c < bctx->num_keys; c++) {
+        key = &bctx->keys[c];
+
+        switch (bctx->key_type) {
+        case SSS_NSS_KEY_UID:
+        case SSS_NSS_KEY_GID:
+            if (blen - pctr < sizeof(uint32_t)) {
+                return EINVAL;
+            }
+            SAFEALIGN_COPY_UINT32(&key->id, body + pctr, &pctr);
+            break;
+        case SSS_NSS_KEY_NAME:
+        case SSS_NSS_KEY_SID:
+            slen = strnlen((const char *)body + pctr, blen - pctr);
+            if (slen == 0 || slen == blen - pctr) {
+                /* empty or not terminated */
+                return EINVAL;
+            }
+            if (!sss_utf8_check(body + pctr, slen)) {
+                return EINVAL;
+            }
+            key->str = (const char *)body + pctr;
+            pctr += slen + 1;
+            break;
+        }
+
+        for (d = 0; d < c; d++) {
+            if (bctx->keys[d].duplicate) {
+                continue;
+            }
+            if (key->str != NULL ? strcmp(key->str, bctx->keys[d].str) == 0
+                                 : key->id == bctx->keys[d].id) {
+                key->duplicate = true;
+                key->orig = d;
+                break;
+            }
+        }
+    }
+
+    if (pctr != blen) {
+        return EINVAL;
+    }
+
+    return EOK;
+}
+
+static errno_t nss_batch_check_well_known(struct nss_batch_ctx *bctx,
+                                          struct nss_batch_key *key)
+{
+    const char *wk_name;
+    const char *wk_dom_name;
+    char *name;
+    char *dom_name;
+    errno_t ret;
+
+    switch (bctx->key_type) {
+    case SSS_NSS_KEY_SID:
+        ret = well_known_sid_to_name(key->str, &wk_dom_name, &wk_name);
+        if (ret != EOK) {
+            return ret;
+        }
+
+        if (wk_dom_name != NULL) {
+            key->wk_name = sss_tc_fqname2(bctx, bctx->nctx->global_names,
+                                          wk_dom_name, wk_dom_name, wk_name);
+            if (key->wk_name == NULL) {
+                return ENOMEM;
+            }
+        } else {
+            key->wk_name = wk_name;
+        }
+        key->wk_sid = key->str;
+        return EOK;
+    case SSS_NSS_KEY_NAME:
+        ret = sss_parse_name(bctx, bctx->nctx->global_names, key->str,
+                             &dom_name, &name);
+        if (ret != EOK || dom_name == NULL || name == NULL) {
+            return ENOENT;
+        }
+
+        ret = name_to_well_known_sid(dom_name, name, &key->wk_sid);
+        talloc_free(dom_name);
+        talloc_free(name);
+        if (ret != EOK) {
+            return ret;
+        }
+        key->wk_name = key->str;
+        return EOK;
+    default:
+        return ENOENT;
+    }
+}
+
+static void nss_batch_lookup_done(struct tevent_req *subreq);
+
+static errno_t nss_batch_lookup_send(struct nss_batch_ctx *bctx, size_t idx,
+                                     bool group)
+{
+    struct cli_ctx *cctx = bctx->cmdctx->cctx;
+    struct nss_ctx *nctx = bctx->nctx;
+    struct nss_batch_key *key = &bctx->keys[idx];
+    struct nss_batch_lookup *lookup;
+    struct tevent_req *subreq;
+
+    lookup = talloc_zero(bctx, struct nss_batch_lookup);
+    if (lookup == NULL) {
+        return ENOMEM;
+    }
+    lookup->bctx = bctx;
+    lookup->idx = idx;
+    lookup->group = group;
+
+    switch (bctx->key_type) {
+    case SSS_NSS_KEY_NAME:
+        if (group) {
+            subreq = cache_req_group_by_name_send(lookup, cctx->ev, cctx->rctx,
+                                                  nctx->ncache,
+                                                  nctx->neg_timeout,
+                                                  nctx->cache_refresh_percent,
+                                                  NULL, key->str);
+        } else {
+            subreq = cache_req_user_by_name_send(lookup, cctx->ev, cctx->rctx,
+                                                 nctx->ncache,
+                                                 nctx->neg_timeout,
+                                                 nctx->cache_refresh_percent,
+                                                 NULL, key->str);
+        }
+        break;
+    case SSS_NSS_KEY_UID:
+        subreq = cache_req_user_by_id_send(lookup, cctx->ev, cctx->rctx,
+                                           nctx->ncache, nctx->neg_timeout,
+                                           nctx->cache_refresh_percent,
+                                           NULL, key->id);
+        break;
+    case SSS_NSS_KEY_GID:
+        subreq = cache_req_group_by_id_send(lookup, cctx->ev, cctx->rctx,
+                                            nctx->ncache, nctx->neg_timeout,
+                                            nctx->cache_refresh_percent,
+                                            NULL, key->id);
+        break;
+    case SSS_NSS_KEY_SID:
+        subreq = cache_req_object_by_sid_send(lookup, cctx->ev, cctx->rctx,
+                                              nctx->ncache, nctx->neg_timeout,
+                                              nctx->cache_refresh_percent,
+                                              NULL, key->str, NULL);
+        break;
+    default:
+        subreq = NULL;
+        break;
+    }
+
+    if (subreq == NULL) {
+        talloc_free(lookup);
+        return ENOMEM;
+    }
+
+    tevent_req_set_callback(subreq, nss_batch_lookup_done, lookup);
+    return EOK;
+}
+
+static errno_t nss_batch_send_reply(struct nss_batch_ctx *bctx);
+
+static void nss_batch_lookup_done(struct tevent_req *subreq)
+{
+    struct nss_batch_lookup *lookup;
+    struct nss_cmd_ctx *cmdctx;
+    struct nss_batch_ctx *bctx;
+    struct nss_batch_key *key;
+    struct ldb_result *res = NULL;
+    struct sss_domain_info *dom = NULL;
+    size_t idx;
+    errno_t ret;
+
+    lookup = tevent_req_callback_data(subreq, struct nss_batch_lookup);
+    bctx = lookup->bctx;
+    idx = lookup->idx;
+    key = &bctx->keys[idx];
+
+    ret = cache_req_recv(lookup, subreq, &res, &dom, NULL);
+    talloc_zfree(subreq);
+
+    if (ret == ENOENT && bctx->key_type == SSS_NSS_KEY_NAME
+            && !lookup->group) {
+        /* the name might belong to a group */
+        talloc_free(lookup);
+        ret = nss_batch_lookup_send(bctx, idx, true);
+        if (ret == EOK) {
+            return;
+        }
+        key->ret = ret;
+        goto done;
+    }
+
+    if (ret == EOK && res->count != 1) {
+        DEBUG(SSSDBG_OP_FAILURE, "Expected one result, got [%u].\n",
+              res->count);
+        ret = EINVAL;
+    }
+
+    key->ret = ret;
+    if (ret == EOK) {
+        key->dom = dom;
+        key->msg = talloc_steal(bctx, res->msgs[0]);
+    }
+    talloc_free(lookup);
+
+done:
+    bctx->num_pending--;
+    if (bctx->num_pending > 0) {
+        return;
+    }
+
+    /* sending the reply frees cmdctx and bctx with it */
+    cmdctx = bctx->cmdctx;
+    ret = nss_batch_send_reply(bctx);
+    if (ret != EOK) {
+        nss_cmd_done(cmdctx, ret);
+    }
+}
+
+static errno_t nss_batch_fill_result(struct sss_packet *packet, size_t *pctr,
+                                     errno_t error, enum sss_id_type id_type,
+                                     uint32_t id, const char *name,
+                                     const char *sid)
+{
+    struct sized_string name_str;
+    struct sized_string sid_str;
+    uint8_t *body;
+    size_t blen;
+    errno_t ret;
+
+    to_sized_string(&name_str, name);
+    to_sized_string(&sid_str, sid);
+
+    ret = sss_packet_grow(packet, 3 * sizeof(uint32_t)
+                                  + name_str.len + sid_str.len);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "sss_packet_grow failed.\n");
+        return ret;
+    }
+
+    sss_packet_get_body(packet, &body, &blen);
+    SAFEALIGN_SETMEM_UINT32(body + *pctr, error, pctr);
+    SAFEALIGN_COPY_UINT32(body + *pctr, &id_type, pctr);
+    SAFEALIGN_COPY_UINT32(body + *pctr, &id, pctr);
+    memcpy(body + *pctr, name_str.str, name_str.len);
+    *pctr += name_str.len;
+    memcpy(body + *pctr, sid_str.str, sid_str.len);
+    *pctr += sid_str.len;
+
+    return EOK;
+}
+
+static errno_t nss_batch_fill_key(TALLOC_CTX *mem_ctx,
+                                  struct nss_batch_ctx *bctx,
+                                  struct nss_batch_key *key,
+                                  struct sss_packet *packet,
+                                  size_t *pctr)
+{
+    enum sss_id_type id_type;
+    const char *name;
+    const char *sid;
+    uint64_t tmp_id;
+    uint32_t id;
+    errno_t ret;
+
+    if (key->wk_sid != NULL) {
+        return nss_batch_fill_result(packet, pctr, EOK, SSS_ID_TYPE_GID, 0,
+                                     key->wk_name, key->wk_sid);
+    }
+
+    if (key->ret != EOK) {
+        return nss_batch_fill_result(packet, pctr, key->ret,
+                                     SSS_ID_TYPE_NOT_SPECIFIED, 0, "", "");
+    }
+
+    ret = find_sss_id_type(key->msg, key->dom->mpg, &id_type);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "find_sss_id_type failed.\n");
+        return nss_batch_fill_result(packet, pctr, ret,
+                                     SSS_ID_TYPE_NOT_SPECIFIED, 0, "", "");
+    }
+
+    ret = get_object_name(mem_ctx, key->dom, true, key->msg, &name);
+    if (ret != EOK) {
+        return nss_batch_fill_result(packet, pctr, ret,
+                                     SSS_ID_TYPE_NOT_SPECIFIED, 0, "", "");
+    }
+
+    if (id_type == SSS_ID_TYPE_GID) {
+        tmp_id = ldb_msg_find_attr_as_uint64(key->msg, SYSDB_GIDNUM, 0);
+    } else {
+        tmp_id = ldb_msg_find_attr_as_uint64(key->msg, SYSDB_UIDNUM, 0);
+    }
+    id = (tmp_id >= UINT32_MAX) ? 0 : (uint32_t) tmp_id;
+
+    sid = ldb_msg_find_attr_as_string(key->msg, SYSDB_SID_STR, "");
+
+    nss_sid_mc_store(bctx->nctx, key->dom, id_type, key->msg);
+
+    return nss_batch_fill_result(packet, pctr, EOK, id_type, id, name, sid);
+}
+
+static errno_t nss_batch_send_reply(struct nss_batch_ctx *bctx)
+{
+    struct cli_ctx *cctx = bctx->cmdctx->cctx;
+    struct nss_batch_key *key;
+    TALLOC_CTX *tmp_ctx;
+    uint8_t *body;
+    size_t blen;
+    size_t pctr = 0;
+    uint32_t c;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sss_packet_new(cctx->creq, 2 * sizeof(uint32_t),
+                         sss_packet_get_cmd(cctx->creq->in),
+                         &cctx->creq->out);
+    if (ret != EOK) {
+        ret = EFAULT;
+        goto done;
+    }
+
+    sss_packet_get_body(cctx->creq->out, &body, &blen);
+    SAFEALIGN_COPY_UINT32(body, &bctx->num_keys, &pctr); /* num results */
+    SAFEALIGN_SETMEM_UINT32(body + pctr, 0, &pctr); /* reserved */
+
+    for (c = 0; c < bctx->num_keys; c++) {
+        key = &bctx->keys[c];
+        if (key->duplicate) {
+            key = &bctx->keys[key->orig];
+        }
+
+        ret = nss_batch_fill_key(tmp_ctx, bctx, key, cctx->creq->out, &pctr);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    sss_packet_set_error(cctx->creq->out, EOK);
+    sss_cmd_done(cctx, bctx->cmdctx);
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static errno_t nss_batch_lookup_keys(struct nss_batch_ctx *bctx)
+{
+    struct nss_batch_key *key;
+    uint32_t c;
+    errno_t ret;
+
+    for (c = 0; c < bctx->num_keys; c++) {
+        key = &bctx->keys[c];
+        if (key->duplicate) {
+            continue;
+        }
+
+        ret = nss_batch_check_well_known(bctx, key);
+        if (ret == EOK) {
+            continue;
+        } else if (ret == ENOMEM) {
+            return ret;
+        }
+
+        ret = nss_batch_lookup_send(bctx, c, false);
+        if (ret != EOK) {
+            return ret;
+        }
+        bctx->num_pending++;
+    }
+
+    if (bctx->num_pending == 0) {
+        return nss_batch_send_reply(bctx);
+    }
+
+    return EAGAIN;
+}
+
+static void nss_cmd_getbatch_domains_done(struct tevent_req *req);
+
+static int nss_cmd_getbatch(struct cli_ctx *cctx)
+{
+    struct nss_cmd_ctx *cmdctx;
+    struct nss_batch_ctx *bctx;
+    struct tevent_req *req;
+    uint8_t *body;
+    size_t blen;
+    errno_t ret;
+
+    cmdctx = talloc_zero(cctx, struct nss_cmd_ctx);
+    if (cmdctx == NULL) {
+        return ENOMEM;
+    }
+    cmdctx->cctx = cctx;
+    cmdctx->cmd = SSS_NSS_GETBATCH;
+
+    bctx = talloc_zero(cmdctx, struct nss_batch_ctx);
+    if (bctx == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+    bctx->cmdctx = cmdctx;
+    bctx->nctx = talloc_get_type(cctx->rctx->pvt_ctx, struct nss_ctx);
+
+    sss_packet_get_body(cctx->creq->in, &body, &blen);
+    ret = nss_batch_parse_keys(bctx, body, blen);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Invalid batch request.\n");
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Running command [%d][%s] with [%"PRIu32"] "
+          "keys of type [%d].\n", cmdctx->cmd, sss_cmd2str(cmdctx->cmd),
+          bctx->num_keys, bctx->key_type);
+
+    /* Subdomains must be known before IDs and SIDs are searched in all
+     * domains */
+    if (cctx->rctx->get_domains_last_call.tv_sec == 0) {
+        req = sss_dp_get_domains_send(cctx->rctx, cctx->rctx, true, NULL);
+        if (req == NULL) {
+            ret = ENOMEM;
+        } else {
+            tevent_req_set_callback(req, nss_cmd_getbatch_domains_done, bctx);
+            ret = EAGAIN;
+        }
+        goto done;
+    }
+
+    ret = nss_batch_lookup_keys(bctx);
+
+done:
+    return nss_cmd_done(cmdctx, ret);
+}
+
+static void nss_cmd_getbatch_domains_done(struct tevent_req *req)
+{
+    struct nss_cmd_ctx *cmdctx;
+    struct nss_batch_ctx *bctx;
+    errno_t ret;
+
+    bctx = tevent_req_callback_data(req, struct nss_batch_ctx);
+    /* bctx is freed with cmdctx once the reply was sent */
+    cmdctx = bctx->cmdctx;
+
+    ret = sss_dp_get_domains_recv(req);
+    talloc_free(req);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = nss_batch_lookup_keys(bctx);
+
+done:
+    if (ret != EOK) {
+        nss_cmd_done(cmdctx, ret);
+    }
+}
+
+/* The clients report the lookups answered from the memory cache, which
+ * never reach the responder otherwise */
+static int nss_cmd_mc_stats(struct cli_ctx *cctx)
+{
+    struct sss_mc_stats_report report;
+    struct nss_ctx *nctx;
+    uint8_t *body;
+    size_t blen;
+    int ret;
+
+    nctx = talloc_get_type(cctx->rctx->pvt_ctx, struct nss_ctx);
+
+    sss_packet_get_body(cctx->creq->in, &body, &blen);
+    if (blen != sizeof(report)) {
+        return EINVAL;
+    }
+    memcpy(&report, body, sizeof(report));
+
+    ret = sss_mmap_cache_stats_add(nctx->mc_stats, &report);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Invalid memory cache statistics from the client.\n");
+        return ret;
+    }
+
+    ret = sss_packet_new(cctx->creq, 0,
+                         sss_packet_get_cmd(cctx->creq->in),
+                         &cctx->creq->out);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    sss_cmd_done(cctx, NULL);
+    return EOK;
+}
+
 struct cli_protocol_version *register_cli_protocol_version(void)
 {
     static struct cli_protocol_version nss_cli_protocol_version[] = {
         {1, "2008-09-05", "initial version, \\0 terminated strings"},
+        {2, "2016-06-01", "multiplexed requests tagged in the reserved "
+                          "header field", true},
         {0, NULL, NULL}
     };
 
@@ -5537,28 +6366,30 @@ static struct sss_cmd_table nss_cmds[] = {
     {SSS_GET_VERSION, sss_cmd_get_version},
     {SSS_NSS_GETPWNAM, nss_cmd_getpwnam},
     {SSS_NSS_GETPWUID, nss_cmd_getpwuid},
-    {SSS_NSS_SETPWENT, nss_cmd_setpwent},
-    {SSS_NSS_GETPWENT, nss_cmd_getpwent},
-    {SSS_NSS_ENDPWENT, nss_cmd_endpwent},
+    {SSS_NSS_SETPWENT, nss_cmd_setpwent, true},
+    {SSS_NSS_GETPWENT, nss_cmd_getpwent, true},
+    {SSS_NSS_ENDPWENT, nss_cmd_endpwent, true},
     {SSS_NSS_GETGRNAM, nss_cmd_getgrnam},
     {SSS_NSS_GETGRGID, nss_cmd_getgrgid},
-    {SSS_NSS_SETGRENT, nss_cmd_setgrent},
-    {SSS_NSS_GETGRENT, nss_cmd_getgrent},
-    {SSS_NSS_ENDGRENT, nss_cmd_endgrent},
+    {SSS_NSS_SETGRENT, nss_cmd_setgrent, true},
+    {SSS_NSS_GETGRENT, nss_cmd_getgrent, true},
+    {SSS_NSS_ENDGRENT, nss_cmd_endgrent, true},
     {SSS_NSS_INITGR, nss_cmd_initgroups},
-    {SSS_NSS_SETNETGRENT, nss_cmd_setnetgrent},
-    {SSS_NSS_GETNETGRENT, nss_cmd_getnetgrent},
-    {SSS_NSS_ENDNETGRENT, nss_cmd_endnetgrent},
+    {SSS_NSS_SETNETGRENT, nss_cmd_setnetgrent, true},
+    {SSS_NSS_GETNETGRENT, nss_cmd_getnetgrent, true},
+    {SSS_NSS_ENDNETGRENT, nss_cmd_endnetgrent, true},
     {SSS_NSS_GETSERVBYNAME, nss_cmd_getservbyname},
     {SSS_NSS_GETSERVBYPORT, nss_cmd_getservbyport},
-    {SSS_NSS_SETSERVENT, nss_cmd_setservent},
-    {SSS_NSS_GETSERVENT, nss_cmd_getservent},
-    {SSS_NSS_ENDSERVENT, nss_cmd_endservent},
+    {SSS_NSS_SETSERVENT, nss_cmd_setservent, true},
+    {SSS_NSS_GETSERVENT, nss_cmd_getservent, true},
+    {SSS_NSS_ENDSERVENT, nss_cmd_endservent, true},
     {SSS_NSS_GETSIDBYNAME, nss_cmd_getsidbyname},
     {SSS_NSS_GETSIDBYID, nss_cmd_getsidbyid},
     {SSS_NSS_GETNAMEBYSID, nss_cmd_getnamebysid},
     {SSS_NSS_GETIDBYSID, nss_cmd_getidbysid},
     {SSS_NSS_GETORIGBYNAME, nss_cmd_getorigbyname},
+    {SSS_NSS_GETBATCH, nss_cmd_getbatch},
+    {SSS_NSS_MC_STATS, nss_cmd_mc_stats},
     {SSS_CLI_NULL, NULL}
 };
 
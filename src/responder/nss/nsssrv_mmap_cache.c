@@ -33,6 +33,27 @@
 #define SSS_AVG_GROUP_PAYLOAD (MC_SLOT_SIZE * 3)
 /* average place for 40 supplementary groups + 2 names */
 #define SSS_AVG_INITGROUP_PAYLOAD (MC_SLOT_SIZE * 5)
+/* a netgroup with a handful of triples */
+#define SSS_AVG_NETGROUP_PAYLOAD (MC_SLOT_SIZE * 6)
+/* name/proto key, name, protocol and a single alias */
+#define SSS_AVG_SERVICES_PAYLOAD (MC_SLOT_SIZE * 3)
+/* fully qualified name and a domain SID */
+#define SSS_AVG_SID_PAYLOAD (MC_SLOT_SIZE * 4)
+/* only the prefixed name or ID that was not found */
+#define SSS_AVG_NEGATIVE_PAYLOAD (MC_SLOT_SIZE * 2)
+
+/* Runs of free slots are kept in per-size free lists, runs of
+ * MC_FREE_CLASSES slots and more share the last list */
+#define MC_FREE_CLASSES 16
+#define MC_FREE_LIST_LEN 256
+#define MC_FREE_CLASS(num) \
+    (((num) >= MC_FREE_CLASSES ? MC_FREE_CLASSES : (num)) - 1)
+
+/* A cache grows at most to this multiple of its configured size */
+#define SSS_MC_MAX_GROWTH 8
+/* The cache doubles its size once this fraction of its entries had to be
+ * evicted before they expired */
+#define MC_GROWTH_TRIGGER(mcc) (((mcc)->ft_size * 8) / 4)
 
 #define MC_NEXT_BARRIER(val) ((((val) + 1) & 0x00ffffff) | 0xf0000000)
 
@@ -68,10 +89,22 @@ struct sss_mc_ctx {
 
     uint8_t *free_table;    /* free list bitmaps */
     uint32_t ft_size;       /* size of free table */
-    uint32_t next_slot;     /* the next slot after last allocation */
+    uint32_t next_slot;     /* the next slot after last allocation, also
+                             * the position of the CLOCK hand */
 
     uint8_t *data_table;    /* data table address (in mmap) */
     uint32_t dt_size;       /* size of data table */
+
+    /* The following is private to the responder and not part of the
+     * mmapped file */
+    uint8_t *ref_table;     /* referenced bit of each record, indexed by
+                             * the first slot of the record */
+    uint32_t *free_lists;   /* first slots of free runs, MC_FREE_LIST_LEN
+                             * entries for each size class */
+    uint32_t free_count[MC_FREE_CLASSES];
+
+    uint32_t max_elems;     /* the cache does not grow beyond this size */
+    uint32_t live_evictions; /* records evicted before they expired */
 };
 
 #define MC_FIND_BIT(base, num) \
@@ -277,6 +310,83 @@ static void sss_mc_rm_rec_from_chain(struct sss_mc_ctx *mcc,
     }
 }
 
+/* Returns the number of consecutive free slots starting at @slot, but
+ * does not look further than @max slots. */
+static uint32_t sss_mc_free_run_len(struct sss_mc_ctx *mcc,
+                                    uint32_t slot, uint32_t max)
+{
+    uint32_t tot_slots;
+    uint32_t len;
+    bool used;
+
+    tot_slots = mcc->ft_size * 8;
+
+    for (len = 0; len < max && slot + len < tot_slots; len++) {
+        MC_PROBE_BIT(mcc->free_table, slot + len, used);
+        if (used) {
+            break;
+        }
+    }
+
+    return len;
+}
+
+static void sss_mc_free_list_push(struct sss_mc_ctx *mcc,
+                                  uint32_t slot, uint32_t num)
+{
+    uint32_t class;
+
+    if (num == 0) {
+        return;
+    }
+
+    class = MC_FREE_CLASS(num);
+    if (mcc->free_count[class] == MC_FREE_LIST_LEN) {
+        /* The free table is authoritative, the run can still be found
+         * by scanning it. */
+        return;
+    }
+
+    mcc->free_lists[class * MC_FREE_LIST_LEN + mcc->free_count[class]] = slot;
+    mcc->free_count[class]++;
+}
+
+/* Takes @num_slots consecutive free slots from the smallest size class
+ * that can satisfy the request. The lists are only hints, every run is
+ * checked against the free table before it is used. */
+static bool sss_mc_free_list_pop(struct sss_mc_ctx *mcc,
+                                 uint32_t num_slots, uint32_t *_slot)
+{
+    uint32_t class;
+    uint32_t slot;
+    uint32_t len;
+
+    for (class = MC_FREE_CLASS(num_slots); class < MC_FREE_CLASSES; class++) {
+        while (mcc->free_count[class] > 0) {
+            mcc->free_count[class]--;
+            slot = mcc->free_lists[class * MC_FREE_LIST_LEN
+                                   + mcc->free_count[class]];
+
+            len = sss_mc_free_run_len(mcc, slot,
+                                      num_slots + MC_FREE_CLASSES);
+            if (len >= num_slots) {
+                /* return the rest of the run to the lists */
+                sss_mc_free_list_push(mcc, slot + num_slots,
+                                      len - num_slots);
+                *_slot = slot;
+                return true;
+            }
+
+            /* the run has been partially reused in the meantime */
+            if (len > 0 && MC_FREE_CLASS(len) < class) {
+                sss_mc_free_list_push(mcc, slot, len);
+            }
+        }
+    }
+
+    return false;
+}
+
 static void sss_mc_free_slots(struct sss_mc_ctx *mcc, struct sss_mc_rec *rec)
 {
     uint32_t slot;
@@ -288,6 +398,11 @@ static void sss_mc_free_slots(struct sss_mc_ctx *mcc, struct sss_mc_rec *rec)
     for (i = 0; i < num; i++) {
         MC_CLEAR_BIT(mcc->free_table, slot + i);
     }
+    MC_CLEAR_BIT(mcc->ref_table, slot);
+
+    /* merge with the free slots that follow the record */
+    num += sss_mc_free_run_len(mcc, slot + num, MC_FREE_CLASSES);
+    sss_mc_free_list_push(mcc, slot, num);
 }
 
 static void sss_mc_invalidate_rec(struct sss_mc_ctx *mcc,
@@ -374,24 +489,32 @@ static bool sss_mc_is_valid_rec(struct sss_mc_ctx *mcc, struct sss_mc_rec *rec)
     return true;
 }
 
-/* FIXME: This is a very simplistic, inefficient, memory allocator,
- * it will just free the oldest entries regardless of expiration if it
- * cycled the whole freebits map and found no empty slot */
+/* Free runs are taken from the per-size free lists first, then the free
+ * table is scanned. If the cache is full, the CLOCK algorithm picks the
+ * records to evict: the hand (next_slot) moves over the data table and
+ * gives every record that was referenced since the hand passed it last
+ * time a second chance. */
 static errno_t sss_mc_find_free_slots(struct sss_mc_ctx *mcc,
                                       int num_slots, uint32_t *free_slot)
 {
     struct sss_mc_rec *rec;
+    struct sss_mc_rec *hot;
+    uint32_t hot_slot = 0;
     uint32_t tot_slots;
     uint32_t cur;
     uint32_t i;
     uint32_t t;
+    time_t now;
     bool used;
+    bool referenced;
 
     tot_slots = mcc->ft_size * 8;
 
+    if (sss_mc_free_list_pop(mcc, num_slots, free_slot)) {
+        return EOK;
+    }
+
     /* Try to find a free slot w/o removing anything first */
-    /* FIXME: is it really worth it ? May be it is easier to
-     * just recycle the next set of slots ? */
     if ((mcc->next_slot + num_slots) > tot_slots) {
         cur = 0;
     } else {
@@ -435,15 +558,25 @@ static errno_t sss_mc_find_free_slots(struct sss_mc_ctx *mcc,
         }
     }
 
-    /* no free slots found, free occupied slots after next_slot */
+    /* no free slots found, move the CLOCK hand until it points to
+     * num_slots slots that hold no recently referenced record. Every
+     * record that is skipped loses its referenced bit, so the loop ends
+     * at the latest after one full turn. */
+    now = time(NULL);
     if ((mcc->next_slot + num_slots) > tot_slots) {
         cur = 0;
     } else {
         cur = mcc->next_slot;
     }
-    for (i = 0; i < num_slots; i++) {
-        MC_PROBE_BIT(mcc->free_table, cur + i, used);
-        if (used) {
+
+    do {
+        hot = NULL;
+        for (i = 0; i < num_slots; i++) {
+            MC_PROBE_BIT(mcc->free_table, cur + i, used);
+            if (!used) {
+                continue;
+            }
+
             /* the first used slot should be a record header, however we
              * carefully check it is a valid header and hardfail if not */
             rec = MC_SLOT_TO_PTR(mcc->data_table, cur + i, struct sss_mc_rec);
@@ -452,9 +585,42 @@ static errno_t sss_mc_find_free_slots(struct sss_mc_ctx *mcc,
                  * invalidate the whole cache */
                 return EFAULT;
             }
+
+            MC_PROBE_BIT(mcc->ref_table, cur + i, referenced);
+            if (referenced && rec->expire > now) {
+                hot = rec;
+                hot_slot = cur + i;
+                break;
+            }
+
+            i += MC_SIZE_TO_SLOTS(rec->len) - 1;
+        }
+
+        if (hot != NULL) {
+            /* second chance, continue right after the record */
+            MC_CLEAR_BIT(mcc->ref_table, hot_slot);
+            cur = hot_slot + MC_SIZE_TO_SLOTS(hot->len);
+            if ((cur + num_slots) > tot_slots) {
+                cur = 0;
+            }
+        }
+    } while (hot != NULL);
+
+    /* free occupied slots under the hand */
+    for (i = 0; i < num_slots; i++) {
+        MC_PROBE_BIT(mcc->free_table, cur + i, used);
+        if (used) {
+            rec = MC_SLOT_TO_PTR(mcc->data_table, cur + i, struct sss_mc_rec);
+            if (!sss_mc_is_valid_rec(mcc, rec)) {
+                return EFAULT;
+            }
             /* next loop skip the whole record */
             i += MC_SIZE_TO_SLOTS(rec->len) - 1;
 
+            if (rec->expire > now) {
+                mcc->live_evictions++;
+            }
+
             /* finally invalidate record completely */
             sss_mc_invalidate_rec(mcc, rec);
         }
@@ -478,6 +644,15 @@ static errno_t sss_mc_get_strs_offset(struct sss_mc_ctx *mcc,
     case SSS_MC_INITGROUPS:
         *_offset = offsetof(struct sss_mc_initgr_data, gids);
         return EOK;
+    case SSS_MC_NETGROUP:
+        *_offset = offsetof(struct sss_mc_netgr_data, strs);
+        return EOK;
+    case SSS_MC_SERVICES:
+        *_offset = offsetof(struct sss_mc_svc_data, strs);
+        return EOK;
+    case SSS_MC_SID:
+        *_offset = offsetof(struct sss_mc_sid_data, strs);
+        return EOK;
     default:
         DEBUG(SSSDBG_FATAL_FAILURE, "Unknown memory cache type.\n");
         return EINVAL;
@@ -498,6 +673,15 @@ static errno_t sss_mc_get_strs_len(struct sss_mc_ctx *mcc,
     case SSS_MC_INITGROUPS:
         *_len = ((struct sss_mc_initgr_data *)&rec->data)->data_len;
         return EOK;
+    case SSS_MC_NETGROUP:
+        *_len = ((struct sss_mc_netgr_data *)&rec->data)->strs_len;
+        return EOK;
+    case SSS_MC_SERVICES:
+        *_len = ((struct sss_mc_svc_data *)&rec->data)->strs_len;
+        return EOK;
+    case SSS_MC_SID:
+        *_len = ((struct sss_mc_sid_data *)&rec->data)->strs_len;
+        return EOK;
     default:
         DEBUG(SSSDBG_FATAL_FAILURE, "Unknown memory cache type.\n");
         return EINVAL;
@@ -573,6 +757,38 @@ static struct sss_mc_rec *sss_mc_find_record(struct sss_mc_ctx *mcc,
     return rec;
 }
 
+/* Replaces the cache with an empty one of twice the size. Clients are told
+ * to reopen the cache through the recycled flag of the old file. */
+static errno_t sss_mc_grow(struct sss_mc_ctx **_mcc)
+{
+    struct sss_mc_ctx *mcc = *_mcc;
+    uint32_t max_elems;
+    size_t n_elem;
+    errno_t ret;
+
+    max_elems = mcc->max_elems;
+    n_elem = (size_t)mcc->ft_size * 8 * 2;
+    if (n_elem > max_elems) {
+        n_elem = max_elems;
+    }
+
+    DEBUG(SSSDBG_CONF_SETTINGS,
+          "%u unexpired records were evicted from the %s mmap cache, "
+          "growing it from %u to %zu entries\n", mcc->live_evictions,
+          mcc->name, mcc->ft_size * 8, n_elem);
+
+    ret = sss_mmap_cache_reinit(talloc_parent(mcc), n_elem, -1, _mcc);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    (*_mcc)->max_elems = max_elems;
+
+    return EOK;
+}
+
+/* Note that the cache may be replaced by a bigger one, so callers must
+ * reload the context from @_mcc afterwards. */
 static errno_t sss_mc_get_record(struct sss_mc_ctx **_mcc,
                                  size_t rec_len,
                                  struct sized_string *key,
@@ -587,13 +803,25 @@ static errno_t sss_mc_get_record(struct sss_mc_ctx **_mcc,
     errno_t ret;
     int i;
 
+    if (mcc->live_evictions > MC_GROWTH_TRIGGER(mcc)
+            && mcc->ft_size * 8 < mcc->max_elems) {
+        ret = sss_mc_grow(_mcc);
+        if (ret != EOK) {
+            return ret;
+        }
+        mcc = *_mcc;
+    }
+
     num_slots = MC_SIZE_TO_SLOTS(rec_len);
 
     old_rec = sss_mc_find_record(mcc, key);
     if (old_rec) {
         old_slots = MC_SIZE_TO_SLOTS(old_rec->len);
 
+        /* the record was asked for again, keep it around */
         if (old_slots == num_slots) {
+            MC_SET_BIT(mcc->ref_table,
+                       MC_PTR_TO_SLOT(mcc->data_table, old_rec));
             *_rec = old_rec;
             return EOK;
         }
@@ -629,6 +857,10 @@ static errno_t sss_mc_get_record(struct sss_mc_ctx **_mcc,
         MC_SET_BIT(mcc->free_table, base_slot + i);
     }
 
+    if (old_rec != NULL) {
+        MC_SET_BIT(mcc->ref_table, base_slot);
+    }
+
     *_rec = rec;
     return EOK;
 }
@@ -724,6 +956,7 @@ errno_t sss_mmap_cache_pw_store(struct sss_mc_ctx **_mcc,
     if (ret != EOK) {
         return ret;
     }
+    mcc = *_mcc;
 
     data = (struct sss_mc_pwd_data *)rec->data;
     pos = 0;
@@ -867,6 +1100,7 @@ int sss_mmap_cache_gr_store(struct sss_mc_ctx **_mcc,
     if (ret != EOK) {
         return ret;
     }
+    mcc = *_mcc;
 
     data = (struct sss_mc_grp_data *)rec->data;
     pos = 0;
@@ -995,6 +1229,7 @@ errno_t sss_mmap_cache_initgr_store(struct sss_mc_ctx **_mcc,
     if (ret != EOK) {
         return ret;
     }
+    mcc = *_mcc;
 
     data = (struct sss_mc_initgr_data *)rec->data;
     pos = 0;
@@ -1036,6 +1271,669 @@ errno_t sss_mmap_cache_initgr_invalidate(struct sss_mc_ctx *mcc,
     return sss_mmap_cache_invalidate(mcc, name);
 }
 
+/***************************************************************************
+ * netgroup map
+ ***************************************************************************/
+
+errno_t sss_mmap_cache_netgr_store(struct sss_mc_ctx **_mcc,
+                                   struct sized_string *name,
+                                   uint32_t num_entries,
+                                   uint8_t *entries_buf, size_t entries_len)
+{
+    struct sss_mc_ctx *mcc = *_mcc;
+    struct sss_mc_rec *rec;
+    struct sss_mc_netgr_data *data;
+    size_t data_len;
+    size_t rec_len;
+    size_t pos;
+    int ret;
+
+    if (mcc == NULL) {
+        /* cache not initialized ? */
+        return EINVAL;
+    }
+
+    data_len = name->len + entries_len;
+    rec_len = sizeof(struct sss_mc_rec) +
+              sizeof(struct sss_mc_netgr_data) +
+              data_len;
+    if (rec_len > mcc->dt_size) {
+        return ENOMEM;
+    }
+
+    ret = sss_mc_get_record(_mcc, rec_len, name, &rec);
+    if (ret != EOK) {
+        return ret;
+    }
+    mcc = *_mcc;
+
+    data = (struct sss_mc_netgr_data *)rec->data;
+    pos = 0;
+
+    MC_RAISE_BARRIER(rec);
+
+    /* Netgroups can only be searched by name, use it for both keys */
+    sss_mmap_set_rec_header(mcc, rec, rec_len, mcc->valid_time_slot,
+                            name->str, name->len, name->str, name->len);
+
+    /* netgroup struct */
+    data->name = MC_PTR_DIFF(data->strs, data);
+    data->num_entries = num_entries;
+    data->entries_len = entries_len;
+    data->strs_len = data_len;
+    memcpy(&data->strs[pos], name->str, name->len);
+    pos += name->len;
+    memcpy(&data->strs[pos], entries_buf, entries_len);
+    pos += entries_len;
+
+    MC_LOWER_BARRIER(rec);
+
+    /* finally chain the rec in the hash table */
+    sss_mmap_chain_in_rec(mcc, rec);
+
+    return EOK;
+}
+
+errno_t sss_mmap_cache_netgr_invalidate(struct sss_mc_ctx *mcc,
+                                        struct sized_string *name)
+{
+    return sss_mmap_cache_invalidate(mcc, name);
+}
+
+/***************************************************************************
+ * services map
+ ***************************************************************************/
+
+errno_t sss_mmap_cache_svc_store(struct sss_mc_ctx **_mcc,
+                                 struct sized_string *name,
+                                 struct sized_string *protocol,
+                                 uint16_t port, uint32_t num_aliases,
+                                 char *aliasbuf, size_t aliassize)
+{
+    struct sss_mc_ctx *mcc = *_mcc;
+    struct sss_mc_rec *rec;
+    struct sss_mc_svc_data *data;
+    struct sized_string namekey;
+    struct sized_string portkey;
+    TALLOC_CTX *tmp_ctx;
+    char *namestr;
+    char *portstr;
+    size_t data_len;
+    size_t rec_len;
+    size_t pos;
+    int ret;
+
+    if (mcc == NULL) {
+        /* cache not initialized ? */
+        return EINVAL;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    /* The same service name can be bound to different ports for different
+     * protocols, so both keys are qualified with the protocol */
+    namestr = talloc_asprintf(tmp_ctx, "%s/%s", name->str, protocol->str);
+    portstr = talloc_asprintf(tmp_ctx, "%u/%s",
+                              (unsigned int)port, protocol->str);
+    if (namestr == NULL || portstr == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+    to_sized_string(&namekey, namestr);
+    to_sized_string(&portkey, portstr);
+
+    data_len = namekey.len + name->len + protocol->len + aliassize;
+    rec_len = sizeof(struct sss_mc_rec) +
+              sizeof(struct sss_mc_svc_data) +
+              data_len;
+    if (rec_len > mcc->dt_size) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sss_mc_get_record(_mcc, rec_len, &namekey, &rec);
+    if (ret != EOK) {
+        goto done;
+    }
+    mcc = *_mcc;
+
+    data = (struct sss_mc_svc_data *)rec->data;
+    pos = 0;
+
+    MC_RAISE_BARRIER(rec);
+
+    /* header */
+    sss_mmap_set_rec_header(mcc, rec, rec_len, mcc->valid_time_slot,
+                            namekey.str, namekey.len,
+                            portkey.str, portkey.len);
+
+    /* services struct */
+    data->name = MC_PTR_DIFF(data->strs, data);
+    data->port = (uint32_t)htons(port);
+    data->num_aliases = num_aliases;
+    data->strs_len = data_len;
+    memcpy(&data->strs[pos], namekey.str, namekey.len);
+    pos += namekey.len;
+    memcpy(&data->strs[pos], name->str, name->len);
+    pos += name->len;
+    memcpy(&data->strs[pos], protocol->str, protocol->len);
+    pos += protocol->len;
+    memcpy(&data->strs[pos], aliasbuf, aliassize);
+    pos += aliassize;
+
+    MC_LOWER_BARRIER(rec);
+
+    /* finally chain the rec in the hash table */
+    sss_mmap_chain_in_rec(mcc, rec);
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+/***************************************************************************
+ * SID map
+ ***************************************************************************/
+
+errno_t sss_mmap_cache_sid_store(struct sss_mc_ctx **_mcc,
+                                 struct sized_string *name,
+                                 struct sized_string *sid,
+                                 uint32_t id, uint32_t type)
+{
+    struct sss_mc_ctx *mcc = *_mcc;
+    struct sss_mc_rec *rec;
+    struct sss_mc_sid_data *data;
+    size_t data_len;
+    size_t rec_len;
+    size_t pos;
+    int ret;
+
+    if (mcc == NULL) {
+        /* cache not initialized ? */
+        return EINVAL;
+    }
+
+    data_len = name->len + sid->len;
+    rec_len = sizeof(struct sss_mc_rec) +
+              sizeof(struct sss_mc_sid_data) +
+              data_len;
+    if (rec_len > mcc->dt_size) {
+        return ENOMEM;
+    }
+
+    ret = sss_mc_get_record(_mcc, rec_len, name, &rec);
+    if (ret != EOK) {
+        return ret;
+    }
+    mcc = *_mcc;
+
+    data = (struct sss_mc_sid_data *)rec->data;
+    pos = 0;
+
+    MC_RAISE_BARRIER(rec);
+
+    /* header */
+    sss_mmap_set_rec_header(mcc, rec, rec_len, mcc->valid_time_slot,
+                            name->str, name->len, sid->str, sid->len);
+
+    /* sid struct */
+    data->name = MC_PTR_DIFF(data->strs, data);
+    data->id = id;
+    data->type = type;
+    data->strs_len = data_len;
+    memcpy(&data->strs[pos], name->str, name->len);
+    pos += name->len;
+    data->sid = MC_PTR_DIFF(&data->strs[pos], data);
+    memcpy(&data->strs[pos], sid->str, sid->len);
+    pos += sid->len;
+
+    MC_LOWER_BARRIER(rec);
+
+    /* finally chain the rec in the hash table */
+    sss_mmap_chain_in_rec(mcc, rec);
+
+    return EOK;
+}
+
+errno_t sss_mmap_cache_sid_invalidate(struct sss_mc_ctx *mcc,
+                                      struct sized_string *name)
+{
+    return sss_mmap_cache_invalidate(mcc, name);
+}
+
+errno_t sss_mmap_cache_sid_invalidate_sid(struct sss_mc_ctx *mcc,
+                                          const char *sid)
+{
+    struct sss_mc_rec *rec;
+    struct sss_mc_sid_data *data;
+    uint32_t hash;
+    uint32_t slot;
+
+    if (mcc == NULL) {
+        /* cache not initialized ? */
+        return EINVAL;
+    }
+
+    hash = sss_mc_hash(mcc, sid, strlen(sid) + 1);
+
+    slot = mcc->hash_table[hash];
+    if (!MC_SLOT_WITHIN_BOUNDS(slot, mcc->dt_size)) {
+        return ENOENT;
+    }
+
+    while (slot != MC_INVALID_VAL) {
+        if (!MC_SLOT_WITHIN_BOUNDS(slot, mcc->dt_size)) {
+            DEBUG(SSSDBG_FATAL_FAILURE, "Corrupted fastcache.\n");
+            sss_mc_save_corrupted(mcc);
+            sss_mmap_cache_reset(mcc);
+            return ENOENT;
+        }
+
+        rec = MC_SLOT_TO_PTR(mcc->data_table, slot, struct sss_mc_rec);
+        data = (struct sss_mc_sid_data *)(&rec->data);
+
+        if (hash == rec->hash2
+                && data->sid < offsetof(struct sss_mc_sid_data, strs)
+                                    + data->strs_len
+                && strcmp(sid, (char *)data + data->sid) == 0) {
+            break;
+        }
+
+        slot = sss_mc_next_slot_with_hash(rec, hash);
+    }
+
+    if (slot == MC_INVALID_VAL) {
+        return ENOENT;
+    }
+
+    sss_mc_invalidate_rec(mcc, rec);
+
+    return EOK;
+}
+
+/***************************************************************************
+ * negative records
+ ***************************************************************************/
+
+errno_t sss_mmap_cache_neg_store(struct sss_mc_ctx **_mcc,
+                                 struct sized_string *key)
+{
+    struct sss_mc_ctx *mcc = *_mcc;
+    struct sss_mc_rec *rec;
+    struct sss_mc_neg_data *data;
+    size_t rec_len;
+    int ret;
+
+    if (mcc == NULL) {
+        /* cache not initialized ? */
+        return EINVAL;
+    }
+
+    rec_len = sizeof(struct sss_mc_rec) +
+              sizeof(struct sss_mc_neg_data) +
+              key->len;
+    if (rec_len > mcc->dt_size) {
+        return ENOMEM;
+    }
+
+    ret = sss_mc_get_record(_mcc, rec_len, key, &rec);
+    if (ret != EOK) {
+        return ret;
+    }
+    mcc = *_mcc;
+
+    data = (struct sss_mc_neg_data *)rec->data;
+
+    MC_RAISE_BARRIER(rec);
+
+    /* header, there is only one key so both hashes are the same */
+    sss_mmap_set_rec_header(mcc, rec, rec_len, mcc->valid_time_slot,
+                            key->str, key->len, key->str, key->len);
+
+    /* negative struct */
+    data->name = MC_PTR_DIFF(data->strs, data);
+    data->strs_len = key->len;
+    memcpy(data->strs, key->str, key->len);
+
+    MC_LOWER_BARRIER(rec);
+
+    /* finally chain the rec in the hash table */
+    sss_mmap_chain_in_rec(mcc, rec);
+
+    return EOK;
+}
+
+/***************************************************************************
+ * client statistics
+ ***************************************************************************/
+
+#define SSS_MC_STATS_PATH SSS_NSS_MCACHE_DIR"/"SSS_MC_STATS_FILE
+
+errno_t sss_mmap_cache_stats_init(bool enabled, struct sss_mc_stats **_stats)
+{
+    struct sss_mc_stats stats;
+    struct sss_mc_stats *page = NULL;
+    const char *tmp_file = SSS_MC_STATS_PATH".tmp";
+    ssize_t written;
+    int fd;
+    int ret;
+
+    *_stats = NULL;
+
+    /* counters never survive a restart of the responder */
+    ret = unlink(SSS_MC_STATS_PATH);
+    if (ret == -1 && errno != ENOENT) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to remove %s: %d(%s)\n",
+              SSS_MC_STATS_PATH, ret, strerror(ret));
+        return ret;
+    }
+
+    if (!enabled) {
+        return EOK;
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    stats.magic = SSS_MC_STATS_MAGIC;
+    stats.vno = SSS_MC_STATS_VNO;
+    stats.num_caches = SSS_MC_STATS_NUM;
+    stats.created = time(NULL);
+
+    (void)unlink(tmp_file);
+
+    fd = open(tmp_file, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to create %s: %d(%s)\n",
+              tmp_file, ret, strerror(ret));
+        return ret;
+    }
+
+    /* everyone may read the counters, only the responder updates them */
+    ret = fchmod(fd, 0644);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to chmod %s: %d(%s)\n",
+              tmp_file, ret, strerror(ret));
+        goto done;
+    }
+
+    errno = 0;
+    written = sss_atomic_write_s(fd, (uint8_t *)&stats, sizeof(stats));
+    if (written != sizeof(stats)) {
+        ret = (written == -1) ? errno : EIO;
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to write %s: %d(%s)\n",
+              tmp_file, ret, strerror(ret));
+        goto done;
+    }
+
+    page = mmap(NULL, sizeof(struct sss_mc_stats),
+                PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (page == MAP_FAILED) {
+        ret = errno;
+        page = NULL;
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to mmap %s: %d(%s)\n",
+              tmp_file, ret, strerror(ret));
+        goto done;
+    }
+
+    /* readers only ever see a complete file */
+    ret = rename(tmp_file, SSS_MC_STATS_PATH);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to rename %s: %d(%s)\n",
+              tmp_file, ret, strerror(ret));
+        goto done;
+    }
+
+    *_stats = page;
+    ret = EOK;
+
+done:
+    close(fd);
+    if (ret != EOK) {
+        if (page != NULL) {
+            munmap(page, sizeof(struct sss_mc_stats));
+        }
+        (void)unlink(tmp_file);
+    }
+    return ret;
+}
+
+errno_t sss_mmap_cache_stats_add(struct sss_mc_stats *stats,
+                                 const struct sss_mc_stats_report *report)
+{
+    const uint64_t *counts;
+    uint64_t *counters;
+    size_t i;
+
+    if (report->vno != SSS_MC_STATS_VNO
+            || report->num_caches != SSS_MC_STATS_NUM) {
+        return EINVAL;
+    }
+
+    if (stats == NULL) {
+        /* statistics were disabled since the client checked */
+        return EOK;
+    }
+
+    counts = (const uint64_t *)report->caches;
+    counters = (uint64_t *)stats->caches;
+    for (i = 0; i < SSS_MC_STATS_COUNTERS; i++) {
+        counters[i] += counts[i];
+    }
+
+    return EOK;
+}
+
+/***************************************************************************
+ * warm restart
+ ***************************************************************************/
+
+/* the cache file left behind by the previous instance of the responder */
+struct sss_mc_old_file {
+    void *base;
+    size_t size;
+    struct sss_mc_header h;
+};
+
+/* Maps the old cache file if it is still alive and has the layout of a cache
+ * of @n_elem entries or of one that grew up to @max_elems entries. The size
+ * of the old cache is returned in @_n_elem. */
+static errno_t sss_mc_open_old_file(const char *file, int payload,
+                                    size_t n_elem, size_t max_elems,
+                                    struct sss_mc_old_file *old,
+                                    size_t *_n_elem)
+{
+    struct sss_mc_header *h = &old->h;
+    struct stat fdstat;
+    size_t old_elems;
+    size_t old_size;
+    int fd;
+    int ret;
+
+    fd = open(file, O_RDONLY);
+    if (fd == -1) {
+        return errno;
+    }
+
+    ret = fstat(fd, &fdstat);
+    if (ret == -1) {
+        ret = errno;
+        goto done;
+    }
+
+    if (fdstat.st_size < MC_HEADER_SIZE) {
+        ret = EINVAL;
+        goto done;
+    }
+
+    old->size = fdstat.st_size;
+    old->base = mmap(NULL, old->size, PROT_READ, MAP_SHARED, fd, 0);
+    if (old->base == MAP_FAILED) {
+        ret = errno;
+        old->base = NULL;
+        goto done;
+    }
+
+    memcpy(h, old->base, sizeof(struct sss_mc_header));
+
+    old_elems = h->ft_size * 8;
+    old_size = MC_HEADER_SIZE + MC_ALIGN64(h->dt_size)
+               + MC_ALIGN64(h->ft_size) + MC_ALIGN64(h->ht_size);
+
+    /* the hashes stored in the records are only valid for a hash table of
+     * the same size */
+    if (!MC_VALID_BARRIER(h->b1) || h->b1 != h->b2
+            || h->major_vno != SSS_MC_MAJOR_VNO
+            || h->minor_vno != SSS_MC_MINOR_VNO
+            || h->status != SSS_MC_HEADER_ALIVE
+            || old_elems < n_elem || old_elems > max_elems
+            || h->dt_size != MC_DT_SIZE(old_elems, payload)
+            || h->ht_size != MC_HT_SIZE(old_elems * 2)
+            || h->data_table != MC_HEADER_SIZE
+            || h->free_table != h->data_table + MC_ALIGN64(h->dt_size)
+            || h->hash_table != h->free_table + MC_ALIGN64(h->ft_size)
+            || old_size != old->size) {
+        ret = EINVAL;
+        goto done;
+    }
+
+    *_n_elem = old_elems;
+    ret = EOK;
+
+done:
+    if (ret != EOK && old->base != NULL) {
+        munmap(old->base, old->size);
+        old->base = NULL;
+    }
+    close(fd);
+    return ret;
+}
+
+/* Checks a record reached through a hash chain of the old cache the way
+ * sss_mc_is_valid_rec() checks the records of a live cache */
+static bool sss_mc_is_valid_old_rec(struct sss_mc_rec *old_rec,
+                                    uint32_t slot, uint32_t tot_slots,
+                                    uint32_t ht_elems)
+{
+    if (!MC_VALID_BARRIER(old_rec->b1) || old_rec->b1 != old_rec->b2) {
+        return false;
+    }
+
+    if (old_rec->len < sizeof(struct sss_mc_rec)
+            || old_rec->len > (tot_slots - slot) * MC_SLOT_SIZE) {
+        return false;
+    }
+
+    if (old_rec->hash1 >= ht_elems || old_rec->hash2 >= ht_elems) {
+        return false;
+    }
+
+    return true;
+}
+
+/* Copies the records of the old cache that did not expire yet to the same
+ * slots of the new one, which uses the seed of the old cache so that the
+ * stored hashes stay valid. Only the records reachable from the old hash
+ * table are taken, each one when its first hash chain is walked, so record
+ * payloads are never read as record headers. The hash chains and the free
+ * table are rebuilt, nothing but the records themselves is taken from the
+ * old file. */
+static uint32_t sss_mc_load_old_file(struct sss_mc_ctx *mcc,
+                                     struct sss_mc_old_file *old)
+{
+    struct sss_mc_rec *old_rec;
+    struct sss_mc_rec *rec;
+    uint8_t *old_data_table;
+    uint32_t *old_hash_table;
+    uint32_t ht_elems;
+    uint32_t tot_slots;
+    uint32_t num_slots;
+    uint32_t loaded = 0;
+    uint64_t steps = 0;
+    uint32_t hash;
+    uint32_t slot;
+    uint32_t next;
+    uint32_t i;
+    bool used;
+    time_t now;
+
+    old_data_table = MC_PTR_ADD(old->base, old->h.data_table);
+    old_hash_table = MC_PTR_ADD(old->base, old->h.hash_table);
+    ht_elems = MC_HT_ELEMS(mcc->ht_size);
+    tot_slots = mcc->dt_size / MC_SLOT_SIZE;
+    now = time(NULL);
+
+    mcc->seed = old->h.seed;
+
+    for (hash = 0; hash < ht_elems; hash++) {
+        slot = old_hash_table[hash];
+        while (slot != MC_INVALID_VAL32) {
+            /* every record is on at most two chains, more steps mean the
+             * chains of the old file loop */
+            if (slot >= tot_slots || ++steps > 2 * (uint64_t)tot_slots) {
+                DEBUG(SSSDBG_MINOR_FAILURE,
+                      "Corrupted hash chains in the old memory cache\n");
+                return loaded;
+            }
+
+            old_rec = MC_SLOT_TO_PTR(old_data_table, slot, struct sss_mc_rec);
+            if (!sss_mc_is_valid_old_rec(old_rec, slot, tot_slots, ht_elems)
+                    || (old_rec->hash1 != hash && old_rec->hash2 != hash)) {
+                /* in the middle of an update, the rest of the chain cannot
+                 * be trusted */
+                break;
+            }
+
+            next = sss_mc_next_slot_with_hash(old_rec, hash);
+
+            if (old_rec->hash1 != hash
+                    || old_rec->expire == MC_INVALID_VAL64
+                    || old_rec->expire < now) {
+                /* loaded from its first chain or expired */
+                slot = next;
+                continue;
+            }
+
+            num_slots = MC_SIZE_TO_SLOTS(old_rec->len);
+
+            /* records of a consistent cache never overlap */
+            for (i = 0; i < num_slots; i++) {
+                MC_PROBE_BIT(mcc->free_table, slot + i, used);
+                if (used) {
+                    break;
+                }
+            }
+            if (i < num_slots) {
+                slot = next;
+                continue;
+            }
+
+            /* the new file is not alive yet, no barriers needed */
+            rec = MC_SLOT_TO_PTR(mcc->data_table, slot, struct sss_mc_rec);
+            memcpy(rec, old_rec, old_rec->len);
+            rec->next1 = MC_INVALID_VAL;
+            rec->next2 = MC_INVALID_VAL;
+            sss_mmap_chain_in_rec(mcc, rec);
+
+            for (i = 0; i < num_slots; i++) {
+                MC_SET_BIT(mcc->free_table, slot + i);
+            }
+
+            loaded++;
+            slot = next;
+        }
+    }
+
+    return loaded;
+}
+
 /***************************************************************************
  * initialization
  ***************************************************************************/
@@ -1211,9 +2109,13 @@ static int mc_ctx_destructor(struct sss_mc_ctx *mc_ctx)
 
 errno_t sss_mmap_cache_init(TALLOC_CTX *mem_ctx, const char *name,
                             enum sss_mc_type type, size_t n_elem,
-                            time_t timeout, struct sss_mc_ctx **mcc)
+                            time_t timeout, bool warm,
+                            struct sss_mc_ctx **mcc)
 {
     struct sss_mc_ctx *mc_ctx = NULL;
+    struct sss_mc_old_file old = { 0 };
+    size_t max_elems;
+    uint32_t loaded;
     unsigned int rseed;
     int payload;
     int ret, dret;
@@ -1228,6 +2130,18 @@ errno_t sss_mmap_cache_init(TALLOC_CTX *mem_ctx, const char *name,
     case SSS_MC_INITGROUPS:
         payload = SSS_AVG_INITGROUP_PAYLOAD;
         break;
+    case SSS_MC_NETGROUP:
+        payload = SSS_AVG_NETGROUP_PAYLOAD;
+        break;
+    case SSS_MC_SERVICES:
+        payload = SSS_AVG_SERVICES_PAYLOAD;
+        break;
+    case SSS_MC_SID:
+        payload = SSS_AVG_SID_PAYLOAD;
+        break;
+    case SSS_MC_NEGATIVE:
+        payload = SSS_AVG_NEGATIVE_PAYLOAD;
+        break;
     default:
         return EINVAL;
     }
@@ -1260,20 +2174,40 @@ errno_t sss_mmap_cache_init(TALLOC_CTX *mem_ctx, const char *name,
      * so we increase by the necessary amount if they are not a multiple */
     /* We can use MC_ALIGN64 for this */
     n_elem = MC_ALIGN64(n_elem);
+    max_elems = n_elem * SSS_MC_MAX_GROWTH;
+
+    if (warm) {
+        /* a cache that grew keeps its size across the restart */
+        ret = sss_mc_open_old_file(mc_ctx->file, payload, n_elem, max_elems,
+                                   &old, &n_elem);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_TRACE_FUNC,
+                  "No reusable memory cache file %s: %d(%s)\n",
+                  mc_ctx->file, ret, strerror(ret));
+        }
+    }
 
     /* hash table is double the size because it will store both forward and
      * reverse keys (name/uid, name/gid, ..) */
     mc_ctx->ht_size = MC_HT_SIZE(n_elem * 2);
     mc_ctx->dt_size = MC_DT_SIZE(n_elem, payload);
     mc_ctx->ft_size = MC_FT_SIZE(n_elem);
+    mc_ctx->max_elems = max_elems;
+
+    mc_ctx->ref_table = talloc_zero_array(mc_ctx, uint8_t, mc_ctx->ft_size);
+    mc_ctx->free_lists = talloc_zero_array(mc_ctx, uint32_t,
+                                           MC_FREE_CLASSES * MC_FREE_LIST_LEN);
+    if (mc_ctx->ref_table == NULL || mc_ctx->free_lists == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
     mc_ctx->mmap_size = MC_HEADER_SIZE +
                         MC_ALIGN64(mc_ctx->dt_size) +
                         MC_ALIGN64(mc_ctx->ft_size) +
                         MC_ALIGN64(mc_ctx->ht_size);
 
-
-    /* for now ALWAYS create a new file on restart */
-
+    /* ALWAYS create a new file on restart, a warm restart only copies the
+     * records of the old one */
     ret = sss_mc_create_file(mc_ctx);
     if (ret) {
         goto done;
@@ -1313,11 +2247,22 @@ errno_t sss_mmap_cache_init(TALLOC_CTX *mem_ctx, const char *name,
     rseed = time(NULL) * getpid();
     mc_ctx->seed = rand_r(&rseed);
 
+    if (old.base != NULL) {
+        loaded = sss_mc_load_old_file(mc_ctx, &old);
+        DEBUG(SSSDBG_CONF_SETTINGS,
+              "Reused %"PRIu32" records of the %s memory cache\n",
+              loaded, name);
+    }
+
     sss_mc_header_update(mc_ctx, SSS_MC_HEADER_ALIVE);
 
     ret = EOK;
 
 done:
+    if (old.base != NULL) {
+        munmap(old.base, old.size);
+    }
+
     if (ret) {
         /* Closing the file descriptor and ummaping the file
          * from memory is done in the mc_ctx_destructor. */
@@ -1345,6 +2290,7 @@ errno_t sss_mmap_cache_reinit(TALLOC_CTX *mem_ctx, size_t n_elem,
     TALLOC_CTX* tmp_ctx = NULL;
     char *name;
     enum sss_mc_type type;
+    uint32_t max_elems;
 
     if (mc_ctx == NULL || (*mc_ctx) == NULL) {
         DEBUG(SSSDBG_CRIT_FAILURE,
@@ -1367,8 +2313,11 @@ errno_t sss_mmap_cache_reinit(TALLOC_CTX *mem_ctx, size_t n_elem,
 
     type = (*mc_ctx)->type;
 
+    max_elems = 0;
     if (n_elem == (size_t)-1) {
+        /* keep the current size, including any growth */
         n_elem = (*mc_ctx)->ft_size * 8;
+        max_elems = (*mc_ctx)->max_elems;
     }
 
     if (timeout == (time_t)-1) {
@@ -1380,12 +2329,17 @@ errno_t sss_mmap_cache_reinit(TALLOC_CTX *mem_ctx, size_t n_elem,
     /* make sure we do not leave a potentially freed pointer around */
     *mc_ctx = NULL;
 
-    ret = sss_mmap_cache_init(mem_ctx, name, type, n_elem, timeout, mc_ctx);
+    ret = sss_mmap_cache_init(mem_ctx, name, type, n_elem, timeout, false,
+                              mc_ctx);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, "Failed to re-initialize mmap cache.\n");
         goto done;
     }
 
+    if (max_elems != 0) {
+        (*mc_ctx)->max_elems = max_elems;
+    }
+
 done:
     talloc_free(tmp_ctx);
     return ret;
@@ -1408,5 +2362,10 @@ void sss_mmap_cache_reset(struct sss_mc_ctx *mc_ctx)
     memset(mc_ctx->free_table, 0x00, mc_ctx->ft_size);
     memset(mc_ctx->hash_table, 0xff, mc_ctx->ht_size);
 
+    memset(mc_ctx->ref_table, 0x00, mc_ctx->ft_size);
+    memset(mc_ctx->free_count, 0x00, sizeof(mc_ctx->free_count));
+    mc_ctx->next_slot = 0;
+    mc_ctx->live_evictions = 0;
+
     sss_mc_header_update(mc_ctx, SSS_MC_HEADER_ALIVE);
 }
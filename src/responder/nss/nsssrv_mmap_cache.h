@@ -23,19 +23,31 @@
 #define _NSSSRV_MMAP_CACHE_H_
 
 #define SSS_MC_CACHE_ELEMENTS 50000
+#define SSS_MC_CACHE_NETGR_ELEMENTS 10000
+#define SSS_MC_CACHE_SVC_ELEMENTS 10000
+#define SSS_MC_CACHE_NEG_ELEMENTS 10000
 
 struct sss_mc_ctx;
+struct sss_mc_stats;
+struct sss_mc_stats_report;
 
 enum sss_mc_type {
     SSS_MC_NONE = 0,
     SSS_MC_PASSWD,
     SSS_MC_GROUP,
     SSS_MC_INITGROUPS,
+    SSS_MC_NETGROUP,
+    SSS_MC_SERVICES,
+    SSS_MC_SID,
+    SSS_MC_NEGATIVE,
 };
 
+/* With @warm the records that did not expire yet are copied from the cache
+ * file of the previous responder, if it is still usable. */
 errno_t sss_mmap_cache_init(TALLOC_CTX *mem_ctx, const char *name,
                             enum sss_mc_type type, size_t n_elem,
-                            time_t valid_time, struct sss_mc_ctx **mcc);
+                            time_t valid_time, bool warm,
+                            struct sss_mc_ctx **mcc);
 
 errno_t sss_mmap_cache_pw_store(struct sss_mc_ctx **_mcc,
                                 struct sized_string *name,
@@ -57,6 +69,25 @@ errno_t sss_mmap_cache_initgr_store(struct sss_mc_ctx **_mcc,
                                     uint32_t num_groups,
                                     uint8_t *gids_buf);
 
+errno_t sss_mmap_cache_netgr_store(struct sss_mc_ctx **_mcc,
+                                   struct sized_string *name,
+                                   uint32_t num_entries,
+                                   uint8_t *entries_buf, size_t entries_len);
+
+errno_t sss_mmap_cache_svc_store(struct sss_mc_ctx **_mcc,
+                                 struct sized_string *name,
+                                 struct sized_string *protocol,
+                                 uint16_t port, uint32_t num_aliases,
+                                 char *aliasbuf, size_t aliassize);
+
+errno_t sss_mmap_cache_sid_store(struct sss_mc_ctx **_mcc,
+                                 struct sized_string *name,
+                                 struct sized_string *sid,
+                                 uint32_t id, uint32_t type);
+
+errno_t sss_mmap_cache_neg_store(struct sss_mc_ctx **_mcc,
+                                 struct sized_string *key);
+
 errno_t sss_mmap_cache_pw_invalidate(struct sss_mc_ctx *mcc,
                                      struct sized_string *name);
 
@@ -70,6 +101,23 @@ errno_t sss_mmap_cache_gr_invalidate_gid(struct sss_mc_ctx *mcc, gid_t gid);
 errno_t sss_mmap_cache_initgr_invalidate(struct sss_mc_ctx *mcc,
                                          struct sized_string *name);
 
+errno_t sss_mmap_cache_netgr_invalidate(struct sss_mc_ctx *mcc,
+                                        struct sized_string *name);
+
+errno_t sss_mmap_cache_sid_invalidate(struct sss_mc_ctx *mcc,
+                                      struct sized_string *name);
+
+errno_t sss_mmap_cache_sid_invalidate_sid(struct sss_mc_ctx *mcc,
+                                          const char *sid);
+
+/* Creates the file the lookup statistics of the clients are kept in and
+ * returns its mapping in @_stats, or removes it if @enabled is false */
+errno_t sss_mmap_cache_stats_init(bool enabled, struct sss_mc_stats **_stats);
+
+/* Adds the counts a client reported to @stats */
+errno_t sss_mmap_cache_stats_add(struct sss_mc_stats *stats,
+                                 const struct sss_mc_stats_report *report);
+
 errno_t sss_mmap_cache_reinit(TALLOC_CTX *mem_ctx, size_t n_elem,
                               time_t timeout, struct sss_mc_ctx **mc_ctx);
 
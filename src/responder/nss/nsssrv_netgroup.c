@@ -27,6 +27,7 @@
 #include "responder/nss/nsssrv.h"
 #include "responder/nss/nsssrv_private.h"
 #include "responder/nss/nsssrv_netgroup.h"
+#include "responder/nss/nsssrv_mmap_cache.h"
 #include "responder/common/negcache.h"
 #include "confdb/confdb.h"
 #include "db/sysdb.h"
@@ -708,16 +709,23 @@ static errno_t setnetgrent_recv(struct tevent_req *req)
     return EOK;
 }
 
+static void nss_netgr_mc_store(struct nss_ctx *nctx,
+                               const char *rawname,
+                               struct getent_ctx *netgr);
 static void nss_cmd_setnetgrent_done(struct tevent_req *req)
 {
     errno_t reqret;
     errno_t ret;
     struct sss_packet *packet;
+    struct getent_ctx *netgr;
+    struct sized_string mc_name;
     uint8_t *body;
     size_t blen;
 
     struct nss_cmd_ctx *cmdctx =
             tevent_req_callback_data(req, struct nss_cmd_ctx);
+    struct nss_ctx *nctx =
+            talloc_get_type(cmdctx->cctx->rctx->pvt_ctx, struct nss_ctx);
 
     reqret = setnetgrent_recv(req);
     talloc_zfree(req);
@@ -733,9 +741,22 @@ static void nss_cmd_setnetgrent_done(struct tevent_req *req)
                          &cmdctx->cctx->creq->out);
     if (ret == EOK) {
         if (reqret == ENOENT) {
+            /* The netgroup is gone, do not let clients find it in the
+             * fast cache either */
+            sss_packet_get_body(cmdctx->cctx->creq->in, &body, &blen);
+            to_sized_string(&mc_name, (const char *)body);
+            sss_mmap_cache_netgr_invalidate(nctx->netgr_mc_ctx, &mc_name);
+
             /* Notify the caller that this entry wasn't found */
             sss_cmd_empty_packet(cmdctx->cctx->creq->out);
         } else {
+            ret = get_netgroup_entry(nctx, cmdctx->cctx->netgr_name, &netgr);
+            if (ret == EOK && netgr->ready && netgr->found) {
+                /* the raw name the client asked for is the cache key */
+                sss_packet_get_body(cmdctx->cctx->creq->in, &body, &blen);
+                nss_netgr_mc_store(nctx, (const char *)body, netgr);
+            }
+
             packet = cmdctx->cctx->creq->out;
             ret = sss_packet_grow(packet, 2*sizeof(uint32_t));
             if (ret != EOK) {
@@ -945,15 +966,76 @@ done:
     return EOK;
 }
 
+/* Returns the size of the entry packed as in the GETNETGRENT reply
+ * or 0 if the entry is not valid and must be skipped */
+static size_t netgr_entry_packed_len(struct sysdb_netgroup_ctx *entry)
+{
+    size_t len;
+
+    if (entry->type == SYSDB_NETGROUP_TRIPLE_VAL) {
+        len = sizeof(uint32_t) + 3;
+        if (entry->value.triple.hostname) {
+            len += strlen(entry->value.triple.hostname);
+        }
+        if (entry->value.triple.username) {
+            len += strlen(entry->value.triple.username);
+        }
+        if (entry->value.triple.domainname) {
+            len += strlen(entry->value.triple.domainname);
+        }
+        return len;
+    } else if (entry->type == SYSDB_NETGROUP_GROUP_VAL) {
+        if (entry->value.groupname == NULL ||
+            entry->value.groupname[0] == '\0') {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "Empty netgroup member. Please check your cache.\n");
+            return 0;
+        }
+        return sizeof(uint32_t) + strlen(entry->value.groupname) + 1;
+    }
+
+    DEBUG(SSSDBG_CRIT_FAILURE,
+          "Unexpected value type for netgroup entry. "
+              "Please check your cache.\n");
+    return 0;
+}
+
+static void netgr_pack_string(uint8_t *body, size_t *rp, const char *str)
+{
+    size_t len;
+
+    if (str == NULL) {
+        body[*rp] = '\0';
+        *rp += 1;
+        return;
+    }
+
+    len = strlen(str) + 1;
+    memcpy(&body[*rp], str, len);
+    *rp += len;
+}
+
+/* The caller must make sure there are at least netgr_entry_packed_len()
+ * bytes available at body[*rp] */
+static void netgr_entry_pack(struct sysdb_netgroup_ctx *entry,
+                             uint8_t *body, size_t *rp)
+{
+    if (entry->type == SYSDB_NETGROUP_TRIPLE_VAL) {
+        SAFEALIGN_SET_UINT32(&body[*rp], SSS_NETGR_REP_TRIPLE, rp);
+        netgr_pack_string(body, rp, entry->value.triple.hostname);
+        netgr_pack_string(body, rp, entry->value.triple.username);
+        netgr_pack_string(body, rp, entry->value.triple.domainname);
+    } else {
+        SAFEALIGN_SET_UINT32(&body[*rp], SSS_NETGR_REP_GROUP, rp);
+        netgr_pack_string(body, rp, entry->value.groupname);
+    }
+}
+
 static errno_t nss_cmd_retnetgrent(struct cli_ctx *client,
                                    struct sysdb_netgroup_ctx **entries,
                                    int count)
 {
     size_t len;
-    size_t hostlen = 0;
-    size_t userlen = 0;
-    size_t domainlen = 0;
-    size_t grouplen = 0;
     uint8_t *body;
     size_t blen, rp;
     errno_t ret;
@@ -969,102 +1051,88 @@ static errno_t nss_cmd_retnetgrent(struct cli_ctx *client,
     num = 0;
     while (entries[client->netgrent_cur] &&
            (client->netgrent_cur - start) < count) {
-        if (entries[client->netgrent_cur]->type == SYSDB_NETGROUP_TRIPLE_VAL) {
-            hostlen = 1;
-            if (entries[client->netgrent_cur]->value.triple.hostname) {
-                hostlen += strlen(entries[client->netgrent_cur]->value.triple.hostname);
-            }
-
-            userlen = 1;
-            if (entries[client->netgrent_cur]->value.triple.username) {
-                userlen += strlen(entries[client->netgrent_cur]->value.triple.username);
-            }
+        len = netgr_entry_packed_len(entries[client->netgrent_cur]);
+        if (len == 0) {
+            client->netgrent_cur++;
+            continue;
+        }
 
-            domainlen = 1;
-            if (entries[client->netgrent_cur]->value.triple.domainname) {
-                domainlen += strlen(entries[client->netgrent_cur]->value.triple.domainname);
-            }
+        ret = sss_packet_grow(packet, len);
+        if (ret != EOK) {
+            return ret;
+        }
+        sss_packet_get_body(packet, &body, &blen);
 
-            len = sizeof(uint32_t) + hostlen + userlen + domainlen;
-            ret = sss_packet_grow(packet, len);
-            if (ret != EOK) {
-                return ret;
-            }
-            sss_packet_get_body(packet, &body, &blen);
+        netgr_entry_pack(entries[client->netgrent_cur], body, &rp);
 
-            SAFEALIGN_SET_UINT32(&body[rp], SSS_NETGR_REP_TRIPLE, &rp);
+        num++;
+        client->netgrent_cur++;
+    }
 
-            if (hostlen == 1) {
-                body[rp] = '\0';
-            } else {
-                memcpy(&body[rp],
-                       entries[client->netgrent_cur]->value.triple.hostname,
-                       hostlen);
-            }
-            rp += hostlen;
+    sss_packet_get_body(packet, &body, &blen);
 
-            if (userlen == 1) {
-                body[rp] = '\0';
-            } else {
-                memcpy(&body[rp],
-                       entries[client->netgrent_cur]->value.triple.username,
-                       userlen);
-            }
-            rp += userlen;
+    /* num results */
+    SAFEALIGN_COPY_UINT32(body, &num, NULL);
 
-            if (domainlen == 1) {
-                body[rp] = '\0';
-            } else {
-                memcpy(&body[rp],
-                       entries[client->netgrent_cur]->value.triple.domainname,
-                       domainlen);
-            }
-            rp += domainlen;
-        } else if (entries[client->netgrent_cur]->type == SYSDB_NETGROUP_GROUP_VAL) {
-            if (entries[client->netgrent_cur]->value.groupname == NULL ||
-                entries[client->netgrent_cur]->value.groupname[0] == '\0') {
-                DEBUG(SSSDBG_CRIT_FAILURE,
-                      "Empty netgroup member. Please check your cache.\n");
-                continue;
-            }
+    /* reserved */
+    SAFEALIGN_SETMEM_UINT32(body + sizeof(uint32_t), 0, NULL);
 
-            grouplen = 1 + strlen(entries[client->netgrent_cur]->value.groupname);
+    return EOK;
+}
 
-            len = sizeof(uint32_t) + grouplen;
+/* Store the complete netgroup in the mmap cache, so that clients can
+ * resolve the following setnetgrent() calls for the same name without
+ * talking to the responder at all */
+static void nss_netgr_mc_store(struct nss_ctx *nctx,
+                               const char *rawname,
+                               struct getent_ctx *netgr)
+{
+    struct sized_string name;
+    uint8_t *buf;
+    size_t buflen;
+    size_t len;
+    size_t rp;
+    uint32_t num;
+    int i;
+    errno_t ret;
 
-            ret = sss_packet_grow(packet, len);
-            if (ret != EOK) {
-                return ret;
-            }
+    if (nctx->netgr_mc_ctx == NULL || netgr->entries == NULL) {
+        return;
+    }
 
-            sss_packet_get_body(packet, &body, &blen);
+    buflen = 0;
+    for (i = 0; netgr->entries[i] != NULL; i++) {
+        buflen += netgr_entry_packed_len(netgr->entries[i]);
+    }
+    if (buflen == 0) {
+        return;
+    }
 
-            SAFEALIGN_SET_UINT32(&body[rp], SSS_NETGR_REP_GROUP, &rp);
+    buf = talloc_size(NULL, buflen);
+    if (buf == NULL) {
+        return;
+    }
 
-            memcpy(&body[rp],
-                   entries[client->netgrent_cur]->value.groupname,
-                   grouplen);
-            rp += grouplen;
-        } else {
-            DEBUG(SSSDBG_CRIT_FAILURE,
-                  "Unexpected value type for netgroup entry. "
-                      "Please check your cache.\n");
+    rp = 0;
+    num = 0;
+    for (i = 0; netgr->entries[i] != NULL; i++) {
+        len = netgr_entry_packed_len(netgr->entries[i]);
+        if (len == 0) {
             continue;
         }
-
+        netgr_entry_pack(netgr->entries[i], buf, &rp);
         num++;
-        client->netgrent_cur++;
     }
 
-    sss_packet_get_body(packet, &body, &blen);
-
-    /* num results */
-    SAFEALIGN_COPY_UINT32(body, &num, NULL);
-
-    /* reserved */
-    SAFEALIGN_SETMEM_UINT32(body + sizeof(uint32_t), 0, NULL);
+    to_sized_string(&name, rawname);
+    ret = sss_mmap_cache_netgr_store(&nctx->netgr_mc_ctx, &name,
+                                     num, buf, rp);
+    if (ret != EOK && ret != ENOMEM) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Failed to store netgroup %s in mmap cache!\n", rawname);
+    }
 
-    return EOK;
+    talloc_free(buf);
 }
 
 int nss_cmd_endnetgrent(struct cli_ctx *client)
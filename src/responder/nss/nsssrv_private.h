@@ -47,6 +47,11 @@ struct nss_cmd_ctx {
 struct dom_ctx {
     struct sss_domain_info *domain;
     struct ldb_result *res;
+
+    /* passwd enumeration only keeps the names, the entries are loaded
+     * a page at a time by getpwent */
+    const char **names;
+    size_t num_names;
 };
 
 struct getent_ctx {
@@ -98,6 +103,9 @@ struct setent_step_ctx {
     char *name;
 };
 
+/* Maximum number of entries loaded from the cache for one getpwent reply */
+#define NSS_ENUM_PAGE_SIZE 256
+
 #define NSS_CMD_FATAL_ERROR(cctx) do { \
     DEBUG(SSSDBG_CRIT_FAILURE,"Fatal error, killing connection!\n"); \
     talloc_free(cctx); \
@@ -135,5 +143,7 @@ void nss_update_gr_memcache(struct nss_ctx *nctx);
 void nss_update_initgr_memcache(struct nss_ctx *nctx,
                                 const char *name, const char *domain,
                                 int gnum, uint32_t *groups);
+void nss_invalidate_memcache_entry(struct nss_ctx *nctx, uint32_t type,
+                                   const char *name, const char *domain);
 
 #endif /* NSSSRV_PRIVATE_H_ */
@@ -26,6 +26,7 @@
 #include "responder/nss/nsssrv.h"
 #include "responder/nss/nsssrv_private.h"
 #include "responder/nss/nsssrv_services.h"
+#include "responder/nss/nsssrv_mmap_cache.h"
 #include "responder/common/negcache.h"
 #include "confdb/confdb.h"
 #include "db/sysdb.h"
@@ -587,13 +588,14 @@ getserv_recv(TALLOC_CTX *mem_ctx,
 static errno_t
 fill_service(struct sss_packet *packet,
              struct sss_domain_info *dom,
+             struct sss_mc_ctx **svc_mc_ctx,
              const char *protocol,
              struct ldb_message **msgs,
              unsigned int *count)
 {
     errno_t ret;
     unsigned int msg_count = *count;
-    size_t rzero, rsize, aptr;
+    size_t rzero, rsize, aptr, alias_start;
     unsigned int num = 0;
     unsigned int i, j;
     uint32_t num_aliases, written_aliases;
@@ -723,6 +725,7 @@ fill_service(struct sss_packet *packet,
                          cased_proto.len,
                          &rsize);
 
+        alias_start = rzero + rsize;
         written_aliases = 0;
         for (j = 0; j < num_aliases; j++) {
             if (sss_string_equal(dom->case_sensitive,
@@ -746,7 +749,6 @@ fill_service(struct sss_packet *packet,
                              &rsize);
 
             written_aliases++;
-            talloc_zfree(tmpstr);
         }
 
         /* We must not advance rsize here, the data has already been
@@ -755,6 +757,22 @@ fill_service(struct sss_packet *packet,
         SAFEALIGN_SETMEM_UINT32(&body[aptr], written_aliases, NULL);
 
         num++;
+
+        /* Only lookups with an explicit protocol can be answered from
+         * the fast cache, the "any protocol" result depends on the
+         * order of the values in sysdb */
+        if (protocol && svc_mc_ctx && *svc_mc_ctx) {
+            ret = sss_mmap_cache_svc_store(svc_mc_ctx,
+                                           &cased_name, &cased_proto,
+                                           port, written_aliases,
+                                           (char *)&body[alias_start],
+                                           rzero + rsize - alias_start);
+            if (ret != EOK && ret != ENOMEM) {
+                DEBUG(SSSDBG_CRIT_FAILURE,
+                      "Failed to store service %s(%s) in mmap cache!\n",
+                      cased_name.str, cased_proto.str);
+            }
+        }
     }
 
     ret = EOK;
@@ -995,6 +1013,8 @@ nss_cmd_getserv_done(struct tevent_req *req)
     struct nss_dom_ctx *dctx =
             tevent_req_callback_data(req, struct nss_dom_ctx);
     struct nss_cmd_ctx *cmdctx = dctx->cmdctx;
+    struct nss_ctx *nctx = talloc_get_type(cmdctx->cctx->rctx->pvt_ctx,
+                                           struct nss_ctx);
 
     reqret = getserv_recv(dctx, req, &dctx->res);
     talloc_zfree(req);
@@ -1017,6 +1037,7 @@ nss_cmd_getserv_done(struct tevent_req *req)
             i = dctx->res->count;
             ret = fill_service(cmdctx->cctx->creq->out,
                                dctx->domain,
+                               &nctx->svc_mc_ctx,
                                dctx->protocol,
                                dctx->res->msgs,
                                &i);
@@ -1791,7 +1812,7 @@ retservent(struct cli_ctx *cctx, int num)
 
         ret = fill_service(cctx->creq->out,
                            pdom->domain,
-                           NULL, msgs,
+                           NULL, NULL, msgs,
                            &n);
 
         cctx->svcent_cur += n;
@@ -212,6 +212,12 @@ int pac_process_init(TALLOC_CTX *mem_ctx,
         goto fail;
     }
 
+    ret = sss_ncache_set_timeout(pac_ctx->ncache, rctx->ev,
+                                 pac_ctx->neg_timeout);
+    if (ret != EOK) {
+        goto fail;
+    }
+
     ret = confdb_get_int(pac_ctx->rctx->cdb, CONFDB_PAC_CONF_ENTRY,
                          CONFDB_PAC_LIFETIME, 300,
                          &pac_ctx->pac_lifetime);
@@ -181,6 +181,34 @@ done:
     return ret;
 }
 
+static void pam_cached_auth_report(struct tevent_context *ev,
+                                   struct tevent_timer *te,
+                                   struct timeval current_time,
+                                   void *pvt)
+{
+    struct pam_ctx *pctx;
+    struct pam_cached_auth_stats *stats;
+    struct tevent_timer *next;
+
+    pctx = talloc_get_type(pvt, struct pam_ctx);
+    stats = &pctx->cached_auth_stats;
+
+    DEBUG(SSSDBG_IMPORTANT_INFO,
+          "Cached authentication since start: %"PRIu64" served locally, "
+          "%"PRIu64" failed and sent to the back end, %"PRIu64" sent to the "
+          "back end because the last online authentication was too old\n",
+          stats->served, stats->failed, stats->stale);
+
+    next = tevent_add_timer(ev, pctx,
+                            tevent_timeval_current_ofs(
+                                        pctx->cached_auth_report_interval, 0),
+                            pam_cached_auth_report, pctx);
+    if (next == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Cannot schedule the next cached authentication report\n");
+    }
+}
+
 static int pam_process_init(TALLOC_CTX *mem_ctx,
                             struct tevent_context *ev,
                             struct confdb_ctx *cdb,
@@ -190,6 +218,7 @@ static int pam_process_init(TALLOC_CTX *mem_ctx,
     struct sss_cmd_table *pam_cmds;
     struct be_conn *iter;
     struct pam_ctx *pctx;
+    struct tevent_timer *te;
     int ret, max_retries;
     int id_timeout;
     int fd_limit;
@@ -271,6 +300,11 @@ static int pam_process_init(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    ret = sss_ncache_set_timeout(pctx->ncache, rctx->ev, pctx->neg_timeout);
+    if (ret != EOK) {
+        goto done;
+    }
+
     ret = sss_ncache_prepopulate(pctx->ncache, cdb, pctx->rctx);
     if (ret != EOK) {
         goto done;
@@ -315,6 +349,28 @@ static int pam_process_init(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    /* Report the cached authentication counters together with the
+     * latency histograms */
+    ret = confdb_get_int(pctx->rctx->cdb, CONFDB_PAM_CONF_ENTRY,
+                         CONFDB_SERVICE_LATENCY_REPORT_INTERVAL, 0,
+                         &pctx->cached_auth_report_interval);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              "Failed to read the report interval\n");
+        goto done;
+    }
+
+    if (pctx->cached_auth_report_interval > 0) {
+        te = tevent_add_timer(rctx->ev, pctx,
+                              tevent_timeval_current_ofs(
+                                        pctx->cached_auth_report_interval, 0),
+                              pam_cached_auth_report, pctx);
+        if (te == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+    }
+
     pctx->p11_child_debug_fd = -1;
     if (pctx->cert_auth) {
         ret = p11_child_init(pctx);
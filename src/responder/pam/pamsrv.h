@@ -31,6 +31,15 @@ struct pam_auth_req;
 
 typedef void (pam_dp_callback_t)(struct pam_auth_req *preq);
 
+/* Authentications of online users checked against the cached password,
+ * see cached_auth_timeout */
+struct pam_cached_auth_stats {
+    uint64_t served;    /* verified in the responder */
+    uint64_t failed;    /* not verified, sent to the back end */
+    uint64_t stale;     /* last online authentication too old, sent to the
+                         * back end */
+};
+
 struct pam_ctx {
     struct resp_ctx *rctx;
     struct sss_nc_ctx *ncache;
@@ -47,6 +56,9 @@ struct pam_ctx {
     bool cert_auth;
     int p11_child_debug_fd;
     char *nss_db;
+
+    struct pam_cached_auth_stats cached_auth_stats;
+    int cached_auth_report_interval;
 };
 
 struct pam_auth_dp_req {
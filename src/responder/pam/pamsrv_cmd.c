@@ -851,9 +851,30 @@ static void pam_handle_cached_login(struct pam_auth_req *preq, int ret,
     size_t resp_len;
     uint8_t *resp;
     int64_t dummy;
+    struct pam_ctx *pctx =
+            talloc_get_type(preq->cctx->rctx->pvt_ctx, struct pam_ctx);
 
     preq->pd->pam_status = cached_login_pam_status(ret);
 
+    /* Was this attempt to authenticate from cache? */
+    if (use_cached_auth) {
+        if (preq->pd->pam_status == PAM_SUCCESS) {
+            pctx->cached_auth_stats.served++;
+        } else {
+            /* Whatever prevented it (wrong password, no or expired cached
+             * password, delay after failed attempts) is for the back end to
+             * judge. Don't try cached authentication again, try online
+             * check. */
+            DEBUG(SSSDBG_FUNC_DATA,
+                  "Cached authentication failed for: %s [%d]: %s\n",
+                  preq->pd->user, ret, sss_strerror(ret));
+            pctx->cached_auth_stats.failed++;
+            preq->cached_auth_failed = true;
+            pam_dom_forwarder(preq);
+            return;
+        }
+    }
+
     switch (preq->pd->pam_status) {
         case PAM_SUCCESS:
             resp_type = SSS_PAM_USER_INFO_OFFLINE_AUTH;
@@ -894,18 +915,6 @@ static void pam_handle_cached_login(struct pam_auth_req *preq, int ret,
                 }
             }
             break;
-        case PAM_AUTH_ERR:
-            /* Was this attempt to authenticate from cache? */
-            if (use_cached_auth) {
-                /* Don't try cached authentication again, try online check. */
-                DEBUG(SSSDBG_FUNC_DATA,
-                      "Cached authentication failed for: %s\n",
-                      preq->pd->user);
-                preq->cached_auth_failed = true;
-                pam_dom_forwarder(preq);
-                return;
-            }
-            break;
         default:
             DEBUG(SSSDBG_TRACE_LIBS,
                   "cached login returned: %d\n", preq->pd->pam_status);
@@ -1750,7 +1759,8 @@ static bool pam_can_user_cache_auth(struct sss_domain_info *domain,
                                     int pam_cmd,
                                     struct sss_auth_token *authtok,
                                     const char* user,
-                                    bool cached_auth_failed)
+                                    bool cached_auth_failed,
+                                    struct pam_cached_auth_stats *stats)
 {
     errno_t ret;
     bool result = false;
@@ -1770,6 +1780,10 @@ static bool pam_can_user_cache_auth(struct sss_domain_info *domain,
                   "pam_is_last_online_login_fresh failed: %s:[%d]\n",
                   sss_strerror(ret), ret);
         }
+
+        if (!result) {
+            stats->stale++;
+        }
     }
 
     return result;
@@ -1811,7 +1825,8 @@ static void pam_dom_forwarder(struct pam_auth_req *preq)
                                 preq->pd->cmd,
                                 preq->pd->authtok,
                                 preq->pd->user,
-                                preq->cached_auth_failed)) {
+                                preq->cached_auth_failed,
+                                &pctx->cached_auth_stats)) {
         preq->use_cached_auth = true;
         pam_reply(preq);
         return;
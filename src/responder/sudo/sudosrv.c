@@ -133,6 +133,14 @@ int sudo_process_init(TALLOC_CTX *mem_ctx,
         goto fail;
     }
 
+    ret = sss_ncache_set_timeout(sudo_ctx->ncache, rctx->ev,
+                                 sudo_ctx->neg_timeout);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              "fatal error setting ncache timeout\n");
+        goto fail;
+    }
+
     sss_ncache_prepopulate(sudo_ctx->ncache, sudo_ctx->rctx->cdb, rctx);
     if (ret != EOK) {
         DEBUG(SSSDBG_FATAL_FAILURE,
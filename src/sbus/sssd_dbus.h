@@ -263,6 +263,55 @@ void sbus_conn_send_reply(struct sbus_connection *conn,
  * him to connect. root is always allowed */
 void sbus_allow_uid(struct sbus_connection *conn, uid_t *uid);
 
+/*
+ * Framed connections
+ *
+ * A framed connection carries the same messages as a D-Bus connection
+ * over a plain unix socket, each one prefixed with its length, without
+ * the libdbus connection machinery. The object paths and interfaces are
+ * registered with sbus_conn_register_iface() as usual. Method calls are
+ * sent with sbus_frame_send().
+ */
+struct sbus_frame_server;
+struct sbus_frame_call;
+
+/* @reply is NULL when @error is not EOK. It is only valid during the call,
+ * reference it to keep it. */
+typedef void (*sbus_frame_reply_fn)(DBusMessage *reply,
+                                    errno_t error,
+                                    void *pvt);
+
+/* Listens on @socket_path, every accepted connection is passed to
+ * @init_fn. Only root and @uid may connect. */
+int sbus_frame_server_new(TALLOC_CTX *mem_ctx,
+                          struct tevent_context *ev,
+                          const char *socket_path,
+                          uid_t uid, gid_t gid,
+                          sbus_server_conn_init_fn init_fn,
+                          void *init_pvt,
+                          struct sbus_frame_server **_server);
+
+int sbus_frame_connect(TALLOC_CTX *mem_ctx,
+                       struct tevent_context *ev,
+                       const char *socket_path,
+                       struct sbus_connection **_conn);
+
+/* Creates a framed connection on an already connected socket */
+int sbus_frame_init_connection(TALLOC_CTX *mem_ctx,
+                               struct tevent_context *ev,
+                               int fd,
+                               struct sbus_connection **_conn);
+
+/* Sends a method call, @reply_fn is called exactly once unless the call
+ * is cancelled by freeing @_call, which is allocated on @mem_ctx. */
+int sbus_frame_send(TALLOC_CTX *mem_ctx,
+                    struct sbus_connection *conn,
+                    DBusMessage *msg,
+                    int timeout_ms,
+                    sbus_frame_reply_fn reply_fn,
+                    void *pvt,
+                    struct sbus_frame_call **_call);
+
 /*
  * This structure is passed to all dbus method and property
  * handlers. It is a talloc context which will be valid until
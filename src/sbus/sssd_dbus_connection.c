@@ -338,6 +338,11 @@ void sbus_disconnect(struct sbus_connection *conn)
         return;
     }
 
+    if (conn->type == SBUS_FRAMED) {
+        sbus_frame_disconnect(conn);
+        return;
+    }
+
     DEBUG(SSSDBG_TRACE_FUNC, "Disconnecting %p\n", conn->dbus.conn);
 
     /*******************************
@@ -572,6 +577,12 @@ int sbus_conn_send(struct sbus_connection *conn,
 {
     DBusConnection *dbus_conn;
 
+    if (conn->type == SBUS_FRAMED) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "BUG: Use sbus_frame_send() with framed connections\n");
+        return EINVAL;
+    }
+
     dbus_conn = sbus_get_connection(conn);
     if (!dbus_conn) {
         DEBUG(SSSDBG_CRIT_FAILURE, "D-BUS not connected\n");
@@ -584,6 +595,11 @@ int sbus_conn_send(struct sbus_connection *conn,
 
 void sbus_conn_send_reply(struct sbus_connection *conn, DBusMessage *reply)
 {
+    if (conn->type == SBUS_FRAMED) {
+        sbus_frame_send_message(conn, reply);
+        return;
+    }
+
     dbus_connection_send(conn->dbus.conn, reply, NULL);
 }
 
@@ -602,6 +618,11 @@ dbus_bool_t is_uid_sssd_user(DBusConnection *connection,
 
 void sbus_allow_uid(struct sbus_connection *conn, uid_t *uid)
 {
+    if (conn->type == SBUS_FRAMED) {
+        /* the peer was checked when the connection was accepted */
+        return;
+    }
+
     dbus_connection_set_unix_user_function(sbus_get_connection(conn),
                                            is_uid_sssd_user,
                                            uid, NULL);
@@ -0,0 +1,923 @@
+/*
+   SSSD
+
+   SBUS - framed transport
+
+   Copyright (C) 2016 Red Hat
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <tevent.h>
+#include <dbus/dbus.h>
+
+#include "util/util.h"
+#include "sbus/sssd_dbus.h"
+#include "sbus/sssd_dbus_private.h"
+
+/* Every frame is the length of the message in host byte order followed by
+ * the message in the D-Bus wire format. Both ends are on the same host. */
+#define SBUS_FRAME_HDR_SIZE sizeof(uint32_t)
+
+/* The same limit as D-Bus has */
+#define SBUS_FRAME_MAX_SIZE (128 * 1024 * 1024)
+
+/* Number of queued frames written with a single sendmsg() */
+#define SBUS_FRAME_WRITE_BATCH 16
+
+struct sbus_frame_out {
+    struct sbus_frame_out *prev;
+    struct sbus_frame_out *next;
+
+    uint32_t length;
+    /* allocated by libdbus */
+    char *data;
+
+    /* bytes of the header and the data already written */
+    size_t written;
+};
+
+struct sbus_frame_call {
+    struct sbus_frame_call *prev;
+    struct sbus_frame_call *next;
+
+    /* NULL once the connection is gone */
+    struct sbus_frame_conn *frame;
+    dbus_uint32_t serial;
+
+    sbus_frame_reply_fn reply_fn;
+    void *pvt;
+
+    struct tevent_immediate *imm;
+    errno_t error;
+};
+
+struct sbus_frame_conn {
+    struct sbus_connection *conn;
+
+    int fd;
+    struct tevent_fd *fde;
+
+    /* connections accepted by a server are freed when the peer goes away,
+     * the owner of a client connection frees it */
+    bool server_side;
+
+    /* frame being read */
+    uint32_t in_length;
+    size_t in_read;
+    char *in_data;
+
+    struct sbus_frame_out *out;
+
+    dbus_uint32_t last_serial;
+    struct sbus_frame_call *calls;
+};
+
+struct sbus_frame_server {
+    struct tevent_context *ev;
+
+    int fd;
+    struct tevent_fd *fde;
+    char *path;
+
+    uid_t uid;
+    gid_t gid;
+
+    sbus_server_conn_init_fn init_fn;
+    void *init_pvt;
+};
+
+/* =Sending================================================================ */
+
+static int sbus_frame_out_destructor(struct sbus_frame_out *out)
+{
+    dbus_free(out->data);
+    return 0;
+}
+
+static dbus_uint32_t sbus_frame_next_serial(struct sbus_frame_conn *frame)
+{
+    frame->last_serial++;
+    if (frame->last_serial == 0) {
+        frame->last_serial++;
+    }
+
+    return frame->last_serial;
+}
+
+static errno_t sbus_frame_queue(struct sbus_frame_conn *frame,
+                                DBusMessage *msg)
+{
+    struct sbus_frame_out *out;
+    char *data;
+    int len;
+
+    if (frame->fde == NULL) {
+        return ENOTCONN;
+    }
+
+    if (dbus_message_get_serial(msg) == 0) {
+        dbus_message_set_serial(msg, sbus_frame_next_serial(frame));
+    }
+
+    if (!dbus_message_marshal(msg, &data, &len)) {
+        return ENOMEM;
+    }
+
+    if (len <= 0 || len > SBUS_FRAME_MAX_SIZE) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Cannot send a message of %d bytes\n", len);
+        dbus_free(data);
+        return EMSGSIZE;
+    }
+
+    out = talloc_zero(frame, struct sbus_frame_out);
+    if (out == NULL) {
+        dbus_free(data);
+        return ENOMEM;
+    }
+
+    out->length = len;
+    out->data = data;
+    talloc_set_destructor(out, sbus_frame_out_destructor);
+
+    DLIST_ADD_END(frame->out, out, struct sbus_frame_out *);
+    TEVENT_FD_WRITEABLE(frame->fde);
+
+    return EOK;
+}
+
+static errno_t sbus_frame_write(struct sbus_frame_conn *frame)
+{
+    struct iovec iov[SBUS_FRAME_WRITE_BATCH * 2];
+    struct msghdr msg;
+    struct sbus_frame_out *out;
+    struct sbus_frame_out *next;
+    size_t done;
+    ssize_t len;
+    int iovcnt;
+    errno_t ret;
+
+    while (frame->out != NULL) {
+        iovcnt = 0;
+        /* every frame needs up to two vectors, the header and the data */
+        for (out = frame->out;
+             out != NULL && iovcnt + 2 <= SBUS_FRAME_WRITE_BATCH * 2;
+             out = out->next) {
+            if (out->written < SBUS_FRAME_HDR_SIZE) {
+                iov[iovcnt].iov_base = (uint8_t *) &out->length
+                                       + out->written;
+                iov[iovcnt].iov_len = SBUS_FRAME_HDR_SIZE - out->written;
+                iovcnt++;
+                done = 0;
+            } else {
+                done = out->written - SBUS_FRAME_HDR_SIZE;
+            }
+
+            iov[iovcnt].iov_base = out->data + done;
+            iov[iovcnt].iov_len = out->length - done;
+            iovcnt++;
+        }
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+
+        /* a peer that went away is reported as EPIPE, not with SIGPIPE */
+        errno = 0;
+        len = sendmsg(frame->fd, &msg, MSG_NOSIGNAL);
+        if (len == -1) {
+            ret = errno;
+            if (ret == EINTR) {
+                continue;
+            } else if (ret == EAGAIN || ret == EWOULDBLOCK) {
+                return EOK;
+            }
+
+            DEBUG(SSSDBG_OP_FAILURE, "sendmsg failed [%d]: %s\n",
+                  ret, sss_strerror(ret));
+            return ret;
+        }
+
+        /* drop the frames that were written completely */
+        for (out = frame->out; out != NULL && len > 0; out = next) {
+            next = out->next;
+
+            done = SBUS_FRAME_HDR_SIZE + out->length - out->written;
+            if ((size_t) len < done) {
+                out->written += len;
+                return EOK;
+            }
+
+            len -= done;
+            DLIST_REMOVE(frame->out, out);
+            talloc_free(out);
+        }
+    }
+
+    TEVENT_FD_NOT_WRITEABLE(frame->fde);
+    return EOK;
+}
+
+void sbus_frame_send_message(struct sbus_connection *conn,
+                             DBusMessage *msg)
+{
+    errno_t ret;
+
+    ret = sbus_frame_queue(conn->frame, msg);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Cannot send message [%d]: %s\n",
+              ret, sss_strerror(ret));
+    }
+}
+
+/* =Calls================================================================== */
+
+static int sbus_frame_call_destructor(struct sbus_frame_call *call)
+{
+    if (call->frame != NULL) {
+        DLIST_REMOVE(call->frame->calls, call);
+    }
+
+    return 0;
+}
+
+/* Frees the call before the reply function runs, so that the function may
+ * free anything the call was allocated on */
+static void sbus_frame_call_finish(struct sbus_frame_call *call,
+                                   DBusMessage *reply,
+                                   errno_t error)
+{
+    sbus_frame_reply_fn reply_fn = call->reply_fn;
+    void *pvt = call->pvt;
+
+    talloc_free(call);
+
+    reply_fn(reply, error, pvt);
+}
+
+static void sbus_frame_call_failed(struct tevent_context *ev,
+                                   struct tevent_immediate *imm,
+                                   void *pvt)
+{
+    struct sbus_frame_call *call;
+
+    call = talloc_get_type(pvt, struct sbus_frame_call);
+
+    sbus_frame_call_finish(call, NULL, call->error);
+}
+
+static void sbus_frame_call_timeout(struct tevent_context *ev,
+                                    struct tevent_timer *te,
+                                    struct timeval tv,
+                                    void *pvt)
+{
+    struct sbus_frame_call *call;
+
+    call = talloc_get_type(pvt, struct sbus_frame_call);
+
+    DEBUG(SSSDBG_MINOR_FAILURE, "Call [%u] timed out\n", call->serial);
+
+    sbus_frame_call_finish(call, NULL, ETIME);
+}
+
+int sbus_frame_send(TALLOC_CTX *mem_ctx,
+                    struct sbus_connection *conn,
+                    DBusMessage *msg,
+                    int timeout_ms,
+                    sbus_frame_reply_fn reply_fn,
+                    void *pvt,
+                    struct sbus_frame_call **_call)
+{
+    struct sbus_frame_call *call;
+    struct tevent_timer *te;
+    struct timeval tv;
+    errno_t ret;
+
+    if (conn->type != SBUS_FRAMED || reply_fn == NULL) {
+        return EINVAL;
+    }
+
+    if (conn->disconnect) {
+        return ENOTCONN;
+    }
+
+    call = talloc_zero(mem_ctx, struct sbus_frame_call);
+    if (call == NULL) {
+        return ENOMEM;
+    }
+
+    call->reply_fn = reply_fn;
+    call->pvt = pvt;
+
+    /* allocated now, so that the call can always be failed */
+    call->imm = tevent_create_immediate(call);
+    if (call->imm == NULL) {
+        ret = ENOMEM;
+        goto fail;
+    }
+
+    if (timeout_ms > 0) {
+        tv = tevent_timeval_current_ofs(timeout_ms / 1000,
+                                        (timeout_ms % 1000) * 1000);
+        te = tevent_add_timer(conn->ev, call, tv,
+                              sbus_frame_call_timeout, call);
+        if (te == NULL) {
+            ret = ENOMEM;
+            goto fail;
+        }
+    }
+
+    call->serial = sbus_frame_next_serial(conn->frame);
+    dbus_message_set_serial(msg, call->serial);
+
+    ret = sbus_frame_queue(conn->frame, msg);
+    if (ret != EOK) {
+        goto fail;
+    }
+
+    call->frame = conn->frame;
+    DLIST_ADD(conn->frame->calls, call);
+    talloc_set_destructor(call, sbus_frame_call_destructor);
+
+    if (_call != NULL) {
+        *_call = call;
+    }
+
+    return EOK;
+
+fail:
+    talloc_free(call);
+    return ret;
+}
+
+/* =Receiving============================================================== */
+
+/* Returns EAGAIN until a whole frame was read */
+static errno_t sbus_frame_read(struct sbus_frame_conn *frame,
+                               DBusMessage **_msg)
+{
+    DBusError dbus_error;
+    DBusMessage *msg;
+    size_t done;
+    ssize_t len;
+    errno_t ret;
+
+    if (frame->in_read < SBUS_FRAME_HDR_SIZE) {
+        errno = 0;
+        len = read(frame->fd, (uint8_t *) &frame->in_length + frame->in_read,
+                   SBUS_FRAME_HDR_SIZE - frame->in_read);
+        if (len == -1) {
+            ret = errno;
+            if (ret == EINTR || ret == EAGAIN || ret == EWOULDBLOCK) {
+                return EAGAIN;
+            }
+            return ret;
+        } else if (len == 0) {
+            return ENOTCONN;
+        }
+
+        frame->in_read += len;
+        if (frame->in_read < SBUS_FRAME_HDR_SIZE) {
+            return EAGAIN;
+        }
+
+        if (frame->in_length == 0 || frame->in_length > SBUS_FRAME_MAX_SIZE) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "Invalid frame length %u\n", frame->in_length);
+            return EBADMSG;
+        }
+
+        frame->in_data = talloc_size(frame, frame->in_length);
+        if (frame->in_data == NULL) {
+            return ENOMEM;
+        }
+
+        /* the message usually arrived together with its header */
+    }
+
+    done = frame->in_read - SBUS_FRAME_HDR_SIZE;
+
+    errno = 0;
+    len = read(frame->fd, frame->in_data + done, frame->in_length - done);
+    if (len == -1) {
+        ret = errno;
+        if (ret == EINTR || ret == EAGAIN || ret == EWOULDBLOCK) {
+            return EAGAIN;
+        }
+        return ret;
+    } else if (len == 0) {
+        return ENOTCONN;
+    }
+
+    frame->in_read += len;
+    if (frame->in_read < SBUS_FRAME_HDR_SIZE + frame->in_length) {
+        return EAGAIN;
+    }
+
+    dbus_error_init(&dbus_error);
+    msg = dbus_message_demarshal(frame->in_data, frame->in_length,
+                                 &dbus_error);
+
+    talloc_zfree(frame->in_data);
+    frame->in_read = 0;
+    frame->in_length = 0;
+
+    if (msg == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Invalid message: %s\n",
+              dbus_error.message);
+        dbus_error_free(&dbus_error);
+        return EBADMSG;
+    }
+
+    *_msg = msg;
+    return EOK;
+}
+
+static void sbus_frame_reply(struct sbus_frame_conn *frame,
+                             DBusMessage *reply)
+{
+    struct sbus_frame_call *call;
+    dbus_uint32_t serial;
+
+    serial = dbus_message_get_reply_serial(reply);
+
+    for (call = frame->calls; call != NULL; call = call->next) {
+        if (call->serial == serial) {
+            break;
+        }
+    }
+
+    if (call == NULL) {
+        /* the caller is not interested anymore */
+        DEBUG(SSSDBG_TRACE_INTERNAL,
+              "Discarding reply to call [%u]\n", serial);
+        return;
+    }
+
+    sbus_frame_call_finish(call, reply, EOK);
+}
+
+/* Must be the last thing done with @frame, the handlers may free it */
+static void sbus_frame_process(struct sbus_frame_conn *frame,
+                               DBusMessage *msg)
+{
+    DBusHandlerResult result;
+
+    switch (dbus_message_get_type(msg)) {
+    case DBUS_MESSAGE_TYPE_METHOD_CALL:
+        result = sbus_conn_dispatch_message(frame->conn, msg);
+        if (result == DBUS_HANDLER_RESULT_NEED_MEMORY) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Out of memory dispatching message\n");
+        }
+        break;
+    case DBUS_MESSAGE_TYPE_METHOD_RETURN:
+    case DBUS_MESSAGE_TYPE_ERROR:
+        sbus_frame_reply(frame, msg);
+        break;
+    default:
+        DEBUG(SSSDBG_MINOR_FAILURE, "Ignoring message of type %d\n",
+              dbus_message_get_type(msg));
+        break;
+    }
+
+    dbus_message_unref(msg);
+}
+
+/* =Connections============================================================ */
+
+static void sbus_frame_close(struct sbus_frame_conn *frame)
+{
+    talloc_zfree(frame->fde);
+
+    if (frame->fd != -1) {
+        close(frame->fd);
+        frame->fd = -1;
+    }
+}
+
+/* The calls waiting for a reply are failed from the main loop, where no
+ * connection code is on the stack */
+static void sbus_frame_fail_calls(struct sbus_frame_conn *frame,
+                                  errno_t error)
+{
+    struct sbus_frame_call *call;
+
+    while ((call = frame->calls) != NULL) {
+        DLIST_REMOVE(frame->calls, call);
+        call->frame = NULL;
+        call->error = error;
+
+        tevent_schedule_immediate(call->imm, frame->conn->ev,
+                                  sbus_frame_call_failed, call);
+    }
+}
+
+static void sbus_frame_lost(struct sbus_frame_conn *frame, errno_t error)
+{
+    struct sbus_connection *conn = frame->conn;
+
+    DEBUG(SSSDBG_MINOR_FAILURE, "Framed connection lost [%d]: %s\n",
+          error, sss_strerror(error));
+
+    conn->disconnect = 1;
+    sbus_frame_close(frame);
+    sbus_frame_fail_calls(frame, EIO);
+
+    if (frame->server_side) {
+        talloc_free(conn);
+    }
+}
+
+void sbus_frame_disconnect(struct sbus_connection *conn)
+{
+    DEBUG(SSSDBG_TRACE_FUNC, "Disconnecting framed connection %p\n", conn);
+
+    conn->disconnect = 1;
+    sbus_frame_close(conn->frame);
+    sbus_frame_fail_calls(conn->frame, ECONNABORTED);
+}
+
+static void sbus_frame_fd_handler(struct tevent_context *ev,
+                                  struct tevent_fd *fde,
+                                  uint16_t flags,
+                                  void *pvt)
+{
+    struct sbus_frame_conn *frame;
+    DBusMessage *msg;
+    errno_t ret;
+
+    frame = talloc_get_type(pvt, struct sbus_frame_conn);
+
+    if (flags & TEVENT_FD_WRITE) {
+        ret = sbus_frame_write(frame);
+        if (ret != EOK) {
+            sbus_frame_lost(frame, ret);
+            return;
+        }
+    }
+
+    if (flags & TEVENT_FD_READ) {
+        ret = sbus_frame_read(frame, &msg);
+        if (ret == EAGAIN) {
+            return;
+        } else if (ret != EOK) {
+            sbus_frame_lost(frame, ret);
+            return;
+        }
+
+        /* one message per wakeup, tevent calls us again if more data
+         * is waiting */
+        sbus_frame_process(frame, msg);
+    }
+}
+
+static int sbus_frame_conn_destructor(struct sbus_frame_conn *frame)
+{
+    struct sbus_frame_call *call;
+
+    /* the owners of the calls are notified by their own timeouts */
+    while ((call = frame->calls) != NULL) {
+        DLIST_REMOVE(frame->calls, call);
+        call->frame = NULL;
+    }
+
+    sbus_frame_close(frame);
+    return 0;
+}
+
+static errno_t sbus_frame_new_conn(TALLOC_CTX *mem_ctx,
+                                   struct tevent_context *ev,
+                                   int fd,
+                                   bool server_side,
+                                   struct sbus_connection **_conn)
+{
+    struct sbus_connection *conn;
+    struct sbus_frame_conn *frame;
+    errno_t ret;
+
+    conn = talloc_zero(mem_ctx, struct sbus_connection);
+    if (conn == NULL) {
+        return ENOMEM;
+    }
+
+    conn->ev = ev;
+    conn->type = SBUS_FRAMED;
+    conn->connection_type = SBUS_CONN_TYPE_PRIVATE;
+
+    ret = sbus_opath_hash_init(conn, conn, &conn->managed_paths);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Cannot create object paths hash table\n");
+        goto fail;
+    }
+
+    ret = sbus_nodes_hash_init(conn, conn, &conn->nodes_fns);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Cannot create node functions hash table\n");
+        goto fail;
+    }
+
+    ret = sbus_incoming_signal_hash_init(conn, &conn->incoming_signals);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Cannot create incoming signals "
+              "hash table\n");
+        goto fail;
+    }
+
+    frame = talloc_zero(conn, struct sbus_frame_conn);
+    if (frame == NULL) {
+        ret = ENOMEM;
+        goto fail;
+    }
+
+    frame->conn = conn;
+    frame->fd = -1;
+    frame->server_side = server_side;
+    talloc_set_destructor(frame, sbus_frame_conn_destructor);
+    conn->frame = frame;
+
+    ret = sss_fd_nonblocking(fd);
+    if (ret != EOK) {
+        goto fail;
+    }
+
+    frame->fde = tevent_add_fd(ev, frame, fd, TEVENT_FD_READ,
+                               sbus_frame_fd_handler, frame);
+    if (frame->fde == NULL) {
+        ret = ENOMEM;
+        goto fail;
+    }
+    frame->fd = fd;
+
+    *_conn = conn;
+    return EOK;
+
+fail:
+    talloc_free(conn);
+    return ret;
+}
+
+int sbus_frame_init_connection(TALLOC_CTX *mem_ctx,
+                               struct tevent_context *ev,
+                               int fd,
+                               struct sbus_connection **_conn)
+{
+    return sbus_frame_new_conn(mem_ctx, ev, fd, false, _conn);
+}
+
+int sbus_frame_connect(TALLOC_CTX *mem_ctx,
+                       struct tevent_context *ev,
+                       const char *socket_path,
+                       struct sbus_connection **_conn)
+{
+    struct sockaddr_un addr;
+    errno_t ret;
+    int fd;
+
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        return ENAMETOOLONG;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "socket failed [%d]: %s\n",
+              ret, sss_strerror(ret));
+        return ret;
+    }
+
+    /* connecting to a listening unix socket does not block */
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_TRACE_FUNC, "Cannot connect to [%s] [%d]: %s\n",
+              socket_path, ret, sss_strerror(ret));
+        close(fd);
+        return ret;
+    }
+
+    ret = sbus_frame_new_conn(mem_ctx, ev, fd, false, _conn);
+    if (ret != EOK) {
+        close(fd);
+        return ret;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Connected to [%s]\n", socket_path);
+
+    return EOK;
+}
+
+/* =Server================================================================= */
+
+static errno_t sbus_frame_check_peer(struct sbus_frame_server *server,
+                                     int fd)
+{
+#ifdef HAVE_UCRED
+    struct ucred ucred;
+    socklen_t len = sizeof(ucred);
+    errno_t ret;
+
+    ret = getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &ucred, &len);
+    if (ret != 0) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "getsockopt failed [%d]: %s\n",
+              ret, sss_strerror(ret));
+        return ret;
+    }
+
+    /* the same users sbus_allow_uid() lets in */
+    if (ucred.uid != 0 && ucred.uid != server->uid) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Refusing framed connection of uid %"SPRIuid"\n", ucred.uid);
+        return EACCES;
+    }
+#endif /* HAVE_UCRED */
+
+    return EOK;
+}
+
+static void sbus_frame_accept(struct tevent_context *ev,
+                              struct tevent_fd *fde,
+                              uint16_t flags,
+                              void *pvt)
+{
+    struct sbus_frame_server *server;
+    struct sbus_connection *conn;
+    errno_t ret;
+    int fd;
+
+    server = talloc_get_type(pvt, struct sbus_frame_server);
+
+    fd = accept(server->fd, NULL, NULL);
+    if (fd == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_OP_FAILURE, "accept failed [%d]: %s\n",
+              ret, sss_strerror(ret));
+        return;
+    }
+
+    ret = sbus_frame_check_peer(server, fd);
+    if (ret != EOK) {
+        close(fd);
+        return;
+    }
+
+    if (fcntl(fd, F_SETFD, FD_CLOEXEC) == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_OP_FAILURE, "Cannot set close-on-exec [%d]: %s\n",
+              ret, sss_strerror(ret));
+        close(fd);
+        return;
+    }
+
+    ret = sbus_frame_new_conn(server, ev, fd, true, &conn);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Cannot set up framed connection\n");
+        close(fd);
+        return;
+    }
+
+    DEBUG(SSSDBG_FUNC_DATA, "Got a framed connection\n");
+
+    ret = server->init_fn(conn, server->init_pvt);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Initialization failed!\n");
+        talloc_free(conn);
+    }
+}
+
+static int sbus_frame_server_destructor(struct sbus_frame_server *server)
+{
+    talloc_zfree(server->fde);
+
+    if (server->fd != -1) {
+        close(server->fd);
+        unlink(server->path);
+    }
+
+    return 0;
+}
+
+int sbus_frame_server_new(TALLOC_CTX *mem_ctx,
+                          struct tevent_context *ev,
+                          const char *socket_path,
+                          uid_t uid, gid_t gid,
+                          sbus_server_conn_init_fn init_fn,
+                          void *init_pvt,
+                          struct sbus_frame_server **_server)
+{
+    struct sbus_frame_server *server;
+    struct sockaddr_un addr;
+    mode_t orig_umask;
+    errno_t ret;
+
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        return ENAMETOOLONG;
+    }
+
+    server = talloc_zero(mem_ctx, struct sbus_frame_server);
+    if (server == NULL) {
+        return ENOMEM;
+    }
+
+    server->ev = ev;
+    server->uid = uid;
+    server->gid = gid;
+    server->init_fn = init_fn;
+    server->init_pvt = init_pvt;
+    server->fd = -1;
+    talloc_set_destructor(server, sbus_frame_server_destructor);
+
+    server->path = talloc_strdup(server, socket_path);
+    if (server->path == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    server->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (server->fd == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "socket failed [%d]: %s\n",
+              ret, sss_strerror(ret));
+        goto done;
+    }
+
+    ret = sss_fd_nonblocking(server->fd);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+
+    /* make sure we have no old sockets around */
+    if (unlink(socket_path) != 0 && errno != ENOENT) {
+        ret = errno;
+        DEBUG(SSSDBG_MINOR_FAILURE, "Cannot remove old socket [%d]: %s\n",
+              ret, sss_strerror(ret));
+    }
+
+    /* only the owner may connect, like to the D-Bus server */
+    orig_umask = umask(0177);
+    ret = bind(server->fd, (struct sockaddr *) &addr, sizeof(addr));
+    umask(orig_umask);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to bind on socket [%s] [%d]: %s\n",
+              socket_path, ret, sss_strerror(ret));
+        goto done;
+    }
+
+    if (chown(socket_path, uid, gid) != 0) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "chown failed for [%s] [%d]: %s\n",
+              socket_path, ret, sss_strerror(ret));
+        goto done;
+    }
+
+    if (listen(server->fd, 10) == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to listen on socket [%s] [%d]: %s\n",
+              socket_path, ret, sss_strerror(ret));
+        goto done;
+    }
+
+    server->fde = tevent_add_fd(ev, server, server->fd, TEVENT_FD_READ,
+                                sbus_frame_accept, server);
+    if (server->fde == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Framed server listening on %s\n", socket_path);
+
+    *_server = server;
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        talloc_free(server);
+    }
+    return ret;
+}
@@ -487,6 +487,10 @@ sbus_opath_hash_delete_cb(hash_entry_t *item,
     char *path;
 
     conn = talloc_get_type(pvt, struct sbus_connection);
+    if (conn->type == SBUS_FRAMED) {
+        return;
+    }
+
     path = sbus_opath_get_base_path(NULL, item->key.str);
 
     dbus_connection_unregister_object_path(conn->dbus.conn, path);
@@ -873,6 +877,11 @@ sbus_conn_register_path(struct sbus_connection *conn,
     char *reg_path = NULL;
     dbus_bool_t dbret;
 
+    if (conn->type == SBUS_FRAMED) {
+        /* framed connections dispatch through managed_paths directly */
+        return EOK;
+    }
+
     DEBUG(SSSDBG_TRACE_FUNC, "Registering object path %s with D-Bus "
           "connection\n", path);
 
@@ -1022,8 +1031,18 @@ sbus_message_handler(DBusConnection *dbus_conn,
                      DBusMessage *message,
                      void *handler_data)
 {
-    struct tevent_req *req;
     struct sbus_connection *conn;
+
+    conn = talloc_get_type(handler_data, struct sbus_connection);
+
+    return sbus_conn_dispatch_message(conn, message);
+}
+
+DBusHandlerResult
+sbus_conn_dispatch_message(struct sbus_connection *conn,
+                           DBusMessage *message)
+{
+    struct tevent_req *req;
     struct sbus_interface *iface;
     struct sbus_request *sbus_req;
     const struct sbus_method_meta *method;
@@ -1032,8 +1051,6 @@ sbus_message_handler(DBusConnection *dbus_conn,
     const char *path;
     const char *sender;
 
-    conn = talloc_get_type(handler_data, struct sbus_connection);
-
     /* header information */
     iface_name = dbus_message_get_interface(message);
     method_name = dbus_message_get_member(message);
@@ -32,10 +32,13 @@ union dbus_conn_pointer {
 };
 enum dbus_conn_type {
     SBUS_SERVER,
-    SBUS_CONNECTION
+    SBUS_CONNECTION,
+    /* framed connection that does not use libdbus for the transport */
+    SBUS_FRAMED
 };
 
 struct sbus_watch_ctx;
+struct sbus_frame_conn;
 
 struct sbus_connection {
     struct tevent_context *ev;
@@ -66,6 +69,9 @@ struct sbus_connection {
 
     /* watches list */
     struct sbus_watch_ctx *watch_list;
+
+    /* transport of SBUS_FRAMED connections */
+    struct sbus_frame_conn *frame;
 };
 
 /* =Standard=interfaces=================================================== */
@@ -108,6 +114,14 @@ struct sbus_request *
 sbus_new_request(struct sbus_connection *conn, struct sbus_interface *intf,
                  DBusMessage *message);
 
+/* =Framed=transport====================================================== */
+
+/* Queues a reply or a signal on a framed connection */
+void sbus_frame_send_message(struct sbus_connection *conn,
+                             DBusMessage *msg);
+
+void sbus_frame_disconnect(struct sbus_connection *conn);
+
 /* =Interface=and=object=paths============================================ */
 
 struct sbus_interface_list {
@@ -141,6 +155,11 @@ sbus_nodes_hash_lookup(TALLOC_CTX *mem_ctx,
                        hash_table_t *table,
                        const char *object_path);
 
+/* Looks up the handler of a method call received on @conn and invokes it */
+DBusHandlerResult
+sbus_conn_dispatch_message(struct sbus_connection *conn,
+                           DBusMessage *message);
+
 void
 sbus_request_invoke_or_finish(struct sbus_request *dbus_req,
                               sbus_msg_handler_fn handler_fn,
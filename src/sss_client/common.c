@@ -63,18 +63,61 @@
 
 /* common functions */
 
-int sss_cli_sd = -1; /* the sss client socket descriptor */
-struct stat sss_cli_sb; /* the sss client stat buffer */
+struct sss_cli_conn {
+    int sd;             /* the sss client socket descriptor */
+    struct stat sb;     /* the sss client stat buffer */
+    pid_t pid;          /* the process the socket was opened in */
+    uint32_t version;   /* the protocol version agreed with the responder */
+};
+
+/* the connection used by everything except NSS lookups that can be
+ * served from the connection pool, see sss_nss_make_request() */
+static struct sss_cli_conn sss_cli_conn = { .sd = -1 };
+
+#if HAVE_PTHREAD
+/* Number of connections to the NSS responder used by lookups that do not
+ * depend on any per-client state in the responder. Concurrent cache misses
+ * of a multi-threaded process are spread over them instead of waiting for
+ * each other on a single socket. */
+#define SSS_NSS_POOL_SIZE 8
+
+struct sss_nss_pool_conn {
+    pthread_mutex_t mtx;
+    struct sss_cli_conn conn;
+};
+
+static struct sss_nss_pool_conn sss_nss_pool[SSS_NSS_POOL_SIZE] = {
+    [0 ... SSS_NSS_POOL_SIZE - 1] = { .mtx = PTHREAD_MUTEX_INITIALIZER,
+                                      .conn = { .sd = -1 } }
+};
+static pthread_once_t sss_nss_pool_once = PTHREAD_ONCE_INIT;
+
+static struct sss_nss_pool_conn *sss_nss_pool_get(void);
+static void sss_nss_pool_put(struct sss_nss_pool_conn *pc);
+#endif
+
+static void sss_cli_conn_close(struct sss_cli_conn *conn)
+{
+    if (conn->sd != -1) {
+        close(conn->sd);
+        conn->sd = -1;
+    }
+}
 
 #if HAVE_FUNCTION_ATTRIBUTE_DESTRUCTOR
 __attribute__((destructor))
 #endif
 static void sss_cli_close_socket(void)
 {
-    if (sss_cli_sd != -1) {
-        close(sss_cli_sd);
-        sss_cli_sd = -1;
+#if HAVE_PTHREAD
+    int i;
+
+    for (i = 0; i < SSS_NSS_POOL_SIZE; i++) {
+        sss_cli_conn_close(&sss_nss_pool[i].conn);
     }
+#endif
+
+    sss_cli_conn_close(&sss_cli_conn);
 }
 
 /* Requests:
@@ -82,10 +125,12 @@ static void sss_cli_close_socket(void)
  * byte 0-3: 32bit unsigned with length (the complete packet length: 0 to X)
  * byte 4-7: 32bit unsigned with command code
  * byte 8-11: 32bit unsigned (reserved)
- * byte 12-15: 32bit unsigned (reserved)
+ * byte 12-15: 32bit unsigned request tag (reserved before
+ *             SSS_NSS_PROTOCOL_VERSION_MUX), the reply carries the same tag
  * byte 16-X: (optional) request structure associated to the command code used
  */
-static enum sss_status sss_cli_send_req(enum sss_cli_command cmd,
+static enum sss_status sss_cli_send_req(struct sss_cli_conn *conn,
+                                        enum sss_cli_command cmd,
                                         struct sss_cli_req_data *rd,
                                         int *errnop)
 {
@@ -105,7 +150,7 @@ static enum sss_status sss_cli_send_req(enum sss_cli_command cmd,
         int res, error;
 
         *errnop = 0;
-        pfd.fd = sss_cli_sd;
+        pfd.fd = conn->sd;
         pfd.events = POLLOUT;
 
         do {
@@ -139,19 +184,19 @@ static enum sss_status sss_cli_send_req(enum sss_cli_command cmd,
             break;
         }
         if (*errnop) {
-            sss_cli_close_socket();
+            sss_cli_conn_close(conn);
             return SSS_STATUS_UNAVAIL;
         }
 
         errno = 0;
         if (datasent < SSS_NSS_HEADER_SIZE) {
-            res = send(sss_cli_sd,
+            res = send(conn->sd,
                        (char *)header + datasent,
                        SSS_NSS_HEADER_SIZE - datasent,
                        SSS_DEFAULT_WRITE_FLAGS);
         } else {
             rdsent = datasent - SSS_NSS_HEADER_SIZE;
-            res = send(sss_cli_sd,
+            res = send(conn->sd,
                        (const char *)rd->data + rdsent,
                        rd->len - rdsent,
                        SSS_DEFAULT_WRITE_FLAGS);
@@ -167,7 +212,7 @@ static enum sss_status sss_cli_send_req(enum sss_cli_command cmd,
             }
 
             /* Write failed */
-            sss_cli_close_socket();
+            sss_cli_conn_close(conn);
             *errnop = error;
             return SSS_STATUS_UNAVAIL;
         }
@@ -183,11 +228,12 @@ static enum sss_status sss_cli_send_req(enum sss_cli_command cmd,
  * byte 0-3: 32bit unsigned with length (the complete packet length: 0 to X)
  * byte 4-7: 32bit unsigned with command code
  * byte 8-11: 32bit unsigned with the request status (server errno)
- * byte 12-15: 32bit unsigned (reserved)
+ * byte 12-15: 32bit unsigned request tag
  * byte 16-X: (optional) reply structure associated to the command code used
  */
 
-static enum sss_status sss_cli_recv_rep(enum sss_cli_command cmd,
+static enum sss_status sss_cli_recv_rep(struct sss_cli_conn *conn,
+                                        enum sss_cli_command cmd,
                                         uint8_t **_buf, int *_len,
                                         int *errnop)
 {
@@ -213,7 +259,7 @@ static enum sss_status sss_cli_recv_rep(enum sss_cli_command cmd,
         int bufrecv;
         int res, error;
 
-        pfd.fd = sss_cli_sd;
+        pfd.fd = conn->sd;
         pfd.events = POLLIN;
 
         do {
@@ -250,19 +296,19 @@ static enum sss_status sss_cli_recv_rep(enum sss_cli_command cmd,
             break;
         }
         if (*errnop) {
-            sss_cli_close_socket();
+            sss_cli_conn_close(conn);
             ret = SSS_STATUS_UNAVAIL;
             goto failed;
         }
 
         errno = 0;
         if (datarecv < SSS_NSS_HEADER_SIZE) {
-            res = read(sss_cli_sd,
+            res = read(conn->sd,
                        (char *)header + datarecv,
                        SSS_NSS_HEADER_SIZE - datarecv);
         } else {
             bufrecv = datarecv - SSS_NSS_HEADER_SIZE;
-            res = read(sss_cli_sd,
+            res = read(conn->sd,
                        (char *) buf + bufrecv,
                        header[0] - datarecv);
         }
@@ -281,7 +327,7 @@ static enum sss_status sss_cli_recv_rep(enum sss_cli_command cmd,
              * since the transaction has failed half way
              * through. */
 
-            sss_cli_close_socket();
+            sss_cli_conn_close(conn);
             *errnop = error;
             ret = SSS_STATUS_UNAVAIL;
             goto failed;
@@ -295,7 +341,7 @@ static enum sss_status sss_cli_recv_rep(enum sss_cli_command cmd,
              * been read, do checks and proceed */
             if (header[2] != 0) {
                 /* server side error */
-                sss_cli_close_socket();
+                sss_cli_conn_close(conn);
                 *errnop = header[2];
                 if (*errnop == EAGAIN) {
                     ret = SSS_STATUS_TRYAGAIN;
@@ -307,7 +353,7 @@ static enum sss_status sss_cli_recv_rep(enum sss_cli_command cmd,
             }
             if (header[1] != cmd) {
                 /* wrong command id */
-                sss_cli_close_socket();
+                sss_cli_conn_close(conn);
                 *errnop = EBADMSG;
                 ret = SSS_STATUS_UNAVAIL;
                 goto failed;
@@ -316,7 +362,7 @@ static enum sss_status sss_cli_recv_rep(enum sss_cli_command cmd,
                 len = header[0] - SSS_NSS_HEADER_SIZE;
                 buf = malloc(len);
                 if (!buf) {
-                    sss_cli_close_socket();
+                    sss_cli_conn_close(conn);
                     *errnop = ENOMEM;
                     ret = SSS_STATUS_UNAVAIL;
                     goto failed;
@@ -326,7 +372,7 @@ static enum sss_status sss_cli_recv_rep(enum sss_cli_command cmd,
     }
 
     if (pollhup) {
-        sss_cli_close_socket();
+        sss_cli_conn_close(conn);
     }
 
     *_len = len;
@@ -342,6 +388,7 @@ failed:
 /* this function will check command codes match and returned length is ok */
 /* repbuf and replen report only the data section not the header */
 static enum sss_status sss_cli_make_request_nochecks(
+                                       struct sss_cli_conn *conn,
                                        enum sss_cli_command cmd,
                                        struct sss_cli_req_data *rd,
                                        uint8_t **repbuf, size_t *replen,
@@ -352,13 +399,13 @@ static enum sss_status sss_cli_make_request_nochecks(
     int len = 0;
 
     /* send data */
-    ret = sss_cli_send_req(cmd, rd, errnop);
+    ret = sss_cli_send_req(conn, cmd, rd, errnop);
     if (ret != SSS_STATUS_SUCCESS) {
         return ret;
     }
 
     /* data sent, now get reply */
-    ret = sss_cli_recv_rep(cmd, &buf, &len, errnop);
+    ret = sss_cli_recv_rep(conn, cmd, &buf, &len, errnop);
     if (ret != SSS_STATUS_SUCCESS) {
         return ret;
     }
@@ -384,7 +431,8 @@ static enum sss_status sss_cli_make_request_nochecks(
  * 0-3: 32bit unsigned version number
  */
 
-static bool sss_cli_check_version(const char *socket_name)
+static bool sss_cli_check_version(struct sss_cli_conn *conn,
+                                  const char *socket_name)
 {
     uint8_t *repbuf = NULL;
     size_t replen;
@@ -393,9 +441,12 @@ static bool sss_cli_check_version(const char *socket_name)
     uint32_t expected_version;
     uint32_t obtained_version;
     struct sss_cli_req_data req;
+    bool nss = false;
 
     if (strcmp(socket_name, SSS_NSS_SOCKET_NAME) == 0) {
-        expected_version = SSS_NSS_PROTOCOL_VERSION;
+        /* older responders answer with SSS_NSS_PROTOCOL_VERSION */
+        expected_version = SSS_NSS_PROTOCOL_VERSION_MUX;
+        nss = true;
     } else if (strcmp(socket_name, SSS_PAM_SOCKET_NAME) == 0 ||
                strcmp(socket_name, SSS_PAM_PRIV_SOCKET_NAME) == 0) {
         expected_version = SSS_PAM_PROTOCOL_VERSION;
@@ -414,7 +465,7 @@ static bool sss_cli_check_version(const char *socket_name)
     req.len = sizeof(expected_version);
     req.data = &expected_version;
 
-    nret = sss_cli_make_request_nochecks(SSS_GET_VERSION, &req,
+    nret = sss_cli_make_request_nochecks(conn, SSS_GET_VERSION, &req,
                                          &repbuf, &replen, &errnop);
     if (nret != SSS_STATUS_SUCCESS) {
         return false;
@@ -427,7 +478,10 @@ static bool sss_cli_check_version(const char *socket_name)
     SAFEALIGN_COPY_UINT32(&obtained_version, repbuf, NULL);
     free(repbuf);
 
-    return (obtained_version == expected_version);
+    conn->version = obtained_version;
+
+    return (obtained_version == expected_version
+            || (nss && obtained_version == SSS_NSS_PROTOCOL_VERSION));
 }
 
 /* this 2 functions are adapted from samba3 winbinbd's wb_common.c */
@@ -524,7 +578,8 @@ static int make_safe_fd(int fd)
     return new_fd;
 }
 
-static int sss_cli_open_socket(int *errnop, const char *socket_name)
+static int sss_cli_open_socket(int *errnop, const char *socket_name,
+                               struct stat *sb)
 {
     struct sockaddr_un nssaddr;
     bool inprogress = true;
@@ -615,7 +670,7 @@ static int sss_cli_open_socket(int *errnop, const char *socket_name)
         return -1;
     }
 
-    ret = fstat(sd, &sss_cli_sb);
+    ret = fstat(sd, sb);
     if (ret != 0) {
         close(sd);
         return -1;
@@ -624,33 +679,34 @@ static int sss_cli_open_socket(int *errnop, const char *socket_name)
     return sd;
 }
 
-static enum sss_status sss_cli_check_socket(int *errnop, const char *socket_name)
+static enum sss_status sss_cli_check_socket(struct sss_cli_conn *conn,
+                                           int *errnop,
+                                           const char *socket_name)
 {
-    static pid_t mypid;
     struct stat mysb;
     int mysd;
     int ret;
 
-    if (getpid() != mypid) {
-        ret = fstat(sss_cli_sd, &mysb);
+    if (getpid() != conn->pid) {
+        ret = fstat(conn->sd, &mysb);
         if (ret == 0) {
             if (S_ISSOCK(mysb.st_mode) &&
-                mysb.st_dev == sss_cli_sb.st_dev &&
-                mysb.st_ino == sss_cli_sb.st_ino) {
-                sss_cli_close_socket();
+                mysb.st_dev == conn->sb.st_dev &&
+                mysb.st_ino == conn->sb.st_ino) {
+                sss_cli_conn_close(conn);
             }
         }
-        sss_cli_sd = -1;
-        mypid = getpid();
+        conn->sd = -1;
+        conn->pid = getpid();
     }
 
     /* check if the socket has been closed on the other side */
-    if (sss_cli_sd != -1) {
+    if (conn->sd != -1) {
         struct pollfd pfd;
         int res, error;
 
         *errnop = 0;
-        pfd.fd = sss_cli_sd;
+        pfd.fd = conn->sd;
         pfd.events = POLLIN | POLLOUT;
 
         do {
@@ -687,42 +743,62 @@ static enum sss_status sss_cli_check_socket(int *errnop, const char *socket_name
             return SSS_STATUS_SUCCESS;
         }
 
-        sss_cli_close_socket();
+        sss_cli_conn_close(conn);
     }
 
-    mysd = sss_cli_open_socket(errnop, socket_name);
+    mysd = sss_cli_open_socket(errnop, socket_name, &conn->sb);
     if (mysd == -1) {
         return SSS_STATUS_UNAVAIL;
     }
 
-    sss_cli_sd = mysd;
+    conn->sd = mysd;
 
-    if (sss_cli_check_version(socket_name)) {
+    if (sss_cli_check_version(conn, socket_name)) {
         return SSS_STATUS_SUCCESS;
     }
 
-    sss_cli_close_socket();
+    sss_cli_conn_close(conn);
     *errnop = EFAULT;
     return SSS_STATUS_UNAVAIL;
 }
 
-/* this function will check command codes match and returned length is ok */
-/* repbuf and replen report only the data section not the header */
-enum nss_status sss_nss_make_request(enum sss_cli_command cmd,
-                      struct sss_cli_req_data *rd,
-                      uint8_t **repbuf, size_t *replen,
-                      int *errnop)
+#if HAVE_PTHREAD
+/* The responder keeps the state of set/get/end*ent enumerations per client
+ * connection, so these commands must always use the same connection and
+ * their callers serialize on sss_nss_lock(). Everything else is a self
+ * contained lookup and can use any connection. */
+static bool sss_nss_cmd_needs_state(enum sss_cli_command cmd)
 {
-    enum sss_status ret;
-    char *envval;
-
-    /* avoid looping in the nss daemon */
-    envval = getenv("_SSS_LOOPS");
-    if (envval && strcmp(envval, "NO") == 0) {
-        return NSS_STATUS_NOTFOUND;
+    switch (cmd) {
+    case SSS_NSS_SETPWENT:
+    case SSS_NSS_GETPWENT:
+    case SSS_NSS_ENDPWENT:
+    case SSS_NSS_SETGRENT:
+    case SSS_NSS_GETGRENT:
+    case SSS_NSS_ENDGRENT:
+    case SSS_NSS_SETNETGRENT:
+    case SSS_NSS_GETNETGRENT:
+    case SSS_NSS_ENDNETGRENT:
+    case SSS_NSS_SETSERVENT:
+    case SSS_NSS_GETSERVENT:
+    case SSS_NSS_ENDSERVENT:
+        return true;
+    default:
+        return false;
     }
+}
+#endif
 
-    ret = sss_cli_check_socket(errnop, SSS_NSS_SOCKET_NAME);
+static enum nss_status sss_nss_make_request_conn(struct sss_cli_conn *conn,
+                                                 enum sss_cli_command cmd,
+                                                 struct sss_cli_req_data *rd,
+                                                 uint8_t **repbuf,
+                                                 size_t *replen,
+                                                 int *errnop)
+{
+    enum sss_status ret;
+
+    ret = sss_cli_check_socket(conn, errnop, SSS_NSS_SOCKET_NAME);
     if (ret != SSS_STATUS_SUCCESS) {
 #ifdef NONSTANDARD_SSS_NSS_BEHAVIOUR
         *errnop = 0;
@@ -733,10 +809,10 @@ enum nss_status sss_nss_make_request(enum sss_cli_command cmd,
 #endif
     }
 
-    ret = sss_cli_make_request_nochecks(cmd, rd, repbuf, replen, errnop);
+    ret = sss_cli_make_request_nochecks(conn, cmd, rd, repbuf, replen, errnop);
     if (ret == SSS_STATUS_UNAVAIL && *errnop == EPIPE) {
         /* try reopen socket */
-        ret = sss_cli_check_socket(errnop, SSS_NSS_SOCKET_NAME);
+        ret = sss_cli_check_socket(conn, errnop, SSS_NSS_SOCKET_NAME);
         if (ret != SSS_STATUS_SUCCESS) {
 #ifdef NONSTANDARD_SSS_NSS_BEHAVIOUR
             *errnop = 0;
@@ -748,7 +824,8 @@ enum nss_status sss_nss_make_request(enum sss_cli_command cmd,
         }
 
         /* and make request one more time */
-        ret = sss_cli_make_request_nochecks(cmd, rd, repbuf, replen, errnop);
+        ret = sss_cli_make_request_nochecks(conn, cmd, rd,
+                                            repbuf, replen, errnop);
     }
     switch (ret) {
     case SSS_STATUS_TRYAGAIN:
@@ -767,12 +844,325 @@ enum nss_status sss_nss_make_request(enum sss_cli_command cmd,
     }
 }
 
+/* this function will check command codes match and returned length is ok */
+/* repbuf and replen report only the data section not the header */
+enum nss_status sss_nss_make_request(enum sss_cli_command cmd,
+                      struct sss_cli_req_data *rd,
+                      uint8_t **repbuf, size_t *replen,
+                      int *errnop)
+{
+    enum nss_status nret;
+    char *envval;
+#if HAVE_PTHREAD
+    struct sss_nss_pool_conn *pc;
+#endif
+
+    /* avoid looping in the nss daemon */
+    envval = getenv("_SSS_LOOPS");
+    if (envval && strcmp(envval, "NO") == 0) {
+        return NSS_STATUS_NOTFOUND;
+    }
+
+#if HAVE_PTHREAD
+    if (!sss_nss_cmd_needs_state(cmd)) {
+        pc = sss_nss_pool_get();
+        nret = sss_nss_make_request_conn(&pc->conn, cmd, rd,
+                                         repbuf, replen, errnop);
+        sss_nss_pool_put(pc);
+        return nret;
+    }
+#endif
+
+    /* the caller holds sss_nss_lock() */
+    nret = sss_nss_make_request_conn(&sss_cli_conn, cmd, rd,
+                                     repbuf, replen, errnop);
+    return nret;
+}
+
+/* Writes all requests and reads the replies as they arrive, the tag of
+ * each request is its index in reqs */
+static enum sss_status sss_cli_make_request_mux(struct sss_cli_conn *conn,
+                                                struct sss_cli_mux_req *reqs,
+                                                size_t num_reqs,
+                                                int *errnop)
+{
+    uint32_t sheader[4];
+    uint32_t rheader[4];
+    size_t sent_reqs = 0;
+    size_t datasent = 0;
+    size_t done_reqs = 0;
+    size_t datarecv = 0;
+    uint8_t *buf = NULL;
+    uint8_t *done = NULL;
+    struct sss_cli_req_data *rd;
+    enum sss_status ret;
+    size_t i;
+
+    done = calloc(num_reqs, sizeof(uint8_t));
+    if (done == NULL) {
+        *errnop = ENOMEM;
+        return SSS_STATUS_UNAVAIL;
+    }
+
+    for (i = 0; i < num_reqs; i++) {
+        reqs[i].repbuf = NULL;
+        reqs[i].replen = 0;
+        reqs[i].error = 0;
+    }
+
+    while (done_reqs < num_reqs) {
+        struct pollfd pfd;
+        int res, error;
+
+        *errnop = 0;
+        pfd.fd = conn->sd;
+        pfd.events = POLLIN;
+        if (sent_reqs < num_reqs) {
+            pfd.events |= POLLOUT;
+        }
+
+        do {
+            errno = 0;
+            res = poll(&pfd, 1, SSS_CLI_SOCKET_TIMEOUT);
+            error = errno;
+        } while (error == EINTR);
+
+        switch (res) {
+        case -1:
+            *errnop = error;
+            break;
+        case 0:
+            *errnop = ETIME;
+            break;
+        case 1:
+            if (pfd.revents & (POLLERR | POLLNVAL)) {
+                *errnop = EPIPE;
+            }
+            if ((pfd.revents & POLLHUP) && !(pfd.revents & POLLIN)) {
+                *errnop = EPIPE;
+            }
+            break;
+        default: /* more than one avail ?? */
+            *errnop = EBADF;
+            break;
+        }
+        if (*errnop) {
+            ret = SSS_STATUS_UNAVAIL;
+            goto failed;
+        }
+
+        if ((pfd.revents & POLLOUT) && sent_reqs < num_reqs) {
+            rd = reqs[sent_reqs].rd;
+            sheader[0] = SSS_NSS_HEADER_SIZE + (rd?rd->len:0);
+            sheader[1] = reqs[sent_reqs].cmd;
+            sheader[2] = 0;
+            sheader[3] = sent_reqs;
+
+            errno = 0;
+            if (datasent < SSS_NSS_HEADER_SIZE) {
+                res = send(conn->sd,
+                           (char *)sheader + datasent,
+                           SSS_NSS_HEADER_SIZE - datasent,
+                           SSS_DEFAULT_WRITE_FLAGS);
+            } else {
+                res = send(conn->sd,
+                           (const char *)rd->data
+                                        + (datasent - SSS_NSS_HEADER_SIZE),
+                           sheader[0] - datasent,
+                           SSS_DEFAULT_WRITE_FLAGS);
+            }
+            error = errno;
+
+            if (res == -1 || res == 0) {
+                if (error != EINTR && error != EAGAIN) {
+                    *errnop = error;
+                    ret = SSS_STATUS_UNAVAIL;
+                    goto failed;
+                }
+            } else {
+                datasent += res;
+                if (datasent == sheader[0]) {
+                    sent_reqs++;
+                    datasent = 0;
+                }
+            }
+        }
+
+        if (!(pfd.revents & POLLIN)) {
+            continue;
+        }
+
+        errno = 0;
+        if (datarecv < SSS_NSS_HEADER_SIZE) {
+            res = read(conn->sd,
+                       (char *)rheader + datarecv,
+                       SSS_NSS_HEADER_SIZE - datarecv);
+        } else {
+            res = read(conn->sd,
+                       (char *)buf + (datarecv - SSS_NSS_HEADER_SIZE),
+                       rheader[0] - datarecv);
+        }
+        error = errno;
+
+        if (res == -1 || res == 0) {
+            if (res == -1 && (error == EINTR || error == EAGAIN)) {
+                continue;
+            }
+            /* the responder closed the connection or the read failed */
+            *errnop = (res == 0) ? EPIPE : error;
+            ret = SSS_STATUS_UNAVAIL;
+            goto failed;
+        }
+
+        datarecv += res;
+
+        if (datarecv == SSS_NSS_HEADER_SIZE && buf == NULL) {
+            if (rheader[3] >= num_reqs || done[rheader[3]]
+                    || rheader[1] != reqs[rheader[3]].cmd
+                    || rheader[0] < SSS_NSS_HEADER_SIZE) {
+                /* not a reply to any of our requests */
+                *errnop = EBADMSG;
+                ret = SSS_STATUS_UNAVAIL;
+                goto failed;
+            }
+            if (rheader[0] > SSS_NSS_HEADER_SIZE) {
+                buf = malloc(rheader[0] - SSS_NSS_HEADER_SIZE);
+                if (buf == NULL) {
+                    *errnop = ENOMEM;
+                    ret = SSS_STATUS_UNAVAIL;
+                    goto failed;
+                }
+            }
+        }
+
+        if (datarecv < SSS_NSS_HEADER_SIZE || datarecv < rheader[0]) {
+            continue;
+        }
+
+        /* a complete reply was read */
+        i = rheader[3];
+        reqs[i].error = rheader[2];
+        if (rheader[2] == 0 && buf != NULL) {
+            reqs[i].repbuf = buf;
+            reqs[i].replen = rheader[0] - SSS_NSS_HEADER_SIZE;
+        } else {
+            free(buf);
+        }
+        buf = NULL;
+        datarecv = 0;
+        done[i] = 1;
+        done_reqs++;
+    }
+
+    free(done);
+    return SSS_STATUS_SUCCESS;
+
+failed:
+    sss_cli_conn_close(conn);
+    for (i = 0; i < num_reqs; i++) {
+        free(reqs[i].repbuf);
+        reqs[i].repbuf = NULL;
+        reqs[i].replen = 0;
+    }
+    free(buf);
+    free(done);
+    return ret;
+}
+
+enum nss_status sss_nss_make_request_mux(struct sss_cli_mux_req *reqs,
+                                         size_t num_reqs,
+                                         int *errnop)
+{
+    struct sss_cli_conn *conn;
+    enum sss_status ret;
+    enum nss_status nret;
+    char *envval;
+    size_t i;
+#if HAVE_PTHREAD
+    struct sss_nss_pool_conn *pc;
+#endif
+
+    /* avoid looping in the nss daemon */
+    envval = getenv("_SSS_LOOPS");
+    if (envval && strcmp(envval, "NO") == 0) {
+        return NSS_STATUS_NOTFOUND;
+    }
+
+#if HAVE_PTHREAD
+    for (i = 0; i < num_reqs; i++) {
+        if (sss_nss_cmd_needs_state(reqs[i].cmd)) {
+            *errnop = EINVAL;
+            return NSS_STATUS_UNAVAIL;
+        }
+    }
+
+    pc = sss_nss_pool_get();
+    conn = &pc->conn;
+#else
+    sss_nss_lock();
+    conn = &sss_cli_conn;
+#endif
+
+    ret = sss_cli_check_socket(conn, errnop, SSS_NSS_SOCKET_NAME);
+    if (ret != SSS_STATUS_SUCCESS) {
+        nret = NSS_STATUS_UNAVAIL;
+        goto done;
+    }
+
+    if (conn->version < SSS_NSS_PROTOCOL_VERSION_MUX) {
+        /* one request at a time, a server side error of one request is
+         * reported in its error field like with the multiplexed protocol */
+        for (i = 0; i < num_reqs; i++) {
+            reqs[i].repbuf = NULL;
+            reqs[i].replen = 0;
+            reqs[i].error = 0;
+        }
+        for (i = 0; i < num_reqs; i++) {
+            nret = sss_nss_make_request_conn(conn, reqs[i].cmd, reqs[i].rd,
+                                             &reqs[i].repbuf,
+                                             &reqs[i].replen, errnop);
+            if (nret == NSS_STATUS_SUCCESS) {
+                continue;
+            }
+            if (*errnop == 0) {
+                /* NONSTANDARD_SSS_NSS_BEHAVIOUR hides the error */
+                reqs[i].error = ENOENT;
+                continue;
+            }
+            reqs[i].error = *errnop;
+        }
+        *errnop = 0;
+        nret = NSS_STATUS_SUCCESS;
+        goto done;
+    }
+
+    ret = sss_cli_make_request_mux(conn, reqs, num_reqs, errnop);
+    if (ret == SSS_STATUS_UNAVAIL && *errnop == EPIPE) {
+        /* the connection was closed by the responder, try once more */
+        ret = sss_cli_check_socket(conn, errnop, SSS_NSS_SOCKET_NAME);
+        if (ret == SSS_STATUS_SUCCESS) {
+            ret = sss_cli_make_request_mux(conn, reqs, num_reqs, errnop);
+        }
+    }
+
+    nret = (ret == SSS_STATUS_SUCCESS) ? NSS_STATUS_SUCCESS
+                                       : NSS_STATUS_UNAVAIL;
+
+done:
+#if HAVE_PTHREAD
+    sss_nss_pool_put(pc);
+#else
+    sss_nss_unlock();
+#endif
+    return nret;
+}
+
 int sss_pac_check_and_open(void)
 {
     enum sss_status ret;
     int errnop;
 
-    ret = sss_cli_check_socket(&errnop, SSS_PAC_SOCKET_NAME);
+    ret = sss_cli_check_socket(&sss_cli_conn, &errnop, SSS_PAC_SOCKET_NAME);
     if (ret != SSS_STATUS_SUCCESS) {
         return EIO;
     }
@@ -794,21 +1184,21 @@ int sss_pac_make_request(enum sss_cli_command cmd,
         return NSS_STATUS_NOTFOUND;
     }
 
-    ret = sss_cli_check_socket(errnop, SSS_PAC_SOCKET_NAME);
+    ret = sss_cli_check_socket(&sss_cli_conn, errnop, SSS_PAC_SOCKET_NAME);
     if (ret != SSS_STATUS_SUCCESS) {
         return NSS_STATUS_UNAVAIL;
     }
 
-    ret = sss_cli_make_request_nochecks(cmd, rd, repbuf, replen, errnop);
+    ret = sss_cli_make_request_nochecks(&sss_cli_conn, cmd, rd, repbuf, replen, errnop);
     if (ret == SSS_STATUS_UNAVAIL && *errnop == EPIPE) {
         /* try reopen socket */
-        ret = sss_cli_check_socket(errnop, SSS_PAC_SOCKET_NAME);
+        ret = sss_cli_check_socket(&sss_cli_conn, errnop, SSS_PAC_SOCKET_NAME);
         if (ret != SSS_STATUS_SUCCESS) {
             return NSS_STATUS_UNAVAIL;
         }
 
         /* and make request one more time */
-        ret = sss_cli_make_request_nochecks(cmd, rd, repbuf, replen, errnop);
+        ret = sss_cli_make_request_nochecks(&sss_cli_conn, cmd, rd, repbuf, replen, errnop);
     }
     switch (ret) {
     case SSS_STATUS_TRYAGAIN:
@@ -899,31 +1289,31 @@ int sss_pam_make_request(enum sss_cli_command cmd,
         }
     }
 
-    status = sss_cli_check_socket(errnop, socket_name);
+    status = sss_cli_check_socket(&sss_cli_conn, errnop, socket_name);
     if (status != SSS_STATUS_SUCCESS) {
         ret = PAM_SERVICE_ERR;
         goto out;
     }
 
-    error = check_server_cred(sss_cli_sd);
+    error = check_server_cred(sss_cli_conn.sd);
     if (error != 0) {
-        sss_cli_close_socket();
+        sss_cli_conn_close(&sss_cli_conn);
         *errnop = error;
         ret = PAM_SERVICE_ERR;
         goto out;
     }
 
-    status = sss_cli_make_request_nochecks(cmd, rd, repbuf, replen, errnop);
+    status = sss_cli_make_request_nochecks(&sss_cli_conn, cmd, rd, repbuf, replen, errnop);
     if (status == SSS_STATUS_UNAVAIL && *errnop == EPIPE) {
         /* try reopen socket */
-        status = sss_cli_check_socket(errnop, socket_name);
+        status = sss_cli_check_socket(&sss_cli_conn, errnop, socket_name);
         if (status != SSS_STATUS_SUCCESS) {
             ret = PAM_SERVICE_ERR;
             goto out;
         }
 
         /* and make request one more time */
-        status = sss_cli_make_request_nochecks(cmd, rd, repbuf, replen, errnop);
+        status = sss_cli_make_request_nochecks(&sss_cli_conn, cmd, rd, repbuf, replen, errnop);
     }
 
     if (status == SSS_STATUS_SUCCESS) {
@@ -941,10 +1331,7 @@ void sss_pam_close_fd(void)
 {
     sss_pam_lock();
 
-    if (sss_cli_sd != -1) {
-        close(sss_cli_sd);
-        sss_cli_sd = -1;
-    }
+    sss_cli_conn_close(&sss_cli_conn);
 
     sss_pam_unlock();
 }
@@ -958,21 +1345,21 @@ sss_cli_make_request_with_checks(enum sss_cli_command cmd,
 {
     enum sss_status ret = SSS_STATUS_UNAVAIL;
 
-    ret = sss_cli_check_socket(errnop, socket_name);
+    ret = sss_cli_check_socket(&sss_cli_conn, errnop, socket_name);
     if (ret != SSS_STATUS_SUCCESS) {
         return SSS_STATUS_UNAVAIL;
     }
 
-    ret = sss_cli_make_request_nochecks(cmd, rd, repbuf, replen, errnop);
+    ret = sss_cli_make_request_nochecks(&sss_cli_conn, cmd, rd, repbuf, replen, errnop);
     if (ret == SSS_STATUS_UNAVAIL && *errnop == EPIPE) {
         /* try reopen socket */
-        ret = sss_cli_check_socket(errnop, socket_name);
+        ret = sss_cli_check_socket(&sss_cli_conn, errnop, socket_name);
         if (ret != SSS_STATUS_SUCCESS) {
             return SSS_STATUS_UNAVAIL;
         }
 
         /* and make request one more time */
-        ret = sss_cli_make_request_nochecks(cmd, rd, repbuf, replen, errnop);
+        ret = sss_cli_make_request_nochecks(&sss_cli_conn, cmd, rd, repbuf, replen, errnop);
     }
 
     return ret;
@@ -1135,7 +1522,7 @@ static void sss_mt_lock(struct sss_mutex *m)
 {
     pthread_once(&m->once, m->init);
     if (pthread_mutex_lock(&m->mtx) == EOWNERDEAD) {
-        sss_cli_close_socket();
+        sss_cli_conn_close(&sss_cli_conn);
         sss_mutex_consistent(&m->mtx);
     }
 }
@@ -1187,6 +1574,85 @@ void sss_nss_mc_unlock(void)
     sss_mt_unlock(&sss_nss_mc_mtx);
 }
 
+/* NSS connection pool */
+static void sss_nss_pool_mt_init(pthread_mutex_t *mtx)
+{
+    pthread_mutexattr_t attr;
+
+    if (pthread_mutexattr_init(&attr) != 0) {
+        pthread_mutex_init(mtx, NULL);
+        return;
+    }
+    sss_mutexattr_setrobust(&attr);
+    pthread_mutex_init(mtx, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+static void sss_nss_pool_atfork_child(void)
+{
+    int i;
+
+    /* threads holding a connection of the parent do not exist in the
+     * child, the sockets are reopened by sss_cli_check_socket() */
+    for (i = 0; i < SSS_NSS_POOL_SIZE; i++) {
+        sss_nss_pool_mt_init(&sss_nss_pool[i].mtx);
+    }
+}
+
+static void sss_nss_pool_init(void)
+{
+    int i;
+
+    for (i = 0; i < SSS_NSS_POOL_SIZE; i++) {
+        sss_nss_pool_mt_init(&sss_nss_pool[i].mtx);
+    }
+
+    pthread_atfork(NULL, NULL, sss_nss_pool_atfork_child);
+}
+
+static struct sss_nss_pool_conn *sss_nss_pool_acquired(unsigned int idx,
+                                                       int lockret)
+{
+    if (lockret == EOWNERDEAD) {
+        /* the previous owner died in the middle of a request */
+        sss_cli_conn_close(&sss_nss_pool[idx].conn);
+        sss_mutex_consistent(&sss_nss_pool[idx].mtx);
+    }
+
+    return &sss_nss_pool[idx];
+}
+
+/* Returns the first idle connection of the pool. If all of them are busy
+ * the caller waits for one of them; each call starts the search at the next
+ * connection so that waiting threads do not all queue on the same one. */
+static struct sss_nss_pool_conn *sss_nss_pool_get(void)
+{
+    static unsigned int next;
+    unsigned int start;
+    unsigned int idx;
+    unsigned int i;
+    int ret;
+
+    pthread_once(&sss_nss_pool_once, sss_nss_pool_init);
+
+    start = __sync_fetch_and_add(&next, 1) % SSS_NSS_POOL_SIZE;
+    for (i = 0; i < SSS_NSS_POOL_SIZE; i++) {
+        idx = (start + i) % SSS_NSS_POOL_SIZE;
+        ret = pthread_mutex_trylock(&sss_nss_pool[idx].mtx);
+        if (ret == 0 || ret == EOWNERDEAD) {
+            return sss_nss_pool_acquired(idx, ret);
+        }
+    }
+
+    ret = pthread_mutex_lock(&sss_nss_pool[start].mtx);
+    return sss_nss_pool_acquired(start, ret);
+}
+
+static void sss_nss_pool_put(struct sss_nss_pool_conn *pc)
+{
+    pthread_mutex_unlock(&pc->mtx);
+}
+
 #else
 
 /* sorry no mutexes available */
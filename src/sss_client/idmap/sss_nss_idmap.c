@@ -27,10 +27,16 @@
 #include <nss.h>
 
 #include "sss_client/sss_cli.h"
+#include "sss_client/nss_mc.h"
 #include "sss_client/idmap/sss_nss_idmap.h"
 #include "util/strtonum.h"
 
 #define DATA_START (3 * sizeof(uint32_t))
+
+/* the responders do not accept requests longer than 1024 bytes, longer
+ * batches are split into several requests */
+#define BATCH_MAX_DATA (1024 - SSS_NSS_HEADER_SIZE)
+#define BATCH_HEADER_SIZE (2 * sizeof(uint32_t))
 union input {
     const char *str;
     uint32_t id;
@@ -152,6 +158,7 @@ static int sss_nss_getyyybyxxx(union input inp, enum sss_cli_command cmd ,
     char *str = NULL;
     size_t data_len;
     uint32_t c;
+    uint32_t type;
     struct sss_nss_kv *kv_list;
 
     switch (cmd) {
@@ -177,7 +184,26 @@ static int sss_nss_getyyybyxxx(union input inp, enum sss_cli_command cmd ,
         return EINVAL;
     }
 
-    sss_nss_lock();
+    switch (cmd) {
+    case SSS_NSS_GETSIDBYNAME:
+        ret = sss_nss_mc_getsidbyname(inp.str, inp_len, &out->d.str, &type);
+        break;
+    case SSS_NSS_GETNAMEBYSID:
+        ret = sss_nss_mc_getbysid(inp.str, inp_len, &out->d.str, NULL, &type);
+        break;
+    case SSS_NSS_GETIDBYSID:
+        ret = sss_nss_mc_getbysid(inp.str, inp_len, NULL, &out->d.id, &type);
+        break;
+    default:
+        /* not available in the mmap cache */
+        ret = ENOENT;
+        break;
+    }
+    if (ret == EOK) {
+        out->type = type;
+        return EOK;
+    }
+    /* otherwise fall back to socket based comms */
 
     nret = sss_nss_make_request(cmd, &rd, &repbuf, &replen, &errnop);
     if (nret != NSS_STATUS_SUCCESS) {
@@ -252,7 +278,6 @@ static int sss_nss_getyyybyxxx(union input inp, enum sss_cli_command cmd ,
     ret = EOK;
 
 done:
-    sss_nss_unlock();
     free(repbuf);
     if (ret != EOK) {
         free(str);
@@ -368,3 +393,258 @@ int sss_nss_getorigbyname(const char *fq_name, struct sss_nss_kv **kv_list,
 
     return ret;
 }
+
+void sss_nss_free_batch(struct sss_nss_batch_result *results, size_t num)
+{
+    size_t c;
+
+    if (results != NULL) {
+        for (c = 0; c < num; c++) {
+            free(results[c].fq_name);
+            free(results[c].sid);
+        }
+        free(results);
+    }
+}
+
+static int batch_key_len(enum sss_nss_key_type key_type, const void *keys,
+                         size_t idx, size_t *_len)
+{
+    const char *str;
+    size_t len;
+    int ret;
+
+    switch (key_type) {
+    case SSS_NSS_KEY_UID:
+    case SSS_NSS_KEY_GID:
+        *_len = sizeof(uint32_t);
+        return EOK;
+    case SSS_NSS_KEY_NAME:
+    case SSS_NSS_KEY_SID:
+        str = ((const char * const *) keys)[idx];
+        if (str == NULL || *str == '\0') {
+            return EINVAL;
+        }
+
+        ret = sss_strnlen(str, SSS_NAME_MAX, &len);
+        if (ret != EOK) {
+            return EINVAL;
+        }
+        *_len = len + 1;
+        return EOK;
+    }
+
+    return EINVAL;
+}
+
+/* Reads the results of one request into results[0] to results[num - 1] */
+static int batch_parse_reply(uint8_t *repbuf, size_t replen, size_t num,
+                             struct sss_nss_batch_result *results)
+{
+    uint32_t num_results;
+    uint32_t error;
+    uint32_t type;
+    uint32_t id;
+    const char *name;
+    const char *sid;
+    size_t rp = 0;
+    size_t c;
+
+    if (replen < BATCH_HEADER_SIZE) {
+        return EBADMSG;
+    }
+
+    SAFEALIGN_COPY_UINT32(&num_results, repbuf, &rp);
+    if (num_results != num) {
+        return EBADMSG;
+    }
+    rp += sizeof(uint32_t); /* reserved */
+
+    for (c = 0; c < num; c++) {
+        if (replen - rp < 3 * sizeof(uint32_t)) {
+            return EBADMSG;
+        }
+        SAFEALIGN_COPY_UINT32(&error, repbuf + rp, &rp);
+        SAFEALIGN_COPY_UINT32(&type, repbuf + rp, &rp);
+        SAFEALIGN_COPY_UINT32(&id, repbuf + rp, &rp);
+
+        name = (const char *) repbuf + rp;
+        if (memchr(name, '\0', replen - rp) == NULL) {
+            return EBADMSG;
+        }
+        rp += strlen(name) + 1;
+
+        sid = (const char *) repbuf + rp;
+        if (rp >= replen || memchr(sid, '\0', replen - rp) == NULL) {
+            return EBADMSG;
+        }
+        rp += strlen(sid) + 1;
+
+        results[c].error = error;
+        if (error != EOK) {
+            continue;
+        }
+
+        results[c].type = type;
+        results[c].id = id;
+
+        results[c].fq_name = strdup(name);
+        if (results[c].fq_name == NULL) {
+            return ENOMEM;
+        }
+
+        if (*sid != '\0') {
+            results[c].sid = strdup(sid);
+            if (results[c].sid == NULL) {
+                return ENOMEM;
+            }
+        }
+    }
+
+    if (rp != replen) {
+        return EBADMSG;
+    }
+
+    return EOK;
+}
+
+/* Packs as many keys as possible into each request and sends all requests
+ * at once */
+static int sss_nss_getbatch(enum sss_nss_key_type key_type, const void *keys,
+                            size_t num, struct sss_nss_batch_result **_results)
+{
+    struct sss_nss_batch_result *results = NULL;
+    struct sss_cli_mux_req *reqs = NULL;
+    struct sss_cli_req_data *rd = NULL;
+    size_t *first = NULL;
+    uint8_t *data;
+    size_t num_reqs = 0;
+    size_t data_len;
+    size_t key_len;
+    size_t next;
+    size_t c;
+    size_t k;
+    uint32_t num_keys;
+    uint32_t type = key_type;
+    enum nss_status nret;
+    int errnop;
+    int ret;
+
+    if (keys == NULL || num == 0 || _results == NULL) {
+        return EINVAL;
+    }
+
+    results = calloc(num, sizeof(struct sss_nss_batch_result));
+    /* in the worst case every key needs its own request */
+    reqs = calloc(num, sizeof(struct sss_cli_mux_req));
+    rd = calloc(num, sizeof(struct sss_cli_req_data));
+    first = calloc(num + 1, sizeof(size_t));
+    if (results == NULL || reqs == NULL || rd == NULL || first == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    for (k = 0; k < num; k = next) {
+        data_len = BATCH_HEADER_SIZE;
+        for (next = k; next < num; next++) {
+            ret = batch_key_len(key_type, keys, next, &key_len);
+            if (ret != EOK) {
+                goto done;
+            }
+            if (data_len + key_len > BATCH_MAX_DATA) {
+                break;
+            }
+            data_len += key_len;
+        }
+
+        data = malloc(data_len);
+        if (data == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        num_keys = next - k;
+        c = 0;
+        SAFEALIGN_COPY_UINT32(data, &type, &c);
+        SAFEALIGN_COPY_UINT32(data + c, &num_keys, &c);
+        for (; k < next; k++) {
+            batch_key_len(key_type, keys, k, &key_len);
+            if (key_type == SSS_NSS_KEY_UID || key_type == SSS_NSS_KEY_GID) {
+                SAFEALIGN_COPY_UINT32(data + c, &((const uint32_t *) keys)[k],
+                                      &c);
+            } else {
+                memcpy(data + c, ((const char * const *) keys)[k], key_len);
+                c += key_len;
+            }
+        }
+
+        rd[num_reqs].len = data_len;
+        rd[num_reqs].data = data;
+        reqs[num_reqs].cmd = SSS_NSS_GETBATCH;
+        reqs[num_reqs].rd = &rd[num_reqs];
+        first[num_reqs + 1] = next;
+        num_reqs++;
+    }
+
+    nret = sss_nss_make_request_mux(reqs, num_reqs, &errnop);
+    if (nret != NSS_STATUS_SUCCESS) {
+        ret = nss_status_to_errno(nret);
+        goto done;
+    }
+
+    for (c = 0; c < num_reqs; c++) {
+        if (reqs[c].error != EOK) {
+            /* the whole request failed */
+            for (k = first[c]; k < first[c + 1]; k++) {
+                results[k].error = reqs[c].error;
+            }
+            continue;
+        }
+
+        ret = batch_parse_reply(reqs[c].repbuf, reqs[c].replen,
+                                first[c + 1] - first[c], &results[first[c]]);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    *_results = results;
+    results = NULL;
+    ret = EOK;
+
+done:
+    for (c = 0; reqs != NULL && c < num_reqs; c++) {
+        free(reqs[c].repbuf);
+        free((void *) rd[c].data);
+    }
+    sss_nss_free_batch(results, num);
+    free(reqs);
+    free(rd);
+    free(first);
+
+    return ret;
+}
+
+int sss_nss_getbatchbyname(const char * const *fq_names, size_t num,
+                           struct sss_nss_batch_result **results)
+{
+    return sss_nss_getbatch(SSS_NSS_KEY_NAME, fq_names, num, results);
+}
+
+int sss_nss_getbatchbyuid(const uint32_t *uids, size_t num,
+                          struct sss_nss_batch_result **results)
+{
+    return sss_nss_getbatch(SSS_NSS_KEY_UID, uids, num, results);
+}
+
+int sss_nss_getbatchbygid(const uint32_t *gids, size_t num,
+                          struct sss_nss_batch_result **results)
+{
+    return sss_nss_getbatch(SSS_NSS_KEY_GID, gids, num, results);
+}
+
+int sss_nss_getbatchbysid(const char * const *sids, size_t num,
+                          struct sss_nss_batch_result **results)
+{
+    return sss_nss_getbatch(SSS_NSS_KEY_SID, sids, num, results);
+}
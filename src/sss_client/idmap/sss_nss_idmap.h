@@ -42,6 +42,27 @@ struct sss_nss_kv {
     char *value;
 };
 
+/**
+ * Key types of batch lookups
+ */
+enum sss_nss_key_type {
+    SSS_NSS_KEY_NAME = 1,   /* fully qualified user or group name */
+    SSS_NSS_KEY_UID,
+    SSS_NSS_KEY_GID,
+    SSS_NSS_KEY_SID
+};
+
+/**
+ * Result of a single key of a batch lookup
+ */
+struct sss_nss_batch_result {
+    int error;              /* 0 or the error code of this key, e.g. ENOENT */
+    enum sss_id_type type;  /* type of the object */
+    uint32_t id;            /* POSIX ID, 0 if the object has none */
+    char *fq_name;          /* fully qualified name of the object */
+    char *sid;              /* SID of the object, NULL if it has none */
+};
+
 /**
  * @brief Find SID by fully qualified name
  *
@@ -129,4 +150,77 @@ int sss_nss_getorigbyname(const char *fq_name, struct sss_nss_kv **kv_list,
  * @param[in] kv_list Key-value list returned by sss_nss_getorigbyname().
  */
 void sss_nss_free_kv(struct sss_nss_kv *kv_list);
+
+/**
+ * @brief Find users or groups by a list of fully qualified names
+ *
+ * All keys are sent to SSSD with as few requests as possible and are looked
+ * up at the same time, which is much faster than calling
+ * sss_nss_getsidbyname() for each of them.
+ *
+ * @param[in] fq_names  Fully qualified names of users or groups
+ * @param[in] num       Number of names
+ * @param[out] results  Array of num results in the order of the names,
+ *                      must be freed by the caller with sss_nss_free_batch()
+ *
+ * @return
+ *  - 0 (EOK): success, the error field of each result tells if the object
+ *             was found
+ *  - EINVAL: input cannot be parsed or a key is too long
+ *  - ENOMEM: memory allocation failed
+ *  - ENOENT: SSSD is not available
+ *  - EBADMSG: the reply of SSSD cannot be parsed
+ */
+int sss_nss_getbatchbyname(const char * const *fq_names, size_t num,
+                           struct sss_nss_batch_result **results);
+
+/**
+ * @brief Find users by a list of POSIX UIDs
+ *
+ * @param[in] uids      POSIX UIDs
+ * @param[in] num       Number of UIDs
+ * @param[out] results  Array of num results in the order of the UIDs,
+ *                      must be freed by the caller with sss_nss_free_batch()
+ *
+ * @return
+ *  - see #sss_nss_getbatchbyname
+ */
+int sss_nss_getbatchbyuid(const uint32_t *uids, size_t num,
+                          struct sss_nss_batch_result **results);
+
+/**
+ * @brief Find groups by a list of POSIX GIDs
+ *
+ * @param[in] gids      POSIX GIDs
+ * @param[in] num       Number of GIDs
+ * @param[out] results  Array of num results in the order of the GIDs,
+ *                      must be freed by the caller with sss_nss_free_batch()
+ *
+ * @return
+ *  - see #sss_nss_getbatchbyname
+ */
+int sss_nss_getbatchbygid(const uint32_t *gids, size_t num,
+                          struct sss_nss_batch_result **results);
+
+/**
+ * @brief Find users or groups by a list of SIDs
+ *
+ * @param[in] sids      String representations of the SIDs
+ * @param[in] num       Number of SIDs
+ * @param[out] results  Array of num results in the order of the SIDs,
+ *                      must be freed by the caller with sss_nss_free_batch()
+ *
+ * @return
+ *  - see #sss_nss_getbatchbyname
+ */
+int sss_nss_getbatchbysid(const char * const *sids, size_t num,
+                          struct sss_nss_batch_result **results);
+
+/**
+ * @brief Free the results returned by the sss_nss_getbatchby*() calls
+ *
+ * @param[in] results  Results returned by a sss_nss_getbatchby*() call
+ * @param[in] num      Number of results
+ */
+void sss_nss_free_batch(struct sss_nss_batch_result *results, size_t num);
 #endif /* SSS_NSS_IDMAP_H_ */
@@ -270,9 +270,7 @@ static int send_recv(uint8_t **rep, size_t *rep_len, enum sss_cli_command cmd,
     rd.data = req;
     rd.len = req_len;
 
-    sss_nss_lock();
     req_rc = sss_nss_make_request(cmd, &rd, rep, rep_len, &err);
-    sss_nss_unlock();
 
     if (req_rc == NSS_STATUS_NOTFOUND) {
         return ENOENT;
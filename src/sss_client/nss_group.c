@@ -314,30 +314,6 @@ enum nss_status _nss_sss_initgroups_dyn(const char *user, gid_t group,
     rd.len = user_len + 1;
     rd.data = user;
 
-    sss_nss_lock();
-
-    /* previous thread might already initialize entry in mmap cache */
-    ret = sss_nss_mc_initgroups_dyn(user, user_len, group, start, size,
-                                    groups, limit);
-    switch (ret) {
-    case 0:
-        *errnop = 0;
-        nret = NSS_STATUS_SUCCESS;
-        goto out;
-    case ERANGE:
-        *errnop = ERANGE;
-        nret = NSS_STATUS_TRYAGAIN;
-        goto out;
-    case ENOENT:
-        /* fall through, we need to actively ask the parent
-         * if no entry is found */
-        break;
-    default:
-        /* if using the mmaped cache failed,
-         * fall back to socket based comms */
-        break;
-    }
-
     nret = sss_nss_make_request(SSS_NSS_INITGR, &rd,
                                 &repbuf, &replen, errnop);
     if (nret != NSS_STATUS_SUCCESS) {
@@ -389,7 +365,6 @@ enum nss_status _nss_sss_initgroups_dyn(const char *user, gid_t group,
     nret = NSS_STATUS_SUCCESS;
 
 out:
-    sss_nss_unlock();
     return nret;
 }
 
@@ -435,34 +410,21 @@ enum nss_status _nss_sss_getgrnam_r(const char *name, struct group *result,
         break;
     }
 
+    /* the responder may have published that there is no such entry */
+    ret = sss_nss_mc_neg_name(SSS_MC_NEG_GRNAM, name, name_len);
+    if (ret == 0) {
+        *errnop = ENOENT;
+        return NSS_STATUS_NOTFOUND;
+    }
+
     rd.len = name_len + 1;
     rd.data = name;
 
+    /* the reply saved by a previous call that returned ERANGE */
     sss_nss_lock();
-
-    /* previous thread might already initialize entry in mmap cache */
-    ret = sss_nss_mc_getgrnam(name, name_len, result, buffer, buflen);
-    switch (ret) {
-    case 0:
-        *errnop = 0;
-        nret = NSS_STATUS_SUCCESS;
-        goto out;
-    case ERANGE:
-        *errnop = ERANGE;
-        nret = NSS_STATUS_TRYAGAIN;
-        goto out;
-    case ENOENT:
-        /* fall through, we need to actively ask the parent
-         * if no entry is found */
-        break;
-    default:
-        /* if using the mmaped cache failed,
-         * fall back to socket based comms */
-        break;
-    }
-
     nret = sss_nss_get_getgr_cache(name, 0, GETGR_NAME,
                                    &repbuf, &replen, errnop);
+    sss_nss_unlock();
     if (nret == NSS_STATUS_NOTFOUND) {
         nret = sss_nss_make_request(SSS_NSS_GETGRNAM, &rd,
                                     &repbuf, &replen, errnop);
@@ -496,7 +458,9 @@ enum nss_status _nss_sss_getgrnam_r(const char *name, struct group *result,
     len = replen - 8;
     ret = sss_nss_getgr_readrep(&grrep, repbuf+8, &len);
     if (ret == ERANGE) {
+        sss_nss_lock();
         sss_nss_save_getgr_cache(name, 0, GETGR_NAME, &repbuf, replen);
+        sss_nss_unlock();
     } else {
         free(repbuf);
     }
@@ -509,7 +473,6 @@ enum nss_status _nss_sss_getgrnam_r(const char *name, struct group *result,
     nret = NSS_STATUS_SUCCESS;
 
 out:
-    sss_nss_unlock();
     return nret;
 }
 
@@ -546,35 +509,22 @@ enum nss_status _nss_sss_getgrgid_r(gid_t gid, struct group *result,
         break;
     }
 
+    /* the responder may have published that there is no such entry */
+    ret = sss_nss_mc_neg_id(SSS_MC_NEG_GRGID, gid);
+    if (ret == 0) {
+        *errnop = ENOENT;
+        return NSS_STATUS_NOTFOUND;
+    }
+
     group_gid = gid;
     rd.len = sizeof(uint32_t);
     rd.data = &group_gid;
 
+    /* the reply saved by a previous call that returned ERANGE */
     sss_nss_lock();
-
-    /* previous thread might already initialize entry in mmap cache */
-    ret = sss_nss_mc_getgrgid(gid, result, buffer, buflen);
-    switch (ret) {
-    case 0:
-        *errnop = 0;
-        nret = NSS_STATUS_SUCCESS;
-        goto out;
-    case ERANGE:
-        *errnop = ERANGE;
-        nret = NSS_STATUS_TRYAGAIN;
-        goto out;
-    case ENOENT:
-        /* fall through, we need to actively ask the parent
-         * if no entry is found */
-        break;
-    default:
-        /* if using the mmaped cache failed,
-         * fall back to socket based comms */
-        break;
-    }
-
     nret = sss_nss_get_getgr_cache(NULL, gid, GETGR_GID,
                                    &repbuf, &replen, errnop);
+    sss_nss_unlock();
     if (nret == NSS_STATUS_NOTFOUND) {
         nret = sss_nss_make_request(SSS_NSS_GETGRGID, &rd,
                                     &repbuf, &replen, errnop);
@@ -608,7 +558,9 @@ enum nss_status _nss_sss_getgrgid_r(gid_t gid, struct group *result,
     len = replen - 8;
     ret = sss_nss_getgr_readrep(&grrep, repbuf+8, &len);
     if (ret == ERANGE) {
+        sss_nss_lock();
         sss_nss_save_getgr_cache(NULL, gid, GETGR_GID, &repbuf, replen);
+        sss_nss_unlock();
     } else {
         free(repbuf);
     }
@@ -621,7 +573,6 @@ enum nss_status _nss_sss_getgrgid_r(gid_t gid, struct group *result,
     nret = NSS_STATUS_SUCCESS;
 
 out:
-    sss_nss_unlock();
     return nret;
 }
 
@@ -26,6 +26,7 @@
 #include <stdbool.h>
 #include <pwd.h>
 #include <grp.h>
+#include <netdb.h>
 #include "util/mmap_cache.h"
 
 #ifndef HAVE_ERRNO_T
@@ -39,6 +40,11 @@ enum sss_mc_state {
     RECYCLED,
 };
 
+/* Stored in the reserved field of the netgroup entries returned from the
+ * mmap cache, so that getnetgrent() knows it must not ask the responder
+ * for more entries */
+#define SSS_NSS_MC_NETGR_MARK 0xf0cacc0e
+
 /* common stuff */
 struct sss_cli_mc_ctx {
     enum sss_mc_state initialized;
@@ -56,6 +62,9 @@ struct sss_cli_mc_ctx {
     uint32_t ht_size;       /* size of hash table */
 
     uint32_t active_threads; /* count of threads which use memory cache */
+
+    /* lookup counters shared with sss_cache, NULL if not enabled */
+    struct sss_mc_stats_counters *stats;
 };
 
 errno_t sss_nss_mc_get_ctx(const char *name, struct sss_cli_mc_ctx *ctx);
@@ -68,6 +77,8 @@ errno_t sss_nss_str_ptr_from_buffer(char **str, void **cookie,
                                     char *buf, size_t len);
 uint32_t sss_nss_mc_next_slot_with_hash(struct sss_mc_rec *rec,
                                         uint32_t hash);
+void sss_nss_mc_stats_lookup(struct sss_cli_mc_ctx *ctx,
+                             errno_t ret, uint32_t chain_len);
 
 /* passwd db */
 errno_t sss_nss_mc_getpwnam(const char *name, size_t name_len,
@@ -90,4 +101,29 @@ errno_t sss_nss_mc_initgroups_dyn(const char *name, size_t name_len,
                                   gid_t group, long int *start, long int *size,
                                   gid_t **groups, long int limit);
 
+/* netgroup db */
+errno_t sss_nss_mc_setnetgrent(const char *name, size_t name_len,
+                               uint8_t **_entries, size_t *_entries_len);
+
+/* services db */
+errno_t sss_nss_mc_getservbyname(const char *name, size_t name_len,
+                                 const char *protocol, size_t proto_len,
+                                 struct servent *result,
+                                 char *buffer, size_t buflen);
+errno_t sss_nss_mc_getservbyport(int port,
+                                 const char *protocol, size_t proto_len,
+                                 struct servent *result,
+                                 char *buffer, size_t buflen);
+
+/* sid db */
+errno_t sss_nss_mc_getsidbyname(const char *name, size_t name_len,
+                                char **_sid, uint32_t *_type);
+errno_t sss_nss_mc_getbysid(const char *sid, size_t sid_len,
+                            char **_name, uint32_t *_id, uint32_t *_type);
+
+/* negative records, return 0 if the entry is known not to exist */
+errno_t sss_nss_mc_neg_name(const char *prefix,
+                            const char *name, size_t name_len);
+errno_t sss_nss_mc_neg_id(const char *prefix, uint32_t id);
+
 #endif /* _NSS_MC_H_ */
@@ -30,6 +30,7 @@
 #include <sys/mman.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 #include "nss_mc.h"
 #include "sss_cli.h"
 #include "util/io.h"
@@ -55,6 +56,128 @@ do { \
     } \
 } while(0)
 
+/* Lookup statistics are counted in the process and reported to the
+ * responder, which owns the file the statistics are read from. The
+ * reports piggyback on lookups that have to ask the responder anyway,
+ * at most once per SSS_MC_STATS_REPORT_INTERVAL seconds. */
+#define SSS_MC_STATS_REPORT_INTERVAL 10
+
+static struct sss_mc_stats_counters stats_pending[SSS_MC_STATS_NUM];
+static time_t stats_reported;
+
+static struct sss_mc_stats_counters *sss_nss_mc_stats_get(const char *name)
+{
+    static const char *names[] = SSS_MC_STATS_NAMES;
+    int idx;
+    int ret;
+
+    for (idx = 0; idx < SSS_MC_STATS_NUM; idx++) {
+        if (strcmp(names[idx], name) == 0) {
+            break;
+        }
+    }
+    if (idx == SSS_MC_STATS_NUM) {
+        return NULL;
+    }
+
+    /* the responder only creates the file if statistics are enabled */
+    ret = access(SSS_NSS_MCACHE_DIR"/"SSS_MC_STATS_FILE, F_OK);
+    if (ret == -1) {
+        return NULL;
+    }
+
+    return &stats_pending[idx];
+}
+
+static void sss_nss_mc_stats_report(void)
+{
+    struct sss_mc_stats_report report;
+    struct sss_cli_req_data rd;
+    uint64_t *pending;
+    uint64_t *counters;
+    time_t last;
+    time_t now;
+    size_t i;
+    int errnop;
+
+    now = time(NULL);
+    last = __atomic_load_n(&stats_reported, __ATOMIC_RELAXED);
+    if (now - last < SSS_MC_STATS_REPORT_INTERVAL) {
+        return;
+    }
+
+    /* only one thread reports */
+    if (!__atomic_compare_exchange_n(&stats_reported, &last, now, false,
+                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    report.vno = SSS_MC_STATS_VNO;
+    report.num_caches = SSS_MC_STATS_NUM;
+
+    pending = (uint64_t *)stats_pending;
+    counters = (uint64_t *)report.caches;
+    for (i = 0; i < SSS_MC_STATS_COUNTERS; i++) {
+        counters[i] = __atomic_exchange_n(&pending[i], 0, __ATOMIC_RELAXED);
+    }
+
+    rd.len = sizeof(report);
+    rd.data = &report;
+
+    /* statistics are best effort, the counts are lost on failure */
+    (void)sss_nss_make_request(SSS_NSS_MC_STATS, &rd, NULL, NULL, &errnop);
+}
+
+static int sss_nss_mc_stats_bucket(uint32_t chain_len)
+{
+    int bucket;
+
+    if (chain_len < 4) {
+        return chain_len;
+    }
+
+    /* 4-7, 8-15, 16-31, 32+ */
+    for (bucket = 4; chain_len >= 8 && bucket < SSS_MC_STATS_CHAIN_BUCKETS - 1;
+         bucket++) {
+        chain_len >>= 1;
+    }
+
+    return bucket;
+}
+
+void sss_nss_mc_stats_lookup(struct sss_cli_mc_ctx *ctx,
+                             errno_t ret, uint32_t chain_len)
+{
+    struct sss_mc_stats_counters *stats = ctx->stats;
+
+    if (stats == NULL) {
+        return;
+    }
+
+    switch (ret) {
+    case 0:
+        __atomic_fetch_add(&stats->hits, 1, __ATOMIC_RELAXED);
+        break;
+    case ERANGE:
+        /* the caller retries with a bigger buffer, count it then */
+        return;
+    case EINVAL:
+        __atomic_fetch_add(&stats->expired, 1, __ATOMIC_RELAXED);
+        break;
+    default:
+        __atomic_fetch_add(&stats->misses, 1, __ATOMIC_RELAXED);
+        break;
+    }
+
+    __atomic_fetch_add(&stats->chain_len[sss_nss_mc_stats_bucket(chain_len)],
+                       1, __ATOMIC_RELAXED);
+
+    if (ret != 0) {
+        /* the caller is going to ask the responder anyway */
+        sss_nss_mc_stats_report();
+    }
+}
+
 errno_t sss_nss_check_header(struct sss_cli_mc_ctx *ctx)
 {
     struct sss_mc_header h;
@@ -180,6 +303,7 @@ static errno_t sss_nss_mc_init_ctx(const char *name,
         goto done;
     }
 
+    ctx->stats = sss_nss_mc_stats_get(name);
     ctx->initialized = INITIALIZED;
 
     ret = 0;
@@ -307,6 +431,12 @@ errno_t sss_nss_mc_get_record(struct sss_cli_mc_ctx *ctx,
             break;
         }
     }
+
+    if (count < 5 && ctx->stats != NULL) {
+        /* inconsistent copies caused by a concurrent update */
+        __atomic_fetch_add(&ctx->stats->retries, 5 - count, __ATOMIC_RELAXED);
+    }
+
     if (count == 0) {
         /* couldn't successfully read header we have to give up */
         ret = EIO;
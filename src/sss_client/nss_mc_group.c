@@ -30,7 +30,7 @@
 #include "util/util_safealign.h"
 
 struct sss_cli_mc_ctx gr_mc_ctx = { UNINITIALIZED, -1, 0, NULL, 0, NULL, 0,
-                                    NULL, 0, 0 };
+                                    NULL, 0, 0, NULL };
 
 static errno_t sss_nss_mc_parse_result(struct sss_mc_rec *rec,
                                        struct group *result,
@@ -111,6 +111,7 @@ errno_t sss_nss_mc_getgrnam(const char *name, size_t name_len,
     char *rec_name;
     uint32_t hash;
     uint32_t slot;
+    uint32_t chain_len = 0;
     int ret;
     const size_t strs_offset = offsetof(struct sss_mc_grp_data, strs);
     size_t data_size;
@@ -134,6 +135,7 @@ errno_t sss_nss_mc_getgrnam(const char *name, size_t name_len,
         /* free record from previous iteration */
         free(rec);
         rec = NULL;
+        chain_len++;
 
         ret = sss_nss_mc_get_record(&gr_mc_ctx, slot, &rec);
         if (ret) {
@@ -178,6 +180,7 @@ errno_t sss_nss_mc_getgrnam(const char *name, size_t name_len,
 
 done:
     free(rec);
+    sss_nss_mc_stats_lookup(&gr_mc_ctx, ret, chain_len);
     __sync_sub_and_fetch(&gr_mc_ctx.active_threads, 1);
     return ret;
 }
@@ -191,6 +194,7 @@ errno_t sss_nss_mc_getgrgid(gid_t gid,
     char gidstr[11];
     uint32_t hash;
     uint32_t slot;
+    uint32_t chain_len = 0;
     int len;
     int ret;
 
@@ -216,6 +220,7 @@ errno_t sss_nss_mc_getgrgid(gid_t gid,
         /* free record from previous iteration */
         free(rec);
         rec = NULL;
+        chain_len++;
 
         ret = sss_nss_mc_get_record(&gr_mc_ctx, slot, &rec);
         if (ret) {
@@ -246,6 +251,7 @@ errno_t sss_nss_mc_getgrgid(gid_t gid,
 
 done:
     free(rec);
+    sss_nss_mc_stats_lookup(&gr_mc_ctx, ret, chain_len);
     __sync_sub_and_fetch(&gr_mc_ctx.active_threads, 1);
     return ret;
 }
@@ -33,7 +33,7 @@
 #include "util/util_safealign.h"
 
 struct sss_cli_mc_ctx initgr_mc_ctx = { UNINITIALIZED, -1, 0, NULL, 0, NULL, 0,
-                                        NULL, 0, 0 };
+                                        NULL, 0, 0, NULL };
 
 static errno_t sss_nss_mc_parse_result(struct sss_mc_rec *rec,
                                        long int *start, long int *size,
@@ -92,6 +92,7 @@ errno_t sss_nss_mc_initgroups_dyn(const char *name, size_t name_len,
     char *rec_name;
     uint32_t hash;
     uint32_t slot;
+    uint32_t chain_len = 0;
     int ret;
     const size_t data_offset = offsetof(struct sss_mc_initgr_data, gids);
     size_t data_size;
@@ -115,6 +116,7 @@ errno_t sss_nss_mc_initgroups_dyn(const char *name, size_t name_len,
         /* free record from previous iteration */
         free(rec);
         rec = NULL;
+        chain_len++;
 
         ret = sss_nss_mc_get_record(&initgr_mc_ctx, slot, &rec);
         if (ret) {
@@ -160,6 +162,7 @@ errno_t sss_nss_mc_initgroups_dyn(const char *name, size_t name_len,
 
 done:
     free(rec);
+    sss_nss_mc_stats_lookup(&initgr_mc_ctx, ret, chain_len);
     __sync_sub_and_fetch(&initgr_mc_ctx.active_threads, 1);
     return ret;
 }
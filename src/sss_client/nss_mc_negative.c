@@ -0,0 +1,153 @@
+/*
+ * System Security Services Daemon. NSS client interface
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Negative results published by the responder in the mmap cache */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <time.h>
+#include "nss_mc.h"
+
+struct sss_cli_mc_ctx neg_mc_ctx = { UNINITIALIZED, -1, 0, NULL, 0, NULL, 0,
+                                     NULL, 0, 0, NULL };
+
+/* Returns 0 if a valid negative record with the given key exists */
+static errno_t sss_nss_mc_neg_find(const char *key, size_t key_len)
+{
+    struct sss_mc_rec *rec = NULL;
+    struct sss_mc_neg_data *data;
+    char *rec_key;
+    uint32_t hash;
+    uint32_t slot;
+    uint32_t chain_len = 0;
+    int ret;
+    const size_t strs_offset = offsetof(struct sss_mc_neg_data, strs);
+    size_t data_size;
+
+    ret = sss_nss_mc_get_ctx("negative", &neg_mc_ctx);
+    if (ret) {
+        return ret;
+    }
+
+    /* Get max size of data table. */
+    data_size = neg_mc_ctx.dt_size;
+
+    /* hashes are calculated including the NULL terminator */
+    hash = sss_nss_mc_hash(&neg_mc_ctx, key, key_len + 1);
+    slot = neg_mc_ctx.hash_table[hash];
+
+    /* If slot is not within the bounds of mmaped region and
+     * it's value is not MC_INVALID_VAL, then the cache is
+     * probbably corrupted. */
+    while (MC_SLOT_WITHIN_BOUNDS(slot, data_size)) {
+        /* free record from previous iteration */
+        free(rec);
+        rec = NULL;
+        chain_len++;
+
+        ret = sss_nss_mc_get_record(&neg_mc_ctx, slot, &rec);
+        if (ret) {
+            goto done;
+        }
+
+        /* check record matches what we are searching for */
+        if (hash != rec->hash1) {
+            /* if key hash does not match we can skip this immediately */
+            slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+            continue;
+        }
+
+        data = (struct sss_mc_neg_data *)rec->data;
+        /* Integrity check
+         * - key must fill the whole string area
+         * - data->name cannot point outside strings
+         * - all strings must be within copy of record
+         * - size of record must be lower that data table size */
+        if (key_len + 1 != data->strs_len
+            || data->name != strs_offset
+            || data->strs_len > rec->len
+            || rec->len > data_size) {
+            ret = ENOENT;
+            goto done;
+        }
+
+        rec_key = (char *)data + data->name;
+        if (memcmp(key, rec_key, key_len + 1) == 0) {
+            break;
+        }
+
+        slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+    }
+
+    if (!MC_SLOT_WITHIN_BOUNDS(slot, data_size)) {
+        ret = ENOENT;
+        goto done;
+    }
+
+    if (rec->expire < time(NULL)) {
+        /* the responder has to be asked again */
+        ret = ENOENT;
+        goto done;
+    }
+
+    ret = 0;
+
+done:
+    free(rec);
+    sss_nss_mc_stats_lookup(&neg_mc_ctx, ret, chain_len);
+    __sync_sub_and_fetch(&neg_mc_ctx.active_threads, 1);
+    return ret;
+}
+
+errno_t sss_nss_mc_neg_name(const char *prefix,
+                            const char *name, size_t name_len)
+{
+    char *key;
+    size_t prefix_len;
+    int ret;
+
+    prefix_len = strlen(prefix);
+    key = malloc(prefix_len + name_len + 1);
+    if (key == NULL) {
+        return ENOMEM;
+    }
+    memcpy(key, prefix, prefix_len);
+    memcpy(key + prefix_len, name, name_len + 1);
+
+    ret = sss_nss_mc_neg_find(key, prefix_len + name_len);
+    free(key);
+    return ret;
+}
+
+errno_t sss_nss_mc_neg_id(const char *prefix, uint32_t id)
+{
+    char key[64];
+    int key_len;
+
+    key_len = snprintf(key, sizeof(key), "%s%u", prefix, (unsigned int)id);
+    if (key_len < 0 || key_len >= sizeof(key)) {
+        return EINVAL;
+    }
+
+    return sss_nss_mc_neg_find(key, key_len);
+}
@@ -0,0 +1,158 @@
+/*
+ * System Security Services Daemon. NSS client interface
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* NETGROUP database NSS interface using mmap cache */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <time.h>
+#include "nss_mc.h"
+#include "util/util_safealign.h"
+
+struct sss_cli_mc_ctx netgr_mc_ctx = { UNINITIALIZED, -1, 0, NULL, 0, NULL, 0,
+                                       NULL, 0, 0, NULL };
+
+static errno_t sss_nss_mc_parse_result(struct sss_mc_rec *rec,
+                                       size_t name_len,
+                                       uint8_t **_entries,
+                                       size_t *_entries_len)
+{
+    struct sss_mc_netgr_data *data;
+    time_t expire;
+    uint32_t mark = SSS_NSS_MC_NETGR_MARK;
+    uint8_t *entries;
+    size_t len;
+
+    /* additional checks before filling result*/
+    expire = rec->expire;
+    if (expire < time(NULL)) {
+        /* entry is now invalid */
+        return EINVAL;
+    }
+
+    data = (struct sss_mc_netgr_data *)rec->data;
+
+    if (data->num_entries == 0
+        || data->entries_len + name_len + 1 != data->strs_len) {
+        return EINVAL;
+    }
+
+    /* Rebuild the GETNETGRENT reply, the number of results and the
+     * reserved field are followed by all entries */
+    len = 2 * sizeof(uint32_t) + data->entries_len;
+    entries = malloc(len);
+    if (entries == NULL) {
+        return ENOMEM;
+    }
+
+    SAFEALIGN_COPY_UINT32(entries, &data->num_entries, NULL);
+    SAFEALIGN_COPY_UINT32(entries + sizeof(uint32_t), &mark, NULL);
+    memcpy(entries + 2 * sizeof(uint32_t),
+           data->strs + name_len + 1, data->entries_len);
+
+    *_entries = entries;
+    *_entries_len = len;
+    return 0;
+}
+
+errno_t sss_nss_mc_setnetgrent(const char *name, size_t name_len,
+                               uint8_t **_entries, size_t *_entries_len)
+{
+    struct sss_mc_rec *rec = NULL;
+    struct sss_mc_netgr_data *data;
+    char *rec_name;
+    uint32_t hash;
+    uint32_t slot;
+    uint32_t chain_len = 0;
+    int ret;
+    const size_t strs_offset = offsetof(struct sss_mc_netgr_data, strs);
+    size_t data_size;
+
+    ret = sss_nss_mc_get_ctx("netgroup", &netgr_mc_ctx);
+    if (ret) {
+        return ret;
+    }
+
+    /* Get max size of data table. */
+    data_size = netgr_mc_ctx.dt_size;
+
+    /* hashes are calculated including the NULL terminator */
+    hash = sss_nss_mc_hash(&netgr_mc_ctx, name, name_len + 1);
+    slot = netgr_mc_ctx.hash_table[hash];
+
+    /* If slot is not within the bounds of mmaped region and
+     * it's value is not MC_INVALID_VAL, then the cache is
+     * probbably corrupted. */
+    while (MC_SLOT_WITHIN_BOUNDS(slot, data_size)) {
+        /* free record from previous iteration */
+        free(rec);
+        rec = NULL;
+        chain_len++;
+
+        ret = sss_nss_mc_get_record(&netgr_mc_ctx, slot, &rec);
+        if (ret) {
+            goto done;
+        }
+
+        /* check record matches what we are searching for */
+        if (hash != rec->hash1) {
+            /* if name hash does not match we can skip this immediately */
+            slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+            continue;
+        }
+
+        data = (struct sss_mc_netgr_data *)rec->data;
+        /* Integrity check
+         * - name_len cannot be longer than all strings
+         * - data->name cannot point outside strings
+         * - all strings must be within copy of record
+         * - size of record must be lower that data table size */
+        if (name_len > data->strs_len
+            || (data->name + name_len) > (strs_offset + data->strs_len)
+            || data->strs_len > rec->len
+            || rec->len > data_size) {
+            ret = ENOENT;
+            goto done;
+        }
+
+        rec_name = (char *)data + data->name;
+        if (strcmp(name, rec_name) == 0) {
+            break;
+        }
+
+        slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+    }
+
+    if (!MC_SLOT_WITHIN_BOUNDS(slot, data_size)) {
+        ret = ENOENT;
+        goto done;
+    }
+
+    ret = sss_nss_mc_parse_result(rec, name_len, _entries, _entries_len);
+
+done:
+    free(rec);
+    sss_nss_mc_stats_lookup(&netgr_mc_ctx, ret, chain_len);
+    __sync_sub_and_fetch(&netgr_mc_ctx.active_threads, 1);
+    return ret;
+}
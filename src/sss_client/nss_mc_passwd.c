@@ -29,7 +29,7 @@
 #include "nss_mc.h"
 
 struct sss_cli_mc_ctx pw_mc_ctx = { UNINITIALIZED, -1, 0, NULL, 0, NULL, 0,
-                                    NULL, 0, 0 };
+                                    NULL, 0, 0, NULL };
 
 static errno_t sss_nss_mc_parse_result(struct sss_mc_rec *rec,
                                        struct passwd *result,
@@ -104,6 +104,7 @@ errno_t sss_nss_mc_getpwnam(const char *name, size_t name_len,
     char *rec_name;
     uint32_t hash;
     uint32_t slot;
+    uint32_t chain_len = 0;
     int ret;
     const size_t strs_offset = offsetof(struct sss_mc_pwd_data, strs);
     size_t data_size;
@@ -127,6 +128,7 @@ errno_t sss_nss_mc_getpwnam(const char *name, size_t name_len,
         /* free record from previous iteration */
         free(rec);
         rec = NULL;
+        chain_len++;
 
         ret = sss_nss_mc_get_record(&pw_mc_ctx, slot, &rec);
         if (ret) {
@@ -171,6 +173,7 @@ errno_t sss_nss_mc_getpwnam(const char *name, size_t name_len,
 
 done:
     free(rec);
+    sss_nss_mc_stats_lookup(&pw_mc_ctx, ret, chain_len);
     __sync_sub_and_fetch(&pw_mc_ctx.active_threads, 1);
     return ret;
 }
@@ -184,6 +187,7 @@ errno_t sss_nss_mc_getpwuid(uid_t uid,
     char uidstr[11];
     uint32_t hash;
     uint32_t slot;
+    uint32_t chain_len = 0;
     int len;
     int ret;
 
@@ -209,6 +213,7 @@ errno_t sss_nss_mc_getpwuid(uid_t uid,
         /* free record from previous iteration */
         free(rec);
         rec = NULL;
+        chain_len++;
 
         ret = sss_nss_mc_get_record(&pw_mc_ctx, slot, &rec);
         if (ret) {
@@ -239,6 +244,7 @@ errno_t sss_nss_mc_getpwuid(uid_t uid,
 
 done:
     free(rec);
+    sss_nss_mc_stats_lookup(&pw_mc_ctx, ret, chain_len);
     __sync_sub_and_fetch(&pw_mc_ctx.active_threads, 1);
     return ret;
 }
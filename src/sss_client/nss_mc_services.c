@@ -0,0 +1,322 @@
+/*
+ * System Security Services Daemon. NSS client interface
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* SERVICES database NSS interface using mmap cache */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <arpa/inet.h>
+#include <time.h>
+#include "nss_mc.h"
+#include "util/util_safealign.h"
+
+struct sss_cli_mc_ctx svc_mc_ctx = { UNINITIALIZED, -1, 0, NULL, 0, NULL, 0,
+                                     NULL, 0, 0, NULL };
+
+static errno_t sss_nss_mc_parse_result(struct sss_mc_rec *rec,
+                                       struct servent *result,
+                                       char *buffer, size_t buflen)
+{
+    struct sss_mc_svc_data *data;
+    time_t expire;
+    void *cookie;
+    char *key;
+    char *strbuf;
+    size_t aliassize;
+    uint32_t i;
+    int ret;
+
+    /* additional checks before filling result*/
+    expire = rec->expire;
+    if (expire < time(NULL)) {
+        /* entry is now invalid */
+        return EINVAL;
+    }
+
+    data = (struct sss_mc_svc_data *)rec->data;
+
+    aliassize = (data->num_aliases + 1) * sizeof(char *);
+    if (data->strs_len + aliassize > buflen) {
+        return ERANGE;
+    }
+
+    /* fill in glibc provided structs */
+
+    /* copy in buffer */
+    strbuf = buffer + aliassize;
+    memcpy(strbuf, data->strs, data->strs_len);
+
+    /* fill in servent */
+    result->s_port = data->port;
+
+    /* The address &buffer[0] must be aligned to sizeof(char *) */
+    if (!IS_ALIGNED(buffer, char *)) {
+        /* The buffer is not properly aligned. */
+        return EFAULT;
+    }
+
+    result->s_aliases = DISCARD_ALIGN(buffer, char **);
+    result->s_aliases[data->num_aliases] = NULL;
+
+    cookie = NULL;
+    /* the lookup key is stored first, it is not part of the servent */
+    ret = sss_nss_str_ptr_from_buffer(&key, &cookie,
+                                      strbuf, data->strs_len);
+    if (ret) {
+        return ret;
+    }
+    ret = sss_nss_str_ptr_from_buffer(&result->s_name, &cookie,
+                                      strbuf, data->strs_len);
+    if (ret) {
+        return ret;
+    }
+    ret = sss_nss_str_ptr_from_buffer(&result->s_proto, &cookie,
+                                      strbuf, data->strs_len);
+    if (ret) {
+        return ret;
+    }
+
+    for (i = 0; i < data->num_aliases; i++) {
+        ret = sss_nss_str_ptr_from_buffer(&result->s_aliases[i], &cookie,
+                                          strbuf, data->strs_len);
+        if (ret) {
+            return ret;
+        }
+    }
+    if (cookie != NULL) {
+        return EINVAL;
+    }
+
+    return 0;
+}
+
+/* Returns the protocol string of the record or NULL if it is malformed */
+static const char *sss_nss_mc_svc_proto(struct sss_mc_svc_data *data)
+{
+    const char *max = data->strs + data->strs_len;
+    const char *p = data->strs;
+    int skip;
+
+    /* skip key and name */
+    for (skip = 0; skip < 2; skip++) {
+        p = memchr(p, '\0', max - p);
+        if (p == NULL || p + 1 >= max) {
+            return NULL;
+        }
+        p++;
+    }
+
+    if (memchr(p, '\0', max - p) == NULL) {
+        return NULL;
+    }
+
+    return p;
+}
+
+errno_t sss_nss_mc_getservbyname(const char *name, size_t name_len,
+                                 const char *protocol, size_t proto_len,
+                                 struct servent *result,
+                                 char *buffer, size_t buflen)
+{
+    struct sss_mc_rec *rec = NULL;
+    struct sss_mc_svc_data *data;
+    char *rec_key;
+    char *key = NULL;
+    size_t key_len;
+    uint32_t hash;
+    uint32_t slot;
+    uint32_t chain_len = 0;
+    int ret;
+    const size_t strs_offset = offsetof(struct sss_mc_svc_data, strs);
+    size_t data_size;
+
+    ret = sss_nss_mc_get_ctx("services", &svc_mc_ctx);
+    if (ret) {
+        return ret;
+    }
+
+    /* Get max size of data table. */
+    data_size = svc_mc_ctx.dt_size;
+
+    key_len = name_len + proto_len + 1;
+    key = malloc(key_len + 1);
+    if (key == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+    memcpy(key, name, name_len);
+    key[name_len] = '/';
+    memcpy(key + name_len + 1, protocol, proto_len + 1);
+
+    /* hashes are calculated including the NULL terminator */
+    hash = sss_nss_mc_hash(&svc_mc_ctx, key, key_len + 1);
+    slot = svc_mc_ctx.hash_table[hash];
+
+    /* If slot is not within the bounds of mmaped region and
+     * it's value is not MC_INVALID_VAL, then the cache is
+     * probbably corrupted. */
+    while (MC_SLOT_WITHIN_BOUNDS(slot, data_size)) {
+        /* free record from previous iteration */
+        free(rec);
+        rec = NULL;
+        chain_len++;
+
+        ret = sss_nss_mc_get_record(&svc_mc_ctx, slot, &rec);
+        if (ret) {
+            goto done;
+        }
+
+        /* check record matches what we are searching for */
+        if (hash != rec->hash1) {
+            /* if name hash does not match we can skip this immediately */
+            slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+            continue;
+        }
+
+        data = (struct sss_mc_svc_data *)rec->data;
+        /* Integrity check
+         * - key_len cannot be longer than all strings
+         * - data->name cannot point outside strings
+         * - all strings must be within copy of record
+         * - size of record must be lower that data table size */
+        if (key_len > data->strs_len
+            || (data->name + key_len) > (strs_offset + data->strs_len)
+            || data->strs_len > rec->len
+            || rec->len > data_size) {
+            ret = ENOENT;
+            goto done;
+        }
+
+        rec_key = (char *)data + data->name;
+        if (strcmp(key, rec_key) == 0) {
+            break;
+        }
+
+        slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+    }
+
+    if (!MC_SLOT_WITHIN_BOUNDS(slot, data_size)) {
+        ret = ENOENT;
+        goto done;
+    }
+
+    ret = sss_nss_mc_parse_result(rec, result, buffer, buflen);
+
+done:
+    free(key);
+    free(rec);
+    sss_nss_mc_stats_lookup(&svc_mc_ctx, ret, chain_len);
+    __sync_sub_and_fetch(&svc_mc_ctx.active_threads, 1);
+    return ret;
+}
+
+errno_t sss_nss_mc_getservbyport(int port,
+                                 const char *protocol, size_t proto_len,
+                                 struct servent *result,
+                                 char *buffer, size_t buflen)
+{
+    struct sss_mc_rec *rec = NULL;
+    struct sss_mc_svc_data *data;
+    const char *rec_proto;
+    char *key = NULL;
+    int key_len;
+    uint32_t hash;
+    uint32_t slot;
+    uint32_t chain_len = 0;
+    int ret;
+
+    ret = sss_nss_mc_get_ctx("services", &svc_mc_ctx);
+    if (ret) {
+        return ret;
+    }
+
+    /* port number, slash, protocol and terminator */
+    key = malloc(proto_len + 8);
+    if (key == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    key_len = snprintf(key, proto_len + 8, "%u/%s",
+                       (unsigned int)ntohs(port), protocol);
+    if (key_len < 0 || key_len >= proto_len + 8) {
+        ret = EINVAL;
+        goto done;
+    }
+
+    /* hashes are calculated including the NULL terminator */
+    hash = sss_nss_mc_hash(&svc_mc_ctx, key, key_len + 1);
+    slot = svc_mc_ctx.hash_table[hash];
+
+    /* If slot is not within the bounds of mmaped region and
+     * it's value is not MC_INVALID_VAL, then the cache is
+     * probbably corrupted. */
+    while (MC_SLOT_WITHIN_BOUNDS(slot, svc_mc_ctx.dt_size)) {
+        /* free record from previous iteration */
+        free(rec);
+        rec = NULL;
+        chain_len++;
+
+        ret = sss_nss_mc_get_record(&svc_mc_ctx, slot, &rec);
+        if (ret) {
+            goto done;
+        }
+
+        /* check record matches what we are searching for */
+        if (hash != rec->hash2) {
+            /* if port hash does not match we can skip this immediately */
+            slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+            continue;
+        }
+
+        data = (struct sss_mc_svc_data *)rec->data;
+        if (data->strs_len > rec->len
+            || rec->len > svc_mc_ctx.dt_size) {
+            ret = ENOENT;
+            goto done;
+        }
+
+        rec_proto = sss_nss_mc_svc_proto(data);
+        if ((uint16_t)data->port == (uint16_t)port
+                && rec_proto != NULL
+                && strcmp(protocol, rec_proto) == 0) {
+            break;
+        }
+
+        slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+    }
+
+    if (!MC_SLOT_WITHIN_BOUNDS(slot, svc_mc_ctx.dt_size)) {
+        ret = ENOENT;
+        goto done;
+    }
+
+    ret = sss_nss_mc_parse_result(rec, result, buffer, buflen);
+
+done:
+    free(key);
+    free(rec);
+    sss_nss_mc_stats_lookup(&svc_mc_ctx, ret, chain_len);
+    __sync_sub_and_fetch(&svc_mc_ctx.active_threads, 1);
+    return ret;
+}
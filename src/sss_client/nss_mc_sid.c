@@ -0,0 +1,214 @@
+/*
+ * System Security Services Daemon. NSS client interface
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* SID <-> name/ID mappings using mmap cache */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <time.h>
+#include "nss_mc.h"
+
+struct sss_cli_mc_ctx sid_mc_ctx = { UNINITIALIZED, -1, 0, NULL, 0, NULL, 0,
+                                     NULL, 0, 0, NULL };
+
+static errno_t sss_nss_mc_sid_check_record(struct sss_mc_rec *rec,
+                                           size_t data_size)
+{
+    struct sss_mc_sid_data *data;
+    const size_t strs_offset = offsetof(struct sss_mc_sid_data, strs);
+    time_t expire;
+
+    /* additional checks before filling result*/
+    expire = rec->expire;
+    if (expire < time(NULL)) {
+        /* entry is now invalid */
+        return EINVAL;
+    }
+
+    data = (struct sss_mc_sid_data *)rec->data;
+    /* Integrity check
+     * - data->name and data->sid cannot point outside strings
+     * - strings must be zero terminated
+     * - all strings must be within copy of record
+     * - size of record must be lower that data table size */
+    if (data->strs_len == 0
+        || data->strs_len > rec->len
+        || rec->len > data_size
+        || data->name < strs_offset
+        || data->sid <= data->name
+        || data->sid >= strs_offset + data->strs_len
+        || data->strs[data->strs_len - 1] != '\0') {
+        return ENOENT;
+    }
+
+    return 0;
+}
+
+/* Searches the record with the given key in the chain of the first
+ * (name) or second (SID) hash. On success the caller must free *_rec */
+static errno_t sss_nss_mc_sid_find(const char *key, size_t key_len,
+                                   bool by_sid, struct sss_mc_rec **_rec)
+{
+    struct sss_mc_rec *rec = NULL;
+    struct sss_mc_sid_data *data;
+    char *rec_key;
+    uint32_t hash;
+    uint32_t slot;
+    uint32_t chain_len = 0;
+    int ret;
+    size_t data_size;
+
+    /* Get max size of data table. */
+    data_size = sid_mc_ctx.dt_size;
+
+    /* hashes are calculated including the NULL terminator */
+    hash = sss_nss_mc_hash(&sid_mc_ctx, key, key_len + 1);
+    slot = sid_mc_ctx.hash_table[hash];
+
+    /* If slot is not within the bounds of mmaped region and
+     * it's value is not MC_INVALID_VAL, then the cache is
+     * probbably corrupted. */
+    while (MC_SLOT_WITHIN_BOUNDS(slot, data_size)) {
+        /* free record from previous iteration */
+        free(rec);
+        rec = NULL;
+        chain_len++;
+
+        ret = sss_nss_mc_get_record(&sid_mc_ctx, slot, &rec);
+        if (ret) {
+            goto done;
+        }
+
+        /* check record matches what we are searching for */
+        if (hash != (by_sid ? rec->hash2 : rec->hash1)) {
+            /* if hash does not match we can skip this immediately */
+            slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+            continue;
+        }
+
+        ret = sss_nss_mc_sid_check_record(rec, data_size);
+        if (ret) {
+            goto done;
+        }
+
+        data = (struct sss_mc_sid_data *)rec->data;
+        rec_key = (char *)data + (by_sid ? data->sid : data->name);
+        if (strcmp(key, rec_key) == 0) {
+            *_rec = rec;
+            rec = NULL;
+            ret = 0;
+            goto done;
+        }
+
+        slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+    }
+
+    ret = ENOENT;
+
+done:
+    free(rec);
+    sss_nss_mc_stats_lookup(&sid_mc_ctx, ret, chain_len);
+    return ret;
+}
+
+errno_t sss_nss_mc_getsidbyname(const char *name, size_t name_len,
+                                char **_sid, uint32_t *_type)
+{
+    struct sss_mc_rec *rec = NULL;
+    struct sss_mc_sid_data *data;
+    char *sid;
+    int ret;
+
+    ret = sss_nss_mc_get_ctx("sid", &sid_mc_ctx);
+    if (ret) {
+        return ret;
+    }
+
+    ret = sss_nss_mc_sid_find(name, name_len, false, &rec);
+    if (ret) {
+        goto done;
+    }
+
+    data = (struct sss_mc_sid_data *)rec->data;
+    sid = strdup((char *)data + data->sid);
+    if (sid == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    *_sid = sid;
+    *_type = data->type;
+    ret = 0;
+
+done:
+    free(rec);
+    __sync_sub_and_fetch(&sid_mc_ctx.active_threads, 1);
+    return ret;
+}
+
+errno_t sss_nss_mc_getbysid(const char *sid, size_t sid_len,
+                            char **_name, uint32_t *_id, uint32_t *_type)
+{
+    struct sss_mc_rec *rec = NULL;
+    struct sss_mc_sid_data *data;
+    char *name;
+    int ret;
+
+    ret = sss_nss_mc_get_ctx("sid", &sid_mc_ctx);
+    if (ret) {
+        return ret;
+    }
+
+    ret = sss_nss_mc_sid_find(sid, sid_len, true, &rec);
+    if (ret) {
+        goto done;
+    }
+
+    data = (struct sss_mc_sid_data *)rec->data;
+
+    if (_id != NULL) {
+        if (data->id == 0) {
+            /* object has no POSIX ID, let the responder decide */
+            ret = ENOENT;
+            goto done;
+        }
+        *_id = data->id;
+    }
+
+    if (_name != NULL) {
+        name = strdup((char *)data + data->name);
+        if (name == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+        *_name = name;
+    }
+
+    *_type = data->type;
+    ret = 0;
+
+done:
+    free(rec);
+    __sync_sub_and_fetch(&sid_mc_ctx.active_threads, 1);
+    return ret;
+}
@@ -32,6 +32,7 @@
 #include <string.h>
 #include "sss_cli.h"
 #include "nss_compat.h"
+#include "nss_mc.h"
 
 #define CLEAR_NETGRENT_DATA(netgrent) do { \
         free(netgrent->data); \
@@ -53,6 +54,22 @@
  *  ... repeated N times
  */
 #define NETGR_METADATA_COUNT 2 * sizeof(uint32_t)
+
+/* True if the current netgroup data were read from the mmap cache rather
+ * than returned by the responder */
+static bool netgr_data_from_mc(struct __netgrent *netgrent)
+{
+    uint32_t mark;
+
+    if (netgrent->data == NULL
+            || netgrent->data_size < NETGR_METADATA_COUNT) {
+        return false;
+    }
+
+    SAFEALIGN_COPY_UINT32(&mark, netgrent->data + sizeof(uint32_t), NULL);
+    return mark == SSS_NSS_MC_NETGR_MARK;
+}
+
 struct sss_nss_netgr_rep {
     struct __netgrent *result;
     char *buffer;
@@ -166,21 +183,35 @@ enum nss_status _nss_sss_setnetgrent(const char *netgroup,
     int errnop;
     char *name;
     size_t name_len;
+    uint8_t *mc_data;
+    size_t mc_data_len;
     errno_t ret;
 
     if (!netgroup) return NSS_STATUS_NOTFOUND;
 
+    ret = sss_strnlen(netgroup, SSS_NAME_MAX, &name_len);
+    if (ret != 0) {
+        return NSS_STATUS_NOTFOUND;
+    }
+
+    ret = sss_nss_mc_setnetgrent(netgroup, name_len, &mc_data, &mc_data_len);
+    if (ret == 0) {
+        /* make sure we do not have leftovers, and release memory */
+        CLEAR_NETGRENT_DATA(result);
+
+        /* getnetgrent() will return the entries directly from mc_data */
+        result->data = (char *) mc_data;
+        result->data_size = mc_data_len;
+        result->idx.position = NETGR_METADATA_COUNT;
+        return NSS_STATUS_SUCCESS;
+    }
+    /* otherwise fall back to socket based comms */
+
     sss_nss_lock();
 
     /* make sure we do not have leftovers, and release memory */
     CLEAR_NETGRENT_DATA(result);
 
-    ret = sss_strnlen(netgroup, SSS_NAME_MAX, &name_len);
-    if (ret != 0) {
-        nret = NSS_STATUS_NOTFOUND;
-        goto out;
-    }
-
     name = malloc(sizeof(char)*name_len + 1);
     if (name == NULL) {
         nret = NSS_STATUS_TRYAGAIN;
@@ -257,6 +288,12 @@ static enum nss_status internal_getnetgrent_r(struct __netgrent *result,
         return NSS_STATUS_SUCCESS;
     }
 
+    if (netgr_data_from_mc(result)) {
+        /* The mmap cache record holds all entries of the netgroup and the
+         * responder does not know about this enumeration at all */
+        return NSS_STATUS_RETURN;
+    }
+
     /* Release memory, if any */
     CLEAR_NETGRENT_DATA(result);
 
@@ -307,6 +344,12 @@ enum nss_status _nss_sss_endnetgrent(struct __netgrent *result)
     enum nss_status nret;
     int errnop;
 
+    if (netgr_data_from_mc(result)) {
+        /* nothing was set up in the responder for this enumeration */
+        CLEAR_NETGRENT_DATA(result);
+        return NSS_STATUS_SUCCESS;
+    }
+
     sss_nss_lock();
 
     /* make sure we do not have leftovers, and release memory */
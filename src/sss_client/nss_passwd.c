@@ -173,32 +173,16 @@ enum nss_status _nss_sss_getpwnam_r(const char *name, struct passwd *result,
         break;
     }
 
+    /* the responder may have published that there is no such entry */
+    ret = sss_nss_mc_neg_name(SSS_MC_NEG_PWNAM, name, name_len);
+    if (ret == 0) {
+        *errnop = ENOENT;
+        return NSS_STATUS_NOTFOUND;
+    }
+
     rd.len = name_len + 1;
     rd.data = name;
 
-    sss_nss_lock();
-
-    /* previous thread might already initialize entry in mmap cache */
-    ret = sss_nss_mc_getpwnam(name, name_len, result, buffer, buflen);
-    switch (ret) {
-    case 0:
-        *errnop = 0;
-        nret = NSS_STATUS_SUCCESS;
-        goto out;
-    case ERANGE:
-        *errnop = ERANGE;
-        nret = NSS_STATUS_TRYAGAIN;
-        goto out;
-    case ENOENT:
-        /* fall through, we need to actively ask the parent
-         * if no entry is found */
-        break;
-    default:
-        /* if using the mmaped cache failed,
-         * fall back to socket based comms */
-        break;
-    }
-
     nret = sss_nss_make_request(SSS_NSS_GETPWNAM, &rd,
                                 &repbuf, &replen, errnop);
     if (nret != NSS_STATUS_SUCCESS) {
@@ -239,7 +223,6 @@ enum nss_status _nss_sss_getpwnam_r(const char *name, struct passwd *result,
     nret = NSS_STATUS_SUCCESS;
 
 out:
-    sss_nss_unlock();
     return nret;
 }
 
@@ -276,33 +259,17 @@ enum nss_status _nss_sss_getpwuid_r(uid_t uid, struct passwd *result,
         break;
     }
 
+    /* the responder may have published that there is no such entry */
+    ret = sss_nss_mc_neg_id(SSS_MC_NEG_PWUID, uid);
+    if (ret == 0) {
+        *errnop = ENOENT;
+        return NSS_STATUS_NOTFOUND;
+    }
+
     user_uid = uid;
     rd.len = sizeof(uint32_t);
     rd.data = &user_uid;
 
-    sss_nss_lock();
-
-    /* previous thread might already initialize entry in mmap cache */
-    ret = sss_nss_mc_getpwuid(uid, result, buffer, buflen);
-    switch (ret) {
-    case 0:
-        *errnop = 0;
-        nret = NSS_STATUS_SUCCESS;
-        goto out;
-    case ERANGE:
-        *errnop = ERANGE;
-        nret = NSS_STATUS_TRYAGAIN;
-        goto out;
-    case ENOENT:
-        /* fall through, we need to actively ask the parent
-         * if no entry is found */
-        break;
-    default:
-        /* if using the mmaped cache failed,
-         * fall back to socket based comms */
-        break;
-    }
-
     nret = sss_nss_make_request(SSS_NSS_GETPWUID, &rd,
                                 &repbuf, &replen, errnop);
     if (nret != NSS_STATUS_SUCCESS) {
@@ -343,7 +310,6 @@ enum nss_status _nss_sss_getpwuid_r(uid_t uid, struct passwd *result,
     nret = NSS_STATUS_SUCCESS;
 
 out:
-    sss_nss_unlock();
     return nret;
 }
 
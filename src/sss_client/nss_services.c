@@ -30,6 +30,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "sss_cli.h"
+#include "nss_mc.h"
 
 static struct sss_nss_getservent_data {
     size_t len;
@@ -193,6 +194,28 @@ _nss_sss_getservbyname_r(const char *name,
         }
     }
 
+
+    if (protocol) {
+        ret = sss_nss_mc_getservbyname(name, name_len, protocol, proto_len,
+                                       result, buffer, buflen);
+        switch (ret) {
+        case 0:
+            *errnop = 0;
+            return NSS_STATUS_SUCCESS;
+        case ERANGE:
+            *errnop = ERANGE;
+            return NSS_STATUS_TRYAGAIN;
+        case ENOENT:
+            /* fall through, we need to actively ask the parent
+             * if no entry is found */
+            break;
+        default:
+            /* if using the mmaped cache failed,
+             * fall back to socket based comms */
+            break;
+        }
+    }
+
     rd.len = name_len + proto_len + 2;
     data = malloc(sizeof(uint8_t)*rd.len);
     if (data == NULL) {
@@ -210,8 +233,6 @@ _nss_sss_getservbyname_r(const char *name,
     }
     rd.data = data;
 
-    sss_nss_lock();
-
     nret = sss_nss_make_request(SSS_NSS_GETSERVBYNAME, &rd,
                                 &repbuf, &replen, errnop);
     free(data);
@@ -255,7 +276,6 @@ _nss_sss_getservbyname_r(const char *name,
     nret = NSS_STATUS_SUCCESS;
 
 out:
-    sss_nss_unlock();
     return nret;
 }
 
@@ -288,6 +308,28 @@ _nss_sss_getservbyport_r(int port, const char *protocol,
         }
     }
 
+
+    if (protocol) {
+        ret = sss_nss_mc_getservbyport(port, protocol, proto_len,
+                                       result, buffer, buflen);
+        switch (ret) {
+        case 0:
+            *errnop = 0;
+            return NSS_STATUS_SUCCESS;
+        case ERANGE:
+            *errnop = ERANGE;
+            return NSS_STATUS_TRYAGAIN;
+        case ENOENT:
+            /* fall through, we need to actively ask the parent
+             * if no entry is found */
+            break;
+        default:
+            /* if using the mmaped cache failed,
+             * fall back to socket based comms */
+            break;
+        }
+    }
+
     rd.len = sizeof(uint32_t)*2 + proto_len + 1;
     data = malloc(sizeof(uint8_t)*rd.len);
     if (data == NULL) {
@@ -309,8 +351,6 @@ _nss_sss_getservbyport_r(int port, const char *protocol,
     }
     rd.data = data;
 
-    sss_nss_lock();
-
     nret = sss_nss_make_request(SSS_NSS_GETSERVBYPORT, &rd,
                                 &repbuf, &replen, errnop);
     free(data);
@@ -354,7 +394,6 @@ _nss_sss_getservbyport_r(int port, const char *protocol,
     nret = NSS_STATUS_SUCCESS;
 
 out:
-    sss_nss_unlock();
     return nret;
 }
 
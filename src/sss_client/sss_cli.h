@@ -45,6 +45,8 @@ typedef int errno_t;
 #endif
 
 #define SSS_NSS_PROTOCOL_VERSION 1
+/* the NSS responder accepts several tagged requests at once */
+#define SSS_NSS_PROTOCOL_VERSION_MUX 2
 #define SSS_PAM_PROTOCOL_VERSION 3
 #define SSS_SUDO_PROTOCOL_VERSION 1
 #define SSS_AUTOFS_PROTOCOL_VERSION 1
@@ -255,6 +257,22 @@ SSS_NSS_GETORIGBYNAME = 0x0115, /**< Takes a zero terminated fully qualified
                                      second the value. Hence the list should
                                      have an even number of strings, if not
                                      the whole list is invalid. */
+SSS_NSS_GETBATCH     = 0x0116, /**< Takes the type of the keys (enum
+                                    sss_nss_key_type), the number of keys as
+                                    unsigned 32bit integer values and the
+                                    keys, either unsigned 32bit integer
+                                    values or zero terminated strings. Returns
+                                    the number of results, a reserved
+                                    unsigned 32bit integer and one result per
+                                    key in the order of the keys: the error
+                                    code, the object type and the POSIX ID as
+                                    unsigned 32bit integer values followed by
+                                    the zero terminated name and SID of the
+                                    object. */
+SSS_NSS_MC_STATS     = 0x0117, /**< Takes a struct sss_mc_stats_report with
+                                    the memory cache lookups of the client
+                                    since its last report. Returns no
+                                    data. */
 };
 
 /**
@@ -538,6 +556,25 @@ enum nss_status sss_nss_make_request(enum sss_cli_command cmd,
                                      uint8_t **repbuf, size_t *replen,
                                      int *errnop);
 
+struct sss_cli_mux_req {
+    enum sss_cli_command cmd;
+    struct sss_cli_req_data *rd;
+
+    /* filled in by sss_nss_make_request_mux() */
+    uint8_t *repbuf;    /* reply data section, must be freed by the caller */
+    size_t replen;
+    int error;          /* server side error of this request */
+};
+
+/* Sends all requests to the NSS responder at once and collects the replies
+ * in the order they are ready. Only lookups that do not depend on the
+ * set/get/end*ent state of the connection can be sent this way. Falls back
+ * to one request at a time if the responder does not support
+ * SSS_NSS_PROTOCOL_VERSION_MUX. */
+enum nss_status sss_nss_make_request_mux(struct sss_cli_mux_req *reqs,
+                                         size_t num_reqs,
+                                         int *errnop);
+
 int sss_pam_make_request(enum sss_cli_command cmd,
                          struct sss_cli_req_data *rd,
                          uint8_t **repbuf, size_t *replen,
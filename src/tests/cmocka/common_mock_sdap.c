@@ -24,6 +24,22 @@
 #include "providers/ldap/ldap_common.h"
 #include "providers/ldap/sdap.h"
 #include "tests/cmocka/common_mock.h"
+#include "tests/cmocka/common_mock_sdap.h"
+
+static struct {
+    mock_sdap_search_fn fn;
+    void *pvt;
+    unsigned int delay_usec;
+} mock_search;
+
+void mock_sdap_set_search_handler(mock_sdap_search_fn fn,
+                                  void *pvt,
+                                  unsigned int delay_usec)
+{
+    mock_search.fn = fn;
+    mock_search.pvt = pvt;
+    mock_search.delay_usec = delay_usec;
+}
 
 struct sdap_id_ctx *mock_sdap_id_ctx(TALLOC_CTX *mem_ctx,
                                      struct be_ctx *be_ctx,
@@ -81,6 +97,21 @@ bool sdap_has_deref_support(struct sdap_handle *sh, struct sdap_options *opts)
     return sss_mock_type(bool);
 }
 
+struct mock_sdap_search_state {
+    size_t reply_count;
+    struct sysdb_attrs **reply;
+};
+
+static void mock_sdap_search_done(struct tevent_context *ev,
+                                  struct tevent_timer *te,
+                                  struct timeval tv,
+                                  void *pvt)
+{
+    struct tevent_req *req = talloc_get_type(pvt, struct tevent_req);
+
+    tevent_req_done(req);
+}
+
 struct tevent_req *sdap_get_generic_send(TALLOC_CTX *mem_ctx,
                                          struct tevent_context *ev,
                                          struct sdap_options *opts,
@@ -94,7 +125,37 @@ struct tevent_req *sdap_get_generic_send(TALLOC_CTX *mem_ctx,
                                          int timeout,
                                          bool allow_paging)
 {
-    return test_req_succeed_send(mem_ctx, ev);
+    struct mock_sdap_search_state *state;
+    struct tevent_req *req;
+    struct tevent_timer *te;
+    errno_t ret;
+
+    if (mock_search.fn == NULL) {
+        return test_req_succeed_send(mem_ctx, ev);
+    }
+
+    req = tevent_req_create(mem_ctx, &state, struct mock_sdap_search_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    ret = mock_search.fn(state, search_base, scope, filter, mock_search.pvt,
+                         &state->reply_count, &state->reply);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        tevent_req_post(req, ev);
+        return req;
+    }
+
+    te = tevent_add_timer(ev, state,
+                          tevent_timeval_current_ofs(0, mock_search.delay_usec),
+                          mock_sdap_search_done, req);
+    if (te == NULL) {
+        talloc_free(req);
+        return NULL;
+    }
+
+    return req;
 }
 
 int sdap_get_generic_recv(struct tevent_req *req,
@@ -102,8 +163,17 @@ int sdap_get_generic_recv(struct tevent_req *req,
                           size_t *reply_count,
                           struct sysdb_attrs ***reply)
 {
+    struct mock_sdap_search_state *state;
+
     TEVENT_REQ_RETURN_ON_ERROR(req);
 
+    if (mock_search.fn != NULL) {
+        state = tevent_req_data(req, struct mock_sdap_search_state);
+        *reply_count = state->reply_count;
+        *reply = talloc_steal(mem_ctx, state->reply);
+        return EOK;
+    }
+
     *reply_count = sss_mock_type(size_t);
     *reply = sss_mock_ptr_type(struct sysdb_attrs **);
 
@@ -37,4 +37,19 @@ struct sdap_id_ctx *mock_sdap_id_ctx(TALLOC_CTX *mem_ctx,
 
 struct sdap_handle *mock_sdap_handle(TALLOC_CTX *mem_ctx);
 
+/* Answers sdap_get_generic_send() instead of the values queued with
+ * will_return(sdap_get_generic_recv, ...). The reply is delivered after
+ * delay_usec microseconds to simulate the round trip to the server. */
+typedef errno_t (*mock_sdap_search_fn)(TALLOC_CTX *mem_ctx,
+                                       const char *search_base,
+                                       int scope,
+                                       const char *filter,
+                                       void *pvt,
+                                       size_t *_reply_count,
+                                       struct sysdb_attrs ***_reply);
+
+void mock_sdap_set_search_handler(mock_sdap_search_fn fn,
+                                  void *pvt,
+                                  unsigned int delay_usec);
+
 #endif /* COMMON_MOCK_SDAP_H_ */
@@ -83,6 +83,44 @@ enum nss_status sss_nss_make_request(enum sss_cli_command cmd,
     return d->nss_status;
 }
 
+enum nss_status sss_nss_make_request_mux(struct sss_cli_mux_req *reqs,
+                                         size_t num_reqs, int *errnop)
+{
+    struct sss_nss_make_request_test_data *d;
+    size_t c;
+
+    for (c = 0; c < num_reqs; c++) {
+        assert_int_equal(reqs[c].cmd, SSS_NSS_GETBATCH);
+
+        d = sss_mock_ptr_type(struct sss_nss_make_request_test_data *);
+
+        reqs[c].repbuf = NULL;
+        reqs[c].replen = d->replen;
+        reqs[c].error = d->errnop;
+        if (d->replen != 0 && d->repbuf != NULL) {
+            reqs[c].repbuf = malloc(d->replen);
+            assert_non_null(reqs[c].repbuf);
+            memcpy(reqs[c].repbuf, d->repbuf, d->replen);
+        }
+    }
+
+    *errnop = 0;
+    return NSS_STATUS_SUCCESS;
+}
+
+static size_t add_batch_result(uint8_t *buf, size_t rp, uint32_t error,
+                               uint32_t type, uint32_t id,
+                               const char *name, const char *sid)
+{
+    SAFEALIGN_SET_UINT32(buf + rp, error, &rp);
+    SAFEALIGN_SET_UINT32(buf + rp, type, &rp);
+    SAFEALIGN_SET_UINT32(buf + rp, id, &rp);
+    safealign_memcpy(buf + rp, name, strlen(name) + 1, &rp);
+    safealign_memcpy(buf + rp, sid, strlen(sid) + 1, &rp);
+
+    return rp;
+}
+
 void test_getsidbyname(void **state)
 {
     int ret;
@@ -146,12 +184,97 @@ void test_getorigbyname(void **state)
     sss_nss_free_kv(kv_list);
 }
 
+void test_getbatchbyuid(void **state)
+{
+    int ret;
+    uint8_t buf[256];
+    size_t rp = 0;
+    uint32_t uids[] = {1000, 1001};
+    struct sss_nss_batch_result *res = NULL;
+    struct sss_nss_make_request_test_data d = {buf, 0, 0,
+                                               NSS_STATUS_SUCCESS};
+    struct sss_nss_make_request_test_data d_err = {NULL, 0, EIO,
+                                                   NSS_STATUS_SUCCESS};
+
+    ret = sss_nss_getbatchbyuid(NULL, 2, &res);
+    assert_int_equal(ret, EINVAL);
+
+    ret = sss_nss_getbatchbyuid(uids, 0, &res);
+    assert_int_equal(ret, EINVAL);
+
+    SAFEALIGN_SET_UINT32(buf, 2, &rp);
+    SAFEALIGN_SET_UINT32(buf + rp, 0, &rp);
+    rp = add_batch_result(buf, rp, EOK, SSS_ID_TYPE_UID, 1000,
+                          "user@test", "S-1-5-21-1-2-3-1000");
+    rp = add_batch_result(buf, rp, ENOENT, 0, 0, "", "");
+    d.replen = rp;
+
+    will_return(sss_nss_make_request_mux, &d);
+    ret = sss_nss_getbatchbyuid(uids, 2, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res[0].error, EOK);
+    assert_int_equal(res[0].type, SSS_ID_TYPE_UID);
+    assert_int_equal(res[0].id, 1000);
+    assert_string_equal(res[0].fq_name, "user@test");
+    assert_string_equal(res[0].sid, "S-1-5-21-1-2-3-1000");
+    assert_int_equal(res[1].error, ENOENT);
+    assert_null(res[1].fq_name);
+    assert_null(res[1].sid);
+    sss_nss_free_batch(res, 2);
+
+    /* the number of results must match the number of keys */
+    will_return(sss_nss_make_request_mux, &d);
+    ret = sss_nss_getbatchbyuid(uids, 1, &res);
+    assert_int_equal(ret, EBADMSG);
+
+    /* a failed request fails all keys sent with it */
+    will_return(sss_nss_make_request_mux, &d_err);
+    ret = sss_nss_getbatchbyuid(uids, 2, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res[0].error, EIO);
+    assert_int_equal(res[1].error, EIO);
+    sss_nss_free_batch(res, 2);
+}
+
+void test_getbatchbyname_split(void **state)
+{
+    int ret;
+    size_t c;
+    char name[256];
+    const char *names[8];
+    struct sss_nss_batch_result *res = NULL;
+    struct sss_nss_make_request_test_data d_err = {NULL, 0, ENOENT,
+                                                   NSS_STATUS_SUCCESS};
+
+    memset(name, 'a', sizeof(name) - 1);
+    name[sizeof(name) - 1] = '\0';
+    for (c = 0; c < 8; c++) {
+        names[c] = name;
+    }
+
+    /* 8 names of 256 bytes do not fit into one request, three names are
+     * sent with each of the first two requests and two with the last one */
+    will_return_count(sss_nss_make_request_mux, &d_err, 3);
+    ret = sss_nss_getbatchbyname(names, 8, &res);
+    assert_int_equal(ret, EOK);
+    for (c = 0; c < 8; c++) {
+        assert_int_equal(res[c].error, ENOENT);
+    }
+    sss_nss_free_batch(res, 8);
+
+    names[3] = "";
+    ret = sss_nss_getbatchbyname(names, 8, &res);
+    assert_int_equal(ret, EINVAL);
+}
+
 int main(int argc, const char *argv[])
 {
 
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_getsidbyname),
         cmocka_unit_test(test_getorigbyname),
+        cmocka_unit_test(test_getbatchbyuid),
+        cmocka_unit_test(test_getbatchbyname_split),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
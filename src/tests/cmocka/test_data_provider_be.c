@@ -20,6 +20,7 @@
 #include <errno.h>
 #include <popt.h>
 #include <time.h>
+#include <sys/socket.h>
 
 #include "providers/dp_backend.h"
 #include "tests/cmocka/common_mock.h"
@@ -34,9 +35,17 @@
 #define OFFLINE_TIMEOUT 2
 #define AS_STR(param) (#param)
 
+#define TEST_ACCT_MAX_REQS 4
+
 static TALLOC_CTX *global_mock_context = NULL;
 static bool global_timer_added;
 
+/* The account requests that reached the ID back end */
+static struct be_req *global_acct_reqs[TEST_ACCT_MAX_REQS];
+static int global_acct_calls;
+
+extern struct data_provider_iface be_methods;
+
 struct tevent_timer *__real__tevent_add_timer(struct tevent_context *ev,
                                               TALLOC_CTX *mem_ctx,
                                               struct timeval next_event,
@@ -106,6 +115,178 @@ static int test_teardown(void **state)
     return 0;
 }
 
+static void test_acct_handler(struct be_req *be_req)
+{
+    assert_true(global_acct_calls < TEST_ACCT_MAX_REQS);
+    global_acct_reqs[global_acct_calls] = be_req;
+    global_acct_calls++;
+}
+
+static struct bet_ops test_acct_ops = {
+    .handler = test_acct_handler,
+};
+
+static int test_acct_setup(void **state)
+{
+    struct test_ctx *test_ctx;
+    int ret;
+
+    test_setup(state);
+    test_ctx = talloc_get_type(*state, struct test_ctx);
+
+    ret = sss_hash_create(test_ctx->be_ctx, 32,
+                          &test_ctx->be_ctx->acct_requests);
+    assert_int_equal(ret, EOK);
+    test_ctx->be_ctx->bet_info[BET_ID].bet_ops = &test_acct_ops;
+
+    memset(global_acct_reqs, 0, sizeof(global_acct_reqs));
+    global_acct_calls = 0;
+
+    return 0;
+}
+
+struct test_acct_client {
+    struct sbus_connection *client;
+    struct sbus_connection *server;
+};
+
+/* Connects a responder to the back end over a framed connection */
+static void test_acct_connect(struct test_ctx *test_ctx,
+                              struct test_acct_client *cli)
+{
+    struct be_client *becli;
+    int fds[2];
+    int ret;
+
+    ret = socketpair(PF_LOCAL, SOCK_STREAM, 0, fds);
+    assert_int_equal(ret, 0);
+
+    ret = sbus_frame_init_connection(test_ctx, test_ctx->tctx->ev,
+                                     fds[0], &cli->client);
+    assert_int_equal(ret, EOK);
+
+    ret = sbus_frame_init_connection(test_ctx, test_ctx->tctx->ev,
+                                     fds[1], &cli->server);
+    assert_int_equal(ret, EOK);
+
+    becli = talloc_zero(cli->server, struct be_client);
+    assert_non_null(becli);
+    becli->bectx = test_ctx->be_ctx;
+    becli->conn = cli->server;
+    becli->initialized = true;
+
+    ret = sbus_conn_register_iface(cli->server, &be_methods.vtable,
+                                   DP_PATH, becli);
+    assert_int_equal(ret, EOK);
+}
+
+struct test_acct_reply {
+    bool done;
+    errno_t error;
+    dbus_uint16_t err_maj;
+    dbus_uint32_t err_min;
+};
+
+static void test_acct_reply_done(DBusMessage *reply, errno_t error, void *pvt)
+{
+    struct test_acct_reply *state = pvt;
+    const char *err_msg;
+    dbus_bool_t dbret;
+
+    state->done = true;
+    state->error = error;
+    if (reply == NULL) {
+        return;
+    }
+
+    dbret = dbus_message_get_args(reply, NULL,
+                                  DBUS_TYPE_UINT16, &state->err_maj,
+                                  DBUS_TYPE_UINT32, &state->err_min,
+                                  DBUS_TYPE_STRING, &err_msg,
+                                  DBUS_TYPE_INVALID);
+    assert_true(dbret);
+}
+
+static void test_acct_send(struct test_ctx *test_ctx,
+                           struct test_acct_client *cli,
+                           const char *filter,
+                           struct test_acct_reply *state)
+{
+    DBusMessage *msg;
+    dbus_uint32_t type = BE_REQ_USER;
+    dbus_uint32_t attr_type = BE_ATTR_CORE;
+    const char *domain = test_ctx->be_ctx->domain->name;
+    dbus_bool_t dbret;
+    int ret;
+
+    memset(state, 0, sizeof(struct test_acct_reply));
+
+    msg = dbus_message_new_method_call(NULL, DP_PATH, DATA_PROVIDER_IFACE,
+                                       DATA_PROVIDER_IFACE_GETACCOUNTINFO);
+    assert_non_null(msg);
+
+    dbret = dbus_message_append_args(msg,
+                                     DBUS_TYPE_UINT32, &type,
+                                     DBUS_TYPE_UINT32, &attr_type,
+                                     DBUS_TYPE_STRING, &filter,
+                                     DBUS_TYPE_STRING, &domain,
+                                     DBUS_TYPE_INVALID);
+    assert_true(dbret);
+
+    /* the call is allocated on the connection and goes away with it */
+    ret = sbus_frame_send(cli->client, cli->client, msg, 5000,
+                          test_acct_reply_done, state, NULL);
+    assert_int_equal(ret, EOK);
+    dbus_message_unref(msg);
+}
+
+static void test_acct_wait(struct test_ctx *test_ctx,
+                           uint64_t requests,
+                           int calls)
+{
+    while (test_ctx->be_ctx->acct_stats.requests < requests
+            || global_acct_calls < calls) {
+        assert_int_equal(tevent_loop_once(test_ctx->tctx->ev), 0);
+    }
+}
+
+static void test_acct_wait_reply(struct test_ctx *test_ctx,
+                                 struct test_acct_reply *state,
+                                 dbus_uint16_t err_maj)
+{
+    while (!state->done) {
+        assert_int_equal(tevent_loop_once(test_ctx->tctx->ev), 0);
+    }
+
+    assert_int_equal(state->error, EOK);
+    assert_int_equal(state->err_maj, err_maj);
+}
+
+/* Returns the running request for @name, it is freed once terminated */
+static struct be_req *test_acct_take(const char *name)
+{
+    struct be_acct_req *ar;
+    struct be_req *be_req;
+    int i;
+
+    for (i = 0; i < global_acct_calls; i++) {
+        if (global_acct_reqs[i] == NULL) {
+            continue;
+        }
+
+        ar = talloc_get_type(be_req_get_data(global_acct_reqs[i]),
+                             struct be_acct_req);
+        if (strcmp(ar->filter_value, name) == 0) {
+            be_req = global_acct_reqs[i];
+            global_acct_reqs[i] = NULL;
+            return be_req;
+        }
+    }
+
+    fail_msg("No running request for [%s]", name);
+    return NULL;
+}
+
 static void assert_domain_state(struct sss_domain_info *dom,
                                 enum sss_domain_state expected_state)
 {
@@ -199,6 +380,108 @@ static void test_mark_subdom_offline_disabled(void **state)
                         DOM_DISABLED);
 }
 
+static void test_acct_coalesce(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type(*state, struct test_ctx);
+    struct test_acct_client cli_a;
+    struct test_acct_client cli_b;
+    struct test_acct_reply user1[3];
+    struct test_acct_reply user2;
+    struct test_acct_reply again;
+    int i;
+
+    test_acct_connect(test_ctx, &cli_a);
+    test_acct_connect(test_ctx, &cli_b);
+
+    test_acct_send(test_ctx, &cli_a, "name=user1", &user1[0]);
+    test_acct_send(test_ctx, &cli_a, "name=user1", &user1[1]);
+    test_acct_send(test_ctx, &cli_b, "name=user1", &user1[2]);
+    test_acct_send(test_ctx, &cli_b, "name=user2", &user2);
+
+    /* the identical requests only reach the back end once */
+    test_acct_wait(test_ctx, 4, 2);
+    assert_int_equal(global_acct_calls, 2);
+    assert_int_equal(test_ctx->be_ctx->acct_stats.coalesced, 2);
+
+    /* every client waiting for user1 gets the result of the lookup */
+    be_req_terminate(test_acct_take("user1"), DP_ERR_OK, EOK, NULL);
+    for (i = 0; i < 3; i++) {
+        test_acct_wait_reply(test_ctx, &user1[i], DP_ERR_OK);
+    }
+    assert_false(user2.done);
+
+    be_req_terminate(test_acct_take("user2"), DP_ERR_OFFLINE, EAGAIN, NULL);
+    test_acct_wait_reply(test_ctx, &user2, DP_ERR_OFFLINE);
+
+    /* a finished request is not joined anymore */
+    test_acct_send(test_ctx, &cli_a, "name=user1", &again);
+    test_acct_wait(test_ctx, 5, 3);
+    assert_int_equal(test_ctx->be_ctx->acct_stats.coalesced, 2);
+
+    be_req_terminate(test_acct_take("user1"), DP_ERR_OK, EOK, NULL);
+    test_acct_wait_reply(test_ctx, &again, DP_ERR_OK);
+
+    talloc_free(cli_a.client);
+    talloc_free(cli_b.client);
+}
+
+static void test_acct_waiter_gone(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type(*state, struct test_ctx);
+    struct test_acct_client cli_a;
+    struct test_acct_client cli_b;
+    struct test_acct_reply reply_a;
+    struct test_acct_reply reply_b;
+
+    test_acct_connect(test_ctx, &cli_a);
+    test_acct_connect(test_ctx, &cli_b);
+
+    /* the request of the first responder runs, the second one waits */
+    test_acct_send(test_ctx, &cli_a, "name=user1", &reply_a);
+    test_acct_wait(test_ctx, 1, 1);
+    test_acct_send(test_ctx, &cli_b, "name=user1", &reply_b);
+    test_acct_wait(test_ctx, 2, 1);
+    assert_int_equal(test_ctx->be_ctx->acct_stats.coalesced, 1);
+
+    /* the waiting responder goes away, its request with it */
+    talloc_free(cli_b.client);
+    talloc_free(cli_b.server);
+
+    be_req_terminate(test_acct_take("user1"), DP_ERR_OK, EOK, NULL);
+    test_acct_wait_reply(test_ctx, &reply_a, DP_ERR_OK);
+
+    talloc_free(cli_a.client);
+}
+
+static void test_acct_runner_gone(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type(*state, struct test_ctx);
+    struct test_acct_client cli_a;
+    struct test_acct_client cli_b;
+    struct test_acct_reply reply_a;
+    struct test_acct_reply reply_b;
+
+    test_acct_connect(test_ctx, &cli_a);
+    test_acct_connect(test_ctx, &cli_b);
+
+    /* the request of the first responder runs, the second one waits */
+    test_acct_send(test_ctx, &cli_a, "name=user1", &reply_a);
+    test_acct_wait(test_ctx, 1, 1);
+    test_acct_send(test_ctx, &cli_b, "name=user1", &reply_b);
+    test_acct_wait(test_ctx, 2, 1);
+    assert_int_equal(test_ctx->be_ctx->acct_stats.coalesced, 1);
+
+    /* the responder whose request runs goes away, the request is freed
+     * and the waiting one must still get an answer */
+    talloc_free(cli_a.client);
+    talloc_free(cli_a.server);
+
+    test_acct_wait_reply(test_ctx, &reply_b, DP_ERR_FATAL);
+    assert_int_equal(reply_b.err_min, EIO);
+
+    talloc_free(cli_b.client);
+}
+
 int main(int argc, const char *argv[])
 {
     poptContext pc;
@@ -223,6 +506,15 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_mark_subdom_offline_disabled,
                                         test_setup,
                                         test_teardown),
+        cmocka_unit_test_setup_teardown(test_acct_coalesce,
+                                        test_acct_setup,
+                                        test_teardown),
+        cmocka_unit_test_setup_teardown(test_acct_waiter_gone,
+                                        test_acct_setup,
+                                        test_teardown),
+        cmocka_unit_test_setup_teardown(test_acct_runner_gone,
+                                        test_acct_setup,
+                                        test_teardown),
     };
 
     /* Set debug level to invalid value so we can deside if -d 0 was used. */
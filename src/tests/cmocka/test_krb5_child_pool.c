@@ -0,0 +1,262 @@
+/*
+    Copyright (C) 2016 Red Hat
+
+    SSSD tests: krb5_child pool worker tests
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#include <popt.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "tests/cmocka/common_mock.h"
+
+/* The static functions of the pool worker are tested directly, main() is
+ * left out with UNIT_TESTING */
+#include "providers/krb5/krb5_child.c"
+
+#define WAIT_STEP_USEC 10000
+#define WAIT_MAX_STEPS 500
+
+static void assert_process_gone(pid_t pid)
+{
+    int i;
+
+    /* the orphan is reaped by init, which may take a moment */
+    for (i = 0; i < WAIT_MAX_STEPS; i++) {
+        if (kill(pid, 0) == -1 && errno == ESRCH) {
+            return;
+        }
+        usleep(WAIT_STEP_USEC);
+    }
+
+    kill(pid, SIGKILL);
+    fail_msg("Process [%d] outlived its pool worker", pid);
+}
+
+static int wait_status(pid_t pid)
+{
+    int status;
+
+    while (waitpid(pid, &status, 0) == -1) {
+        assert_int_equal(errno, EINTR);
+    }
+
+    return status;
+}
+
+/* A request process must not be able to write to the pipe of the worker
+ * the back end reads all replies from */
+void test_pool_detach_stdout(void **state)
+{
+    int pipefd[2];
+    int saved_stdout;
+    char c = 'x';
+    ssize_t len;
+    errno_t ret;
+
+    assert_int_equal(pipe(pipefd), 0);
+
+    saved_stdout = dup(STDOUT_FILENO);
+    assert_int_not_equal(saved_stdout, -1);
+    assert_int_not_equal(dup2(pipefd[1], STDOUT_FILENO), -1);
+    close(pipefd[1]);
+
+    ret = k5c_pool_detach_stdout();
+
+    len = write(STDOUT_FILENO, &c, sizeof(c));
+
+    assert_int_not_equal(dup2(saved_stdout, STDOUT_FILENO), -1);
+    close(saved_stdout);
+
+    assert_int_equal(ret, EOK);
+    assert_int_equal(len, sizeof(c));
+
+    /* the only write end was replaced, so nothing reached the pipe */
+    len = read(pipefd[0], &c, sizeof(c));
+    assert_int_equal(len, 0);
+    close(pipefd[0]);
+}
+
+/* When the back end kills a worker on timeout its request goes away too */
+void test_pool_die_with_worker(void **state)
+{
+    int pipefd[2];
+    pid_t worker;
+    pid_t request;
+    pid_t worker_pid;
+    ssize_t len;
+    errno_t ret;
+
+    assert_int_equal(pipe(pipefd), 0);
+
+    worker = fork();
+    assert_int_not_equal(worker, -1);
+    if (worker == 0) {
+        close(pipefd[0]);
+        worker_pid = getpid();
+
+        request = fork();
+        if (request == 0) {
+            ret = k5c_die_with_worker(worker_pid);
+            if (ret != EOK) {
+                _exit(1);
+            }
+
+            request = getpid();
+            sss_atomic_write_s(pipefd[1], &request, sizeof(request));
+            close(pipefd[1]);
+            while (true) {
+                pause();
+            }
+        }
+
+        close(pipefd[1]);
+        while (true) {
+            pause();
+        }
+    }
+
+    close(pipefd[1]);
+    len = sss_atomic_read_s(pipefd[0], &request, sizeof(request));
+    close(pipefd[0]);
+    assert_int_equal(len, sizeof(request));
+
+    assert_int_equal(kill(worker, SIGKILL), 0);
+    wait_status(worker);
+
+#ifdef HAVE_PRCTL
+    assert_process_gone(request);
+#else
+    kill(request, SIGKILL);
+#endif
+}
+
+/* A request process whose worker is already gone does not start */
+void test_pool_die_with_worker_gone(void **state)
+{
+    pid_t request;
+    int status;
+    errno_t ret;
+
+    request = fork();
+    assert_int_not_equal(request, -1);
+    if (request == 0) {
+        /* the parent is not the given worker */
+        ret = k5c_die_with_worker(getpid());
+        _exit(ret == ESRCH ? 0 : 1);
+    }
+
+    status = wait_status(request);
+    assert_true(WIFEXITED(status));
+    assert_int_equal(WEXITSTATUS(status), 0);
+}
+
+/* Requests that cannot be handled get an empty reply, the worker keeps
+ * serving requests until its input is closed */
+void test_pool_worker_bad_request(void **state)
+{
+    int to_worker[2];
+    int from_worker[2];
+    uint8_t request[sizeof(uint32_t) * 2] = { 0 };
+    uint32_t len;
+    uint32_t reply_len;
+    pid_t worker;
+    ssize_t size;
+    size_t rp = 0;
+    int status;
+    int i;
+
+    assert_int_equal(pipe(to_worker), 0);
+    assert_int_equal(pipe(from_worker), 0);
+
+    worker = fork();
+    assert_int_not_equal(worker, -1);
+    if (worker == 0) {
+        close(to_worker[1]);
+        close(from_worker[0]);
+        if (dup2(to_worker[0], STDIN_FILENO) == -1
+                || dup2(from_worker[1], STDOUT_FILENO) == -1) {
+            _exit(1);
+        }
+        close(to_worker[0]);
+        close(from_worker[1]);
+
+        _exit(k5c_pool_worker(getuid(), getgid()) == EOK ? 0 : 1);
+    }
+
+    close(to_worker[0]);
+    close(from_worker[1]);
+
+    /* only the command, the rest of the request is missing */
+    len = sizeof(uint32_t);
+    SAFEALIGN_COPY_UINT32(request, &len, &rp);
+    SAFEALIGN_SETMEM_UINT32(request + rp, SSS_PAM_AUTHENTICATE, &rp);
+
+    for (i = 0; i < 2; i++) {
+        size = sss_atomic_write_s(to_worker[1], request, rp);
+        assert_int_equal(size, rp);
+
+        size = sss_atomic_read_s(from_worker[0], &reply_len,
+                                 sizeof(reply_len));
+        assert_int_equal(size, sizeof(reply_len));
+        assert_int_equal(reply_len, 0);
+    }
+
+    close(to_worker[1]);
+    status = wait_status(worker);
+    close(from_worker[0]);
+
+    assert_true(WIFEXITED(status));
+    assert_int_equal(WEXITSTATUS(status), 0);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_pool_detach_stdout),
+        cmocka_unit_test(test_pool_die_with_worker),
+        cmocka_unit_test(test_pool_die_with_worker_gone),
+        cmocka_unit_test(test_pool_worker_bad_request),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
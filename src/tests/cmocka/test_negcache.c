@@ -621,6 +621,147 @@ static void test_sss_ncache_reset_permanent(void **state)
     assert_int_equal(ret, ENOENT);
 }
 
+/* Only the permanent entries may be removed by the reset and the table must
+ * keep all entries while it grows */
+static void test_sss_ncache_reset_keeps_timed(void **state)
+{
+    int ret;
+    uid_t uid;
+    struct test_state *ts;
+    const int num = 5000;
+
+    ts = talloc_get_type_abort(*state, struct test_state);
+
+    for (uid = 0; uid < num; uid++) {
+        ret = sss_ncache_set_uid(ts->ctx, uid % 2 == 0, NULL, uid);
+        assert_int_equal(ret, EOK);
+    }
+
+    for (uid = 0; uid < num; uid++) {
+        ret = sss_ncache_check_uid(ts->ctx, LIFETIME, NULL, uid);
+        assert_int_equal(ret, EEXIST);
+    }
+
+    ret = sss_ncache_reset_permanent(ts->ctx);
+    assert_int_equal(ret, EOK);
+
+    for (uid = 0; uid < num; uid++) {
+        ret = sss_ncache_check_uid(ts->ctx, LIFETIME, NULL, uid);
+        assert_int_equal(ret, uid % 2 == 0 ? ENOENT : EEXIST);
+    }
+
+    /* a temporary entry replaces a permanent one */
+    ret = sss_ncache_set_uid(ts->ctx, true, NULL, num);
+    assert_int_equal(ret, EOK);
+    ret = sss_ncache_set_uid(ts->ctx, false, NULL, num);
+    assert_int_equal(ret, EOK);
+
+    ret = sss_ncache_reset_permanent(ts->ctx);
+    assert_int_equal(ret, EOK);
+
+    ret = sss_ncache_check_uid(ts->ctx, LIFETIME, NULL, num);
+    assert_int_equal(ret, EEXIST);
+}
+
+/* Expired entries are dropped when the table grows even if they are never
+ * looked up again */
+static void test_sss_ncache_purge_on_rehash(void **state)
+{
+    int ret;
+    uid_t uid;
+    struct test_state *ts;
+    const int num = 150;
+
+    ts = talloc_get_type_abort(*state, struct test_state);
+
+    ret = sss_ncache_set_timeout(ts->ctx, NULL, SHORTSPAN);
+    assert_int_equal(ret, EOK);
+
+    for (uid = 0; uid < num; uid++) {
+        ret = sss_ncache_set_uid(ts->ctx, false, NULL, uid);
+        assert_int_equal(ret, EOK);
+    }
+    ret = sss_ncache_set_uid(ts->ctx, true, NULL, 2 * num);
+    assert_int_equal(ret, EOK);
+
+    sleep(SHORTSPAN + 1);
+
+    /* enough new entries to rebuild the table */
+    for (uid = num; uid < 2 * num; uid++) {
+        ret = sss_ncache_set_uid(ts->ctx, false, NULL, uid);
+        assert_int_equal(ret, EOK);
+    }
+
+    /* a ttl of -1 would still find the entries if they were kept */
+    for (uid = 0; uid < num; uid++) {
+        ret = sss_ncache_check_uid(ts->ctx, -1, NULL, uid);
+        assert_int_equal(ret, ENOENT);
+    }
+    for (uid = num; uid < 2 * num; uid++) {
+        ret = sss_ncache_check_uid(ts->ctx, LIFETIME, NULL, uid);
+        assert_int_equal(ret, EEXIST);
+    }
+    ret = sss_ncache_check_uid(ts->ctx, -1, NULL, 2 * num);
+    assert_int_equal(ret, EEXIST);
+}
+
+/* Expired entries are dropped periodically */
+static void test_sss_ncache_purge_timer(void **state)
+{
+    int ret;
+    uid_t uid;
+    struct test_state *ts;
+    struct tevent_context *ev;
+    size_t blocks;
+    const int num = 1000;
+
+    ts = talloc_get_type_abort(*state, struct test_state);
+
+    ev = tevent_context_init(ts);
+    assert_non_null(ev);
+
+    ret = sss_ncache_set_timeout(ts->ctx, ev, SHORTSPAN);
+    assert_int_equal(ret, EOK);
+
+    for (uid = 0; uid < num; uid++) {
+        ret = sss_ncache_set_uid(ts->ctx, false, NULL, uid);
+        assert_int_equal(ret, EOK);
+    }
+    ret = sss_ncache_set_uid(ts->ctx, true, NULL, num);
+    assert_int_equal(ret, EOK);
+    blocks = talloc_total_blocks(ts->ctx);
+
+    /* the first run of the timer does not find any expired entry */
+    sleep(SHORTSPAN);
+    ret = tevent_loop_once(ev);
+    assert_int_equal(ret, 0);
+
+    sleep(SHORTSPAN + 1);
+    ret = tevent_loop_once(ev);
+    assert_int_equal(ret, 0);
+
+    assert_true(talloc_total_blocks(ts->ctx) < blocks);
+    for (uid = 0; uid < num; uid++) {
+        ret = sss_ncache_check_uid(ts->ctx, -1, NULL, uid);
+        assert_int_equal(ret, ENOENT);
+    }
+    ret = sss_ncache_check_uid(ts->ctx, -1, NULL, num);
+    assert_int_equal(ret, EEXIST);
+
+    /* the purge is rescheduled */
+    ret = sss_ncache_set_uid(ts->ctx, false, NULL, 0);
+    assert_int_equal(ret, EOK);
+    sleep(SHORTSPAN + 1);
+    ret = tevent_loop_once(ev);
+    assert_int_equal(ret, 0);
+    ret = sss_ncache_check_uid(ts->ctx, -1, NULL, 0);
+    assert_int_equal(ret, ENOENT);
+
+    ret = sss_ncache_set_timeout(ts->ctx, NULL, 0);
+    assert_int_equal(ret, EOK);
+    talloc_free(ev);
+}
+
 static void test_sss_ncache_prepopulate(void **state)
 {
     int ret;
@@ -860,6 +1001,12 @@ int main(void)
                                         setup, teardown),
         cmocka_unit_test_setup_teardown(test_sss_ncache_reset_permanent, setup,
                                         teardown),
+        cmocka_unit_test_setup_teardown(test_sss_ncache_reset_keeps_timed,
+                                        setup, teardown),
+        cmocka_unit_test_setup_teardown(test_sss_ncache_purge_on_rehash,
+                                        setup, teardown),
+        cmocka_unit_test_setup_teardown(test_sss_ncache_purge_timer,
+                                        setup, teardown),
         cmocka_unit_test_setup_teardown(test_sss_ncache_prepopulate,
                                         setup, teardown),
         cmocka_unit_test_setup_teardown(test_sss_ncache_default_domain_suffix,
@@ -579,17 +579,11 @@ static void nested_groups_test_nested_chain_with_error(void **state)
     assert_int_equal(ret, EIO);
 }
 
-static int nested_groups_test_setup(void **state)
+static int nested_groups_setup_params(void **state,
+                                      struct sss_test_conf_param *params)
 {
     errno_t ret;
     struct nested_groups_test_ctx *test_ctx = NULL;
-    static struct sss_test_conf_param params[] = {
-        { "ldap_schema", "rfc2307bis" }, /* enable nested groups */
-        { "ldap_search_base", OBJECT_BASE_DN },
-        { "ldap_user_search_base", USER_BASE_DN },
-        { "ldap_group_search_base", GROUP_BASE_DN },
-        { NULL, NULL }
-    };
 
     test_ctx = talloc_zero(NULL, struct nested_groups_test_ctx);
     assert_non_null(test_ctx);
@@ -629,6 +623,19 @@ static int nested_groups_test_setup(void **state)
     return 0;
 }
 
+static int nested_groups_test_setup(void **state)
+{
+    static struct sss_test_conf_param params[] = {
+        { "ldap_schema", "rfc2307bis" }, /* enable nested groups */
+        { "ldap_search_base", OBJECT_BASE_DN },
+        { "ldap_user_search_base", USER_BASE_DN },
+        { "ldap_group_search_base", GROUP_BASE_DN },
+        { NULL, NULL }
+    };
+
+    return nested_groups_setup_params(state, params);
+}
+
 static int nested_groups_test_teardown(void **state)
 {
     talloc_zfree(*state);
@@ -1147,6 +1154,308 @@ static void nested_group_external_member_test(void **state)
 }
 
 
+/* Benchmark of nested group resolution. The directory is a tree of groups
+ * NESTED_BENCH_DEPTH levels deep where each group has NESTED_BENCH_USERS
+ * users and NESTED_BENCH_FANOUT nested groups. Each search is answered
+ * after NESTED_BENCH_LATENCY microseconds. */
+#define NESTED_BENCH_USERS      20
+#define NESTED_BENCH_FANOUT     4
+#define NESTED_BENCH_DEPTH      3
+#define NESTED_BENCH_GROUPS     (1 + 4 + 16 + 64)
+#define NESTED_BENCH_LATENCY    500
+
+struct nested_groups_bench {
+    const char *user_filter;
+    size_t searches;
+};
+
+static bool nested_groups_bench_parse(const char *dn,
+                                      const char *prefix,
+                                      const char *base_dn,
+                                      unsigned int max_id,
+                                      unsigned int *_id)
+{
+    size_t prefix_len = strlen(prefix);
+    unsigned long id;
+    char *end;
+
+    if (strncasecmp(dn, prefix, prefix_len) != 0) {
+        return false;
+    }
+
+    id = strtoul(dn + prefix_len, &end, 10);
+    if (end == dn + prefix_len || *end != ',' || id >= max_id) {
+        return false;
+    }
+
+    if (strcasecmp(end + 1, base_dn) != 0) {
+        return false;
+    }
+
+    *_id = id;
+    return true;
+}
+
+static struct sysdb_attrs *
+nested_groups_bench_group(TALLOC_CTX *mem_ctx, unsigned int id)
+{
+    const char *members[NESTED_BENCH_USERS + NESTED_BENCH_FANOUT + 1];
+    struct sysdb_attrs *group;
+    TALLOC_CTX *tmp_ctx;
+    unsigned int child;
+    char *value;
+    int n = 0;
+    int i;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    for (i = 0; i < NESTED_BENCH_USERS; i++) {
+        members[n] = talloc_asprintf(tmp_ctx, "cn=user%u,%s",
+                                     id * NESTED_BENCH_USERS + i,
+                                     USER_BASE_DN);
+        assert_non_null(members[n]);
+        n++;
+    }
+
+    for (i = 1; i <= NESTED_BENCH_FANOUT; i++) {
+        child = id * NESTED_BENCH_FANOUT + i;
+        if (child >= NESTED_BENCH_GROUPS) {
+            break;
+        }
+
+        members[n] = talloc_asprintf(tmp_ctx, "cn=group%u,%s",
+                                     child, GROUP_BASE_DN);
+        assert_non_null(members[n]);
+        n++;
+    }
+    members[n] = NULL;
+
+    value = talloc_asprintf(tmp_ctx, "group%u", id);
+    assert_non_null(value);
+
+    group = mock_sysdb_group_rfc2307bis(mem_ctx, GROUP_BASE_DN, 20000 + id,
+                                        value, members);
+    assert_non_null(group);
+
+    /* only security groups are POSIX groups in AD */
+    value = talloc_asprintf(tmp_ctx, "%d",
+                            (int32_t) (SDAP_AD_GROUP_TYPE_SECURITY
+                                       | SDAP_AD_GROUP_TYPE_GLOBAL));
+    assert_non_null(value);
+
+    ret = sysdb_attrs_add_string(group, SYSDB_GROUP_TYPE, value);
+    assert_int_equal(ret, EOK);
+
+    talloc_free(tmp_ctx);
+    return group;
+}
+
+static struct sysdb_attrs *
+nested_groups_bench_entry(TALLOC_CTX *mem_ctx, const char *dn, bool is_user)
+{
+    struct sysdb_attrs *user;
+    unsigned int id;
+    char *name;
+
+    if (!is_user) {
+        if (!nested_groups_bench_parse(dn, "cn=group", GROUP_BASE_DN,
+                                       NESTED_BENCH_GROUPS, &id)) {
+            return NULL;
+        }
+
+        return nested_groups_bench_group(mem_ctx, id);
+    }
+
+    if (!nested_groups_bench_parse(dn, "cn=user", USER_BASE_DN,
+                                   NESTED_BENCH_GROUPS * NESTED_BENCH_USERS,
+                                   &id)) {
+        return NULL;
+    }
+
+    name = talloc_asprintf(mem_ctx, "user%u", id);
+    assert_non_null(name);
+
+    user = mock_sysdb_user(mem_ctx, USER_BASE_DN, 10000 + id, name);
+    assert_non_null(user);
+
+    talloc_free(name);
+    return user;
+}
+
+static errno_t nested_groups_bench_search(TALLOC_CTX *mem_ctx,
+                                          const char *search_base,
+                                          int scope,
+                                          const char *filter,
+                                          void *pvt,
+                                          size_t *_reply_count,
+                                          struct sysdb_attrs ***_reply)
+{
+    static const char dn_attr[] = "(distinguishedName=";
+    struct nested_groups_bench *bench = pvt;
+    struct sysdb_attrs **reply;
+    const char *p;
+    const char *end;
+    char *dn;
+    size_t count = 0;
+    size_t max = 1;
+    bool is_user;
+
+    bench->searches++;
+    is_user = strcasestr(filter, bench->user_filter) != NULL;
+
+    for (p = strstr(filter, dn_attr); p != NULL; p = strstr(p + 1, dn_attr)) {
+        max++;
+    }
+
+    reply = talloc_zero_array(mem_ctx, struct sysdb_attrs *, max);
+    assert_non_null(reply);
+
+    if (scope == LDAP_SCOPE_BASE) {
+        reply[count] = nested_groups_bench_entry(reply, search_base, is_user);
+        if (reply[count] != NULL) {
+            count++;
+        }
+    } else {
+        for (p = strstr(filter, dn_attr); p != NULL; p = strstr(p, dn_attr)) {
+            p += sizeof(dn_attr) - 1;
+            end = strchr(p, ')');
+            assert_non_null(end);
+
+            dn = talloc_strndup(reply, p, end - p);
+            assert_non_null(dn);
+
+            reply[count] = nested_groups_bench_entry(reply, dn, is_user);
+            if (reply[count] != NULL) {
+                count++;
+            }
+            talloc_free(dn);
+        }
+    }
+
+    *_reply_count = count;
+    *_reply = reply;
+    return EOK;
+}
+
+static void nested_groups_bench_run(struct nested_groups_test_ctx *test_ctx,
+                                    int parallel,
+                                    int batch_size,
+                                    struct timeval *_elapsed)
+{
+    struct sysdb_attrs *rootgroup = NULL;
+    struct tevent_req *req = NULL;
+    struct timeval start;
+    struct timeval end;
+    errno_t ret;
+
+    ret = dp_opt_set_int(test_ctx->sdap_opts->basic,
+                         SDAP_NESTED_GROUP_PARALLEL, parallel);
+    assert_int_equal(ret, EOK);
+
+    ret = dp_opt_set_int(test_ctx->sdap_opts->basic,
+                         SDAP_NESTED_GROUP_BATCH_SIZE, batch_size);
+    assert_int_equal(ret, EOK);
+
+    rootgroup = nested_groups_bench_group(test_ctx, 0);
+    test_ctx->tctx->done = false;
+
+    start = tevent_timeval_current();
+
+    req = sdap_nested_group_send(test_ctx, test_ctx->tctx->ev,
+                                 test_ctx->sdap_domain, test_ctx->sdap_opts,
+                                 test_ctx->sdap_handle, rootgroup);
+    assert_non_null(req);
+    tevent_req_set_callback(req, nested_groups_test_done, test_ctx);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, ERR_OK);
+
+    end = tevent_timeval_current();
+    *_elapsed = tevent_timeval_until(&start, &end);
+
+    /* all groups and users of the tree are found */
+    assert_int_equal(test_ctx->num_users,
+                     NESTED_BENCH_GROUPS * NESTED_BENCH_USERS);
+    assert_int_equal(test_ctx->num_groups, NESTED_BENCH_GROUPS);
+
+    talloc_zfree(test_ctx->users);
+    talloc_zfree(test_ctx->groups);
+}
+
+static void nested_groups_bench(void **state)
+{
+    struct nested_groups_test_ctx *test_ctx = NULL;
+    struct nested_groups_bench *bench = NULL;
+    struct timeval serial_time;
+    struct timeval batched_time;
+    size_t serial_searches;
+    size_t batched_searches;
+
+    test_ctx = talloc_get_type_abort(*state, struct nested_groups_test_ctx);
+
+    bench = talloc_zero(test_ctx, struct nested_groups_bench);
+    assert_non_null(bench);
+
+    bench->user_filter = talloc_asprintf(bench, "(objectclass=%s)",
+                        test_ctx->sdap_opts->user_map[SDAP_OC_USER].name);
+    assert_non_null(bench->user_filter);
+
+    sss_will_return_always(sdap_has_deref_support, false);
+    mock_sdap_set_search_handler(nested_groups_bench_search, bench,
+                                 NESTED_BENCH_LATENCY);
+
+    /* one member at a time */
+    nested_groups_bench_run(test_ctx, 1, 1, &serial_time);
+    serial_searches = bench->searches;
+    bench->searches = 0;
+
+    /* default settings */
+    nested_groups_bench_run(test_ctx, 8, 50, &batched_time);
+    batched_searches = bench->searches;
+
+    print_message("%d groups with %d users, %d levels deep, "
+                  "%d usec per search\n",
+                  NESTED_BENCH_GROUPS, NESTED_BENCH_GROUPS * NESTED_BENCH_USERS,
+                  NESTED_BENCH_DEPTH, NESTED_BENCH_LATENCY);
+    print_message("serial:  %6zu searches in %ld.%06ld s\n",
+                  serial_searches, (long) serial_time.tv_sec,
+                  (long) serial_time.tv_usec);
+    print_message("batched: %6zu searches in %ld.%06ld s\n",
+                  batched_searches, (long) batched_time.tv_sec,
+                  (long) batched_time.tv_usec);
+
+    /* a base search for every member except the root group */
+    assert_int_equal(serial_searches,
+                     NESTED_BENCH_GROUPS - 1
+                     + NESTED_BENCH_GROUPS * NESTED_BENCH_USERS);
+
+    /* at most one search for the users and one for the nested groups
+     * of each group */
+    assert_true(batched_searches <= 2 * NESTED_BENCH_GROUPS);
+}
+
+static int nested_groups_bench_setup(void **state)
+{
+    static struct sss_test_conf_param params[] = {
+        { "ldap_schema", "ad" }, /* enable batched lookups */
+        { "ldap_search_base", OBJECT_BASE_DN },
+        { "ldap_user_search_base", USER_BASE_DN },
+        { "ldap_group_search_base", GROUP_BASE_DN },
+        { "ldap_group_nesting_level", "3" },
+        { NULL, NULL }
+    };
+
+    return nested_groups_setup_params(state, params);
+}
+
+static int nested_groups_bench_teardown(void **state)
+{
+    mock_sdap_set_search_handler(NULL, NULL, 0);
+    return nested_groups_test_teardown(state);
+}
+
 int main(int argc, const char *argv[])
 {
     int rv;
@@ -1172,6 +1481,9 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(nested_group_external_member_test,
                                         nested_group_external_member_setup,
                                         nested_group_external_member_teardown),
+        cmocka_unit_test_setup_teardown(nested_groups_bench,
+                                        nested_groups_bench_setup,
+                                        nested_groups_bench_teardown),
     };
 
     /* Set debug level to invalid value so we can deside if -d 0 was used. */
@@ -31,6 +31,7 @@
 #include "responder/nss/nsssrv.h"
 #include "responder/nss/nsssrv_private.h"
 #include "sss_client/idmap/sss_nss_idmap.h"
+#include "util/mmap_cache.h"
 #include "util/util_sss_idmap.h"
 #include "db/sysdb_private.h"   /* new_subdomain() */
 
@@ -1810,6 +1811,188 @@ void test_nss_well_known_getsidbyname_special(void **state)
     }
 }
 
+static int test_nss_getbatch_well_known_check(uint32_t status,
+                                              uint8_t *body, size_t blen)
+{
+    const char *expected[] = { "Print Operators@BUILTIN", "S-1-5-32-550",
+                               "LOCAL@LOCAL AUTHORITY", "S-1-2-0",
+                               "Print Operators@BUILTIN", "S-1-5-32-550" };
+    uint32_t num_results;
+    uint32_t error;
+    uint32_t type;
+    uint32_t id;
+    size_t rp = 0;
+    size_t c;
+
+    assert_int_equal(status, EOK);
+
+    SAFEALIGN_COPY_UINT32(&num_results, body, &rp);
+    assert_int_equal(num_results, 3);
+    rp += sizeof(uint32_t); /* reserved */
+
+    for (c = 0; c < num_results; c++) {
+        SAFEALIGN_COPY_UINT32(&error, body + rp, &rp);
+        SAFEALIGN_COPY_UINT32(&type, body + rp, &rp);
+        SAFEALIGN_COPY_UINT32(&id, body + rp, &rp);
+        assert_int_equal(error, EOK);
+        assert_int_equal(type, SSS_ID_TYPE_GID);
+        assert_int_equal(id, 0);
+
+        assert_string_equal((const char *) body + rp, expected[2 * c]);
+        rp += strlen(expected[2 * c]) + 1;
+        assert_string_equal((const char *) body + rp, expected[2 * c + 1]);
+        rp += strlen(expected[2 * c + 1]) + 1;
+    }
+
+    assert_int_equal(rp, blen);
+    return EOK;
+}
+
+void test_nss_getbatch_well_known_sid(void **state)
+{
+    errno_t ret;
+    const char *sids[] = { "S-1-5-32-550", "S-1-2-0", "S-1-5-32-550" };
+    uint8_t *body;
+    size_t blen;
+    size_t rp = 0;
+    size_t c;
+
+    blen = 2 * sizeof(uint32_t);
+    for (c = 0; c < 3; c++) {
+        blen += strlen(sids[c]) + 1;
+    }
+
+    body = talloc_size(nss_test_ctx, blen);
+    assert_non_null(body);
+
+    SAFEALIGN_SETMEM_UINT32(body, SSS_NSS_KEY_SID, &rp);
+    SAFEALIGN_SETMEM_UINT32(body + rp, 3, &rp);
+    for (c = 0; c < 3; c++) {
+        memcpy(body + rp, sids[c], strlen(sids[c]) + 1);
+        rp += strlen(sids[c]) + 1;
+    }
+
+    will_return(__wrap_sss_packet_get_body, WRAP_CALL_WRAPPER);
+    will_return(__wrap_sss_packet_get_body, body);
+    will_return(__wrap_sss_packet_get_body, blen);
+    will_return(__wrap_sss_packet_get_cmd, SSS_NSS_GETBATCH);
+    /* the header of the reply and one result per key */
+    will_return_count(__wrap_sss_packet_get_body, WRAP_CALL_REAL, 4);
+
+    set_cmd_cb(test_nss_getbatch_well_known_check);
+    ret = sss_cmd_execute(nss_test_ctx->cctx, SSS_NSS_GETBATCH,
+                          nss_test_ctx->nss_cmds);
+    assert_int_equal(ret, EOK);
+
+    /* Wait until the test finishes with EOK */
+    ret = test_ev_loop(nss_test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+
+    talloc_free(body);
+}
+
+static int test_nss_mc_stats_check(uint32_t status, uint8_t *body,
+                                   size_t blen)
+{
+    assert_int_equal(status, EOK);
+    assert_int_equal(blen, 0);
+    return EOK;
+}
+
+static void mock_input_mc_stats(struct sss_mc_stats_report *report)
+{
+    will_return(__wrap_sss_packet_get_body, WRAP_CALL_WRAPPER);
+    will_return(__wrap_sss_packet_get_body, report);
+    will_return(__wrap_sss_packet_get_body, sizeof(*report));
+}
+
+/* The counts the clients report are added up */
+void test_nss_mc_stats(void **state)
+{
+    struct sss_mc_stats_report report;
+    struct sss_mc_stats *stats;
+    errno_t ret;
+    int i;
+
+    stats = talloc_zero(nss_test_ctx, struct sss_mc_stats);
+    assert_non_null(stats);
+    nss_test_ctx->nctx->mc_stats = stats;
+
+    memset(&report, 0, sizeof(report));
+    report.vno = SSS_MC_STATS_VNO;
+    report.num_caches = SSS_MC_STATS_NUM;
+    report.caches[SSS_MC_STATS_PASSWD].hits = 5;
+    report.caches[SSS_MC_STATS_PASSWD].chain_len[1] = 5;
+    report.caches[SSS_MC_STATS_NEGATIVE].misses = 2;
+
+    for (i = 0; i < 2; i++) {
+        nss_test_ctx->tctx->done = false;
+
+        mock_input_mc_stats(&report);
+        will_return(__wrap_sss_packet_get_cmd, SSS_NSS_MC_STATS);
+
+        set_cmd_cb(test_nss_mc_stats_check);
+        ret = sss_cmd_execute(nss_test_ctx->cctx, SSS_NSS_MC_STATS,
+                              nss_test_ctx->nss_cmds);
+        assert_int_equal(ret, EOK);
+
+        ret = test_ev_loop(nss_test_ctx->tctx);
+        assert_int_equal(ret, EOK);
+    }
+
+    assert_int_equal(stats->caches[SSS_MC_STATS_PASSWD].hits, 10);
+    assert_int_equal(stats->caches[SSS_MC_STATS_PASSWD].chain_len[1], 10);
+    assert_int_equal(stats->caches[SSS_MC_STATS_PASSWD].misses, 0);
+    assert_int_equal(stats->caches[SSS_MC_STATS_NEGATIVE].misses, 4);
+    assert_int_equal(stats->caches[SSS_MC_STATS_GROUP].hits, 0);
+
+    nss_test_ctx->nctx->mc_stats = NULL;
+    talloc_free(stats);
+}
+
+/* Reports of another layout are refused and nothing is counted */
+void test_nss_mc_stats_invalid(void **state)
+{
+    struct sss_mc_stats_report report;
+    struct sss_mc_stats *stats;
+    errno_t ret;
+
+    stats = talloc_zero(nss_test_ctx, struct sss_mc_stats);
+    assert_non_null(stats);
+    nss_test_ctx->nctx->mc_stats = stats;
+
+    memset(&report, 0, sizeof(report));
+    report.vno = SSS_MC_STATS_VNO + 1;
+    report.num_caches = SSS_MC_STATS_NUM;
+    report.caches[SSS_MC_STATS_PASSWD].hits = 5;
+
+    mock_input_mc_stats(&report);
+    ret = sss_cmd_execute(nss_test_ctx->cctx, SSS_NSS_MC_STATS,
+                          nss_test_ctx->nss_cmds);
+    assert_int_equal(ret, EINVAL);
+
+    report.vno = SSS_MC_STATS_VNO;
+    report.num_caches = SSS_MC_STATS_NUM + 1;
+
+    mock_input_mc_stats(&report);
+    ret = sss_cmd_execute(nss_test_ctx->cctx, SSS_NSS_MC_STATS,
+                          nss_test_ctx->nss_cmds);
+    assert_int_equal(ret, EINVAL);
+
+    /* a short body */
+    will_return(__wrap_sss_packet_get_body, WRAP_CALL_WRAPPER);
+    will_return(__wrap_sss_packet_get_body, &report);
+    will_return(__wrap_sss_packet_get_body, sizeof(report) - 1);
+    ret = sss_cmd_execute(nss_test_ctx->cctx, SSS_NSS_MC_STATS,
+                          nss_test_ctx->nss_cmds);
+    assert_int_equal(ret, EINVAL);
+
+    assert_int_equal(stats->caches[SSS_MC_STATS_PASSWD].hits, 0);
+
+    nss_test_ctx->nctx->mc_stats = NULL;
+    talloc_free(stats);
+}
+
 static int test_nss_getorigbyname_check(uint32_t status, uint8_t *body,
                                         size_t blen)
 {
@@ -2983,6 +3166,12 @@ int main(int argc, const char *argv[])
                                         nss_test_setup, nss_test_teardown),
         cmocka_unit_test_setup_teardown(test_nss_well_known_getsidbyname_special,
                                         nss_test_setup, nss_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nss_getbatch_well_known_sid,
+                                        nss_test_setup, nss_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nss_mc_stats,
+                                        nss_test_setup, nss_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nss_mc_stats_invalid,
+                                        nss_test_setup, nss_test_teardown),
         cmocka_unit_test_setup_teardown(test_nss_getorigbyname,
                                         nss_test_setup,
                                         nss_test_teardown),
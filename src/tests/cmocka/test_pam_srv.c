@@ -913,6 +913,8 @@ void test_pam_cached_auth_success(void **state)
 
     /* Back end should not be contacted */
     assert_false(pam_test_ctx->provider_contacted);
+    assert_int_equal(pam_test_ctx->pctx->cached_auth_stats.served, 1);
+    assert_int_equal(pam_test_ctx->pctx->cached_auth_stats.failed, 0);
 }
 
 void test_pam_cached_auth_wrong_pw(void **state)
@@ -930,6 +932,25 @@ void test_pam_cached_auth_wrong_pw(void **state)
 
     /* Back end should be contacted */
     assert_true(pam_test_ctx->provider_contacted);
+    assert_int_equal(pam_test_ctx->pctx->cached_auth_stats.served, 0);
+    assert_int_equal(pam_test_ctx->pctx->cached_auth_stats.failed, 1);
+}
+
+/* no cached password although the last on-line authentication is fresh */
+void test_pam_cached_auth_no_cached_pw(void **state)
+{
+    int ret;
+
+    ret = pam_set_last_online_auth_with_curr_token(pam_test_ctx->tctx->dom,
+                                                   "pamuser", time(NULL));
+    assert_int_equal(ret, EOK);
+
+    common_test_pam_cached_auth("12345");
+
+    /* Back end should be contacted */
+    assert_true(pam_test_ctx->provider_contacted);
+    assert_int_equal(pam_test_ctx->pctx->cached_auth_stats.served, 0);
+    assert_int_equal(pam_test_ctx->pctx->cached_auth_stats.failed, 1);
 }
 
 /* test cached_auth_timeout option */
@@ -969,6 +990,7 @@ void test_pam_cached_auth_timeout(void **state)
 
     /* Back end should be contacted */
     assert_true(pam_test_ctx->provider_contacted);
+    assert_int_equal(pam_test_ctx->pctx->cached_auth_stats.stale, 1);
 }
 
 void test_pam_cached_auth_success_combined_pw_with_cached_2fa(void **state)
@@ -1675,6 +1697,9 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_pam_cached_auth_wrong_pw,
                                         pam_cached_test_setup,
                                         pam_test_teardown),
+        cmocka_unit_test_setup_teardown(test_pam_cached_auth_no_cached_pw,
+                                        pam_cached_test_setup,
+                                        pam_test_teardown),
         cmocka_unit_test_setup_teardown(test_pam_cached_auth_opt_timeout,
                                         pam_cached_test_setup,
                                         pam_test_teardown),
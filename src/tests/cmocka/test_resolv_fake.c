@@ -257,23 +257,32 @@ static int test_resolv_fake_teardown(void **state)
     return 0;
 }
 
-void test_resolv_fake_srv_done(struct tevent_req *req)
+static void mock_srv_answer(TALLOC_CTX *mem_ctx)
 {
-    errno_t ret;
-    TALLOC_CTX *tmp_ctx;
-    int status;
-    uint32_t ttl;
-    struct ares_srv_reply *srv_replies = NULL;
-    struct resolv_fake_ctx *test_ctx =
-        tevent_req_callback_data(req, struct resolv_fake_ctx);
+    unsigned char *buf;
+    size_t buflen;
 
-    tmp_ctx = talloc_new(test_ctx);
-    assert_non_null(tmp_ctx);
+    struct srv_rrdata rr[2];
 
-    ret = resolv_getsrv_recv(tmp_ctx, req, &status, NULL,
-                             &srv_replies, &ttl);
-    assert_int_equal(ret, EOK);
+    rr[0].prio = 1;
+    rr[0].port = 389;
+    rr[0].weight = 40;
+    rr[0].ttl = 600;
+    rr[0].hostname = "ldap.sssd.com";
 
+    rr[1].prio = 1;
+    rr[1].port = 389;
+    rr[1].weight = 60;
+    rr[1].ttl = 500;
+    rr[1].hostname = "ldap2.sssd.com";
+
+    buf = create_srv_buffer(mem_ctx, TEST_SRV_QUERY, rr, 2, &buflen);
+    assert_non_null(buf);
+    mock_ares_query(0, 0, buf, buflen);
+}
+
+static void check_srv_replies(struct ares_srv_reply *srv_replies)
+{
     assert_non_null(srv_replies);
     assert_int_equal(srv_replies->priority, 1);
     assert_int_equal(srv_replies->weight, 40);
@@ -289,7 +298,26 @@ void test_resolv_fake_srv_done(struct tevent_req *req)
 
     srv_replies = srv_replies->next;
     assert_null(srv_replies);
+}
 
+void test_resolv_fake_srv_done(struct tevent_req *req)
+{
+    errno_t ret;
+    TALLOC_CTX *tmp_ctx;
+    int status;
+    uint32_t ttl;
+    struct ares_srv_reply *srv_replies = NULL;
+    struct resolv_fake_ctx *test_ctx =
+        tevent_req_callback_data(req, struct resolv_fake_ctx);
+
+    tmp_ctx = talloc_new(test_ctx);
+    assert_non_null(tmp_ctx);
+
+    ret = resolv_getsrv_recv(tmp_ctx, req, &status, NULL,
+                             &srv_replies, &ttl);
+    assert_int_equal(ret, EOK);
+
+    check_srv_replies(srv_replies);
     assert_int_equal(ttl, 500);
 
     talloc_free(tmp_ctx);
@@ -303,26 +331,7 @@ void test_resolv_fake_srv(void **state)
     struct resolv_fake_ctx *test_ctx =
         talloc_get_type(*state, struct resolv_fake_ctx);
 
-    unsigned char *buf;
-    size_t buflen;
-
-    struct srv_rrdata rr[2];
-
-    rr[0].prio = 1;
-    rr[0].port = 389;
-    rr[0].weight = 40;
-    rr[0].ttl = 600;
-    rr[0].hostname = "ldap.sssd.com";
-
-    rr[1].prio = 1;
-    rr[1].port = 389;
-    rr[1].weight = 60;
-    rr[1].ttl = 500;
-    rr[1].hostname = "ldap2.sssd.com";
-
-    buf = create_srv_buffer(test_ctx, TEST_SRV_QUERY, rr, 2, &buflen);
-    assert_non_null(buf);
-    mock_ares_query(0, 0, buf, buflen);
+    mock_srv_answer(test_ctx);
 
     req = resolv_getsrv_send(test_ctx, test_ctx->ctx->ev,
                              test_ctx->resolv, TEST_SRV_QUERY);
@@ -333,6 +342,102 @@ void test_resolv_fake_srv(void **state)
     assert_int_equal(ret, ERR_OK);
 }
 
+struct resolv_fake_cache_state {
+    struct resolv_fake_ctx *test_ctx;
+    int done;
+};
+
+static void test_resolv_fake_srv_cached_done(struct tevent_req *req);
+
+static void test_resolv_fake_srv_cached_check(struct tevent_req *req)
+{
+    errno_t ret;
+    uint32_t ttl;
+    struct ares_srv_reply *srv_replies = NULL;
+    struct resolv_fake_cache_state *state =
+        tevent_req_callback_data(req, struct resolv_fake_cache_state);
+
+    ret = resolv_getsrv_recv(state, req, NULL, NULL, &srv_replies, &ttl);
+    talloc_free(req);
+    assert_int_equal(ret, EOK);
+
+    check_srv_replies(srv_replies);
+    talloc_free(srv_replies);
+
+    state->done++;
+    if (state->done <= 2) {
+        assert_int_equal(ttl, 500);
+    } else {
+        /* the cached answer is only valid for the cache timeout */
+        assert_true(ttl > 0);
+        assert_true(ttl <= 300);
+    }
+}
+
+static void test_resolv_fake_srv_cached_done(struct tevent_req *req)
+{
+    struct resolv_fake_cache_state *state =
+        tevent_req_callback_data(req, struct resolv_fake_cache_state);
+    struct resolv_cache_stats stats;
+    struct tevent_req *subreq;
+
+    test_resolv_fake_srv_cached_check(req);
+
+    if (state->done == 2) {
+        /* both concurrent lookups were answered by the same query, the
+         * next one must be answered from the cache without a query */
+        subreq = resolv_getsrv_send(state, state->test_ctx->ctx->ev,
+                                    state->test_ctx->resolv, TEST_SRV_QUERY);
+        assert_non_null(subreq);
+        tevent_req_set_callback(subreq, test_resolv_fake_srv_cached_done,
+                                state);
+        return;
+    }
+
+    if (state->done == 3) {
+        resolv_cache_get_stats(state->test_ctx->resolv, &stats);
+        assert_int_equal(stats.misses, 1);
+        assert_int_equal(stats.coalesced, 1);
+        assert_int_equal(stats.hits, 1);
+        assert_int_equal(stats.negative_hits, 0);
+
+        test_ev_done(state->test_ctx->ctx, EOK);
+    }
+}
+
+void test_resolv_fake_srv_cached(void **state)
+{
+    int ret;
+    int i;
+    struct tevent_req *req;
+    struct resolv_fake_cache_state *cache_state;
+    struct resolv_fake_ctx *test_ctx =
+        talloc_get_type(*state, struct resolv_fake_ctx);
+
+    cache_state = talloc_zero(test_ctx, struct resolv_fake_cache_state);
+    assert_non_null(cache_state);
+    cache_state->test_ctx = test_ctx;
+
+    resolv_cache_set_max_ttl(test_ctx->resolv, 300);
+
+    /* only one query is expected */
+    mock_srv_answer(test_ctx);
+
+    for (i = 0; i < 2; i++) {
+        req = resolv_getsrv_send(cache_state, test_ctx->ctx->ev,
+                                 test_ctx->resolv, TEST_SRV_QUERY);
+        assert_non_null(req);
+        tevent_req_set_callback(req, test_resolv_fake_srv_cached_done,
+                                cache_state);
+    }
+
+    ret = test_ev_loop(test_ctx->ctx);
+    assert_int_equal(ret, ERR_OK);
+    assert_int_equal(cache_state->done, 3);
+
+    talloc_free(cache_state);
+}
+
 int main(int argc, const char *argv[])
 {
     int rv;
@@ -348,6 +453,9 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_resolv_fake_srv,
                                         test_resolv_fake_setup,
                                         test_resolv_fake_teardown),
+        cmocka_unit_test_setup_teardown(test_resolv_fake_srv_cached,
+                                        test_resolv_fake_setup,
+                                        test_resolv_fake_teardown),
     };
 
     /* Set debug level to invalid value so we can deside if -d 0 was used. */
@@ -607,6 +607,66 @@ void test_user_by_name_multiple_domains_parse(void **state)
     talloc_free(fqn);
 }
 
+void test_user_by_name_parallel_domains_found(void **state)
+{
+    struct cache_req_test_ctx *test_ctx = NULL;
+    struct sss_domain_info *domain = NULL;
+    struct sss_domain_info *last_domain = NULL;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct cache_req_test_ctx);
+    test_ctx->rctx->parallel_domain_lookups = true;
+
+    /* Add the test user to the second domain and a user with the same name
+     * but a different uid to the last domain. Both are answered from the
+     * cache before the first domain gets its reply from data provider, but
+     * the second domain must win as it would in a sequential search. */
+    domain = find_domain_by_name(test_ctx->tctx->dom,
+                                 "responder_cache_req_test_b", true);
+    assert_non_null(domain);
+
+    prepare_user(domain, &users[0], 1000, time(NULL));
+
+    last_domain = find_domain_by_name(test_ctx->tctx->dom,
+                                      "responder_cache_req_test_d", true);
+    assert_non_null(last_domain);
+
+    ret = sysdb_store_user(last_domain, users[0].name, "pwd", 2000, 1000,
+                           NULL, NULL, NULL, "cn=test-user,dc=test", NULL,
+                           NULL, 1000, time(NULL));
+    assert_int_equal(ret, EOK);
+
+    /* Mock values. */
+    will_return_always(__wrap_sss_dp_get_account_send, test_ctx);
+    will_return_always(sss_dp_get_account_recv, 0);
+    mock_parse_inp(users[0].name, NULL, ERR_OK);
+
+    /* Test. */
+    run_user_by_name(test_ctx, NULL, 0, ERR_OK);
+    assert_true(test_ctx->dp_called);
+    check_user(test_ctx, &users[0], domain);
+
+    assert_non_null(test_ctx->name);
+    assert_string_equal(users[0].name, test_ctx->name);
+}
+
+void test_user_by_name_parallel_domains_notfound(void **state)
+{
+    struct cache_req_test_ctx *test_ctx = NULL;
+
+    test_ctx = talloc_get_type_abort(*state, struct cache_req_test_ctx);
+    test_ctx->rctx->parallel_domain_lookups = true;
+
+    /* Mock values. */
+    will_return_always(__wrap_sss_dp_get_account_send, test_ctx);
+    will_return_always(sss_dp_get_account_recv, 0);
+    mock_parse_inp(users[0].name, NULL, ERR_OK);
+
+    /* Test. */
+    run_user_by_name(test_ctx, NULL, 0, ENOENT);
+    assert_true(test_ctx->dp_called);
+}
+
 void test_user_by_name_cache_valid(void **state)
 {
     struct cache_req_test_ctx *test_ctx = NULL;
@@ -905,6 +965,47 @@ void test_user_by_id_multiple_domains_notfound(void **state)
     assert_true(test_ctx->dp_called);
 }
 
+void test_user_by_id_parallel_domains_found(void **state)
+{
+    struct cache_req_test_ctx *test_ctx = NULL;
+    struct sss_domain_info *domain = NULL;
+
+    test_ctx = talloc_get_type_abort(*state, struct cache_req_test_ctx);
+    test_ctx->rctx->parallel_domain_lookups = true;
+
+    /* Setup user. */
+    domain = find_domain_by_name(test_ctx->tctx->dom,
+                                 "responder_cache_req_test_d", true);
+    assert_non_null(domain);
+
+    prepare_user(domain, &users[0], 1000, time(NULL));
+
+    /* Mock values. */
+    will_return_always(__wrap_sss_dp_get_account_send, test_ctx);
+    will_return_always(sss_dp_get_account_recv, 0);
+
+    /* Test. */
+    run_user_by_id(test_ctx, NULL, 0, ERR_OK);
+    assert_true(test_ctx->dp_called);
+    check_user(test_ctx, &users[0], domain);
+}
+
+void test_user_by_id_parallel_domains_notfound(void **state)
+{
+    struct cache_req_test_ctx *test_ctx = NULL;
+
+    test_ctx = talloc_get_type_abort(*state, struct cache_req_test_ctx);
+    test_ctx->rctx->parallel_domain_lookups = true;
+
+    /* Mock values. */
+    will_return_always(__wrap_sss_dp_get_account_send, test_ctx);
+    will_return_always(sss_dp_get_account_recv, 0);
+
+    /* Test. */
+    run_user_by_id(test_ctx, NULL, 0, ENOENT);
+    assert_true(test_ctx->dp_called);
+}
+
 void test_user_by_id_cache_valid(void **state)
 {
     struct cache_req_test_ctx *test_ctx = NULL;
@@ -2074,6 +2175,8 @@ int main(int argc, const char *argv[])
         new_multi_domain_test(user_by_name_multiple_domains_found),
         new_multi_domain_test(user_by_name_multiple_domains_notfound),
         new_multi_domain_test(user_by_name_multiple_domains_parse),
+        new_multi_domain_test(user_by_name_parallel_domains_found),
+        new_multi_domain_test(user_by_name_parallel_domains_notfound),
 
         new_single_domain_test(user_by_upn_cache_valid),
         new_single_domain_test(user_by_upn_cache_expired),
@@ -2092,6 +2195,8 @@ int main(int argc, const char *argv[])
         new_single_domain_test(user_by_id_missing_notfound),
         new_multi_domain_test(user_by_id_multiple_domains_found),
         new_multi_domain_test(user_by_id_multiple_domains_notfound),
+        new_multi_domain_test(user_by_id_parallel_domains_found),
+        new_multi_domain_test(user_by_id_parallel_domains_notfound),
 
         new_single_domain_test(group_by_name_cache_valid),
         new_single_domain_test(group_by_name_cache_expired),
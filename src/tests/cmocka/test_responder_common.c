@@ -24,9 +24,11 @@
 #include <tevent.h>
 #include <errno.h>
 #include <popt.h>
+#include <sys/socket.h>
 
 #include "tests/cmocka/common_mock.h"
 #include "tests/cmocka/common_mock_resp.h"
+#include "responder/common/responder_packet.h"
 
 #define TESTS_PATH "tp_" BASE_FILE_STEM
 #define TEST_CONF_DB "test_responder_conf.ldb"
@@ -300,6 +302,62 @@ void test_schedule_get_domains_task(void **state)
     talloc_free(dummy_ncache_ptr);
 }
 
+void test_packet_recv_one(void **state)
+{
+    uint32_t reqs[9] = {
+        /* SSS_NSS_GETPWNAM with the tag 7 and a 4 bytes long body */
+        SSS_NSS_HEADER_SIZE + 4, SSS_NSS_GETPWNAM, 0, 7, 0x616263,
+        /* SSS_NSS_GETGRGID with the tag 3 and no body */
+        SSS_NSS_HEADER_SIZE, SSS_NSS_GETGRGID, 0, 3
+    };
+    TALLOC_CTX *tmp_ctx;
+    struct sss_packet *packet;
+    uint8_t *body;
+    size_t blen;
+    int sv[2];
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    ret = socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    assert_int_equal(ret, 0);
+
+    /* both requests are in the socket before the first one is read */
+    ret = send(sv[0], reqs, sizeof(reqs), 0);
+    assert_int_equal(ret, sizeof(reqs));
+
+    ret = sss_packet_new(tmp_ctx, SSS_PACKET_MAX_RECV_SIZE, 0,
+                         &packet);
+    assert_int_equal(ret, EOK);
+    do {
+        ret = sss_packet_recv_one(packet, sv[1]);
+    } while (ret == EAGAIN);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(sss_packet_get_cmd(packet), SSS_NSS_GETPWNAM);
+    assert_int_equal(sss_packet_get_tag(packet), 7);
+    sss_packet_get_body(packet, &body, &blen);
+    assert_int_equal(blen, 4);
+    talloc_free(packet);
+
+    ret = sss_packet_new(tmp_ctx, SSS_PACKET_MAX_RECV_SIZE, 0,
+                         &packet);
+    assert_int_equal(ret, EOK);
+    do {
+        ret = sss_packet_recv_one(packet, sv[1]);
+    } while (ret == EAGAIN);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(sss_packet_get_cmd(packet), SSS_NSS_GETGRGID);
+    assert_int_equal(sss_packet_get_tag(packet), 3);
+    sss_packet_get_body(packet, &body, &blen);
+    assert_int_equal(blen, 0);
+    talloc_free(packet);
+
+    close(sv[0]);
+    close(sv[1]);
+    talloc_free(tmp_ctx);
+}
+
 int main(int argc, const char *argv[])
 {
     int rv;
@@ -330,6 +388,7 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_schedule_get_domains_task,
                                         parse_inp_test_setup,
                                         parse_inp_test_teardown),
+        cmocka_unit_test(test_packet_recv_one),
     };
 
     /* Set debug level to invalid value so we can deside if -d 0 was used. */
@@ -0,0 +1,565 @@
+/*
+    Copyright (C) 2016 Red Hat
+
+    SSSD tests: LDAP enumeration
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <popt.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "providers/ldap/ldap_opts.h"
+
+/* The enumeration request is tested with its static helpers, the
+ * connections and the searches are mocked with -Wl,-wrap */
+#include "providers/ldap/sdap_async_enum.c"
+
+#define TEST_SEARCH_DELAY_USEC 10000
+
+#define TEST_BASE1 "ou=users1,dc=example,dc=com"
+#define TEST_BASE2 "ou=users2,dc=example,dc=com"
+#define TEST_BASE3 "ou=users3,dc=example,dc=com"
+
+struct test_ctx {
+    struct tevent_context *ev;
+    struct sdap_id_ctx *id_ctx;
+    struct sdap_domain *sdom;
+    struct sdap_id_conn_ctx *conn;
+
+    bool done;
+    errno_t ret;
+};
+
+/* The result of the user search of one search base */
+struct test_shard {
+    const char *basedn;
+    const char *usn_value;
+    errno_t ret;
+};
+
+static struct test_enum {
+    struct tevent_context *ev;
+    struct test_shard *shards;
+    int dp_error;
+
+    int in_flight[SDAP_ENUM_PHASE_SENTINEL];
+    int completed[SDAP_ENUM_PHASE_SENTINEL];
+    int max_in_flight[SDAP_ENUM_PHASE_SENTINEL];
+    int max_total_in_flight;
+
+    /* user searches still running when the groups were searched */
+    int users_in_flight_at_groups;
+
+    int num_enumerated;
+} test_enum;
+
+struct test_search_state {
+    enum sdap_dom_enum_phase_type type;
+    char *usn_value;
+    errno_t ret;
+};
+
+static void test_search_done(struct tevent_context *ev,
+                             struct tevent_timer *te,
+                             struct timeval current_time,
+                             void *pvt)
+{
+    struct tevent_req *req = (struct tevent_req *) pvt;
+    struct test_search_state *state = tevent_req_data(req,
+                                                struct test_search_state);
+
+    test_enum.in_flight[state->type]--;
+    test_enum.completed[state->type]++;
+
+    if (state->ret != EOK) {
+        tevent_req_error(req, state->ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+static struct tevent_req *test_search_send(TALLOC_CTX *mem_ctx,
+                                           struct tevent_context *ev,
+                                           enum sdap_dom_enum_phase_type type,
+                                           const char *usn_value,
+                                           errno_t ret)
+{
+    struct test_search_state *state;
+    struct tevent_req *req;
+    struct tevent_timer *te;
+    int total = 0;
+    int i;
+
+    req = tevent_req_create(mem_ctx, &state, struct test_search_state);
+    assert_non_null(req);
+
+    state->type = type;
+    state->ret = ret;
+    if (usn_value != NULL) {
+        state->usn_value = talloc_strdup(state, usn_value);
+        assert_non_null(state->usn_value);
+    }
+
+    te = tevent_add_timer(ev, state,
+                          tevent_timeval_current_ofs(0,
+                                                     TEST_SEARCH_DELAY_USEC),
+                          test_search_done, req);
+    assert_non_null(te);
+
+    test_enum.in_flight[type]++;
+    if (test_enum.in_flight[type] > test_enum.max_in_flight[type]) {
+        test_enum.max_in_flight[type] = test_enum.in_flight[type];
+    }
+    for (i = 0; i < SDAP_ENUM_PHASE_SENTINEL; i++) {
+        total += test_enum.in_flight[i];
+    }
+    if (total > test_enum.max_total_in_flight) {
+        test_enum.max_total_in_flight = total;
+    }
+
+    return req;
+}
+
+static int test_search_recv(struct tevent_req *req,
+                            TALLOC_CTX *mem_ctx,
+                            char **_usn_value)
+{
+    struct test_search_state *state = tevent_req_data(req,
+                                                struct test_search_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    if (_usn_value != NULL) {
+        *_usn_value = talloc_steal(mem_ctx, state->usn_value);
+    }
+    return EOK;
+}
+
+struct tevent_req *
+__wrap_sdap_get_users_send(TALLOC_CTX *memctx,
+                           struct tevent_context *ev,
+                           struct sss_domain_info *dom,
+                           struct sysdb_ctx *sysdb,
+                           struct sdap_options *opts,
+                           struct sdap_search_base **search_bases,
+                           struct sdap_handle *sh,
+                           const char **attrs,
+                           const char *filter,
+                           int timeout,
+                           enum sdap_entry_lookup_type lookup_type)
+{
+    struct test_shard *shard;
+
+    /* every shard searches a single base */
+    assert_non_null(search_bases);
+    assert_non_null(search_bases[0]);
+    assert_null(search_bases[1]);
+
+    for (shard = test_enum.shards; shard->basedn != NULL; shard++) {
+        if (strcmp(shard->basedn, search_bases[0]->basedn) == 0) {
+            break;
+        }
+    }
+    assert_non_null(shard->basedn);
+
+    return test_search_send(memctx, ev, SDAP_ENUM_PHASE_USERS,
+                            shard->usn_value, shard->ret);
+}
+
+int __wrap_sdap_get_users_recv(struct tevent_req *req,
+                               TALLOC_CTX *mem_ctx, char **timestamp)
+{
+    return test_search_recv(req, mem_ctx, timestamp);
+}
+
+struct tevent_req *
+__wrap_sdap_get_groups_send(TALLOC_CTX *memctx,
+                            struct tevent_context *ev,
+                            struct sdap_domain *sdom,
+                            struct sdap_options *opts,
+                            struct sdap_handle *sh,
+                            const char **attrs,
+                            const char *filter,
+                            int timeout,
+                            enum sdap_entry_lookup_type lookup_type,
+                            bool no_members)
+{
+    test_enum.users_in_flight_at_groups =
+                                test_enum.in_flight[SDAP_ENUM_PHASE_USERS];
+
+    return test_search_send(memctx, ev, SDAP_ENUM_PHASE_GROUPS, NULL, EOK);
+}
+
+int __wrap_sdap_get_groups_recv(struct tevent_req *req,
+                                TALLOC_CTX *mem_ctx, char **timestamp)
+{
+    return test_search_recv(req, mem_ctx, timestamp);
+}
+
+struct tevent_req *__wrap_enum_services_send(TALLOC_CTX *memctx,
+                                             struct tevent_context *ev,
+                                             struct sdap_id_ctx *id_ctx,
+                                             struct sdap_id_op *op,
+                                             bool purge)
+{
+    return test_search_send(memctx, ev, SDAP_ENUM_PHASE_SERVICES, NULL, EOK);
+}
+
+errno_t __wrap_enum_services_recv(struct tevent_req *req)
+{
+    return test_search_recv(req, NULL, NULL);
+}
+
+/* The operations only carry the mocked connection result */
+struct sdap_id_op *__wrap_sdap_id_op_create(TALLOC_CTX *memctx,
+                                            struct sdap_id_conn_cache *cache)
+{
+    return (struct sdap_id_op *) talloc_new(memctx);
+}
+
+struct tevent_req *__wrap_sdap_id_op_connect_send(struct sdap_id_op *op,
+                                                  TALLOC_CTX *memctx,
+                                                  int *ret_out)
+{
+    struct tevent_req *req;
+    int *state;
+
+    req = tevent_req_create(memctx, &state, int);
+    assert_non_null(req);
+
+    if (test_enum.dp_error == DP_ERR_OK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, EIO);
+    }
+    tevent_req_post(req, test_enum.ev);
+
+    *ret_out = EOK;
+    return req;
+}
+
+int __wrap_sdap_id_op_connect_recv(struct tevent_req *req, int *dp_error)
+{
+    *dp_error = test_enum.dp_error;
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
+int __wrap_sdap_id_op_done(struct sdap_id_op *op, int ret, int *dp_error)
+{
+    /* failed searches are not retried */
+    *dp_error = ret == EOK ? DP_ERR_OK : DP_ERR_FATAL;
+    return ret;
+}
+
+struct sdap_handle *__wrap_sdap_id_op_handle(struct sdap_id_op *op)
+{
+    return NULL;
+}
+
+bool
+__wrap_sdap_idmap_domain_has_algorithmic_mapping(struct sdap_idmap_ctx *ctx,
+                                                 const char *name,
+                                                 const char *dom_sid)
+{
+    return false;
+}
+
+errno_t __wrap_sysdb_set_enumerated(struct sss_domain_info *domain,
+                                    bool enumerated)
+{
+    test_enum.num_enumerated++;
+    return EOK;
+}
+
+static void test_enum_done(struct tevent_req *req)
+{
+    struct test_ctx *test_ctx = tevent_req_callback_data(req,
+                                                         struct test_ctx);
+
+    test_ctx->ret = sdap_dom_enum_ex_recv(req);
+    test_ctx->done = true;
+    talloc_free(req);
+}
+
+static void test_enum_run(struct test_ctx *test_ctx,
+                          struct test_shard *shards)
+{
+    struct sdap_search_base **bases;
+    struct tevent_req *req;
+    size_t num_shards;
+    size_t i;
+
+    num_shards = 0;
+    while (shards[num_shards].basedn != NULL) {
+        num_shards++;
+    }
+
+    bases = talloc_zero_array(test_ctx->sdom, struct sdap_search_base *,
+                              num_shards + 1);
+    assert_non_null(bases);
+    for (i = 0; i < num_shards; i++) {
+        bases[i] = talloc_zero(bases, struct sdap_search_base);
+        assert_non_null(bases[i]);
+        bases[i]->basedn = shards[i].basedn;
+        bases[i]->scope = LDAP_SCOPE_SUBTREE;
+    }
+    test_ctx->sdom->user_search_bases = bases;
+    test_enum.shards = shards;
+
+    req = sdap_dom_enum_ex_send(test_ctx, test_ctx->ev, test_ctx->id_ctx,
+                                test_ctx->sdom, test_ctx->conn,
+                                test_ctx->conn, test_ctx->conn);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_enum_done, test_ctx);
+
+    while (!test_ctx->done) {
+        assert_int_equal(tevent_loop_once(test_ctx->ev), 0);
+    }
+}
+
+static int test_setup(void **state)
+{
+    struct test_ctx *test_ctx;
+    struct sdap_options *opts;
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct test_ctx);
+    assert_non_null(test_ctx);
+
+    test_ctx->ev = tevent_context_init(test_ctx);
+    assert_non_null(test_ctx->ev);
+
+    opts = talloc_zero(test_ctx, struct sdap_options);
+    assert_non_null(opts);
+    ret = dp_copy_defaults(opts, default_basic_opts, SDAP_OPTS_BASIC,
+                           &opts->basic);
+    assert_int_equal(ret, EOK);
+    opts->schema_type = SDAP_SCHEMA_RFC2307;
+    opts->user_map = rfc2307_user_map;
+    opts->user_map_cnt = SDAP_OPTS_USER;
+    opts->group_map = rfc2307_group_map;
+
+    test_ctx->id_ctx = talloc_zero(test_ctx, struct sdap_id_ctx);
+    assert_non_null(test_ctx->id_ctx);
+    test_ctx->id_ctx->opts = opts;
+    test_ctx->id_ctx->srv_opts = talloc_zero(test_ctx->id_ctx,
+                                             struct sdap_server_opts);
+    assert_non_null(test_ctx->id_ctx->srv_opts);
+
+    test_ctx->sdom = talloc_zero(test_ctx, struct sdap_domain);
+    assert_non_null(test_ctx->sdom);
+    test_ctx->sdom->dom = talloc_zero(test_ctx->sdom, struct sss_domain_info);
+    assert_non_null(test_ctx->sdom->dom);
+    test_ctx->sdom->dom->name = talloc_strdup(test_ctx->sdom->dom, "LDAP");
+    assert_non_null(test_ctx->sdom->dom->name);
+    /* no cleanup of the cache after the enumeration */
+    test_ctx->sdom->last_purge = tevent_timeval_current();
+
+    test_ctx->conn = talloc_zero(test_ctx, struct sdap_id_conn_ctx);
+    assert_non_null(test_ctx->conn);
+
+    memset(&test_enum, 0, sizeof(test_enum));
+    test_enum.ev = test_ctx->ev;
+    test_enum.dp_error = DP_ERR_OK;
+
+    check_leaks_push(test_ctx);
+    *state = test_ctx;
+    return 0;
+}
+
+static int test_teardown(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state, struct test_ctx);
+    struct sdap_server_opts *srv_opts = test_ctx->id_ctx->srv_opts;
+
+    /* the recorded USNs are owned by the id context */
+    talloc_zfree(srv_opts->max_user_value);
+    talloc_zfree(srv_opts->max_group_value);
+    talloc_zfree(test_ctx->sdom->user_search_bases);
+
+    assert_true(check_leaks_pop(test_ctx));
+    talloc_free(test_ctx);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+/* Every user search base is searched by its own shard, concurrently with
+ * each other and with the groups and services */
+void test_enum_sharded(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state, struct test_ctx);
+    struct sdap_server_opts *srv_opts = test_ctx->id_ctx->srv_opts;
+    struct test_shard shards[] = {
+        { TEST_BASE1, "9", EOK },
+        { TEST_BASE2, "100", EOK },
+        { TEST_BASE3, "30", EOK },
+        { NULL, NULL, EOK },
+    };
+
+    test_enum_run(test_ctx, shards);
+
+    assert_int_equal(test_ctx->ret, EOK);
+    assert_int_equal(test_enum.completed[SDAP_ENUM_PHASE_USERS], 3);
+    assert_int_equal(test_enum.completed[SDAP_ENUM_PHASE_GROUPS], 1);
+    assert_int_equal(test_enum.completed[SDAP_ENUM_PHASE_SERVICES], 1);
+    assert_int_equal(test_enum.max_in_flight[SDAP_ENUM_PHASE_USERS], 3);
+    assert_int_equal(test_enum.max_total_in_flight, 5);
+
+    /* the highest USN is compared as a number */
+    assert_string_equal(srv_opts->max_user_value, "100");
+    assert_int_equal(srv_opts->last_usn, 100);
+    assert_int_equal(test_enum.num_enumerated, 1);
+}
+
+/* A single user search base is searched by a single shard */
+void test_enum_single_base(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state, struct test_ctx);
+    struct sdap_server_opts *srv_opts = test_ctx->id_ctx->srv_opts;
+    struct test_shard shards[] = {
+        { TEST_BASE1, "42", EOK },
+        { NULL, NULL, EOK },
+    };
+
+    test_enum_run(test_ctx, shards);
+
+    assert_int_equal(test_ctx->ret, EOK);
+    assert_int_equal(test_enum.completed[SDAP_ENUM_PHASE_USERS], 1);
+    assert_string_equal(srv_opts->max_user_value, "42");
+    assert_int_equal(test_enum.num_enumerated, 1);
+}
+
+/* The USN of the shards that succeeded is not stored when another shard
+ * failed, the next enumeration must not skip the changes of that one */
+void test_enum_failed_shard(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state, struct test_ctx);
+    struct sdap_server_opts *srv_opts = test_ctx->id_ctx->srv_opts;
+    struct test_shard shards[] = {
+        { TEST_BASE1, "100", EOK },
+        { TEST_BASE2, NULL, EIO },
+        { TEST_BASE3, "200", EOK },
+        { NULL, NULL, EOK },
+    };
+
+    srv_opts->max_user_value = talloc_strdup(test_ctx->id_ctx, "5");
+    assert_non_null(srv_opts->max_user_value);
+    srv_opts->last_usn = 5;
+
+    test_enum_run(test_ctx, shards);
+
+    assert_int_equal(test_ctx->ret, EIO);
+    assert_string_equal(srv_opts->max_user_value, "5");
+    assert_int_equal(srv_opts->last_usn, 5);
+    assert_int_equal(test_enum.num_enumerated, 0);
+}
+
+/* With rfc2307bis the group members are resolved against the cached users,
+ * so the groups are only searched once all user shards are saved */
+void test_enum_groups_wait_for_users(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state, struct test_ctx);
+    struct sdap_server_opts *srv_opts = test_ctx->id_ctx->srv_opts;
+    struct test_shard shards[] = {
+        { TEST_BASE1, "10", EOK },
+        { TEST_BASE2, "20", EOK },
+        { NULL, NULL, EOK },
+    };
+
+    test_ctx->id_ctx->opts->schema_type = SDAP_SCHEMA_RFC2307BIS;
+    test_ctx->id_ctx->opts->user_map = rfc2307bis_user_map;
+    test_ctx->id_ctx->opts->group_map = rfc2307bis_group_map;
+
+    test_enum_run(test_ctx, shards);
+
+    assert_int_equal(test_ctx->ret, EOK);
+    assert_int_equal(test_enum.completed[SDAP_ENUM_PHASE_USERS], 2);
+    assert_int_equal(test_enum.completed[SDAP_ENUM_PHASE_GROUPS], 1);
+    assert_int_equal(test_enum.users_in_flight_at_groups, 0);
+    assert_int_equal(test_enum.max_in_flight[SDAP_ENUM_PHASE_USERS], 2);
+    assert_string_equal(srv_opts->max_user_value, "20");
+}
+
+/* An offline back end ends the enumeration without storing anything */
+void test_enum_offline(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state, struct test_ctx);
+    struct sdap_server_opts *srv_opts = test_ctx->id_ctx->srv_opts;
+    struct test_shard shards[] = {
+        { TEST_BASE1, "10", EOK },
+        { TEST_BASE2, "20", EOK },
+        { NULL, NULL, EOK },
+    };
+
+    test_enum.dp_error = DP_ERR_OFFLINE;
+
+    test_enum_run(test_ctx, shards);
+
+    assert_int_equal(test_ctx->ret, EOK);
+    assert_int_equal(test_enum.completed[SDAP_ENUM_PHASE_USERS], 0);
+    assert_null(srv_opts->max_user_value);
+    assert_int_equal(test_enum.num_enumerated, 0);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_enum_sharded,
+                                        test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_enum_single_base,
+                                        test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_enum_failed_shard,
+                                        test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_enum_groups_wait_for_users,
+                                        test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_enum_offline,
+                                        test_setup, test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,587 @@
+/*
+    Copyright (C) 2016 Red Hat
+
+    SSSD tests: LDAP connection pool of sdap_id_op
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <popt.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "providers/ldap/ldap_opts.h"
+
+/* The connection cache is tested with its static helpers, the connection
+ * to the server is mocked with -Wl,-wrap,sdap_cli_connect_send */
+#include "providers/ldap/sdap_id_op.c"
+
+#define TEST_WAIT_TIMEOUT 1
+
+struct test_ctx {
+    struct tevent_context *ev;
+    struct be_ctx *be;
+    struct sdap_id_conn_ctx *id_conn;
+    struct sdap_id_conn_cache *conn_cache;
+};
+
+/* the connections opened by the mocked sdap_cli_connect_send() */
+static int num_connects;
+
+struct test_connect_state {
+    struct sdap_handle *sh;
+};
+
+struct tevent_req *__wrap_sdap_cli_connect_send(TALLOC_CTX *memctx,
+                                                struct tevent_context *ev,
+                                                struct sdap_options *opts,
+                                                struct be_ctx *be,
+                                                struct sdap_service *service,
+                                                bool skip_rootdse,
+                                                enum connect_tls force_tls,
+                                                bool skip_auth)
+{
+    struct test_connect_state *state;
+    struct tevent_req *req;
+
+    req = tevent_req_create(memctx, &state, struct test_connect_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    state->sh = talloc_zero(state, struct sdap_handle);
+    if (state->sh == NULL) {
+        talloc_free(req);
+        return NULL;
+    }
+    state->sh->connected = true;
+
+    num_connects++;
+
+    tevent_req_done(req);
+    tevent_req_post(req, ev);
+    return req;
+}
+
+int __wrap_sdap_cli_connect_recv(struct tevent_req *req,
+                                 TALLOC_CTX *memctx,
+                                 bool *can_retry,
+                                 struct sdap_handle **gsh,
+                                 struct sdap_server_opts **srv_opts)
+{
+    struct test_connect_state *state = tevent_req_data(req,
+                                                struct test_connect_state);
+
+    *can_retry = false;
+    *srv_opts = NULL;
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *gsh = talloc_steal(memctx, state->sh);
+    return EOK;
+}
+
+/* An operation created in mem_ctx together with the result of its
+ * connection request */
+struct test_op {
+    struct sdap_id_op *op;
+    bool done;
+    int dp_error;
+    errno_t ret;
+};
+
+static void test_op_connect_done(struct tevent_req *req)
+{
+    struct test_op *top = tevent_req_callback_data(req, struct test_op);
+
+    top->ret = sdap_id_op_connect_recv(req, &top->dp_error);
+    top->done = true;
+    talloc_free(req);
+}
+
+static struct test_op *test_op_connect(TALLOC_CTX *mem_ctx,
+                                       struct test_ctx *test_ctx)
+{
+    struct tevent_req *req;
+    struct test_op *top;
+    errno_t ret;
+
+    top = talloc_zero(mem_ctx, struct test_op);
+    assert_non_null(top);
+
+    top->op = sdap_id_op_create(mem_ctx, test_ctx->conn_cache);
+    assert_non_null(top->op);
+
+    req = sdap_id_op_connect_send(top->op, mem_ctx, &ret);
+    assert_int_equal(ret, EOK);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_op_connect_done, top);
+
+    return top;
+}
+
+static void test_op_wait(struct test_ctx *test_ctx, struct test_op *top)
+{
+    while (!top->done) {
+        assert_int_equal(tevent_loop_once(test_ctx->ev), 0);
+    }
+
+    assert_int_equal(top->ret, EOK);
+    assert_int_equal(top->dp_error, DP_ERR_OK);
+}
+
+static void test_timeout_done(struct tevent_context *ev,
+                              struct tevent_timer *te,
+                              struct timeval current_time,
+                              void *pvt)
+{
+    bool *done = (bool *) pvt;
+
+    *done = true;
+}
+
+/* Run the pending events without waiting for timers in the future */
+static void test_run_pending(struct test_ctx *test_ctx)
+{
+    struct tevent_timer *te;
+    bool done = false;
+
+    te = tevent_add_timer(test_ctx->ev, test_ctx,
+                          tevent_timeval_current_ofs(0, 100000),
+                          test_timeout_done, &done);
+    assert_non_null(te);
+
+    while (!done) {
+        assert_int_equal(tevent_loop_once(test_ctx->ev), 0);
+    }
+}
+
+static int test_setup_pool(void **state, int pool_size, int max_ops)
+{
+    struct test_ctx *test_ctx;
+    struct sdap_id_ctx *id_ctx;
+    struct sdap_options *opts;
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct test_ctx);
+    assert_non_null(test_ctx);
+
+    test_ctx->ev = tevent_context_init(test_ctx);
+    assert_non_null(test_ctx->ev);
+
+    test_ctx->be = talloc_zero(test_ctx, struct be_ctx);
+    assert_non_null(test_ctx->be);
+    test_ctx->be->ev = test_ctx->ev;
+
+    opts = talloc_zero(test_ctx, struct sdap_options);
+    assert_non_null(opts);
+    ret = dp_copy_defaults(opts, default_basic_opts, SDAP_OPTS_BASIC,
+                           &opts->basic);
+    assert_int_equal(ret, EOK);
+
+    ret = dp_opt_set_int(opts->basic, SDAP_CONNECTION_POOL_SIZE, pool_size);
+    assert_int_equal(ret, EOK);
+    ret = dp_opt_set_int(opts->basic, SDAP_CONNECTION_POOL_MAX_OPS, max_ops);
+    assert_int_equal(ret, EOK);
+    ret = dp_opt_set_int(opts->basic, SDAP_SEARCH_TIMEOUT, TEST_WAIT_TIMEOUT);
+    assert_int_equal(ret, EOK);
+
+    id_ctx = talloc_zero(test_ctx, struct sdap_id_ctx);
+    assert_non_null(id_ctx);
+    id_ctx->be = test_ctx->be;
+    id_ctx->opts = opts;
+
+    test_ctx->id_conn = talloc_zero(test_ctx, struct sdap_id_conn_ctx);
+    assert_non_null(test_ctx->id_conn);
+    test_ctx->id_conn->id_ctx = id_ctx;
+    test_ctx->id_conn->service = talloc_zero(test_ctx, struct sdap_service);
+    assert_non_null(test_ctx->id_conn->service);
+    test_ctx->id_conn->service->name = talloc_strdup(test_ctx, "LDAP");
+    assert_non_null(test_ctx->id_conn->service->name);
+
+    ret = sdap_id_conn_cache_create(test_ctx, test_ctx->id_conn,
+                                    &test_ctx->conn_cache);
+    assert_int_equal(ret, EOK);
+    test_ctx->id_conn->conn_cache = test_ctx->conn_cache;
+
+    num_connects = 0;
+
+    check_leaks_push(test_ctx);
+    *state = test_ctx;
+    return 0;
+}
+
+/* a single connection running a single operation */
+static int test_setup(void **state)
+{
+    return test_setup_pool(state, 1, 1);
+}
+
+/* two connections running a single operation each */
+static int test_setup_pool_limit(void **state)
+{
+    return test_setup_pool(state, 2, 1);
+}
+
+/* two connections without a limit of operations */
+static int test_setup_pool_no_limit(void **state)
+{
+    return test_setup_pool(state, 2, 0);
+}
+
+static int test_teardown(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state, struct test_ctx);
+
+    /* release the cached connections */
+    sdap_id_conn_cache_be_offline_cb(test_ctx->conn_cache);
+
+    assert_true(check_leaks_pop(test_ctx));
+    talloc_free(test_ctx);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+/* A busy connection makes the pool open another one */
+void test_pool_opens_connection(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state, struct test_ctx);
+    TALLOC_CTX *first_state;
+    TALLOC_CTX *second_state;
+    struct test_op *first;
+    struct test_op *second;
+
+    first_state = talloc_new(test_ctx);
+    assert_non_null(first_state);
+    second_state = talloc_new(test_ctx);
+    assert_non_null(second_state);
+
+    first = test_op_connect(first_state, test_ctx);
+    test_op_wait(test_ctx, first);
+    assert_int_equal(num_connects, 1);
+
+    second = test_op_connect(second_state, test_ctx);
+    test_op_wait(test_ctx, second);
+    assert_int_equal(num_connects, 2);
+    assert_false(second->op->waiting);
+    assert_ptr_not_equal(sdap_id_op_handle(second->op),
+                         sdap_id_op_handle(first->op));
+    assert_true(sdap_id_conn_cache_is_pooled(first->op->conn_data));
+    assert_true(sdap_id_conn_cache_is_pooled(second->op->conn_data));
+
+    talloc_free(second_state);
+    talloc_free(first_state);
+}
+
+/* New operations go to the connection running the fewest operations */
+void test_pool_least_loaded(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state, struct test_ctx);
+    TALLOC_CTX *ops_state;
+    struct test_op *top[4];
+    int dp_error;
+    int i;
+
+    ops_state = talloc_new(test_ctx);
+    assert_non_null(ops_state);
+
+    for (i = 0; i < 3; i++) {
+        top[i] = test_op_connect(ops_state, test_ctx);
+        test_op_wait(test_ctx, top[i]);
+    }
+
+    /* the third operation shares the first connection of the full pool */
+    assert_int_equal(num_connects, 2);
+    assert_ptr_equal(top[2]->op->conn_data, top[0]->op->conn_data);
+    assert_int_equal(top[0]->op->conn_data->num_ops, 2);
+    assert_int_equal(top[1]->op->conn_data->num_ops, 1);
+
+    /* the second connection is the least loaded one once it is idle */
+    sdap_id_op_done(top[1]->op, EOK, &dp_error);
+    assert_null(top[1]->op->conn_data);
+
+    top[3] = test_op_connect(ops_state, test_ctx);
+    test_op_wait(test_ctx, top[3]);
+    assert_int_equal(num_connects, 2);
+    assert_ptr_not_equal(top[3]->op->conn_data, top[0]->op->conn_data);
+    assert_int_equal(top[3]->op->conn_data->num_ops, 1);
+    assert_int_equal(top[0]->op->conn_data->num_ops, 2);
+
+    talloc_free(ops_state);
+}
+
+/* A finished operation lets the next waiting one start */
+void test_pool_dispatch(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state, struct test_ctx);
+    TALLOC_CTX *ops_state;
+    struct sdap_handle *sh;
+    struct test_op *top[4];
+    int dp_error;
+    int i;
+
+    ops_state = talloc_new(test_ctx);
+    assert_non_null(ops_state);
+
+    for (i = 0; i < 2; i++) {
+        top[i] = test_op_connect(ops_state, test_ctx);
+        test_op_wait(test_ctx, top[i]);
+    }
+
+    /* both connections are busy */
+    top[2] = test_op_connect(ops_state, test_ctx);
+    top[3] = test_op_connect(ops_state, test_ctx);
+    test_run_pending(test_ctx);
+    assert_true(top[2]->op->waiting);
+    assert_true(top[3]->op->waiting);
+    assert_ptr_equal(test_ctx->conn_cache->waiting, top[2]->op);
+
+    sh = sdap_id_op_handle(top[1]->op);
+    sdap_id_op_done(top[1]->op, EOK, &dp_error);
+    assert_non_null(test_ctx->conn_cache->dispatch_timer);
+
+    /* the first waiting operation takes the released connection, long
+     * before the wait timeout */
+    test_run_pending(test_ctx);
+    assert_null(test_ctx->conn_cache->dispatch_timer);
+    assert_true(top[2]->done);
+    assert_int_equal(top[2]->ret, EOK);
+    assert_ptr_equal(sdap_id_op_handle(top[2]->op), sh);
+    assert_false(top[3]->done);
+    assert_true(top[3]->op->waiting);
+    assert_ptr_equal(test_ctx->conn_cache->waiting, top[3]->op);
+    assert_int_equal(num_connects, 2);
+
+    sh = sdap_id_op_handle(top[0]->op);
+    sdap_id_op_done(top[0]->op, EOK, &dp_error);
+    test_run_pending(test_ctx);
+    assert_true(top[3]->done);
+    assert_ptr_equal(sdap_id_op_handle(top[3]->op), sh);
+    assert_null(test_ctx->conn_cache->waiting);
+
+    talloc_free(ops_state);
+}
+
+/* A lookup started by a running operation, e.g. the primary group of an
+ * initgroups request, must not wait for the connection of its parent */
+void test_nested_op_shares_connection(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state, struct test_ctx);
+    TALLOC_CTX *parent_state;
+    TALLOC_CTX *nested_state;
+    TALLOC_CTX *other_state;
+    struct test_op *parent;
+    struct test_op *nested;
+    struct test_op *other;
+    int dp_error;
+
+    parent_state = talloc_new(test_ctx);
+    assert_non_null(parent_state);
+
+    parent = test_op_connect(parent_state, test_ctx);
+    test_op_wait(test_ctx, parent);
+
+    /* the nested request is allocated under the state of the parent one */
+    nested_state = talloc_new(parent_state);
+    assert_non_null(nested_state);
+
+    other_state = talloc_new(test_ctx);
+    assert_non_null(other_state);
+
+    nested = test_op_connect(nested_state, test_ctx);
+    other = test_op_connect(other_state, test_ctx);
+    test_run_pending(test_ctx);
+
+    assert_true(nested->done);
+    assert_ptr_equal(sdap_id_op_handle(nested->op),
+                     sdap_id_op_handle(parent->op));
+    assert_false(other->done);
+    assert_int_equal(num_connects, 1);
+
+    /* the unrelated operation starts once the connection is released */
+    sdap_id_op_done(nested->op, EOK, &dp_error);
+    sdap_id_op_done(parent->op, EOK, &dp_error);
+    test_op_wait(test_ctx, other);
+    assert_non_null(sdap_id_op_handle(other->op));
+
+    talloc_free(other_state);
+    talloc_free(parent_state);
+}
+
+/* An operation does not wait for a busy connection forever */
+void test_waiting_op_timeout(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state, struct test_ctx);
+    TALLOC_CTX *first_state;
+    TALLOC_CTX *second_state;
+    struct test_op *first;
+    struct test_op *second;
+
+    first_state = talloc_new(test_ctx);
+    assert_non_null(first_state);
+    second_state = talloc_new(test_ctx);
+    assert_non_null(second_state);
+
+    first = test_op_connect(first_state, test_ctx);
+    test_op_wait(test_ctx, first);
+
+    second = test_op_connect(second_state, test_ctx);
+    test_run_pending(test_ctx);
+    assert_false(second->done);
+    assert_true(second->op->waiting);
+
+    /* after the wait timeout the busy connection is shared */
+    test_op_wait(test_ctx, second);
+    assert_ptr_equal(sdap_id_op_handle(second->op),
+                     sdap_id_op_handle(first->op));
+    assert_false(second->op->waiting);
+    assert_null(second->op->wait_timer);
+    assert_int_equal(num_connects, 1);
+
+    talloc_free(second_state);
+    talloc_free(first_state);
+}
+
+/* A waiting operation that goes away does not leave its timer behind */
+void test_waiting_op_freed(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state, struct test_ctx);
+    TALLOC_CTX *first_state;
+    TALLOC_CTX *second_state;
+    struct test_op *first;
+    struct test_op *second;
+
+    first_state = talloc_new(test_ctx);
+    assert_non_null(first_state);
+    second_state = talloc_new(test_ctx);
+    assert_non_null(second_state);
+
+    first = test_op_connect(first_state, test_ctx);
+    test_op_wait(test_ctx, first);
+
+    second = test_op_connect(second_state, test_ctx);
+    test_run_pending(test_ctx);
+    assert_true(second->op->waiting);
+    assert_non_null(second->op->wait_timer);
+
+    talloc_free(second_state);
+    assert_null(test_ctx->conn_cache->waiting);
+
+    talloc_free(first_state);
+}
+
+/* A search which never ends does not take the place of other operations */
+void test_long_lived_op(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state, struct test_ctx);
+    TALLOC_CTX *sync_state;
+    TALLOC_CTX *lookup_state;
+    TALLOC_CTX *waiting_state;
+    struct tevent_req *req;
+    struct test_op *sync;
+    struct test_op *lookup;
+    struct test_op *waiting;
+    errno_t ret;
+
+    sync_state = talloc_new(test_ctx);
+    assert_non_null(sync_state);
+    lookup_state = talloc_new(test_ctx);
+    assert_non_null(lookup_state);
+    waiting_state = talloc_new(test_ctx);
+    assert_non_null(waiting_state);
+
+    sync = talloc_zero(sync_state, struct test_op);
+    assert_non_null(sync);
+    sync->op = sdap_id_op_create(sync_state, test_ctx->conn_cache);
+    assert_non_null(sync->op);
+    sdap_id_op_set_long_lived(sync->op);
+    req = sdap_id_op_connect_send(sync->op, sync_state, &ret);
+    assert_int_equal(ret, EOK);
+    tevent_req_set_callback(req, test_op_connect_done, sync);
+    test_op_wait(test_ctx, sync);
+    assert_int_equal(sync->op->conn_data->num_ops, 0);
+
+    /* a lookup does not wait for the search */
+    lookup = test_op_connect(lookup_state, test_ctx);
+    test_run_pending(test_ctx);
+    assert_true(lookup->done);
+    assert_false(lookup->op->waiting);
+    assert_ptr_equal(sdap_id_op_handle(lookup->op),
+                     sdap_id_op_handle(sync->op));
+
+    /* an operation marked while connected stops counting */
+    waiting = test_op_connect(waiting_state, test_ctx);
+    test_run_pending(test_ctx);
+    assert_false(waiting->done);
+    assert_true(waiting->op->waiting);
+
+    sdap_id_op_set_long_lived(lookup->op);
+    test_op_wait(test_ctx, waiting);
+    assert_int_equal(num_connects, 1);
+
+    talloc_free(waiting_state);
+    talloc_free(lookup_state);
+    talloc_free(sync_state);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_pool_opens_connection,
+                                        test_setup_pool_limit, test_teardown),
+        cmocka_unit_test_setup_teardown(test_pool_least_loaded,
+                                        test_setup_pool_no_limit,
+                                        test_teardown),
+        cmocka_unit_test_setup_teardown(test_pool_dispatch,
+                                        test_setup_pool_limit, test_teardown),
+        cmocka_unit_test_setup_teardown(test_nested_op_shares_connection,
+                                        test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_waiting_op_timeout,
+                                        test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_waiting_op_freed,
+                                        test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_long_lived_op,
+                                        test_setup, test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
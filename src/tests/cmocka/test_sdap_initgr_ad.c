@@ -0,0 +1,359 @@
+/*
+    Copyright (C) 2016 Red Hat
+
+    SSSD tests: Resolving the tokenGroups SIDs in batches
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <popt.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "providers/ldap/ldap_opts.h"
+
+/* The batches are built by a static helper, the domains of the SIDs are
+ * mocked with -Wl,-wrap */
+#include "providers/ldap/sdap_async_initgroups_ad.c"
+
+#define DOM1_SID "S-1-5-21-1111-2222-3333"
+#define DOM2_SID "S-1-5-21-4444-5555-6666"
+#define UNKNOWN_SID "S-1-5-21-7777-8888-9999"
+
+struct test_ctx {
+    struct sdap_ad_resolve_sids_state *state;
+
+    struct sss_domain_info *dom1;
+    struct sss_domain_info *dom2;
+    struct sdap_domain *sdom1;
+    struct sdap_domain *sdom2;
+};
+
+static struct test_ctx *mock_test_ctx;
+
+struct sss_domain_info *
+__wrap_sss_get_domain_by_sid_ldap_fallback(struct sss_domain_info *domain,
+                                           const char *sid)
+{
+    if (strncmp(sid, DOM1_SID, sizeof(DOM1_SID) - 1) == 0) {
+        return mock_test_ctx->dom1;
+    }
+
+    if (strncmp(sid, DOM2_SID, sizeof(DOM2_SID) - 1) == 0) {
+        return mock_test_ctx->dom2;
+    }
+
+    return NULL;
+}
+
+struct sdap_domain *__wrap_sdap_domain_get(struct sdap_options *opts,
+                                           struct sss_domain_info *dom)
+{
+    if (dom == mock_test_ctx->dom1) {
+        return mock_test_ctx->sdom1;
+    }
+
+    if (dom == mock_test_ctx->dom2) {
+        return mock_test_ctx->sdom2;
+    }
+
+    return NULL;
+}
+
+static struct sdap_domain *test_sdom(TALLOC_CTX *mem_ctx,
+                                     struct sss_domain_info **_dom,
+                                     const char *name)
+{
+    struct sdap_domain *sdom;
+
+    sdom = talloc_zero(mem_ctx, struct sdap_domain);
+    assert_non_null(sdom);
+
+    sdom->dom = talloc_zero(sdom, struct sss_domain_info);
+    assert_non_null(sdom->dom);
+    sdom->dom->name = talloc_strdup(sdom->dom, name);
+    assert_non_null(sdom->dom->name);
+
+    *_dom = sdom->dom;
+    return sdom;
+}
+
+static int test_setup(void **state)
+{
+    struct test_ctx *test_ctx;
+    struct sdap_options *opts;
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct test_ctx);
+    assert_non_null(test_ctx);
+
+    opts = talloc_zero(test_ctx, struct sdap_options);
+    assert_non_null(opts);
+    ret = dp_copy_defaults(opts, default_basic_opts, SDAP_OPTS_BASIC,
+                           &opts->basic);
+    assert_int_equal(ret, EOK);
+
+    test_ctx->sdom1 = test_sdom(test_ctx, &test_ctx->dom1, "dom1");
+    test_ctx->sdom2 = test_sdom(test_ctx, &test_ctx->dom2, "dom2");
+
+    test_ctx->state = talloc_zero(test_ctx,
+                                  struct sdap_ad_resolve_sids_state);
+    assert_non_null(test_ctx->state);
+    test_ctx->state->opts = opts;
+    test_ctx->state->domain = test_ctx->dom1;
+
+    mock_test_ctx = test_ctx;
+
+    check_leaks_push(test_ctx);
+    *state = test_ctx;
+    return 0;
+}
+
+static int test_teardown(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state, struct test_ctx);
+
+    talloc_zfree(test_ctx->state->batches);
+
+    assert_true(check_leaks_pop(test_ctx));
+    talloc_free(test_ctx);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+static void set_batch_size(struct test_ctx *test_ctx,
+                           int batch_size, int wildcard_limit)
+{
+    errno_t ret;
+
+    ret = dp_opt_set_int(test_ctx->state->opts->basic,
+                         SDAP_NESTED_GROUP_BATCH_SIZE, batch_size);
+    assert_int_equal(ret, EOK);
+    ret = dp_opt_set_int(test_ctx->state->opts->basic,
+                         SDAP_WILDCARD_LIMIT, wildcard_limit);
+    assert_int_equal(ret, EOK);
+}
+
+/* Generates num_sids SIDs of the domain with the given SID */
+static char **test_sids(TALLOC_CTX *mem_ctx, const char *dom_sid,
+                        size_t num_sids)
+{
+    char **sids;
+    size_t i;
+
+    sids = talloc_zero_array(mem_ctx, char *, num_sids + 1);
+    assert_non_null(sids);
+
+    for (i = 0; i < num_sids; i++) {
+        sids[i] = talloc_asprintf(sids, "%s-%zu", dom_sid, 1000 + i);
+        assert_non_null(sids[i]);
+    }
+
+    return sids;
+}
+
+static void assert_batch(struct sdap_ad_sids_batch *batch,
+                         struct sdap_domain *sdom,
+                         char **sids, size_t first, size_t num_sids)
+{
+    size_t i;
+
+    assert_ptr_equal(batch->sdom, sdom);
+    assert_int_equal(batch->num_sids, num_sids);
+    for (i = 0; i < num_sids; i++) {
+        assert_string_equal(batch->sids[i], sids[first + i]);
+    }
+}
+
+static void test_split(struct test_ctx *test_ctx,
+                       size_t num_sids, size_t batch_size)
+{
+    struct sdap_ad_resolve_sids_state *state = test_ctx->state;
+    size_t num_batches;
+    size_t i;
+    char **sids;
+    errno_t ret;
+
+    sids = test_sids(test_ctx, DOM1_SID, num_sids);
+
+    ret = sdap_ad_resolve_sids_split(state, sids);
+    assert_int_equal(ret, EOK);
+
+    num_batches = (num_sids + batch_size - 1) / batch_size;
+    assert_int_equal(state->num_batches, num_batches);
+    for (i = 0; i < num_batches; i++) {
+        assert_batch(&state->batches[i], test_ctx->sdom1, sids,
+                     i * batch_size,
+                     i + 1 < num_batches ? batch_size
+                                         : num_sids - i * batch_size);
+    }
+
+    talloc_zfree(state->batches);
+    state->num_batches = 0;
+    talloc_free(sids);
+}
+
+/* The SIDs of a domain fill batches of exactly the batch size */
+void test_split_batch_edges(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state, struct test_ctx);
+
+    set_batch_size(test_ctx, 3, 1000);
+
+    test_split(test_ctx, 1, 3);
+    test_split(test_ctx, 2, 3);
+    test_split(test_ctx, 3, 3);
+    test_split(test_ctx, 4, 3);
+    test_split(test_ctx, 6, 3);
+    test_split(test_ctx, 7, 3);
+}
+
+/* The batches are searched with the wildcard size limit */
+void test_split_wildcard_limit(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state, struct test_ctx);
+
+    set_batch_size(test_ctx, 10, 2);
+    test_split(test_ctx, 5, 2);
+
+    /* no limit */
+    set_batch_size(test_ctx, 10, 0);
+    test_split(test_ctx, 5, 10);
+}
+
+/* A batch size below 1, negative ones included, falls back to searching
+ * the SIDs one by one */
+void test_split_batch_size_one(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state, struct test_ctx);
+
+    set_batch_size(test_ctx, 1, 1000);
+    test_split(test_ctx, 3, 1);
+
+    set_batch_size(test_ctx, 0, 1000);
+    test_split(test_ctx, 3, 1);
+
+    set_batch_size(test_ctx, -5, 1000);
+    test_split(test_ctx, 3, 1);
+
+    /* a negative batch size must not turn into a huge one */
+    set_batch_size(test_ctx, -5, 0);
+    test_split(test_ctx, 3, 1);
+}
+
+/* Every batch searches a single domain, the SIDs of a domain go to its
+ * last batch until it is full */
+void test_split_domains(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state, struct test_ctx);
+    struct sdap_ad_resolve_sids_state *resolve_state = test_ctx->state;
+    struct sdap_ad_sids_batch *batches;
+    const char *sids[] = {
+        DOM1_SID"-1000",
+        DOM2_SID"-1000",
+        UNKNOWN_SID"-1000",
+        DOM1_SID"-1001",
+        DOM1_SID"-1002",
+        DOM2_SID"-1001",
+        DOM1_SID"-1003",
+        NULL
+    };
+    errno_t ret;
+
+    set_batch_size(test_ctx, 2, 1000);
+
+    ret = sdap_ad_resolve_sids_split(resolve_state, discard_const(sids));
+    assert_int_equal(ret, EOK);
+
+    batches = resolve_state->batches;
+    assert_int_equal(resolve_state->num_batches, 3);
+
+    assert_ptr_equal(batches[0].sdom, test_ctx->sdom1);
+    assert_int_equal(batches[0].num_sids, 2);
+    assert_string_equal(batches[0].sids[0], sids[0]);
+    assert_string_equal(batches[0].sids[1], sids[3]);
+
+    /* the SID of the unknown domain is skipped */
+    assert_ptr_equal(batches[1].sdom, test_ctx->sdom2);
+    assert_int_equal(batches[1].num_sids, 2);
+    assert_string_equal(batches[1].sids[0], sids[1]);
+    assert_string_equal(batches[1].sids[1], sids[5]);
+
+    assert_ptr_equal(batches[2].sdom, test_ctx->sdom1);
+    assert_int_equal(batches[2].num_sids, 2);
+    assert_string_equal(batches[2].sids[0], sids[4]);
+    assert_string_equal(batches[2].sids[1], sids[6]);
+}
+
+/* SIDs of unknown domains do not start any search */
+void test_split_unknown_domain(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state, struct test_ctx);
+    char **sids;
+    errno_t ret;
+
+    sids = test_sids(test_ctx, UNKNOWN_SID, 3);
+
+    ret = sdap_ad_resolve_sids_split(test_ctx->state, sids);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_ctx->state->num_batches, 0);
+
+    talloc_free(sids);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_split_batch_edges,
+                                        test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_split_wildcard_limit,
+                                        test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_split_batch_size_one,
+                                        test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_split_domains,
+                                        test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_split_unknown_domain,
+                                        test_setup, test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
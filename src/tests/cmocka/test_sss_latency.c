@@ -0,0 +1,306 @@
+/*
+    Copyright (C) 2016 Red Hat
+
+    SSSD tests: Request latency tracing
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <popt.h>
+
+#include "tests/cmocka/common_mock.h"
+
+/* The histograms are static, the module is tested directly */
+#include "util/sss_latency.c"
+
+struct test_ctx {
+    struct tevent_context *ev;
+};
+
+/* gettimeofday() is wrapped so that the durations are exact */
+static struct timeval mock_now;
+
+int __real_gettimeofday(struct timeval *tv, void *tz);
+
+int __wrap_gettimeofday(struct timeval *tv, void *tz)
+{
+    if (!timerisset(&mock_now)) {
+        return __real_gettimeofday(tv, tz);
+    }
+
+    *tv = mock_now;
+    return 0;
+}
+
+static void record_usec(enum sss_latency_stage stage, uint64_t usec)
+{
+    struct timeval start;
+
+    mock_now.tv_sec = 1000;
+    mock_now.tv_usec = 0;
+    sss_latency_start(&start);
+
+    mock_now.tv_sec += usec / 1000000;
+    mock_now.tv_usec += usec % 1000000;
+    sss_latency_record(1, stage, &start);
+
+    timerclear(&mock_now);
+}
+
+static int test_setup(void **state)
+{
+    struct test_ctx *test_ctx;
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct test_ctx);
+    assert_non_null(test_ctx);
+
+    test_ctx->ev = tevent_context_init(test_ctx);
+    assert_non_null(test_ctx->ev);
+
+    ret = sss_latency_setup(test_ctx, test_ctx->ev, 60, false);
+    assert_int_equal(ret, EOK);
+    assert_true(sss_latency_enabled());
+
+    check_leaks_push(test_ctx);
+    *state = test_ctx;
+    return 0;
+}
+
+static int test_teardown(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct test_ctx);
+
+    memset(&latency, 0, sizeof(latency));
+    timerclear(&mock_now);
+
+    assert_true(check_leaks_pop(test_ctx));
+    talloc_free(test_ctx);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+void test_record_buckets(void **state)
+{
+    struct sss_latency_histogram *hist;
+    struct {
+        uint64_t usec;
+        int bucket;
+    } data[] = {
+        { 0, 0 },
+        { 1, 0 },
+        { 2, 1 },
+        { 3, 1 },
+        { 4, 2 },
+        { 1023, 9 },
+        { 1024, 10 },
+        { 1000000, 19 },
+        { (1 << 24) - 1, 23 },
+        { 1 << 24, 24 },
+        { 100000000, 24 },
+    };
+    uint64_t total = 0;
+    size_t i;
+
+    hist = &latency.stages[SSS_LATENCY_LDAP_OP];
+
+    for (i = 0; i < sizeof(data) / sizeof(data[0]); i++) {
+        record_usec(SSS_LATENCY_LDAP_OP, data[i].usec);
+        total += data[i].usec;
+
+        assert_int_equal(hist->count, i + 1);
+        assert_int_equal(hist->max_usec, data[i].usec);
+    }
+    assert_int_equal(hist->total_usec, total);
+
+    assert_int_equal(hist->buckets[0], 2);
+    assert_int_equal(hist->buckets[1], 2);
+    assert_int_equal(hist->buckets[2], 1);
+    assert_int_equal(hist->buckets[9], 1);
+    assert_int_equal(hist->buckets[10], 1);
+    assert_int_equal(hist->buckets[19], 1);
+    assert_int_equal(hist->buckets[23], 1);
+    assert_int_equal(hist->buckets[SSS_LATENCY_BUCKETS - 1], 2);
+
+    /* other stages are not touched */
+    assert_int_equal(latency.stages[SSS_LATENCY_CLIENT].count, 0);
+}
+
+void test_record_clock_set_back(void **state)
+{
+    struct sss_latency_histogram *hist;
+    struct timeval start;
+
+    hist = &latency.stages[SSS_LATENCY_CLIENT];
+
+    mock_now.tv_sec = 1000;
+    sss_latency_start(&start);
+    mock_now.tv_sec = 900;
+    sss_latency_record(1, SSS_LATENCY_CLIENT, &start);
+
+    assert_int_equal(hist->count, 1);
+    assert_int_equal(hist->total_usec, 0);
+    assert_int_equal(hist->buckets[0], 1);
+}
+
+void test_record_not_started(void **state)
+{
+    struct timeval start;
+
+    /* nothing is recorded for a stage that was not started while
+     * tracing was enabled */
+    latency.enabled = false;
+    mock_now.tv_sec = 1000;
+    sss_latency_start(&start);
+    assert_false(timerisset(&start));
+
+    latency.enabled = true;
+    sss_latency_record(1, SSS_LATENCY_CLIENT, &start);
+    assert_int_equal(latency.stages[SSS_LATENCY_CLIENT].count, 0);
+
+    sss_latency_start(&start);
+    sss_latency_record(1, SSS_LATENCY_STAGE_MAX, &start);
+    assert_int_equal(latency.stages[SSS_LATENCY_CLIENT].count, 0);
+}
+
+void test_percentile(void **state)
+{
+    struct sss_latency_histogram hist = { 0 };
+
+    /* 100 durations, the longest one in the last bucket */
+    hist.count = 100;
+    hist.buckets[0] = 50;
+    hist.buckets[3] = 40;
+    hist.buckets[10] = 9;
+    hist.buckets[SSS_LATENCY_BUCKETS - 1] = 1;
+    hist.max_usec = 30000000;
+
+    assert_int_equal(sss_latency_percentile(&hist, 1), 2);
+    assert_int_equal(sss_latency_percentile(&hist, 50), 2);
+    assert_int_equal(sss_latency_percentile(&hist, 51), 16);
+    assert_int_equal(sss_latency_percentile(&hist, 90), 16);
+    assert_int_equal(sss_latency_percentile(&hist, 99), 2048);
+    assert_int_equal(sss_latency_percentile(&hist, 100), 30000000);
+
+    /* a single duration is every percentile */
+    memset(&hist, 0, sizeof(hist));
+    hist.count = 1;
+    hist.buckets[5] = 1;
+    hist.max_usec = 40;
+
+    assert_int_equal(sss_latency_percentile(&hist, 1), 64);
+    assert_int_equal(sss_latency_percentile(&hist, 50), 64);
+    assert_int_equal(sss_latency_percentile(&hist, 100), 64);
+}
+
+void test_report_reset(void **state)
+{
+    time_t before;
+    int stage;
+
+    record_usec(SSS_LATENCY_CLIENT, 10);
+    record_usec(SSS_LATENCY_SYSDB_WRITE, 1 << 25);
+
+    latency.since = 0;
+    before = time(NULL);
+    sss_latency_report();
+
+    for (stage = 0; stage < SSS_LATENCY_STAGE_MAX; stage++) {
+        assert_int_equal(latency.stages[stage].count, 0);
+        assert_int_equal(latency.stages[stage].total_usec, 0);
+        assert_int_equal(latency.stages[stage].max_usec, 0);
+    }
+    assert_true(latency.since >= before);
+
+    /* the next period starts from scratch */
+    record_usec(SSS_LATENCY_CLIENT, 4);
+    assert_int_equal(latency.stages[SSS_LATENCY_CLIENT].count, 1);
+    assert_int_equal(latency.stages[SSS_LATENCY_CLIENT].buckets[2], 1);
+    assert_int_equal(latency.stages[SSS_LATENCY_CLIENT].max_usec, 4);
+}
+
+void test_new_rid(void **state)
+{
+    /* the IDs start at the PID of the process */
+    assert_int_equal(sss_latency_new_rid(), ((uint32_t) getpid() << 16) + 1);
+
+    /* 0 is skipped on wrap around */
+    latency.next_rid = UINT32_MAX - 1;
+    assert_int_equal(sss_latency_new_rid(), UINT32_MAX);
+    assert_int_equal(sss_latency_new_rid(), 1);
+    assert_int_equal(sss_latency_new_rid(), 2);
+
+    latency.enabled = false;
+    assert_int_equal(sss_latency_new_rid(), 0);
+}
+
+void test_set_current(void **state)
+{
+    assert_int_equal(sss_latency_current_rid(), 0);
+
+    assert_int_equal(sss_latency_set_current(5), 0);
+    assert_int_equal(sss_latency_current_rid(), 5);
+    assert_int_equal(sss_latency_set_current(0), 5);
+    assert_int_equal(sss_latency_current_rid(), 0);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_record_buckets,
+                                        test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_record_clock_set_back,
+                                        test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_record_not_started,
+                                        test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_percentile,
+                                        test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_report_reset,
+                                        test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_new_rid,
+                                        test_setup, test_teardown),
+        cmocka_unit_test_setup_teardown(test_set_current,
+                                        test_setup, test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,283 @@
+/*
+    Copyright (C) 2016 Red Hat
+
+    SSSD tests: Upgrades of the cache database
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <cmocka.h>
+#include <popt.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "db/sysdb_private.h"
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_CONF_FILE "tests_conf.ldb"
+
+/* The indexes added to the 0.18 cache */
+static const char *indexes_0_18[] = { SYSDB_UPN, SYSDB_CANONICAL_UPN,
+                                      SYSDB_UUID, SYSDB_USER_CERT,
+                                      SYSDB_GHOST, NULL };
+
+struct sysdb_test_ctx {
+    struct sysdb_ctx *sysdb;
+    struct confdb_ctx *confdb;
+    struct tevent_context *ev;
+    struct sss_domain_info *domain;
+};
+
+static int test_sysdb_setup(void **state)
+{
+    struct sysdb_test_ctx *test_ctx;
+    char *conf_db;
+    const char *val[2];
+    int ret;
+
+    assert_true(leak_check_setup());
+
+    val[1] = NULL;
+
+    /* Create tests directory if it doesn't exist */
+    /* (relative to current dir) */
+    ret = mkdir(TESTS_PATH, 0775);
+    assert_true(ret == 0 || errno == EEXIST);
+
+    test_ctx = talloc_zero(global_talloc_context, struct sysdb_test_ctx);
+    assert_non_null(test_ctx);
+
+    test_ctx->ev = tevent_context_init(test_ctx);
+    assert_non_null(test_ctx->ev);
+
+    conf_db = talloc_asprintf(test_ctx, "%s/%s", TESTS_PATH, TEST_CONF_FILE);
+    assert_non_null(conf_db);
+
+    ret = confdb_init(test_ctx, &test_ctx->confdb, conf_db);
+    assert_int_equal(ret, EOK);
+
+    val[0] = "LOCAL";
+    ret = confdb_add_param(test_ctx->confdb, true,
+                           "config/sssd", "domains", val);
+    assert_int_equal(ret, EOK);
+
+    val[0] = "local";
+    ret = confdb_add_param(test_ctx->confdb, true,
+                           "config/domain/LOCAL", "id_provider", val);
+    assert_int_equal(ret, EOK);
+
+    ret = sssd_domain_init(test_ctx, test_ctx->confdb, "local",
+                           TESTS_PATH, &test_ctx->domain);
+    assert_int_equal(ret, EOK);
+
+    test_ctx->sysdb = test_ctx->domain->sysdb;
+
+    *state = (void *) test_ctx;
+    return 0;
+}
+
+static int test_sysdb_teardown(void **state)
+{
+    struct sysdb_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                         struct sysdb_test_ctx);
+
+    talloc_free(test_ctx);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+static struct ldb_message_element *get_indexes(TALLOC_CTX *mem_ctx,
+                                               struct ldb_context *ldb)
+{
+    const char *attrs[] = { "@IDXATTR", NULL };
+    struct ldb_result *res;
+    struct ldb_dn *dn;
+    int ret;
+
+    dn = ldb_dn_new(mem_ctx, ldb, "@INDEXLIST");
+    assert_non_null(dn);
+
+    ret = ldb_search(ldb, mem_ctx, &res, dn, LDB_SCOPE_BASE, attrs, NULL);
+    assert_int_equal(ret, LDB_SUCCESS);
+    assert_int_equal(res->count, 1);
+
+    return ldb_msg_find_element(res->msgs[0], "@IDXATTR");
+}
+
+static bool has_index(struct ldb_message_element *el, const char *attr)
+{
+    unsigned int i;
+
+    for (i = 0; i < el->num_values; i++) {
+        if (strcmp((const char *) el->values[i].data, attr) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static const char *get_version(TALLOC_CTX *mem_ctx, struct ldb_context *ldb)
+{
+    const char *attrs[] = { "version", NULL };
+    struct ldb_result *res;
+    struct ldb_dn *dn;
+    int ret;
+
+    dn = ldb_dn_new(mem_ctx, ldb, SYSDB_BASE);
+    assert_non_null(dn);
+
+    ret = ldb_search(ldb, mem_ctx, &res, dn, LDB_SCOPE_BASE, attrs, NULL);
+    assert_int_equal(ret, LDB_SUCCESS);
+    assert_int_equal(res->count, 1);
+
+    return ldb_msg_find_attr_as_string(res->msgs[0], "version", NULL);
+}
+
+/* Turn the new cache into one created by an SSSD with cache version 0.17 */
+static void downgrade_to_0_17(TALLOC_CTX *mem_ctx, struct ldb_context *ldb)
+{
+    struct ldb_message *msg;
+    int ret;
+    int i;
+
+    msg = ldb_msg_new(mem_ctx);
+    assert_non_null(msg);
+    msg->dn = ldb_dn_new(msg, ldb, "@INDEXLIST");
+    assert_non_null(msg->dn);
+
+    ret = ldb_msg_add_empty(msg, "@IDXATTR", LDB_FLAG_MOD_DELETE, NULL);
+    assert_int_equal(ret, LDB_SUCCESS);
+    for (i = 0; indexes_0_18[i] != NULL; i++) {
+        ret = ldb_msg_add_string(msg, "@IDXATTR", indexes_0_18[i]);
+        assert_int_equal(ret, LDB_SUCCESS);
+    }
+
+    ret = ldb_modify(ldb, msg);
+    assert_int_equal(ret, LDB_SUCCESS);
+    talloc_free(msg);
+
+    msg = ldb_msg_new(mem_ctx);
+    assert_non_null(msg);
+    msg->dn = ldb_dn_new(msg, ldb, SYSDB_BASE);
+    assert_non_null(msg->dn);
+
+    ret = ldb_msg_add_empty(msg, "version", LDB_FLAG_MOD_REPLACE, NULL);
+    assert_int_equal(ret, LDB_SUCCESS);
+    ret = ldb_msg_add_string(msg, "version", SYSDB_VERSION_0_17);
+    assert_int_equal(ret, LDB_SUCCESS);
+
+    ret = ldb_modify(ldb, msg);
+    assert_int_equal(ret, LDB_SUCCESS);
+    talloc_free(msg);
+}
+
+static void test_sysdb_upgrade_17(void **state)
+{
+    struct sysdb_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                         struct sysdb_test_ctx);
+    struct ldb_context *ldb = test_ctx->sysdb->ldb;
+    struct ldb_message_element *el;
+    const char *version = NULL;
+    TALLOC_CTX *tmp_ctx;
+    int ret;
+    int i;
+
+    tmp_ctx = talloc_new(test_ctx);
+    assert_non_null(tmp_ctx);
+
+    /* a new cache is created with the indexes */
+    el = get_indexes(tmp_ctx, ldb);
+    assert_non_null(el);
+    for (i = 0; indexes_0_18[i] != NULL; i++) {
+        assert_true(has_index(el, indexes_0_18[i]));
+    }
+
+    downgrade_to_0_17(tmp_ctx, ldb);
+    el = get_indexes(tmp_ctx, ldb);
+    assert_non_null(el);
+    for (i = 0; indexes_0_18[i] != NULL; i++) {
+        assert_false(has_index(el, indexes_0_18[i]));
+    }
+    assert_string_equal(get_version(tmp_ctx, ldb), SYSDB_VERSION_0_17);
+
+    ret = sysdb_upgrade_17(test_ctx->sysdb, &version);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(version, SYSDB_VERSION_0_18);
+    assert_string_equal(get_version(tmp_ctx, ldb), SYSDB_VERSION_0_18);
+
+    el = get_indexes(tmp_ctx, ldb);
+    assert_non_null(el);
+    for (i = 0; indexes_0_18[i] != NULL; i++) {
+        assert_true(has_index(el, indexes_0_18[i]));
+    }
+
+    /* the indexes of the older versions are kept */
+    assert_true(has_index(el, SYSDB_NAME));
+    assert_true(has_index(el, SYSDB_SID_STR));
+
+    talloc_free(tmp_ctx);
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    int no_cleanup = 0;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        {"no-cleanup", 'n', POPT_ARG_NONE, &no_cleanup, 0,
+         _("Do not delete the test database after a test run"), NULL },
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_sysdb_upgrade_17,
+                                        test_sysdb_setup, test_sysdb_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while ((opt = poptGetNextOpt(pc)) != -1) {
+        switch (opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_FILE, LOCAL_SYSDB_FILE);
+    test_dom_suite_setup(TESTS_PATH);
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+
+    if (rv == 0 && no_cleanup == 0) {
+        test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_FILE, LOCAL_SYSDB_FILE);
+    }
+    return rv;
+}
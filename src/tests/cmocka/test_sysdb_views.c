@@ -738,6 +738,40 @@ static void test_sysdb_enumpwent_filter_views(void **state)
     check_enumpwent(ret, res, true);
 }
 
+static void test_sysdb_enumpwent_pages(void **state)
+{
+    int ret;
+    struct sysdb_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                        struct sysdb_test_ctx);
+    struct ldb_result *res;
+    const char **names;
+    const char *page[3];
+    size_t count;
+
+    ret = sysdb_enumpwent_names(test_ctx, test_ctx->domain, &names, &count);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(count, N_ELEMENTS(users)-1);
+    assert_string_equal(names[0], "barney");
+    assert_string_equal(names[1], "alice");
+    assert_string_equal(names[2], "bob");
+    assert_null(names[3]);
+
+    ret = sysdb_enumpwent_page_with_views(test_ctx, test_ctx->domain,
+                                          names, count, &res);
+    check_enumpwent(ret, res, true);
+
+    /* users removed since the names were read are skipped */
+    page[0] = "alice";
+    page[1] = "nosuchuser";
+    page[2] = "bob";
+    ret = sysdb_enumpwent_page_with_views(test_ctx, test_ctx->domain,
+                                          page, 3, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 2);
+    assert_user_attrs(res->msgs[0], "alice", true);
+    assert_user_attrs(res->msgs[1], "bob", true);
+}
+
 static const char *groups[] = { "one", "two", "three", NULL };
 
 static void enum_test_group_override(struct sysdb_test_ctx *test_ctx,
@@ -1005,6 +1039,9 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_sysdb_enumpwent_filter_views,
                                         test_enum_users_setup,
                                         test_enum_users_teardown),
+        cmocka_unit_test_setup_teardown(test_sysdb_enumpwent_pages,
+                                        test_enum_users_setup,
+                                        test_enum_users_teardown),
         cmocka_unit_test_setup_teardown(test_sysdb_enumgrent,
                                         test_enum_groups_setup,
                                         test_enum_groups_teardown),
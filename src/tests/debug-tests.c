@@ -24,9 +24,12 @@
 
 #include <check.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <talloc.h>
 #include <errno.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
 #include "util/util.h"
 #include "tests/common.h"
 
@@ -651,6 +654,177 @@ START_TEST(test_debug_is_set_false)
 }
 END_TEST
 
+static char *test_helper_read_debug_file(TALLOC_CTX *mem_ctx, FILE *file)
+{
+    char *content;
+    long filesize;
+    size_t fsize;
+
+    fail_if(fseek(file, 0, SEEK_END) == -1, "fseek failed");
+    filesize = ftell(file);
+    fail_if(filesize == -1, "ftell failed");
+    rewind(file);
+
+    content = talloc_array(mem_ctx, char, filesize + 1);
+    fail_if(content == NULL, "talloc_array failed");
+
+    fsize = fread(content, sizeof(char), filesize, file);
+    fail_unless(fsize == filesize, "fread failed");
+    content[fsize] = '\0';
+
+    return content;
+}
+
+START_TEST(test_debug_buffered)
+{
+    TALLOC_CTX *ctx = talloc_new(NULL);
+    char filename[24] = {'\0'};
+    mode_t old_umask;
+    FILE *file;
+    char *content;
+    char *traced;
+    char *failure;
+    int fd;
+    errno_t ret;
+
+    debug_timestamps = 0;
+    debug_microseconds = 0;
+    debug_to_file = 1;
+    debug_prg_name = "sssd";
+    debug_level = SSSDBG_FATAL_FAILURE | SSSDBG_CRIT_FAILURE |
+                  SSSDBG_OP_FAILURE | SSSDBG_CONF_SETTINGS;
+
+    strncpy(filename, "sssd_debug_tests.XXXXXX", 24);
+    old_umask = umask(SSS_DFL_UMASK);
+    fd = mkstemp(filename);
+    umask(old_umask);
+    fail_if(fd == -1, "mkstemp failed");
+
+    file = fdopen(fd, "r");
+    fail_if(file == NULL, "fdopen failed");
+
+    ret = set_debug_file_from_fd(fd);
+    fail_unless(ret == EOK, "set_debug_file_from_fd failed");
+
+    ret = debug_buffer_init(4096, SSSDBG_TRACE_ALL, 4096);
+    fail_unless(ret == EOK, "debug_buffer_init failed");
+
+    fail_unless(DEBUG_IS_SET(SSSDBG_TRACE_ALL), "Trace level is not set");
+    fail_if(DEBUG_IS_LOGGED(SSSDBG_TRACE_ALL), "Trace level is logged");
+
+    DEBUG(SSSDBG_CONF_SETTINGS, "buffered message\n");
+    DEBUG(SSSDBG_TRACE_ALL, "traced message\n");
+    DEBUG(SSSDBG_TRACE_FUNC, "dropped message\n");
+
+    content = test_helper_read_debug_file(ctx, file);
+    fail_unless(content[0] == '\0', "Buffered message written too early");
+
+    debug_flush();
+
+    content = test_helper_read_debug_file(ctx, file);
+    fail_if(strstr(content, "buffered message\n") == NULL,
+            "Buffered message not written on flush");
+    fail_unless(strstr(content, "traced message") == NULL,
+                "Traced message written without a failure");
+
+    DEBUG(SSSDBG_CRIT_FAILURE, "failure message\n");
+
+    content = test_helper_read_debug_file(ctx, file);
+    traced = strstr(content, "traced message\n");
+    failure = strstr(content, "failure message\n");
+    fail_if(traced == NULL, "Trace not written on failure");
+    fail_if(failure == NULL, "Failure not written at once");
+    fail_unless(traced < failure, "Trace not written before the failure");
+    fail_unless(strstr(content, "dropped message") == NULL,
+                "Message above both levels was written");
+
+    ret = debug_buffer_init(0, 0, 0);
+    fail_unless(ret == EOK, "debug_buffer_init failed");
+    fail_unless(debug_trace_level == 0, "Trace level was not reset");
+
+    fclose(file);
+    remove(filename);
+    talloc_free(ctx);
+}
+END_TEST
+
+static int test_helper_count(const char *content, const char *needle)
+{
+    int count = 0;
+
+    while ((content = strstr(content, needle)) != NULL) {
+        count++;
+        content += strlen(needle);
+    }
+
+    return count;
+}
+
+START_TEST(test_debug_buffered_fork)
+{
+    TALLOC_CTX *ctx = talloc_new(NULL);
+    char filename[24] = {'\0'};
+    mode_t old_umask;
+    FILE *file;
+    char *content;
+    pid_t pid;
+    int status;
+    int fd;
+    errno_t ret;
+
+    debug_timestamps = 0;
+    debug_microseconds = 0;
+    debug_to_file = 1;
+    debug_prg_name = "sssd";
+    debug_level = SSSDBG_FATAL_FAILURE | SSSDBG_CRIT_FAILURE |
+                  SSSDBG_OP_FAILURE | SSSDBG_CONF_SETTINGS;
+
+    strncpy(filename, "sssd_debug_tests.XXXXXX", 24);
+    old_umask = umask(SSS_DFL_UMASK);
+    fd = mkstemp(filename);
+    umask(old_umask);
+    fail_if(fd == -1, "mkstemp failed");
+
+    file = fdopen(fd, "r");
+    fail_if(file == NULL, "fdopen failed");
+
+    ret = set_debug_file_from_fd(fd);
+    fail_unless(ret == EOK, "set_debug_file_from_fd failed");
+
+    ret = debug_buffer_init(4096, 0, 0);
+    fail_unless(ret == EOK, "debug_buffer_init failed");
+
+    DEBUG(SSSDBG_CONF_SETTINGS, "parent message\n");
+
+    pid = fork();
+    fail_if(pid == -1, "fork failed");
+    if (pid == 0) {
+        /* exit() writes out whatever the child has buffered */
+        DEBUG(SSSDBG_CONF_SETTINGS, "child message\n");
+        exit(0);
+    }
+
+    fail_if(waitpid(pid, &status, 0) != pid, "waitpid failed");
+    fail_unless(WIFEXITED(status) && WEXITSTATUS(status) == 0,
+                "Child failed");
+
+    debug_flush();
+
+    content = test_helper_read_debug_file(ctx, file);
+    fail_unless(test_helper_count(content, "parent message\n") == 1,
+                "Parent message not written exactly once");
+    fail_unless(test_helper_count(content, "child message\n") == 1,
+                "Child message not written exactly once");
+
+    ret = debug_buffer_init(0, 0, 0);
+    fail_unless(ret == EOK, "debug_buffer_init failed");
+
+    fclose(file);
+    remove(filename);
+    talloc_free(ctx);
+}
+END_TEST
+
 Suite *debug_suite(void)
 {
     Suite *s = suite_create("debug");
@@ -667,6 +841,8 @@ Suite *debug_suite(void)
     tcase_add_test(tc_debug, test_debug_is_notset_timestamp_microseconds);
     tcase_add_test(tc_debug, test_debug_is_set_true);
     tcase_add_test(tc_debug, test_debug_is_set_false);
+    tcase_add_test(tc_debug, test_debug_buffered);
+    tcase_add_test(tc_debug, test_debug_buffered_fork);
     tcase_set_timeout(tc_debug, 60);
 
     suite_add_tcase(s, tc_debug);
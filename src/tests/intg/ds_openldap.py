@@ -127,6 +127,7 @@ class DSOpenLDAP(DS):
             cn: module{{0}}
             olcModulePath: {dist_lib_dir}
             olcModuleLoad: back_hdb
+            olcModuleLoad: syncprov
 
             # Set defaults for the backend
             dn: olcBackend=hdb,cn=config
@@ -148,6 +149,7 @@ class DSOpenLDAP(DS):
             olcDbIndex: cn,uid eq
             olcDbIndex: uidNumber,gidNumber eq
             olcDbIndex: member,memberUid eq
+            olcDbIndex: entryCSN,entryUUID eq
             olcAccess: to attrs=userPassword,shadowLastChange
               by self write
               by anonymous auth
@@ -155,6 +157,12 @@ class DSOpenLDAP(DS):
             olcAccess: to dn.base="" by * read
             olcAccess: to *
               by * read
+
+            # Content synchronization provider
+            dn: olcOverlay=syncprov,olcDatabase={{1}}hdb,cn=config
+            objectClass: olcOverlayConfig
+            objectClass: olcSyncProvConfig
+            olcOverlay: syncprov
         """).format(**locals())
 
         slapadd = subprocess.Popen(
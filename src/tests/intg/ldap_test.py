@@ -749,3 +749,40 @@ def test_vetoed_shells(vetoed_shells):
                  shell="/bin/default")
         )
     )
+
+
+@pytest.fixture
+def syncrepl_rfc2307(request, ldap_conn):
+    """
+    Create an RFC2307 directory fixture with one user and an SSSD conf
+    following the server changes with the LDAP Content Synchronization
+    """
+    ent_list = ldap_ent.List(ldap_conn.ds_inst.base_dn)
+    ent_list.add_user("user1", 1001, 2001, loginShell="/bin/A")
+    create_ldap_fixture(request, ldap_conn, ent_list)
+    conf = \
+        format_basic_conf(ldap_conn, SCHEMA_RFC2307, enum=False) + \
+        unindent("""
+            [domain/LDAP]
+            ldap_use_syncrepl   = true
+            entry_cache_timeout = 5000
+        """).format(**locals())
+    create_conf_fixture(request, conf)
+    create_sssd_fixture(request)
+    return None
+
+
+def test_syncrepl(ldap_conn, syncrepl_rfc2307):
+    """Test server changes reach the cache before the entries expire"""
+    ent.assert_passwd_by_name("user1", dict(name="user1", shell="/bin/A"))
+
+    user1_dn = "uid=user1,ou=Users," + ldap_conn.ds_inst.base_dn
+    ldap_conn.modify_s(user1_dn,
+                       [(ldap.MOD_REPLACE, "loginShell", "/bin/B")])
+    time.sleep(INTERACTIVE_TIMEOUT)
+    ent.assert_passwd_by_name("user1", dict(name="user1", shell="/bin/B"))
+
+    ldap_conn.delete_s(user1_dn)
+    time.sleep(INTERACTIVE_TIMEOUT)
+    with pytest.raises(KeyError):
+        pwd.getpwnam("user1")
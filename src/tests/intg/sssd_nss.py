@@ -0,0 +1,193 @@
+#
+# Module for calling the netgroup, services and SID functions of the SSSD
+# client libraries directly
+#
+# Copyright (c) 2016 Red Hat, Inc.
+#
+# This is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by
+# the Free Software Foundation; version 2 only
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+import config
+import socket
+from ctypes import (cdll, Structure, Union, c_int, c_char, c_char_p,
+                    c_void_p, c_size_t, c_ulong, POINTER, byref,
+                    create_string_buffer)
+from sssd_id import NssReturnCode
+
+NETGR_TRIPLE_VAL = 0
+
+BUFFER_SIZE = 4096
+
+
+class NetgrTriple(Structure):
+    _fields_ = [("host", c_char_p),
+                ("user", c_char_p),
+                ("domain", c_char_p)]
+
+
+class NetgrVal(Union):
+    _fields_ = [("triple", NetgrTriple),
+                ("group", c_char_p)]
+
+
+class NetgrIdx(Union):
+    _fields_ = [("cursor", c_void_p),
+                ("position", c_ulong)]
+
+
+class Netgrent(Structure):
+    """ glibc struct __netgrent """
+    _fields_ = [("type", c_int),
+                ("val", NetgrVal),
+                ("data", c_void_p),
+                ("data_size", c_size_t),
+                ("idx", NetgrIdx),
+                ("first", c_int),
+                ("known_groups", c_void_p),
+                ("needed_groups", c_void_p),
+                ("nip", c_void_p)]
+
+
+class Servent(Structure):
+    _fields_ = [("s_name", c_char_p),
+                ("s_aliases", POINTER(c_char_p)),
+                ("s_port", c_int),
+                ("s_proto", c_char_p)]
+
+
+def load_libnss_sss():
+    return cdll.LoadLibrary(config.PREFIX + "/lib/libnss_sss.so.2")
+
+
+def get_sssd_netgroup(name):
+    """
+    Function will return the entries of a netgroup as provided by sssd.
+
+    @param string name name of the netgroup
+
+    @return (int, List[(string, string, string) or string]) (err, entries)
+        entries contains (host, user, domain) tuples for triples and names
+        for nested netgroups if err is NssReturnCode.SUCCESS
+    """
+    libnss_sss = load_libnss_sss()
+    result = Netgrent()
+    buf = create_string_buffer(BUFFER_SIZE)
+    errno = c_int(0)
+
+    res = libnss_sss._nss_sss_setnetgrent(c_char_p(name), byref(result))
+    if res != NssReturnCode.SUCCESS:
+        return (int(res), [])
+
+    entries = []
+    getnetgrent_r = libnss_sss._nss_sss_getnetgrent_r
+    getnetgrent_r.argtypes = [POINTER(Netgrent), POINTER(c_char), c_size_t,
+                              POINTER(c_int)]
+    while True:
+        res = getnetgrent_r(byref(result), buf, BUFFER_SIZE, byref(errno))
+        if res != NssReturnCode.SUCCESS:
+            break
+        if result.type == NETGR_TRIPLE_VAL:
+            triple = result.val.triple
+            entries.append((triple.host, triple.user, triple.domain))
+        else:
+            entries.append(result.val.group)
+
+    libnss_sss._nss_sss_endnetgrent(byref(result))
+    return (NssReturnCode.SUCCESS, entries)
+
+
+def servent_to_tuple(result):
+    aliases = []
+    i = 0
+    while result.s_aliases[i] is not None:
+        aliases.append(result.s_aliases[i])
+        i += 1
+    return (result.s_name, aliases, socket.ntohs(result.s_port),
+            result.s_proto)
+
+
+def get_sssd_service_by_name(name, protocol):
+    """
+    Function will look up a service by name as provided by sssd.
+
+    @param string name name of the service
+    @param string protocol protocol of the service or None
+
+    @return (int, (string, List[string], int, string)) (err, service)
+        service contains the name, aliases, port and protocol if err is
+        NssReturnCode.SUCCESS
+    """
+    libnss_sss = load_libnss_sss()
+    result = Servent()
+    buf = create_string_buffer(BUFFER_SIZE)
+    errno = c_int(0)
+
+    func = libnss_sss._nss_sss_getservbyname_r
+    func.argtypes = [c_char_p, c_char_p, POINTER(Servent), POINTER(c_char),
+                     c_size_t, POINTER(c_int)]
+    res = func(name, protocol, byref(result), buf, BUFFER_SIZE, byref(errno))
+    if res != NssReturnCode.SUCCESS:
+        return (int(res), None)
+
+    return (NssReturnCode.SUCCESS, servent_to_tuple(result))
+
+
+def get_sssd_service_by_port(port, protocol):
+    """
+    Function will look up a service by port as provided by sssd.
+
+    @param int port port of the service in host byte order
+    @param string protocol protocol of the service or None
+
+    @return (int, (string, List[string], int, string)) (err, service)
+        service contains the name, aliases, port and protocol if err is
+        NssReturnCode.SUCCESS
+    """
+    libnss_sss = load_libnss_sss()
+    result = Servent()
+    buf = create_string_buffer(BUFFER_SIZE)
+    errno = c_int(0)
+
+    func = libnss_sss._nss_sss_getservbyport_r
+    func.argtypes = [c_int, c_char_p, POINTER(Servent), POINTER(c_char),
+                     c_size_t, POINTER(c_int)]
+    res = func(socket.htons(port), protocol, byref(result), buf, BUFFER_SIZE,
+               byref(errno))
+    if res != NssReturnCode.SUCCESS:
+        return (int(res), None)
+
+    return (NssReturnCode.SUCCESS, servent_to_tuple(result))
+
+
+def get_sssd_sid_by_name(name):
+    """
+    Function will return the SID of an object as provided by sssd.
+
+    @param string name fully qualified name of the object
+
+    @return (int, string) (err, sid)
+        sid is set if err is 0, otherwise err is an errno value
+    """
+    libsss_nss_idmap = cdll.LoadLibrary(config.PREFIX +
+                                        "/lib/libsss_nss_idmap.so.0")
+    sid = c_char_p()
+    id_type = c_int(0)
+
+    func = libsss_nss_idmap.sss_nss_getsidbyname
+    func.restype = c_int
+    func.argtypes = [c_char_p, POINTER(c_char_p), POINTER(c_int)]
+    res = func(name, byref(sid), byref(id_type))
+    if res != 0:
+        return (res, None)
+
+    # the SID is malloc'ed by the library, leaking it here is fine
+    return (0, sid.value)
@@ -18,9 +18,11 @@
 #
 import os
 import stat
+import struct
 import ent
 import grp
 import pwd
+import ldap
 import config
 import signal
 import subprocess
@@ -29,6 +31,7 @@ import pytest
 import ds_openldap
 import ldap_ent
 import sssd_id
+import sssd_nss
 from util import unindent
 
 LDAP_BASE_DN = "dc=example,dc=com"
@@ -126,6 +129,14 @@ def load_data_to_ldap(request, ldap_conn):
     ent_list.add_group("group0x", 2000, ["user1", "user2", "user3"])
     ent_list.add_group("group1x", 2010, ["user11", "user12", "user13"])
     ent_list.add_group("group2x", 2020, ["user21", "user22", "user23"])
+
+    ent_list.add_netgroup("netgroup1", ["(host1,user1,example.com)",
+                                        "(host2,user2,example.com)"])
+    ent_list.add_netgroup("netgroup2", ["(host3,user3,example.com)"],
+                          ["netgroup1"])
+
+    ent_list.add_service("svc1", 11111, ["tcp", "udp"], ["svc1-alias"])
+    ent_list.add_service("svc2", 22222, ["tcp"])
     create_ldap_fixture(request, ldap_conn, ent_list)
 
 
@@ -207,6 +218,124 @@ def fqname_case_insensitive_rfc2307(request, ldap_conn):
     return None
 
 
+MANY_USERS = 100
+
+
+def load_many_users_to_ldap(request, ldap_conn):
+    ent_list = ldap_ent.List(ldap_conn.ds_inst.base_dn)
+    for i in range(MANY_USERS):
+        ent_list.add_user("muser%d" % i, 3000 + i, 2001)
+    create_ldap_fixture(request, ldap_conn, ent_list)
+
+
+@pytest.fixture
+def small_mc_rfc2307(request, ldap_conn):
+    load_data_to_ldap(request, ldap_conn)
+    load_many_users_to_ldap(request, ldap_conn)
+
+    conf = unindent("""\
+        [sssd]
+        domains             = LDAP
+        services            = nss
+
+        [nss]
+        memcache_size_passwd = 8
+
+        [domain/LDAP]
+        ldap_auth_disable_tls_never_use_in_production = true
+        ldap_schema         = rfc2307
+        id_provider         = ldap
+        auth_provider       = ldap
+        sudo_provider       = ldap
+        ldap_uri            = {ldap_conn.ds_inst.ldap_url}
+        ldap_search_base    = {ldap_conn.ds_inst.base_dn}
+    """).format(**locals())
+    create_conf_fixture(request, conf)
+    create_sssd_fixture(request)
+    return None
+
+
+@pytest.fixture
+def short_mc_timeout_rfc2307(request, ldap_conn):
+    load_data_to_ldap(request, ldap_conn)
+
+    conf = unindent("""\
+        [sssd]
+        domains             = LDAP
+        services            = nss
+
+        [nss]
+        memcache_timeout    = 1
+
+        [domain/LDAP]
+        ldap_auth_disable_tls_never_use_in_production = true
+        ldap_schema         = rfc2307
+        id_provider         = ldap
+        auth_provider       = ldap
+        sudo_provider       = ldap
+        ldap_uri            = {ldap_conn.ds_inst.ldap_url}
+        ldap_search_base    = {ldap_conn.ds_inst.base_dn}
+        entry_cache_timeout = 1
+    """).format(**locals())
+    create_conf_fixture(request, conf)
+    create_sssd_fixture(request)
+    return None
+
+
+@pytest.fixture
+def disabled_mc_rfc2307(request, ldap_conn):
+    load_data_to_ldap(request, ldap_conn)
+
+    conf = unindent("""\
+        [sssd]
+        domains             = LDAP
+        services            = nss
+
+        [nss]
+        memcache_size_netgroup = 0
+        memcache_size_services = 0
+        memcache_size_sid   = 0
+
+        [domain/LDAP]
+        ldap_auth_disable_tls_never_use_in_production = true
+        ldap_schema         = rfc2307
+        id_provider         = ldap
+        auth_provider       = ldap
+        sudo_provider       = ldap
+        ldap_uri            = {ldap_conn.ds_inst.ldap_url}
+        ldap_search_base    = {ldap_conn.ds_inst.base_dn}
+    """).format(**locals())
+    create_conf_fixture(request, conf)
+    create_sssd_fixture(request)
+    return None
+
+
+@pytest.fixture
+def warm_restart_rfc2307(request, ldap_conn):
+    load_data_to_ldap(request, ldap_conn)
+
+    conf = unindent("""\
+        [sssd]
+        domains             = LDAP
+        services            = nss
+
+        [nss]
+        memcache_warm_restart = true
+
+        [domain/LDAP]
+        ldap_auth_disable_tls_never_use_in_production = true
+        ldap_schema         = rfc2307
+        id_provider         = ldap
+        auth_provider       = ldap
+        sudo_provider       = ldap
+        ldap_uri            = {ldap_conn.ds_inst.ldap_url}
+        ldap_search_base    = {ldap_conn.ds_inst.base_dn}
+    """).format(**locals())
+    create_conf_fixture(request, conf)
+    create_sssd_fixture(request)
+    return None
+
+
 def test_getpwnam(ldap_conn, sanity_rfc2307):
     ent.assert_passwd_by_name(
         'user1',
@@ -778,3 +907,304 @@ def test_removed_mc(ldap_conn, sanity_rfc2307):
         grp.getgrnam('group1')
     with pytest.raises(KeyError):
         grp.getgrgid(2001)
+
+
+def restart_sssd():
+    """Restart sssd and wait for the NSS responder to set up its caches"""
+    stop_sssd()
+    if subprocess.call(["sssd", "-D", "-f"]) != 0:
+        raise Exception("sssd start failed")
+    ent.assert_passwd_by_name('user2', dict(name='user2', uid=1002))
+
+
+SSS_MC_HEADER_ALIVE = 1
+SSS_MC_HEADER_RECYCLED = 2
+
+
+def read_mc_header(name):
+    """Read the header of a memory cache file up to the hash table offset"""
+    path = config.MCACHE_PATH + "/" + name
+    with open(path, "rb") as mc_file:
+        return struct.unpack("11I", mc_file.read(44))
+
+
+def read_mc_data_table(name):
+    header = read_mc_header(name)
+    path = config.MCACHE_PATH + "/" + name
+    with open(path, "rb") as mc_file:
+        mc_file.seek(header[8])
+        return mc_file.read(header[5])
+
+
+def mc_elems(name):
+    """Number of entries a memory cache file was sized for"""
+    return read_mc_header(name)[6] * 8
+
+
+def overwrite_mc_table(name, table, value):
+    """Overwrite the data or hash table of a memory cache file"""
+    path = config.MCACHE_PATH + "/" + name
+    header = read_mc_header(name)
+    with open(path, "r+b") as mc_file:
+        if table == "data":
+            offset, size = header[8], header[5]
+        else:
+            offset, size = header[10], header[7]
+        mc_file.seek(offset)
+        mc_file.write(value * size)
+
+
+def prepare_warm_restart():
+    ent.assert_passwd_by_name('user1', dict(name='user1', uid=1001))
+    ent.assert_group_by_name("group1", dict(name="group1", gid=2001))
+    stop_sssd()
+
+
+def test_warm_restart(ldap_conn, warm_restart_rfc2307):
+    prepare_warm_restart()
+    restart_sssd()
+    stop_sssd()
+
+    # only the records copied from the previous cache files are left
+    ent.assert_passwd_by_name('user1', dict(name='user1', uid=1001))
+    ent.assert_passwd_by_uid(1001, dict(name='user1', uid=1001))
+    ent.assert_group_by_name("group1", dict(name="group1", gid=2001))
+    ent.assert_group_by_gid(2001, dict(name="group1", gid=2001))
+
+
+def test_warm_restart_disabled(ldap_conn, sanity_rfc2307):
+    prepare_warm_restart()
+    restart_sssd()
+    stop_sssd()
+
+    with pytest.raises(KeyError):
+        pwd.getpwnam('user1')
+    with pytest.raises(KeyError):
+        grp.getgrnam('group1')
+
+
+def test_warm_restart_unlinked_records(ldap_conn, warm_restart_rfc2307):
+    prepare_warm_restart()
+
+    # records that cannot be reached through the hash table are not reused
+    overwrite_mc_table("passwd", "hash", b"\xff")
+    restart_sssd()
+    stop_sssd()
+
+    with pytest.raises(KeyError):
+        pwd.getpwnam('user1')
+    ent.assert_group_by_name("group1", dict(name="group1", gid=2001))
+
+
+def test_warm_restart_corrupted_records(ldap_conn, warm_restart_rfc2307):
+    prepare_warm_restart()
+
+    # the hash chains lead to garbage with valid looking barriers
+    overwrite_mc_table("passwd", "data", b"\xf0")
+    restart_sssd()
+    stop_sssd()
+
+    with pytest.raises(KeyError):
+        pwd.getpwnam('user1')
+    ent.assert_group_by_name("group1", dict(name="group1", gid=2001))
+
+
+def assert_many_user(i):
+    ent.assert_passwd_by_name("muser%d" % i,
+                              dict(name="muser%d" % i, uid=3000 + i))
+
+
+def test_mc_growth_with_mapped_file(ldap_conn, small_mc_rfc2307):
+    # the client maps the first file
+    assert_many_user(0)
+    assert mc_elems("passwd") == 8
+
+    # entries evicted before they expired make the cache grow, clients
+    # still holding the old file have to switch to the new one
+    for i in range(1, 30):
+        assert_many_user(i)
+    assert mc_elems("passwd") > 8
+
+    for i in range(30):
+        assert_many_user(i)
+
+    stop_sssd()
+
+    # served from the new file
+    assert_many_user(29)
+
+
+def test_mc_eviction_when_full(ldap_conn, small_mc_rfc2307):
+    for i in range(MANY_USERS):
+        assert_many_user(i)
+
+    # the cache stops growing at eight times its size and the oldest
+    # entries make room for the new ones
+    assert mc_elems("passwd") == 8 * 8
+
+    stop_sssd()
+
+    assert_many_user(MANY_USERS - 1)
+    with pytest.raises(KeyError):
+        pwd.getpwnam("muser0")
+
+
+def test_mc_free_list_reuse(ldap_conn, short_mc_timeout_rfc2307):
+    for name in ["user1", "user2", "user3"]:
+        ent.assert_passwd_by_name(name, dict(name=name))
+
+    # name and password of a record are at the start of its strings
+    old_pos = read_mc_data_table("passwd").find(b"\x00user2\x00*\x00")
+    assert old_pos != -1
+
+    # the record of user2 does not fit its slots anymore
+    ldap_conn.modify_s("uid=user2,ou=Users," + ldap_conn.ds_inst.base_dn,
+                       [(ldap.MOD_REPLACE, "cn", "x" * 100)])
+    time.sleep(2)
+    ent.assert_passwd_by_name("user2", dict(name="user2", gecos="x" * 100))
+
+    # a record of the old size reuses the freed slots
+    ent.assert_passwd_by_name("user11", dict(name="user11", uid=1011))
+    data_table = read_mc_data_table("passwd")
+    assert data_table.find(b"\x00user11\x00*\x00") == old_pos
+    assert data_table.find(b"\x00user2\x00*\x00") != old_pos
+
+    ent.assert_passwd_by_name("user2", dict(name="user2", gecos="x" * 100))
+
+
+NETGROUP1_ENTRIES = [("host1", "user1", "example.com"),
+                     ("host2", "user2", "example.com")]
+NETGROUP2_ENTRIES = [("host3", "user3", "example.com"), "netgroup1"]
+
+SVC1_TCP = ("svc1", ["svc1-alias"], 11111, "tcp")
+SVC1_UDP = ("svc1", ["svc1-alias"], 11111, "udp")
+SVC2_TCP = ("svc2", [], 22222, "tcp")
+
+
+def assert_netgroup(name, expected_entries):
+    (res, entries) = sssd_nss.get_sssd_netgroup(name)
+    assert res == sssd_id.NssReturnCode.SUCCESS, \
+        "Could not find netgroup %s" % name
+    assert sorted(entries) == sorted(expected_entries)
+
+
+def assert_service(name, port, protocol, expected):
+    (res, service) = sssd_nss.get_sssd_service_by_name(name, protocol)
+    assert res == sssd_id.NssReturnCode.SUCCESS, \
+        "Could not find service %s/%s" % (name, protocol)
+    assert service == expected
+
+    (res, service) = sssd_nss.get_sssd_service_by_port(port, protocol)
+    assert res == sssd_id.NssReturnCode.SUCCESS, \
+        "Could not find service %d/%s" % (port, protocol)
+    assert service == expected
+
+
+def assert_mc_records_for_netgroups_services():
+    assert_netgroup("netgroup1", NETGROUP1_ENTRIES)
+    assert_netgroup("netgroup2", NETGROUP2_ENTRIES)
+
+    assert_service("svc1", 11111, "tcp", SVC1_TCP)
+    assert_service("svc1-alias", 11111, "udp", SVC1_UDP)
+    assert_service("svc2", 22222, "tcp", SVC2_TCP)
+
+
+def assert_missing_mc_records_for_netgroups_services():
+    for name in ["netgroup1", "netgroup2"]:
+        (res, _) = sssd_nss.get_sssd_netgroup(name)
+        assert res != sssd_id.NssReturnCode.SUCCESS, \
+            "Netgroup %s should not be found without sssd" % name
+
+    for (name, port, protocol) in [("svc1", 11111, "tcp"),
+                                   ("svc1-alias", 11111, "udp"),
+                                   ("svc2", 22222, "tcp")]:
+        (res, _) = sssd_nss.get_sssd_service_by_name(name, protocol)
+        assert res != sssd_id.NssReturnCode.SUCCESS, \
+            "Service %s/%s should not be found without sssd" % \
+            (name, protocol)
+        (res, _) = sssd_nss.get_sssd_service_by_port(port, protocol)
+        assert res != sssd_id.NssReturnCode.SUCCESS, \
+            "Service %d/%s should not be found without sssd" % \
+            (port, protocol)
+
+
+def test_netgroups_services_with_mc(ldap_conn, sanity_rfc2307):
+    assert_mc_records_for_netgroups_services()
+    stop_sssd()
+
+    # everything should be in memory cache
+    assert_mc_records_for_netgroups_services()
+
+
+def test_services_without_protocol_with_mc(ldap_conn, sanity_rfc2307):
+    assert_service("svc2", 22222, "tcp", SVC2_TCP)
+    (res, service) = sssd_nss.get_sssd_service_by_name("svc2", None)
+    assert res == sssd_id.NssReturnCode.SUCCESS
+    assert service == SVC2_TCP
+    stop_sssd()
+
+    # only lookups with a protocol are served from the memory cache
+    assert_service("svc2", 22222, "tcp", SVC2_TCP)
+    (res, _) = sssd_nss.get_sssd_service_by_name("svc2", None)
+    assert res != sssd_id.NssReturnCode.SUCCESS
+    (res, _) = sssd_nss.get_sssd_service_by_port(22222, None)
+    assert res != sssd_id.NssReturnCode.SUCCESS
+
+
+def test_invalidate_netgroups_services_before_stop(ldap_conn,
+                                                   sanity_rfc2307):
+    assert_mc_records_for_netgroups_services()
+
+    subprocess.call(["sss_cache", "-E"])
+    stop_sssd()
+
+    assert_missing_mc_records_for_netgroups_services()
+
+
+def test_invalidate_netgroups_services_after_stop(ldap_conn,
+                                                  sanity_rfc2307):
+    assert_mc_records_for_netgroups_services()
+    stop_sssd()
+
+    assert_mc_records_for_netgroups_services()
+    subprocess.call(["sss_cache", "-E"])
+
+    assert_missing_mc_records_for_netgroups_services()
+
+
+def test_invalidate_netgroups_before_stop(ldap_conn, sanity_rfc2307):
+    assert_mc_records_for_netgroups_services()
+
+    subprocess.call(["sss_cache", "-N"])
+    stop_sssd()
+
+    assert_missing_mc_records_for_netgroups_services()
+
+
+def test_invalidate_sid_mc(ldap_conn, sanity_rfc2307):
+    ent.assert_passwd_by_name('user1', dict(name='user1', uid=1001))
+    assert read_mc_header("sid")[3] == SSS_MC_HEADER_ALIVE
+    stop_sssd()
+
+    subprocess.call(["sss_cache", "-E"])
+    assert read_mc_header("sid")[3] == SSS_MC_HEADER_RECYCLED
+
+    # without sssd and a usable memory cache nothing can be resolved
+    (res, _) = sssd_nss.get_sssd_sid_by_name("user1@LDAP")
+    assert res != 0
+
+
+def test_disabled_netgroup_services_sid_mc(ldap_conn, disabled_mc_rfc2307):
+    # disabled memory caches are not even created
+    for name in ["netgroup", "services", "sid"]:
+        assert not os.path.exists(config.MCACHE_PATH + "/" + name)
+    assert os.path.exists(config.MCACHE_PATH + "/passwd")
+
+    # lookups fall back to the responder
+    assert_mc_records_for_netgroups_services()
+    stop_sssd()
+
+    assert_missing_mc_records_for_netgroups_services()
+
+    # invalidation skips the missing files
+    assert subprocess.call(["sss_cache", "-E"]) == 0
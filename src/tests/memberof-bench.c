@@ -0,0 +1,422 @@
+/*
+   SSSD
+
+   memberof module benchmark
+
+   Stores a group with a large number of members at the bottom of a nested
+   group hierarchy and reports how long the memberof module takes to add
+   the members, remove some of them, nest the group into another one and
+   delete it. Run it with LDB_MODULES_PATH pointing to the directory of the
+   memberof module to be measured, e.g. ldb_mod_test_dir of the build tree,
+   to compare two versions of the module.
+
+   Copyright (C) 2016 Red Hat
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <talloc.h>
+#include <popt.h>
+#include <time.h>
+#include <errno.h>
+
+#include "util/util.h"
+#include "db/sysdb.h"
+#include "tests/common.h"
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_CONF_DB "tests_conf.ldb"
+#define TEST_DOM_NAME "bench"
+
+#define DEFAULT_USERS   20000
+#define DEFAULT_DEPTH   4
+#define DEFAULT_WIDTH   2
+
+#define UID_BASE        100000
+#define GID_BASE        200000
+
+#define LEAF_GROUP      "bleaf"
+#define EXTRA_GROUP     "bextra"
+
+static int verbose;
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec)
+           + (end->tv_nsec - start->tv_nsec) / 1000000000.0;
+}
+
+static void report(const char *step, struct timespec *start)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("%-40s %10.3f s\n", step, elapsed(start, &end));
+}
+
+static char *level_group_name(TALLOC_CTX *mem_ctx, int level, int idx)
+{
+    return talloc_asprintf(mem_ctx, "bgroup_%d_%d", level, idx);
+}
+
+/* Each group of a level is a member of every group of the level above, so
+ * the entries below are reached by several paths of the hierarchy */
+static errno_t store_hierarchy(struct sss_test_ctx *tctx,
+                               int depth, int width)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sysdb_attrs *attrs;
+    char *name;
+    char *member;
+    gid_t gid = GID_BASE;
+    int level;
+    int i;
+    int j;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    for (level = 0; level < depth; level++) {
+        for (i = 0; i < width; i++) {
+            name = level_group_name(tmp_ctx, level, i);
+            if (name == NULL) {
+                ret = ENOMEM;
+                goto done;
+            }
+
+            ret = sysdb_store_group(tctx->dom, name, gid++, NULL, -1, 0);
+            if (ret != EOK) {
+                goto done;
+            }
+        }
+
+        if (level == 0) {
+            continue;
+        }
+
+        for (j = 0; j < width; j++) {
+            attrs = sysdb_new_attrs(tmp_ctx);
+            if (attrs == NULL) {
+                ret = ENOMEM;
+                goto done;
+            }
+
+            for (i = 0; i < width; i++) {
+                member = sysdb_group_strdn(attrs, tctx->dom->name,
+                                           level_group_name(tmp_ctx,
+                                                            level, i));
+                if (member == NULL) {
+                    ret = ENOMEM;
+                    goto done;
+                }
+
+                ret = sysdb_attrs_steal_string(attrs, SYSDB_MEMBER, member);
+                if (ret != EOK) {
+                    goto done;
+                }
+            }
+
+            name = level_group_name(tmp_ctx, level - 1, j);
+            if (name == NULL) {
+                ret = ENOMEM;
+                goto done;
+            }
+
+            ret = sysdb_store_group(tctx->dom, name, GID_BASE +
+                                    (level - 1) * width + j, attrs, -1, 0);
+            if (ret != EOK) {
+                goto done;
+            }
+        }
+    }
+
+    /* the leaf group is a member of every group of the lowest level */
+    ret = sysdb_store_group(tctx->dom, LEAF_GROUP, gid++, NULL, -1, 0);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    for (i = 0; i < width; i++) {
+        ret = sysdb_add_group_member(tctx->dom,
+                                     level_group_name(tmp_ctx, depth - 1, i),
+                                     LEAF_GROUP, SYSDB_MEMBER_GROUP, false);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    ret = sysdb_store_group(tctx->dom, EXTRA_GROUP, gid++, NULL, -1, 0);
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static errno_t store_users(struct sss_test_ctx *tctx, int num_users)
+{
+    char name[64];
+    errno_t ret;
+    errno_t sret;
+    int i;
+
+    ret = sysdb_transaction_start(tctx->sysdb);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    for (i = 0; i < num_users; i++) {
+        snprintf(name, sizeof(name), "buser%d", i);
+        ret = sysdb_store_user(tctx->dom, name, "x", UID_BASE + i, 0, name,
+                               "/home/buser", "/bin/bash",
+                               NULL, NULL, NULL, -1, 0);
+        if (ret != EOK) {
+            sret = sysdb_transaction_cancel(tctx->sysdb);
+            if (sret != EOK) {
+                DEBUG(SSSDBG_CRIT_FAILURE, "Could not cancel transaction\n");
+            }
+            return ret;
+        }
+    }
+
+    return sysdb_transaction_commit(tctx->sysdb);
+}
+
+/* Replaces the members of the leaf group with the first num_users users */
+static errno_t store_leaf_members(struct sss_test_ctx *tctx, int num_users)
+{
+    struct sysdb_attrs *attrs;
+    char name[64];
+    char *member;
+    errno_t ret;
+    int i;
+
+    attrs = sysdb_new_attrs(NULL);
+    if (attrs == NULL) {
+        return ENOMEM;
+    }
+
+    for (i = 0; i < num_users; i++) {
+        snprintf(name, sizeof(name), "buser%d", i);
+        member = sysdb_user_strdn(attrs, tctx->dom->name, name);
+        if (member == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        ret = sysdb_attrs_steal_string(attrs, SYSDB_MEMBER, member);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    ret = sysdb_store_group(tctx->dom, LEAF_GROUP, 0, attrs, -1, 0);
+
+done:
+    talloc_free(attrs);
+    return ret;
+}
+
+/* Checks that the memberuid values reached the top of the hierarchy */
+static errno_t check_members(struct sss_test_ctx *tctx, const char *group,
+                             int num_users)
+{
+    const char *attrs[] = { SYSDB_MEMBERUID, NULL };
+    struct ldb_message *msg;
+    struct ldb_message_element *el;
+    unsigned int count;
+    errno_t ret;
+
+    ret = sysdb_search_group_by_name(NULL, tctx->dom, group, attrs, &msg);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    el = ldb_msg_find_element(msg, SYSDB_MEMBERUID);
+    count = el != NULL ? el->num_values : 0;
+    talloc_free(msg);
+
+    if (count != (unsigned int) num_users) {
+        fprintf(stderr, "Group %s has %u memberuid values, expected %d\n",
+                group, count, num_users);
+        return EINVAL;
+    }
+
+    if (verbose) {
+        printf("Group %s has %u memberuid values\n", group, count);
+    }
+
+    return EOK;
+}
+
+static errno_t run_benchmark(struct sss_test_ctx *tctx,
+                             int num_users, int depth, int width)
+{
+    struct timespec start;
+    char *top;
+    errno_t ret;
+
+    top = level_group_name(tctx, 0, 0);
+    if (top == NULL) {
+        return ENOMEM;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ret = store_users(tctx, num_users);
+    if (ret != EOK) {
+        fprintf(stderr, "Could not store the users: %s\n", sss_strerror(ret));
+        return ret;
+    }
+    report("store users", &start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ret = store_hierarchy(tctx, depth, width);
+    if (ret != EOK) {
+        fprintf(stderr, "Could not store the groups: %s\n", sss_strerror(ret));
+        return ret;
+    }
+    report("store group hierarchy", &start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ret = store_leaf_members(tctx, num_users);
+    if (ret != EOK) {
+        fprintf(stderr, "Could not add the members: %s\n", sss_strerror(ret));
+        return ret;
+    }
+    report("add all members to the leaf group", &start);
+
+    ret = check_members(tctx, top, num_users);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ret = store_leaf_members(tctx, num_users / 2);
+    if (ret != EOK) {
+        fprintf(stderr, "Could not remove the members: %s\n",
+                sss_strerror(ret));
+        return ret;
+    }
+    report("remove half of the members", &start);
+
+    ret = check_members(tctx, top, num_users / 2);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ret = sysdb_add_group_member(tctx->dom, EXTRA_GROUP, LEAF_GROUP,
+                                 SYSDB_MEMBER_GROUP, false);
+    if (ret != EOK) {
+        fprintf(stderr, "Could not nest the leaf group: %s\n",
+                sss_strerror(ret));
+        return ret;
+    }
+    report("nest the leaf group into another one", &start);
+
+    ret = check_members(tctx, EXTRA_GROUP, num_users / 2);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ret = sysdb_delete_group(tctx->dom, LEAF_GROUP, 0);
+    if (ret != EOK) {
+        fprintf(stderr, "Could not delete the leaf group: %s\n",
+                sss_strerror(ret));
+        return ret;
+    }
+    report("delete the leaf group", &start);
+
+    return check_members(tctx, top, 0);
+}
+
+int main(int argc, const char *argv[])
+{
+    int opt;
+    poptContext pc;
+    int pc_users = DEFAULT_USERS;
+    int pc_depth = DEFAULT_DEPTH;
+    int pc_width = DEFAULT_WIDTH;
+    struct sss_test_ctx *tctx;
+    int ret;
+
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        { "users", 'u', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_users, 0,
+                    "Number of members of the leaf group", NULL },
+        { "depth", 'd', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_depth, 0,
+                    "Number of levels of groups above the leaf group", NULL },
+        { "width", 'w', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_width, 0,
+                    "Number of groups on each level", NULL },
+        { "verbose", 'v', POPT_ARG_NONE, 0, 'v',
+                    "Be verbose", NULL },
+        POPT_TABLEEND
+    };
+
+    /* parse the params */
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while ((opt = poptGetNextOpt(pc)) != -1) {
+        switch (opt) {
+            case 'v':
+                verbose = 1;
+                break;
+
+            default:
+                fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                        poptBadOption(pc, 0), poptStrerror(opt));
+                poptPrintUsage(pc, stderr, 0);
+                return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    if (pc_users < 2 || pc_depth < 1 || pc_width < 1) {
+        fprintf(stderr, "At least 2 users and one level of one group "
+                        "are required\n");
+        return 1;
+    }
+
+    if (!ldb_modules_path_is_set()) {
+        fprintf(stderr, "LDB_MODULES_PATH must point to the directory of "
+                        "the memberof module\n");
+        return 1;
+    }
+
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    test_dom_suite_setup(TESTS_PATH);
+
+    tctx = create_dom_test_ctx(NULL, TESTS_PATH, TEST_CONF_DB,
+                               TEST_DOM_NAME, "local", NULL);
+    if (tctx == NULL) {
+        fprintf(stderr, "Could not create the test domain\n");
+        return 1;
+    }
+
+    printf("%d members, %d levels of %d groups\n",
+           pc_users, pc_depth, pc_width);
+    ret = run_benchmark(tctx, pc_users, pc_depth, pc_width);
+
+    talloc_free(tctx);
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+
+    return ret == EOK ? 0 : 1;
+}
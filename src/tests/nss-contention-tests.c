@@ -0,0 +1,308 @@
+/*
+   SSSD
+
+   NSS client contention benchmark
+
+   Runs the same set of lookups from an increasing number of threads of one
+   process and reports the throughput, which shows how well concurrent
+   requests of a multi-threaded process scale in the NSS client.
+
+   Copyright (C) 2016 Red Hat
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <talloc.h>
+#include <popt.h>
+#include <pthread.h>
+#include <time.h>
+#include <pwd.h>
+#include <grp.h>
+#include <errno.h>
+
+#include "util/util.h"
+#include "tests/common.h"
+
+#define DEFAULT_START       10
+#define DEFAULT_STOP        20
+#define DEFAULT_THREADS     16
+#define DEFAULT_ITERATIONS  100
+
+#define LOOKUP_BUFSIZE      16384
+
+struct worker_ctx {
+    pthread_t tid;
+    char **names;
+    int iterations;
+    int groups;
+    int offset;
+
+    int lookups;
+    int failures;
+};
+
+static int verbose;
+
+static int lookup_one(const char *name, int groups, char *buf, size_t buflen)
+{
+    struct passwd pwd;
+    struct passwd *pwd_res;
+    struct group grp;
+    struct group *grp_res;
+
+    if (groups) {
+        return getgrnam_r(name, &grp, buf, buflen, &grp_res);
+    }
+
+    return getpwnam_r(name, &pwd, buf, buflen, &pwd_res);
+}
+
+static void *worker(void *ptr)
+{
+    struct worker_ctx *wctx = talloc_get_type(ptr, struct worker_ctx);
+    char buf[LOOKUP_BUFSIZE];
+    int i;
+    int n;
+    int ret;
+
+    for (i = 0; i < wctx->iterations; i++) {
+        /* start at a different name in each thread, so the threads do not
+         * always ask for the same entry at the same time */
+        for (n = wctx->offset; wctx->names[n] != NULL; n++) {
+            ret = lookup_one(wctx->names[n], wctx->groups, buf, sizeof(buf));
+            wctx->lookups++;
+            if (ret != 0) {
+                wctx->failures++;
+            }
+        }
+        for (n = 0; n < wctx->offset; n++) {
+            ret = lookup_one(wctx->names[n], wctx->groups, buf, sizeof(buf));
+            wctx->lookups++;
+            if (ret != 0) {
+                wctx->failures++;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec)
+           + (end->tv_nsec - start->tv_nsec) / 1000000000.0;
+}
+
+static int run_round(TALLOC_CTX *mem_ctx, char **names, int num_names,
+                     int num_threads, int iterations, int groups,
+                     double *_rate)
+{
+    struct worker_ctx **workers;
+    struct timespec start;
+    struct timespec end;
+    int lookups = 0;
+    int failures = 0;
+    int started;
+    int i;
+    int ret;
+
+    workers = talloc_zero_array(mem_ctx, struct worker_ctx *, num_threads);
+    if (workers == NULL) {
+        return ENOMEM;
+    }
+
+    for (i = 0; i < num_threads; i++) {
+        workers[i] = talloc_zero(workers, struct worker_ctx);
+        if (workers[i] == NULL) {
+            talloc_free(workers);
+            return ENOMEM;
+        }
+        workers[i]->names = names;
+        workers[i]->iterations = iterations;
+        workers[i]->groups = groups;
+        workers[i]->offset = i % num_names;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (started = 0; started < num_threads; started++) {
+        ret = pthread_create(&workers[started]->tid, NULL,
+                             worker, workers[started]);
+        if (ret != 0) {
+            break;
+        }
+    }
+
+    for (i = 0; i < started; i++) {
+        pthread_join(workers[i]->tid, NULL);
+        lookups += workers[i]->lookups;
+        failures += workers[i]->failures;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    talloc_free(workers);
+
+    if (started != num_threads) {
+        return ret;
+    }
+
+    if (failures != 0 && verbose) {
+        fprintf(stderr, "%d of %d lookups failed with %d threads\n",
+                failures, lookups, num_threads);
+    }
+
+    *_rate = lookups / elapsed(&start, &end);
+    return EOK;
+}
+
+static int generate_names(TALLOC_CTX *mem_ctx, const char *prefix,
+                          int start, int stop, char ***_out)
+{
+    char **out;
+    int num_names = stop-start+1;
+    int idx = 0;
+
+    out = talloc_array(mem_ctx, char *, num_names+1);
+    if (out == NULL) {
+        return ENOMEM;
+    }
+
+    for (idx = 0; idx < num_names; ++idx) {
+        out[idx] = talloc_asprintf(mem_ctx, "%s%d", prefix, start + idx);
+        if (out[idx] == NULL) {
+            return ENOMEM;
+        }
+    }
+    out[idx] = NULL;
+
+    *_out = out;
+    return EOK;
+}
+
+int main(int argc, const char *argv[])
+{
+    int opt;
+    poptContext pc;
+    int pc_start = DEFAULT_START;
+    int pc_stop = DEFAULT_STOP;
+    int pc_threads = DEFAULT_THREADS;
+    int pc_iterations = DEFAULT_ITERATIONS;
+    int pc_groups = 0;
+    int pc_no_memcache = 0;
+    char *pc_prefix = NULL;
+    TALLOC_CTX *ctx = NULL;
+    char **names = NULL;
+    double rate;
+    double base_rate = 0;
+    int num_threads;
+    int ret;
+
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        { "groups", 'g', POPT_ARG_NONE, &pc_groups, 0,
+                    "Lookup in groups instead of users", NULL },
+        { "prefix", '\0', POPT_ARG_STRING, &pc_prefix, 0,
+                    "The username prefix", NULL },
+        { "start",  '\0', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_start, 0,
+                    "Start value to append to prefix", NULL },
+        { "stop",   '\0', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_stop, 0,
+                    "End value to append to prefix", NULL },
+        { "threads", 't', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_threads, 0,
+                    "Maximum number of concurrent threads", NULL },
+        { "iterations", 'i', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_iterations, 0,
+                    "How many times each thread looks up all names", NULL },
+        { "no-memcache", '\0', POPT_ARG_NONE, &pc_no_memcache, 0,
+                    "Bypass the memory cache so that every lookup goes "
+                    "to the responder", NULL },
+        { "verbose", 'v', POPT_ARG_NONE, 0, 'v',
+                    "Be verbose", NULL },
+        POPT_TABLEEND
+    };
+
+    /* parse the params */
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while ((opt = poptGetNextOpt(pc)) != -1) {
+        switch (opt) {
+            case 'v':
+                verbose = 1;
+                break;
+
+            default:
+                fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                        poptBadOption(pc, 0), poptStrerror(opt));
+                poptPrintUsage(pc, stderr, 0);
+                return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    if (pc_prefix == NULL || pc_stop < pc_start
+            || pc_threads < 1 || pc_iterations < 1) {
+        fprintf(stderr, "A prefix and a valid range of names, threads and "
+                        "iterations are required\n");
+        return 1;
+    }
+
+    tests_set_cwd();
+
+    if (pc_no_memcache) {
+        setenv("SSS_NSS_USE_MEMCACHE", "NO", 1);
+    }
+
+    ctx = talloc_new(NULL);
+    if (ctx == NULL) {
+        return 1;
+    }
+
+    ret = generate_names(ctx, pc_prefix, pc_start, pc_stop, &names);
+    if (ret != EOK) {
+        fprintf(stderr, "generate_names failed: %s\n", strerror(ret));
+        talloc_free(ctx);
+        return 1;
+    }
+
+    printf("%8s %16s %8s\n", "threads", "lookups/s", "speedup");
+    for (num_threads = 1; ; num_threads *= 2) {
+        if (num_threads > pc_threads) {
+            num_threads = pc_threads;
+        }
+
+        ret = run_round(ctx, names, pc_stop - pc_start + 1, num_threads,
+                        pc_iterations, pc_groups, &rate);
+        if (ret != EOK) {
+            fprintf(stderr, "Round with %d threads failed: %s\n",
+                    num_threads, strerror(ret));
+            talloc_free(ctx);
+            return 1;
+        }
+
+        if (base_rate == 0) {
+            base_rate = rate;
+        }
+        printf("%8d %16.0f %7.2fx\n", num_threads, rate, rate / base_rate);
+
+        if (num_threads == pc_threads) {
+            break;
+        }
+    }
+
+    talloc_free(ctx);
+    return 0;
+}
@@ -23,6 +23,10 @@
 */
 
 #include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <check.h>
 #include <talloc.h>
 #include <tevent.h>
@@ -414,6 +418,382 @@ START_TEST(test_sbus_new_error)
 }
 END_TEST
 
+/* Framed connections */
+
+struct frame_call_state {
+    bool done;
+    errno_t error;
+    DBusMessage *reply;
+};
+
+static void frame_call_done(DBusMessage *reply, errno_t error, void *pvt)
+{
+    struct frame_call_state *state = pvt;
+
+    state->done = true;
+    state->error = error;
+    if (reply != NULL) {
+        state->reply = dbus_message_ref(reply);
+    }
+}
+
+static DBusMessage *frame_call_sync(struct tevent_context *ev,
+                                    struct sbus_connection *conn,
+                                    const char *object_path,
+                                    const char *method,
+                                    int first_arg_type,
+                                    ...)
+{
+    struct frame_call_state state = { false, EOK, NULL };
+    DBusMessage *message;
+    va_list va;
+    int ret;
+
+    message = dbus_message_new_method_call(NULL, object_path,
+                                           PILOT_IFACE, method);
+    ck_assert(message != NULL);
+
+    va_start(va, first_arg_type);
+    ck_assert(dbus_message_append_args_valist(message, first_arg_type, va));
+    va_end(va);
+
+    ret = sbus_frame_send(conn, conn, message, 5000,
+                          frame_call_done, &state, NULL);
+    ck_assert_int_eq(ret, EOK);
+    dbus_message_unref(message);
+
+    while (!state.done) {
+        ck_assert_int_eq(tevent_loop_once(ev), 0);
+    }
+
+    ck_assert_int_eq(state.error, EOK);
+    ck_assert(state.reply != NULL);
+
+    return state.reply;
+}
+
+/* Runs the pilot interface on a framed connection in a child process, like
+ * test_dbus_setup_mock() does for D-Bus */
+static pid_t frame_setup_mock(TALLOC_CTX *mem_ctx,
+                              struct tevent_context *ev,
+                              struct sbus_connection **_client)
+{
+    struct tevent_context *child_ev;
+    struct sbus_connection *server;
+    int fds[2];
+    pid_t pid;
+    int ret;
+
+    ck_assert_int_eq(socketpair(PF_LOCAL, SOCK_STREAM, 0, fds), 0);
+
+    pid = fork();
+    ck_assert(pid != -1);
+    if (pid == 0) {
+        close(fds[0]);
+
+        child_ev = tevent_context_init(NULL);
+        if (child_ev == NULL) {
+            _exit(1);
+        }
+
+        ret = sbus_frame_init_connection(child_ev, child_ev, fds[1], &server);
+        if (ret != EOK) {
+            _exit(1);
+        }
+        pilot_test_server_init(server, NULL);
+
+        /* returns when the parent closes its end */
+        tevent_loop_wait(child_ev);
+        _exit(0);
+    }
+
+    close(fds[1]);
+
+    ret = sbus_frame_init_connection(mem_ctx, ev, fds[0], _client);
+    ck_assert_int_eq(ret, EOK);
+
+    return pid;
+}
+
+static void frame_teardown_mock(struct sbus_connection *client, pid_t pid)
+{
+    int status;
+
+    talloc_free(client);
+    ck_assert_int_eq(waitpid(pid, &status, 0), pid);
+    ck_assert(WIFEXITED(status));
+    ck_assert_int_eq(WEXITSTATUS(status), 0);
+}
+
+START_TEST(test_frame_handler)
+{
+    const char *args[] = { "one", "two", "three" };
+    const char **array;
+    struct tevent_context *ev;
+    struct sbus_connection *client;
+    DBusMessage *reply;
+    dbus_bool_t crashed;
+    dbus_bool_t boolean;
+    dbus_int32_t duration;
+    dbus_int32_t integer;
+    pid_t pid;
+
+    ev = tevent_context_init(NULL);
+    ck_assert(ev != NULL);
+    pid = frame_setup_mock(ev, ev, &client);
+
+    /* Leela crashes with a duration higher than 5 */
+    duration = 10;
+    reply = frame_call_sync(ev, client, "/test/leela", PILOT_BLINK,
+                            DBUS_TYPE_INT32, &duration,
+                            DBUS_TYPE_INVALID);
+    ck_assert_int_eq(dbus_message_get_type(reply),
+                     DBUS_MESSAGE_TYPE_METHOD_RETURN);
+    ck_assert(dbus_message_get_args(reply, NULL,
+                                    DBUS_TYPE_BOOLEAN, &crashed,
+                                    DBUS_TYPE_INVALID));
+    dbus_message_unref(reply);
+    ck_assert(crashed == true);
+
+    /* Fry doesn't crash with a duration lower than 5 */
+    duration = 1;
+    reply = frame_call_sync(ev, client, "/test/fry", PILOT_BLINK,
+                            DBUS_TYPE_INT32, &duration,
+                            DBUS_TYPE_INVALID);
+    ck_assert(dbus_message_get_args(reply, NULL,
+                                    DBUS_TYPE_BOOLEAN, &crashed,
+                                    DBUS_TYPE_INVALID));
+    dbus_message_unref(reply);
+    ck_assert(crashed == FALSE);
+
+    /* String arrays go through unchanged */
+    boolean = TRUE;
+    integer = 5;
+    array = args;
+    reply = frame_call_sync(ev, client, "/test/leela", PILOT_EAT,
+                            DBUS_TYPE_INT32, &integer,
+                            DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &array, 3,
+                            DBUS_TYPE_BOOLEAN, &boolean,
+                            DBUS_TYPE_INVALID);
+    ck_assert_int_eq(dbus_message_get_type(reply),
+                     DBUS_MESSAGE_TYPE_METHOD_RETURN);
+    dbus_message_unref(reply);
+
+    /* Errors are replies too */
+    reply = frame_call_sync(ev, client, "/test/leela", PILOT_EAT,
+                            DBUS_TYPE_INVALID);
+    ck_assert_int_eq(dbus_message_get_type(reply), DBUS_MESSAGE_TYPE_ERROR);
+    ck_assert_str_eq(dbus_message_get_error_name(reply),
+                     DBUS_ERROR_INVALID_ARGS);
+    dbus_message_unref(reply);
+
+    reply = frame_call_sync(ev, client, "/test/bender", PILOT_BLINK,
+                            DBUS_TYPE_INVALID);
+    ck_assert_int_eq(dbus_message_get_type(reply), DBUS_MESSAGE_TYPE_ERROR);
+    ck_assert_str_eq(dbus_message_get_error_name(reply),
+                     DBUS_ERROR_UNKNOWN_METHOD);
+    dbus_message_unref(reply);
+
+    frame_teardown_mock(client, pid);
+    talloc_free(ev);
+}
+END_TEST
+
+START_TEST(test_frame_disconnect)
+{
+    struct frame_call_state state = { false, EOK, NULL };
+    struct tevent_context *ev;
+    struct sbus_connection *client;
+    DBusMessage *message;
+    dbus_int32_t duration = 1;
+    int fds[2];
+    int ret;
+
+    ev = tevent_context_init(NULL);
+    ck_assert(ev != NULL);
+
+    ck_assert_int_eq(socketpair(PF_LOCAL, SOCK_STREAM, 0, fds), 0);
+    ret = sbus_frame_init_connection(ev, ev, fds[0], &client);
+    ck_assert_int_eq(ret, EOK);
+
+    message = dbus_message_new_method_call(NULL, "/test/leela",
+                                           PILOT_IFACE, PILOT_BLINK);
+    ck_assert(message != NULL);
+    ck_assert(dbus_message_append_args(message,
+                                       DBUS_TYPE_INT32, &duration,
+                                       DBUS_TYPE_INVALID));
+
+    ret = sbus_frame_send(ev, client, message, 5000,
+                          frame_call_done, &state, NULL);
+    ck_assert_int_eq(ret, EOK);
+    dbus_message_unref(message);
+
+    /* the peer goes away without answering */
+    close(fds[1]);
+
+    while (!state.done) {
+        ck_assert_int_eq(tevent_loop_once(ev), 0);
+    }
+
+    ck_assert_int_eq(state.error, EIO);
+    ck_assert(state.reply == NULL);
+    ck_assert(sbus_conn_disconnecting(client));
+
+    talloc_free(ev);
+}
+END_TEST
+
+#define BATCH_CALLS 200
+
+/* Queues many calls at once on a socket with a small send buffer, so the
+ * frames are written in batches and cut at arbitrary places */
+START_TEST(test_frame_partial_writes)
+{
+    const char *args[] = { "one", "two", "three" };
+    const char **array = args;
+    dbus_bool_t boolean = TRUE;
+    dbus_int32_t integer = 5;
+    struct frame_call_state state[BATCH_CALLS];
+    struct tevent_context *ev;
+    struct sbus_connection *client;
+    struct sbus_connection *server;
+    DBusMessage *message;
+    int sndbuf = 1024;
+    int fds[2];
+    int done;
+    int ret;
+    int i;
+
+    ev = tevent_context_init(NULL);
+    ck_assert(ev != NULL);
+
+    ck_assert_int_eq(socketpair(PF_LOCAL, SOCK_STREAM, 0, fds), 0);
+    ck_assert_int_eq(setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF,
+                                &sndbuf, sizeof(sndbuf)), 0);
+    ck_assert_int_eq(setsockopt(fds[1], SOL_SOCKET, SO_SNDBUF,
+                                &sndbuf, sizeof(sndbuf)), 0);
+
+    ret = sbus_frame_init_connection(ev, ev, fds[0], &client);
+    ck_assert_int_eq(ret, EOK);
+    ret = sbus_frame_init_connection(ev, ev, fds[1], &server);
+    ck_assert_int_eq(ret, EOK);
+    pilot_test_server_init(server, NULL);
+
+    memset(state, 0, sizeof(state));
+    for (i = 0; i < BATCH_CALLS; i++) {
+        message = dbus_message_new_method_call(NULL, "/test/leela",
+                                               PILOT_IFACE, PILOT_EAT);
+        ck_assert(message != NULL);
+        ck_assert(dbus_message_append_args(message,
+                                           DBUS_TYPE_INT32, &integer,
+                                           DBUS_TYPE_ARRAY, DBUS_TYPE_STRING,
+                                           &array, 3,
+                                           DBUS_TYPE_BOOLEAN, &boolean,
+                                           DBUS_TYPE_INVALID));
+
+        ret = sbus_frame_send(ev, client, message, 5000,
+                              frame_call_done, &state[i], NULL);
+        ck_assert_int_eq(ret, EOK);
+        dbus_message_unref(message);
+    }
+
+    do {
+        ck_assert_int_eq(tevent_loop_once(ev), 0);
+
+        done = 0;
+        for (i = 0; i < BATCH_CALLS; i++) {
+            if (state[i].done) {
+                done++;
+            }
+        }
+    } while (done < BATCH_CALLS);
+
+    for (i = 0; i < BATCH_CALLS; i++) {
+        ck_assert_int_eq(state[i].error, EOK);
+        ck_assert(state[i].reply != NULL);
+        ck_assert_int_eq(dbus_message_get_type(state[i].reply),
+                         DBUS_MESSAGE_TYPE_METHOD_RETURN);
+        dbus_message_unref(state[i].reply);
+    }
+
+    talloc_free(ev);
+}
+END_TEST
+
+#define BENCHMARK_CALLS 10000
+
+static double elapsed_usec(struct timeval *start)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start->tv_sec) * 1000000.0
+           + (now.tv_usec - start->tv_usec);
+}
+
+/* Compares the round trip of a method call over D-Bus and over a framed
+ * connection. Only run with --benchmark. */
+START_TEST(test_frame_benchmark)
+{
+    const char *args[] = { "one", "two", "three" };
+    const char **array = args;
+    dbus_bool_t boolean = TRUE;
+    dbus_int32_t integer = 5;
+    TALLOC_CTX *ctx;
+    struct tevent_context *ev;
+    DBusConnection *dbus_client;
+    struct sbus_connection *frame_client;
+    DBusError error = DBUS_ERROR_INIT;
+    DBusMessage *reply;
+    struct timeval start;
+    double dbus_usec;
+    double frame_usec;
+    pid_t pid;
+    int i;
+
+    ctx = talloc_new(NULL);
+    dbus_client = test_dbus_setup_mock(ctx, NULL, pilot_test_server_init, NULL);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < BENCHMARK_CALLS; i++) {
+        reply = test_dbus_call_sync(dbus_client, "/test/leela",
+                                    PILOT_IFACE, PILOT_EAT, &error,
+                                    DBUS_TYPE_INT32, &integer,
+                                    DBUS_TYPE_ARRAY, DBUS_TYPE_STRING,
+                                    &array, 3,
+                                    DBUS_TYPE_BOOLEAN, &boolean,
+                                    DBUS_TYPE_INVALID);
+        ck_assert(reply != NULL);
+        dbus_message_unref(reply);
+    }
+    dbus_usec = elapsed_usec(&start);
+
+    talloc_free(ctx);
+
+    ev = tevent_context_init(NULL);
+    ck_assert(ev != NULL);
+    pid = frame_setup_mock(ev, ev, &frame_client);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < BENCHMARK_CALLS; i++) {
+        reply = frame_call_sync(ev, frame_client, "/test/leela", PILOT_EAT,
+                                DBUS_TYPE_INT32, &integer,
+                                DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &array, 3,
+                                DBUS_TYPE_BOOLEAN, &boolean,
+                                DBUS_TYPE_INVALID);
+        dbus_message_unref(reply);
+    }
+    frame_usec = elapsed_usec(&start);
+
+    frame_teardown_mock(frame_client, pid);
+    talloc_free(ev);
+
+    printf("%d calls: D-Bus %.1f us per call, framed %.1f us per call\n",
+           BENCHMARK_CALLS, dbus_usec / BENCHMARK_CALLS,
+           frame_usec / BENCHMARK_CALLS);
+}
+END_TEST
+
 TCase *create_sbus_tests(void)
 {
     TCase *tc = tcase_create("tests");
@@ -424,14 +804,29 @@ TCase *create_sbus_tests(void)
     tcase_add_test(tc, test_request_dontcrash);
     tcase_add_test(tc, test_introspection);
     tcase_add_test(tc, test_sbus_new_error);
+    tcase_add_test(tc, test_frame_handler);
+    tcase_add_test(tc, test_frame_disconnect);
+    tcase_add_test(tc, test_frame_partial_writes);
 
     return tc;
 }
 
-Suite *create_suite(void)
+TCase *create_sbus_benchmarks(void)
+{
+    TCase *tc = tcase_create("benchmarks");
+
+    tcase_add_test(tc, test_frame_benchmark);
+
+    return tc;
+}
+
+Suite *create_suite(bool benchmark)
 {
     Suite *s = suite_create("sbus");
     suite_add_tcase(s, create_sbus_tests());
+    if (benchmark) {
+        suite_add_tcase(s, create_sbus_benchmarks());
+    }
     return s;
 }
 
@@ -440,11 +835,14 @@ int main(int argc, const char *argv[])
     int opt;
     poptContext pc;
     int failure_count;
+    int benchmark = 0;
     Suite *suite;
     SRunner *sr;
 
     struct poptOption long_options[] = {
         POPT_AUTOHELP
+        { "benchmark", 0, POPT_ARG_NONE, &benchmark, 0,
+          "Compare the latency of D-Bus and framed connections", NULL },
         POPT_TABLEEND
     };
 
@@ -460,7 +858,7 @@ int main(int argc, const char *argv[])
     }
     poptFreeContext(pc);
 
-    suite = create_suite();
+    suite = create_suite(benchmark);
     sr = srunner_create(suite);
     /* If CK_VERBOSITY is set, use that, otherwise it defaults to CK_NORMAL */
     srunner_run_all(sr, CK_ENV);
@@ -644,6 +644,154 @@ START_TEST (test_sysdb_store_user_existing)
 }
 END_TEST
 
+#define BATCH_USER_BASE 29500
+#define BATCH_GROUP_BASE 29600
+#define BATCH_NUM_USERS 150
+
+static struct sysdb_attrs *
+batch_member_attrs(struct sysdb_test_ctx *test_ctx,
+                   struct sysdb_user_batch_entry *users, int num_users)
+{
+    struct sysdb_attrs *attrs;
+    char *member;
+    int ret;
+    int i;
+
+    attrs = sysdb_new_attrs(test_ctx);
+    fail_unless(attrs != NULL, "sysdb_new_attrs failed");
+    for (i = 0; i < num_users; i++) {
+        member = sysdb_user_strdn(attrs, test_ctx->domain->name,
+                                  users[i].name);
+        fail_unless(member != NULL, "sysdb_user_strdn failed");
+        ret = sysdb_attrs_steal_string(attrs, SYSDB_MEMBER, member);
+        fail_unless(ret == EOK, "sysdb_attrs_steal_string failed");
+    }
+
+    return attrs;
+}
+
+START_TEST (test_sysdb_store_batch)
+{
+    struct sysdb_test_ctx *test_ctx;
+    struct sysdb_user_batch_entry *users;
+    struct sysdb_group_batch_entry groups[2];
+    struct ldb_message *msg;
+    struct ldb_message_element *el;
+    const char *attrlist[] = { SYSDB_SHELL, SYSDB_MEMBERUID, NULL };
+    const char *shell;
+    int ret;
+    int i;
+
+    /* Setup */
+    ret = setup_sysdb_tests(&test_ctx);
+    if (ret != EOK) {
+        fail("Could not set up the test");
+        return;
+    }
+
+    /* the first user is already cached and gets updated by the batch */
+    ret = sysdb_store_user(test_ctx->domain, "batchuser0", "x",
+                           BATCH_USER_BASE, 0, "batchuser0", "/home/batch",
+                           "/bin/sh", NULL, NULL, NULL, -1, 0);
+    fail_unless(ret == EOK, "Could not store user batchuser0");
+
+    /* more users than fit into one search and the last one twice */
+    users = talloc_zero_array(test_ctx, struct sysdb_user_batch_entry,
+                              BATCH_NUM_USERS + 1);
+    fail_unless(users != NULL, "talloc_zero_array failed");
+    for (i = 0; i < BATCH_NUM_USERS + 1; i++) {
+        users[i].domain = test_ctx->domain;
+        users[i].name = talloc_asprintf(users, "batchuser%d",
+                                        i < BATCH_NUM_USERS ?
+                                            i : BATCH_NUM_USERS - 1);
+        fail_unless(users[i].name != NULL, "talloc_asprintf failed");
+        users[i].uid = BATCH_USER_BASE + (i < BATCH_NUM_USERS ?
+                                              i : BATCH_NUM_USERS - 1);
+        users[i].gecos = users[i].name;
+        users[i].homedir = "/home/batch";
+        users[i].shell = "/bin/bash";
+        users[i].cache_timeout = -1;
+        users[i].ret = EINVAL;
+    }
+
+    ret = sysdb_store_users_batch(test_ctx->sysdb, users,
+                                  BATCH_NUM_USERS + 1, 0);
+    fail_unless(ret == EOK, "sysdb_store_users_batch failed [%d]", ret);
+    for (i = 0; i < BATCH_NUM_USERS + 1; i++) {
+        fail_unless(users[i].ret == EOK, "Could not store user %s [%d]",
+                    users[i].name, users[i].ret);
+    }
+
+    for (i = 0; i < BATCH_NUM_USERS; i++) {
+        ret = sysdb_search_user_by_name(test_ctx, test_ctx->domain,
+                                        users[i].name, attrlist, &msg);
+        fail_unless(ret == EOK, "Could not find user %s", users[i].name);
+        shell = ldb_msg_find_attr_as_string(msg, SYSDB_SHELL, NULL);
+        fail_unless(shell != NULL && strcmp(shell, "/bin/bash") == 0,
+                    "Wrong shell of user %s", users[i].name);
+    }
+
+    /* a new group with all users and a group without members */
+    memset(groups, 0, sizeof(groups));
+    groups[0].domain = test_ctx->domain;
+    groups[0].name = "batchgroup0";
+    groups[0].gid = BATCH_GROUP_BASE;
+    groups[0].attrs = batch_member_attrs(test_ctx, users, BATCH_NUM_USERS);
+    groups[0].cache_timeout = -1;
+    groups[1].domain = test_ctx->domain;
+    groups[1].name = "batchgroup1";
+    groups[1].gid = BATCH_GROUP_BASE + 1;
+    groups[1].cache_timeout = -1;
+
+    ret = sysdb_store_groups_batch(test_ctx->sysdb, groups, 2, 0);
+    fail_unless(ret == EOK, "sysdb_store_groups_batch failed [%d]", ret);
+    fail_unless(groups[0].ret == EOK, "Could not store batchgroup0");
+    fail_unless(groups[1].ret == EOK, "Could not store batchgroup1");
+
+    /* storing the same members again keeps them */
+    groups[0].attrs = batch_member_attrs(test_ctx, users, BATCH_NUM_USERS);
+    groups[1].attrs = NULL;
+    ret = sysdb_store_groups_batch(test_ctx->sysdb, groups, 2, 0);
+    fail_unless(ret == EOK, "sysdb_store_groups_batch failed [%d]", ret);
+    fail_unless(groups[0].ret == EOK, "Could not update batchgroup0");
+
+    ret = sysdb_search_group_by_gid(test_ctx, test_ctx->domain,
+                                    BATCH_GROUP_BASE, attrlist, &msg);
+    fail_unless(ret == EOK, "Could not find group batchgroup0");
+    el = ldb_msg_find_element(msg, SYSDB_MEMBERUID);
+    fail_unless(el != NULL && el->num_values == BATCH_NUM_USERS,
+                "Wrong number of memberuid values in batchgroup0");
+
+    /* a changed member list replaces the cached one */
+    groups[0].attrs = batch_member_attrs(test_ctx, users, 1);
+
+    ret = sysdb_store_groups_batch(test_ctx->sysdb, groups, 1, 0);
+    fail_unless(ret == EOK, "sysdb_store_groups_batch failed [%d]", ret);
+    fail_unless(groups[0].ret == EOK, "Could not update batchgroup0");
+
+    ret = sysdb_search_group_by_gid(test_ctx, test_ctx->domain,
+                                    BATCH_GROUP_BASE, attrlist, &msg);
+    fail_unless(ret == EOK, "Could not find group batchgroup0");
+    el = ldb_msg_find_element(msg, SYSDB_MEMBERUID);
+    fail_unless(el != NULL && el->num_values == 1,
+                "Wrong number of memberuid values in batchgroup0");
+
+    /* cleanup */
+    for (i = 0; i < 2; i++) {
+        ret = sysdb_delete_group(test_ctx->domain, NULL, BATCH_GROUP_BASE + i);
+        fail_unless(ret == EOK, "Could not delete group %d",
+                    BATCH_GROUP_BASE + i);
+    }
+    for (i = 0; i < BATCH_NUM_USERS; i++) {
+        ret = sysdb_delete_user(test_ctx->domain, NULL, BATCH_USER_BASE + i);
+        fail_unless(ret == EOK, "Could not delete user %d",
+                    BATCH_USER_BASE + i);
+    }
+
+    talloc_free(test_ctx);
+}
+END_TEST
+
 START_TEST (test_sysdb_store_group)
 {
     struct sysdb_test_ctx *test_ctx;
@@ -2987,6 +3135,128 @@ START_TEST (test_sysdb_memberof_check_memberuid_loop_without_group_5)
 }
 END_TEST
 
+#define MBO_LARGE_USER_BASE (MBO_USER_BASE + 100)
+#define MBO_LARGE_NUM_USERS 500
+
+START_TEST (test_sysdb_memberof_large_group)
+{
+    struct sysdb_test_ctx *test_ctx;
+    struct sysdb_attrs *attrs;
+    struct ldb_message *msg;
+    struct ldb_message_element *el;
+    const char *attrlist[] = { SYSDB_MEMBEROF, SYSDB_MEMBERUID, NULL };
+    const char *parent_name = "largeparent";
+    const char *child_name = "largechild";
+    gid_t parent_gid = MBO_GROUP_BASE + 100;
+    gid_t child_gid = MBO_GROUP_BASE + 101;
+    char *username;
+    char *member;
+    int ret;
+    int i;
+
+    /* Setup */
+    ret = setup_sysdb_tests(&test_ctx);
+    if (ret != EOK) {
+        fail("Could not set up the test");
+        return;
+    }
+
+    ret = sysdb_transaction_start(test_ctx->sysdb);
+    fail_unless(ret == EOK, "sysdb_transaction_start failed [%d]", ret);
+
+    /* largechild is a member of largeparent */
+    ret = sysdb_store_group(test_ctx->domain, child_name, child_gid,
+                            NULL, -1, 0);
+    fail_unless(ret == EOK, "Could not store group %s", child_name);
+
+    attrs = sysdb_new_attrs(test_ctx);
+    fail_unless(attrs != NULL, "sysdb_new_attrs failed");
+    member = sysdb_group_strdn(attrs, test_ctx->domain->name, child_name);
+    fail_unless(member != NULL, "sysdb_group_strdn failed");
+    ret = sysdb_attrs_steal_string(attrs, SYSDB_MEMBER, member);
+    fail_unless(ret == EOK, "sysdb_attrs_steal_string failed");
+    ret = sysdb_store_group(test_ctx->domain, parent_name, parent_gid,
+                            attrs, -1, 0);
+    fail_unless(ret == EOK, "Could not store group %s", parent_name);
+
+    /* add all users to the child group with a single modification */
+    attrs = sysdb_new_attrs(test_ctx);
+    fail_unless(attrs != NULL, "sysdb_new_attrs failed");
+    for (i = 0; i < MBO_LARGE_NUM_USERS; i++) {
+        username = talloc_asprintf(test_ctx, "largeuser%d", i);
+        fail_unless(username != NULL, "talloc_asprintf failed");
+
+        ret = sysdb_store_user(test_ctx->domain, username, "x",
+                               MBO_LARGE_USER_BASE + i, 0, username,
+                               "/home/largeuser", "/bin/bash",
+                               NULL, NULL, NULL, -1, 0);
+        fail_unless(ret == EOK, "Could not store user %s", username);
+
+        member = sysdb_user_strdn(attrs, test_ctx->domain->name, username);
+        fail_unless(member != NULL, "sysdb_user_strdn failed");
+        ret = sysdb_attrs_steal_string(attrs, SYSDB_MEMBER, member);
+        fail_unless(ret == EOK, "sysdb_attrs_steal_string failed");
+    }
+
+    ret = sysdb_store_group(test_ctx->domain, child_name, child_gid,
+                            attrs, -1, 0);
+    fail_unless(ret == EOK, "Could not add members to %s", child_name);
+
+    /* both groups list every user exactly once */
+    ret = sysdb_search_group_by_gid(test_ctx, test_ctx->domain, child_gid,
+                                    attrlist, &msg);
+    fail_unless(ret == EOK, "Could not find group %s", child_name);
+    el = ldb_msg_find_element(msg, SYSDB_MEMBERUID);
+    fail_unless(el != NULL && el->num_values == MBO_LARGE_NUM_USERS,
+                "Wrong number of memberuid values in %s", child_name);
+
+    ret = sysdb_search_group_by_gid(test_ctx, test_ctx->domain, parent_gid,
+                                    attrlist, &msg);
+    fail_unless(ret == EOK, "Could not find group %s", parent_name);
+    el = ldb_msg_find_element(msg, SYSDB_MEMBERUID);
+    fail_unless(el != NULL && el->num_values == MBO_LARGE_NUM_USERS,
+                "Wrong number of memberuid values in %s", parent_name);
+
+    ret = sysdb_search_user_by_name(test_ctx, test_ctx->domain,
+                                    "largeuser0", attrlist, &msg);
+    fail_unless(ret == EOK, "Could not find user largeuser0");
+    el = ldb_msg_find_element(msg, SYSDB_MEMBEROF);
+    fail_unless(el != NULL && el->num_values == 2,
+                "Wrong number of memberof values in largeuser0");
+
+    /* removing the child group removes the users from the parent */
+    ret = sysdb_delete_group(test_ctx->domain, child_name, child_gid);
+    fail_unless(ret == EOK, "Could not delete group %s", child_name);
+
+    ret = sysdb_search_group_by_gid(test_ctx, test_ctx->domain, parent_gid,
+                                    attrlist, &msg);
+    fail_unless(ret == EOK, "Could not find group %s", parent_name);
+    fail_unless(ldb_msg_find_element(msg, SYSDB_MEMBERUID) == NULL,
+                "Group %s still has memberuid values", parent_name);
+
+    ret = sysdb_search_user_by_name(test_ctx, test_ctx->domain,
+                                    "largeuser0", attrlist, &msg);
+    fail_unless(ret == EOK, "Could not find user largeuser0");
+    fail_unless(ldb_msg_find_element(msg, SYSDB_MEMBEROF) == NULL,
+                "User largeuser0 is still a member of a group");
+
+    /* cleanup */
+    ret = sysdb_delete_group(test_ctx->domain, parent_name, parent_gid);
+    fail_unless(ret == EOK, "Could not delete group %s", parent_name);
+    for (i = 0; i < MBO_LARGE_NUM_USERS; i++) {
+        ret = sysdb_delete_user(test_ctx->domain, NULL,
+                                MBO_LARGE_USER_BASE + i);
+        fail_unless(ret == EOK, "Could not delete user %d",
+                    MBO_LARGE_USER_BASE + i);
+    }
+
+    ret = sysdb_transaction_commit(test_ctx->sysdb);
+    fail_unless(ret == EOK, "sysdb_transaction_commit failed [%d]", ret);
+
+    talloc_free(test_ctx);
+}
+END_TEST
+
 START_TEST (test_sysdb_memberof_check_nested_ghosts)
 {
     struct sysdb_test_ctx *test_ctx;
@@ -6432,6 +6702,9 @@ Suite *create_sysdb_suite(void)
     /* Verify the users can be queried by UID */
     tcase_add_loop_test(tc_sysdb, test_sysdb_getpwuid, 27010, 27020);
 
+    /* Store users and groups in batches */
+    tcase_add_test(tc_sysdb, test_sysdb_store_batch);
+
     /* Enumerate the users */
     tcase_add_test(tc_sysdb, test_sysdb_enumpwent);
 
@@ -6720,6 +6993,8 @@ Suite *create_sysdb_suite(void)
     tcase_add_loop_test(tc_memberof, test_sysdb_remove_local_group_by_gid,
                         MBO_GROUP_BASE , MBO_GROUP_BASE + 10);
 
+    tcase_add_test(tc_memberof, test_sysdb_memberof_large_group);
+
     suite_add_tcase(s, tc_memberof);
 
     TCase *tc_subdomain = tcase_create("SYSDB sub-domain Tests");
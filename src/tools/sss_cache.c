@@ -99,6 +99,8 @@ struct cache_tool_ctx {
     bool update_service_filter;
     bool update_autofs_filter;
     bool update_ssh_host_filter;
+
+    bool show_stats;
 };
 
 errno_t init_domains(struct cache_tool_ctx *ctx, const char *domain);
@@ -128,6 +130,11 @@ int main(int argc, const char *argv[])
         goto done;
     }
 
+    if (tctx->show_stats) {
+        ret = sss_memcache_print_stats();
+        goto done;
+    }
+
     for (dinfo = tctx->domains; dinfo;
             dinfo = get_next_domain(dinfo, SSS_GND_DESCEND)) {
         if (!IS_SUBDOMAIN(dinfo)) {
@@ -578,6 +585,7 @@ errno_t init_context(int argc, const char *argv[], struct cache_tool_ctx **tctx)
     char *map = NULL;
     char *ssh_host = NULL;
     char *domain = NULL;
+    int stats = 0;
     int debug = SSSDBG_DEFAULT;
     errno_t ret = EOK;
 
@@ -618,6 +626,8 @@ errno_t init_context(int argc, const char *argv[], struct cache_tool_ctx **tctx)
 #endif /* BUILD_SSH */
         { "domain", 'd', POPT_ARG_STRING, &domain, 0,
             _("Only invalidate entries from a particular domain"), NULL },
+        { "stats", '\0', POPT_ARG_NONE, &stats, 0,
+            _("Print the memory cache lookup statistics"), NULL },
         POPT_TABLEEND
     };
 
@@ -663,6 +673,18 @@ errno_t init_context(int argc, const char *argv[], struct cache_tool_ctx **tctx)
         BAD_POPT_PARAMS(pc, poptStrerror(ret), ret, fini);
     }
 
+    if (stats) {
+        /* the statistics are readable by everyone, no root needed */
+        ctx = talloc_zero(NULL, struct cache_tool_ctx);
+        if (ctx == NULL) {
+            ret = ENOMEM;
+            goto fini;
+        }
+        ctx->show_stats = true;
+        ret = EOK;
+        goto fini;
+    }
+
     if (idb == INVALIDATE_NONE && !user && !group &&
         !netgroup && !service && !map && !ssh_host) {
         BAD_POPT_PARAMS(pc,
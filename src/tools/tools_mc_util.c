@@ -158,6 +158,42 @@ static int clear_fastcache(bool *sssd_nss_is_off)
             return ret;
         }
     }
+    ret = sss_memcache_invalidate(SSS_NSS_MCACHE_DIR"/netgroup");
+    if (ret != EOK) {
+        if (ret == EACCES) {
+            *sssd_nss_is_off = false;
+            return EOK;
+        } else {
+            return ret;
+        }
+    }
+    ret = sss_memcache_invalidate(SSS_NSS_MCACHE_DIR"/services");
+    if (ret != EOK) {
+        if (ret == EACCES) {
+            *sssd_nss_is_off = false;
+            return EOK;
+        } else {
+            return ret;
+        }
+    }
+    ret = sss_memcache_invalidate(SSS_NSS_MCACHE_DIR"/sid");
+    if (ret != EOK) {
+        if (ret == EACCES) {
+            *sssd_nss_is_off = false;
+            return EOK;
+        } else {
+            return ret;
+        }
+    }
+    ret = sss_memcache_invalidate(SSS_NSS_MCACHE_DIR"/negative");
+    if (ret != EOK) {
+        if (ret == EACCES) {
+            *sssd_nss_is_off = false;
+            return EOK;
+        } else {
+            return ret;
+        }
+    }
 
     *sssd_nss_is_off = true;
     return EOK;
@@ -371,3 +407,80 @@ errno_t sss_mc_refresh_grouplist(struct tools_ctx *tctx,
 
     return failed ? EIO : EOK;
 }
+
+errno_t sss_memcache_print_stats(void)
+{
+    const char *names[] = SSS_MC_STATS_NAMES;
+    const char *buckets[] = { "0", "1", "2", "3",
+                              "4-7", "8-15", "16-31", "32+" };
+    struct sss_mc_stats stats;
+    struct sss_mc_stats_counters *c;
+    uint64_t lookups;
+    time_t created;
+    ssize_t len;
+    errno_t ret;
+    int fd;
+    int i;
+    int j;
+
+    fd = open(SSS_NSS_MCACHE_DIR"/"SSS_MC_STATS_FILE, O_RDONLY);
+    if (fd == -1) {
+        ret = errno;
+        if (ret == ENOENT) {
+            ERROR("Memory cache statistics are not enabled, set "
+                  "memcache_stats = true in the [nss] section\n");
+        } else {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Unable to open statistics: %s\n",
+                  sss_strerror(ret));
+        }
+        return ret;
+    }
+
+    errno = 0;
+    len = sss_atomic_read_s(fd, &stats, sizeof(stats));
+    ret = errno;
+    close(fd);
+    if (len == -1) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to read statistics: %s\n",
+              sss_strerror(ret));
+        return ret;
+    }
+
+    if (len != sizeof(stats)
+            || stats.magic != SSS_MC_STATS_MAGIC
+            || stats.vno != SSS_MC_STATS_VNO
+            || stats.num_caches != SSS_MC_STATS_NUM) {
+        ERROR("The memory cache statistics file is not valid\n");
+        return EINVAL;
+    }
+
+    created = stats.created;
+    /* ctime() output ends with a newline */
+    printf(_("Memory cache statistics since %s"), ctime(&created));
+
+    printf("%-12s %14s %14s %14s %14s %7s\n", _("Cache"), _("Hits"),
+           _("Misses"), _("Expired"), _("Retries"), _("Hit %"));
+    for (i = 0; i < SSS_MC_STATS_NUM; i++) {
+        c = &stats.caches[i];
+        lookups = c->hits + c->misses + c->expired;
+        printf("%-12s %14"PRIu64" %14"PRIu64" %14"PRIu64" %14"PRIu64
+               " %6.1f%%\n", names[i], c->hits, c->misses, c->expired, c->retries,
+               lookups == 0 ? 0.0 : 100.0 * c->hits / lookups);
+    }
+
+    printf(_("\nHash chain length per lookup\n"));
+    printf("%-12s", _("Cache"));
+    for (j = 0; j < SSS_MC_STATS_CHAIN_BUCKETS; j++) {
+        printf(" %9s", buckets[j]);
+    }
+    printf("\n");
+    for (i = 0; i < SSS_MC_STATS_NUM; i++) {
+        printf("%-12s", names[i]);
+        for (j = 0; j < SSS_MC_STATS_CHAIN_BUCKETS; j++) {
+            printf(" %9"PRIu64, stats.caches[i].chain_len[j]);
+        }
+        printf("\n");
+    }
+
+    return EOK;
+}
@@ -109,6 +109,8 @@ errno_t sss_memcache_invalidate(const char *mc_filename);
 
 errno_t sss_memcache_clear_all(void);
 
+errno_t sss_memcache_print_stats(void);
+
 errno_t sss_mc_refresh_user(const char *username);
 errno_t sss_mc_refresh_group(const char *groupname);
 errno_t sss_mc_refresh_grouplist(struct tools_ctx *tctx,
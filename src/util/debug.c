@@ -25,6 +25,8 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -43,9 +45,43 @@ int debug_timestamps = SSSDBG_TIMESTAMP_UNRESOLVED;
 int debug_microseconds = SSSDBG_MICROSECONDS_UNRESOLVED;
 int debug_to_file = 0;
 int debug_to_stderr = 0;
+int debug_trace_level = 0;
 const char *debug_log_file = "sssd";
 FILE *debug_file = NULL;
 
+/* Messages that write out everything buffered so far */
+#define DEBUG_FLUSH_LEVELS (SSSDBG_FATAL_FAILURE | \
+                            SSSDBG_CRIT_FAILURE | \
+                            SSSDBG_OP_FAILURE)
+
+#define DEBUG_PREFIX_MAX 1024
+
+/* With asynchronous logging enabled the messages are formatted into
+ * debug_batch and written out in one go when it fills up, when a failure
+ * is logged and periodically from the main loop. Messages enabled only
+ * by debug_trace_level go to the debug_trace ring instead and are written
+ * out only when a failure is logged. SSSD processes are single threaded,
+ * so neither buffer needs any locking. */
+static struct {
+    char *data;
+    size_t size;
+    size_t used;
+} debug_batch;
+
+static struct {
+    char *data;
+    size_t size;
+    size_t pos;
+    bool wrapped;
+} debug_trace;
+
+/* The formatted date changes only once a second */
+static struct {
+    time_t sec;
+    char datetime[20];
+    int year;
+} debug_ts_cache = { (time_t) -1, { '\0' }, 0 };
+
 errno_t set_debug_file_from_fd(const int fd)
 {
     FILE *dummy;
@@ -143,6 +179,272 @@ static void debug_printf(const char *format, ...)
     va_end(ap);
 }
 
+static void debug_write(const char *data, size_t len)
+{
+    fwrite(data, 1, len, debug_file ? debug_file : stderr);
+}
+
+static void debug_timestamp(time_t sec, const char **_datetime, int *_year)
+{
+    struct tm tm;
+    char buf[26];
+
+    if (sec != debug_ts_cache.sec) {
+        localtime_r(&sec, &tm);
+        /* get date time without year */
+        asctime_r(&tm, buf);
+        memcpy(debug_ts_cache.datetime, buf, 19);
+        debug_ts_cache.datetime[19] = '\0';
+        debug_ts_cache.year = tm.tm_year + 1900;
+        debug_ts_cache.sec = sec;
+    }
+
+    *_datetime = debug_ts_cache.datetime;
+    *_year = debug_ts_cache.year;
+}
+
+static int debug_format_prefix(char *buf, size_t size,
+                               const char *function, int level)
+{
+    struct timeval tv;
+    const char *datetime;
+    int year;
+
+    if (!debug_timestamps) {
+        return snprintf(buf, size, "[%s] [%s] (%#.4x): ",
+                        debug_prg_name, function, level);
+    }
+
+    gettimeofday(&tv, NULL);
+    debug_timestamp(tv.tv_sec, &datetime, &year);
+
+    if (debug_microseconds) {
+        return snprintf(buf, size, "(%s:%.6ld %d) [%s] [%s] (%#.4x): ",
+                        datetime, tv.tv_usec, year,
+                        debug_prg_name, function, level);
+    }
+
+    return snprintf(buf, size, "(%s %d) [%s] [%s] (%#.4x): ",
+                    datetime, year, debug_prg_name, function, level);
+}
+
+static void debug_trace_add(const char *msg, size_t len)
+{
+    size_t n;
+
+    if (debug_trace.data == NULL) {
+        return;
+    }
+
+    if (len > debug_trace.size) {
+        msg += len - debug_trace.size;
+        len = debug_trace.size;
+    }
+
+    n = debug_trace.size - debug_trace.pos;
+    if (n > len) {
+        n = len;
+    }
+    memcpy(debug_trace.data + debug_trace.pos, msg, n);
+    debug_trace.pos += n;
+
+    if (debug_trace.pos == debug_trace.size) {
+        debug_trace.pos = 0;
+        debug_trace.wrapped = true;
+    }
+
+    if (n < len) {
+        memcpy(debug_trace.data, msg + n, len - n);
+        debug_trace.pos = len - n;
+    }
+}
+
+static void debug_trace_dump(void)
+{
+    const char *start;
+    const char *end;
+    const char *nl;
+
+    if (debug_trace.data == NULL
+            || (debug_trace.pos == 0 && !debug_trace.wrapped)) {
+        return;
+    }
+
+    debug_printf("[%s] ---- debug trace before the failure ----\n",
+                 debug_prg_name);
+
+    if (debug_trace.wrapped) {
+        /* skip the message that was partly overwritten */
+        start = debug_trace.data + debug_trace.pos;
+        end = debug_trace.data + debug_trace.size;
+        nl = memchr(start, '\n', end - start);
+        if (nl != NULL) {
+            debug_write(nl + 1, end - nl - 1);
+        }
+    }
+    debug_write(debug_trace.data, debug_trace.pos);
+
+    debug_printf("[%s] ---- end of the debug trace ----\n", debug_prg_name);
+
+    debug_trace.pos = 0;
+    debug_trace.wrapped = false;
+}
+
+void debug_flush(void)
+{
+    if (debug_batch.used > 0) {
+        debug_write(debug_batch.data, debug_batch.used);
+        debug_batch.used = 0;
+    }
+
+    debug_fflush();
+}
+
+/* The messages buffered by the parent are written out before it forks,
+ * a child that logs anything before it execs or exits does so
+ * synchronously, so no message is written twice or lost with the child */
+static void debug_atfork_child(void)
+{
+    free(debug_batch.data);
+    debug_batch.data = NULL;
+    debug_batch.size = 0;
+    debug_batch.used = 0;
+
+    free(debug_trace.data);
+    debug_trace.data = NULL;
+    debug_trace.size = 0;
+    debug_trace.pos = 0;
+    debug_trace.wrapped = false;
+    debug_trace_level = 0;
+}
+
+errno_t debug_buffer_init(size_t buffer_size, int trace_level,
+                          size_t trace_size)
+{
+    static bool exit_handler;
+    char *batch = NULL;
+    char *trace = NULL;
+
+    debug_flush();
+
+    if (buffer_size > 0) {
+        batch = malloc(buffer_size);
+        if (batch == NULL) {
+            return ENOMEM;
+        }
+    }
+
+    if (buffer_size > 0 && trace_level != 0 && trace_size > 0) {
+        trace = malloc(trace_size);
+        if (trace == NULL) {
+            free(batch);
+            return ENOMEM;
+        }
+    }
+
+    free(debug_batch.data);
+    debug_batch.data = batch;
+    debug_batch.size = buffer_size;
+    debug_batch.used = 0;
+
+    free(debug_trace.data);
+    debug_trace.data = trace;
+    debug_trace.size = trace_size;
+    debug_trace.pos = 0;
+    debug_trace.wrapped = false;
+    debug_trace_level = (trace == NULL) ? 0 : trace_level;
+
+    if (batch != NULL && !exit_handler) {
+        atexit(debug_flush);
+        pthread_atfork(debug_flush, NULL, debug_atfork_child);
+        exit_handler = true;
+    }
+
+    return EOK;
+}
+
+/* Formats the message at the end of debug_batch, returns its length or -1
+ * if it does not fit */
+static int debug_batch_format(const char *function, int level, int flags,
+                              const char *format, va_list ap)
+{
+    char *out = debug_batch.data + debug_batch.used;
+    size_t avail = debug_batch.size - debug_batch.used;
+    va_list ap_copy;
+    int len;
+    int ret;
+
+    len = debug_format_prefix(out, avail, function, level);
+    if (len < 0 || len >= avail) {
+        return -1;
+    }
+
+    va_copy(ap_copy, ap);
+    ret = vsnprintf(out + len, avail - len, format, ap_copy);
+    va_end(ap_copy);
+    if (ret < 0) {
+        return -1;
+    }
+    len += ret;
+
+    if (flags & APPEND_LINE_FEED) {
+        if (len + 1 >= avail) {
+            return -1;
+        }
+        out[len++] = '\n';
+    }
+
+    return len < avail ? len : -1;
+}
+
+static void debug_batch_vprintf(const char *function, int level, int flags,
+                                const char *format, va_list ap)
+{
+    char prefix[DEBUG_PREFIX_MAX];
+    char *out;
+    int len;
+
+    len = debug_batch_format(function, level, flags, format, ap);
+    if (len < 0 && debug_batch.used > 0) {
+        debug_flush();
+        len = debug_batch_format(function, level, flags, format, ap);
+    }
+
+    if (len < 0) {
+        /* larger than the whole buffer */
+        if (DEBUG_IS_LOGGED(level)) {
+            debug_format_prefix(prefix, sizeof(prefix), function, level);
+            debug_printf("%s", prefix);
+            debug_vprintf(format, ap);
+            if (flags & APPEND_LINE_FEED) {
+                debug_printf("\n");
+            }
+            debug_fflush();
+        }
+        return;
+    }
+
+    out = debug_batch.data + debug_batch.used;
+
+    if (!DEBUG_IS_LOGGED(level)) {
+        debug_trace_add(out, len);
+        return;
+    }
+
+    if (level & DEBUG_FLUSH_LEVELS) {
+        /* everything logged before, then the trace leading to the failure,
+         * then the failure itself */
+        debug_write(debug_batch.data, debug_batch.used);
+        debug_trace_dump();
+        debug_write(out, len);
+        debug_batch.used = 0;
+        debug_fflush();
+        return;
+    }
+
+    debug_batch.used += len;
+}
+
 #ifdef WITH_JOURNALD
 errno_t journal_send(const char *file,
         long line,
@@ -214,10 +516,7 @@ void sss_vdebug_fn(const char *file,
                    const char *format,
                    va_list ap)
 {
-    struct timeval tv;
-    struct tm *tm;
-    char datetime[20];
-    int year;
+    char prefix[DEBUG_PREFIX_MAX];
 
 #ifdef WITH_JOURNALD
     errno_t ret;
@@ -231,6 +530,21 @@ void sss_vdebug_fn(const char *file,
          * can also provide extra structuring data to make it more easily
          * searchable.
          */
+        if (!DEBUG_IS_LOGGED(level)) {
+            /* enabled only by debug_trace_level, record it in the ring */
+            if (debug_batch.data != NULL) {
+                debug_batch_vprintf(function, level, flags, format, ap);
+            }
+            return;
+        }
+
+        if (level & DEBUG_FLUSH_LEVELS) {
+            /* the trace leading to the failure ends up in the journal
+             * through stderr */
+            debug_trace_dump();
+            debug_fflush();
+        }
+
         va_copy(ap_fallback, ap);
         ret = journal_send(file, line, function, level, format, ap);
         if (ret != EOK) {
@@ -243,28 +557,14 @@ void sss_vdebug_fn(const char *file,
     }
 #endif
 
-    if (debug_timestamps) {
-        gettimeofday(&tv, NULL);
-        tm = localtime(&tv.tv_sec);
-        year = tm->tm_year + 1900;
-        /* get date time without year */
-        memcpy(datetime, ctime(&tv.tv_sec), 19);
-        datetime[19] = '\0';
-        if (debug_microseconds) {
-            debug_printf("(%s:%.6ld %d) [%s] [%s] (%#.4x): ",
-                         datetime, tv.tv_usec,
-                         year, debug_prg_name,
-                         function, level);
-        } else {
-            debug_printf("(%s %d) [%s] [%s] (%#.4x): ",
-                         datetime, year,
-                         debug_prg_name, function, level);
-        }
-    } else {
-        debug_printf("[%s] [%s] (%#.4x): ",
-                     debug_prg_name, function, level);
+    if (debug_batch.data != NULL) {
+        debug_batch_vprintf(function, level, flags, format, ap);
+        return;
     }
 
+    debug_format_prefix(prefix, sizeof(prefix), function, level);
+    debug_printf("%s", prefix);
+
     debug_vprintf(format, ap);
     if (flags & APPEND_LINE_FEED) {
         debug_printf("\n");
@@ -418,6 +718,8 @@ int rotate_debug_files(void)
 
     if (!debug_to_file) return EOK;
 
+    debug_flush();
+
     do {
         error = 0;
         ret = fclose(debug_file);
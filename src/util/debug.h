@@ -37,6 +37,7 @@ extern int debug_timestamps;
 extern int debug_microseconds;
 extern int debug_to_file;
 extern int debug_to_stderr;
+extern int debug_trace_level;
 extern const char *debug_log_file;
 void sss_vdebug_fn(const char *file,
                    long line,
@@ -54,6 +55,16 @@ int debug_convert_old_level(int old_level);
 errno_t set_debug_file_from_fd(const int fd);
 int get_fd_from_debug_file(void);
 
+/* Switches to asynchronous logging through a buffer of buffer_size bytes,
+ * a buffer_size of 0 switches back to writing every message at once.
+ * Messages enabled by trace_level but not by debug_level are kept in
+ * a ring of trace_size bytes that is written out only when a failure
+ * is logged. */
+errno_t debug_buffer_init(size_t buffer_size, int trace_level,
+                          size_t trace_size);
+/* Writes out the buffered messages */
+void debug_flush(void);
+
 #define SSS_DOM_ENV           "_SSS_DOM"
 
 #define SSSDBG_FATAL_FAILURE  0x0010   /* level 0 */
@@ -110,11 +121,19 @@ int get_fd_from_debug_file(void);
 } while (0)
 
 /** \def DEBUG_IS_SET(level)
+    \brief checks whether messages of the level are logged or traced
+
+    \param level the debug level, please use one of the SSSDBG*_ macros
+*/
+#define DEBUG_IS_SET(level) (DEBUG_IS_LOGGED(level) || \
+                             debug_trace_level & (level))
+
+/** \def DEBUG_IS_LOGGED(level)
     \brief checks whether level is set in debug_level
 
     \param level the debug level, please use one of the SSSDBG*_ macros
 */
-#define DEBUG_IS_SET(level) (debug_level & (level) || \
+#define DEBUG_IS_LOGGED(level) (debug_level & (level) || \
                             (debug_level == SSSDBG_UNRESOLVED && \
                                             (level & (SSSDBG_FATAL_FAILURE | \
                                                       SSSDBG_CRIT_FAILURE))))
@@ -149,6 +149,109 @@ struct sss_mc_initgr_data {
                              * after gids */
 };
 
+struct sss_mc_netgr_data {
+    rel_ptr_t name;         /* ptr to name string, rel. to struct base addr */
+    uint32_t num_entries;   /* number of netgroup entries in strs */
+    uint32_t entries_len;   /* length of the packed entries */
+    uint32_t strs_len;      /* length of strs */
+    char strs[0];           /* name of the netgroup followed by all the
+                             * entries packed exactly as in the body of
+                             * a SSS_NSS_GETNETGRENT reply (32bit type
+                             * followed by zero terminated strings) */
+};
+
+struct sss_mc_svc_data {
+    rel_ptr_t name;         /* ptr to the "name/protocol" key string,
+                             * rel. to struct base addr */
+    uint32_t port;          /* port number in network byte order */
+    uint32_t num_aliases;   /* number of aliases in strs */
+    uint32_t strs_len;      /* length of strs */
+    char strs[0];           /* concatenation of all service strings, each
+                             * string is zero terminated ordered as follows:
+                             * key, name, protocol, alias1, alias2, ... */
+};
+
+struct sss_mc_sid_data {
+    rel_ptr_t name;         /* ptr to name string, rel. to struct base addr */
+    rel_ptr_t sid;          /* ptr to SID string, rel. to struct base addr */
+    uint32_t id;            /* POSIX ID, 0 if the object has none */
+    uint32_t type;          /* enum sss_id_type of the object */
+    uint32_t strs_len;      /* length of strs */
+    char strs[0];           /* concatenation of all strings, each string is
+                             * zero terminated ordered as follows:
+                             * name, sid */
+};
+
+/* Keys of the negative records, the prefix is followed by the name or by
+ * the decimal ID that was not found */
+#define SSS_MC_NEG_PWNAM "pwnam:"
+#define SSS_MC_NEG_PWUID "pwuid:"
+#define SSS_MC_NEG_GRNAM "grnam:"
+#define SSS_MC_NEG_GRGID "grgid:"
+
+struct sss_mc_neg_data {
+    rel_ptr_t name;         /* ptr to the key string, rel. to struct base addr */
+    uint32_t strs_len;      /* length of strs */
+    char strs[0];           /* zero terminated key */
+};
+
+/* Lookup statistics of the clients. The clients count their lookups and
+ * report them to the responder with SSS_NSS_MC_STATS, the responder adds
+ * them up in a file only it can write to. The counts come from the
+ * clients, so they must never be trusted for anything but reporting. */
+#define SSS_MC_STATS_FILE "stats"
+
+#define SSS_MC_STATS_MAGIC  0x5353534d  /* "SSSM" */
+#define SSS_MC_STATS_VNO    1
+
+enum sss_mc_stats_id {
+    SSS_MC_STATS_PASSWD = 0,
+    SSS_MC_STATS_GROUP,
+    SSS_MC_STATS_INITGROUPS,
+    SSS_MC_STATS_NETGROUP,
+    SSS_MC_STATS_SERVICES,
+    SSS_MC_STATS_SID,
+    SSS_MC_STATS_NEGATIVE,
+
+    SSS_MC_STATS_NUM    /* keep last */
+};
+
+/* names of the caches in the order of enum sss_mc_stats_id */
+#define SSS_MC_STATS_NAMES { "passwd", "group", "initgroups", "netgroup", \
+                             "services", "sid", "negative" }
+
+/* hash chain lengths 0, 1, 2, 3, 4-7, 8-15, 16-31 and 32 or more */
+#define SSS_MC_STATS_CHAIN_BUCKETS 8
+
+struct sss_mc_stats_counters {
+    uint64_t hits;          /* record found and returned */
+    uint64_t misses;        /* not in the cache, asked the responder */
+    uint64_t expired;       /* record found but expired or invalid */
+    uint64_t retries;       /* record reads repeated on barrier mismatch */
+    uint64_t chain_len[SSS_MC_STATS_CHAIN_BUCKETS]; /* records visited
+                                                     * per lookup */
+};
+
+struct sss_mc_stats {
+    uint32_t magic;         /* SSS_MC_STATS_MAGIC */
+    uint32_t vno;           /* SSS_MC_STATS_VNO */
+    uint32_t num_caches;    /* SSS_MC_STATS_NUM */
+    uint32_t reserved;
+    uint64_t created;       /* time the counters were created at */
+    struct sss_mc_stats_counters caches[SSS_MC_STATS_NUM];
+};
+
+/* all counters of all caches, they are added up one by one */
+#define SSS_MC_STATS_COUNTERS \
+    (SSS_MC_STATS_NUM * (sizeof(struct sss_mc_stats_counters) / sizeof(uint64_t)))
+
+/* body of the SSS_NSS_MC_STATS request, the counts since the last report */
+struct sss_mc_stats_report {
+    uint32_t vno;           /* SSS_MC_STATS_VNO */
+    uint32_t num_caches;    /* SSS_MC_STATS_NUM */
+    struct sss_mc_stats_counters caches[SSS_MC_STATS_NUM];
+};
+
 #pragma pack()
 
 
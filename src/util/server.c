@@ -32,6 +32,7 @@
 #include "util/util.h"
 #include "confdb/confdb.h"
 #include "monitor/monitor_interfaces.h"
+#include "util/sss_latency.h"
 
 #ifdef HAVE_PRCTL
 #include <sys/prctl.h>
@@ -358,6 +359,11 @@ int die_if_parent_died(void)
     return EOK;
 }
 
+/* How often the buffered debug messages are written out, in seconds */
+#define DEBUG_FLUSH_INTERVAL 1
+/* Size of the debug trace ring in KiB */
+#define DEBUG_TRACE_SIZE_DEFAULT 1024
+
 struct logrotate_ctx {
     struct confdb_ctx *confdb;
     const char *confdb_path;
@@ -417,6 +423,112 @@ errno_t server_common_rotate_logs(struct confdb_ctx *confdb,
     return EOK;
 }
 
+static void server_debug_flush_handler(struct tevent_context *ev,
+                                       struct tevent_timer *te,
+                                       struct timeval current_time,
+                                       void *pvt)
+{
+    struct main_context *ctx = talloc_get_type(pvt, struct main_context);
+    struct tevent_timer *next;
+
+    debug_flush();
+
+    next = tevent_add_timer(ev, ctx,
+                            tevent_timeval_current_ofs(DEBUG_FLUSH_INTERVAL, 0),
+                            server_debug_flush_handler, ctx);
+    if (next == NULL) {
+        /* nothing would write the buffer out anymore */
+        debug_buffer_init(0, 0, 0);
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Cannot schedule the debug flush, logging synchronously\n");
+    }
+}
+
+static errno_t server_setup_debug_buffer(struct main_context *ctx,
+                                         const char *conf_entry)
+{
+    struct tevent_timer *te;
+    int buffer_size;
+    int trace_level;
+    int trace_size;
+    errno_t ret;
+
+    ret = confdb_get_int(ctx->confdb_ctx, conf_entry,
+                         CONFDB_SERVICE_DEBUG_BUFFER_SIZE, 0, &buffer_size);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    if (buffer_size <= 0) {
+        return EOK;
+    }
+
+    ret = confdb_get_int(ctx->confdb_ctx, conf_entry,
+                         CONFDB_SERVICE_DEBUG_TRACE_LEVEL, 0, &trace_level);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    if (trace_level != 0) {
+        trace_level = debug_convert_old_level(trace_level);
+    }
+
+    ret = confdb_get_int(ctx->confdb_ctx, conf_entry,
+                         CONFDB_SERVICE_DEBUG_TRACE_SIZE,
+                         DEBUG_TRACE_SIZE_DEFAULT, &trace_size);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    if (trace_size < 0) {
+        trace_size = 0;
+    }
+
+    te = tevent_add_timer(ctx->event_ctx, ctx,
+                          tevent_timeval_current_ofs(DEBUG_FLUSH_INTERVAL, 0),
+                          server_debug_flush_handler, ctx);
+    if (te == NULL) {
+        return ENOMEM;
+    }
+
+    ret = debug_buffer_init((size_t) buffer_size * 1024, trace_level,
+                            (size_t) trace_size * 1024);
+    if (ret != EOK) {
+        talloc_free(te);
+        return ret;
+    }
+
+    DEBUG(SSSDBG_CONF_SETTINGS,
+          "Buffering up to %d KiB of debug messages\n", buffer_size);
+
+    return EOK;
+}
+
+static errno_t server_setup_latency(struct main_context *ctx,
+                                    const char *conf_entry)
+{
+    int report_interval;
+    bool trace_requests;
+    errno_t ret;
+
+    ret = confdb_get_int(ctx->confdb_ctx, conf_entry,
+                         CONFDB_SERVICE_LATENCY_REPORT_INTERVAL, 0,
+                         &report_interval);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = confdb_get_bool(ctx->confdb_ctx, conf_entry,
+                          CONFDB_SERVICE_LATENCY_TRACE_REQUESTS, false,
+                          &trace_requests);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    return sss_latency_setup(ctx, ctx->event_ctx, report_interval,
+                             trace_requests);
+}
+
 static const char *get_db_path(void)
 {
 #ifdef UNIT_TESTING
@@ -643,6 +755,20 @@ int server_setup(const char *name, int flags,
         }
     }
 
+    ret = server_setup_debug_buffer(ctx, conf_entry);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE, "Error setting up debug buffering (%d) "
+                                     "[%s]\n", ret, strerror(ret));
+        return ret;
+    }
+
+    ret = server_setup_latency(ctx, conf_entry);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE, "Error setting up latency tracing (%d) "
+                                     "[%s]\n", ret, strerror(ret));
+        return ret;
+    }
+
     sss_log(SSS_LOG_INFO, "Starting up");
 
     DEBUG(SSSDBG_TRACE_FUNC, "CONFDB: %s\n", conf_db);
@@ -0,0 +1,276 @@
+/*
+   SSSD
+
+   Per-request latency tracing
+
+   Copyright (C) 2016 Red Hat
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <unistd.h>
+
+#include "util/util.h"
+#include "util/sss_latency.h"
+
+/* Bucket i counts the durations from 2^i up to 2^(i+1) microseconds, the
+ * last one everything longer than about 16 seconds */
+#define SSS_LATENCY_BUCKETS 25
+
+struct sss_latency_histogram {
+    uint64_t count;
+    uint64_t total_usec;
+    uint64_t max_usec;
+    uint64_t buckets[SSS_LATENCY_BUCKETS];
+};
+
+static struct sss_latency_ctx {
+    bool enabled;
+    bool trace_requests;
+    int report_interval;
+    time_t since;
+
+    uint32_t next_rid;
+    uint32_t current_rid;
+
+    struct sss_latency_histogram stages[SSS_LATENCY_STAGE_MAX];
+} latency;
+
+static const char *sss_latency_stage_names[SSS_LATENCY_STAGE_MAX] = {
+    "client request",
+    "cache search",
+    "data provider request",
+    "back end queue",
+    "back end request",
+    "LDAP operation",
+    "cache write",
+};
+
+bool sss_latency_enabled(void)
+{
+    return latency.enabled;
+}
+
+uint32_t sss_latency_new_rid(void)
+{
+    if (!latency.enabled) {
+        return 0;
+    }
+
+    /* 0 means no request */
+    latency.next_rid++;
+    if (latency.next_rid == 0) {
+        latency.next_rid++;
+    }
+
+    return latency.next_rid;
+}
+
+uint32_t sss_latency_set_current(uint32_t rid)
+{
+    uint32_t prev = latency.current_rid;
+
+    latency.current_rid = rid;
+
+    return prev;
+}
+
+uint32_t sss_latency_current_rid(void)
+{
+    return latency.current_rid;
+}
+
+void sss_latency_start(struct timeval *start)
+{
+    if (!latency.enabled) {
+        timerclear(start);
+        return;
+    }
+
+    gettimeofday(start, NULL);
+}
+
+void sss_latency_record(uint32_t rid, enum sss_latency_stage stage,
+                        const struct timeval *start)
+{
+    struct sss_latency_histogram *hist;
+    struct timeval now;
+    uint64_t usec;
+    int bucket;
+
+    if (!latency.enabled || !timerisset(start)
+            || stage >= SSS_LATENCY_STAGE_MAX) {
+        return;
+    }
+
+    gettimeofday(&now, NULL);
+    if (timercmp(&now, start, <)) {
+        /* the clock was set back */
+        usec = 0;
+    } else {
+        usec = (uint64_t) (now.tv_sec - start->tv_sec) * 1000000
+               + now.tv_usec - start->tv_usec;
+    }
+
+    for (bucket = 0; bucket < SSS_LATENCY_BUCKETS - 1; bucket++) {
+        if ((usec >> (bucket + 1)) == 0) {
+            break;
+        }
+    }
+
+    hist = &latency.stages[stage];
+    hist->count++;
+    hist->total_usec += usec;
+    hist->buckets[bucket]++;
+    if (usec > hist->max_usec) {
+        hist->max_usec = usec;
+    }
+
+    if (latency.trace_requests) {
+        DEBUG(SSSDBG_IMPORTANT_INFO,
+              "Request [%#x]: %s took %"PRIu64".%06"PRIu64" seconds\n",
+              rid, sss_latency_stage_names[stage],
+              usec / 1000000, usec % 1000000);
+    }
+}
+
+/* Upper bound of the duration under which the given percentage of the
+ * recorded durations fall, in microseconds */
+static uint64_t sss_latency_percentile(struct sss_latency_histogram *hist,
+                                       unsigned int percent)
+{
+    uint64_t wanted;
+    uint64_t seen = 0;
+    int i;
+
+    wanted = (hist->count * percent + 99) / 100;
+
+    for (i = 0; i < SSS_LATENCY_BUCKETS - 1; i++) {
+        seen += hist->buckets[i];
+        if (seen >= wanted) {
+            return (uint64_t) 1 << (i + 1);
+        }
+    }
+
+    return hist->max_usec;
+}
+
+void sss_latency_report(void)
+{
+    struct sss_latency_histogram *hist;
+    char buckets[SSS_LATENCY_BUCKETS * 24];
+    size_t pos;
+    time_t now;
+    int stage;
+    int i;
+
+    if (!latency.enabled) {
+        return;
+    }
+
+    now = time(NULL);
+
+    for (stage = 0; stage < SSS_LATENCY_STAGE_MAX; stage++) {
+        hist = &latency.stages[stage];
+        if (hist->count == 0) {
+            continue;
+        }
+
+        pos = 0;
+        buckets[0] = '\0';
+        for (i = 0; i < SSS_LATENCY_BUCKETS; i++) {
+            if (hist->buckets[i] == 0) {
+                continue;
+            }
+
+            if (i < SSS_LATENCY_BUCKETS - 1) {
+                pos += snprintf(buckets + pos, sizeof(buckets) - pos,
+                                " <%"PRIu64"us:%"PRIu64,
+                                (uint64_t) 1 << (i + 1), hist->buckets[i]);
+            } else {
+                pos += snprintf(buckets + pos, sizeof(buckets) - pos,
+                                " longer:%"PRIu64, hist->buckets[i]);
+            }
+            if (pos >= sizeof(buckets)) {
+                break;
+            }
+        }
+
+        DEBUG(SSSDBG_IMPORTANT_INFO,
+              "Latency of %s in the last %ld seconds: %"PRIu64" requests, "
+              "average %"PRIu64"us, 50%% under %"PRIu64"us, "
+              "90%% under %"PRIu64"us, 99%% under %"PRIu64"us, "
+              "max %"PRIu64"us, histogram:%s\n",
+              sss_latency_stage_names[stage], (long) (now - latency.since),
+              hist->count, hist->total_usec / hist->count,
+              sss_latency_percentile(hist, 50),
+              sss_latency_percentile(hist, 90),
+              sss_latency_percentile(hist, 99),
+              hist->max_usec, buckets);
+    }
+
+    memset(latency.stages, 0, sizeof(latency.stages));
+    latency.since = now;
+}
+
+static void sss_latency_report_handler(struct tevent_context *ev,
+                                       struct tevent_timer *te,
+                                       struct timeval current_time,
+                                       void *pvt)
+{
+    struct tevent_timer *next;
+
+    sss_latency_report();
+
+    next = tevent_add_timer(ev, pvt,
+                            tevent_timeval_current_ofs(latency.report_interval,
+                                                       0),
+                            sss_latency_report_handler, pvt);
+    if (next == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Cannot schedule the next latency report\n");
+    }
+}
+
+errno_t sss_latency_setup(TALLOC_CTX *mem_ctx,
+                          struct tevent_context *ev,
+                          int report_interval,
+                          bool trace_requests)
+{
+    struct tevent_timer *te;
+
+    if (report_interval <= 0) {
+        latency.enabled = false;
+        return EOK;
+    }
+
+    te = tevent_add_timer(ev, mem_ctx,
+                          tevent_timeval_current_ofs(report_interval, 0),
+                          sss_latency_report_handler, mem_ctx);
+    if (te == NULL) {
+        return ENOMEM;
+    }
+
+    latency.enabled = true;
+    latency.trace_requests = trace_requests;
+    latency.report_interval = report_interval;
+    latency.since = time(NULL);
+    /* keep the IDs of the responders and back ends apart */
+    latency.next_rid = ((uint32_t) getpid()) << 16;
+
+    DEBUG(SSSDBG_CONF_SETTINGS,
+          "Reporting request latency every %d seconds\n", report_interval);
+
+    return EOK;
+}
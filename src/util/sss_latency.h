@@ -0,0 +1,81 @@
+/*
+   SSSD
+
+   Per-request latency tracing
+
+   Copyright (C) 2016 Red Hat
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SSS_LATENCY_H__
+#define __SSS_LATENCY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/time.h>
+#include <talloc.h>
+#include <tevent.h>
+
+/* Stages a request is timed at. Each process keeps a histogram of the
+ * stages it runs. */
+enum sss_latency_stage {
+    /* responder: client command received until the reply is ready */
+    SSS_LATENCY_CLIENT,
+    /* responder: cache_req lookup in the cache */
+    SSS_LATENCY_CACHE_SEARCH,
+    /* responder: round trip of a request to the back end */
+    SSS_LATENCY_DP_REQUEST,
+    /* back end: request waiting to be dispatched */
+    SSS_LATENCY_BE_QUEUE,
+    /* back end: request dispatched until it is answered */
+    SSS_LATENCY_BE_REQUEST,
+    /* back end: LDAP operation sent until the final reply */
+    SSS_LATENCY_LDAP_OP,
+    /* commit of a cache transaction */
+    SSS_LATENCY_SYSDB_WRITE,
+
+    SSS_LATENCY_STAGE_MAX
+};
+
+/* Enables the histograms, they are logged and reset every report_interval
+ * seconds. With trace_requests every timed stage is logged as well. */
+errno_t sss_latency_setup(TALLOC_CTX *mem_ctx,
+                          struct tevent_context *ev,
+                          int report_interval,
+                          bool trace_requests);
+
+bool sss_latency_enabled(void);
+
+/* Returns a new request ID, unique within the process */
+uint32_t sss_latency_new_rid(void);
+
+/* The request ID the code running right now works for. Set it around the
+ * entry points of a request and the callbacks that resume it, anything
+ * started from there (back end requests, LDAP operations, cache writes)
+ * is recorded under that ID. Returns the previous ID. */
+uint32_t sss_latency_set_current(uint32_t rid);
+uint32_t sss_latency_current_rid(void);
+
+/* Stores the start time of a stage, a no-op when tracing is disabled */
+void sss_latency_start(struct timeval *start);
+
+/* Records the time elapsed since sss_latency_start() */
+void sss_latency_record(uint32_t rid, enum sss_latency_stage stage,
+                        const struct timeval *start);
+
+/* Logs the histograms collected so far and resets them */
+void sss_latency_report(void);
+
+#endif /* __SSS_LATENCY_H__ */